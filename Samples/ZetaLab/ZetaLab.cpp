@@ -56,7 +56,7 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
         // load the gltf model(s)
         timer.Start();
 
-        Model::glTF::Load(path);
+        Model::glTF::Load(path, false, true);
 
         App::FlushWorkerThreadPool();
 
@@ -1,4 +1,5 @@
 #include <Utility/SmallVector.h>
+#include <Utility/HashTable.h>
 #include <App/App.h>
 #include <Support/MemoryArena.h>
 #include <doctest/doctest.h>
@@ -141,4 +142,70 @@ TEST_SUITE("SmallVector")
 		for (int i = 0; i < 10; i++)
 			CHECK(vec1[i] == i);
 	}
+};
+TEST_SUITE("HashTable")
+{
+	TEST_CASE("Erase")
+	{
+		HashTable<uint64_t> table;
+
+		// keys that collide in the same (small) table so that erasing leaves holes in probe sequences
+		constexpr uint64_t N = 1000;
+		for (uint64_t i = 0; i < N; i++)
+			table.insert_or_assign(i * 64, i);
+
+		for (uint64_t i = 0; i < N; i += 3)
+			CHECK(table.erase(i * 64) == 1);
+
+		CHECK(table.erase(1) == 0);
+		CHECK(table.size() == N - (N + 2) / 3);
+
+		int numWrong = 0;
+
+		for (uint64_t i = 0; i < N; i++)
+		{
+			const uint64_t* v = table.find(i * 64);
+
+			if (i % 3 == 0)
+				numWrong += v != nullptr;
+			else
+				numWrong += !v || *v != i;
+		}
+
+		CHECK(numWrong == 0);
+
+		// erased keys can be inserted again
+		for (uint64_t i = 0; i < N; i += 3)
+			table.insert_or_assign(i * 64, i);
+
+		CHECK(table.size() == N);
+		table.free();
+	}
+
+	TEST_CASE("Const")
+	{
+		HashTable<uint64_t> table;
+
+		for (uint64_t i = 0; i < 100; i++)
+			table.insert_or_assign(i * 7, i);
+
+		const HashTable<uint64_t>& constTable = table;
+		const uint64_t* v = constTable.find(14);
+		REQUIRE(v);
+		CHECK(*v == 2);
+		CHECK(constTable.find(15) == nullptr);
+
+		uint64_t sum = 0;
+		size_t n = 0;
+
+		for (auto* it = constTable.begin_it(); it != constTable.end_it(); it = constTable.next_it(it))
+		{
+			sum += it->Val;
+			n++;
+		}
+
+		CHECK(n == 100);
+		CHECK(sum == 99 * 100 / 2);
+		table.free();
+	}
 };
\ No newline at end of file
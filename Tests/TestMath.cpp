@@ -1,10 +1,17 @@
 #include <Math/CollisionFuncs.h>
 #include <Math/Quaternion.h>
 #include <Math/MatrixFuncs.h>
+#include <Math/MeshBVH.h>
+#include <Math/BVH.h>
+#include <Math/SpatialHash.h>
+#include <Math/OcclusionCulling.h>
+#include <Math/BatchFuncs.h>
 #include <Utility/RNG.h>
 #include <doctest/doctest.h>
 #include <DirectXMath.h>
 #include <DirectXCollision.h>
+#include <algorithm>
+#include <chrono>
 
 using namespace ZetaRay;
 using namespace ZetaRay::Util;
@@ -424,6 +431,805 @@ TEST_CASE("QuaternionFromRotationMat")
 }
 
 
+TEST_CASE("MeshBVH")
+{
+	RNG rng;
+	constexpr int NUM_TRIS = 2000;
+
+	SmallVector<Core::Vertex> vertices;
+	SmallVector<uint32_t> indices;
+
+	// random small triangles in [-10, 10]^3
+	for (int i = 0; i < NUM_TRIS; i++)
+	{
+		float3 c(rng.GetUniformFloat() * 20.0f - 10.0f, rng.GetUniformFloat() * 20.0f - 10.0f, rng.GetUniformFloat() * 20.0f - 10.0f);
+
+		for (int j = 0; j < 3; j++)
+		{
+			Core::Vertex v{};
+			v.Position = float3(c.x + rng.GetUniformFloat() - 0.5f, c.y + rng.GetUniformFloat() - 0.5f, c.z + rng.GetUniformFloat() - 0.5f);
+			vertices.push_back(v);
+			indices.push_back(3 * i + j);
+		}
+	}
+
+	MeshBVH bvh;
+	bvh.Build(vertices, indices);
+	CHECK(bvh.GetNumTriangles() == NUM_TRIS);
+
+	SUBCASE("Closest hit matches brute force")
+	{
+		for (int r = 0; r < 500; r++)
+		{
+			Ray ray(float3(rng.GetUniformFloat() * 20.0f - 10.0f, rng.GetUniformFloat() * 20.0f - 10.0f, rng.GetUniformFloat() * 20.0f - 10.0f),
+				float3(rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f));
+			v_Ray vRay(ray);
+
+			float closestT = FLT_MAX;
+			uint32_t closestTri = uint32_t(-1);
+
+			for (int i = 0; i < NUM_TRIS; i++)
+			{
+				float t;
+				if (intersectRayVsTriangle(vRay, loadFloat3(vertices[3 * i].Position), loadFloat3(vertices[3 * i + 1].Position),
+					loadFloat3(vertices[3 * i + 2].Position), t) && t < closestT)
+				{
+					closestT = t;
+					closestTri = i;
+				}
+			}
+
+			MeshBVH::Hit hit;
+			const bool found = bvh.CastRay(ray, hit);
+
+			CHECK(found == (closestTri != uint32_t(-1)));
+
+			if (found)
+			{
+				CHECK(hit.PrimitiveIdx == closestTri);
+				CHECK(fabsf(hit.T - closestT) < 1e-5f);
+
+				// hit position from barycentrics must match the one from ray distance
+				const float3 v0 = vertices[3 * hit.PrimitiveIdx].Position;
+				const float3 v1 = vertices[3 * hit.PrimitiveIdx + 1].Position;
+				const float3 v2 = vertices[3 * hit.PrimitiveIdx + 2].Position;
+				const float3 p = v0 + hit.U * (v1 - v0) + hit.V * (v2 - v0);
+				const float3 q = ray.Origin + hit.T * ray.Dir;
+
+				CHECK(fabsf(p.x - q.x) < 1e-3f);
+				CHECK(fabsf(p.y - q.y) < 1e-3f);
+				CHECK(fabsf(p.z - q.z) < 1e-3f);
+			}
+		}
+	}
+
+	SUBCASE("Serialization round trip")
+	{
+		SmallVector<uint8_t> data;
+		bvh.Serialize(data);
+
+		MeshBVH loaded;
+		const uint8_t* curr = data.begin();
+		CHECK(loaded.Deserialize(curr, data.end()));
+		CHECK(curr == data.end());
+		CHECK(loaded.GetNumTriangles() == bvh.GetNumTriangles());
+
+		Ray ray(float3(-20.0f, 0.1f, 0.2f), float3(1.0f, 0.0f, 0.0f));
+		MeshBVH::Hit h1;
+		MeshBVH::Hit h2;
+		CHECK(bvh.CastRay(ray, h1) == loaded.CastRay(ray, h2));
+		CHECK(h1.PrimitiveIdx == h2.PrimitiveIdx);
+	}
+
+	SUBCASE("Corrupted data is rejected")
+	{
+		SmallVector<uint8_t> data;
+		bvh.Serialize(data);
+
+		// header is followed by the nodes, right child of the root is at offset 24 of the first node
+		constexpr size_t HEADER_SIZE = 3 * sizeof(uint32_t);
+		const uint32_t outOfBounds = uint32_t(-1);
+		memcpy(data.begin() + HEADER_SIZE + 24, &outOfBounds, sizeof(uint32_t));
+
+		MeshBVH loaded;
+		const uint8_t* curr = data.begin();
+		CHECK(!loaded.Deserialize(curr, data.end()));
+		CHECK(!loaded.IsBuilt());
+	}
+}
+
+TEST_CASE("BVH")
+{
+	RNG rng;
+	constexpr int NUM_INSTANCES = 1000;
+	constexpr int NUM_ROUNDS = 20;
+	constexpr int NUM_STREAMED_PER_ROUND = 100;
+	constexpr int NUM_RAYS_PER_ROUND = 64;
+
+	auto randomBox = [&rng]()
+		{
+			return AABB(float3(rng.GetUniformFloat() * 200.0f - 100.0f, rng.GetUniformFloat() * 200.0f - 100.0f, rng.GetUniformFloat() * 200.0f - 100.0f),
+				float3(0.5f + rng.GetUniformFloat() * 2.5f, 0.5f + rng.GetUniformFloat() * 2.5f, 0.5f + rng.GetUniformFloat() * 2.5f));
+		};
+
+	// instances that are currently in the BVH
+	SmallVector<BVH::BVHInput> live;
+	uint64_t nextID = 0;
+
+	for (int i = 0; i < NUM_INSTANCES; i++)
+		live.push_back(BVH::BVHInput{ .AABB = randomBox(), .ID = nextID++ });
+
+	BVH bvh;
+	bvh.Build(live);
+
+	// streams instances in & out and moves some of the existing ones around
+	auto stream = [&]()
+		{
+			for (int i = 0; i < NUM_STREAMED_PER_ROUND; i++)
+			{
+				const uint32_t idx = rng.GetUniformUintBounded((uint32_t)live.size());
+				bvh.Remove(live[idx].ID, live[idx].AABB);
+
+				live[idx] = live.back();
+				live.pop_back();
+			}
+
+			for (int i = 0; i < NUM_STREAMED_PER_ROUND; i++)
+			{
+				live.push_back(BVH::BVHInput{ .AABB = randomBox(), .ID = nextID++ });
+				bvh.Insert(live.back());
+			}
+
+			for (int i = 0; i < NUM_STREAMED_PER_ROUND / 4; i++)
+			{
+				const uint32_t idx = rng.GetUniformUintBounded((uint32_t)live.size());
+
+				// alternate between small moves and moving to a random (most likely disjoint) position
+				AABB newBox = live[idx].AABB;
+				if (i & 0x1)
+					newBox.Center = newBox.Center + float3(0.25f, -0.25f, 0.25f);
+				else
+					newBox = randomBox();
+
+				BVH::BVHUpdateInput update{ .OldBox = live[idx].AABB, .NewBox = newBox, .ID = live[idx].ID };
+				bvh.Update(Span(&update, 1));
+
+				live[idx].AABB = newBox;
+			}
+		};
+
+	auto checkClosestHit = [&]()
+		{
+			// from outside the scene bounds towards a random point inside
+			float3 origin(rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f);
+			origin.normalize();
+			origin = origin * 300.0f;
+			float3 target(rng.GetUniformFloat() * 100.0f - 50.0f, rng.GetUniformFloat() * 100.0f - 50.0f, rng.GetUniformFloat() * 100.0f - 50.0f);
+			float3 dir = target - origin;
+			dir.normalize();
+
+			Ray ray(origin, dir);
+			v_Ray vRay(ray);
+
+			float closestT = FLT_MAX;
+			float hitT = FLT_MAX;
+			const uint64_t hitID = bvh.CastRay(ray);
+
+			for (auto& instance : live)
+			{
+				float t;
+				if (intersectRayVsAABB(vRay, v_AABB(instance.AABB), t))
+				{
+					closestT = Min(closestT, t);
+					hitT = instance.ID == hitID ? t : hitT;
+				}
+			}
+
+			CHECK((hitID == uint64_t(-1)) == (closestT == FLT_MAX));
+			CHECK(fabsf(hitT - closestT) < 1e-4f);
+		};
+
+	SUBCASE("Closest hit matches brute force after streaming")
+	{
+		for (int round = 0; round < NUM_ROUNDS; round++)
+		{
+			stream();
+
+			for (int r = 0; r < NUM_RAYS_PER_ROUND; r++)
+				checkClosestHit();
+		}
+	}
+
+	SUBCASE("Tree quality after streaming")
+	{
+		for (int round = 0; round < NUM_ROUNDS; round++)
+			stream();
+
+		const float incrementalCost = bvh.ComputeSAHCost();
+
+		BVH rebuilt;
+		rebuilt.Build(live);
+		const float rebuiltCost = rebuilt.ComputeSAHCost();
+
+		INFO("SAH cost after streaming: ", incrementalCost, ", full rebuild: ", rebuiltCost);
+		CHECK(incrementalCost < 1.5f * rebuiltCost);
+	}
+
+	SUBCASE("Overlap query after streaming")
+	{
+		for (int round = 0; round < NUM_ROUNDS; round++)
+		{
+			stream();
+
+			for (int r = 0; r < NUM_RAYS_PER_ROUND; r++)
+			{
+				const AABB query = randomBox();
+				SmallVector<uint64_t> found;
+				bvh.DoOverlapQuery(query, found);
+
+				SmallVector<uint64_t> expected;
+				for (auto& instance : live)
+				{
+					if (intersectAABBvsAABB(v_AABB(query), v_AABB(instance.AABB)) != COLLISION_TYPE::DISJOINT)
+						expected.push_back(instance.ID);
+				}
+
+				std::sort(found.begin(), found.end());
+				std::sort(expected.begin(), expected.end());
+				CHECK(std::equal(found.begin(), found.end(), expected.begin(), expected.end()));
+			}
+		}
+	}
+}
+
+namespace
+{
+	// mostly small instances along with a few large ones
+	AABB RandomInstanceBox(float worldSize, RNG& rng) noexcept
+	{
+		const float size = rng.GetUniformFloat() < 0.05f ? 20.0f : 2.0f;
+		return AABB(float3(rng.GetUniformFloat() * worldSize - worldSize * 0.5f, rng.GetUniformFloat() * worldSize - worldSize * 0.5f, 
+			rng.GetUniformFloat() * worldSize - worldSize * 0.5f),
+			float3(0.1f + rng.GetUniformFloat() * size, 0.1f + rng.GetUniformFloat() * size, 0.1f + rng.GetUniformFloat() * size));
+	}
+
+	bool Overlaps(const AABB& a, const AABB& b) noexcept
+	{
+		return fabsf(a.Center.x - b.Center.x) <= a.Extents.x + b.Extents.x &&
+			fabsf(a.Center.y - b.Center.y) <= a.Extents.y + b.Extents.y &&
+			fabsf(a.Center.z - b.Center.z) <= a.Extents.z + b.Extents.z;
+	}
+}
+
+TEST_CASE("SpatialHash")
+{
+	RNG rng;
+
+	auto boxDistSq = [](const AABB& box, const float3& p)
+		{
+			const float dx = Max(fabsf(p.x - box.Center.x) - box.Extents.x, 0.0f);
+			const float dy = Max(fabsf(p.y - box.Center.y) - box.Extents.y, 0.0f);
+			const float dz = Max(fabsf(p.z - box.Center.z) - box.Extents.z, 0.0f);
+
+			return dx * dx + dy * dy + dz * dz;
+		};
+
+	SUBCASE("Matches brute force after streaming")
+	{
+		constexpr int NUM_INSTANCES = 2000;
+		constexpr int NUM_ROUNDS = 10;
+		constexpr int NUM_QUERIES_PER_ROUND = 50;
+		constexpr float WORLD_SIZE = 200.0f;
+
+		SmallVector<BVH::BVHInput> live;
+		uint64_t nextID = 0;
+
+		for (int i = 0; i < NUM_INSTANCES; i++)
+			live.push_back(BVH::BVHInput{ .AABB = RandomInstanceBox(WORLD_SIZE, rng), .ID = nextID++ });
+
+		SpatialHash hash;
+		hash.Build(live);
+
+		for (int round = 0; round < NUM_ROUNDS; round++)
+		{
+			// remove, insert and move some of the instances
+			for (int i = 0; i < 100; i++)
+			{
+				const uint32_t idx = rng.GetUniformUintBounded((uint32_t)live.size());
+				hash.Remove(live[idx].ID);
+				live[idx] = live.back();
+				live.pop_back();
+			}
+
+			for (int i = 0; i < 100; i++)
+			{
+				live.push_back(BVH::BVHInput{ .AABB = RandomInstanceBox(WORLD_SIZE, rng), .ID = nextID++ });
+				hash.Insert(live.back());
+			}
+
+			// every instance can appear at most once in the update list
+			SmallVector<BVH::BVHUpdateInput> updates;
+			const uint32_t first = rng.GetUniformUintBounded((uint32_t)live.size());
+
+			for (int i = 0; i < 200; i++)
+			{
+				const uint32_t idx = (first + i) % (uint32_t)live.size();
+				AABB newBox = live[idx].AABB;
+
+				// small moves, moves to a different cell and resizes
+				if (i % 3 == 0)
+					newBox.Center = newBox.Center + float3(0.1f, -0.1f, 0.1f);
+				else if (i % 3 == 1)
+					newBox.Center = RandomInstanceBox(WORLD_SIZE, rng).Center;
+				else
+					newBox = RandomInstanceBox(WORLD_SIZE, rng);
+
+				updates.push_back(BVH::BVHUpdateInput{ .OldBox = live[idx].AABB, .NewBox = newBox, .ID = live[idx].ID });
+				live[idx].AABB = newBox;
+			}
+
+			hash.Update(updates);
+
+			CHECK(hash.GetNumInstances() == live.size());
+
+			// queries don't modify the hash
+			const SpatialHash& constHash = hash;
+
+			for (int q = 0; q < NUM_QUERIES_PER_ROUND; q++)
+			{
+				const AABB query = RandomInstanceBox(WORLD_SIZE, rng);
+				SmallVector<uint64_t> found;
+				constHash.OverlapBox(query, found);
+
+				SmallVector<uint64_t> expected;
+				for (auto& instance : live)
+				{
+					if (Overlaps(query, instance.AABB))
+						expected.push_back(instance.ID);
+				}
+
+				std::sort(found.begin(), found.end());
+				std::sort(expected.begin(), expected.end());
+				CHECK(found.size() == expected.size());
+				CHECK(std::equal(found.begin(), found.end(), expected.begin(), expected.end()));
+
+				const float3 p = query.Center;
+				const float radius = 1.0f + rng.GetUniformFloat() * 20.0f;
+				found.clear();
+				constHash.OverlapSphere(p, radius, found);
+
+				expected.clear();
+				for (auto& instance : live)
+				{
+					if (boxDistSq(instance.AABB, p) <= radius * radius)
+						expected.push_back(instance.ID);
+				}
+
+				std::sort(found.begin(), found.end());
+				std::sort(expected.begin(), expected.end());
+				CHECK(std::equal(found.begin(), found.end(), expected.begin(), expected.end()));
+
+				// distances (rather than IDs) are compared as there could be ties
+				constexpr int K = 8;
+				SmallVector<SpatialHash::Neighbor> nearest;
+				constHash.FindKNearest(p, K, nearest);
+
+				SmallVector<float> expectedDist;
+				for (auto& instance : live)
+					expectedDist.push_back(boxDistSq(instance.AABB, p));
+
+				std::partial_sort(expectedDist.begin(), expectedDist.begin() + K, expectedDist.end());
+				REQUIRE(nearest.size() == K);
+
+				for (int i = 0; i < K; i++)
+					CHECK(fabsf(nearest[i].DistSq - expectedDist[i]) <= 1e-4f * Max(1.0f, expectedDist[i]));
+			}
+		}
+	}
+}
+
+TEST_CASE("SpatialHash benchmark" * doctest::skip())
+{
+	RNG rng;
+
+	constexpr int NUM_INSTANCES = 100000;
+	constexpr int NUM_QUERIES = 2000;
+	constexpr float WORLD_SIZE = 2000.0f;
+
+	SmallVector<BVH::BVHInput> instances;
+	for (int i = 0; i < NUM_INSTANCES; i++)
+		instances.push_back(BVH::BVHInput{ .AABB = RandomInstanceBox(WORLD_SIZE, rng), .ID = (uint64_t)i });
+
+	BVH bvh;
+	bvh.Build(instances);
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	SpatialHash hash;
+	hash.Build(instances);
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	MESSAGE("SpatialHash build (", NUM_INSTANCES, " instances): ",
+		std::chrono::duration<double, std::milli>(t1 - t0).count(), " ms");
+
+	// gameplay-style queries -- radius of a few instances
+	SmallVector<AABB> queries;
+	for (int i = 0; i < NUM_QUERIES; i++)
+	{
+		const float r = 5.0f + rng.GetUniformFloat() * 20.0f;
+		queries.push_back(AABB(RandomInstanceBox(WORLD_SIZE, rng).Center, float3(r, r, r)));
+	}
+
+	SmallVector<uint64_t> found;
+	size_t numBruteForce = 0;
+	size_t numBVH = 0;
+	size_t numHash = 0;
+
+	t0 = std::chrono::high_resolution_clock::now();
+	for (auto& q : queries)
+	{
+		for (auto& instance : instances)
+			numBruteForce += Overlaps(q, instance.AABB);
+	}
+	t1 = std::chrono::high_resolution_clock::now();
+
+	for (auto& q : queries)
+	{
+		found.clear();
+		bvh.DoOverlapQuery(q, found);
+		numBVH += found.size();
+	}
+	auto t2 = std::chrono::high_resolution_clock::now();
+
+	for (auto& q : queries)
+	{
+		found.clear();
+		hash.OverlapBox(q, found);
+		numHash += found.size();
+	}
+	auto t3 = std::chrono::high_resolution_clock::now();
+
+	size_t numNearest = 0;
+	SmallVector<SpatialHash::Neighbor> nearest;
+	for (auto& q : queries)
+	{
+		nearest.clear();
+		hash.FindKNearest(q.Center, 8, nearest);
+		numNearest += nearest.size();
+	}
+	auto t4 = std::chrono::high_resolution_clock::now();
+
+	CHECK(numBVH == numBruteForce);
+	CHECK(numHash == numBruteForce);
+	CHECK(numNearest == 8 * NUM_QUERIES);
+
+	MESSAGE(NUM_QUERIES, " box queries (", numHash, " results) -- brute force: ",
+		std::chrono::duration<double, std::milli>(t1 - t0).count(), " ms, BVH: ",
+		std::chrono::duration<double, std::milli>(t2 - t1).count(), " ms, SpatialHash: ",
+		std::chrono::duration<double, std::milli>(t3 - t2).count(), " ms");
+	MESSAGE(NUM_QUERIES, " 8-nearest queries -- SpatialHash: ",
+		std::chrono::duration<double, std::milli>(t4 - t3).count(), " ms");
+
+	// 1% of the instances move every frame
+	SmallVector<BVH::BVHUpdateInput> updates;
+	for (int i = 0; i < NUM_INSTANCES / 100; i++)
+	{
+		const uint32_t idx = i * 100;
+		AABB newBox = instances[idx].AABB;
+		newBox.Center = newBox.Center + float3(0.5f, 0.0f, 0.5f);
+
+		updates.push_back(BVH::BVHUpdateInput{ .OldBox = instances[idx].AABB, .NewBox = newBox, .ID = instances[idx].ID });
+	}
+
+	t0 = std::chrono::high_resolution_clock::now();
+	bvh.Update(updates);
+	t1 = std::chrono::high_resolution_clock::now();
+	hash.Update(updates);
+	t2 = std::chrono::high_resolution_clock::now();
+
+	MESSAGE("Updating ", updates.size(), " instances -- BVH: ",
+		std::chrono::duration<double, std::milli>(t1 - t0).count(), " ms, SpatialHash: ",
+		std::chrono::duration<double, std::milli>(t2 - t1).count(), " ms");
+}
+
+TEST_CASE("OcclusionBuffer")
+{
+	constexpr int WIDTH = 256;
+	constexpr int HEIGHT = 144;
+	constexpr float NEAR_Z = 0.1f;
+
+	const float4x3 identity(float3(1, 0, 0), float3(0, 1, 0), float3(0, 0, 1), float3(0, 0, 0));
+
+	auto viewProj = [](float4a camPos, float4a focus)
+		{
+			float4a up(0.0f, 1.0f, 0.0f, 0.0f);
+			const v_float4x4 vView = lookAtLH(camPos, focus, up);
+			const v_float4x4 vProj = perspectiveReverseZ((float)WIDTH / HEIGHT, Math::DegreeToRadians(60.0f), NEAR_Z);
+
+			return store(mul(vView, vProj));
+		};
+
+	// triangle list for the 6 faces of given box
+	auto boxTriangles = [](const AABB& box, SmallVector<float3>& vertices)
+		{
+			const float3 lo = box.Center - box.Extents;
+			const float3 hi = box.Center + box.Extents;
+			float3 corners[8];
+
+			for (int i = 0; i < 8; i++)
+				corners[i] = float3(i & 0x1 ? hi.x : lo.x, i & 0x2 ? hi.y : lo.y, i & 0x4 ? hi.z : lo.z);
+
+			const int faces[6][4] = { {0, 1, 3, 2}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 3, 7, 6}, {0, 2, 6, 4}, {1, 3, 7, 5} };
+
+			for (auto& f : faces)
+			{
+				for (int v : { f[0], f[1], f[2], f[0], f[2], f[3] })
+					vertices.push_back(corners[v]);
+			}
+		};
+
+	OcclusionBuffer buffer;
+	buffer.Init(WIDTH, HEIGHT);
+
+	SUBCASE("Wall")
+	{
+		buffer.BeginFrame(viewProj(float4a(0.0f, 0.0f, 0.0f, 1.0f), float4a(0.0f, 0.0f, 1.0f, 1.0f)), NEAR_Z);
+
+		// 10x10 wall at z = 10
+		float3 wall[6] = { float3(-5, -5, 10), float3(5, -5, 10), float3(5, 5, 10), 
+			float3(-5, -5, 10), float3(5, 5, 10), float3(-5, 5, 10) };
+		buffer.RasterizeOccluder(Span(wall), identity);
+
+		CHECK(buffer.IsOccluded(AABB(float3(0, 0, 20), float3(1, 1, 1))));
+		CHECK(buffer.IsOccluded(AABB(float3(8, 8, 40), float3(1, 1, 1))));
+		// in front of the wall
+		CHECK(!buffer.IsOccluded(AABB(float3(0, 0, 5), float3(1, 1, 1))));
+		// intersects the wall
+		CHECK(!buffer.IsOccluded(AABB(float3(0, 0, 10), float3(1, 1, 1))));
+		// wider than the wall's "shadow"
+		CHECK(!buffer.IsOccluded(AABB(float3(0, 0, 20), float3(12, 1, 1))));
+		// crosses the near plane
+		CHECK(!buffer.IsOccluded(AABB(float3(0, 0, 0), float3(1, 1, 1))));
+		// outside the screen
+		CHECK(!buffer.IsOccluded(AABB(float3(0, 0, -20), float3(1, 1, 1))));
+	}
+
+	SUBCASE("City")
+	{
+		RNG rng;
+		constexpr int GRID_SIZE = 32;
+		constexpr float BLOCK_SIZE = 20.0f;
+		constexpr int NUM_OCCLUDERS = 32;
+		constexpr int NUM_PROPS = 4096;
+
+		// grid of buildings separated by streets
+		SmallVector<AABB> buildings;
+
+		for (int i = 0; i < GRID_SIZE; i++)
+		{
+			for (int j = 0; j < GRID_SIZE; j++)
+			{
+				const float height = 10.0f + rng.GetUniformFloat() * 40.0f;
+				buildings.push_back(AABB(float3(i * BLOCK_SIZE, height * 0.5f, j * BLOCK_SIZE), 
+					float3(0.35f * BLOCK_SIZE, height * 0.5f, 0.35f * BLOCK_SIZE)));
+			}
+		}
+
+		// small objects scattered around the streets and on the rooftops
+		SmallVector<AABB> props;
+
+		for (int i = 0; i < NUM_PROPS; i++)
+		{
+			props.push_back(AABB(float3(rng.GetUniformFloat() * GRID_SIZE * BLOCK_SIZE, rng.GetUniformFloat() * 50.0f, 
+				rng.GetUniformFloat() * GRID_SIZE * BLOCK_SIZE), float3(1.0f, 1.0f, 1.0f)));
+		}
+
+		// street-level camera
+		const float4a camPos(0.5f * BLOCK_SIZE, 2.0f, 0.5f * BLOCK_SIZE, 1.0f);
+		const float4a focus(GRID_SIZE * BLOCK_SIZE, 2.0f, GRID_SIZE * BLOCK_SIZE * 0.7f, 1.0f);
+		buffer.BeginFrame(viewProj(camPos, focus), NEAR_Z);
+
+		// buildings closest to the camera are the best occluders
+		SmallVector<AABB> occluders;
+		occluders.append_range(buildings.begin(), buildings.end());
+		float3 eye(camPos.x, camPos.y, camPos.z);
+
+		std::sort(occluders.begin(), occluders.end(), [&eye](const AABB& lhs, const AABB& rhs)
+			{
+				return (lhs.Center - eye).length() < (rhs.Center - eye).length();
+			});
+
+		occluders.resize(NUM_OCCLUDERS);
+
+		SmallVector<float3> vertices;
+		for (auto& box : occluders)
+			boxTriangles(box, vertices);
+
+		buffer.RasterizeOccluder(vertices, identity);
+
+		int numOccluded = 0;
+		SmallVector<AABB> occludees;
+		occludees.append_range(buildings.begin(), buildings.end());
+		occludees.append_range(props.begin(), props.end());
+		SmallVector<bool> occluded;
+		occluded.resize(occludees.size());
+
+		for (size_t i = 0; i < occludees.size(); i++)
+		{
+			occluded[i] = buffer.IsOccluded(occludees[i]);
+			numOccluded += occluded[i];
+		}
+
+		INFO(numOccluded, "/", occludees.size(), " occluded");
+		CHECK(numOccluded > 0);
+
+		// sample points of every occluded box must be hidden behind one of the occluders
+
+		for (size_t i = 0; i < occludees.size(); i++)
+		{
+			if (!occluded[i])
+				continue;
+
+			const float3 lo = occludees[i].Center - occludees[i].Extents * 0.99f;
+			const float3 hi = occludees[i].Center + occludees[i].Extents * 0.99f;
+
+			for (int c = 0; c < 9; c++)
+			{
+				float3 target = c == 8 ? occludees[i].Center : 
+					float3(c & 0x1 ? hi.x : lo.x, c & 0x2 ? hi.y : lo.y, c & 0x4 ? hi.z : lo.z);
+
+				float3 dir = target - eye;
+				v_Ray vRay(eye, dir);
+				bool hidden = false;
+
+				for (auto& box : occluders)
+				{
+					float t;
+					hidden = hidden || (intersectRayVsAABB(vRay, v_AABB(box), t) && t < 1.0f);
+				}
+
+				CHECK(hidden);
+			}
+		}
+	}
+}
+
+TEST_CASE_TEMPLATE_DEFINE("SimdBatch", V, SimdBatch)
+{
+	constexpr int W = V::Width;
+	RNG rng;
+
+	SUBCASE("Arithmetic")
+	{
+		alignas(32) float a[W];
+		alignas(32) float b[W];
+
+		for (int i = 0; i < W; i++)
+		{
+			a[i] = -10.0f + rng.GetUniformFloat() * 20.0f;
+			b[i] = -10.0f + rng.GetUniformFloat() * 20.0f;
+		}
+
+		// make sure both outcomes of the comparisons are exercised
+		b[0] = a[0];
+
+		const V vA = V::load(a);
+		const V vB = V::load(b);
+
+		alignas(32) float sum[W];
+		alignas(32) float prod[W];
+		alignas(32) float fma[W];
+		alignas(32) float mn[W];
+		alignas(32) float mx[W];
+		alignas(32) float absSqrt[W];
+		alignas(32) float sel[W];
+		(vA + vB).store(sum);
+		(vA * vB).store(prod);
+		fmadd(vA, vB, -vA).store(fma);
+		Min(vA, vB).store(mn);
+		Max(vA, vB).store(mx);
+		sqrt(abs(vA)).store(absSqrt);
+		select(vA < vB, vA, vB - vA).store(sel);
+
+		const uint32_t lt = movemask(vA < vB);
+		const uint32_t le = movemask(vA <= vB);
+		const uint32_t gtOrEq = movemask((vA > vB) | (vA >= vB));
+
+		for (int i = 0; i < W; i++)
+		{
+			INFO("Lane: ", i, ", a: ", a[i], ", b: ", b[i]);
+			CHECK(sum[i] == a[i] + b[i]);
+			CHECK(prod[i] == a[i] * b[i]);
+			CHECK(fabsf(fma[i] - (a[i] * b[i] - a[i])) <= 1e-4f);
+			CHECK(mn[i] == std::min(a[i], b[i]));
+			CHECK(mx[i] == std::max(a[i], b[i]));
+			CHECK(fabsf(absSqrt[i] - sqrtf(fabsf(a[i]))) <= 1e-6f);
+			CHECK(sel[i] == (a[i] < b[i] ? a[i] : b[i] - a[i]));
+			CHECK(((lt >> i) & 0x1) == uint32_t(a[i] < b[i]));
+			CHECK(((le >> i) & 0x1) == uint32_t(a[i] <= b[i]));
+			CHECK(((gtOrEq >> i) & 0x1) == uint32_t(a[i] >= b[i]));
+		}
+	}
+
+	SUBCASE("Transform")
+	{
+		for (int iter = 0; iter < 100; iter++)
+		{
+			float4x3 M(float3(rng.GetUniformFloat(), rng.GetUniformFloat(), rng.GetUniformFloat()),
+				float3(rng.GetUniformFloat(), rng.GetUniformFloat(), rng.GetUniformFloat()),
+				float3(rng.GetUniformFloat(), rng.GetUniformFloat(), rng.GetUniformFloat()),
+				float3(rng.GetUniformFloat() * 100.0f, rng.GetUniformFloat() * 100.0f, rng.GetUniformFloat() * 100.0f));
+			const v_float4x4 vM = load(M);
+
+			AABB boxes[W];
+			for (int i = 0; i < W; i++)
+			{
+				boxes[i].Center = float3(-50.0f + rng.GetUniformFloat() * 100.0f,
+					-50.0f + rng.GetUniformFloat() * 100.0f,
+					-50.0f + rng.GetUniformFloat() * 100.0f);
+				boxes[i].Extents = float3(rng.GetUniformFloat() * 10.0f, rng.GetUniformFloat() * 10.0f, rng.GetUniformFloat() * 10.0f);
+			}
+
+			// leave the last lane unused
+			const soa_AABB<V> vBoxes = loadAABBs<V>(boxes, W - 1);
+			AABB transformed[W];
+			transformed[W - 1] = boxes[W - 1];
+			storeAABBs(transform(soa_float4x3<V>(M), vBoxes), transformed, W - 1);
+
+			for (int i = 0; i < W - 1; i++)
+			{
+				const v_AABB vExpected = transform(vM, v_AABB(boxes[i].Center, boxes[i].Extents));
+				const AABB expected = store(vExpected);
+
+				INFO("Lane: ", i);
+				CHECK(fabsf(expected.Center.x - transformed[i].Center.x) <= 1e-4f);
+				CHECK(fabsf(expected.Center.y - transformed[i].Center.y) <= 1e-4f);
+				CHECK(fabsf(expected.Center.z - transformed[i].Center.z) <= 1e-4f);
+				CHECK(fabsf(expected.Extents.x - transformed[i].Extents.x) <= 1e-4f);
+				CHECK(fabsf(expected.Extents.y - transformed[i].Extents.y) <= 1e-4f);
+				CHECK(fabsf(expected.Extents.z - transformed[i].Extents.z) <= 1e-4f);
+			}
+
+			CHECK(transformed[W - 1].Center.x == boxes[W - 1].Center.x);
+		}
+	}
+
+	SUBCASE("Frustum")
+	{
+		ViewFrustum frustum(PI_OVER_4, 1920.0f / 1080.0f, 1.0f, 1000.0f);
+		v_ViewFrustum vFrustum(frustum);
+
+		for (int iter = 0; iter < 2000; iter++)
+		{
+			AABB boxes[W];
+			for (int i = 0; i < W; i++)
+			{
+				boxes[i].Center = float3(-1000.0f + rng.GetUniformFloat() * 1000.0f,
+					-1000.0f + rng.GetUniformFloat() * 1000.0f,
+					-1000.0f + rng.GetUniformFloat() * 1000.0f);
+				boxes[i].Extents = float3(0.1f + rng.GetUniformFloat() * 1000.0f,
+					0.1f + rng.GetUniformFloat() * 1000.0f,
+					0.1f + rng.GetUniformFloat() * 1000.0f);
+			}
+
+			const uint32_t result = instersectFrustumVsAABB(frustum, loadAABBs<V>(boxes, W));
+
+			for (int i = 0; i < W; i++)
+			{
+				const bool expected = instersectFrustumVsAABB(vFrustum, v_AABB(boxes[i].Center, boxes[i].Extents)) != COLLISION_TYPE::DISJOINT;
+				CHECK(((result >> i) & 0x1) == uint32_t(expected));
+			}
+		}
+	}
+}
+
+TEST_CASE_TEMPLATE_INVOKE(SimdBatch, SimdBackend::Scalar::simd<float, 8>, SimdBackend::Scalar::simd<float, 4>);
+#if defined(ZETA_SIMD_SSE4)
+TEST_CASE_TEMPLATE_INVOKE(SimdBatch, SimdBackend::SSE4::simd<float, 8>, SimdBackend::SSE4::simd<float, 4>);
+#endif
+#if defined(ZETA_SIMD_AVX2)
+TEST_CASE_TEMPLATE_INVOKE(SimdBatch, SimdBackend::AVX2::simd<float, 8>);
+#endif
+
 /*
 TEST_CASE("PlaneTransformation")
 {
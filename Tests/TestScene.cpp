@@ -0,0 +1,4443 @@
+#include <Scene/Animation.h>
+#include <Scene/SceneGraph.h>
+#include <Scene/Skinning.h>
+#include <Scene/Asset.h>
+#include <Scene/SceneCore.h>
+#include <Model/SceneCache.h>
+#include <Model/AccessorDecoder.h>
+#include <Model/MeshOptimizer.h>
+#include <Model/Meshlet.h>
+#include <Model/MeshSimplifier.h>
+#include <Model/VertexCompression.h>
+#include <Model/Mesh.h>
+#include <Support/StreamingQueue.h>
+#include <Math/MatrixFuncs.h>
+#include <Math/CollisionTypes.h>
+#include <Math/Quaternion.h>
+#include <Math/Surface.h>
+#include <Utility/RNG.h>
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <array>
+#include <thread>
+#include <vector>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Support;
+using namespace ZetaRay::Scene;
+
+namespace
+{
+	AffineTransformation RandomTransform(RNG& rng) noexcept
+	{
+		AffineTransformation tr;
+		const float s = 0.5f + rng.GetUniformFloat();
+		tr.Scale = float3(s, s, s);
+		float3 axis(rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f);
+		axis.normalize();
+		tr.Rotation = storeFloat4(rotationQuat(axis, rng.GetUniformFloat() * TWO_PI));
+		tr.Translation = float3(rng.GetUniformFloat() * 10.0f, rng.GetUniformFloat() * 10.0f, rng.GetUniformFloat() * 10.0f);
+
+		return tr;
+	}
+
+	// Builds a scene graph where every node at level i has childrenPerNode[i] children
+	void BuildSceneGraph(MemoryPool& mp, SmallVector<TreeLevel, PoolAllocator>& levels, Span<int> childrenPerNode, RNG& rng) noexcept
+	{
+		levels.emplace_back(mp);
+		levels[0].m_IDs.push_back(0);
+		levels[0].m_localTransforms.push_back(AffineTransformation::GetIdentity());
+		levels[0].m_toWorlds.push_back(float4x3(store(identity())));
+		levels[0].m_prevToWorlds.push_back(levels[0].m_toWorlds[0]);
+		levels[0].m_meshIDs.push_back(0);
+		levels[0].m_rtFlags.push_back(0);
+		uint64_t nextID = 1;
+
+		for (int l = 0; l < (int)childrenPerNode.size(); l++)
+		{
+			levels.emplace_back(mp);
+			TreeLevel& parentLevel = levels[l];
+			TreeLevel& currLevel = levels[l + 1];
+			const int numParents = (int)parentLevel.m_IDs.size();
+
+			parentLevel.m_subtreeRanges.resize(numParents);
+			currLevel.m_IDs.reserve(numParents * childrenPerNode[l]);
+			currLevel.m_localTransforms.reserve(numParents * childrenPerNode[l]);
+			currLevel.m_toWorlds.reserve(numParents * childrenPerNode[l]);
+			currLevel.m_prevToWorlds.reserve(numParents * childrenPerNode[l]);
+
+			for (int p = 0; p < numParents; p++)
+			{
+				parentLevel.m_subtreeRanges[p] = Range((int)currLevel.m_IDs.size(), childrenPerNode[l]);
+				const v_float4x4 vParentW = load(parentLevel.m_toWorlds[p]);
+
+				for (int c = 0; c < childrenPerNode[l]; c++)
+				{
+					AffineTransformation tr = RandomTransform(rng);
+					const v_float4x4 vW = mul(affineTransformation(tr.Scale, tr.Rotation, tr.Translation), vParentW);
+
+					currLevel.m_IDs.push_back(nextID++);
+					currLevel.m_localTransforms.push_back(tr);
+					currLevel.m_toWorlds.push_back(float4x3(store(vW)));
+					currLevel.m_prevToWorlds.push_back(float4x3(store(vW)));
+					currLevel.m_meshIDs.push_back(0);
+					currLevel.m_rtFlags.push_back(0);
+				}
+			}
+		}
+
+		TreeLevel& leaves = levels.back();
+		leaves.m_subtreeRanges.resize(leaves.m_IDs.size());
+		for (int i = 0; i < (int)leaves.m_IDs.size(); i++)
+			leaves.m_subtreeRanges[i] = Range((int)leaves.m_IDs.size(), 0);
+	}
+
+	// Recomputes the world transformation of every node (the brute-force approach)
+	void UpdateAll(Span<TreeLevel> levels) noexcept
+	{
+		for (int level = 0; level < (int)levels.size() - 1; level++)
+		{
+			for (int i = 0; i < (int)levels[level].m_subtreeRanges.size(); i++)
+			{
+				const v_float4x4 vParentW = load(levels[level].m_toWorlds[i]);
+				const Range& range = levels[level].m_subtreeRanges[i];
+
+				for (int j = range.Base; j < range.Base + range.Count; j++)
+				{
+					AffineTransformation& tr = levels[level + 1].m_localTransforms[j];
+					const v_float4x4 vLocal = affineTransformation(tr.Scale, tr.Rotation, tr.Translation);
+					levels[level + 1].m_toWorlds[j] = float4x3(store(mul(vLocal, vParentW)));
+				}
+			}
+		}
+	}
+
+	// Results of the SIMD path can differ in the last few bits from MatrixFuncs
+	bool ApproxEqual(const float4x3& a, const float4x3& b) noexcept
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			const float3 d = a.m[i] - b.m[i];
+			const float tol = 1e-5f * Max(1.0f, Max(fabsf(a.m[i].x), Max(fabsf(a.m[i].y), fabsf(a.m[i].z))));
+
+			if (fabsf(d.x) > tol || fabsf(d.y) > tol || fabsf(d.z) > tol)
+				return false;
+		}
+
+		return true;
+	}
+
+	// Executor that runs every job on its own thread (first one on the calling thread)
+	struct ThreadExecutor
+	{
+		explicit ThreadExecutor(int maxNumJobs)
+			: m_maxNumJobs(maxNumJobs)
+		{}
+
+		int MaxNumJobs() const { return m_maxNumJobs; }
+
+		template<typename Job>
+		void For(int numJobs, Job&& job) const
+		{
+			std::vector<std::thread> threads;
+			threads.reserve(Max(numJobs - 1, 0));
+
+			for (int i = 1; i < numJobs; i++)
+				threads.emplace_back([&job, i]() { job(i); });
+
+			if (numJobs > 0)
+				job(0);
+
+			for (auto& t : threads)
+				t.join();
+		}
+
+		template<typename Prepare, typename Job>
+		void Stages(int numStages, Prepare&& prepare, Job&& job) const
+		{
+			for (int s = 0; s < numStages; s++)
+			{
+				const int numJobs = prepare(s);
+				REQUIRE(numJobs <= m_maxNumJobs);
+
+				For(numJobs, [&job, s](int i) { job(s, i); });
+			}
+		}
+
+	private:
+		int m_maxNumJobs;
+	};
+
+	// Random animations with 2 to maxNumKeyframes keyframes each
+	void RandomAnimations(int numAnimations, int maxNumKeyframes, SmallVector<Keyframe>& keyframes,
+		SmallVector<AnimationOffset>& animations, RNG& rng) noexcept
+	{
+		for (int i = 0; i < numAnimations; i++)
+		{
+			const int n = 2 + (int)rng.GetUniformUintBounded(maxNumKeyframes - 1);
+			const int beg = (int)keyframes.size();
+			float t = rng.GetUniformFloat();
+
+			for (int k = 0; k < n; k++)
+			{
+				keyframes.push_back(Keyframe{ .Transform = RandomTransform(rng), .Time = t });
+				t += 0.05f + rng.GetUniformFloat();
+			}
+
+			animations.emplace_back(beg, beg + n, rng.GetUniformFloat() * 2.0f);
+		}
+	}
+
+	// Samples one animation at a time with a binary search and the scalar slerp() 
+	AffineTransformation SampleReference(Span<Keyframe> keyframes, const AnimationOffset& anim, float t) noexcept
+	{
+		const Keyframe* beg = keyframes.data() + anim.BegOffset;
+		const Keyframe* end = keyframes.data() + anim.EndOffset;
+		const float localT = t - anim.BegTimeOffset;
+
+		if (localT <= beg->Time)
+			return beg->Transform;
+		if (localT >= (end - 1)->Time)
+			return (end - 1)->Transform;
+
+		auto k2 = std::upper_bound(beg, end, localT, [](float f, const Keyframe& k)
+			{
+				return f < k.Time;
+			});
+		auto k1 = k2 - 1;
+
+		const float interpolatedT = (localT - k1->Time) / (k2->Time - k1->Time);
+		AffineTransformation k1Tr = k1->Transform;
+		AffineTransformation k2Tr = k2->Transform;
+
+		AffineTransformation ret;
+		ret.Scale = storeFloat3(lerp(loadFloat3(k1Tr.Scale), loadFloat3(k2Tr.Scale), interpolatedT));
+		ret.Rotation = storeFloat4(slerp(loadFloat4(k1Tr.Rotation), loadFloat4(k2Tr.Rotation), interpolatedT));
+		ret.Translation = storeFloat3(lerp(loadFloat3(k1Tr.Translation), loadFloat3(k2Tr.Translation), interpolatedT));
+
+		return ret;
+	}
+
+	// Polynomial approximations of acos() and sin() differ slightly between the two paths
+	bool ApproxEqual(const AffineTransformation& a, const AffineTransformation& b) noexcept
+	{
+		const float4 dr = a.Rotation - b.Rotation;
+		const float3 ds = a.Scale - b.Scale;
+		const float3 dt = a.Translation - b.Translation;
+
+		return fabsf(dr.x) < 1e-3f && fabsf(dr.y) < 1e-3f && fabsf(dr.z) < 1e-3f && fabsf(dr.w) < 1e-3f &&
+			fabsf(ds.x) < 1e-4f && fabsf(ds.y) < 1e-4f && fabsf(ds.z) < 1e-4f &&
+			fabsf(dt.x) < 1e-3f && fabsf(dt.y) < 1e-3f && fabsf(dt.z) < 1e-3f;
+	}
+
+	// Similar to what exporters write to glTF -- curves are sampled at 30 fps. Tracks are either smooth
+	// curves, linearly interpolated between a few keys set by hand, or don't change.
+	void BakedAnimations(int numAnimations, SmallVector<Keyframe>& keyframes, SmallVector<AnimationOffset>& animations,
+		RNG& rng) noexcept
+	{
+		constexpr float FPS = 30.0f;
+		constexpr int NUM_HAND_KEYS = 6;
+
+		for (int i = 0; i < numAnimations; i++)
+		{
+			const int n = (int)(FPS * (1.0f + rng.GetUniformFloat() * 4.0f));
+			const float duration = (n - 1) / FPS;
+			const int beg = (int)keyframes.size();
+			const bool animatedScale = rng.GetUniformFloat() < 0.2f;
+			const bool animatedTranslation = rng.GetUniformFloat() < 0.8f;
+			const bool handKeyedTranslation = rng.GetUniformFloat() < 0.5f;
+			const bool handKeyedRotation = rng.GetUniformFloat() < 0.5f;
+
+			const float w = 1.0f + rng.GetUniformFloat() * 4.0f;
+			const float phase = rng.GetUniformFloat() * TWO_PI;
+			const float3 amplitude(rng.GetUniformFloat() * 2.0f, rng.GetUniformFloat() * 2.0f, rng.GetUniformFloat() * 2.0f);
+			const float3 velocity(rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f);
+			const AffineTransformation base = RandomTransform(rng);
+			float3 axis(rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f);
+			axis.normalize();
+
+			AffineTransformation handKeys[NUM_HAND_KEYS];
+			for (int k = 0; k < NUM_HAND_KEYS; k++)
+				handKeys[k] = RandomTransform(rng);
+
+			for (int k = 0; k < n; k++)
+			{
+				const float t = k / FPS;
+				const float s = sinf(w * t + phase);
+
+				// hand keys are evenly spaced
+				const float u = t / duration * (NUM_HAND_KEYS - 1);
+				const int k1 = Min((int)u, NUM_HAND_KEYS - 2);
+				const float alpha = u - k1;
+
+				Keyframe key{ .Transform = base, .Time = t };
+
+				if (handKeyedRotation)
+				{
+					key.Transform.Rotation = storeFloat4(slerp(loadFloat4(handKeys[k1].Rotation), 
+						loadFloat4(handKeys[k1 + 1].Rotation), alpha));
+				}
+				else
+					key.Transform.Rotation = storeFloat4(rotationQuat(axis, phase + PI * s));
+
+				if (animatedScale)
+					key.Transform.Scale = base.Scale * (1.0f + 0.25f * s);
+
+				if (animatedTranslation)
+				{
+					key.Transform.Translation = handKeyedTranslation ? 
+						handKeys[k1].Translation + (handKeys[k1 + 1].Translation - handKeys[k1].Translation) * alpha :
+						base.Translation + amplitude * s + velocity * t;
+				}
+
+				keyframes.push_back(key);
+			}
+
+			animations.emplace_back(beg, beg + n, rng.GetUniformFloat() * 2.0f);
+		}
+	}
+
+	// Maximum difference of scale and translation components and the angle between rotations
+	void TransformError(const AffineTransformation& a, const AffineTransformation& b, float& maxDiff, float& angle) noexcept
+	{
+		const float3 ds = a.Scale - b.Scale;
+		const float3 dt = a.Translation - b.Translation;
+		maxDiff = Max(Max(Max(fabsf(ds.x), fabsf(ds.y)), fabsf(ds.z)), Max(Max(fabsf(dt.x), fabsf(dt.y)), fabsf(dt.z)));
+
+		// reference slerp() doesn't return exactly unit quaternions. Also acos() is too imprecise for
+		// small angles, so use the chord length.
+		float4 q1 = a.Rotation;
+		float4 q2 = b.Rotation;
+		q1.normalize();
+		q2.normalize();
+		float4 dq = q1.dot(q2) >= 0.0f ? q1 - q2 : q1 + q2;
+		angle = 4.0f * asinf(Min(0.5f * dq.length(), 1.0f));
+	}
+
+	constexpr uint64_t ROOT_ID = uint64_t(-1);
+
+	// Same as SceneCore::Init()
+	void InitSceneGraph(MemoryPool& mp, SmallVector<TreeLevel, PoolAllocator>& levels) noexcept
+	{
+		levels.emplace_back(mp);
+		levels.emplace_back(mp);
+
+		levels[0].m_toWorlds.push_back(float4x3(store(identity())));
+		levels[0].m_prevToWorlds.push_back(levels[0].m_toWorlds[0]);
+		levels[0].m_subtreeRanges.push_back(Range(0, 0));
+	}
+
+	// Parents always come before their children
+	void RandomNodes(int n, uint64_t firstID, Span<NewNode> existing, SmallVector<NewNode>& nodes, RNG& rng) noexcept
+	{
+		nodes.reserve(nodes.size() + n);
+		const size_t numExisting = existing.size();
+
+		for (int i = 0; i < n; i++)
+		{
+			const size_t numCandidates = numExisting + nodes.size();
+			uint64_t parentID = ROOT_ID;
+
+			if (numCandidates && rng.GetUniformFloat() < 0.9f)
+			{
+				const size_t p = rng.GetUniformUintBounded((uint32_t)numCandidates);
+				parentID = p < numExisting ? existing[p].ID : nodes[p - numExisting].ID;
+			}
+
+			nodes.push_back(NewNode{
+				.LocalTransform = RandomTransform(rng),
+				.ID = firstID + i,
+				.ParentID = parentID,
+				.MeshID = firstID + i,
+				.RtFlags = uint8_t(i & 0xff) });
+		}
+	}
+
+	// Inserts the node by shifting everything after it to the right (how SceneCore used to add 
+	// instances one at a time, except for the subtree range of the new node)
+	void InsertOneAtATime(SmallVector<TreeLevel, PoolAllocator>& levels, MemoryPool& mp, const NewNode& node, 
+		HashTable<TreePos>& idToTreePos) noexcept
+	{
+		TreePos parent{ .Level = 0, .Offset = 0 };
+		if (node.ParentID != ROOT_ID)
+			parent = *idToTreePos.find(node.ParentID);
+
+		const int level = parent.Level + 1;
+		while ((int)levels.size() <= level)
+			levels.emplace_back(mp);
+
+		TreeLevel& parentLevel = levels[level - 1];
+		TreeLevel& currLevel = levels[level];
+		Range& parentRange = parentLevel.m_subtreeRanges[parent.Offset];
+		const int insertIdx = parentRange.Base + parentRange.Count;
+		parentRange.Count++;
+
+		auto rearrange = [insertIdx](auto& vec, auto val)
+			{
+				vec.push_back(val);
+
+				for (int i = (int)vec.size() - 1; i != insertIdx; --i)
+					std::swap(vec[i], vec[i - 1]);
+			};
+
+		AffineTransformation tr = node.LocalTransform;
+		const v_float4x4 vLocal = affineTransformation(tr.Scale, tr.Rotation, tr.Translation);
+		// (empty) children of the new node start where the children of its left neighbor end
+		const int newBase = insertIdx == 0 ? 0 : currLevel.m_subtreeRanges[insertIdx - 1].Base + currLevel.m_subtreeRanges[insertIdx - 1].Count;
+
+		rearrange(currLevel.m_IDs, node.ID);
+		rearrange(currLevel.m_localTransforms, node.LocalTransform);
+		rearrange(currLevel.m_toWorlds, float4x3(store(mul(vLocal, load(parentLevel.m_toWorlds[parent.Offset])))));
+		rearrange(currLevel.m_prevToWorlds, currLevel.m_toWorlds[insertIdx]);
+		rearrange(currLevel.m_meshIDs, node.MeshID);
+		rearrange(currLevel.m_subtreeRanges, Range(newBase, 0));
+		rearrange(currLevel.m_rtFlags, node.RtFlags);
+
+		for (int i = parent.Offset + 1; i < (int)parentLevel.m_subtreeRanges.size(); i++)
+			parentLevel.m_subtreeRanges[i].Base++;
+
+		idToTreePos.insert_or_assign(node.ID, TreePos{ .Level = level, .Offset = insertIdx });
+
+		for (int i = insertIdx + 1; i < (int)currLevel.m_IDs.size(); i++)
+			idToTreePos.find(currLevel.m_IDs[i])->Offset++;
+	}
+
+	// Compares every level except for level 0
+	int CountMismatches(Span<TreeLevel> levels, Span<TreeLevel> reference) noexcept
+	{
+		int numMismatches = 0;
+
+		for (int l = 1; l < (int)Min(levels.size(), reference.size()); l++)
+		{
+			TreeLevel& b = levels[l];
+			TreeLevel& r = reference[l];
+			numMismatches += b.m_IDs.size() != r.m_IDs.size();
+
+			for (int j = 0; j < (int)Min(b.m_IDs.size(), r.m_IDs.size()); j++)
+			{
+				numMismatches += b.m_IDs[j] != r.m_IDs[j];
+				numMismatches += b.m_meshIDs[j] != r.m_meshIDs[j];
+				numMismatches += b.m_rtFlags[j] != r.m_rtFlags[j];
+				numMismatches += memcmp(&b.m_localTransforms[j], &r.m_localTransforms[j], sizeof(AffineTransformation)) != 0;
+				numMismatches += memcmp(&b.m_toWorlds[j], &r.m_toWorlds[j], sizeof(float4x3)) != 0;
+				numMismatches += memcmp(&b.m_prevToWorlds[j], &r.m_prevToWorlds[j], sizeof(float4x3)) != 0;
+				numMismatches += b.m_subtreeRanges[j].Count != r.m_subtreeRanges[j].Count;
+
+				// base offset of empty ranges doesn't matter as long as they remain sorted
+				if (r.m_subtreeRanges[j].Count)
+					numMismatches += b.m_subtreeRanges[j].Base != r.m_subtreeRanges[j].Base;
+			}
+		}
+
+		return numMismatches;
+	}
+
+	// Subtree ranges have to be sorted, which is required for finding the parent of a node
+	int CountUnsortedRanges(Span<TreeLevel> levels) noexcept
+	{
+		int numUnsorted = 0;
+
+		for (auto& level : levels)
+		{
+			for (size_t j = 1; j < level.m_subtreeRanges.size(); j++)
+				numUnsorted += level.m_subtreeRanges[j].Base != level.m_subtreeRanges[j - 1].Base + level.m_subtreeRanges[j - 1].Count;
+		}
+
+		return numUnsorted;
+	}
+
+	// Returns the number of nodes in the subtree rooted at given node (including itself)
+	int SubtreeSize(Span<TreeLevel> levels, int level, int offset) noexcept
+	{
+		int ret = 1;
+		const Range& r = levels[level].m_subtreeRanges[offset];
+
+		for (int j = r.Base; j < r.Base + r.Count; j++)
+			ret += SubtreeSize(levels, level + 1, j);
+
+		return ret;
+	}
+
+	// Skeleton with random (rigid) bind pose, parent of every joint is one of the joints before it
+	void RandomSkeleton(int numJoints, Skeleton& skeleton, SmallVector<AffineTransformation>& bindPose, RNG& rng) noexcept
+	{
+		skeleton.Parents.resize(numJoints);
+		skeleton.InverseBindMatrices.resize(numJoints);
+		bindPose.resize(numJoints);
+		SmallVector<float4x3> globals;
+		globals.resize(numJoints);
+
+		for (int i = 0; i < numJoints; i++)
+		{
+			AffineTransformation& tr = bindPose[i];
+			tr = RandomTransform(rng);
+			tr.Scale = float3(1.0f, 1.0f, 1.0f);
+			tr.Translation = float3(rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f);
+
+			skeleton.Parents[i] = i == 0 ? -1 : (int)rng.GetUniformUintBounded(i);
+			v_float4x4 vM = affineTransformation(tr.Scale, tr.Rotation, tr.Translation);
+			if (i > 0)
+				vM = mul(vM, load(globals[skeleton.Parents[i]]));
+
+			globals[i] = float4x3(store(vM));
+			skeleton.InverseBindMatrices[i] = float4x3(store(inverseSRT(vM)));
+		}
+	}
+
+	// Vertices with one to four influences each
+	void RandomSkinnedMesh(int numVertices, int numJoints, SmallVector<Core::Vertex>& vertices, 
+		SmallVector<SkinInfluence>& influences, RNG& rng) noexcept
+	{
+		vertices.resize(numVertices);
+		influences.resize(numVertices);
+
+		auto randomDir = [&rng]()
+			{
+				float3 d(rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f, rng.GetUniformFloat() - 0.5f);
+				d.normalize();
+				return d;
+			};
+
+		for (int i = 0; i < numVertices; i++)
+		{
+			Core::Vertex& v = vertices[i];
+			v.Position = float3(rng.GetUniformFloat() * 2.0f - 1.0f, rng.GetUniformFloat() * 2.0f - 1.0f, 
+				rng.GetUniformFloat() * 2.0f - 1.0f);
+			v.Normal = half3(randomDir());
+			v.Tangent = half3(randomDir());
+			v.TexUV = float2(rng.GetUniformFloat(), rng.GetUniformFloat());
+
+			SkinInfluence& s = influences[i];
+			const int n = 1 + (int)rng.GetUniformUintBounded(SkinInfluence::MAX_NUM_INFLUENCES);
+			float sum = 0.0f;
+
+			for (int k = 0; k < SkinInfluence::MAX_NUM_INFLUENCES; k++)
+			{
+				s.Joints[k] = (uint16_t)rng.GetUniformUintBounded(numJoints);
+				s.Weights[k] = k < n ? 0.05f + rng.GetUniformFloat() : 0.0f;
+				sum += s.Weights[k];
+			}
+
+			for (int k = 0; k < SkinInfluence::MAX_NUM_INFLUENCES; k++)
+				s.Weights[k] /= sum;
+		}
+	}
+
+	// Scalar linear-blend skinning
+	Core::Vertex SkinLinearBlendReference(const Core::Vertex& v, const SkinInfluence& s, Span<float4x3> palette) noexcept
+	{
+		float4x3 M(float3(0.0f), float3(0.0f), float3(0.0f), float3(0.0f));
+
+		for (int k = 0; k < SkinInfluence::MAX_NUM_INFLUENCES; k++)
+		{
+			for (int i = 0; i < 4; i++)
+				M.m[i] += palette[s.Joints[k]].m[i] * s.Weights[k];
+		}
+
+		const v_float4x4 vM = load(M);
+		__m128 vP = mul(vM, _mm_setr_ps(v.Position.x, v.Position.y, v.Position.z, 1.0f));
+		float3 t(v.Tangent);
+
+		// normals are transformed with the inverse transpose
+		const float3 n(v.Normal);
+		const float3 c0 = M.m[1].cross(M.m[2]);
+		const float3 c1 = M.m[2].cross(M.m[0]);
+		const float3 c2 = M.m[0].cross(M.m[1]);
+		const float sign = M.m[0].dot(c0) < 0.0f ? -1.0f : 1.0f;
+		const float3 nT = (c0 * n.x + c1 * n.y + c2 * n.z) * sign;
+		__m128 vN = normalize(_mm_setr_ps(nT.x, nT.y, nT.z, 0.0f));
+		__m128 vT = normalize(mul(vM, _mm_setr_ps(t.x, t.y, t.z, 0.0f)));
+
+		Core::Vertex ret = v;
+		ret.Position = storeFloat3(vP);
+		ret.Normal = half3(storeFloat3(vN));
+		ret.Tangent = half3(storeFloat3(vT));
+
+		return ret;
+	}
+
+	// Scalar dual-quaternion skinning. Blended dual quaternion is converted back to a matrix.
+	Core::Vertex SkinDualQuaternionReference(const Core::Vertex& v, const SkinInfluence& s, Span<float4x3> palette) noexcept
+	{
+		float4 real(0.0f);
+		float4 dual(0.0f);
+		float3 scale(0.0f);
+		DualQuaternion dq0 = ToDualQuaternion(palette[s.Joints[0]]);
+
+		for (int k = 0; k < SkinInfluence::MAX_NUM_INFLUENCES; k++)
+		{
+			const DualQuaternion dq = ToDualQuaternion(palette[s.Joints[k]]);
+			const float w = s.Weights[k] * (dq0.Real.dot(dq.Real) >= 0.0f ? 1.0f : -1.0f);
+			real += dq.Real * w;
+			dual += dq.Dual * w;
+			scale += dq.Scale * s.Weights[k];
+		}
+
+		const float len = real.length();
+		real = real / len;
+		dual = dual / len;
+
+		// translation = 2 * (dual * conjugate(real)).xyz
+		const __m128 vConj = _mm_setr_ps(-real.x, -real.y, -real.z, real.w);
+		const float4 t = storeFloat4(_mm_mul_ps(mulQuat(loadFloat4(dual), vConj), _mm_set1_ps(2.0f)));
+		const float3 vT(t.x, t.y, t.z);
+
+		float3 one(1.0f);
+		float3 zero(0.0f);
+		float3 translation = vT;
+		const v_float4x4 vM = affineTransformation(one, real, translation);
+		const v_float4x4 vR = affineTransformation(one, real, zero);
+
+		float3 n(v.Normal);
+		float3 tangent(v.Tangent);
+		const float3 p = v.Position * scale;
+		n = float3(n.x / scale.x, n.y / scale.y, n.z / scale.z);
+		tangent = tangent * scale;
+
+		Core::Vertex ret = v;
+		ret.Position = storeFloat3(mul(vM, _mm_setr_ps(p.x, p.y, p.z, 1.0f)));
+		ret.Normal = half3(storeFloat3(normalize(mul(vR, _mm_setr_ps(n.x, n.y, n.z, 0.0f)))));
+		ret.Tangent = half3(storeFloat3(normalize(mul(vR, _mm_setr_ps(tangent.x, tangent.y, tangent.z, 0.0f)))));
+
+		return ret;
+	}
+
+	bool ApproxEqual(const Core::Vertex& a, const Core::Vertex& b, float posTolerance) noexcept
+	{
+		const float3 na(a.Normal);
+		const float3 nb(b.Normal);
+		const float3 ta(a.Tangent);
+		const float3 tb(b.Tangent);
+		auto maxDiff = [](float3 u, float3 v) { return Max(fabsf(u.x - v.x), Max(fabsf(u.y - v.y), fabsf(u.z - v.z))); };
+
+		// normals and tangents are stored as half
+		return maxDiff(a.Position, b.Position) <= posTolerance && maxDiff(na, nb) <= 2e-3f && maxDiff(ta, tb) <= 2e-3f && 
+			a.TexUV.x == b.TexUV.x && a.TexUV.y == b.TexUV.y;
+	}
+}
+
+TEST_CASE("WorldTransformUpdater")
+{
+	RNG rng;
+	MemoryPool mp;
+	mp.Init();
+
+	SUBCASE("Matches full update")
+	{
+		SmallVector<TreeLevel, PoolAllocator> levels(mp, mp);
+		int childrenPerNode[] = { 8, 4, 3, 2 };
+		BuildSceneGraph(mp, levels, Span(childrenPerNode), rng);
+
+		SmallVector<TreeLevel, PoolAllocator> reference(mp, mp);
+		BuildSceneGraph(mp, reference, Span(childrenPerNode), rng);
+
+		WorldTransformUpdater updater;
+
+		for (int frame = 0; frame < 10; frame++)
+		{
+			// change a few local transforms, possibly including some whose ancestors also changed
+			for (int i = 0; i < 6; i++)
+			{
+				const int level = 1 + (int)rng.GetUniformUintBounded((uint32_t)levels.size() - 1);
+				const int offset = (int)rng.GetUniformUintBounded((uint32_t)levels[level].m_IDs.size());
+
+				levels[level].m_localTransforms[offset] = RandomTransform(rng);
+				updater.MarkDirty(TreePos{ .Level = level, .Offset = offset });
+
+				// same node can be marked more than once
+				if (i == 5)
+				{
+					levels[level].m_localTransforms[offset] = RandomTransform(rng);
+					updater.MarkDirty(TreePos{ .Level = level, .Offset = offset });
+				}
+			}
+
+			CHECK(updater.HasDirtyNodes());
+			auto changed = updater.Update(levels);
+			CHECK(!updater.HasDirtyNodes());
+
+			// changed nodes are sorted and every node appears at most once
+			for (size_t i = 1; i < changed.size(); i++)
+			{
+				const bool ordered = changed[i - 1].Pos.Level < changed[i].Pos.Level ||
+					(changed[i - 1].Pos.Level == changed[i].Pos.Level && changed[i - 1].Pos.Offset < changed[i].Pos.Offset);
+				CHECK(ordered);
+			}
+
+			for (int l = 0; l < (int)levels.size(); l++)
+			{
+				for (int j = 0; j < (int)levels[l].m_IDs.size(); j++)
+					reference[l].m_localTransforms[j] = levels[l].m_localTransforms[j];
+			}
+
+			UpdateAll(reference);
+
+			int numMismatches = 0;
+			int numDifferentFromPrev = 0;
+
+			for (int l = 0; l < (int)levels.size(); l++)
+			{
+				for (int j = 0; j < (int)levels[l].m_IDs.size(); j++)
+				{
+					if (!ApproxEqual(reference[l].m_toWorlds[j], levels[l].m_toWorlds[j]))
+						numMismatches++;
+				}
+			}
+
+			for (auto& node : changed)
+			{
+				if (!equal(load(node.PrevW), load(levels[node.Pos.Level].m_toWorlds[node.Pos.Offset])))
+					numDifferentFromPrev++;
+			}
+
+			CHECK(numMismatches == 0);
+			CHECK(numDifferentFromPrev == (int)changed.size());
+			CHECK(changed.size() > 0);
+		}
+
+		// nothing changed
+		auto changed = updater.Update(levels);
+		CHECK(changed.size() == 0);
+	}
+
+	SUBCASE("Parallel matches serial")
+	{
+		// same seed, same graph
+		RNG rng0(7);
+		RNG rng1(7);
+		SmallVector<TreeLevel, PoolAllocator> serial(mp, mp);
+		SmallVector<TreeLevel, PoolAllocator> parallel(mp, mp);
+		int childrenPerNode[] = { 64, 32, 8 };
+		BuildSceneGraph(mp, serial, Span(childrenPerNode), rng0);
+		BuildSceneGraph(mp, parallel, Span(childrenPerNode), rng1);
+
+		WorldTransformUpdater serialUpdater;
+		WorldTransformUpdater parallelUpdater;
+
+		for (int frame = 0; frame < 4; frame++)
+		{
+			// enough level-1 nodes so that the lower levels are split between several jobs
+			for (int i = 0; i < 24; i++)
+			{
+				const int level = i < 20 ? 1 : 1 + (int)rng.GetUniformUintBounded((uint32_t)serial.size() - 1);
+				const int offset = (int)rng.GetUniformUintBounded((uint32_t)serial[level].m_IDs.size());
+				const AffineTransformation tr = RandomTransform(rng);
+
+				serial[level].m_localTransforms[offset] = tr;
+				parallel[level].m_localTransforms[offset] = tr;
+				serialUpdater.MarkDirty(TreePos{ .Level = level, .Offset = offset });
+				parallelUpdater.MarkDirty(TreePos{ .Level = level, .Offset = offset });
+			}
+
+			auto changedSerial = serialUpdater.Update(serial);
+			auto changedParallel = parallelUpdater.Update(parallel, ThreadExecutor(8));
+
+			CHECK(changedSerial.size() == changedParallel.size());
+			CHECK(changedParallel.size() > (size_t)2 * WorldTransformUpdater::MIN_NODES_PER_JOB);
+
+			int numMismatches = 0;
+			for (size_t i = 0; i < Min(changedSerial.size(), changedParallel.size()); i++)
+			{
+				if (changedSerial[i].Pos.Level != changedParallel[i].Pos.Level ||
+					changedSerial[i].Pos.Offset != changedParallel[i].Pos.Offset ||
+					memcmp(&changedSerial[i].PrevW, &changedParallel[i].PrevW, sizeof(float4x3)) != 0)
+					numMismatches++;
+			}
+
+			for (int l = 0; l < (int)serial.size(); l++)
+			{
+				numMismatches += memcmp(serial[l].m_toWorlds.data(), parallel[l].m_toWorlds.data(), 
+					serial[l].m_toWorlds.size() * sizeof(float4x3)) != 0;
+			}
+
+			CHECK(numMismatches == 0);
+		}
+	}
+
+	SUBCASE("Previous transformations")
+	{
+		SmallVector<TreeLevel, PoolAllocator> levels(mp, mp);
+		int childrenPerNode[] = { 50, 4, 5 };
+		BuildSceneGraph(mp, levels, Span(childrenPerNode), rng);
+
+		WorldTransformUpdater updater;
+		SmallVector<SmallVector<float4x3>> before;
+		before.resize(levels.size());
+		// previous transformations of the nodes that moved in the last update are reset at the beginning
+		// of the next one
+		SmallVector<TreePos> moved;
+		int numMismatches = 0;
+		size_t numMoved = 0;
+
+		for (int frame = 0; frame < 10; frame++)
+		{
+			// a few random leaves move every frame
+			const int level = (int)levels.size() - 1;
+
+			for (int i = 0; i < 10; i++)
+			{
+				const int offset = (int)rng.GetUniformUintBounded((uint32_t)levels[level].m_IDs.size());
+
+				levels[level].m_localTransforms[offset].Translation.y += 0.01f;
+				updater.MarkDirty(TreePos{ .Level = level, .Offset = offset });
+			}
+
+			for (int l = 0; l < (int)levels.size(); l++)
+			{
+				before[l].clear();
+				before[l].append_range(levels[l].m_toWorlds.begin(), levels[l].m_toWorlds.end());
+			}
+
+			auto changed = updater.Update(levels);
+			numMoved += changed.size();
+
+			for (TreePos p : moved)
+				levels[p.Level].m_prevToWorlds[p.Offset] = levels[p.Level].m_toWorlds[p.Offset];
+
+			moved.resize(changed.size());
+			for (size_t i = 0; i < changed.size(); i++)
+			{
+				TreePos p = changed[i].Pos;
+				levels[p.Level].m_prevToWorlds[p.Offset] = changed[i].PrevW;
+				moved[i] = p;
+			}
+
+			// every node's previous transformation is the one it had before this update
+			for (int l = 1; l < (int)levels.size(); l++)
+			{
+				for (int j = 0; j < (int)levels[l].m_IDs.size(); j++)
+					numMismatches += memcmp(&levels[l].m_prevToWorlds[j], &before[l][j], sizeof(float4x3)) != 0;
+			}
+		}
+
+		CHECK(numMismatches == 0);
+		CHECK(numMoved > 0);
+	}
+}
+
+TEST_CASE("WorldTransformUpdater benchmark" * doctest::skip())
+{
+	RNG rng;
+	MemoryPool mp;
+	mp.Init();
+
+	SUBCASE("Wide and deep")
+	{
+		// ~500k nodes each, either in a few very wide levels or many levels where each node has two children
+		int wide[] = { 100000, 4 };
+		int deep[] = { 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 };
+		const char* names[] = { "Wide", "Deep" };
+		Span<int> shapes[] = { Span(wide), Span(deep) };
+		const int numThreads = Min(Max((int)std::thread::hardware_concurrency(), 1), WorldTransformUpdater::MAX_NUM_JOBS);
+
+		for (int shape = 0; shape < 2; shape++)
+		{
+			SmallVector<TreeLevel, PoolAllocator> levels(mp, mp);
+			BuildSceneGraph(mp, levels, shapes[shape], rng);
+
+			int numNodes = 0;
+			for (auto& level : levels)
+				numNodes += (int)level.m_IDs.size();
+
+			constexpr int NUM_FRAMES = 5;
+			WorldTransformUpdater updater;
+			double ms[3] = { 0.0, 0.0, 0.0 };
+			size_t numChanged = 0;
+
+			for (int method = 0; method < 3; method++)
+			{
+				// first frame is for warm up
+				for (int frame = 0; frame < NUM_FRAMES + 1; frame++)
+				{
+					// everything moves
+					for (int j = 0; j < (int)levels[1].m_IDs.size(); j++)
+					{
+						levels[1].m_localTransforms[j].Translation.y += 0.01f;
+
+						if (method != 0)
+							updater.MarkDirty(TreePos{ .Level = 1, .Offset = j });
+					}
+
+					auto t0 = std::chrono::high_resolution_clock::now();
+
+					if (method == 0)
+						UpdateAll(levels);
+					else if (method == 1)
+						numChanged = updater.Update(levels).size();
+					else
+						numChanged = updater.Update(levels, ThreadExecutor(numThreads)).size();
+
+					auto t1 = std::chrono::high_resolution_clock::now();
+
+					if (frame > 0)
+						ms[method] += std::chrono::duration<double, std::milli>(t1 - t0).count();
+				}
+			}
+
+			MESSAGE(names[shape], " scene graph with ", numNodes, " nodes in ", levels.size(), " levels, all of them moving");
+			MESSAGE("Per-node update: ", ms[0] / NUM_FRAMES, " ms/frame, 8-wide single-threaded: ", ms[1] / NUM_FRAMES,
+				" ms/frame, 8-wide with ", numThreads, " threads: ", ms[2] / NUM_FRAMES, " ms/frame");
+
+			CHECK(numChanged == (size_t)numNodes - 1);
+		}
+	}
+
+	SUBCASE("Animated nodes")
+	{
+		// ~500k nodes
+		SmallVector<TreeLevel, PoolAllocator> levels(mp, mp);
+		int childrenPerNode[] = { 1000, 10, 49 };
+		BuildSceneGraph(mp, levels, Span(childrenPerNode), rng);
+
+		int numNodes = 0;
+		for (auto& level : levels)
+			numNodes += (int)level.m_IDs.size();
+
+		// 1% of the nodes are animated
+		const int numAnimated = numNodes / 100;
+		SmallVector<TreePos> animated;
+		animated.reserve(numAnimated);
+
+		for (int i = 0; i < numAnimated; i++)
+		{
+			const uint32_t n = rng.GetUniformUintBounded(numNodes - 1);
+			int level = 1;
+			int offset = (int)n;
+
+			while (offset >= (int)levels[level].m_IDs.size())
+			{
+				offset -= (int)levels[level].m_IDs.size();
+				level++;
+			}
+
+			animated.push_back(TreePos{ .Level = level, .Offset = offset });
+		}
+
+		int numAffected = 0;
+		for (auto& pos : animated)
+			numAffected += SubtreeSize(levels, pos.Level, pos.Offset);
+
+		constexpr int NUM_FRAMES = 10;
+		WorldTransformUpdater updater;
+		double fullMs = 0.0;
+		double dirtyMs = 0.0;
+		size_t numChanged = 0;
+
+		for (int frame = 0; frame < NUM_FRAMES; frame++)
+		{
+			for (auto& pos : animated)
+				levels[pos.Level].m_localTransforms[pos.Offset].Translation.y += 0.01f;
+
+			auto t0 = std::chrono::high_resolution_clock::now();
+			UpdateAll(levels);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			fullMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+			for (auto& pos : animated)
+			{
+				levels[pos.Level].m_localTransforms[pos.Offset].Translation.y += 0.01f;
+				updater.MarkDirty(pos);
+			}
+
+			t0 = std::chrono::high_resolution_clock::now();
+			numChanged = updater.Update(levels).size();
+			t1 = std::chrono::high_resolution_clock::now();
+			dirtyMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+		}
+
+		MESSAGE("Scene graph with ", numNodes, " nodes, ", numAnimated, " animated (", numAffected, " affected including descendants)");
+		MESSAGE("Full update: ", fullMs / NUM_FRAMES, " ms/frame, dirty-node update: ", dirtyMs / NUM_FRAMES, " ms/frame");
+
+		// overlapping subtrees are only visited once
+		CHECK(numChanged <= (size_t)numAffected);
+		CHECK(numChanged >= (size_t)numAnimated / 2);
+	}
+
+	SUBCASE("Previous transformations")
+	{
+		// ~500k nodes
+		SmallVector<TreeLevel, PoolAllocator> levels(mp, mp);
+		int childrenPerNode[] = { 1000, 10, 49 };
+		BuildSceneGraph(mp, levels, Span(childrenPerNode), rng);
+
+		HashTable<TreePos> idToPos;
+		for (int l = 1; l < (int)levels.size(); l++)
+		{
+			for (int j = 0; j < (int)levels[l].m_IDs.size(); j++)
+				idToPos.emplace(levels[l].m_IDs[j], TreePos{ .Level = l, .Offset = j });
+		}
+
+		const int numNodes = (int)idToPos.size();
+
+		// how SceneCore used to do it -- (ID, previous transformation) of the nodes that moved, sorted by ID
+		struct PrevToWorld
+		{
+			float4x3 W;
+			uint64_t ID;
+		};
+
+		SmallVector<PrevToWorld> sorted;
+		auto getPrevSorted = [&](uint64_t id)
+			{
+				auto it = std::lower_bound(sorted.begin(), sorted.end(), id, [](const PrevToWorld& p, uint64_t key)
+					{
+						return p.ID < key;
+					});
+
+				if (it != sorted.end() && it->ID == id)
+					return it->W;
+
+				TreePos p = *idToPos.find(id);
+				return levels[p.Level].m_toWorlds[p.Offset];
+			};
+
+		// index-aligned previous transformations. Nodes that moved in the last update are reset at the 
+		// beginning of the next one.
+		SmallVector<TreePos> moved;
+		auto getPrevAligned = [&](uint64_t id)
+			{
+				TreePos p = *idToPos.find(id);
+				return levels[p.Level].m_prevToWorlds[p.Offset];
+			};
+
+		constexpr int NUM_FRAMES = 10;
+		WorldTransformUpdater updater;
+		SmallVector<SmallVector<float4x3>> before;
+		before.resize(levels.size());
+		double ms[2] = { 0.0, 0.0 };
+		int numMismatches[2] = { 0, 0 };
+		size_t numMoved = 0;
+
+		for (int frame = 0; frame < NUM_FRAMES; frame++)
+		{
+			// a different 1% of the nodes (leaves, so that the number of moved nodes stays the same) move 
+			// every frame
+			for (int i = 0; i < numNodes / 100; i++)
+			{
+				const int level = (int)levels.size() - 1;
+				const int offset = (int)rng.GetUniformUintBounded((uint32_t)levels[level].m_IDs.size());
+
+				levels[level].m_localTransforms[offset].Translation.y += 0.01f;
+				updater.MarkDirty(TreePos{ .Level = level, .Offset = offset });
+			}
+
+			for (int l = 0; l < (int)levels.size(); l++)
+			{
+				before[l].clear();
+				before[l].append_range(levels[l].m_toWorlds.begin(), levels[l].m_toWorlds.end());
+			}
+
+			auto changed = updater.Update(levels);
+			numMoved += changed.size();
+
+			auto t0 = std::chrono::high_resolution_clock::now();
+
+			sorted.resize(changed.size());
+			for (size_t i = 0; i < changed.size(); i++)
+			{
+				TreePos p = changed[i].Pos;
+				sorted[i] = PrevToWorld{ .W = changed[i].PrevW, .ID = levels[p.Level].m_IDs[p.Offset] };
+			}
+
+			std::sort(sorted.begin(), sorted.end(), [](const PrevToWorld& lhs, const PrevToWorld& rhs)
+				{
+					return lhs.ID < rhs.ID;
+				});
+
+			auto t1 = std::chrono::high_resolution_clock::now();
+
+			for (TreePos p : moved)
+				levels[p.Level].m_prevToWorlds[p.Offset] = levels[p.Level].m_toWorlds[p.Offset];
+
+			moved.resize(changed.size());
+			for (size_t i = 0; i < changed.size(); i++)
+			{
+				TreePos p = changed[i].Pos;
+				levels[p.Level].m_prevToWorlds[p.Offset] = changed[i].PrevW;
+				moved[i] = p;
+			}
+
+			auto t2 = std::chrono::high_resolution_clock::now();
+
+			// every node is looked up, same as computing motion vectors for every instance
+			for (int l = 1; l < (int)levels.size(); l++)
+			{
+				for (int j = 0; j < (int)levels[l].m_IDs.size(); j++)
+				{
+					const float4x3 W = getPrevSorted(levels[l].m_IDs[j]);
+					numMismatches[0] += memcmp(&W, &before[l][j], sizeof(float4x3)) != 0;
+				}
+			}
+
+			auto t3 = std::chrono::high_resolution_clock::now();
+
+			for (int l = 1; l < (int)levels.size(); l++)
+			{
+				for (int j = 0; j < (int)levels[l].m_IDs.size(); j++)
+				{
+					const float4x3 W = getPrevAligned(levels[l].m_IDs[j]);
+					numMismatches[1] += memcmp(&W, &before[l][j], sizeof(float4x3)) != 0;
+				}
+			}
+
+			auto t4 = std::chrono::high_resolution_clock::now();
+
+			ms[0] += std::chrono::duration<double, std::milli>(t1 - t0).count() + 
+				std::chrono::duration<double, std::milli>(t3 - t2).count();
+			ms[1] += std::chrono::duration<double, std::milli>(t2 - t1).count() +
+				std::chrono::duration<double, std::milli>(t4 - t3).count();
+		}
+
+		MESSAGE("Scene graph with ", numNodes, " nodes, ", numMoved / NUM_FRAMES, " moved per frame, every node looked up");
+		MESSAGE("Sorted by ID: ", ms[0] / NUM_FRAMES, " ms/frame, index-aligned: ", ms[1] / NUM_FRAMES, " ms/frame");
+
+		CHECK(numMismatches[0] == 0);
+		CHECK(numMismatches[1] == 0);
+		CHECK(numMoved > 0);
+	}
+}
+
+TEST_CASE("InsertNodes")
+{
+	RNG rng;
+	MemoryPool mp;
+	mp.Init();
+
+	SUBCASE("Matches one at a time")
+	{
+		SmallVector<TreeLevel, PoolAllocator> batched(mp, mp);
+		SmallVector<TreeLevel, PoolAllocator> reference(mp, mp);
+		InitSceneGraph(mp, batched);
+		InitSceneGraph(mp, reference);
+
+		HashTable<NodeHandle> batchedIDs;
+		NodeHandleTable batchedHandles;
+		HashTable<TreePos> referencePos;
+
+		SmallVector<NewNode> allNodes;
+
+		// second batch adds children to both the existing nodes and the new ones
+		for (int batch = 0; batch < 3; batch++)
+		{
+			SmallVector<NewNode> nodes;
+			RandomNodes(batch == 0 ? 1000 : 300, allNodes.size() + 1, allNodes, nodes, rng);
+
+			InsertNodes(batched, mp, nodes, ROOT_ID, batchedIDs, batchedHandles);
+
+			for (auto& node : nodes)
+				InsertOneAtATime(reference, mp, node, referencePos);
+
+			allNodes.append_range(nodes.begin(), nodes.end());
+		}
+
+		CHECK(batched.size() == reference.size());
+		CHECK(batchedIDs.size() == allNodes.size());
+		CHECK(batchedHandles.size() == allNodes.size());
+		CHECK(CountMismatches(batched, reference) == 0);
+		CHECK(CountUnsortedRanges(batched) == 0);
+
+		int numWrongPos = 0;
+
+		for (auto& node : allNodes)
+		{
+			const NodeHandle* h = batchedIDs.find(node.ID);
+			const TreePos* p = h ? batchedHandles.Find(*h) : nullptr;
+			const TreePos* q = referencePos.find(node.ID);
+			numWrongPos += !p || !q || p->Level != q->Level || p->Offset != q->Offset || batched[p->Level].m_IDs[p->Offset] != node.ID ||
+				batched[p->Level].m_handles[p->Offset] != h->Index;
+		}
+
+		CHECK(numWrongPos == 0);
+
+		batchedIDs.free();
+		referencePos.free();
+	}
+}
+
+TEST_CASE("InsertNodes benchmark" * doctest::skip())
+{
+	RNG rng;
+	MemoryPool mp;
+	mp.Init();
+
+	int sizes[] = { 1000, 10000, 100000, 1000000 };
+
+	for (int n : sizes)
+	{
+		SmallVector<NewNode> nodes;
+		RandomNodes(n, 1, Span<NewNode>(nullptr, 0), nodes, rng);
+
+		SmallVector<TreeLevel, PoolAllocator> levels(mp, mp);
+		InitSceneGraph(mp, levels);
+		HashTable<NodeHandle> idToHandle;
+		NodeHandleTable handles;
+
+		auto t0 = std::chrono::high_resolution_clock::now();
+		InsertNodes(levels, mp, nodes, ROOT_ID, idToHandle, handles);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		const double batchedMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+		CHECK(idToHandle.size() == (size_t)n);
+
+		// quadratic, too slow beyond this
+		if (n <= 100000)
+		{
+			SmallVector<TreeLevel, PoolAllocator> reference(mp, mp);
+			InitSceneGraph(mp, reference);
+			HashTable<TreePos> referencePos;
+
+			t0 = std::chrono::high_resolution_clock::now();
+			for (auto& node : nodes)
+				InsertOneAtATime(reference, mp, node, referencePos);
+			t1 = std::chrono::high_resolution_clock::now();
+
+			MESSAGE(n, " nodes (", levels.size(), " levels): batched ", batchedMs, " ms, one at a time ", 
+				std::chrono::duration<double, std::milli>(t1 - t0).count(), " ms");
+
+			referencePos.free();
+		}
+		else
+			MESSAGE(n, " nodes (", levels.size(), " levels): batched ", batchedMs, " ms");
+
+		idToHandle.free();
+	}
+}
+
+
+namespace
+{
+	// Randomly selects around the given fraction of nodes for removal. Descendants of the selected nodes
+	// are marked as well.
+	void SelectNodes(Span<NewNode> nodes, float fraction, HashTable<NodeHandle>& idToHandle, 
+		SmallVector<NodeHandle>& selected, SmallVector<bool>& isRemoved, RNG& rng) noexcept
+	{
+		HashTable<bool> removedIDs;
+		isRemoved.resize(nodes.size());
+
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			const bool* parentRemoved = removedIDs.find(nodes[i].ParentID);
+			const bool select = rng.GetUniformFloat() < fraction;
+			isRemoved[i] = select || (parentRemoved && *parentRemoved);
+			removedIDs.insert_or_assign(nodes[i].ID, isRemoved[i]);
+
+			if (select)
+				selected.push_back(*idToHandle.find(nodes[i].ID));
+		}
+
+		removedIDs.free();
+	}
+}
+
+TEST_CASE("RemoveNodes")
+{
+	RNG rng;
+	MemoryPool mp;
+	mp.Init();
+
+	SUBCASE("Matches rebuilt scene graph")
+	{
+		SmallVector<TreeLevel, PoolAllocator> levels(mp, mp);
+		InitSceneGraph(mp, levels);
+		HashTable<NodeHandle> idToHandle;
+		NodeHandleTable handles;
+
+		SmallVector<NewNode> allNodes;
+		RandomNodes(2000, 1, Span<NewNode>(nullptr, 0), allNodes, rng);
+		InsertNodes(levels, mp, allNodes, ROOT_ID, idToHandle, handles);
+
+		SmallVector<NodeHandle> selected;
+		SmallVector<bool> isRemoved;
+		SelectNodes(allNodes, 0.05f, idToHandle, selected, isRemoved, rng);
+		REQUIRE(!selected.empty());
+
+		// same node twice
+		selected.push_back(selected[0]);
+
+		SmallVector<TreePos> removed;
+		RemoveNodes(levels, selected, handles, removed);
+
+		SmallVector<NewNode> survivors;
+		int numRemoved = 0;
+
+		for (size_t i = 0; i < allNodes.size(); i++)
+		{
+			if (!isRemoved[i])
+				survivors.push_back(allNodes[i]);
+			else
+			{
+				CHECK(idToHandle.erase(allNodes[i].ID) == 1);
+				numRemoved++;
+			}
+		}
+
+		CHECK(removed.size() == (size_t)numRemoved);
+		CHECK(handles.size() == survivors.size());
+
+		// removed nodes stay in place until compaction, so positions of the other nodes are still valid
+		int numWrongPos = 0;
+
+		for (auto& pos : removed)
+			numWrongPos += levels[pos.Level].m_handles[pos.Offset] != NodeHandle::INVALID_INDEX;
+
+		// new nodes can be inserted before compaction
+		SmallVector<NewNode> newNodes;
+		RandomNodes(300, allNodes.size() + 1, survivors, newNodes, rng);
+		InsertNodes(levels, mp, newNodes, ROOT_ID, idToHandle, handles);
+		survivors.append_range(newNodes.begin(), newNodes.end());
+
+		CompactNodes(levels, handles);
+
+		// same as inserting the remaining nodes into an empty scene graph
+		SmallVector<TreeLevel, PoolAllocator> reference(mp, mp);
+		InitSceneGraph(mp, reference);
+		HashTable<NodeHandle> referenceIDs;
+		NodeHandleTable referenceHandles;
+		InsertNodes(reference, mp, survivors, ROOT_ID, referenceIDs, referenceHandles);
+
+		CHECK(levels.size() == reference.size());
+		CHECK(CountMismatches(levels, reference) == 0);
+		CHECK(CountUnsortedRanges(levels) == 0);
+
+		for (auto& node : survivors)
+		{
+			const NodeHandle* h = idToHandle.find(node.ID);
+			const TreePos* p = h ? handles.Find(*h) : nullptr;
+			numWrongPos += !p || levels[p->Level].m_IDs[p->Offset] != node.ID || levels[p->Level].m_handles[p->Offset] != h->Index;
+		}
+
+		CHECK(numWrongPos == 0);
+
+		// handles of the removed nodes are stale, even after their slots were reused
+		int numValid = 0;
+
+		for (NodeHandle h : selected)
+			numValid += handles.Find(h) != nullptr;
+
+		CHECK(numValid == 0);
+
+		idToHandle.free();
+		referenceIDs.free();
+	}
+}
+
+TEST_CASE("RemoveNodes benchmark" * doctest::skip())
+{
+	RNG rng;
+	MemoryPool mp;
+	mp.Init();
+
+	int sizes[] = { 100000, 1000000 };
+	float fractions[] = { 0.001f, 0.01f };
+
+	for (int n : sizes)
+	{
+		for (float fraction : fractions)
+		{
+			SmallVector<NewNode> nodes;
+			RandomNodes(n, 1, Span<NewNode>(nullptr, 0), nodes, rng);
+
+			SmallVector<TreeLevel, PoolAllocator> levels(mp, mp);
+			InitSceneGraph(mp, levels);
+			HashTable<NodeHandle> idToHandle;
+			NodeHandleTable handles;
+			InsertNodes(levels, mp, nodes, ROOT_ID, idToHandle, handles);
+
+			SmallVector<NodeHandle> selected;
+			SmallVector<bool> isRemoved;
+			SelectNodes(nodes, fraction, idToHandle, selected, isRemoved, rng);
+
+			SmallVector<TreePos> removed;
+
+			auto t0 = std::chrono::high_resolution_clock::now();
+			RemoveNodes(levels, selected, handles, removed);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			const double removeMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+			t0 = std::chrono::high_resolution_clock::now();
+			CompactNodes(levels, handles);
+			t1 = std::chrono::high_resolution_clock::now();
+			const double compactMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+			CHECK(handles.size() == nodes.size() - removed.size());
+
+			// alternative is to rebuild the scene graph from the remaining nodes
+			SmallVector<NewNode> survivors;
+			for (size_t i = 0; i < nodes.size(); i++)
+			{
+				if (!isRemoved[i])
+					survivors.push_back(nodes[i]);
+			}
+
+			SmallVector<TreeLevel, PoolAllocator> rebuilt(mp, mp);
+			InitSceneGraph(mp, rebuilt);
+			HashTable<NodeHandle> rebuiltIDs;
+			NodeHandleTable rebuiltHandles;
+
+			t0 = std::chrono::high_resolution_clock::now();
+			InsertNodes(rebuilt, mp, survivors, ROOT_ID, rebuiltIDs, rebuiltHandles);
+			t1 = std::chrono::high_resolution_clock::now();
+			const double rebuildMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+			MESSAGE(n, " nodes, ", removed.size(), " removed (", selected.size(), " subtrees): remove ", removeMs, 
+				" ms, compact ", compactMs, " ms (", (double)n / (compactMs * 1000.0), " M nodes/s), rebuild ", 
+				rebuildMs, " ms");
+
+			idToHandle.free();
+			rebuiltIDs.free();
+		}
+	}
+}
+
+TEST_CASE("AnimationSampler")
+{
+	RNG rng(19);
+
+	SUBCASE("Matches reference")
+	{
+		SmallVector<Keyframe> keyframes;
+		SmallVector<AnimationOffset> animations;
+		// not a multiple of the SIMD width
+		RandomAnimations(1001, 20, keyframes, animations, rng);
+
+		AnimationSampler sampler;
+		SmallVector<AffineTransformation> out;
+		out.resize(animations.size());
+
+		// steady playback, jump back in time, then past the end of every animation
+		float times[40];
+		for (int i = 0; i < 30; i++)
+			times[i] = -0.5f + i * 0.4f;
+		for (int i = 30; i < 39; i++)
+			times[i] = 1.0f + (i - 30) * 0.7f;
+		times[39] = 100.0f;
+
+		int numMismatches = 0;
+
+		for (float t : times)
+		{
+			sampler.Sample(keyframes, animations, t, out);
+
+			for (size_t i = 0; i < animations.size(); i++)
+			{
+				if (!ApproxEqual(out[i], SampleReference(keyframes, animations[i], t)))
+					numMismatches++;
+			}
+		}
+
+		CHECK(numMismatches == 0);
+
+		// new animations are appended and start from their first keyframe
+		RandomAnimations(20, 5, keyframes, animations, rng);
+		out.resize(animations.size());
+
+		sampler.Sample(keyframes, animations, 3.0f, out);
+		numMismatches = 0;
+
+		for (size_t i = 0; i < animations.size(); i++)
+		{
+			if (!ApproxEqual(out[i], SampleReference(keyframes, animations[i], 3.0f)))
+				numMismatches++;
+		}
+
+		CHECK(numMismatches == 0);
+	}
+
+	SUBCASE("Single keyframe")
+	{
+		SmallVector<Keyframe> keyframes;
+		SmallVector<AnimationOffset> animations;
+
+		// every other animation only has one keyframe, which holds for all t
+		for (int i = 0; i < 37; i++)
+		{
+			if (i & 0x1)
+			{
+				const int beg = (int)keyframes.size();
+				keyframes.push_back(Keyframe{ .Transform = RandomTransform(rng), .Time = rng.GetUniformFloat() });
+				animations.emplace_back(beg, beg + 1, rng.GetUniformFloat());
+			}
+			else
+				RandomAnimations(1, 6, keyframes, animations, rng);
+		}
+
+		AnimationSampler sampler;
+		SmallVector<AffineTransformation> out;
+		out.resize(animations.size());
+		int numMismatches = 0;
+
+		for (float t : { -1.0f, 0.3f, 0.9f, 2.5f, 0.1f, 50.0f })
+		{
+			sampler.Sample(keyframes, animations, t, out);
+
+			for (size_t i = 0; i < animations.size(); i++)
+			{
+				if (!ApproxEqual(out[i], SampleReference(keyframes, animations[i], t)))
+					numMismatches++;
+			}
+		}
+
+		CHECK(numMismatches == 0);
+	}
+
+	SUBCASE("Parallel matches serial")
+	{
+		SmallVector<Keyframe> keyframes;
+		SmallVector<AnimationOffset> animations;
+		RandomAnimations(5 * AnimationSampler::MIN_ANIMATIONS_PER_JOB + 3, 10, keyframes, animations, rng);
+
+		AnimationSampler serialSampler;
+		AnimationSampler parallelSampler;
+		SmallVector<AffineTransformation> serial;
+		SmallVector<AffineTransformation> parallel;
+		serial.resize(animations.size());
+		parallel.resize(animations.size());
+
+		for (int frame = 0; frame < 4; frame++)
+		{
+			const float t = frame * 0.3f;
+			serialSampler.Sample(keyframes, animations, t, serial);
+			parallelSampler.Sample(keyframes, animations, t, parallel, ThreadExecutor(4));
+
+			CHECK(memcmp(serial.data(), parallel.data(), serial.size() * sizeof(AffineTransformation)) == 0);
+		}
+	}
+
+	SUBCASE("Accumulated frame time")
+	{
+		SmallVector<Keyframe> keyframes;
+		SmallVector<AnimationOffset> animations;
+		RandomAnimations(300, 20, keyframes, animations, rng);
+
+		AnimationCompressionParams params;
+		params.Raw = true;
+		CompressedAnimations compressed;
+
+		for (auto& anim : animations)
+		{
+			compressed.Add(Span(keyframes.data() + anim.BegOffset, anim.EndOffset - anim.BegOffset), 
+				anim.BegTimeOffset, params);
+		}
+
+		AnimationSampler sampler;
+		SmallVector<AffineTransformation> out;
+		out.resize(animations.size());
+
+		// same as SceneCore::Update() -- animations are sampled at the sum of the frame times, which
+		// doesn't advance (and nothing is sampled) while paused
+		double animationTime = 0.0;
+		double lastSampledTime = 0.0;
+		int numMismatches = 0;
+		int numSampledFrames = 0;
+
+		for (int frame = 0; frame < 1000; frame++)
+		{
+			// 4 to 33 ms per frame, paused for the last 20 frames of every 100
+			const double dt = 0.004 + rng.GetUniformFloat() * 0.029;
+			const bool paused = frame % 100 >= 80;
+
+			if (paused)
+				continue;
+
+			animationTime += dt;
+			const float t = (float)animationTime;
+
+			// time only moves forward, including across the pauses
+			CHECK(animationTime > lastSampledTime);
+			CHECK(animationTime - lastSampledTime < 0.034);
+			lastSampledTime = animationTime;
+
+			sampler.Sample(compressed, t, out);
+			numSampledFrames++;
+
+			for (size_t i = 0; i < animations.size(); i++)
+			{
+				if (!ApproxEqual(out[i], SampleReference(keyframes, animations[i], t)))
+					numMismatches++;
+			}
+		}
+
+		CHECK(numSampledFrames == 800);
+		CHECK(numMismatches == 0);
+	}
+}
+
+TEST_CASE("AnimationSampler benchmark" * doctest::skip())
+{
+	RNG rng(19);
+
+	constexpr int NUM_ANIMATIONS = 100000;
+	constexpr int NUM_FRAMES = 60;
+	SmallVector<Keyframe> keyframes;
+	SmallVector<AnimationOffset> animations;
+	RandomAnimations(NUM_ANIMATIONS, 64, keyframes, animations, rng);
+
+	const int numThreads = Min(Max((int)std::thread::hardware_concurrency(), 1), AnimationSampler::MAX_NUM_JOBS);
+	SmallVector<AffineTransformation> out;
+	out.resize(animations.size());
+	double ms[3] = { 0.0, 0.0, 0.0 };
+	float checksum[3] = { 0.0f, 0.0f, 0.0f };
+
+	for (int method = 0; method < 3; method++)
+	{
+		AnimationSampler sampler;
+
+		// first frame is for warm up
+		for (int frame = 0; frame < NUM_FRAMES + 1; frame++)
+		{
+			// steady playback at 60 fps, past the start of every animation
+			const float t = 4.0f + frame / 60.0f;
+			auto t0 = std::chrono::high_resolution_clock::now();
+
+			if (method == 0)
+			{
+				for (size_t i = 0; i < animations.size(); i++)
+					out[i] = SampleReference(keyframes, animations[i], t);
+			}
+			else if (method == 1)
+				sampler.Sample(keyframes, animations, t, out);
+			else
+				sampler.Sample(keyframes, animations, t, out, ThreadExecutor(numThreads));
+
+			auto t1 = std::chrono::high_resolution_clock::now();
+
+			if (frame > 0)
+				ms[method] += std::chrono::duration<double, std::milli>(t1 - t0).count();
+		}
+
+		for (auto& tr : out)
+			checksum[method] += tr.Translation.x;
+	}
+
+	MESSAGE(NUM_ANIMATIONS, " animated nodes (", keyframes.size(), " keyframes): binary search + scalar slerp: ", 
+		ms[0] / NUM_FRAMES, " ms/frame, cached cursors + 8-wide: ", ms[1] / NUM_FRAMES, " ms/frame, with ", 
+		numThreads, " threads: ", ms[2] / NUM_FRAMES, " ms/frame");
+
+	CHECK(fabsf(checksum[0] - checksum[1]) < 1e-3f * fabsf(checksum[0]));
+	CHECK(checksum[1] == checksum[2]);
+}
+
+TEST_CASE("CompressedAnimations")
+{
+	RNG rng(23);
+
+	SUBCASE("Error is bounded")
+	{
+		SmallVector<Keyframe> keyframes;
+		SmallVector<AnimationOffset> animations;
+		BakedAnimations(200, keyframes, animations, rng);
+
+		CompressedAnimations compressed;
+		for (auto& anim : animations)
+		{
+			compressed.Add(Span(keyframes.data() + anim.BegOffset, anim.EndOffset - anim.BegOffset),
+				anim.BegTimeOffset);
+		}
+
+		REQUIRE(compressed.size() == animations.size());
+		// every track has its own keyframes
+		CHECK(compressed.NumKeyframes() < 3 * keyframes.size());
+
+		float maxDiff = 0.0f;
+		float maxAngle = 0.0f;
+
+		// both at and between the keyframes, also before the start and after the end
+		for (float t = -0.5f; t < 8.0f; t += 0.0123f)
+		{
+			for (size_t i = 0; i < animations.size(); i++)
+			{
+				float diff;
+				float angle;
+				TransformError(compressed.Sample(i, t), SampleReference(keyframes, animations[i], t), diff, angle);
+
+				maxDiff = Max(maxDiff, diff);
+				maxAngle = Max(maxAngle, angle);
+			}
+		}
+
+		// default tolerances, plus some slack for the approximations in slerp
+		CHECK(maxDiff < 1.05e-4f);
+		CHECK(maxAngle < 5.5e-4f);
+	}
+
+	SUBCASE("Constant, lossless and long animations")
+	{
+		// a single keyframe
+		{
+			const Keyframe k{ .Transform = RandomTransform(rng), .Time = 1.0f };
+			SmallVector<Keyframe> keyframes;
+			keyframes.push_back(k);
+
+			CompressedAnimations compressed;
+			compressed.Add(keyframes, 0.5f);
+			REQUIRE(compressed.size() == 1);
+			CHECK(compressed.NumKeyframes() == 3);
+
+			for (float t : { -1.0f, 1.5f, 100.0f })
+			{
+				float diff;
+				float angle;
+				TransformError(compressed.Sample(0, t), k.Transform, diff, angle);
+
+				CHECK(diff == 0.0f);
+				CHECK(angle < 5e-4f);
+			}
+		}
+
+		// random keyframes can't be reduced, values and times are kept as they are
+		{
+			SmallVector<Keyframe> keyframes;
+			SmallVector<AnimationOffset> animations;
+			RandomAnimations(100, 20, keyframes, animations, rng);
+
+			AnimationCompressionParams params;
+			params.Raw = true;
+			CompressedAnimations compressed;
+			CompressedAnimations lossy;
+
+			for (auto& anim : animations)
+			{
+				Span<Keyframe> k(keyframes.data() + anim.BegOffset, anim.EndOffset - anim.BegOffset);
+				compressed.Add(k, anim.BegTimeOffset, params);
+				lossy.Add(k, anim.BegTimeOffset);
+			}
+
+			CHECK(compressed.SizeInBytes() > lossy.SizeInBytes());
+			int numMismatches = 0;
+
+			for (float t = 0.0f; t < 12.0f; t += 0.0371f)
+			{
+				for (size_t i = 0; i < animations.size(); i++)
+				{
+					if (!ApproxEqual(compressed.Sample(i, t), SampleReference(keyframes, animations[i], t)))
+						numMismatches++;
+				}
+			}
+
+			CHECK(numMismatches == 0);
+		}
+
+		// 20 minutes at 30 and 60 fps -- the latter has more keyframes than 16-bit times can tell apart
+		for (float fps : { 30.0f, 60.0f })
+		{
+			const int n = (int)(20 * 60 * fps);
+			SmallVector<Keyframe> keyframes;
+			AffineTransformation tr = RandomTransform(rng);
+
+			for (int i = 0; i < n; i++)
+			{
+				const float t = i / fps;
+				tr.Translation = float3(sinf(t), cosf(3.0f * t), 0.1f * t);
+				keyframes.push_back(Keyframe{ .Transform = tr, .Time = t });
+			}
+
+			CompressedAnimations compressed;
+			compressed.Add(keyframes, 0.0f);
+
+			float maxDiff = 0.0f;
+			AnimationOffset anim(0, n, 0.0f);
+
+			for (float t = 0.0f; t < n / fps; t += 0.0913f)
+			{
+				float diff;
+				float angle;
+				TransformError(compressed.Sample(0, t), SampleReference(keyframes, anim, t), diff, angle);
+				maxDiff = Max(maxDiff, diff);
+			}
+
+			CHECK(maxDiff < 1.05e-4f);
+		}
+
+		// every track gets its own format -- a small range fits in 8 bits
+		{
+			SmallVector<Keyframe> small;
+			SmallVector<Keyframe> large;
+			const AffineTransformation tr = RandomTransform(rng);
+
+			for (int i = 0; i < 30; i++)
+			{
+				const float3 r(rng.GetUniformFloat(), rng.GetUniformFloat(), rng.GetUniformFloat());
+				Keyframe k{ .Transform = tr, .Time = i / 30.0f };
+
+				k.Transform.Translation = r * 0.02f;
+				small.push_back(k);
+				k.Transform.Translation = r * 2.0f;
+				large.push_back(k);
+			}
+
+			CompressedAnimations compressedSmall;
+			CompressedAnimations compressedLarge;
+			compressedSmall.Add(small, 0.0f);
+			compressedLarge.Add(large, 0.0f);
+
+			// 3 bytes less per translation keyframe
+			CHECK(compressedSmall.NumKeyframes() == compressedLarge.NumKeyframes());
+			CHECK(compressedSmall.SizeInBytes() + 3 * 30 == compressedLarge.SizeInBytes());
+		}
+	}
+
+	SUBCASE("Sampler matches Sample()")
+	{
+		SmallVector<Keyframe> keyframes;
+		SmallVector<AnimationOffset> animations;
+		BakedAnimations(500, keyframes, animations, rng);
+		// these can't be reduced much
+		RandomAnimations(501, 20, keyframes, animations, rng);
+
+		CompressedAnimations compressed;
+		for (auto& anim : animations)
+		{
+			compressed.Add(Span(keyframes.data() + anim.BegOffset, anim.EndOffset - anim.BegOffset),
+				anim.BegTimeOffset);
+		}
+
+		AnimationSampler sampler;
+		AnimationSampler parallelSampler;
+		SmallVector<AffineTransformation> out;
+		SmallVector<AffineTransformation> parallelOut;
+		out.resize(compressed.size());
+		parallelOut.resize(compressed.size());
+
+		// steady playback, then jump back in time
+		float times[40];
+		for (int i = 0; i < 30; i++)
+			times[i] = -0.5f + i * 0.4f;
+		for (int i = 30; i < 40; i++)
+			times[i] = 1.0f + (i - 30) * 0.7f;
+
+		int numMismatches = 0;
+
+		for (float t : times)
+		{
+			sampler.Sample(compressed, t, out);
+			parallelSampler.Sample(compressed, t, parallelOut, ThreadExecutor(4));
+
+			for (size_t i = 0; i < compressed.size(); i++)
+			{
+				if (!ApproxEqual(out[i], compressed.Sample(i, t)))
+					numMismatches++;
+			}
+
+			CHECK(memcmp(out.data(), parallelOut.data(), out.size() * sizeof(AffineTransformation)) == 0);
+		}
+
+		CHECK(numMismatches == 0);
+	}
+
+	SUBCASE("Remove")
+	{
+		SmallVector<Keyframe> keyframes;
+		SmallVector<AnimationOffset> animations;
+		BakedAnimations(100, keyframes, animations, rng);
+
+		CompressedAnimations compressed;
+		CompressedAnimations expected;
+		SmallVector<bool> isRemoved;
+
+		for (size_t i = 0; i < animations.size(); i++)
+		{
+			Span<Keyframe> k(keyframes.data() + animations[i].BegOffset, animations[i].EndOffset - animations[i].BegOffset);
+			compressed.Add(k, animations[i].BegTimeOffset);
+
+			isRemoved.push_back(i % 3 == 1);
+			if (!isRemoved.back())
+				expected.Add(k, animations[i].BegTimeOffset);
+		}
+
+		compressed.Remove(isRemoved);
+
+		REQUIRE(compressed.size() == expected.size());
+		CHECK(compressed.NumKeyframes() == expected.NumKeyframes());
+		CHECK(compressed.SizeInBytes() == expected.SizeInBytes());
+
+		int numMismatches = 0;
+
+		for (size_t i = 0; i < compressed.size(); i++)
+		{
+			for (float t = 0.0f; t < 7.0f; t += 0.1f)
+			{
+				const AffineTransformation a = compressed.Sample(i, t);
+				const AffineTransformation b = expected.Sample(i, t);
+
+				if (memcmp(&a, &b, sizeof(AffineTransformation)) != 0)
+					numMismatches++;
+			}
+		}
+
+		CHECK(numMismatches == 0);
+	}
+}
+
+TEST_CASE("CompressedAnimations benchmark" * doctest::skip())
+{
+	RNG rng(23);
+
+	constexpr int NUM_ANIMATIONS = 20000;
+	constexpr int NUM_FRAMES = 60;
+	SmallVector<Keyframe> keyframes;
+	SmallVector<AnimationOffset> animations;
+	BakedAnimations(NUM_ANIMATIONS, keyframes, animations, rng);
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+
+	CompressedAnimations compressed;
+	for (auto& anim : animations)
+	{
+		compressed.Add(Span(keyframes.data() + anim.BegOffset, anim.EndOffset - anim.BegOffset),
+			anim.BegTimeOffset);
+	}
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+	const double compressMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+	const size_t uncompressedBytes = keyframes.size() * sizeof(Keyframe) + animations.size() * sizeof(AnimationOffset);
+	const size_t compressedBytes = compressed.SizeInBytes();
+
+	// error against the original curves at 60 fps
+	double sumDiff = 0.0;
+	double sumAngle = 0.0;
+	float maxDiff = 0.0f;
+	float maxAngle = 0.0f;
+	size_t numSamples = 0;
+
+	for (size_t i = 0; i < animations.size(); i += 10)
+	{
+		const AnimationOffset& anim = animations[i];
+		const float end = keyframes[anim.EndOffset - 1].Time + anim.BegTimeOffset;
+
+		for (float t = anim.BegTimeOffset; t <= end; t += 1.0f / 60.0f)
+		{
+			float diff;
+			float angle;
+			TransformError(compressed.Sample(i, t), SampleReference(keyframes, anim, t), diff, angle);
+
+			sumDiff += diff;
+			sumAngle += angle;
+			maxDiff = Max(maxDiff, diff);
+			maxAngle = Max(maxAngle, angle);
+			numSamples++;
+		}
+	}
+
+	// decode throughput -- same sampler on uncompressed and compressed animations
+	SmallVector<AffineTransformation> out;
+	out.resize(animations.size());
+	double ms[2] = { 0.0, 0.0 };
+
+	for (int method = 0; method < 2; method++)
+	{
+		AnimationSampler sampler;
+
+		// first frame is for warm up
+		for (int frame = 0; frame < NUM_FRAMES + 1; frame++)
+		{
+			const float t = 2.0f + frame / 60.0f;
+			auto f0 = std::chrono::high_resolution_clock::now();
+
+			if (method == 0)
+				sampler.Sample(keyframes, animations, t, out);
+			else
+				sampler.Sample(compressed, t, out);
+
+			auto f1 = std::chrono::high_resolution_clock::now();
+
+			if (frame > 0)
+				ms[method] += std::chrono::duration<double, std::milli>(f1 - f0).count();
+		}
+	}
+
+	MESSAGE(NUM_ANIMATIONS, " baked animations, ", keyframes.size(), " keyframes: ", uncompressedBytes / 1024, 
+		" KB -> ", compressedBytes / 1024, " KB (", (double)uncompressedBytes / compressedBytes, "x, ", 
+		compressed.NumKeyframes(), " keyframes over all tracks) in ", compressMs, " ms");
+	MESSAGE("error -- scale/translation: max ", maxDiff, ", avg ", sumDiff / numSamples, "; rotation (radians): max ", 
+		maxAngle, ", avg ", sumAngle / numSamples);
+	MESSAGE("sampling: uncompressed ", ms[0] / NUM_FRAMES, " ms/frame, compressed ", ms[1] / NUM_FRAMES, 
+		" ms/frame (", NUM_ANIMATIONS * NUM_FRAMES / (ms[1] * 1e-3) / 1e6, " M animations/s)");
+
+	CHECK(compressedBytes * 3 < uncompressedBytes);
+	CHECK(maxDiff < 1.05e-4f);
+	CHECK(maxAngle < 5.5e-4f);
+}
+
+TEST_CASE("Skinning")
+{
+	RNG rng(41);
+
+	SUBCASE("Bind pose")
+	{
+		Skeleton skeleton;
+		SmallVector<AffineTransformation> bindPose;
+		RandomSkeleton(50, skeleton, bindPose, rng);
+
+		SmallVector<float4x3> palette;
+		palette.resize(50);
+		EvaluatePose(skeleton, bindPose, palette);
+
+		// every skinning matrix should be identity
+		float maxDiff = 0.0f;
+		const float4x3 I(store(identity()));
+
+		for (auto& M : palette)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				maxDiff = Max(maxDiff, fabsf(M.m[i].x - I.m[i].x));
+				maxDiff = Max(maxDiff, fabsf(M.m[i].y - I.m[i].y));
+				maxDiff = Max(maxDiff, fabsf(M.m[i].z - I.m[i].z));
+			}
+		}
+
+		CHECK(maxDiff < 1e-4f);
+	}
+
+	SUBCASE("Matches reference")
+	{
+		constexpr int NUM_JOINTS = 40;
+		Skeleton skeleton;
+		SmallVector<AffineTransformation> bindPose;
+		RandomSkeleton(NUM_JOINTS, skeleton, bindPose, rng);
+
+		// animated pose with uniform scale
+		SmallVector<AffineTransformation> pose;
+		pose.resize(NUM_JOINTS);
+		for (auto& tr : pose)
+		{
+			tr = RandomTransform(rng);
+			tr.Translation = tr.Translation * 0.1f;
+		}
+
+		SmallVector<float4x3> palette;
+		palette.resize(NUM_JOINTS);
+		EvaluatePose(skeleton, pose, palette);
+
+		// not a multiple of the batch size
+		SmallVector<Core::Vertex> vertices;
+		SmallVector<SkinInfluence> influences;
+		RandomSkinnedMesh(1001, NUM_JOINTS, vertices, influences, rng);
+
+		SmallVector<DualQuaternion> dualQuats;
+		for (auto& M : palette)
+			dualQuats.push_back(ToDualQuaternion(M));
+
+		SmallVector<Core::Vertex> lbs;
+		SmallVector<Core::Vertex> dqs;
+		lbs.resize(vertices.size());
+		dqs.resize(vertices.size());
+		SkinLinearBlend(vertices, influences, palette, lbs);
+		SkinDualQuaternion(vertices, influences, dualQuats, dqs);
+
+		int numLbsMismatches = 0;
+		int numDqsMismatches = 0;
+		int numRigidMismatches = 0;
+
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			numLbsMismatches += !ApproxEqual(lbs[i], SkinLinearBlendReference(vertices[i], influences[i], palette), 1e-3f);
+			numDqsMismatches += !ApproxEqual(dqs[i], SkinDualQuaternionReference(vertices[i], influences[i], palette), 1e-3f);
+
+			// with a single influence, both are the same rigid transformation
+			if (influences[i].Weights[1] == 0.0f)
+				numRigidMismatches += !ApproxEqual(lbs[i], dqs[i], 1e-3f);
+		}
+
+		CHECK(numLbsMismatches == 0);
+		CHECK(numDqsMismatches == 0);
+		CHECK(numRigidMismatches == 0);
+	}
+
+	SUBCASE("Twist keeps volume")
+	{
+		// second joint is twisted 180 degrees around the bone (x axis). Vertices halfway between the two
+		// collapse onto the axis with linear blending, but not with dual quaternions.
+		float4x3 palette[2];
+		palette[0] = float4x3(store(identity()));
+		float3 s(1.0f);
+		float4 q = storeFloat4(rotationQuat(float3(1.0f, 0.0f, 0.0f), PI));
+		float3 t(0.0f);
+		palette[1] = float4x3(store(affineTransformation(s, q, t)));
+
+		Core::Vertex v;
+		v.Position = float3(0.5f, 1.0f, 0.0f);
+		v.Normal = half3(float3(0.0f, 1.0f, 0.0f));
+		v.Tangent = half3(float3(1.0f, 0.0f, 0.0f));
+		v.TexUV = float2(0.0f);
+		SkinInfluence influence{ .Joints = { 0, 1, 0, 0 }, .Weights = { 0.5f, 0.5f, 0.0f, 0.0f } };
+
+		DualQuaternion dualQuats[2] = { ToDualQuaternion(palette[0]), ToDualQuaternion(palette[1]) };
+		Core::Vertex lbs;
+		Core::Vertex dqs;
+		SkinLinearBlend(Span(&v, 1), Span(&influence, 1), palette, Span(&lbs, 1));
+		SkinDualQuaternion(Span(&v, 1), Span(&influence, 1), dualQuats, Span(&dqs, 1));
+
+		auto distToAxis = [](const float3& p) { return sqrtf(p.y * p.y + p.z * p.z); };
+		CHECK(distToAxis(lbs.Position) < 1e-4f);
+		CHECK(fabsf(distToAxis(dqs.Position) - 1.0f) < 1e-4f);
+		CHECK(fabsf(dqs.Position.x - 0.5f) < 1e-4f);
+	}
+
+	SUBCASE("Normals under non-uniform scale")
+	{
+		// normal stays perpendicular to the surface (tangent), which doesn't hold if it's 
+		// transformed like the tangent
+		float3 s(4.0f, 1.0f, 0.5f);
+		float4 q = storeFloat4(rotationQuat(float3(0.0f, 0.0f, 1.0f), 0.3f));
+		float3 t(1.0f, 2.0f, 3.0f);
+		float4x3 palette[1] = { float4x3(store(affineTransformation(s, q, t))) };
+		DualQuaternion dualQuats[1] = { ToDualQuaternion(palette[0]) };
+
+		Core::Vertex v;
+		v.Position = float3(0.0f);
+		v.Normal = half3(float3(0.70710678f, 0.70710678f, 0.0f));
+		v.Tangent = half3(float3(0.70710678f, -0.70710678f, 0.0f));
+		v.TexUV = float2(0.0f);
+		SkinInfluence influence{ .Joints = { 0, 0, 0, 0 }, .Weights = { 1.0f, 0.0f, 0.0f, 0.0f } };
+
+		Core::Vertex lbs;
+		Core::Vertex dqs;
+		SkinLinearBlend(Span(&v, 1), Span(&influence, 1), palette, Span(&lbs, 1));
+		SkinDualQuaternion(Span(&v, 1), Span(&influence, 1), dualQuats, Span(&dqs, 1));
+
+		for (auto& skinned : { lbs, dqs })
+		{
+			float3 n(skinned.Normal);
+			float3 tangent(skinned.Tangent);
+
+			CHECK(fabsf(n.dot(tangent)) < 2e-3f);
+			CHECK(fabsf(n.length() - 1.0f) < 2e-3f);
+		}
+	}
+
+	SUBCASE("Parallel matches serial")
+	{
+		constexpr int NUM_MESHES = 24;
+		constexpr int NUM_JOINTS = 30;
+		SmallVector<float4x3> palettes[3];
+		SmallVector<Core::Vertex> vertices[NUM_MESHES];
+		SmallVector<SkinInfluence> influences[NUM_MESHES];
+		SmallVector<Core::Vertex> serial[NUM_MESHES];
+		SmallVector<Core::Vertex> parallel[NUM_MESHES];
+
+		for (auto& palette : palettes)
+		{
+			for (int j = 0; j < NUM_JOINTS; j++)
+			{
+				AffineTransformation tr = RandomTransform(rng);
+				palette.push_back(float4x3(store(affineTransformation(tr.Scale, tr.Rotation, tr.Translation))));
+			}
+		}
+
+		SmallVector<MeshSkinner::Mesh> serialMeshes;
+		SmallVector<MeshSkinner::Mesh> parallelMeshes;
+
+		for (int i = 0; i < NUM_MESHES; i++)
+		{
+			RandomSkinnedMesh(1000 + (int)rng.GetUniformUintBounded(4 * (int)MeshSkinner::MIN_VERTICES_PER_JOB), 
+				NUM_JOINTS, vertices[i], influences[i], rng);
+			serial[i].resize(vertices[i].size());
+			parallel[i].resize(vertices[i].size());
+
+			// consecutive meshes share palettes
+			MeshSkinner::Mesh mesh{ .Vertices = vertices[i].data(), .Influences = influences[i].data(), 
+				.Out = serial[i].data(), .NumVertices = (uint32_t)vertices[i].size(),
+				.Palette = palettes[(i / 4) % 3].data(), .NumJoints = NUM_JOINTS };
+			serialMeshes.push_back(mesh);
+
+			mesh.Out = parallel[i].data();
+			parallelMeshes.push_back(mesh);
+		}
+
+		for (auto method : { SKINNING_METHOD::LINEAR_BLEND, SKINNING_METHOD::DUAL_QUATERNION })
+		{
+			MeshSkinner serialSkinner;
+			MeshSkinner parallelSkinner;
+			serialSkinner.Skin(serialMeshes, method);
+			parallelSkinner.Skin(parallelMeshes, method, ThreadExecutor(4));
+
+			// Vertex has padding, so compare member by member
+			int numMismatches = 0;
+			for (int i = 0; i < NUM_MESHES; i++)
+			{
+				for (size_t v = 0; v < serial[i].size(); v++)
+				{
+					const Core::Vertex& a = serial[i][v];
+					const Core::Vertex& b = parallel[i][v];
+					numMismatches += memcmp(&a.Position, &b.Position, sizeof(a.Position)) != 0 || 
+						memcmp(&a.Normal, &b.Normal, sizeof(a.Normal)) != 0 ||
+						memcmp(&a.Tangent, &b.Tangent, sizeof(a.Tangent)) != 0;
+				}
+			}
+
+			CHECK(numMismatches == 0);
+		}
+	}
+}
+
+TEST_CASE("Skinning benchmark" * doctest::skip())
+{
+	RNG rng(41);
+
+	// a crowd of characters with ~20k vertices and 64 joints each
+	constexpr int NUM_MESHES = 50;
+	constexpr int NUM_VERTICES = 20000;
+	constexpr int NUM_JOINTS = 64;
+	constexpr int NUM_FRAMES = 20;
+
+	Skeleton skeleton;
+	SmallVector<AffineTransformation> bindPose;
+	RandomSkeleton(NUM_JOINTS, skeleton, bindPose, rng);
+
+	SmallVector<Core::Vertex> vertices;
+	SmallVector<SkinInfluence> influences;
+	RandomSkinnedMesh(NUM_VERTICES, NUM_JOINTS, vertices, influences, rng);
+
+	SmallVector<float4x3> palettes[NUM_MESHES];
+	SmallVector<Core::Vertex> out[NUM_MESHES];
+	SmallVector<MeshSkinner::Mesh> meshes;
+
+	for (int i = 0; i < NUM_MESHES; i++)
+	{
+		SmallVector<AffineTransformation> pose;
+		pose.resize(NUM_JOINTS);
+		for (auto& tr : pose)
+		{
+			tr = RandomTransform(rng);
+			tr.Translation = tr.Translation * 0.1f;
+		}
+
+		palettes[i].resize(NUM_JOINTS);
+		EvaluatePose(skeleton, pose, palettes[i]);
+		out[i].resize(NUM_VERTICES);
+
+		meshes.push_back(MeshSkinner::Mesh{ .Vertices = vertices.data(), .Influences = influences.data(), 
+			.Out = out[i].data(), .NumVertices = NUM_VERTICES, .Palette = palettes[i].data(), .NumJoints = NUM_JOINTS });
+	}
+
+	const int numThreads = Min(Max((int)std::thread::hardware_concurrency(), 1), MeshSkinner::MAX_NUM_JOBS);
+	// scalar reference, linear blend, dual quaternion, both with numThreads threads
+	double ms[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+	for (int method = 0; method < 5; method++)
+	{
+		MeshSkinner skinner;
+		const SKINNING_METHOD m = method == 2 || method == 4 ? SKINNING_METHOD::DUAL_QUATERNION : SKINNING_METHOD::LINEAR_BLEND;
+		// scalar reference is too slow to run for every frame
+		const int numFrames = method == 0 ? 1 : NUM_FRAMES;
+
+		// first frame is for warm up
+		for (int frame = 0; frame < numFrames + 1; frame++)
+		{
+			auto t0 = std::chrono::high_resolution_clock::now();
+
+			if (method == 0)
+			{
+				for (auto& mesh : meshes)
+				{
+					for (uint32_t v = 0; v < mesh.NumVertices; v++)
+					{
+						mesh.Out[v] = SkinLinearBlendReference(mesh.Vertices[v], mesh.Influences[v], 
+							Span(mesh.Palette, mesh.NumJoints));
+					}
+				}
+			}
+			else if (method < 3)
+				skinner.Skin(meshes, m);
+			else
+				skinner.Skin(meshes, m, ThreadExecutor(numThreads));
+
+			auto t1 = std::chrono::high_resolution_clock::now();
+
+			if (frame > 0)
+				ms[method] += std::chrono::duration<double, std::milli>(t1 - t0).count() / numFrames;
+		}
+	}
+
+	constexpr double NUM_TOTAL_VERTICES = (double)NUM_MESHES * NUM_VERTICES;
+	auto mvps = [NUM_TOTAL_VERTICES](double ms) { return NUM_TOTAL_VERTICES / (ms * 1e-3) / 1e6; };
+
+	MESSAGE(NUM_MESHES, " meshes x ", NUM_VERTICES, " vertices, ", NUM_JOINTS, " joints: scalar linear blend ", 
+		ms[0], " ms (", mvps(ms[0]), " M vertices/s), 8-wide linear blend ", ms[1], " ms (", mvps(ms[1]), 
+		" M vertices/s), 8-wide dual quaternion ", ms[2], " ms (", mvps(ms[2]), " M vertices/s)");
+	MESSAGE("with ", numThreads, " threads: linear blend ", ms[3], " ms (", mvps(ms[3]), " M vertices/s), dual quaternion ", 
+		ms[4], " ms (", mvps(ms[4]), " M vertices/s)");
+
+	CHECK(ms[1] < ms[0]);
+}
+
+TEST_CASE("SceneSnapshot")
+{
+	Model::glTF::SceneSnapshot snapshot;
+	const char bufferURIs[] = "scene.bin\0textures.bin";
+	snapshot.BufferURIs.append_range(bufferURIs, bufferURIs + sizeof(bufferURIs));
+	snapshot.BufferHash = 1234;
+
+	// two meshes
+	constexpr uint32_t NUM_VERTICES_PER_MESH = 15;
+	snapshot.Vertices.resize(2 * NUM_VERTICES_PER_MESH);
+	snapshot.Indices.resize(2 * NUM_VERTICES_PER_MESH);
+
+	for (uint32_t i = 0; i < 2 * NUM_VERTICES_PER_MESH; i++)
+	{
+		snapshot.Vertices[i].Position = float3((float)(i % 7), i * 0.5f, (float)(i % 3));
+		snapshot.Indices[i] = i % NUM_VERTICES_PER_MESH;
+	}
+
+	snapshot.Meshes.resize(2);
+	snapshot.MeshBVHs.resize(2);
+
+	// second mesh has one (made up) LOD
+	snapshot.LODs.push_back(Model::MeshLOD{ .IdxOffset = 0, .NumIndices = 3, .Error = 0.5f });
+	const uint32_t lodIndices[] = { 0, 1, 2 };
+	snapshot.LODIndices.append_range(lodIndices, lodIndices + 3);
+
+	for (uint32_t m = 0; m < 2; m++)
+	{
+		snapshot.Meshes[m] = Model::glTF::Asset::MeshSubset{ .MaterialIdx = (int)m, .MeshIdx = (int)m, .MeshPrimIdx = 0,
+			.BaseVtxOffset = m * NUM_VERTICES_PER_MESH, .BaseIdxOffset = m * NUM_VERTICES_PER_MESH,
+			.NumVertices = NUM_VERTICES_PER_MESH, .NumIndices = NUM_VERTICES_PER_MESH, 
+			.BaseLODOffset = 0, .BaseLODIdxOffset = 0, .NumLODs = m, .NumLODIndices = 3 * m };
+
+		snapshot.MeshBVHs[m].Build(Span(snapshot.Vertices.begin() + m * NUM_VERTICES_PER_MESH, NUM_VERTICES_PER_MESH),
+			Span(snapshot.Indices.begin() + m * NUM_VERTICES_PER_MESH, NUM_VERTICES_PER_MESH));
+	}
+
+	const char imageURIs[] = "a.dds\0\0b.dds";
+	snapshot.ImageURIs.append_range(imageURIs, imageURIs + sizeof(imageURIs));
+	snapshot.Materials.resize(2);
+	snapshot.Materials[1].BaseColorTexPath = 2;
+
+	snapshot.Instances.resize(3);
+	snapshot.Instances[2].ID = 99;
+
+	// snapshot doesn't have to start at the beginning of the buffer
+	constexpr uint64_t CONTENT_HASH = 42;
+	SmallVector<uint8_t> data;
+	data.resize(3);
+	Model::glTF::SerializeSceneSnapshot(snapshot, CONTENT_HASH, data);
+
+	SUBCASE("Round trip")
+	{
+		Model::glTF::SceneSnapshot loaded;
+		REQUIRE(Model::glTF::DeserializeSceneSnapshot(data.begin() + 3, data.end(), CONTENT_HASH, loaded));
+
+		CHECK(loaded.BufferURIs.size() == sizeof(bufferURIs));
+		CHECK(memcmp(loaded.BufferURIs.begin(), bufferURIs, sizeof(bufferURIs)) == 0);
+		CHECK(loaded.BufferHash == snapshot.BufferHash);
+		CHECK(loaded.Vertices.size() == snapshot.Vertices.size());
+		CHECK(memcmp(loaded.Vertices.begin(), snapshot.Vertices.begin(), snapshot.Vertices.size() * sizeof(Core::Vertex)) == 0);
+		CHECK(memcmp(loaded.Indices.begin(), snapshot.Indices.begin(), snapshot.Indices.size() * sizeof(uint32_t)) == 0);
+		CHECK(loaded.Meshes.size() == 2);
+		CHECK(loaded.Meshes[1].NumLODs == 1);
+		CHECK(loaded.LODs.size() == 1);
+		CHECK(loaded.LODs[0].Error == 0.5f);
+		CHECK(std::equal(loaded.LODIndices.begin(), loaded.LODIndices.end(), lodIndices, lodIndices + 3));
+		CHECK(loaded.MeshBVHs[1].GetNumTriangles() == NUM_VERTICES_PER_MESH / 3);
+		CHECK(memcmp(loaded.ImageURIs.begin(), imageURIs, sizeof(imageURIs)) == 0);
+		CHECK(loaded.Materials[1].BaseColorTexPath == 2);
+		CHECK(loaded.Materials[0].BaseColorTexPath == uint64_t(-1));
+		CHECK(loaded.Instances.size() == 3);
+		CHECK(loaded.Instances[2].ID == 99);
+	}
+
+	SUBCASE("Stale or truncated")
+	{
+		Model::glTF::SceneSnapshot loaded;
+		CHECK(!Model::glTF::DeserializeSceneSnapshot(data.begin() + 3, data.end(), CONTENT_HASH + 1, loaded));
+
+		for (size_t n = 0; n < data.size() - 3; n += 5)
+			CHECK(!Model::glTF::DeserializeSceneSnapshot(data.begin() + 3, data.begin() + 3 + n, CONTENT_HASH, loaded));
+	}
+
+	SUBCASE("Buffer changes")
+	{
+		RNG rng(5);
+		SmallVector<uint8_t> small;
+		SmallVector<uint8_t> large;
+		small.resize(1000);
+		large.resize(10 * 1024 * 1024);
+
+		for (auto& b : small)
+			b = (uint8_t)rng.GetUniformUintBounded(256);
+		for (auto& b : large)
+			b = (uint8_t)rng.GetUniformUintBounded(256);
+
+		constexpr uint64_t WRITE_TIME = 77;
+		const uint64_t h = Model::glTF::HashBuffer(small.begin(), small.size(), WRITE_TIME, 0);
+		const uint64_t hLarge = Model::glTF::HashBuffer(large.begin(), large.size(), WRITE_TIME, h);
+
+		CHECK(Model::glTF::HashBuffer(small.begin(), small.size(), WRITE_TIME, 0) == h);
+		CHECK(Model::glTF::HashBuffer(small.begin(), small.size(), WRITE_TIME + 1, 0) != h);
+		CHECK(Model::glTF::HashBuffer(small.begin(), small.size() - 1, WRITE_TIME, 0) != h);
+		CHECK(Model::glTF::HashBuffer(large.begin(), large.size(), WRITE_TIME, 0) != hLarge);
+
+		// small buffers are hashed as a whole
+		small[517]++;
+		CHECK(Model::glTF::HashBuffer(small.begin(), small.size(), WRITE_TIME, 0) != h);
+
+		// large ones are sampled, which always includes the beginning and the end
+		large[10]++;
+		CHECK(Model::glTF::HashBuffer(large.begin(), large.size(), WRITE_TIME, h) != hLarge);
+		large[10]--;
+		large[large.size() - 1]++;
+		CHECK(Model::glTF::HashBuffer(large.begin(), large.size(), WRITE_TIME, h) != hLarge);
+	}
+}
+
+TEST_CASE("SceneSnapshot benchmark" * doctest::skip())
+{
+	constexpr uint64_t CONTENT_HASH = 42;
+
+	// cold -- processing that a load from the cache skips (the rest, e.g. parsing JSON and decoding 
+	// accessors, isn't included), warm -- reading it back
+	constexpr uint32_t GRID_SIZE = 512;
+	Model::glTF::SceneSnapshot cold;
+	cold.Vertices.resize((GRID_SIZE + 1) * (GRID_SIZE + 1));
+
+	for (uint32_t i = 0; i < cold.Vertices.size(); i++)
+	{
+		const float x = (float)(i / (GRID_SIZE + 1));
+		const float z = (float)(i % (GRID_SIZE + 1));
+		cold.Vertices[i].Position = float3(x, sinf(x * 0.1f) * cosf(z * 0.1f) * 10.0f, z);
+	}
+
+	for (uint32_t x = 0; x < GRID_SIZE; x++)
+	{
+		for (uint32_t z = 0; z < GRID_SIZE; z++)
+		{
+			const uint32_t v0 = x * (GRID_SIZE + 1) + z;
+			const uint32_t quad[6] = { v0, v0 + 1, v0 + GRID_SIZE + 1, v0 + 1, v0 + GRID_SIZE + 2, v0 + GRID_SIZE + 1 };
+			cold.Indices.append_range(quad, quad + 6);
+		}
+	}
+
+	const uint32_t numVertices = (uint32_t)cold.Vertices.size();
+	const uint32_t numIndices = (uint32_t)cold.Indices.size();
+	cold.Meshes.push_back(Model::glTF::Asset::MeshSubset{ .BaseVtxOffset = 0, .BaseIdxOffset = 0, 
+		.NumVertices = numVertices, .NumIndices = numIndices });
+	cold.MeshBVHs.resize(1);
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+
+	Model::MeshOptimizer::OptimizeVertexCache(cold.Indices, numVertices);
+	cold.MeshBVHs[0].Build(cold.Vertices, cold.Indices);
+
+	SmallVector<uint8_t> file;
+	Model::glTF::SerializeSceneSnapshot(cold, CONTENT_HASH, file);
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	Model::glTF::SceneSnapshot warm;
+	REQUIRE(Model::glTF::DeserializeSceneSnapshot(file.begin(), file.end(), CONTENT_HASH, warm));
+
+	auto t2 = std::chrono::high_resolution_clock::now();
+
+	MESSAGE(numIndices / 3, " triangles, ", file.size() / 1024, " KB snapshot: cold ", 
+		std::chrono::duration<double, std::milli>(t1 - t0).count(), " ms, warm ",
+		std::chrono::duration<double, std::milli>(t2 - t1).count(), " ms");
+
+	CHECK(warm.Indices.size() == cold.Indices.size());
+	CHECK(warm.MeshBVHs[0].GetNumTriangles() == numIndices / 3);
+}
+
+TEST_CASE("AccessorDecoding")
+{
+	using namespace Model::glTF;
+	RNG rng;
+
+	// interleaved and quantized: float3 position, normalized byte3 normal (+ padding), normalized
+	// ushort2 texture coordinates and normalized short4 tangent
+	struct QuantizedVertex
+	{
+		float Position[3];
+		int8_t Normal[3];
+		int8_t Pad;
+		uint16_t TexUV[2];
+		int16_t Tangent[4];
+		uint32_t Pad2;
+	};
+
+	static_assert(sizeof(QuantizedVertex) == 32);
+
+	// not a multiple of the batch size, so that the remainder is handled separately
+	constexpr size_t NUM_VERTICES = 1003;
+	SmallVector<QuantizedVertex> src;
+	src.resize(NUM_VERTICES);
+
+	for (auto& v : src)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			v.Position[c] = rng.GetUniformFloat() * 200.0f - 100.0f;
+			v.Normal[c] = (int8_t)(rng.GetUniformUintBounded(256) - 128);
+		}
+
+		for (int c = 0; c < 2; c++)
+			v.TexUV[c] = (uint16_t)rng.GetUniformUintBounded(65536);
+
+		for (int c = 0; c < 4; c++)
+			v.Tangent[c] = (int16_t)(rng.GetUniformUintBounded(65536) - 32768);
+	}
+
+	auto view = [&src](size_t offset, ACCESSOR_COMPONENT_TYPE t, bool normalized)
+		{
+			return AccessorView{ .Data = reinterpret_cast<const uint8_t*>(src.data()) + offset,
+				.Count = NUM_VERTICES,
+				.Stride = sizeof(QuantizedVertex),
+				.ComponentType = t,
+				.Normalized = normalized };
+		};
+
+	auto snorm = [](float v, float m) { return Max(v / m, -1.0f); };
+
+	SUBCASE("Strided and quantized attributes")
+	{
+		SmallVector<Core::Vertex> vertices;
+		vertices.resize(NUM_VERTICES);
+
+		DecodePositions(view(offsetof(QuantizedVertex, Position), ACCESSOR_COMPONENT_TYPE::FLOAT32, false), vertices);
+		DecodeNormals(view(offsetof(QuantizedVertex, Normal), ACCESSOR_COMPONENT_TYPE::INT8, true), vertices);
+		DecodeTexCoords(view(offsetof(QuantizedVertex, TexUV), ACCESSOR_COMPONENT_TYPE::UINT16, true), vertices);
+		DecodeTangents(view(offsetof(QuantizedVertex, Tangent), ACCESSOR_COMPONENT_TYPE::INT16, true), vertices);
+
+		// all at once
+		SmallVector<Core::Vertex> vertices2;
+		vertices2.resize(NUM_VERTICES);
+		DecodeVertices(VertexAccessors{ .Position = view(offsetof(QuantizedVertex, Position), ACCESSOR_COMPONENT_TYPE::FLOAT32, false),
+			.Normal = view(offsetof(QuantizedVertex, Normal), ACCESSOR_COMPONENT_TYPE::INT8, true),
+			.TexCoord = view(offsetof(QuantizedVertex, TexUV), ACCESSOR_COMPONENT_TYPE::UINT16, true),
+			.Tangent = view(offsetof(QuantizedVertex, Tangent), ACCESSOR_COMPONENT_TYPE::INT16, true) }, vertices2);
+
+		for (size_t i = 0; i < NUM_VERTICES; i++)
+		{
+			const QuantizedVertex& s = src[i];
+			const Core::Vertex& v = vertices[i];
+
+			CHECK(memcmp(&v, &vertices2[i], offsetof(Core::Vertex, Normal) + sizeof(half3)) == 0);
+			CHECK(memcmp(&v.TexUV, &vertices2[i].TexUV, sizeof(float2) + sizeof(half3)) == 0);
+
+			// z is flipped
+			CHECK(v.Position.x == s.Position[0]);
+			CHECK(v.Position.y == s.Position[1]);
+			CHECK(v.Position.z == -s.Position[2]);
+
+			CHECK(fabsf(HalfToFloat(v.Normal.x) - snorm(s.Normal[0], 127.0f)) < 1e-3f);
+			CHECK(fabsf(HalfToFloat(v.Normal.y) - snorm(s.Normal[1], 127.0f)) < 1e-3f);
+			CHECK(fabsf(HalfToFloat(v.Normal.z) + snorm(s.Normal[2], 127.0f)) < 1e-3f);
+
+			CHECK(fabsf(v.TexUV.x - s.TexUV[0] / 65535.0f) < 1e-6f);
+			CHECK(fabsf(v.TexUV.y - s.TexUV[1] / 65535.0f) < 1e-6f);
+
+			CHECK(fabsf(HalfToFloat(v.Tangent.x) - snorm(s.Tangent[0], 32767.0f)) < 1e-3f);
+			CHECK(fabsf(HalfToFloat(v.Tangent.y) - snorm(s.Tangent[1], 32767.0f)) < 1e-3f);
+			CHECK(fabsf(HalfToFloat(v.Tangent.z) + snorm(s.Tangent[2], 32767.0f)) < 1e-3f);
+		}
+	}
+
+	SUBCASE("Unnormalized integers")
+	{
+		SmallVector<Core::Vertex> vertices;
+		vertices.resize(NUM_VERTICES);
+
+		// tightly packed, so that reading the last elements four bytes at a time would go past the end
+		SmallVector<int8_t> positions;
+		for (auto& v : src)
+			positions.append_range(v.Normal, v.Normal + 3);
+
+		DecodePositions(AccessorView{ .Data = reinterpret_cast<const uint8_t*>(positions.data()), .Count = NUM_VERTICES,
+			.Stride = 3, .ComponentType = ACCESSOR_COMPONENT_TYPE::INT8, .Normalized = false }, vertices);
+		DecodeTexCoords(view(offsetof(QuantizedVertex, TexUV), ACCESSOR_COMPONENT_TYPE::UINT16, false), vertices);
+
+		for (size_t i = 0; i < NUM_VERTICES; i++)
+		{
+			CHECK(vertices[i].Position.x == (float)src[i].Normal[0]);
+			CHECK(vertices[i].Position.y == (float)src[i].Normal[1]);
+			CHECK(vertices[i].Position.z == -(float)src[i].Normal[2]);
+			CHECK(vertices[i].TexUV.x == (float)src[i].TexUV[0]);
+			CHECK(vertices[i].TexUV.y == (float)src[i].TexUV[1]);
+		}
+	}
+
+	SUBCASE("Indices")
+	{
+		// not a multiple of the group size (24)
+		constexpr size_t NUM_INDICES = 3 * 37;
+		SmallVector<uint32_t> expected;
+		expected.resize(NUM_INDICES);
+
+		auto check = [&expected](const void* data, ACCESSOR_COMPONENT_TYPE t, uint32_t size)
+			{
+				SmallVector<uint32_t> indices;
+				indices.resize(NUM_INDICES);
+				DecodeIndices(AccessorView{ .Data = reinterpret_cast<const uint8_t*>(data), .Count = NUM_INDICES,
+					.Stride = size, .ComponentType = t, .Normalized = false }, indices);
+
+				for (size_t i = 0; i < NUM_INDICES; i += 3)
+				{
+					// winding is reversed
+					CHECK(indices[i] == expected[i]);
+					CHECK(indices[i + 1] == expected[i + 2]);
+					CHECK(indices[i + 2] == expected[i + 1]);
+				}
+			};
+
+		SmallVector<uint8_t> u8;
+		SmallVector<uint16_t> u16;
+		SmallVector<uint32_t> u32;
+
+		for (size_t i = 0; i < NUM_INDICES; i++)
+		{
+			expected[i] = rng.GetUniformUintBounded(256);
+			u8.push_back((uint8_t)expected[i]);
+		}
+
+		check(u8.data(), ACCESSOR_COMPONENT_TYPE::UINT8, 1);
+
+		for (size_t i = 0; i < NUM_INDICES; i++)
+		{
+			expected[i] = rng.GetUniformUintBounded(65536);
+			u16.push_back((uint16_t)expected[i]);
+		}
+
+		check(u16.data(), ACCESSOR_COMPONENT_TYPE::UINT16, 2);
+
+		for (size_t i = 0; i < NUM_INDICES; i++)
+		{
+			expected[i] = rng.GetUniformUint();
+			u32.push_back(expected[i]);
+		}
+
+		check(u32.data(), ACCESSOR_COMPONENT_TYPE::UINT32, 4);
+	}
+}
+
+TEST_CASE("AccessorDecoding benchmark" * doctest::skip())
+{
+	using namespace Model::glTF;
+	RNG rng;
+
+	constexpr size_t NUM_BENCH_VERTICES = 2'000'000;
+	constexpr size_t NUM_BENCH_INDICES = 3 * NUM_BENCH_VERTICES;
+
+	// float3 position, float3 normal, float2 texture coordinates and float4 tangent
+	constexpr size_t NUM_FLOATS_PER_VERTEX = 12;
+	SmallVector<float> attribs;
+	attribs.resize(NUM_BENCH_VERTICES * NUM_FLOATS_PER_VERTEX);
+	for (auto& f : attribs)
+		f = rng.GetUniformFloat() * 2.0f - 1.0f;
+
+	// same attributes quantized to short4 position, normalized byte4 normal, normalized ushort2
+	// texture coordinates and normalized byte4 tangent
+	struct alignas(4) Quantized
+	{
+		int16_t Position[4];
+		int8_t Normal[4];
+		uint16_t TexUV[2];
+		int8_t Tangent[4];
+	};
+
+	SmallVector<Quantized> quantized;
+	quantized.resize(NUM_BENCH_VERTICES);
+
+	for (size_t i = 0; i < NUM_BENCH_VERTICES; i++)
+	{
+		const float* v = attribs.data() + i * NUM_FLOATS_PER_VERTEX;
+		Quantized& q = quantized[i];
+
+		for (int c = 0; c < 3; c++)
+		{
+			q.Position[c] = (int16_t)(v[c] * 1000.0f);
+			q.Normal[c] = (int8_t)(v[3 + c] * 127.0f);
+			q.Tangent[c] = (int8_t)(v[8 + c] * 127.0f);
+		}
+
+		q.TexUV[0] = (uint16_t)(fabsf(v[6]) * 65535.0f);
+		q.TexUV[1] = (uint16_t)(fabsf(v[7]) * 65535.0f);
+	}
+
+	SmallVector<uint32_t> srcIndices;
+	srcIndices.resize(NUM_BENCH_INDICES);
+	for (auto& idx : srcIndices)
+		idx = rng.GetUniformUintBounded(NUM_BENCH_VERTICES);
+
+	SmallVector<Core::Vertex> expected;
+	expected.resize(NUM_BENCH_VERTICES);
+	SmallVector<Core::Vertex> vertices;
+	vertices.resize(NUM_BENCH_VERTICES);
+	SmallVector<uint32_t> indices;
+	indices.resize(NUM_BENCH_INDICES);
+
+	auto floatView = [&attribs](size_t offset)
+		{
+			return AccessorView{ .Data = reinterpret_cast<const uint8_t*>(attribs.data() + offset),
+				.Count = NUM_BENCH_VERTICES,
+				.Stride = NUM_FLOATS_PER_VERTEX * sizeof(float),
+				.ComponentType = ACCESSOR_COMPONENT_TYPE::FLOAT32,
+				.Normalized = false };
+		};
+
+	auto quantizedView = [&quantized](size_t offset, ACCESSOR_COMPONENT_TYPE t, bool normalized)
+		{
+			return AccessorView{ .Data = reinterpret_cast<const uint8_t*>(quantized.data()) + offset,
+				.Count = NUM_BENCH_VERTICES,
+				.Stride = sizeof(Quantized),
+				.ComponentType = t,
+				.Normalized = normalized };
+		};
+
+	// one element at a time, same as before
+	auto t0 = std::chrono::high_resolution_clock::now();
+
+	for (size_t i = 0; i < NUM_BENCH_VERTICES; i++)
+	{
+		const float* v = attribs.data() + i * NUM_FLOATS_PER_VERTEX;
+		expected[i].Position = float3(v[0], v[1], -v[2]);
+		expected[i].Normal = half3(v[3], v[4], -v[5]);
+		expected[i].TexUV = float2(v[6], v[7]);
+		expected[i].Tangent = half3(v[8], v[9], -v[10]);
+	}
+
+	for (size_t i = 0; i < NUM_BENCH_INDICES; i += 3)
+	{
+		uint32_t i0, i1, i2;
+		memcpy(&i0, &srcIndices[i], sizeof(uint32_t));
+		memcpy(&i1, &srcIndices[i + 1], sizeof(uint32_t));
+		memcpy(&i2, &srcIndices[i + 2], sizeof(uint32_t));
+
+		indices[i] = i0;
+		indices[i + 1] = i2;
+		indices[i + 2] = i1;
+	}
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	DecodeVertices(VertexAccessors{ .Position = floatView(0),
+		.Normal = floatView(3),
+		.TexCoord = floatView(6),
+		.Tangent = floatView(8) }, vertices);
+	DecodeIndices(AccessorView{ .Data = reinterpret_cast<const uint8_t*>(srcIndices.data()),
+		.Count = NUM_BENCH_INDICES,
+		.Stride = sizeof(uint32_t),
+		.ComponentType = ACCESSOR_COMPONENT_TYPE::UINT32,
+		.Normalized = false }, indices);
+
+	auto t2 = std::chrono::high_resolution_clock::now();
+
+	bool matches = true;
+	for (size_t i = 0; i < NUM_BENCH_VERTICES; i++)
+	{
+		const Core::Vertex& a = vertices[i];
+		const Core::Vertex& b = expected[i];
+
+		matches = matches && a.Position.x == b.Position.x && a.Position.y == b.Position.y && a.Position.z == b.Position.z &&
+			a.Normal.x == b.Normal.x && a.Normal.y == b.Normal.y && a.Normal.z == b.Normal.z &&
+			a.TexUV.x == b.TexUV.x && a.TexUV.y == b.TexUV.y &&
+			a.Tangent.x == b.Tangent.x && a.Tangent.y == b.Tangent.y && a.Tangent.z == b.Tangent.z;
+	}
+
+	CHECK(matches);
+
+	DecodeVertices(VertexAccessors{ .Position = quantizedView(offsetof(Quantized, Position), ACCESSOR_COMPONENT_TYPE::INT16, false),
+		.Normal = quantizedView(offsetof(Quantized, Normal), ACCESSOR_COMPONENT_TYPE::INT8, true),
+		.TexCoord = quantizedView(offsetof(Quantized, TexUV), ACCESSOR_COMPONENT_TYPE::UINT16, true),
+		.Tangent = quantizedView(offsetof(Quantized, Tangent), ACCESSOR_COMPONENT_TYPE::INT8, true) }, vertices);
+
+	auto t3 = std::chrono::high_resolution_clock::now();
+
+	const double floatGB = (attribs.size() * sizeof(float) + srcIndices.size() * sizeof(uint32_t)) / 1e9;
+	const double quantizedGB = quantized.size() * sizeof(Quantized) / 1e9;
+
+	MESSAGE("Decoding ", NUM_BENCH_VERTICES, " vertices and ", NUM_BENCH_INDICES, " indices -- one at a time: ",
+		floatGB / std::chrono::duration<double>(t1 - t0).count(), " GB/s, batched: ", 
+		floatGB / std::chrono::duration<double>(t2 - t1).count(), " GB/s");
+	MESSAGE("Decoding ", NUM_BENCH_VERTICES, " quantized vertices: ", 
+		quantizedGB / std::chrono::duration<double>(t3 - t2).count(), " GB/s (",
+		NUM_BENCH_VERTICES / std::chrono::duration<double>(t3 - t2).count() / 1e6, " M vertices/s)");
+}
+
+TEST_CASE("MeshOptimizer")
+{
+	using namespace Model;
+	RNG rng;
+
+	// regular grid of quads on the xz plane, (v1 - v0) x (v2 - v0) of every triangle points to +y
+	constexpr uint32_t GRID_SIZE = 64;
+	constexpr uint32_t NUM_GRID_VERTICES = (GRID_SIZE + 1) * (GRID_SIZE + 1);
+	constexpr uint32_t NUM_UNUSED_VERTICES = 5;
+	constexpr uint32_t NUM_VERTICES = NUM_GRID_VERTICES + NUM_UNUSED_VERTICES;
+
+	// vertex IDs are shuffled, so that vertices aren't in the order they're used in
+	SmallVector<uint32_t> vertexPerm;
+	vertexPerm.resize(NUM_VERTICES);
+	for (uint32_t i = 0; i < NUM_VERTICES; i++)
+		vertexPerm[i] = i;
+
+	for (uint32_t i = NUM_VERTICES - 1; i > 0; i--)
+		std::swap(vertexPerm[i], vertexPerm[rng.GetUniformUintBounded(i + 1)]);
+
+	SmallVector<Core::Vertex> vertices;
+	vertices.resize(NUM_VERTICES);
+
+	for (uint32_t i = 0; i < NUM_VERTICES; i++)
+	{
+		const uint32_t x = i / (GRID_SIZE + 1);
+		const uint32_t z = i % (GRID_SIZE + 1);
+		vertices[vertexPerm[i]].Position = float3((float)x, 0.0f, (float)z);
+		vertices[vertexPerm[i]].TexUV = float2((float)i, 0.0f);
+	}
+
+	SmallVector<uint32_t> indices;
+
+	for (uint32_t x = 0; x < GRID_SIZE; x++)
+	{
+		for (uint32_t z = 0; z < GRID_SIZE; z++)
+		{
+			const uint32_t v0 = vertexPerm[x * (GRID_SIZE + 1) + z];
+			const uint32_t v1 = vertexPerm[x * (GRID_SIZE + 1) + z + 1];
+			const uint32_t v2 = vertexPerm[(x + 1) * (GRID_SIZE + 1) + z];
+			const uint32_t v3 = vertexPerm[(x + 1) * (GRID_SIZE + 1) + z + 1];
+
+			const uint32_t quad[6] = { v0, v1, v2, v2, v1, v3 };
+			indices.append_range(quad, quad + 6);
+		}
+	}
+
+	// a couple of degenerate triangles
+	const uint32_t degenerate[6] = { vertexPerm[0], vertexPerm[0], vertexPerm[1], vertexPerm[2], vertexPerm[2], vertexPerm[2] };
+	indices.append_range(degenerate, degenerate + 6);
+
+	// shuffle the triangles and rotate their vertices (winding is unchanged)
+	const uint32_t numTris = (uint32_t)indices.size() / 3;
+
+	for (uint32_t t = numTris - 1; t > 0; t--)
+	{
+		const uint32_t other = rng.GetUniformUintBounded(t + 1);
+		for (int k = 0; k < 3; k++)
+			std::swap(indices[3 * t + k], indices[3 * other + k]);
+
+		std::rotate(indices.begin() + 3 * t, indices.begin() + 3 * t + rng.GetUniformUintBounded(3), indices.begin() + 3 * t + 3);
+	}
+
+	// Triangles as sorted keys of their (original) vertex IDs, with the smallest ID first so that
+	// rotations compare equal while the winding still matters
+	auto triangleKeys = [](SmallVector<Core::Vertex>& verts, SmallVector<uint32_t>& idx)
+		{
+			SmallVector<uint64_t> keys;
+
+			for (size_t i = 0; i < idx.size(); i += 3)
+			{
+				uint64_t ids[3];
+				for (int k = 0; k < 3; k++)
+					ids[k] = (uint64_t)verts[idx[i + k]].TexUV.x;
+
+				std::rotate(ids, std::min_element(ids, ids + 3), ids + 3);
+				keys.push_back((ids[0] << 42) | (ids[1] << 21) | ids[2]);
+			}
+
+			std::sort(keys.begin(), keys.end());
+			return keys;
+		};
+
+	const SmallVector<uint64_t> expectedTris = triangleKeys(vertices, indices);
+
+	auto sameTriangles = [&]()
+		{
+			SmallVector<uint64_t> keys = triangleKeys(vertices, indices);
+			return std::equal(keys.begin(), keys.end(), expectedTris.begin(), expectedTris.end());
+		};
+	const auto before = MeshOptimizer::AnalyzeVertexCache(indices, NUM_VERTICES);
+
+	CHECK(before.NumTriangles == numTris);
+	CHECK(before.NumVertices == NUM_GRID_VERTICES);
+	// random order, practically every vertex misses
+	CHECK(before.ACMR() > 2.5f);
+
+	SUBCASE("Vertex cache, overdraw and vertex fetch")
+	{
+		MeshOptimizer::OptimizeVertexCache(indices, NUM_VERTICES);
+		const auto vertexCacheOpt = MeshOptimizer::AnalyzeVertexCache(indices, NUM_VERTICES);
+
+		CHECK(sameTriangles());
+		// a regular grid can at best reach 0.5 (each vertex is shared by six triangles)
+		CHECK(vertexCacheOpt.ACMR() < 0.8f);
+		CHECK(vertexCacheOpt.ATVR() < 1.6f);
+
+		MeshOptimizer::OptimizeOverdraw(indices, vertices, 1.05f);
+		const auto overdrawOpt = MeshOptimizer::AnalyzeVertexCache(indices, NUM_VERTICES);
+
+		CHECK(sameTriangles());
+		// cluster boundaries are where the cache is (nearly) flushed anyway
+		CHECK(overdrawOpt.ACMR() < 1.1f * vertexCacheOpt.ACMR());
+
+		SmallVector<uint32_t> remap;
+		remap.resize(NUM_VERTICES);
+		const uint32_t numReferenced = MeshOptimizer::OptimizeVertexFetchRemap(indices, remap);
+		MeshOptimizer::RemapVertices(Span(vertices), remap);
+
+		CHECK(numReferenced == NUM_GRID_VERTICES);
+		CHECK(sameTriangles());
+
+		// vertices are in the order of first use
+		uint32_t maxIdx = 0;
+		bool sequential = true;
+
+		for (uint32_t idx : indices)
+		{
+			sequential = sequential && idx <= maxIdx + 1;
+			maxIdx = Max(maxIdx, idx);
+		}
+
+		CHECK(sequential);
+		CHECK(maxIdx == NUM_GRID_VERTICES - 1);
+
+		// vertex cache efficiency doesn't depend on vertex IDs
+		const auto after = MeshOptimizer::AnalyzeVertexCache(indices, NUM_VERTICES);
+		CHECK(after.NumTransformedVertices == overdrawOpt.NumTransformedVertices);
+	}
+
+	SUBCASE("Front-facing clusters first")
+	{
+		// two parallel grids facing +y, the one above faces away from the mesh center (y = 0.5) and
+		// the one below toward it
+		const uint32_t numGridIndices = (uint32_t)indices.size();
+		const uint32_t numGridVertices = NUM_VERTICES;
+
+		for (uint32_t i = 0; i < numGridVertices; i++)
+		{
+			Core::Vertex v = vertices[i];
+			v.Position.y = 1.0f;
+			v.TexUV.x += NUM_VERTICES;
+			vertices.push_back(v);
+		}
+
+		for (uint32_t i = 0; i < numGridIndices; i++)
+			indices.push_back(indices[i] + numGridVertices);
+
+		MeshOptimizer::OptimizeVertexCache(indices, (uint32_t)vertices.size());
+		MeshOptimizer::OptimizeOverdraw(indices, vertices, 1.05f);
+
+		// top grid is more likely to occlude the other one and should be drawn first
+		bool topFirst = true;
+		for (uint32_t i = 0; i < numGridIndices; i++)
+			topFirst = topFirst && vertices[indices[i]].Position.y == 1.0f;
+
+		CHECK(topFirst);
+	}
+}
+
+namespace
+{
+	// Unit sphere centered at the origin, triangles are in clockwise order (as seen from outside)
+	void BuildSphere(uint32_t numRings, uint32_t numSegments, SmallVector<Core::Vertex>& vertices, SmallVector<uint32_t>& indices)
+	{
+		for (uint32_t i = 0; i <= numRings; i++)
+		{
+			const float theta = PI * i / numRings;
+			// positions at the poles and along the seam have to match exactly
+			const float sinTheta = i == 0 || i == numRings ? 0.0f : sinf(theta);
+			const float cosTheta = i == 0 ? 1.0f : (i == numRings ? -1.0f : cosf(theta));
+
+			for (uint32_t j = 0; j <= numSegments; j++)
+			{
+				const float phi = TWO_PI * (j % numSegments) / numSegments;
+				Core::Vertex v{};
+				v.Position = float3(sinTheta * cosf(phi), cosTheta, sinTheta * sinf(phi));
+				v.Normal = half3(v.Position);
+				// first and last column have the same positions, but different texture coordinates
+				v.TexUV = float2((float)j / numSegments, (float)i / numRings);
+				vertices.push_back(v);
+			}
+		}
+
+		for (uint32_t i = 0; i < numRings; i++)
+		{
+			for (uint32_t j = 0; j < numSegments; j++)
+			{
+				const uint32_t v0 = i * (numSegments + 1) + j;
+				const uint32_t v1 = v0 + 1;
+				const uint32_t v2 = v0 + numSegments + 1;
+				const uint32_t v3 = v2 + 1;
+				const uint32_t quad[6] = { v0, v1, v2, v2, v1, v3 };
+
+				for (int t = 0; t < 6; t += 3)
+				{
+					uint32_t tri[3] = { quad[t], quad[t + 1], quad[t + 2] };
+					float3 p0 = vertices[tri[0]].Position;
+					float3 n = (vertices[tri[1]].Position - p0).cross(vertices[tri[2]].Position - p0);
+
+					// (v1 - v0) x (v2 - v0) should point outward
+					if (n.dot(p0) < 0.0f)
+						std::swap(tri[1], tri[2]);
+
+					indices.append_range(tri, tri + 3);
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("Meshlets")
+{
+	using namespace Model;
+	RNG rng;
+
+	SmallVector<Core::Vertex> vertices;
+	SmallVector<uint32_t> indices;
+	BuildSphere(64, 128, vertices, indices);
+	MeshOptimizer::OptimizeVertexCache(indices, (uint32_t)vertices.size());
+
+	const uint32_t numTris = (uint32_t)indices.size() / 3;
+	SmallVector<Meshlet> meshlets;
+	SmallVector<uint32_t> meshletVertices;
+	SmallVector<uint8_t> meshletTriangles;
+	meshletTriangles.resize(3 * numTris);
+
+	BuildMeshlets(vertices, indices, meshlets, meshletVertices, meshletTriangles);
+
+	SUBCASE("Topology and bounds")
+	{
+		// every triangle belongs to exactly one meshlet, in order
+		uint32_t nextTri = 0;
+		uint32_t nextVertex = 0;
+		bool valid = true;
+
+		for (auto& m : meshlets)
+		{
+			valid = valid && m.TriangleOffset == nextTri && m.VertexOffset == nextVertex;
+			valid = valid && m.NumVertices <= Meshlet::MAX_NUM_VERTICES && m.NumTriangles <= Meshlet::MAX_NUM_TRIANGLES;
+			nextTri += m.NumTriangles;
+			nextVertex += m.NumVertices;
+
+			// decoded triangles match the index buffer
+			for (uint32_t t = m.TriangleOffset; t < m.TriangleOffset + m.NumTriangles; t++)
+			{
+				const uint32_t i0 = meshletTriangles[3 * t];
+				const uint32_t i1 = meshletTriangles[3 * t + 1];
+				const uint32_t i2 = meshletTriangles[3 * t + 2];
+				valid = valid && i0 < m.NumVertices && i1 < m.NumVertices && i2 < m.NumVertices;
+				valid = valid && meshletVertices[m.VertexOffset + i0] == indices[3 * t] &&
+					meshletVertices[m.VertexOffset + i1] == indices[3 * t + 1] &&
+					meshletVertices[m.VertexOffset + i2] == indices[3 * t + 2];
+			}
+		}
+
+		CHECK(valid);
+		CHECK(nextTri == numTris);
+		CHECK(nextVertex == meshletVertices.size());
+		// vertex cache-optimized order keeps the meshlets reasonably full
+		CHECK(meshlets.size() < 1.5f * numTris / Meshlet::MAX_NUM_TRIANGLES);
+
+		bool inSphere = true;
+		bool inCone = true;
+
+		for (auto& m : meshlets)
+		{
+			for (uint32_t i = 0; i < m.NumVertices; i++)
+			{
+				float3 d = vertices[meshletVertices[m.VertexOffset + i]].Position - m.Center;
+				inSphere = inSphere && d.length() <= m.Radius * 1.0001f;
+			}
+
+			if (m.ConeCutoff == 1.0f)
+				continue;
+
+			const float minCos = sqrtf(1.0f - m.ConeCutoff * m.ConeCutoff);
+
+			for (uint32_t t = m.TriangleOffset; t < m.TriangleOffset + m.NumTriangles; t++)
+			{
+				float3 p0 = vertices[indices[3 * t]].Position;
+				float3 n = (vertices[indices[3 * t + 1]].Position - p0).cross(vertices[indices[3 * t + 2]].Position - p0);
+				// skip the (nearly) degenerate triangles around the poles
+				if (n.length() <= FLT_EPSILON)
+					continue;
+
+				n.normalize();
+				inCone = inCone && n.dot(m.ConeAxis) >= minCos - 1e-4f;
+			}
+		}
+
+		CHECK(inSphere);
+		CHECK(inCone);
+	}
+
+	SUBCASE("Culling")
+	{
+		const ViewFrustum frustum(0.25f * PI, 1.5f, 0.1f, 100.0f);
+		const Plane planes[6] = { frustum.Left, frustum.Right, frustum.Top, frustum.Bottom, frustum.Near, frustum.Far };
+		size_t numVisible = 0;
+		bool conservative = true;
+
+		for (int iter = 0; iter < 50; iter++)
+		{
+			// random scale, rotation and translation for the mesh and a camera looking toward it
+			const float3 s(0.5f + rng.GetUniformFloat(), 0.5f + rng.GetUniformFloat(), 0.5f + rng.GetUniformFloat());
+			float3 axis = float3(rng.GetUniformFloat(), rng.GetUniformFloat(), rng.GetUniformFloat()) + float3(0.1f, 0.0f, 0.0f);
+			axis.normalize();
+			const __m128 vQ = rotationQuat(axis, rng.GetUniformFloat() * TWO_PI);
+			const float3 t(rng.GetUniformFloat() * 10.0f - 5.0f, rng.GetUniformFloat() * 10.0f - 5.0f, rng.GetUniformFloat() * 10.0f - 5.0f);
+			const v_float4x4 vWorld = affineTransformation(_mm_setr_ps(s.x, s.y, s.z, 0.0f), vQ, _mm_setr_ps(t.x, t.y, t.z, 0.0f));
+
+			const float4a camPos(rng.GetUniformFloat() * 8.0f - 4.0f, rng.GetUniformFloat() * 8.0f - 4.0f, rng.GetUniformFloat() * 8.0f - 4.0f, 1.0f);
+			const float4a focus(t.x + rng.GetUniformFloat() - 0.5f, t.y, t.z, 1.0f);
+			const v_float4x4 vView = lookAtLH(camPos, focus, float4a(0.0f, 1.0f, 0.0f, 0.0f));
+
+			const float4x4a objectToView = store(mul(vWorld, vView));
+			const v_float4x4 vObjectToView = load(objectToView);
+			const float3 camObj = storeFloat3(inverseSRT(vObjectToView).vRow[3]);
+
+			SmallVector<uint32_t> visible;
+			CullMeshlets(meshlets, frustum, objectToView, visible);
+			numVisible += visible.size();
+
+			// every culled meshlet is either entirely outside one of the frustum planes or all of its
+			// triangles are facing away from the camera
+			size_t currVisible = 0;
+
+			for (uint32_t m = 0; m < meshlets.size(); m++)
+			{
+				if (currVisible < visible.size() && visible[currVisible] == m)
+				{
+					currVisible++;
+					continue;
+				}
+
+				const Meshlet& meshlet = meshlets[m];
+				bool outsidePlane = false;
+
+				for (int p = 0; p < 6 && !outsidePlane; p++)
+				{
+					bool allOutside = true;
+
+					for (uint32_t i = 0; i < meshlet.NumVertices; i++)
+					{
+						float3 pos = vertices[meshletVertices[meshlet.VertexOffset + i]].Position;
+						float3 posView = storeFloat3(mul(vObjectToView, _mm_setr_ps(pos.x, pos.y, pos.z, 1.0f)));
+						float3 n = planes[p].Normal;
+						allOutside = allOutside && n.dot(posView) + planes[p].d < 0.0f;
+					}
+
+					outsidePlane = allOutside;
+				}
+
+				bool backFacing = true;
+
+				for (uint32_t tri = meshlet.TriangleOffset; tri < meshlet.TriangleOffset + meshlet.NumTriangles; tri++)
+				{
+					float3 p0 = vertices[indices[3 * tri]].Position;
+					float3 n = (vertices[indices[3 * tri + 1]].Position - p0).cross(vertices[indices[3 * tri + 2]].Position - p0);
+					backFacing = backFacing && n.dot(camObj - p0) <= 1e-5f;
+				}
+
+				conservative = conservative && (outsidePlane || backFacing);
+			}
+		}
+
+		CHECK(conservative);
+		// something was culled, but not everything
+		CHECK(numVisible > 0);
+		CHECK(numVisible < 50 * meshlets.size());
+	}
+}
+
+TEST_CASE("Meshlets benchmark" * doctest::skip())
+{
+	using namespace Model;
+
+	SmallVector<Core::Vertex> bigVertices;
+	SmallVector<uint32_t> bigIndices;
+	BuildSphere(512, 1024, bigVertices, bigIndices);
+	MeshOptimizer::OptimizeVertexCache(bigIndices, (uint32_t)bigVertices.size());
+
+	SmallVector<Meshlet> bigMeshlets;
+	SmallVector<uint32_t> bigMeshletVertices;
+	SmallVector<uint8_t> bigMeshletTriangles;
+	bigMeshletTriangles.resize(bigIndices.size());
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	BuildMeshlets(bigVertices, bigIndices, bigMeshlets, bigMeshletVertices, bigMeshletTriangles);
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	// camera inside the sphere's bounds looking at it from outside, roughly half the meshlets
+	// are back-facing
+	const ViewFrustum frustum(0.25f * PI, 1.5f, 0.1f, 100.0f);
+	const float4x4a objectToView = store(lookAtLH(float4a(0.0f, 0.0f, -3.0f, 1.0f), float4a(0.0f, 0.0f, 0.0f, 1.0f),
+		float4a(0.0f, 1.0f, 0.0f, 0.0f)));
+
+	constexpr int NUM_ITERATIONS = 20;
+	SmallVector<uint32_t> visible;
+
+	auto t2 = std::chrono::high_resolution_clock::now();
+
+	for (int i = 0; i < NUM_ITERATIONS; i++)
+	{
+		visible.clear();
+		CullMeshlets(bigMeshlets, frustum, objectToView, visible);
+	}
+
+	auto t3 = std::chrono::high_resolution_clock::now();
+
+	CHECK(visible.size() < bigMeshlets.size());
+
+	const double buildSec = std::chrono::duration<double>(t1 - t0).count();
+	const double cullSec = std::chrono::duration<double>(t3 - t2).count() / NUM_ITERATIONS;
+
+	MESSAGE("Meshlets -- built ", bigMeshlets.size(), " meshlets from ", bigIndices.size() / 3, " triangles in ", 
+		buildSec * 1e3, " ms (", bigIndices.size() / 3 / buildSec / 1e6, " M triangles/s), culling: ", cullSec * 1e6,
+		" us (", bigMeshlets.size() / cullSec / 1e6, " M meshlets/s), visible: ", visible.size());
+}
+
+namespace
+{
+	// Whether every edge has as many triangles on one side as on the other after the vertices with the
+	// same position are welded together
+	bool IsWatertight(Span<Core::Vertex> vertices, Span<uint32_t> indices)
+	{
+		auto lessThan = [&vertices](uint32_t a, uint32_t b)
+			{
+				const float3& pa = vertices[a].Position;
+				const float3& pb = vertices[b].Position;
+
+				return pa.x != pb.x ? pa.x < pb.x : (pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z);
+			};
+
+		std::vector<uint32_t> sorted(vertices.size());
+		for (uint32_t i = 0; i < (uint32_t)vertices.size(); i++)
+			sorted[i] = i;
+
+		std::sort(sorted.begin(), sorted.end(), lessThan);
+		std::vector<uint32_t> remap(vertices.size());
+
+		for (size_t i = 0; i < sorted.size(); i++)
+			remap[sorted[i]] = i > 0 && !lessThan(sorted[i - 1], sorted[i]) ? remap[sorted[i - 1]] : sorted[i];
+
+		std::vector<uint64_t> edges;
+		std::vector<uint64_t> opposite;
+
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			const uint64_t a = remap[indices[i]];
+			const uint64_t b = remap[indices[i - i % 3 + (i % 3 + 1) % 3]];
+
+			if (a == b)
+				continue;
+
+			edges.push_back((a << 32) | b);
+			opposite.push_back((b << 32) | a);
+		}
+
+		std::sort(edges.begin(), edges.end());
+		std::sort(opposite.begin(), opposite.end());
+
+		return edges == opposite;
+	}
+}
+
+TEST_CASE("MeshSimplifier")
+{
+	using namespace Model;
+
+	SmallVector<Core::Vertex> vertices;
+	SmallVector<uint32_t> indices;
+	BuildSphere(64, 128, vertices, indices);
+
+	SmallVector<MeshLOD> lods;
+	SmallVector<uint32_t> lodIndices;
+	MeshSimplifier::BuildLODs(vertices, indices, lods, lodIndices);
+
+	SUBCASE("Sphere")
+	{
+		REQUIRE(IsWatertight(vertices, indices));
+		CHECK(lods.size() >= 3);
+
+		size_t prevNumIndices = indices.size();
+		float prevError = 0.0f;
+
+		for (auto& lod : lods)
+		{
+			REQUIRE(lod.IdxOffset + lod.NumIndices <= lodIndices.size());
+			Span<uint32_t> lodIdx(lodIndices.begin() + lod.IdxOffset, lod.NumIndices);
+
+			CHECK(lod.NumIndices % 3 == 0);
+			CHECK(lod.NumIndices <= 0.75f * prevNumIndices);
+			CHECK(lod.Error > prevError);
+			// sphere has a radius of 1, error is limited to 5% of its extent
+			CHECK(lod.Error <= 0.1f);
+			// no holes, even along the texture seam
+			CHECK(IsWatertight(vertices, lodIdx));
+
+			// triangles don't cross the seam (which would stretch the whole texture over them) and
+			// stay close to the surface
+			bool seamKept = true;
+			float maxDeviation = 0.0f;
+
+			for (size_t i = 0; i < lodIdx.size(); i += 3)
+			{
+				const Core::Vertex& v0 = vertices[lodIdx[i]];
+				const Core::Vertex& v1 = vertices[lodIdx[i + 1]];
+				const Core::Vertex& v2 = vertices[lodIdx[i + 2]];
+
+				seamKept = seamKept && fabsf(v0.TexUV.x - v1.TexUV.x) < 0.5f && fabsf(v0.TexUV.x - v2.TexUV.x) < 0.5f;
+
+				float3 centroid = (v0.Position + v1.Position + v2.Position) * (1.0f / 3.0f);
+				maxDeviation = Max(maxDeviation, 1.0f - centroid.length());
+
+				// facing outward (up to round-off for slivers that are perpendicular to the surface)
+				float3 n = (v1.Position - v0.Position).cross(v2.Position - v0.Position);
+				seamKept = seamKept && n.dot(centroid) >= -1e-3f * n.length();
+			}
+
+			CHECK(seamKept);
+			CHECK(maxDeviation <= 4.0f * lod.Error);
+
+			prevNumIndices = lod.NumIndices;
+			prevError = lod.Error;
+		}
+	}
+
+	SUBCASE("Plane")
+	{
+		// flat grid with linearly varying texture coordinates -- interior and (non-corner) border
+		// vertices can be removed without any error
+		constexpr uint32_t N = 32;
+		SmallVector<Core::Vertex> gridVertices;
+		SmallVector<uint32_t> gridIndices;
+
+		for (uint32_t i = 0; i <= N; i++)
+		{
+			for (uint32_t j = 0; j <= N; j++)
+			{
+				Core::Vertex v{};
+				v.Position = float3((float)j / N, 0.0f, (float)i / N);
+				v.Normal = half3(0.0f, 1.0f, 0.0f);
+				v.TexUV = float2((float)j / N, (float)i / N);
+				gridVertices.push_back(v);
+			}
+		}
+
+		for (uint32_t i = 0; i < N; i++)
+		{
+			for (uint32_t j = 0; j < N; j++)
+			{
+				const uint32_t v0 = i * (N + 1) + j;
+				const uint32_t quad[6] = { v0, v0 + N + 1, v0 + 1, v0 + 1, v0 + N + 1, v0 + N + 2 };
+				gridIndices.append_range(quad, quad + 6);
+			}
+		}
+
+		SmallVector<uint32_t> simplified;
+		const float error = MeshSimplifier::Simplify(gridVertices, gridIndices, 0, 1e-3f, simplified);
+
+		CHECK(error <= 1e-3f);
+		CHECK(simplified.size() * 20 <= gridIndices.size());
+
+		// same area, no flipped triangles and the corners are kept
+		float area = 0.0f;
+		bool noFlips = true;
+		int numCorners = 0;
+		bool isCorner[(N + 1) * (N + 1)] = {};
+		isCorner[0] = isCorner[N] = isCorner[N * (N + 1)] = isCorner[(N + 1) * (N + 1) - 1] = true;
+
+		for (size_t i = 0; i < simplified.size(); i += 3)
+		{
+			float3 p0 = gridVertices[simplified[i]].Position;
+			float3 n = (gridVertices[simplified[i + 1]].Position - p0).cross(gridVertices[simplified[i + 2]].Position - p0);
+
+			area += 0.5f * n.length();
+			noFlips = noFlips && n.y > 0.0f;
+		}
+
+		for (uint32_t v = 0; v < (N + 1) * (N + 1); v++)
+		{
+			if (isCorner[v] && std::find(simplified.begin(), simplified.end(), v) != simplified.end())
+				numCorners++;
+		}
+
+		CHECK(fabsf(area - 1.0f) < 1e-4f);
+		CHECK(noFlips);
+		CHECK(numCorners == 4);
+	}
+
+	SUBCASE("SelectLOD")
+	{
+		REQUIRE(!lods.empty());
+
+		// 60 degree vertical field of view at 1080p, see Camera::GetPixelSpreadAngle()
+		const float pixelSpreadAngle = atanf(2.0f * tanf(PI / 6.0f) / 1080.0f);
+		constexpr float SCALE = 2.0f;
+
+		CHECK(MeshSimplifier::SelectLOD(lods, 0.0f, SCALE, pixelSpreadAngle) == 0);
+		CHECK(MeshSimplifier::SelectLOD(lods, 1e6f, SCALE, pixelSpreadAngle) == lods.size());
+
+		uint32_t prevLOD = 0;
+		bool monotonic = true;
+		bool withinError = true;
+
+		for (float distance = 0.1f; distance < 1e4f; distance *= 1.25f)
+		{
+			const uint32_t lod = MeshSimplifier::SelectLOD(lods, distance, SCALE, pixelSpreadAngle);
+			monotonic = monotonic && lod >= prevLOD;
+			prevLOD = lod;
+
+			// projected error of the selected LOD is at most one pixel, while the next one is more
+			const float pixelSize = distance * tanf(pixelSpreadAngle);
+
+			if (lod > 0)
+				withinError = withinError && lods[lod - 1].Error * SCALE <= pixelSize;
+			if (lod < lods.size())
+				withinError = withinError && lods[lod].Error * SCALE > pixelSize;
+		}
+
+		CHECK(monotonic);
+		CHECK(withinError);
+	}
+}
+
+TEST_CASE("MeshSimplifier benchmark" * doctest::skip())
+{
+	using namespace Model;
+
+	SmallVector<Core::Vertex> bigVertices;
+	SmallVector<uint32_t> bigIndices;
+	BuildSphere(256, 512, bigVertices, bigIndices);
+
+	SmallVector<MeshLOD> bigLODs;
+	SmallVector<uint32_t> bigLODIndices;
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	MeshSimplifier::BuildLODs(bigVertices, bigIndices, bigLODs, bigLODIndices);
+	auto t1 = std::chrono::high_resolution_clock::now();
+
+	CHECK(!bigLODs.empty());
+
+	const double buildSec = std::chrono::duration<double>(t1 - t0).count();
+	MESSAGE("MeshSimplifier -- built ", bigLODs.size(), " LODs from ", bigIndices.size() / 3, " triangles in ",
+		buildSec * 1e3, " ms (", bigIndices.size() / 3 / buildSec / 1e6, " M triangles/s)");
+
+	for (size_t i = 0; i < bigLODs.size(); i++)
+	{
+		MESSAGE("  LOD ", i + 1, ": ", bigLODs[i].NumIndices / 3, " triangles (", 
+			100.0 * bigLODs[i].NumIndices / bigIndices.size(), "%), error: ", bigLODs[i].Error);
+	}
+}
+
+namespace
+{
+	// Straightforward (scalar) implementation of the tangents that TangentGenerator should match: angle-weighted
+	// sum of projected triangle tangents over the corners of every (welded) vertex, using corners with the
+	// dominant handedness. Vertices without any usable triangles are set to zero.
+	void ReferenceTangents(Span<Core::Vertex> vertices, Span<uint32_t> indices, bool weld, SmallVector<float3>& tangents)
+	{
+		auto normalizeOrZero = [](float3 v)
+			{
+				const float lengthSq = v.dot(v);
+				return lengthSq > FLT_MIN ? v * (1.0f / sqrtf(lengthSq)) : float3(0.0f);
+			};
+		auto project = [&normalizeOrZero](float3 v, float3 n) { return normalizeOrZero(v - n.dot(v) * n); };
+
+		SmallVector<uint32_t> remap;
+		remap.resize(vertices.size());
+		std::map<std::array<uint32_t, 8>, uint32_t> unique;
+
+		for (uint32_t v = 0; v < vertices.size(); v++)
+		{
+			const Core::Vertex& vtx = vertices[v];
+			const float f[5] = { vtx.Position.x + 0.0f, vtx.Position.y + 0.0f, vtx.Position.z + 0.0f, 
+				vtx.TexUV.x + 0.0f, vtx.TexUV.y + 0.0f };
+			std::array<uint32_t, 8> key = { 0, 0, 0, 0, 0, vtx.Normal.x, vtx.Normal.y, vtx.Normal.z };
+			memcpy(key.data(), f, sizeof(f));
+
+			remap[v] = weld ? unique.emplace(key, v).first->second : v;
+		}
+
+		SmallVector<float3> sums[2];
+		SmallVector<float> weights[2];
+
+		for (int i = 0; i < 2; i++)
+		{
+			sums[i].resize(vertices.size(), float3(0.0f));
+			weights[i].resize(vertices.size(), 0.0f);
+		}
+
+		for (size_t t = 0; t < indices.size(); t += 3)
+		{
+			const uint32_t tri[3] = { indices[t], indices[t + 1], indices[t + 2] };
+			const float3 p[3] = { vertices[tri[0]].Position, vertices[tri[1]].Position, vertices[tri[2]].Position };
+			const float2 uv10 = vertices[tri[1]].TexUV - vertices[tri[0]].TexUV;
+			const float2 uv20 = vertices[tri[2]].TexUV - vertices[tri[0]].TexUV;
+			float3 e10 = p[1] - p[0];
+			float3 e20 = p[2] - p[0];
+
+			const float det = uv10.x * uv20.y - uv20.x * uv10.y;
+			float3 T = uv20.y * e10 - uv10.y * e20;
+			float3 n = e10.cross(e20);
+
+			if (fabsf(det) <= FLT_MIN || T.dot(T) <= FLT_MIN || n.dot(n) <= FLT_MIN)
+				continue;
+
+			const int handedness = det < 0.0f;
+
+			for (int k = 0; k < 3; k++)
+			{
+				float3 normal = normalizeOrZero(float3(vertices[tri[k]].Normal));
+				float3 edge0 = project(p[(k + 1) % 3] - p[k], normal);
+				float3 edge1 = project(p[(k + 2) % 3] - p[k], normal);
+				const float angle = acosf(Math::Min(Math::Max(edge0.dot(edge1), -1.0f), 1.0f));
+
+				sums[handedness][remap[tri[k]]] += project(handedness ? T * -1.0f : T, normal) * angle;
+				weights[handedness][remap[tri[k]]] += angle;
+			}
+		}
+
+		tangents.resize(vertices.size());
+
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			const uint32_t w = remap[v];
+			tangents[v] = normalizeOrZero(weights[1][w] > weights[0][w] ? sums[1][w] : sums[0][w]);
+		}
+	}
+}
+
+TEST_CASE("TangentGenerator")
+{
+	SmallVector<Core::Vertex> vertices;
+	SmallVector<uint32_t> indices;
+	BuildSphere(64, 128, vertices, indices);
+
+	// tangents are stored in half precision, so they're renormalized before comparing directions
+	auto tangentOf = [](const Core::Vertex& v)
+		{
+			float3 t(v.Tangent);
+			t.normalize();
+
+			return t;
+		};
+	// vertices without any usable triangles get an arbitrary tangent
+	auto matches = [](float3 t, float3 reference) { return reference.dot(reference) == 0.0f || t.dot(reference) > 0.9999f; };
+
+	SUBCASE("Sphere")
+	{
+		TangentGenerator generator;
+		generator.Generate(vertices, indices);
+
+		SmallVector<float3> reference;
+		ReferenceTangents(vertices, indices, true, reference);
+
+		bool matchesReference = true;
+		bool matchesAnalytic = true;
+		bool orthonormal = true;
+
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			float3 t = tangentOf(vertices[v]);
+			float3 n(vertices[v].Normal);
+			float3 p = vertices[v].Position;
+
+			matchesReference = matchesReference && matches(t, reference[v]);
+			orthonormal = orthonormal && fabsf(float3(vertices[v].Tangent).length() - 1.0f) < 2e-3f && fabsf(t.dot(n)) < 2e-3f;
+
+			// away from the poles, tangent should be (almost) the derivative of position w.r.t. u
+			const float sinTheta = sqrtf(p.x * p.x + p.z * p.z);
+			if (sinTheta > 0.1f)
+			{
+				const float3 dPdu(-p.z / sinTheta, 0.0f, p.x / sinTheta);
+				matchesAnalytic = matchesAnalytic && t.dot(dPdu) > 0.999f;
+			}
+		}
+
+		CHECK(matchesReference);
+		CHECK(matchesAnalytic);
+		CHECK(orthonormal);
+
+		// counter-clockwise triangles with rhsIndices should give the same result
+		SmallVector<uint32_t> ccwIndices;
+		ccwIndices.append_range(indices.begin(), indices.end());
+		for (size_t t = 0; t < ccwIndices.size(); t += 3)
+			std::swap(ccwIndices[t + 1], ccwIndices[t + 2]);
+
+		SmallVector<Core::Vertex> ccwVertices;
+		ccwVertices.append_range(vertices.begin(), vertices.end());
+		generator.Generate(ccwVertices, ccwIndices, true);
+
+		bool sameAsCw = true;
+		for (size_t v = 0; v < vertices.size(); v++)
+			sameAsCw = sameAsCw && tangentOf(ccwVertices[v]).dot(tangentOf(vertices[v])) > 0.9999f;
+
+		CHECK(sameAsCw);
+	}
+
+	SUBCASE("Welding")
+	{
+		// every triangle gets its own copy of its vertices
+		SmallVector<Core::Vertex> unindexed;
+		SmallVector<uint32_t> unindexedIndices;
+
+		for (size_t c = 0; c < indices.size(); c++)
+		{
+			unindexed.push_back(vertices[indices[c]]);
+			unindexedIndices.push_back((uint32_t)c);
+		}
+
+		ComputeMeshTangentVectors(vertices, indices);
+		ComputeMeshTangentVectors(unindexed, unindexedIndices, false, true);
+
+		bool sameAsIndexed = true;
+		for (size_t c = 0; c < indices.size(); c++)
+		{
+			const half3& t0 = vertices[indices[c]].Tangent;
+			const half3& t1 = unindexed[c].Tangent;
+			sameAsIndexed = sameAsIndexed && t0.x == t1.x && t0.y == t1.y && t0.z == t1.z;
+		}
+
+		CHECK(sameAsIndexed);
+
+		// without welding, every copy just gets the tangent of its own triangle
+		ComputeMeshTangentVectors(unindexed, unindexedIndices, false, false);
+
+		SmallVector<float3> reference;
+		ReferenceTangents(unindexed, unindexedIndices, false, reference);
+
+		bool matchesReference = true;
+		size_t numDifferent = 0;
+
+		for (size_t c = 0; c < indices.size(); c++)
+		{
+			float3 t = tangentOf(unindexed[c]);
+			matchesReference = matchesReference && matches(t, reference[c]);
+			numDifferent += t.dot(tangentOf(vertices[indices[c]])) < 0.9999f;
+		}
+
+		CHECK(matchesReference);
+		CHECK(numDifferent > indices.size() / 2);
+	}
+
+	SUBCASE("MirroredUVs")
+	{
+		// grid in the xz plane (facing +y) where u = |x|, so texture space is mirrored around x = 0
+		constexpr int N = 16;
+		SmallVector<Core::Vertex> grid;
+		SmallVector<uint32_t> gridIndices;
+
+		for (int i = 0; i <= N; i++)
+		{
+			for (int j = 0; j <= N; j++)
+			{
+				Core::Vertex v{};
+				v.Position = float3((float)(j - N / 2), 0.0f, (float)i);
+				v.Normal = half3(0.0f, 1.0f, 0.0f);
+				v.TexUV = float2(fabsf(v.Position.x) / N, (float)i / N);
+				grid.push_back(v);
+			}
+		}
+
+		for (int i = 0; i < N; i++)
+		{
+			for (int j = 0; j < N; j++)
+			{
+				const uint32_t v0 = i * (N + 1) + j;
+				const uint32_t v2 = v0 + N + 1;
+				// (v1 - v0) x (v2 - v0) points toward +y
+				const uint32_t quad[6] = { v0, v2, v0 + 1, v0 + 1, v2, v2 + 1 };
+				gridIndices.append_range(quad, quad + 6);
+			}
+		}
+
+		TangentGenerator generator;
+		generator.Generate(grid, gridIndices);
+
+		SmallVector<float3> reference;
+		ReferenceTangents(grid, gridIndices, true, reference);
+
+		bool alongX = true;
+		bool matchesReference = true;
+
+		for (size_t v = 0; v < grid.size(); v++)
+		{
+			float3 t = tangentOf(grid[v]);
+			const float x = grid[v].Position.x;
+			// vertices on the mirror line have both handedness (with equal weights), so either side is
+			// fine as long as they don't cancel out
+			const float expected = x < 0.0f || (x == 0.0f && t.x < 0.0f) ? -1.0f : 1.0f;
+
+			alongX = alongX && fabsf(t.x - expected) < 1e-3f;
+			matchesReference = matchesReference && (x == 0.0f || matches(t, reference[v]));
+		}
+
+		CHECK(alongX);
+		CHECK(matchesReference);
+	}
+
+	SUBCASE("Degenerate")
+	{
+		// triangles in the lower half of the sphere have zero area in texture space
+		SmallVector<Core::Vertex> degenerate;
+		degenerate.append_range(vertices.begin(), vertices.end());
+
+		for (auto& v : degenerate)
+			v.TexUV.y = Math::Min(v.TexUV.y, 0.5f);
+
+		ComputeMeshTangentVectors(degenerate, indices);
+
+		bool valid = true;
+		for (const auto& v : degenerate)
+		{
+			float3 t(v.Tangent);
+			valid = valid && fabsf(t.length() - 1.0f) < 2e-3f && fabsf(t.dot(float3(v.Normal))) < 2e-3f;
+		}
+
+		CHECK(valid);
+	}
+
+	SUBCASE("Parallel")
+	{
+		SmallVector<Core::Vertex> bigVertices;
+		SmallVector<uint32_t> bigIndices;
+		BuildSphere(128, 256, bigVertices, bigIndices);
+
+		SmallVector<Core::Vertex> parallelVertices;
+		parallelVertices.append_range(bigVertices.begin(), bigVertices.end());
+
+		TangentGenerator generator;
+		generator.Generate(bigVertices, bigIndices);
+		generator.Generate(parallelVertices, bigIndices, false, true, ThreadExecutor(4));
+
+		bool same = true;
+		for (size_t v = 0; v < bigVertices.size(); v++)
+		{
+			const half3& t0 = bigVertices[v].Tangent;
+			const half3& t1 = parallelVertices[v].Tangent;
+			same = same && t0.x == t1.x && t0.y == t1.y && t0.z == t1.z;
+		}
+
+		CHECK(same);
+	}
+}
+
+TEST_CASE("TangentGenerator benchmark" * doctest::skip())
+{
+	SmallVector<Core::Vertex> bigVertices;
+	SmallVector<uint32_t> bigIndices;
+	BuildSphere(512, 1024, bigVertices, bigIndices);
+
+	const int numThreads = Min(Max((int)std::thread::hardware_concurrency(), 1), TangentGenerator::MAX_NUM_JOBS);
+	// scalar reference, 8-wide, 8-wide with numThreads threads
+	double ms[3] = { 0.0, 0.0, 0.0 };
+	constexpr int NUM_RUNS = 4;
+	TangentGenerator generator;
+	SmallVector<float3> reference;
+
+	for (int method = 0; method < 3; method++)
+	{
+		// scalar reference is too slow to run more than once
+		const int numRuns = method == 0 ? 1 : NUM_RUNS;
+
+		// first run is for warm up
+		for (int run = 0; run < numRuns + 1; run++)
+		{
+			auto t0 = std::chrono::high_resolution_clock::now();
+
+			if (method == 0)
+				ReferenceTangents(bigVertices, bigIndices, false, reference);
+			else if (method == 1)
+				generator.Generate(bigVertices, bigIndices, false, false);
+			else
+				generator.Generate(bigVertices, bigIndices, false, false, ThreadExecutor(numThreads));
+
+			auto t1 = std::chrono::high_resolution_clock::now();
+
+			if (run > 0)
+				ms[method] += std::chrono::duration<double, std::milli>(t1 - t0).count() / numRuns;
+		}
+	}
+
+	const double numTris = (double)bigIndices.size() / 3;
+	auto mtps = [numTris](double ms) { return numTris / (ms * 1e-3) / 1e6; };
+
+	MESSAGE("TangentGenerator -- ", bigIndices.size() / 3, " triangles: scalar reference ", ms[0], " ms (", 
+		mtps(ms[0]), " M triangles/s), 8-wide ", ms[1], " ms (", mtps(ms[1]), " M triangles/s), 8-wide with ", 
+		numThreads, " threads ", ms[2], " ms (", mtps(ms[2]), " M triangles/s)");
+
+	CHECK(ms[1] < ms[0]);
+}
+
+namespace
+{
+	// largest error of 16-bit octahedral encoding is about 1e-4 radians
+	constexpr float MAX_ANGLE_ERROR = 2e-4f;
+
+	AABB ComputeAABB(Span<Core::Vertex> vertices) noexcept
+	{
+		float3 vMin(FLT_MAX);
+		float3 vMax(-FLT_MAX);
+
+		for (const auto& v : vertices)
+		{
+			vMin = float3(Min(vMin.x, v.Position.x), Min(vMin.y, v.Position.y), Min(vMin.z, v.Position.z));
+			vMax = float3(Max(vMax.x, v.Position.x), Max(vMax.y, v.Position.y), Max(vMax.z, v.Position.z));
+		}
+
+		return AABB((vMin + vMax) * 0.5f, (vMax - vMin) * 0.5f);
+	}
+}
+
+TEST_CASE("VertexCompression")
+{
+	using namespace Model;
+
+	SUBCASE("Sphere")
+	{
+		SmallVector<Core::Vertex> vertices;
+		SmallVector<uint32_t> indices;
+		BuildSphere(64, 128, vertices, indices);
+		ComputeMeshTangentVectors(vertices, indices);
+
+		// off-center and non-uniformly scaled
+		for (auto& v : vertices)
+			v.Position = float3(v.Position.x * 3.0f + 10.0f, v.Position.y * 0.5f - 2.0f, v.Position.z + 0.25f);
+
+		const AABB aabb = ComputeAABB(vertices);
+		SmallVector<Core::CompressedVertex> compressed;
+		SmallVector<Core::Vertex> decoded;
+		compressed.resize(vertices.size());
+		decoded.resize(vertices.size());
+
+		VertexCompression::Encode(vertices, aabb, compressed);
+		VertexCompression::Decode(compressed, aabb, decoded);
+		const auto err = VertexCompression::MeasureError(vertices, compressed, aabb);
+
+		// half a quantization step along every axis
+		float3 halfStep = aabb.Extents * (1.0f / 65535.0f);
+		const float maxPosErr = halfStep.length() * 1.01f;
+
+		CHECK(err.MaxPosition <= maxPosErr);
+		CHECK(err.MaxNormalAngle <= MAX_ANGLE_ERROR);
+		CHECK(err.MaxTangentAngle <= MAX_ANGLE_ERROR);
+		CHECK(err.MaxTexUV <= 1.0f / 2048.0f);
+
+		bool decodedMatches = true;
+		float maxDecodedPosErr = 0.0f;
+
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			float3 d = decoded[i].Position - vertices[i].Position;
+			maxDecodedPosErr = Max(maxDecodedPosErr, d.length());
+
+			// decoded normals and tangents are rounded to half precision
+			float3 n0(vertices[i].Normal);
+			float3 n1(decoded[i].Normal);
+			float3 t0(vertices[i].Tangent);
+			float3 t1(decoded[i].Tangent);
+			n0.normalize();
+			n1.normalize();
+			t0.normalize();
+			t1.normalize();
+			decodedMatches = decodedMatches && n0.dot(n1) > 0.99999f && t0.dot(t1) > 0.99999f &&
+				decoded[i].TexUV.x == float2(compressed[i].TexUV).x && decoded[i].TexUV.y == float2(compressed[i].TexUV).y;
+		}
+
+		CHECK(maxDecodedPosErr <= maxPosErr);
+		CHECK(decodedMatches);
+	}
+
+	SUBCASE("UnitVectors")
+	{
+		// random directions, plus the axes and the folds of the octahedron
+		SmallVector<Core::Vertex> vertices;
+		RNG rng(17);
+
+		const float3 special[] = { float3(1, 0, 0), float3(-1, 0, 0), float3(0, 1, 0), float3(0, -1, 0), 
+			float3(0, 0, 1), float3(0, 0, -1), float3(1, 1, -1), float3(-1, 1, -1), float3(1, -1, -1), 
+			float3(-1, -1, -1), float3(1, 0, -1), float3(0, -1, -1), float3(1, 1, 0), float3(-1, -1, 0) };
+
+		for (float3 n : special)
+		{
+			n.normalize();
+			Core::Vertex v{};
+			v.Normal = half3(n);
+			v.Tangent = half3(n);
+			vertices.push_back(v);
+		}
+
+		for (int i = 0; i < 100000; i++)
+		{
+			// uniform on the sphere
+			const float z = 2.0f * rng.GetUniformFloat() - 1.0f;
+			const float phi = TWO_PI * rng.GetUniformFloat();
+			const float r = sqrtf(Max(1.0f - z * z, 0.0f));
+
+			Core::Vertex v{};
+			v.Position = float3(rng.GetUniformFloat(), rng.GetUniformFloat(), rng.GetUniformFloat());
+			v.Normal = half3(float3(r * cosf(phi), r * sinf(phi), z));
+			v.Tangent = half3(float3(-r * sinf(phi), r * cosf(phi), z));
+			v.TexUV = float2(rng.GetUniformFloat() * 4.0f - 2.0f, rng.GetUniformFloat());
+			vertices.push_back(v);
+		}
+
+		// zero vectors are skipped
+		Core::Vertex zero{};
+		zero.Normal = half3(0.0f, 0.0f, 1.0f);
+		zero.Tangent = half3(0.0f);
+		vertices.push_back(zero);
+
+		const AABB aabb = ComputeAABB(vertices);
+		SmallVector<Core::CompressedVertex> compressed;
+		compressed.resize(vertices.size());
+		VertexCompression::Encode(vertices, aabb, compressed);
+		const auto err = VertexCompression::MeasureError(vertices, compressed, aabb);
+
+		CHECK(err.MaxNormalAngle <= MAX_ANGLE_ERROR);
+		CHECK(err.MaxTangentAngle <= MAX_ANGLE_ERROR);
+		CHECK(err.MaxTexUV <= 2.0f / 2048.0f);
+
+		SmallVector<Core::Vertex> decoded;
+		decoded.resize(1);
+		VertexCompression::Decode(Span(compressed.end() - 1, 1), aabb, decoded);
+		CHECK(float3(decoded[0].Tangent).z == 1.0f);
+	}
+
+	SUBCASE("FlatMesh")
+	{
+		// zero extent along y
+		SmallVector<Core::Vertex> vertices;
+
+		for (int i = 0; i < 13; i++)
+		{
+			Core::Vertex v{};
+			v.Position = float3((float)i, 5.0f, (float)(i * i) * 0.1f);
+			v.Normal = half3(0.0f, 1.0f, 0.0f);
+			v.Tangent = half3(1.0f, 0.0f, 0.0f);
+			vertices.push_back(v);
+		}
+
+		const AABB aabb = ComputeAABB(vertices);
+		SmallVector<Core::CompressedVertex> compressed;
+		SmallVector<Core::Vertex> decoded;
+		compressed.resize(vertices.size());
+		decoded.resize(vertices.size());
+		VertexCompression::Encode(vertices, aabb, compressed);
+		VertexCompression::Decode(compressed, aabb, decoded);
+
+		// axes are exactly representable as well
+		bool exact = true;
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			exact = exact && decoded[i].Position.y == 5.0f && float3(decoded[i].Normal).y == 1.0f && 
+				float3(decoded[i].Tangent).x == 1.0f;
+		}
+
+		CHECK(exact);
+	}
+}
+
+TEST_CASE("VertexCompression benchmark" * doctest::skip())
+{
+	using namespace Model;
+
+	SmallVector<Core::Vertex> vertices;
+	SmallVector<uint32_t> indices;
+	BuildSphere(512, 1024, vertices, indices);
+
+	const AABB aabb = ComputeAABB(vertices);
+	SmallVector<Core::CompressedVertex> compressed;
+	SmallVector<Core::Vertex> decoded;
+	compressed.resize(vertices.size());
+	decoded.resize(vertices.size());
+
+	constexpr int NUM_RUNS = 4;
+	double ms[2] = { 0.0, 0.0 };
+
+	// first run is for warm up
+	for (int run = 0; run < NUM_RUNS + 1; run++)
+	{
+		auto t0 = std::chrono::high_resolution_clock::now();
+		VertexCompression::Encode(vertices, aabb, compressed);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		VertexCompression::Decode(compressed, aabb, decoded);
+		auto t2 = std::chrono::high_resolution_clock::now();
+
+		if (run > 0)
+		{
+			ms[0] += std::chrono::duration<double, std::milli>(t1 - t0).count() / NUM_RUNS;
+			ms[1] += std::chrono::duration<double, std::milli>(t2 - t1).count() / NUM_RUNS;
+		}
+	}
+
+	const double numVertices = (double)vertices.size();
+	MESSAGE("VertexCompression -- ", vertices.size(), " vertices: encode ", ms[0], " ms (", numVertices / (ms[0] * 1e-3) / 1e6, 
+		" M vertices/s), decode ", ms[1], " ms (", numVertices / (ms[1] * 1e-3) / 1e6, " M vertices/s)");
+
+	CHECK(VertexCompression::MeasureError(vertices, compressed, aabb).MaxNormalAngle <= MAX_ANGLE_ERROR);
+}
+
+TEST_CASE("StreamingQueue")
+{
+	// simulates streaming a scene -- background threads decode chunks while the main thread
+	// integrates them at the beginning of every frame
+	constexpr int NUM_STAGES = 3;
+	constexpr int NUM_MESH_PRODUCERS = 2;
+	constexpr int NUM_ITEMS_PER_PRODUCER = 200;
+	constexpr int NUM_ITEMS = (NUM_MESH_PRODUCERS + 2) * NUM_ITEMS_PER_PRODUCER;
+	// exactly representable, so that the expected number of items per frame is exact too
+	constexpr double ITEM_COST_MS[NUM_STAGES] = { 0.25, 0.125, 0.0625 };
+	constexpr double BUDGET_MS = 2.0;
+
+	// items advance a fake clock by their cost instead of taking that long. Only accessed by the 
+	// integrating thread.
+	static double fakeTimeMs;
+	fakeTimeMs = 0.0;
+	auto fakeClock = []() noexcept { return fakeTimeMs; };
+
+	SUBCASE("Order")
+	{
+		struct Integrated
+		{
+			int Stage;
+			int Producer;
+			int Seq;
+		};
+
+		StreamingQueue queue(NUM_STAGES, fakeClock);
+		// only accessed by the integrating thread
+		SmallVector<Integrated> integrated;
+		std::atomic_int32_t numMeshProducers = NUM_MESH_PRODUCERS;
+
+		auto produce = [&](int stage, int producer)
+			{
+				for (int i = 0; i < NUM_ITEMS_PER_PRODUCER; i++)
+				{
+					queue.Enqueue(stage, [&integrated, stage, producer, i, cost = ITEM_COST_MS[stage]]()
+						{
+							fakeTimeMs += cost;
+							integrated.push_back(Integrated{ .Stage = stage, .Producer = producer, .Seq = i });
+						});
+
+					if (i % 16 == 0)
+						std::this_thread::yield();
+				}
+			};
+
+		std::vector<std::thread> threads;
+
+		// first stage is produced by multiple threads, while the later stages are closed before it
+		for (int p = 0; p < NUM_MESH_PRODUCERS; p++)
+		{
+			threads.emplace_back([&, p]()
+				{
+					produce(0, p);
+
+					if (numMeshProducers.fetch_sub(1) == 1)
+						queue.Close(0);
+				});
+		}
+
+		threads.emplace_back([&]()
+			{
+				produce(1, NUM_MESH_PRODUCERS);
+				queue.Close(1);
+				produce(2, NUM_MESH_PRODUCERS);
+				queue.Close(2);
+			});
+
+		int numFrames = 0;
+		bool withinBudget = true;
+
+		while (!queue.IsDone())
+		{
+			const double frameStartMs = fakeTimeMs;
+			queue.Integrate(BUDGET_MS);
+			withinBudget = withinBudget && fakeTimeMs - frameStartMs <= BUDGET_MS;
+
+			std::this_thread::yield();
+			REQUIRE(++numFrames < 10000000);
+		}
+
+		for (auto& t : threads)
+			t.join();
+
+		REQUIRE(integrated.size() == NUM_ITEMS);
+		CHECK(withinBudget);
+
+		// stages are integrated in order and items of each producer in the order that they were enqueued
+		bool stagesInOrder = true;
+		bool producersInOrder = true;
+		int nextSeq[NUM_MESH_PRODUCERS + 1][NUM_STAGES] = {};
+
+		for (size_t i = 0; i < integrated.size(); i++)
+		{
+			const Integrated& item = integrated[i];
+			stagesInOrder = stagesInOrder && (i == 0 || integrated[i - 1].Stage <= item.Stage);
+			producersInOrder = producersInOrder && nextSeq[item.Producer][item.Stage] == item.Seq;
+			nextSeq[item.Producer][item.Stage]++;
+		}
+
+		CHECK(stagesInOrder);
+		CHECK(producersInOrder);
+	}
+
+	SUBCASE("Budget")
+	{
+		// everything is ready up front, so every frame should be filled up to the budget
+		StreamingQueue queue(NUM_STAGES, fakeClock);
+		int numItems[NUM_STAGES] = { NUM_MESH_PRODUCERS * NUM_ITEMS_PER_PRODUCER, NUM_ITEMS_PER_PRODUCER, 
+			NUM_ITEMS_PER_PRODUCER };
+		int numExpectedFrames = 0;
+
+		for (int stage = 0; stage < NUM_STAGES; stage++)
+		{
+			for (int i = 0; i < numItems[stage]; i++)
+			{
+				queue.Enqueue(stage, [cost = ITEM_COST_MS[stage]]()
+					{
+						fakeTimeMs += cost;
+					});
+			}
+
+			queue.Close(stage);
+
+			// a new stage always starts in a new frame, as the cost of its items isn't known until 
+			// the first one is integrated
+			const int itemsPerFrame = (int)(BUDGET_MS / ITEM_COST_MS[stage]);
+			numExpectedFrames += (numItems[stage] + itemsPerFrame - 1) / itemsPerFrame;
+		}
+
+		int numFrames = 0;
+		int numIntegrated = 0;
+		double maxFrameMs = 0.0;
+
+		while (!queue.IsDone())
+		{
+			const double frameStartMs = fakeTimeMs;
+			numIntegrated += queue.Integrate(BUDGET_MS);
+			maxFrameMs = Max(maxFrameMs, fakeTimeMs - frameStartMs);
+
+			REQUIRE(++numFrames <= NUM_ITEMS);
+		}
+
+		CHECK(numIntegrated == NUM_ITEMS);
+		CHECK(maxFrameMs <= BUDGET_MS);
+		// budget isn't wasted either
+		CHECK(numFrames == numExpectedFrames);
+	}
+}
+
+TEST_CASE("GeometryHash")
+{
+	using namespace Model;
+
+	SmallVector<Core::Vertex> vertices;
+	SmallVector<uint32_t> indices;
+	BuildSphere(32, 64, vertices, indices);
+	const uint64_t hash = GeometryHash(vertices, indices);
+
+	SUBCASE("Content")
+	{
+		// same members, different padding bytes
+		SmallVector<Core::Vertex> copy;
+		copy.resize(vertices.size());
+		memset(copy.data(), 0xab, copy.size() * sizeof(Core::Vertex));
+
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			copy[i].Position = vertices[i].Position;
+			copy[i].Normal = vertices[i].Normal;
+			copy[i].TexUV = vertices[i].TexUV;
+			copy[i].Tangent = vertices[i].Tangent;
+		}
+
+		CHECK(GeometryHash(copy, indices) == hash);
+
+		copy[vertices.size() / 2].TexUV.x += 1e-3f;
+		CHECK(GeometryHash(copy, indices) != hash);
+
+		// same vertices, flipped winding
+		SmallVector<uint32_t> flipped;
+		flipped.append_range(indices.begin(), indices.end());
+		std::swap(flipped[0], flipped[1]);
+		CHECK(GeometryHash(vertices, flipped) != hash);
+
+		// prefix of the same data
+		CHECK(GeometryHash(Span(vertices.data(), vertices.size() - 1), indices) != hash);
+		CHECK(GeometryHash(vertices, Span(indices.data(), indices.size() - 3)) != hash);
+	}
+
+	SUBCASE("Kitbashed")
+	{
+		// a few unique parts that are copied (along with their vertex and index data) into every scene
+		// and duplicated inside the scenes, as exported by DCC tools
+		constexpr int NUM_PARTS = 24;
+		constexpr int NUM_SCENES = 8;
+		constexpr int NUM_COPIES_PER_SCENE = 40;
+
+		struct Part
+		{
+			SmallVector<Core::Vertex> Vertices;
+			SmallVector<uint32_t> Indices;
+		};
+
+		SmallVector<Part> parts;
+		parts.resize(NUM_PARTS);
+
+		for (int p = 0; p < NUM_PARTS; p++)
+		{
+			BuildSphere(8 + p, 16 + 2 * p, parts[p].Vertices, parts[p].Indices);
+
+			for (auto& v : parts[p].Vertices)
+				v.Position = v.Position * (1.0f + p * 0.1f);
+		}
+
+		SmallVector<Part> primitives;
+		SmallVector<int> partIndices;
+		RNG rng(5);
+
+		for (int s = 0; s < NUM_SCENES; s++)
+		{
+			for (int c = 0; c < NUM_COPIES_PER_SCENE; c++)
+			{
+				const int p = (int)rng.GetUniformUintBounded(NUM_PARTS);
+				Part prim;
+				prim.Vertices.append_range(parts[p].Vertices.begin(), parts[p].Vertices.end());
+				prim.Indices.append_range(parts[p].Indices.begin(), parts[p].Indices.end());
+
+				primitives.push_back(ZetaMove(prim));
+				partIndices.push_back(p);
+			}
+		}
+
+		SmallVector<uint64_t> hashes;
+		hashes.resize(primitives.size());
+		size_t totalBytes = 0;
+
+		for (size_t i = 0; i < primitives.size(); i++)
+			hashes[i] = GeometryHash(primitives[i].Vertices, primitives[i].Indices);
+
+		// primitives are shared exactly when they came from the same part
+		std::map<uint64_t, int> hashToPart;
+		bool sameAsPart = true;
+		size_t uniqueBytes = 0;
+
+		for (size_t i = 0; i < primitives.size(); i++)
+		{
+			const size_t numBytes = primitives[i].Vertices.size() * sizeof(Core::Vertex) + 
+				primitives[i].Indices.size() * sizeof(uint32_t);
+			totalBytes += numBytes;
+
+			auto [it, inserted] = hashToPart.try_emplace(hashes[i], partIndices[i]);
+			sameAsPart = sameAsPart && it->second == partIndices[i];
+
+			if (inserted)
+				uniqueBytes += numBytes;
+		}
+
+		CHECK(sameAsPart);
+		CHECK(hashToPart.size() <= NUM_PARTS);
+		// every part is copied many times, so most of the data is shared
+		CHECK(uniqueBytes * 4 < totalBytes);
+	}
+}
+
+TEST_CASE("MeshContainer")
+{
+	using namespace Model;
+	using MeshSubset = Model::glTF::Asset::MeshSubset;
+
+	struct Part
+	{
+		SmallVector<Core::Vertex> Vertices;
+		SmallVector<uint32_t> Indices;
+	};
+
+	Part parts[3];
+	BuildSphere(4, 8, parts[0].Vertices, parts[0].Indices);
+	BuildSphere(5, 10, parts[1].Vertices, parts[1].Indices);
+	BuildSphere(6, 12, parts[2].Vertices, parts[2].Indices);
+
+	// batch as the importer hands it over -- every mesh prim is decoded to its own range, after 
+	// which duplicates are pointed to their owner's range
+	auto addPart = [](Part& part, uint64_t geometryID, int meshIdx, SmallVector<MeshSubset>& meshes,
+		SmallVector<Core::Vertex>& vertices, SmallVector<uint32_t>& indices)
+		{
+			meshes.push_back(MeshSubset{
+				.MaterialIdx = -1,
+				.MeshIdx = meshIdx,
+				.MeshPrimIdx = 0,
+				.BaseVtxOffset = (uint32_t)vertices.size(),
+				.BaseIdxOffset = (uint32_t)indices.size(),
+				.NumVertices = (uint32_t)part.Vertices.size(),
+				.NumIndices = (uint32_t)part.Indices.size(),
+				.BaseLODOffset = 0,
+				.BaseLODIdxOffset = 0,
+				.NumLODs = 0,
+				.NumLODIndices = 0,
+				.GeometryID = geometryID });
+
+			vertices.append_range(part.Vertices.begin(), part.Vertices.end());
+			indices.append_range(part.Indices.begin(), part.Indices.end());
+		};
+
+	// stand-ins for the GPU buffers, see MeshContainer::RebuildBuffers()
+	SmallVector<Core::Vertex> gpuVertices;
+	SmallVector<uint32_t> gpuIndices;
+
+	auto upload = [&gpuVertices, &gpuIndices](Internal::MeshContainer& meshes)
+		{
+			CHECK(gpuVertices.size() == meshes.GetNumUploadedVertices());
+			CHECK(gpuIndices.size() == meshes.GetNumUploadedIndices());
+
+			gpuVertices.append_range(meshes.GetPendingVertices().begin(), meshes.GetPendingVertices().end());
+			gpuIndices.append_range(meshes.GetPendingIndices().begin(), meshes.GetPendingIndices().end());
+			meshes.MarkUploaded();
+		};
+
+	auto sameVertices = [&gpuVertices](const TriangleMesh& mesh, Part& part)
+		{
+			return mesh.m_numVertices == part.Vertices.size() && 
+				mesh.m_vtxBuffStartOffset + mesh.m_numVertices <= gpuVertices.size() &&
+				memcmp(gpuVertices.data() + mesh.m_vtxBuffStartOffset, part.Vertices.data(), 
+					part.Vertices.size() * sizeof(Core::Vertex)) == 0;
+		};
+
+	const uint64_t hash0 = GeometryHash(parts[0].Vertices, parts[0].Indices);
+	const uint64_t hash2 = GeometryHash(parts[2].Vertices, parts[2].Indices);
+
+	constexpr uint64_t SCENE_0 = 1;
+	constexpr uint64_t SCENE_1 = 2;
+	const uint64_t owner = SceneCore::MeshID(SCENE_0, 0, 0);
+	const uint64_t duplicate = SceneCore::MeshID(SCENE_0, 1, 0);
+	const uint64_t collision = SceneCore::MeshID(SCENE_0, 2, 0);
+	const uint64_t shared = SceneCore::MeshID(SCENE_1, 0, 0);
+	const uint64_t unique = SceneCore::MeshID(SCENE_1, 1, 0);
+	const uint64_t added = SceneCore::MeshID(SCENE_1, 2, 0);
+
+	Internal::MeshContainer meshes;
+
+	// first batch: part 0 twice and part 1 with the same hash as part 0 (a collision)
+	{
+		SmallVector<MeshSubset> subsets;
+		SmallVector<Core::Vertex> vertices;
+		SmallVector<uint32_t> indices;
+		addPart(parts[0], hash0, 0, subsets, vertices, indices);
+		addPart(parts[0], hash0, 1, subsets, vertices, indices);
+		addPart(parts[1], hash0, 2, subsets, vertices, indices);
+		subsets[1].BaseVtxOffset = subsets[0].BaseVtxOffset;
+		subsets[1].BaseIdxOffset = subsets[0].BaseIdxOffset;
+
+		const auto stats = meshes.AddBatch(SCENE_0, ZetaMove(subsets), ZetaMove(vertices), ZetaMove(indices), {}, {});
+
+		CHECK(stats.NumMeshes == 1);
+		CHECK(stats.NumBytes == parts[0].Vertices.size() * sizeof(Core::Vertex) + parts[0].Indices.size() * sizeof(uint32_t));
+	}
+
+	CHECK(meshes.GetMesh(owner).m_geometryID == hash0);
+	CHECK(meshes.GetMesh(duplicate).m_geometryID == hash0);
+	CHECK(meshes.GetMesh(duplicate).m_vtxBuffStartOffset == meshes.GetMesh(owner).m_vtxBuffStartOffset);
+	CHECK(meshes.GetMesh(duplicate).m_idxBuffStartOffset == meshes.GetMesh(owner).m_idxBuffStartOffset);
+	// different content with the same hash is probed to the next key
+	CHECK(meshes.GetMesh(collision).m_geometryID == hash0 + 1);
+	CHECK(meshes.GetMesh(collision).m_vtxBuffStartOffset == 2 * parts[0].Vertices.size());
+	CHECK(meshes.GetMesh(collision).m_idxBuffStartOffset == 2 * parts[0].Indices.size());
+
+	// nothing is kept in system memory once uploaded
+	upload(meshes);
+	CHECK(meshes.GetCpuMemoryUsage() == 0);
+	CHECK(sameVertices(meshes.GetMesh(collision), parts[1]));
+
+	// second batch: part 1 again (found past the collision) and the new part 2, which is appended
+	{
+		SmallVector<MeshSubset> subsets;
+		SmallVector<Core::Vertex> vertices;
+		SmallVector<uint32_t> indices;
+		addPart(parts[1], hash0, 0, subsets, vertices, indices);
+		addPart(parts[2], hash2, 1, subsets, vertices, indices);
+
+		const auto stats = meshes.AddBatch(SCENE_1, ZetaMove(subsets), ZetaMove(vertices), ZetaMove(indices), {}, {});
+
+		CHECK(stats.NumMeshes == 1);
+	}
+
+	CHECK(meshes.GetMesh(shared).m_geometryID == hash0 + 1);
+	CHECK(meshes.GetMesh(shared).m_vtxBuffStartOffset == meshes.GetMesh(collision).m_vtxBuffStartOffset);
+	CHECK(meshes.GetMesh(unique).m_geometryID == hash2);
+	CHECK(meshes.GetMesh(unique).m_vtxBuffStartOffset == 2 * parts[0].Vertices.size() + parts[1].Vertices.size());
+	CHECK(meshes.GetMesh(unique).m_idxBuffStartOffset == 2 * parts[0].Indices.size() + parts[1].Indices.size());
+	CHECK(meshes.GetPendingVertices().size() == parts[2].Vertices.size());
+	CHECK(meshes.GetPendingIndices().size() == parts[2].Indices.size());
+
+	upload(meshes);
+	CHECK(sameVertices(meshes.GetMesh(unique), parts[2]));
+
+	// geometry outlives all but the last mesh that refers to it
+	TriangleMesh removed;
+	meshes.AddRef(owner);
+	CHECK(!meshes.Release(owner, removed));
+	CHECK(meshes.Release(owner, removed));
+	CHECK(meshes.HasGeometry(hash0));
+	CHECK(meshes.Release(duplicate, removed));
+	CHECK(!meshes.HasGeometry(hash0));
+	CHECK(meshes.HasGeometry(hash0 + 1));
+
+	// part 0 is added again, but isn't uploaded yet
+	meshes.Add(added, parts[0].Vertices, parts[0].Indices, SceneCore::DEFAULT_MATERIAL);
+	CHECK(meshes.GetMesh(added).m_geometryID == hash0);
+	CHECK(meshes.GetMesh(added).m_vtxBuffStartOffset == gpuVertices.size());
+
+	// previous part 0 and the range its duplicate was decoded to are dropped. Uploaded geometry that's 
+	// left is moved on the GPU in one go, followed by the pending geometry.
+	{
+		SmallVector<Internal::MeshContainer::BufferMove> vertexMoves;
+		SmallVector<Internal::MeshContainer::BufferMove> indexMoves;
+		meshes.Compact(vertexMoves, indexMoves);
+
+		REQUIRE(vertexMoves.size() == 1);
+		REQUIRE(indexMoves.size() == 1);
+		CHECK(vertexMoves[0].SrcOffset == 2 * parts[0].Vertices.size());
+		CHECK(vertexMoves[0].DstOffset == 0);
+		CHECK(vertexMoves[0].Count == parts[1].Vertices.size() + parts[2].Vertices.size());
+		CHECK(indexMoves[0].SrcOffset == 2 * parts[0].Indices.size());
+		CHECK(indexMoves[0].Count == parts[1].Indices.size() + parts[2].Indices.size());
+		CHECK(meshes.GetNumUploadedVertices() == vertexMoves[0].Count);
+		CHECK(meshes.GetNumUploadedIndices() == indexMoves[0].Count);
+
+		SmallVector<Core::Vertex> newVertices;
+		SmallVector<uint32_t> newIndices;
+		newVertices.resize(vertexMoves[0].Count);
+		newIndices.resize(indexMoves[0].Count);
+		memcpy(newVertices.data(), gpuVertices.data() + vertexMoves[0].SrcOffset, vertexMoves[0].Count * sizeof(Core::Vertex));
+		memcpy(newIndices.data(), gpuIndices.data() + indexMoves[0].SrcOffset, indexMoves[0].Count * sizeof(uint32_t));
+		gpuVertices.swap(newVertices);
+		gpuIndices.swap(newIndices);
+	}
+
+	upload(meshes);
+
+	const TriangleMesh m1 = meshes.GetMesh(collision);
+	const TriangleMesh m2 = meshes.GetMesh(unique);
+	const TriangleMesh m3 = meshes.GetMesh(added);
+
+	CHECK(m1.m_vtxBuffStartOffset == 0);
+	CHECK(m1.m_idxBuffStartOffset == 0);
+	CHECK(m2.m_vtxBuffStartOffset == parts[1].Vertices.size());
+	CHECK(m2.m_idxBuffStartOffset == parts[1].Indices.size());
+	CHECK(m3.m_vtxBuffStartOffset == parts[1].Vertices.size() + parts[2].Vertices.size());
+	CHECK(m3.m_idxBuffStartOffset == parts[1].Indices.size() + parts[2].Indices.size());
+	CHECK(meshes.GetMesh(shared).m_vtxBuffStartOffset == m1.m_vtxBuffStartOffset);
+	CHECK(meshes.GetMesh(shared).m_idxBuffStartOffset == m1.m_idxBuffStartOffset);
+	CHECK(sameVertices(m1, parts[1]));
+	CHECK(sameVertices(meshes.GetMesh(shared), parts[1]));
+	CHECK(sameVertices(m2, parts[2]));
+	CHECK(sameVertices(m3, parts[0]));
+	CHECK(memcmp(gpuIndices.data() + m3.m_idxBuffStartOffset, parts[0].Indices.data(), 
+		parts[0].Indices.size() * sizeof(uint32_t)) == 0);
+
+	CHECK(meshes.Release(collision, removed));
+	CHECK(meshes.HasGeometry(hash0 + 1));
+	CHECK(meshes.Release(shared, removed));
+	CHECK(!meshes.HasGeometry(hash0 + 1));
+	CHECK(meshes.Release(unique, removed));
+	CHECK(!meshes.HasGeometry(hash2));
+	CHECK(meshes.Release(added, removed));
+	CHECK(!meshes.HasGeometry(hash0));
+
+	meshes.Clear();
+}
@@ -18,9 +18,55 @@ namespace ZetaRay::App::Filesystem
     void RemoveFile(const char* path) noexcept;
     bool Exists(const char* path) noexcept;
     size_t GetFileSize(const char* path) noexcept;
+    // Returns a timestamp that changes whenever the file is written to, or 0 if it doesn't exist
+    uint64_t GetLastWriteTime(const char* path) noexcept;
     void CreateDirectoryIfNotExists(const char* path) noexcept;
     bool Copy(const char* srcPath, const char* dstPath, bool overwrite = false) noexcept;
     bool IsDirectory(const char* path) noexcept;
+    // Hints the OS to start reading the given range of a memory-mapped file in the background, so
+    // that a later access doesn't stall on a page fault. Has no effect on memory that's already resident.
+    void Prefetch(const void* data, size_t size) noexcept;
+
+    // Read-only view of a whole file mapped into the address space. Pages are loaded by the OS on
+    // first access, so nothing is read until Data() is dereferenced.
+    struct MemoryMappedFile
+    {
+        MemoryMappedFile() noexcept = default;
+        ~MemoryMappedFile() noexcept { Close(); }
+
+        MemoryMappedFile(const MemoryMappedFile&) = delete;
+        MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+        MemoryMappedFile(MemoryMappedFile&& other) noexcept { Swap(other); }
+        MemoryMappedFile& operator=(MemoryMappedFile&& other) noexcept
+        {
+            Close();
+            Swap(other);
+
+            return *this;
+        }
+
+        // Returns false if file doesn't exist or is empty
+        bool Open(const char* path) noexcept;
+        void Close() noexcept;
+        ZetaInline const uint8_t* Data() const noexcept { return reinterpret_cast<const uint8_t*>(m_view); }
+        ZetaInline size_t Size() const noexcept { return m_size; }
+
+    private:
+        ZetaInline void Swap(MemoryMappedFile& other) noexcept
+        {
+            std::swap(m_file, other.m_file);
+            std::swap(m_mapping, other.m_mapping);
+            std::swap(m_view, other.m_view);
+            std::swap(m_size, other.m_size);
+        }
+
+        // HANDLEs -- void* to avoid including Windows.h
+        void* m_file = nullptr;
+        void* m_mapping = nullptr;
+        void* m_view = nullptr;
+        size_t m_size = 0;
+    };
 
     struct Path
     {
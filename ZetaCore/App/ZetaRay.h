@@ -1,7 +1,8 @@
 #pragma once
 
-#ifndef _M_X64
-#error 64-bit platform is required
+// The math library is written against SSE/AVX intrinsics
+#if !defined(_M_X64) && !defined(__x86_64__)
+#error x86-64 platform is required
 #endif
 
 #define _HAS_EXCEPTIONS 0
@@ -11,17 +12,26 @@
 #include <cstddef>
 #include <type_traits>
 
+#ifdef _MSC_VER
 #pragma warning(disable : 4996) // _CRT_SECURE_NO_WARNINGS
 #pragma warning(disable : 4101) // unreferenced local variable
 #pragma warning(disable : 4100) // unreferenced formal parameter
 #pragma warning(disable : 4189) // local variable is initialized but not referenced
 #pragma warning(disable : 4324) // structure was padded due to alignment specifier
 #pragma warning(disable : 4190) // for FSR2
+#endif
 
 // "Move" was defined in OCIdl.h! 
 #define ZetaMove(x) static_cast<std::remove_reference_t<decltype(x)>&&>(x)
 #define ZetaForward(x) static_cast<decltype(x)&&>(x)
+#ifdef _MSC_VER
 #define ZetaInline __forceinline
+#define ZETA_VECTORCALL __vectorcall
+#else
+#define ZetaInline inline __attribute__((always_inline))
+// only meaningful for MSVC on x64
+#define ZETA_VECTORCALL
+#endif
 
 #define MAX_NUM_THREADS 64
 #define THREAD_ID_TYPE uint32_t
@@ -698,7 +698,7 @@ namespace ZetaRay::Core::Internal
 		}
 
 		void UploadBuffer(int threadIdx, UploadHeapManager& uploadHeap, ID3D12Resource* resource, void* data,
-			size_t sizeInBytes, D3D12_RESOURCE_STATES postCopyState) noexcept
+			size_t sizeInBytes, D3D12_RESOURCE_STATES postCopyState, size_t destOffsetInBytes = 0) noexcept
 		{
 			Assert(m_inBeginEndBlock, "Can't call Upload on a closed ResourceUploadBatch.");
 			Assert(resource, "resource was NULL");
@@ -725,7 +725,7 @@ namespace ZetaRay::Core::Internal
 			// reminder UploadHeapBuffer might have an offset from ths start of underlying
 			// CommitedHeap
 			m_directCmdList->CopyBufferRegion(resource,
-				0,
+				destOffsetInBytes,
 				scratchBuff.GetResource(),
 				scratchBuff.GetOffset(),
 				sizeInBytes);
@@ -738,6 +738,27 @@ namespace ZetaRay::Core::Internal
 			m_scratchResources.push_back(ZetaMove(scratchBuff));
 		}
 
+		// Both resources are expected to be in the COMMON state -- they're implicitly promoted to COPY_DEST
+		// and COPY_SOURCE respectively and decay back after the command list has executed
+		void CopyBuffer(ID3D12Resource* dstResource, size_t destOffsetInBytes, ID3D12Resource* srcResource,
+			size_t srcOffsetInBytes, size_t sizeInBytes) noexcept
+		{
+			Assert(m_inBeginEndBlock, "Can't call Copy on a closed ResourceUploadBatch.");
+			Assert(dstResource && srcResource, "resource was NULL");
+
+			if (!m_directCmdList)
+			{
+				m_directCmdList = App::GetRenderer().GetGraphicsCmdList();
+				m_directCmdList->SetName("ResourceUploadBatch");
+			}
+
+			m_directCmdList->CopyBufferRegion(dstResource,
+				destOffsetInBytes,
+				srcResource,
+				srcOffsetInBytes,
+				sizeInBytes);
+		}
+
 		void UploadTexture(int threadIdx, UploadHeapManager& uploadHeap, ID3D12Resource* dstResource,
 			uint8_t* pixels, D3D12_RESOURCE_STATES postCopyState) noexcept
 		{
@@ -793,7 +814,8 @@ namespace ZetaRay::Core::Internal
 		{
 			Assert(m_inBeginEndBlock, "ResourceUploadBatch already closed.");
 
-			if (!m_scratchResources.empty())
+			// GPU-to-GPU copies don't need any scratch resources
+			if (m_directCmdList)
 			{
 				auto& renderer = App::GetRenderer();
 
@@ -1260,13 +1282,29 @@ DefaultHeapBuffer GpuMemory::GetDefaultHeapBufferAndInit(const char* name, size_
 	return buff;
 }
 
-void GpuMemory::UploadToDefaultHeapBuffer(const DefaultHeapBuffer& buff, size_t sizeInBytes, void* data) noexcept
+void GpuMemory::UploadToDefaultHeapBuffer(const DefaultHeapBuffer& buff, size_t sizeInBytes, void* data, 
+	size_t destOffsetInBytes) noexcept
 {
 	const int idx = GetIndexForThread();
 
 	auto desc = buff.GetDesc();
+	Assert(destOffsetInBytes + sizeInBytes <= desc.Width, "out-of-bounds upload.");
+
 	m_threadContext[idx].ResUploader->UploadBuffer(idx, *m_threadContext[idx].UploadHeap,
-		const_cast<DefaultHeapBuffer&>(buff).GetResource(), data, sizeInBytes, D3D12_RESOURCE_STATE_COMMON);
+		const_cast<DefaultHeapBuffer&>(buff).GetResource(), data, sizeInBytes, D3D12_RESOURCE_STATE_COMMON, 
+		destOffsetInBytes);
+}
+
+void GpuMemory::CopyDefaultHeapBuffer(const DefaultHeapBuffer& dst, size_t destOffsetInBytes, 
+	const DefaultHeapBuffer& src, size_t srcOffsetInBytes, size_t sizeInBytes) noexcept
+{
+	const int idx = GetIndexForThread();
+
+	Assert(destOffsetInBytes + sizeInBytes <= dst.GetDesc().Width, "out-of-bounds copy.");
+	Assert(srcOffsetInBytes + sizeInBytes <= src.GetDesc().Width, "out-of-bounds copy.");
+
+	m_threadContext[idx].ResUploader->CopyBuffer(const_cast<DefaultHeapBuffer&>(dst).GetResource(), destOffsetInBytes,
+		const_cast<DefaultHeapBuffer&>(src).GetResource(), srcOffsetInBytes, sizeInBytes);
 }
 
 void GpuMemory::ReleaseDefaultHeapBuffer(DefaultHeapBuffer&& buff) noexcept
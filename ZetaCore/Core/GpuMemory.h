@@ -222,7 +222,13 @@ namespace ZetaRay::Core
 			D3D12_RESOURCE_STATES postCopyState,
 			bool allowUAV, 
 			void* data) noexcept;
-		void UploadToDefaultHeapBuffer(const DefaultHeapBuffer& buff, size_t sizeInBytes, void* data) noexcept;
+		// Copies sizeInBytes bytes from data to the given buffer, starting at destOffsetInBytes
+		void UploadToDefaultHeapBuffer(const DefaultHeapBuffer& buff, size_t sizeInBytes, void* data, 
+			size_t destOffsetInBytes = 0) noexcept;
+		// Copies sizeInBytes bytes from src (starting at srcOffsetInBytes) to dst (starting at destOffsetInBytes)
+		// on the GPU. Both buffers have to be in the COMMON state.
+		void CopyDefaultHeapBuffer(const DefaultHeapBuffer& dst, size_t destOffsetInBytes, 
+			const DefaultHeapBuffer& src, size_t srcOffsetInBytes, size_t sizeInBytes) noexcept;
 		void ReleaseDefaultHeapBuffer(DefaultHeapBuffer&& buff) noexcept;
 		void ReleaseTexture(Texture&& t) noexcept;
 
@@ -58,6 +58,11 @@ namespace ZetaRay
         {
             return Packed & 0x0fffffff;
         }
+
+        ALPHA_MODE GetAlphaMode() const
+        {
+            return (ALPHA_MODE)((Packed >> 28) & 0x3);
+        }
 #endif
         bool IsDoubleSided() CONST
         {
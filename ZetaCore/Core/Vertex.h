@@ -11,4 +11,19 @@ namespace ZetaRay::Core
 		Math::float2 TexUV;
 		Math::half3 Tangent;
 	};
+
+	// Compressed form of Vertex (20 bytes instead of 36), see Model/VertexCompression.h
+	struct CompressedVertex
+	{
+		// 16-bit unorm, relative to the mesh's AABB
+		uint16_t Position[3];
+		// octahedral encoding, 16-bit snorm
+		int16_t Normal[2];
+		int16_t Tangent[2];
+		Math::half2 TexUV;
+		// structured buffer strides need to be a multiple of four bytes
+		uint16_t Pad;
+	};
+
+	static_assert(sizeof(CompressedVertex) == 20, "CompressedVertex is expected to be 20 bytes.");
 }
\ No newline at end of file
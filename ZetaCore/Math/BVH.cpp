@@ -11,13 +11,13 @@ namespace
 {
 	struct alignas(16) Bin
 	{
-		ZetaInline void __vectorcall Extend(v_AABB box) noexcept
+		ZetaInline void ZETA_VECTORCALL Extend(v_AABB box) noexcept
 		{
 			Box = NumEntries > 0 ? compueUnionAABB(Box, box) : box;
 			NumEntries++;
 		}
 
-		ZetaInline void __vectorcall Extend(Bin bin) noexcept
+		ZetaInline void ZETA_VECTORCALL Extend(Bin bin) noexcept
 		{
 			Box = NumEntries > 0 ? compueUnionAABB(Box, bin.Box) : bin.Box;
 			NumEntries += bin.NumEntries;
@@ -32,18 +32,27 @@ namespace
 // Node
 //--------------------------------------------------------------------------------------
 
-void BVH::Node::InitAsLeaf(int base, int count, int parent) noexcept
+void BVH::Node::InitAsLeaf(Span<BVH::BVHInput> instances, int base, int count, int parent) noexcept
 {
 	Assert(count, "Invalid count");
+	Assert(base + count <= instances.size(), "Invalid base/count.");
+
+	// leaf AABBs aren't needed for traversal, but incremental insertion & rotations need them
+	v_AABB vBox(instances[base].AABB);
+
+	for (int i = base + 1; i < base + count; i++)
+		vBox = compueUnionAABB(vBox, v_AABB(instances[i].AABB));
+
+	AABB = store(vBox);
 	Base = base;
 	Count = count;
-//	AABB.Extents = float3(0.0f, 0.0f, 0.0f);
+	LeftChild = -1;
 	RightChild = -1;
 	Parent = parent;
 }
 
 void BVH::Node::InitAsInternal(Span<BVH::BVHInput> instances, int base, int count,
-	int right, int parent) noexcept
+	int left, int right, int parent) noexcept
 {
 	Assert(count, "Invalid count");
 	Assert(base + count <= instances.size(), "Invalid base/count.");
@@ -54,6 +63,9 @@ void BVH::Node::InitAsInternal(Span<BVH::BVHInput> instances, int base, int coun
 		vBox = compueUnionAABB(vBox, v_AABB(instances[i].AABB));
 
 	AABB = store(vBox);
+	Base = -1;
+	Count = 0;
+	LeftChild = left;
 	RightChild = right;
 	Parent = parent;
 }
@@ -65,7 +77,8 @@ void BVH::Node::InitAsInternal(Span<BVH::BVHInput> instances, int base, int coun
 BVH::BVH() noexcept
 	: m_arena(4 * 1096),
 	m_instances(m_arena),
-	m_nodes(m_arena)
+	m_nodes(m_arena),
+	m_freeInstanceSlots(m_arena)
 {
 }
 
@@ -73,41 +86,48 @@ void BVH::Clear() noexcept
 {
 	m_nodes.free_memory();
 	m_instances.free_memory();
+	m_freeInstanceSlots.free_memory();
+	m_numNodes = 0;
+	m_root = -1;
+	m_freeNodeHead = -1;
 }
 
 void BVH::Build(Span<BVHInput> instances) noexcept
 {
+	m_nodes.clear();
+	m_instances.clear();
+	m_freeInstanceSlots.clear();
+	m_numNodes = 0;
+	m_root = -1;
+	m_freeNodeHead = -1;
+
 	if (instances.size() == 0)
 		return;
 
 	//m_instances.swap(instances);
 	m_instances.append_range(instances.begin(), instances.end(), true);
-	Check(m_instances.size() < UINT32_MAX, "#Instances can't exceed UINT32_MAX.");
+	Check(m_instances.size() < INT32_MAX, "#Instances can't exceed INT32_MAX.");
 	const uint32_t numInstances = (uint32_t)m_instances.size();
 
 	// special case when there's less than MAX_NUM_MODELS_PER_LEAF instances
 	if (m_instances.size() <= MAX_NUM_INSTANCES_PER_LEAF)
 	{
 		m_nodes.resize(1);
-
-		v_AABB vBox(m_instances[0].AABB);
-
-		for (int i = 1; i < m_instances.size(); i++)
-			vBox = compueUnionAABB(vBox, v_AABB(m_instances[i].AABB));
-
-		m_nodes[0].AABB = store(vBox);
-		m_nodes[0].Base = 0;
-		m_nodes[0].Count = (int)m_instances.size();
-		m_nodes[0].RightChild = -1;
-
-		return;
+		m_nodes[0].InitAsLeaf(m_instances, 0, (int)m_instances.size(), -1);
+		m_numNodes = 1;
+		m_root = 0;
 	}
+	else
+	{
+		// a binary tree with at most numInstances leaves
+		const uint32_t MAX_NUM_NODES = 2 * numInstances - 1;
+		m_nodes.resize(MAX_NUM_NODES);
 
-	// TODO check this computation
-	const uint32_t MAX_NUM_NODES = (uint32_t)Math::CeilUnsignedIntDiv(4 * numInstances, MAX_NUM_INSTANCES_PER_LEAF) + 1;
-	m_nodes.resize(MAX_NUM_NODES);
+		m_root = BuildSubtree(0, numInstances, -1);
 
-	BuildSubtree(0, numInstances, -1);
+		// new nodes from incremental insertions are appended to the end
+		m_nodes.resize(m_numNodes);
+	}
 }
 
 int BVH::BuildSubtree(int base, int count, int parent) noexcept
@@ -119,7 +139,7 @@ int BVH::BuildSubtree(int base, int count, int parent) noexcept
 	// create a leaf node and return
 	if (count <= MAX_NUM_INSTANCES_PER_LEAF)
 	{
-		m_nodes[currNodeIdx].InitAsLeaf(base, count, parent);
+		m_nodes[currNodeIdx].InitAsLeaf(m_instances, base, count, parent);
 		return currNodeIdx;
 	}
 
@@ -147,7 +167,7 @@ int BVH::BuildSubtree(int base, int count, int parent) noexcept
 	// all centroids are (almost) the same point, no point in splitting further
 	if (centroidAABB.Extents.x + centroidAABB.Extents.y + centroidAABB.Extents.z <= 1e-5f)
 	{
-		m_nodes[currNodeIdx].InitAsLeaf(base, count, parent);
+		m_nodes[currNodeIdx].InitAsLeaf(m_instances, base, count, parent);
 		return currNodeIdx;
 	}
 
@@ -238,7 +258,7 @@ int BVH::BuildSubtree(int base, int count, int parent) noexcept
 		const float noSplitCost = (float)count;
 		if (noSplitCost <= lowestCost)
 		{
-			m_nodes[currNodeIdx].InitAsLeaf(base, count, parent);
+			m_nodes[currNodeIdx].InitAsLeaf(m_instances, base, count, parent);
 			return currNodeIdx;
 		}
 
@@ -280,7 +300,7 @@ int BVH::BuildSubtree(int base, int count, int parent) noexcept
 	uint32_t right = BuildSubtree(base + splitCount, count - splitCount, currNodeIdx);
 	Assert(left == currNodeIdx + 1, "Index of left child should be equal to current parent's index plus one");
 
-	m_nodes[currNodeIdx].InitAsInternal(m_instances, base, count, right, parent);
+	m_nodes[currNodeIdx].InitAsInternal(m_instances, base, count, left, right, parent);
 
 	return currNodeIdx;
 }
@@ -289,26 +309,26 @@ int BVH::Find(uint64_t ID, const Math::AABB& AABB, int& nodeIdx) noexcept
 {
 	nodeIdx = -1;
 
+	if (m_root == -1)
+		return -1;
+
 	// using a manual stack, we can return early when a match is found, whereas
 	// with a recursive call, travelling back through the call-chain is required
-	constexpr int STACK_SIZE = 64;
-	int stack[STACK_SIZE];
-	int currStackIdx = 0;
-	stack[currStackIdx] = 0;	// insert root
+	SmallVector<int, Support::SystemAllocator, STACK_SIZE> stack;
+	stack.push_back(m_root);	// insert root
 	
 	v_AABB vBox(AABB);
 
 	// can return early if root doesn't intersect or contain the given AABB
-	if(Math::intersectAABBvsAABB(vBox, v_AABB(m_nodes[0].AABB)) == COLLISION_TYPE::DISJOINT)
+	if(Math::intersectAABBvsAABB(vBox, v_AABB(m_nodes[m_root].AABB)) == COLLISION_TYPE::DISJOINT)
 		return -1;
 
 	int currNodeIdx = -1;
 
-	while (currStackIdx >= 0)
+	while (!stack.empty())
 	{
-		Assert(currStackIdx < 64, "Stack size exceeded 64.");
-
-		currNodeIdx = stack[currStackIdx--];
+		currNodeIdx = stack.back();
+		stack.pop_back();
 		const Node& node = m_nodes[currNodeIdx];
 		
 		if (node.IsLeaf())
@@ -330,7 +350,7 @@ int BVH::Find(uint64_t ID, const Math::AABB& AABB, int& nodeIdx) noexcept
 		if(Math::intersectAABBvsAABB(vNodeBox, vBox) != COLLISION_TYPE::DISJOINT)
 		{
 			// decide which tree to descend on first
-			v_AABB vLeft(m_nodes[currNodeIdx + 1].AABB);
+			v_AABB vLeft(m_nodes[node.LeftChild].AABB);
 			v_AABB vRight(m_nodes[node.RightChild].AABB);
 
 			v_AABB vOverlapLeft = Math::computeOverlapAABB(vBox, vLeft);
@@ -339,7 +359,7 @@ int BVH::Find(uint64_t ID, const Math::AABB& AABB, int& nodeIdx) noexcept
 			Math::AABB Left = Math::store(vOverlapLeft);
 			Math::AABB Right = Math::store(vOverlapRight);
 
-			float leftOverlapVolume = m_nodes[currNodeIdx + 1].IsLeaf() ? FLT_MAX : 
+			float leftOverlapVolume = m_nodes[node.LeftChild].IsLeaf() ? FLT_MAX : 
 				Left.Extents.x * Left.Extents.y * Left.Extents.z;
 			float rightOverlapVolume = m_nodes[node.RightChild].IsLeaf() ? FLT_MAX : 
 				Right.Extents.x * Right.Extents.y * Right.Extents.z;
@@ -347,64 +367,116 @@ int BVH::Find(uint64_t ID, const Math::AABB& AABB, int& nodeIdx) noexcept
 			// bigger overlap with the right subtree, descend throught that first
 			if (leftOverlapVolume <= rightOverlapVolume)
 			{
-				stack[++currStackIdx] = currNodeIdx + 1;
-				stack[++currStackIdx] = node.RightChild;
+				stack.push_back(node.LeftChild);
+				stack.push_back(node.RightChild);
 			}
 			else
 			{
-				stack[++currStackIdx] = node.RightChild;
-				stack[++currStackIdx] = currNodeIdx + 1;
+				stack.push_back(node.RightChild);
+				stack.push_back(node.LeftChild);
 			}
 		}
 	}
 
-	return currNodeIdx;
+	return -1;
 }
 
 void BVH::Update(Span<BVHUpdateInput> instances) noexcept
 {
 	for (auto& [oldBox, newBox, id] : instances)
 	{
+		const v_AABB vOldBox(oldBox);
+		const v_AABB vNewBox(newBox);
+
+		Math::COLLISION_TYPE res = Math::intersectAABBvsAABB(vOldBox, vNewBox);
+
+		// instance has moved to a different region of space, growing the ancestors' AABBs would 
+		// degrade the tree quality, reinsert it instead
+		if (res == COLLISION_TYPE::DISJOINT)
+		{
+			Remove(id, oldBox);
+			Insert(BVHInput{ .AABB = newBox, .ID = id });
+
+			continue;
+		}
+
 		// find the leaf node that contains it
 		int nodeIdx;
 		int instanceIdx = Find(id, oldBox, nodeIdx);
 		Assert(instanceIdx != -1, "Instance with ID %u was not found.", id);
 
 		// update the bounding box
-		Node& node = m_nodes[nodeIdx];
 		m_instances[instanceIdx].AABB = newBox;
 
-		const v_AABB vOldBox(oldBox);
-		const v_AABB vNewBox(newBox);
-
-		Math::COLLISION_TYPE res = Math::intersectAABBvsAABB(vOldBox, vNewBox);
-
 		// if the old AABB contains the new one, keep using the old one
 		if (res != COLLISION_TYPE::CONTAINS)
 		{
-			int currParent = node.Parent;
+			int currNode = nodeIdx;
 
-			// following the parent indices, keep going up the tree and merge the AABBs. Break once a parent node's
-			// AABB contains the new one
-			while (currParent != -1)
+			// starting from the leaf and following the parent indices, keep going up the tree and merge 
+			// the AABBs. Break once a node's AABB contains the new one
+			while (currNode != -1)
 			{
-				Node& parentNode = m_nodes[currParent];
+				Node& node = m_nodes[currNode];
 
-				v_AABB vParentBox(parentNode.AABB);
-				if (Math::intersectAABBvsAABB(vParentBox, vNewBox) == COLLISION_TYPE::CONTAINS)
+				v_AABB vNodeBox(node.AABB);
+				if (Math::intersectAABBvsAABB(vNodeBox, vNewBox) == COLLISION_TYPE::CONTAINS)
 					break;
 
-				vParentBox = Math::compueUnionAABB(vParentBox, vNewBox);
-				parentNode.AABB = Math::store(vParentBox);
+				vNodeBox = Math::compueUnionAABB(vNodeBox, vNewBox);
+				node.AABB = Math::store(vNodeBox);
 
-				currParent = m_nodes[currParent].Parent;
+				currNode = node.Parent;
 			}
 		}
+	}
+}
+
+void BVH::Insert(const BVHInput& instance) noexcept
+{
+	const int slot = AllocateInstanceSlot();
+	m_instances[slot] = instance;
+
+	// allocate both nodes first as allocation may invalidate the references
+	const int leaf = AllocateNode();
+	m_nodes[leaf].InitAsLeaf(m_instances, slot, 1, -1);
+
+	if (m_root == -1)
+	{
+		m_root = leaf;
+		return;
+	}
 
-		// Note: when the new AABB and the old AABB are disjoint, it'd be better to
-		// remove and then reinsert the update Node. That requires modifying the range of
-		// all the leaves, which is expensive
+	const int newParent = AllocateNode();
+	const int sibling = FindBestSibling(instance.AABB);
+	const int oldParent = m_nodes[sibling].Parent;
+
+	// new parent takes the sibling's place in the tree, with the sibling and the new leaf as its children
+	Node& parentNode = m_nodes[newParent];
+	parentNode.AABB = store(compueUnionAABB(v_AABB(m_nodes[sibling].AABB), v_AABB(instance.AABB)));
+	parentNode.Base = -1;
+	parentNode.Count = 0;
+	parentNode.LeftChild = sibling;
+	parentNode.RightChild = leaf;
+	parentNode.Parent = oldParent;
+
+	m_nodes[sibling].Parent = newParent;
+	m_nodes[leaf].Parent = newParent;
+
+	if (oldParent == -1)
+	{
+		m_root = newParent;
+		return;
 	}
+
+	Node& oldParentNode = m_nodes[oldParent];
+
+	if (oldParentNode.LeftChild == sibling)
+		oldParentNode.LeftChild = newParent;
+	else
+		oldParentNode.RightChild = newParent;
+
+	RefitAndRotate(oldParent);
 }
 
 void BVH::Remove(uint64_t ID, const Math::AABB& AABB) noexcept
@@ -414,100 +486,301 @@ void BVH::Remove(uint64_t ID, const Math::AABB& AABB) noexcept
 	const int instanceIdx = Find(ID, AABB, nodeIdx);
 	Assert(instanceIdx != -1, "Instance with ID %u was not found.", ID);
 
-	m_instances[instanceIdx].ID = uint64_t(-1);
-	m_instances[instanceIdx].AABB.Extents = float3(-1.0f, -1.0f, -1.0f);
-	m_instances[instanceIdx].AABB.Center = float3(0.0f, 0.0f, 0.0f);
+	Node& leaf = m_nodes[nodeIdx];
 
-	// swap with the last Instance in this leaf
-	const uint32_t swapIdx = m_nodes[nodeIdx].Base + m_nodes[nodeIdx].Count - 1;
+	// swap with the last Instance in this leaf, the last slot is then free to be reused
+	const int swapIdx = leaf.Base + leaf.Count - 1;
 	std::swap(m_instances[instanceIdx], m_instances[swapIdx]);
-	m_nodes[nodeIdx].Count--;
+	leaf.Count--;
+
+	m_instances[swapIdx].ID = uint64_t(-1);
+	m_instances[swapIdx].AABB.Extents = float3(-1.0f, -1.0f, -1.0f);
+	m_instances[swapIdx].AABB.Center = float3(0.0f, 0.0f, 0.0f);
+	m_freeInstanceSlots.push_back(swapIdx);
+
+	if (leaf.Count > 0)
+	{
+		// shrink the leaf AABB and propagate the change up the tree
+		leaf.InitAsLeaf(m_instances, leaf.Base, leaf.Count, leaf.Parent);
+
+		if (leaf.Parent != -1)
+			RefitAndRotate(leaf.Parent);
+
+		return;
+	}
+
+	// leaf is empty now, replace its parent with its sibling
+	const int parent = leaf.Parent;
+	ReleaseNode(nodeIdx);
+
+	if (parent == -1)
+	{
+		m_root = -1;
+		return;
+	}
+
+	const Node& parentNode = m_nodes[parent];
+	const int sibling = parentNode.LeftChild == nodeIdx ? parentNode.RightChild : parentNode.LeftChild;
+	const int grandParent = parentNode.Parent;
+
+	m_nodes[sibling].Parent = grandParent;
+	ReleaseNode(parent);
+
+	if (grandParent == -1)
+	{
+		m_root = sibling;
+		return;
+	}
+
+	Node& grandParentNode = m_nodes[grandParent];
+
+	if (grandParentNode.LeftChild == parent)
+		grandParentNode.LeftChild = sibling;
+	else
+		grandParentNode.RightChild = sibling;
+
+	RefitAndRotate(grandParent);
 }
 
-void BVH::DoFrustumCulling(const Math::ViewFrustum& viewFrustum, 
-	const Math::float4x4a& viewToWorld, 
-	Vector<uint64_t, App::FrameAllocator>& visibleInstanceIDs)
+int BVH::FindBestSibling(const Math::AABB& AABB) noexcept
 {
-	// transform view frustum from view space into world space
-	v_float4x4 vM = load(const_cast<float4x4a&>(viewToWorld));
-	v_ViewFrustum vFrustum(const_cast<ViewFrustum&>(viewFrustum));
-	vFrustum = Math::transform(vM, vFrustum);
+	Assert(m_root != -1, "BVH hasn't been built yet.");
 
-	v_AABB vBox(m_nodes[0].AABB);
+	const v_AABB vBox(AABB);
+	const float boxArea = computeAABBSurfaceArea(vBox);
 
-	// root doesn't intersect camera
-	if (Math::instersectFrustumVsAABB(vFrustum, vBox) == COLLISION_TYPE::DISJOINT)
-		return;
+	struct Candidate
+	{
+		int Node;
+		// increase in surface area of all the ancestors if the new node was inserted in this subtree
+		float InheritedCost;
+	};
 
-	// manual stack
-	constexpr int STACK_SIZE = 64;
-	int stack[STACK_SIZE];
-	int currStackIdx = 0;
+	// branch and bound -- with a manual stack, subtrees whose lower bound on cost is higher 
+	// than the best cost found so far are pruned
+	SmallVector<Candidate, Support::SystemAllocator, STACK_SIZE> stack;
+	stack.push_back(Candidate{ .Node = m_root, .InheritedCost = 0.0f });
 
-	// insert root
-	stack[currStackIdx] = 0;
-	int currNode = -1;
+	int bestSibling = m_root;
+	float bestCost = FLT_MAX;
 
-	while (currStackIdx >= 0)
+	while (!stack.empty())
 	{
-		Assert(currStackIdx < 64, "Stack size exceeded maximum allowed.");
+		const Candidate curr = stack.back();
+		stack.pop_back();
+		const Node& node = m_nodes[curr.Node];
 
-		currNode = stack[currStackIdx--];
-		const Node& node = m_nodes[currNode];
+		const v_AABB vNodeBox(node.AABB);
+		const float nodeArea = computeAABBSurfaceArea(vNodeBox);
+		const float unionArea = computeAABBSurfaceArea(compueUnionAABB(vNodeBox, vBox));
 
-		if (node.IsLeaf())
+		// cost of pairing with this node is the surface area of the new parent plus the increase
+		// in surface area of all the ancestors
+		const float cost = unionArea + curr.InheritedCost;
+
+		if (cost < bestCost)
 		{
-			for (int i = node.Base; i < node.Base + node.Count; i++)
-			{
-				vBox.Reset(m_instances[i].AABB);
+			bestCost = cost;
+			bestSibling = curr.Node;
+		}
 
-				if (Math::instersectFrustumVsAABB(vFrustum, vBox) != COLLISION_TYPE::DISJOINT)
-					visibleInstanceIDs.push_back(m_instances[i].ID);
-			}
+		if (node.IsLeaf())
+			continue;
+
+		// cost of pairing with any node in this subtree is at least the surface area of the new 
+		// node plus the inherited cost
+		const float inheritedCost = curr.InheritedCost + unionArea - nodeArea;
+
+		if (boxArea + inheritedCost < bestCost)
+		{
+			stack.push_back(Candidate{ .Node = node.RightChild, .InheritedCost = inheritedCost });
+			stack.push_back(Candidate{ .Node = node.LeftChild, .InheritedCost = inheritedCost });
 		}
-		else
+	}
+
+	return bestSibling;
+}
+
+void BVH::RefitAndRotate(int nodeIdx) noexcept
+{
+	while (nodeIdx != -1)
+	{
+		Node& node = m_nodes[nodeIdx];
+		Assert(!node.IsLeaf(), "Leaves can't be refitted from their children.");
+
+		node.AABB = store(compueUnionAABB(v_AABB(m_nodes[node.LeftChild].AABB), 
+			v_AABB(m_nodes[node.RightChild].AABB)));
+
+		Rotate(nodeIdx);
+		nodeIdx = node.Parent;
+	}
+}
+
+void BVH::Rotate(int nodeIdx) noexcept
+{
+	// Given node A with children B & C, where B has children D & E and C has children F & G, 
+	// there are four possible rotations: B <-> F, B <-> G, C <-> D and C <-> E. Each rotation 
+	// only changes the AABB of the child that receives the swapped node.
+	const Node& node = m_nodes[nodeIdx];
+	const int b = node.LeftChild;
+	const int c = node.RightChild;
+	const Node& nodeB = m_nodes[b];
+	const Node& nodeC = m_nodes[c];
+	const v_AABB vB(nodeB.AABB);
+	const v_AABB vC(nodeC.AABB);
+
+	// node from the first level that's moved down, its sibling and the grandchild that's moved up
+	int bestChild = -1;
+	int bestSibling = -1;
+	int bestGrandchild = -1;
+	float bestDiff = 0.0f;
+
+	auto evaluate = [this, &bestChild, &bestSibling, &bestGrandchild, &bestDiff](int child, v_AABB vChild, 
+		int sibling, const Node& siblingNode, v_AABB vSibling)
 		{
-			vBox.Reset(node.AABB);
+			if (siblingNode.IsLeaf())
+				return;
 
-			if (Math::instersectFrustumVsAABB(vFrustum, vBox) != COLLISION_TYPE::DISJOINT)
+			const float siblingArea = computeAABBSurfaceArea(vSibling);
+			const v_AABB vF(m_nodes[siblingNode.LeftChild].AABB);
+			const v_AABB vG(m_nodes[siblingNode.RightChild].AABB);
+
+			// swap with left grandchild, sibling then becomes the union of child and right grandchild
+			float diff = computeAABBSurfaceArea(compueUnionAABB(vChild, vG)) - siblingArea;
+
+			if (diff < bestDiff)
 			{
-				stack[++currStackIdx] = node.RightChild;
-				stack[++currStackIdx] = currNode + 1;
+				bestDiff = diff;
+				bestChild = child;
+				bestSibling = sibling;
+				bestGrandchild = siblingNode.LeftChild;
 			}
-		}
+
+			// swap with right grandchild
+			diff = computeAABBSurfaceArea(compueUnionAABB(vF, vChild)) - siblingArea;
+
+			if (diff < bestDiff)
+			{
+				bestDiff = diff;
+				bestChild = child;
+				bestSibling = sibling;
+				bestGrandchild = siblingNode.RightChild;
+			}
+		};
+
+	evaluate(b, vB, c, nodeC, vC);
+	evaluate(c, vC, b, nodeB, vB);
+
+	if (bestChild == -1)
+		return;
+
+	Node& parentNode = m_nodes[nodeIdx];
+	Node& siblingNode = m_nodes[bestSibling];
+
+	if (parentNode.LeftChild == bestChild)
+		parentNode.LeftChild = bestGrandchild;
+	else
+		parentNode.RightChild = bestGrandchild;
+
+	if (siblingNode.LeftChild == bestGrandchild)
+		siblingNode.LeftChild = bestChild;
+	else
+		siblingNode.RightChild = bestChild;
+
+	m_nodes[bestGrandchild].Parent = nodeIdx;
+	m_nodes[bestChild].Parent = bestSibling;
+
+	siblingNode.AABB = store(compueUnionAABB(v_AABB(m_nodes[siblingNode.LeftChild].AABB), 
+		v_AABB(m_nodes[siblingNode.RightChild].AABB)));
+}
+
+int BVH::AllocateNode() noexcept
+{
+	if (m_freeNodeHead != -1)
+	{
+		const int nodeIdx = m_freeNodeHead;
+		m_freeNodeHead = m_nodes[nodeIdx].Base;
+
+		return nodeIdx;
 	}
+
+	Check(m_nodes.size() < INT32_MAX, "#Nodes can't exceed INT32_MAX.");
+	m_nodes.emplace_back();
+
+	return (int)m_nodes.size() - 1;
 }
 
-void BVH::DoFrustumCulling(const Math::ViewFrustum& viewFrustum,
-	const Math::float4x4a& viewToWorld,
-	Vector<BVHInput, App::FrameAllocator>& visibleInstanceIDs)
+void BVH::ReleaseNode(int nodeIdx) noexcept
 {
-	// transform view frustum from view space into world space
-	v_float4x4 vM = load(const_cast<float4x4a&>(viewToWorld));
-	v_ViewFrustum vFrustum(const_cast<ViewFrustum&>(viewFrustum));
-	vFrustum = Math::transform(vM, vFrustum);
+	Node& node = m_nodes[nodeIdx];
+	node.Base = m_freeNodeHead;
+	node.Count = 0;
+	node.LeftChild = -1;
+	node.RightChild = -1;
+	node.Parent = -1;
+
+	m_freeNodeHead = nodeIdx;
+}
 
-	v_AABB vBox(m_nodes[0].AABB);
+int BVH::AllocateInstanceSlot() noexcept
+{
+	if (!m_freeInstanceSlots.empty())
+	{
+		const int slot = m_freeInstanceSlots.back();
+		m_freeInstanceSlots.pop_back();
+
+		return slot;
+	}
+
+	Check(m_instances.size() < INT32_MAX, "#Instances can't exceed INT32_MAX.");
+	m_instances.emplace_back();
+
+	return (int)m_instances.size() - 1;
+}
 
-	// root doesn't intersect camera
-	if (Math::instersectFrustumVsAABB(vFrustum, vBox) == COLLISION_TYPE::DISJOINT)
+float BVH::ComputeSAHCost() const noexcept
+{
+	if (m_root == -1)
+		return 0.0f;
+
+	const float rootArea = computeAABBSurfaceArea(v_AABB(m_nodes[m_root].AABB));
+	if (rootArea <= 0.0f)
+		return 0.0f;
+
+	float cost = 0.0f;
+
+	for (int i = 0; i < (int)m_nodes.size(); i++)
+	{
+		const Node& node = m_nodes[i];
+
+		// skip the released nodes
+		if (node.Parent == -1 && i != m_root)
+			continue;
+
+		const float area = computeAABBSurfaceArea(v_AABB(node.AABB));
+		cost += node.IsLeaf() ? area * node.Count : area * SAH_TRAVERSAL_COST;
+	}
+
+	return cost / rootArea;
+}
+
+template<typename Overlaps, typename Func>
+void BVH::Traverse(Overlaps overlaps, Func onOverlap) const noexcept
+{
+	if (m_root == -1)
 		return;
 
 	// manual stack
-	constexpr int STACK_SIZE = 64;
-	int stack[STACK_SIZE];
-	int currStackIdx = 0;
+	SmallVector<int, Support::SystemAllocator, STACK_SIZE> stack;
 
 	// insert root
-	stack[currStackIdx] = 0;
-	int currNode = -1;
+	stack.push_back(m_root);
+	v_AABB vBox;
 
-	while (currStackIdx >= 0)
+	while (!stack.empty())
 	{
-		Assert(currStackIdx < 64, "Stack size exceeded maximum allowed.");
-
-		currNode = stack[currStackIdx--];
-		const Node& node = m_nodes[currNode];
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
 
 		if (node.IsLeaf())
 		{
@@ -515,30 +788,85 @@ void BVH::DoFrustumCulling(const Math::ViewFrustum& viewFrustum,
 			{
 				vBox.Reset(m_instances[i].AABB);
 
-				if (Math::instersectFrustumVsAABB(vFrustum, vBox) != COLLISION_TYPE::DISJOINT)
-				{
-					visibleInstanceIDs.emplace_back(BVH::BVHInput{
-						.AABB = m_instances[i].AABB,
-						.ID = m_instances[i].ID });
-				}
+				if (overlaps(vBox))
+					onOverlap(m_instances[i]);
 			}
 		}
 		else
 		{
 			vBox.Reset(node.AABB);
 
-			if (Math::instersectFrustumVsAABB(vFrustum, vBox) != COLLISION_TYPE::DISJOINT)
+			if (overlaps(vBox))
 			{
-				stack[++currStackIdx] = node.RightChild;
-				stack[++currStackIdx] = currNode + 1;
+				stack.push_back(node.RightChild);
+				stack.push_back(node.LeftChild);
 			}
 		}
 	}
 }
 
-uint64_t BVH::CastRay(Math::Ray& r) noexcept
+template<typename Func>
+void BVH::FrustumCull(const v_ViewFrustum& vFrustum, Func onVisible) const noexcept
+{
+	Traverse([&vFrustum](const v_AABB& vBox)
+		{
+			return Math::instersectFrustumVsAABB(vFrustum, vBox) != COLLISION_TYPE::DISJOINT;
+		}, 
+		onVisible);
+}
+
+void BVH::DoFrustumCulling(const Math::ViewFrustum& viewFrustum, 
+	const Math::float4x4a& viewToWorld, 
+	Vector<uint64_t, App::FrameAllocator>& visibleInstanceIDs) const
 {
-	v_AABB vBox(m_nodes[0].AABB);
+	// transform view frustum from view space into world space
+	v_float4x4 vM = load(const_cast<float4x4a&>(viewToWorld));
+	v_ViewFrustum vFrustum(const_cast<ViewFrustum&>(viewFrustum));
+	vFrustum = Math::transform(vM, vFrustum);
+
+	FrustumCull(vFrustum, [&visibleInstanceIDs](const BVHInput& instance)
+		{
+			visibleInstanceIDs.push_back(instance.ID);
+		});
+}
+
+void BVH::DoFrustumCulling(const Math::ViewFrustum& viewFrustum,
+	const Math::float4x4a& viewToWorld,
+	Vector<BVHInput, App::FrameAllocator>& visibleInstanceIDs) const
+{
+	// transform view frustum from view space into world space
+	v_float4x4 vM = load(const_cast<float4x4a&>(viewToWorld));
+	v_ViewFrustum vFrustum(const_cast<ViewFrustum&>(viewFrustum));
+	vFrustum = Math::transform(vM, vFrustum);
+
+	FrustumCull(vFrustum, [&visibleInstanceIDs](const BVHInput& instance)
+		{
+			visibleInstanceIDs.emplace_back(BVH::BVHInput{
+				.AABB = instance.AABB,
+				.ID = instance.ID });
+		});
+}
+
+void BVH::DoOverlapQuery(const Math::AABB& box, Vector<uint64_t>& instanceIDs) const noexcept
+{
+	const v_AABB vQuery(box);
+
+	Traverse([&vQuery](const v_AABB& vBox)
+		{
+			return Math::intersectAABBvsAABB(vQuery, vBox) != COLLISION_TYPE::DISJOINT;
+		},
+		[&instanceIDs](const BVHInput& instance)
+		{
+			instanceIDs.push_back(instance.ID);
+		});
+}
+
+uint64_t BVH::CastRay(Math::Ray& r) const noexcept
+{
+	if (m_root == -1)
+		return uint64_t(-1);
+
+	v_AABB vBox(m_nodes[m_root].AABB);
 	v_Ray vRay(r);
 	float t;
 
@@ -551,22 +879,17 @@ uint64_t BVH::CastRay(Math::Ray& r) noexcept
 		return uint64_t(-1);
 
 	// manual stack
-	constexpr int STACK_SIZE = 64;
-	int stack[STACK_SIZE];
-	int currStackIdx = 0;
+	SmallVector<int, Support::SystemAllocator, STACK_SIZE> stack;
 
 	// insert root
-	stack[currStackIdx] = 0;
-	int currNode = -1;
+	stack.push_back(m_root);
 	float minT = FLT_MAX;
 	uint64_t closestID = uint64_t(-1);
 
-	while (currStackIdx >= 0)
+	while (!stack.empty())
 	{
-		Assert(currStackIdx < STACK_SIZE, "Stack size exceeded 64.");
-
-		currNode = stack[currStackIdx--];
-		const Node& node = m_nodes[currNode];
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
 
 		if (node.IsLeaf())
 		{
@@ -584,28 +907,30 @@ uint64_t BVH::CastRay(Math::Ray& r) noexcept
 		}
 		else
 		{
-			const Node& leftChild = m_nodes[currNode + 1];
-			const Node& rightChild = m_nodes[node.RightChild];
-			const v_AABB vLeftBox(leftChild.AABB);
-			const v_AABB vRightBox(rightChild.AABB);
+			const v_AABB vLeftBox(m_nodes[node.LeftChild].AABB);
+			const v_AABB vRightBox(m_nodes[node.RightChild].AABB);
 			float leftT;
 			float rightT;
 
 			const bool hitLeftChild = Math::intersectRayVsAABB(vRay, vDirRcp, vDirIsPos, vIsParallel, vLeftBox, leftT);
 			const bool hitRightChild = Math::intersectRayVsAABB(vRay, vDirRcp, vDirIsPos, vIsParallel, vRightBox, rightT);
 
-			int sortedByT[2] = { currNode + 1, node.RightChild };
-			const int numChilds = hitLeftChild + hitRightChild;
+			// no need to search subtrees that are farther away than the closest hit so far
+			const bool searchLeft = hitLeftChild && leftT < minT;
+			const bool searchRight = hitRightChild && rightT < minT;
 
-			// make sure subtree closer to camera is searched first
-			if (numChilds == 2 && leftT < rightT)
-				std::swap(sortedByT[0], sortedByT[1]);
-
-			for (int c = 0; c < numChilds; c++)
+			// make sure subtree closer to camera is searched first (i.e. pushed last)
+			if (searchLeft && searchRight && leftT < rightT)
 			{
-				// no need to search this subtree as earlier hits are necessarily closer to camera
-				if(sortedByT[c] < minT)
-					stack[++currStackIdx] = sortedByT[c];
+				stack.push_back(node.RightChild);
+				stack.push_back(node.LeftChild);
+			}
+			else
+			{
+				if (searchLeft)
+					stack.push_back(node.LeftChild);
+				if (searchRight)
+					stack.push_back(node.RightChild);
 			}
 		}
 	}
@@ -613,4 +938,59 @@ uint64_t BVH::CastRay(Math::Ray& r) noexcept
 	return closestID;
 }
 
+void BVH::CastRay(Math::Ray& r, Vector<InstanceHit, App::FrameAllocator>& hits) const noexcept
+{
+	if (m_root == -1)
+		return;
+
+	v_AABB vBox(m_nodes[m_root].AABB);
+	v_Ray vRay(r);
+	float t;
+
+	const __m128 vIsParallel = _mm_cmpge_ps(_mm_set1_ps(FLT_EPSILON), abs(vRay.vDir));
+	const __m128 vDirRcp = _mm_div_ps(_mm_set1_ps(1.0f), vRay.vDir);
+	const __m128 vDirIsPos = _mm_cmpge_ps(vRay.vDir, _mm_setzero_ps());
+
+	// can return early if ray doesn't intersect root AABB
+	if (!Math::intersectRayVsAABB(vRay, vDirRcp, vDirIsPos, vIsParallel, vBox, t))
+		return;
+
+	// manual stack
+	SmallVector<int, Support::SystemAllocator, STACK_SIZE> stack;
+
+	// insert root
+	stack.push_back(m_root);
+	const size_t firstHit = hits.size();
+
+	while (!stack.empty())
+	{
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		if (node.IsLeaf())
+		{
+			for (int i = node.Base; i < node.Base + node.Count; i++)
+			{
+				vBox.Reset(m_instances[i].AABB);
+
+				if (Math::intersectRayVsAABB(vRay, vDirRcp, vDirIsPos, vIsParallel, vBox, t))
+					hits.push_back(InstanceHit{ .ID = m_instances[i].ID, .T = t });
+			}
+		}
+		else
+		{
+			vBox.Reset(m_nodes[node.LeftChild].AABB);
+			if (Math::intersectRayVsAABB(vRay, vDirRcp, vDirIsPos, vIsParallel, vBox, t))
+				stack.push_back(node.LeftChild);
 
+			vBox.Reset(m_nodes[node.RightChild].AABB);
+			if (Math::intersectRayVsAABB(vRay, vDirRcp, vDirIsPos, vIsParallel, vBox, t))
+				stack.push_back(node.RightChild);
+		}
+	}
+
+	std::sort(hits.begin() + firstHit, hits.end(), [](const InstanceHit& lhs, const InstanceHit& rhs)
+		{
+			return lhs.T < rhs.T;
+		});
+}
@@ -1,8 +1,14 @@
-// This implmentation uses a top-down approach to build the BVH. 
+// This implmentation uses a top-down approach to build the BVH. Afterwards, instances can be 
+// inserted or removed incrementally and tree rotations are used to keep the SAH cost of the 
+// tree close to that of a full rebuild.
 // 
 // References:
 // 1. Physically Based Rendering 3rd Ed.
 // 2. Real-time Collision Detection
+// 3. D. Kopta, T. Ize, J. Spjut, E. Brunvand, A. Davis and A. Kensler, "Fast, Effective BVH 
+//    Updates for Animated Scenes," in I3D, 2012.
+// 4. J. Bittner, M. Hapala and V. Havran, "Incremental BVH construction for ray tracing," 
+//    Computers & Graphics, 2015.
 
 #pragma once
 
@@ -37,34 +43,61 @@ namespace ZetaRay::Math
 		BVH(BVH&&) = delete;
 		BVH& operator=(BVH&&) = delete;
 
-		bool IsBuilt() noexcept { return m_nodes.size() != 0; }
+		bool IsBuilt() const noexcept { return m_root != -1; }
 		void Clear() noexcept;
 
+		// Builds the BVH from scratch, replacing any existing contents
 		void Build(Util::Span<BVHInput> instances) noexcept;
 		void Update(Util::Span<BVHUpdateInput> instances) noexcept;
+
+		// Inserts a new instance in O(log n) by finding the sibling that minimizes the increase 
+		// in SAH cost (branch and bound). Ancestors are then refitted and rotated.
+		void Insert(const BVHInput& instance) noexcept;
+
+		// Removes the given instance. Leaves that become empty are collapsed into their sibling. 
+		// AABB is used to accelerate finding the instance.
 		void Remove(uint64_t ID, const Math::AABB& AABB) noexcept;
+
+		// Returns the SAH cost of the tree (normalized by the surface area of the root). Useful 
+		// for measuring the tree quality after incremental updates compared to a full rebuild
+		float ComputeSAHCost() const noexcept;
 		
 		// Returns ID of instances that at least partially overlap the view frustum. Assumes 
 		// the view frustum is in the view space
 		void DoFrustumCulling(const Math::ViewFrustum& viewFrustum, 
 			const Math::float4x4a& viewToWorld,
-			Util::Vector<uint64_t, App::FrameAllocator>& visibleInstanceIDs);
+			Util::Vector<uint64_t, App::FrameAllocator>& visibleInstanceIDs) const;
 
 		// Returns IDs & AABBs of instances that at least partially overlap the view frustum. Assumes 
 		// the view frustum is in the view space
 		void DoFrustumCulling(const Math::ViewFrustum& viewFrustum,
 			const Math::float4x4a& viewToWorld,
-			Util::Vector<BVHInput, App::FrameAllocator>& visibleInstanceIDs);
+			Util::Vector<BVHInput, App::FrameAllocator>& visibleInstanceIDs) const;
+
+		// Returns IDs of instances whose AABB overlaps the given (world-space) AABB
+		void DoOverlapQuery(const Math::AABB& box, Util::Vector<uint64_t>& instanceIDs) const noexcept;
+
+		struct InstanceHit
+		{
+			uint64_t ID;
+			// distance to where the ray enters instance's AABB
+			float T;
+		};
 
 		// Casts a ray into the BVH and returns the closest-hit intersection. Given Ray has to 
 		// be in world space
-		uint64_t CastRay(Math::Ray& r) noexcept;
+		uint64_t CastRay(Math::Ray& r) const noexcept;
+
+		// Returns all the instances whose AABB is intersected by the given ray, sorted by 
+		// distance to the AABB. Used as the first level of traversal for exact (triangle) 
+		// ray queries. Given Ray has to be in world space
+		void CastRay(Math::Ray& r, Util::Vector<InstanceHit, App::FrameAllocator>& hits) const noexcept;
 
 		// Returns the AABB that encompasses the scene
-		Math::AABB GetWorldAABB() noexcept 
+		Math::AABB GetWorldAABB() const noexcept 
 		{
-			Assert(m_nodes.size() > 0, "BVH hasn't been built yet.");
-			return m_nodes[0].AABB; 
+			Assert(m_root != -1, "BVH hasn't been built yet.");
+			return m_nodes[m_root].AABB; 
 		}
 
 	private:
@@ -73,16 +106,22 @@ namespace ZetaRay::Math
 		static constexpr int MIN_NUM_INSTANCES_SPLIT_SAH = 10;
 		static constexpr int NUM_SAH_BINS = 6;
 
+		// SAH cost of traversing an internal node relative to testing one instance
+		static constexpr float SAH_TRAVERSAL_COST = 1.0f;
+
+		// inline capacity of the traversal stacks, deeper trees (e.g. after many incremental 
+		// inserts) spill to the heap
+		static constexpr int STACK_SIZE = 64;
+
 		struct alignas(64) Node
 		{
 			bool IsInitialized() noexcept { return Parent != -1; }
-			void InitAsLeaf(int base, int count, int parent) noexcept;
+			void InitAsLeaf(Util::Span<BVH::BVHInput> instances, int base, int count, int parent) noexcept;
 			void InitAsInternal(Util::Span<BVH::BVHInput> instances, int base, int count,
-				int right, int parent) noexcept;
+				int left, int right, int parent) noexcept;
 			bool IsLeaf() const { return RightChild == -1; }
 
-			// Union AABB of all the child nodes for internal nodes
-			// also used to distinguish between leaf & internal nodes
+			// Union AABB of all the instances (leaves) or child nodes (internal nodes)
 			Math::AABB AABB;
 
 			/*
@@ -102,13 +141,15 @@ namespace ZetaRay::Math
 			int Base;
 			int Count;
 
-			// for internal nodes
+			// for internal nodes. Children of nodes that were created by Build() are laid out
+			// depth first, but that doesn't hold after incremental insertions & removals
+			int LeftChild;
 			int RightChild;
 
 			int Parent = -1;
 		};
 
-		static constexpr int qfgh = sizeof(Node);
+		static_assert(sizeof(Node) == 64, "unexpected Node size.");
 
 		// Recursively builds a BVH (subtree) for the given range
 		int BuildSubtree(int base, int count, int parent) noexcept;
@@ -116,6 +157,32 @@ namespace ZetaRay::Math
 		// Finds the leaf node that contains the given instance. Returns -1 otherwise.
 		int Find(uint64_t ID, const Math::AABB& AABB, int& modelIdx) noexcept;
 
+		// Returns the node that, when paired with a new node with the given AABB under a new 
+		// parent, results in the lowest increase in SAH cost
+		int FindBestSibling(const Math::AABB& AABB) noexcept;
+
+		// Starting from the given node, walks up the tree, recomputes the AABBs and rotates 
+		// nodes to reduce the surface area
+		void RefitAndRotate(int nodeIdx) noexcept;
+
+		// Swaps a child of given node with a grandchild (from the other subtree) if that reduces 
+		// the surface area. Given node's AABB remains unchanged.
+		void Rotate(int nodeIdx) noexcept;
+
+		int AllocateNode() noexcept;
+		void ReleaseNode(int nodeIdx) noexcept;
+		int AllocateInstanceSlot() noexcept;
+
+		// Calls onOverlap for every instance whose AABB passes overlaps(v_AABB). Subtrees whose 
+		// bounds fail the test are skipped.
+		template<typename Overlaps, typename Func>
+		void Traverse(Overlaps overlaps, Func onOverlap) const noexcept;
+
+		// Calls onVisible for every instance that at least partially overlaps the given view 
+		// frustum. Assumes the view frustum is in the world space
+		template<typename Func>
+		void FrustumCull(const Math::v_ViewFrustum& vFrustum, Func onVisible) const noexcept;
+
 		Support::MemoryArena m_arena;
 
 		// tree hierarchy is stored as an array
@@ -124,6 +191,12 @@ namespace ZetaRay::Math
 		// array of inputs to build a BVH for. During BVH build, elements are moved around
 		Util::SmallVector<BVHInput, Support::ArenaAllocator> m_instances;
 
+		// slots in m_instances that were freed by removals and can be reused by insertions
+		Util::SmallVector<int, Support::ArenaAllocator> m_freeInstanceSlots;
+
 		uint32_t m_numNodes = 0;
+		int m_root = -1;
+		// head of the linked list of released nodes (linked through Node::Base)
+		int m_freeNodeHead = -1;
 	};
 }
@@ -0,0 +1,367 @@
+#pragma once
+
+#include "CollisionTypes.h"
+#include "Matrix.h"
+#include "Simd.h"
+
+//--------------------------------------------------------------------------------------
+// Batch Functions
+//
+// Structure-of-arrays versions of some of the vector, matrix and collision functions that
+// process V::Width elements at a time, where V is one of the simd<float, N> types.
+//--------------------------------------------------------------------------------------
+
+namespace ZetaRay::Math
+{
+	template<typename V>
+	struct soa_float3
+	{
+		soa_float3() noexcept = default;
+		soa_float3(V x, V y, V z) noexcept
+			: x(x),
+			y(y),
+			z(z)
+		{}
+		explicit soa_float3(const float3& f) noexcept
+			: x(f.x),
+			y(f.y),
+			z(f.z)
+		{}
+
+		V x;
+		V y;
+		V z;
+	};
+
+	template<typename V>
+	struct soa_float4
+	{
+		V x;
+		V y;
+		V z;
+		V w;
+	};
+
+	template<typename V>
+	struct soa_AABB
+	{
+		soa_float3<V> Center;
+		soa_float3<V> Extents;
+	};
+
+	// Every lane holds a (possibly) different affine transformation
+	template<typename V>
+	struct soa_float4x3
+	{
+		soa_float4x3() noexcept = default;
+
+		// Broadcasts M to all the lanes
+		explicit soa_float4x3(const float4x3& M) noexcept
+		{
+			for (int i = 0; i < 4; i++)
+				m[i] = soa_float3<V>(M.m[i]);
+		}
+
+		soa_float3<V> m[4];
+	};
+
+	// Gathers up to V::Width AABBs. Unused lanes are set to an empty AABB at the origin.
+	template<typename V>
+	ZetaInline soa_AABB<V> loadAABBs(const AABB* boxes, int n) noexcept
+	{
+		Assert(n <= V::Width, "at most %d boxes can be loaded at a time.", V::Width);
+		alignas(32) float lanes[6][V::Width];
+
+		for (int i = 0; i < V::Width; i++)
+		{
+			const bool valid = i < n;
+			lanes[0][i] = valid ? boxes[i].Center.x : 0.0f;
+			lanes[1][i] = valid ? boxes[i].Center.y : 0.0f;
+			lanes[2][i] = valid ? boxes[i].Center.z : 0.0f;
+			lanes[3][i] = valid ? boxes[i].Extents.x : 0.0f;
+			lanes[4][i] = valid ? boxes[i].Extents.y : 0.0f;
+			lanes[5][i] = valid ? boxes[i].Extents.z : 0.0f;
+		}
+
+		soa_AABB<V> ret;
+		ret.Center = soa_float3<V>(V::load(lanes[0]), V::load(lanes[1]), V::load(lanes[2]));
+		ret.Extents = soa_float3<V>(V::load(lanes[3]), V::load(lanes[4]), V::load(lanes[5]));
+
+		return ret;
+	}
+
+	// Scatters the first n lanes
+	template<typename V>
+	ZetaInline void storeAABBs(const soa_AABB<V>& vBox, AABB* boxes, int n) noexcept
+	{
+		Assert(n <= V::Width, "at most %d boxes can be stored at a time.", V::Width);
+		alignas(32) float lanes[6][V::Width];
+
+		vBox.Center.x.store(lanes[0]);
+		vBox.Center.y.store(lanes[1]);
+		vBox.Center.z.store(lanes[2]);
+		vBox.Extents.x.store(lanes[3]);
+		vBox.Extents.y.store(lanes[4]);
+		vBox.Extents.z.store(lanes[5]);
+
+		for (int i = 0; i < n; i++)
+		{
+			boxes[i].Center = float3(lanes[0][i], lanes[1][i], lanes[2][i]);
+			boxes[i].Extents = float3(lanes[3][i], lanes[4][i], lanes[5][i]);
+		}
+	}
+
+	// Transforms the given points (w = 1) with M
+	template<typename V>
+	ZetaInline soa_float3<V> mul(const soa_float4x3<V>& M, const soa_float3<V>& p) noexcept
+	{
+		soa_float3<V> ret;
+		ret.x = fmadd(p.x, M.m[0].x, fmadd(p.y, M.m[1].x, fmadd(p.z, M.m[2].x, M.m[3].x)));
+		ret.y = fmadd(p.x, M.m[0].y, fmadd(p.y, M.m[1].y, fmadd(p.z, M.m[2].y, M.m[3].y)));
+		ret.z = fmadd(p.x, M.m[0].z, fmadd(p.y, M.m[1].z, fmadd(p.z, M.m[2].z, M.m[3].z)));
+
+		return ret;
+	}
+
+	// Transforms the given vectors (w = 0) with M
+	template<typename V>
+	ZetaInline soa_float3<V> mul3x3(const soa_float4x3<V>& M, const soa_float3<V>& v) noexcept
+	{
+		soa_float3<V> ret;
+		ret.x = fmadd(v.x, M.m[0].x, fmadd(v.y, M.m[1].x, v.z * M.m[2].x));
+		ret.y = fmadd(v.x, M.m[0].y, fmadd(v.y, M.m[1].y, v.z * M.m[2].y));
+		ret.z = fmadd(v.x, M.m[0].z, fmadd(v.y, M.m[1].z, v.z * M.m[2].z));
+
+		return ret;
+	}
+
+	// Returns A * B, where both are affine transformations (row vectors)
+	template<typename V>
+	ZetaInline soa_float4x3<V> mul(const soa_float4x3<V>& A, const soa_float4x3<V>& B) noexcept
+	{
+		soa_float4x3<V> ret;
+
+		for (int i = 0; i < 3; i++)
+		{
+			const soa_float3<V>& a = A.m[i];
+			ret.m[i].x = fmadd(a.x, B.m[0].x, fmadd(a.y, B.m[1].x, a.z * B.m[2].x));
+			ret.m[i].y = fmadd(a.x, B.m[0].y, fmadd(a.y, B.m[1].y, a.z * B.m[2].y));
+			ret.m[i].z = fmadd(a.x, B.m[0].z, fmadd(a.y, B.m[1].z, a.z * B.m[2].z));
+		}
+
+		// last row of A is a point (w = 1)
+		ret.m[3] = mul(B, A.m[3]);
+
+		return ret;
+	}
+
+	// Same as affineTransformation() in MatrixFuncs.h, i.e. M = S * R * T where R is given
+	// as a unit quaternion (x, y, z, w)
+	template<typename V>
+	ZetaInline soa_float4x3<V> affineTransformation(const soa_float3<V>& s, const soa_float4<V>& q, 
+		const soa_float3<V>& t) noexcept
+	{
+		const V v2(2.0f);
+		const V vOne(1.0f);
+		
+		const V x2 = q.x * v2;
+		const V y2 = q.y * v2;
+		const V z2 = q.z * v2;
+
+		const V xx2 = q.x * x2;
+		const V yy2 = q.y * y2;
+		const V zz2 = q.z * z2;
+		const V xy2 = q.x * y2;
+		const V xz2 = q.x * z2;
+		const V yz2 = q.y * z2;
+		const V xw2 = q.w * x2;
+		const V yw2 = q.w * y2;
+		const V zw2 = q.w * z2;
+
+		soa_float4x3<V> M;
+		M.m[0] = soa_float3<V>(s.x * (vOne - yy2 - zz2), s.x * (xy2 + zw2), s.x * (xz2 - yw2));
+		M.m[1] = soa_float3<V>(s.y * (xy2 - zw2), s.y * (vOne - xx2 - zz2), s.y * (yz2 + xw2));
+		M.m[2] = soa_float3<V>(s.z * (xz2 + yw2), s.z * (yz2 - xw2), s.z * (vOne - xx2 - yy2));
+		M.m[3] = t;
+
+		return M;
+	}
+
+	// Per-lane version of equal() in MatrixFuncs.h
+	template<typename V>
+	ZetaInline typename V::Mask equal(const soa_float4x3<V>& A, const soa_float4x3<V>& B) noexcept
+	{
+		const V vEps(FLT_EPSILON);
+		auto vEqual = V(1.0f) > V(0.0f);
+
+		for (int i = 0; i < 4; i++)
+		{
+			vEqual = vEqual & (vEps >= abs(A.m[i].x - B.m[i].x));
+			vEqual = vEqual & (vEps >= abs(A.m[i].y - B.m[i].y));
+			vEqual = vEqual & (vEps >= abs(A.m[i].z - B.m[i].z));
+		}
+
+		return vEqual;
+	}
+
+	// Returns a + t * (b - a)
+	template<typename V>
+	ZetaInline soa_float3<V> lerp(const soa_float3<V>& a, const soa_float3<V>& b, const V& t) noexcept
+	{
+		return soa_float3<V>(fmadd(t, b.x - a.x, a.x), fmadd(t, b.y - a.y, a.y), fmadd(t, b.z - a.z, a.z));
+	}
+
+	template<typename V>
+	ZetaInline V dot(const soa_float3<V>& a, const soa_float3<V>& b) noexcept
+	{
+		return fmadd(a.x, b.x, fmadd(a.y, b.y, a.z * b.z));
+	}
+
+	template<typename V>
+	ZetaInline soa_float3<V> cross(const soa_float3<V>& a, const soa_float3<V>& b) noexcept
+	{
+		return soa_float3<V>(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	template<typename V>
+	ZetaInline V dot(const soa_float4<V>& a, const soa_float4<V>& b) noexcept
+	{
+		return fmadd(a.x, b.x, fmadd(a.y, b.y, fmadd(a.z, b.z, a.w * b.w)));
+	}
+
+	// Linear interpolation of unit quaternions followed by normalization. q2 is negated when the two 
+	// are on opposite hemispheres so that the shorter arc is taken.
+	template<typename V>
+	ZetaInline soa_float4<V> nlerp(const soa_float4<V>& q1, const soa_float4<V>& q2, const V& t) noexcept
+	{
+		const V vOne(1.0f);
+		const V vS2 = select(dot(q1, q2) >= V(0.0f), t, -t);
+		const V vS1 = vOne - t;
+
+		soa_float4<V> q;
+		q.x = fmadd(q1.x, vS1, q2.x * vS2);
+		q.y = fmadd(q1.y, vS1, q2.y * vS2);
+		q.z = fmadd(q1.z, vS1, q2.z * vS2);
+		q.w = fmadd(q1.w, vS1, q2.w * vS2);
+
+		const V vInvLen = vOne / sqrt(dot(q, q));
+		q.x = q.x * vInvLen;
+		q.y = q.y * vInvLen;
+		q.z = q.z * vInvLen;
+		q.w = q.w * vInvLen;
+
+		return q;
+	}
+
+	// Per-lane version of slerp() in Quaternion.h. Falls back to nlerp() for lanes where the angle 
+	// between the two quaternions is near zero.
+	template<typename V>
+	ZetaInline soa_float4<V> slerp(const soa_float4<V>& q1, const soa_float4<V>& q2, const V& t) noexcept
+	{
+		const V vZero(0.0f);
+		const V vOne(1.0f);
+
+		// take the shorter arc, so that cos(theta) is in [0, 1] and theta is in [0, pi / 2]
+		V vCosTheta = dot(q1, q2);
+		const auto vSameHemisphere = vCosTheta >= vZero;
+		vCosTheta = abs(vCosTheta);
+
+		// acos() -- same polynomial approximation as acos() in VectorFuncs.h, but only for [0, 1]
+		const V vRoot = sqrt(Max(vZero, vOne - vCosTheta));
+		V vTheta = fmadd(V(-0.0012624911f), vCosTheta, V(0.0066700901f));
+		vTheta = fmadd(vTheta, vCosTheta, V(-0.0170881256f));
+		vTheta = fmadd(vTheta, vCosTheta, V(0.0308918810f));
+		vTheta = fmadd(vTheta, vCosTheta, V(-0.0501743046f));
+		vTheta = fmadd(vTheta, vCosTheta, V(0.0889789874f));
+		vTheta = fmadd(vTheta, vCosTheta, V(-0.2145988016f));
+		vTheta = fmadd(vTheta, vCosTheta, V(1.5707963050f));
+		vTheta = vTheta * vRoot;
+
+		// sin() -- same polynomial approximation as sin() in VectorFuncs.h. Both arguments are in 
+		// [0, pi / 2], so there's no need for range reduction.
+		auto sinApprox = [](const V& x) noexcept
+			{
+				const V x2 = x * x;
+				V p = fmadd(V(-2.3889859e-08f), x2, V(2.7525562e-06f));
+				p = fmadd(p, x2, V(-0.00019840874f));
+				p = fmadd(p, x2, V(0.0083333310f));
+				p = fmadd(p, x2, V(-0.16666667f));
+				p = fmadd(p, x2, V(1.0f));
+
+				return p * x;
+			};
+
+		const V vSinTheta = sqrt(Max(vZero, fmadd(-vCosTheta, vCosTheta, vOne)));
+		const V vInvSinTheta = vOne / vSinTheta;
+		const V vS1 = sinApprox((vOne - t) * vTheta) * vInvSinTheta;
+		V vS2 = sinApprox(t * vTheta) * vInvSinTheta;
+		vS2 = select(vSameHemisphere, vS2, -vS2);
+
+		soa_float4<V> q;
+		q.x = fmadd(q1.x, vS1, q2.x * vS2);
+		q.y = fmadd(q1.y, vS1, q2.y * vS2);
+		q.z = fmadd(q1.z, vS1, q2.z * vS2);
+		q.w = fmadd(q1.w, vS1, q2.w * vS2);
+
+		// theta near zero leads to divide-by-zero above
+		const auto vNearZero = vCosTheta > V(1.0f - FLT_EPSILON);
+		if (movemask(vNearZero))
+		{
+			const soa_float4<V> qLerp = nlerp(q1, q2, t);
+			q.x = select(vNearZero, qLerp.x, q.x);
+			q.y = select(vNearZero, qLerp.y, q.y);
+			q.z = select(vNearZero, qLerp.z, q.z);
+			q.w = select(vNearZero, qLerp.w, q.w);
+		}
+
+		return q;
+	}
+
+	// Ref: J. Arvo, "Transforming axis-aligned bounding boxes," Graphics Gems, 1990.
+	template<typename V>
+	ZetaInline soa_AABB<V> transform(const soa_float4x3<V>& M, const soa_AABB<V>& aabb) noexcept
+	{
+		soa_AABB<V> newAABB;
+		newAABB.Center = mul(M, aabb.Center);
+
+		const soa_float3<V>& e = aabb.Extents;
+		newAABB.Extents.x = fmadd(e.x, abs(M.m[0].x), fmadd(e.y, abs(M.m[1].x), e.z * abs(M.m[2].x)));
+		newAABB.Extents.y = fmadd(e.x, abs(M.m[0].y), fmadd(e.y, abs(M.m[1].y), e.z * abs(M.m[2].y)));
+		newAABB.Extents.z = fmadd(e.x, abs(M.m[0].z), fmadd(e.y, abs(M.m[1].z), e.z * abs(M.m[2].z)));
+
+		return newAABB;
+	}
+
+	// Returns a bitmask where bit i is set if the view frustum contains or intersects the i'th AABB.
+	// Frustum and AABBs must be in the same coordinate system and plane normals must be normalized.
+	template<typename V>
+	ZetaInline uint32_t instersectFrustumVsAABB(const ViewFrustum& frustum, const soa_AABB<V>& vBox) noexcept
+	{
+		const Plane* planes = &frustum.Left;
+		const V vZero(0.0f);
+		auto vInside = V(1.0f) > vZero;
+
+		// Seperating-axis theorem, use the plane Normal as the axis
+		for (int i = 0; i < 6; i++)
+		{
+			const V vNx(planes[i].Normal.x);
+			const V vNy(planes[i].Normal.y);
+			const V vNz(planes[i].Normal.z);
+
+			// projection of farthest corner on the axis
+			V vProjLengthAlongAxis = vBox.Extents.x * abs(vNx);
+			vProjLengthAlongAxis = fmadd(vBox.Extents.y, abs(vNy), vProjLengthAlongAxis);
+			vProjLengthAlongAxis = fmadd(vBox.Extents.z, abs(vNz), vProjLengthAlongAxis);
+
+			// distance of the AABB center from the plane
+			V vCenterDistFromPlane = fmadd(vBox.Center.x, vNx, V(planes[i].d));
+			vCenterDistFromPlane = fmadd(vBox.Center.y, vNy, vCenterDistFromPlane);
+			vCenterDistFromPlane = fmadd(vBox.Center.z, vNz, vCenterDistFromPlane);
+
+			// AABB is (at least partially) in the positive half space of the plane
+			vInside = vInside & (vProjLengthAlongAxis >= -vCenterDistFromPlane);
+		}
+
+		return movemask(vInside);
+	}
+}
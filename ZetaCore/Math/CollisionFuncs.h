@@ -10,7 +10,7 @@ namespace ZetaRay::Math
 	// Functions
 	//--------------------------------------------------------------------------------------
 
-	ZetaInline __m128 __vectorcall distFromPlane(const __m128 point, const __m128 plane) noexcept
+	ZetaInline __m128 ZETA_VECTORCALL distFromPlane(const __m128 point, const __m128 plane) noexcept
 	{
 		// plane: n.(p - p0) = 0
 		// dist(p, p0) = proj_n(p - p0) = n.(p - p0)
@@ -18,7 +18,7 @@ namespace ZetaRay::Math
 	}
 
 	// Computes AABB that encloses the given mesh. Assumes vtxStride - (posOffset + sizeof(float3)) >= sizeof(float)
-	ZetaInline v_AABB __vectorcall compueMeshAABB(void* data, uint32_t posOffset, uint32_t vtxStride, uint32_t numVertices) noexcept
+	ZetaInline v_AABB ZETA_VECTORCALL compueMeshAABB(void* data, uint32_t posOffset, uint32_t vtxStride, uint32_t numVertices) noexcept
 	{
 		uintptr_t dataPtr = (uintptr_t)data + posOffset;
 		float3* currPos = reinterpret_cast<float3*>(dataPtr);
@@ -48,7 +48,7 @@ namespace ZetaRay::Math
 	}
 
 	// Returns the union of two AABBs
-	ZetaInline v_AABB __vectorcall compueUnionAABB(const v_AABB vBox1, const v_AABB vBox2) noexcept
+	ZetaInline v_AABB ZETA_VECTORCALL compueUnionAABB(const v_AABB vBox1, const v_AABB vBox2) noexcept
 	{
 		__m128 vMin1 = _mm_sub_ps(vBox1.vCenter, vBox1.vExtents);
 		__m128 vMax1 = _mm_add_ps(vBox1.vCenter, vBox1.vExtents);
@@ -67,7 +67,7 @@ namespace ZetaRay::Math
 		return vRet;
 	}
 
-	ZetaInline float __vectorcall computeAABBSurfaceArea(v_AABB vBox) noexcept
+	ZetaInline float ZETA_VECTORCALL computeAABBSurfaceArea(v_AABB vBox) noexcept
 	{
 		const __m128 vEight = _mm_set1_ps(8.0f);
 		const __m128 vYZX = _mm_shuffle_ps(vBox.vExtents, vBox.vExtents, V_SHUFFLE_XYZW(1, 2, 0, 0));
@@ -83,7 +83,7 @@ namespace ZetaRay::Math
 	}
 
 	// Returns how source "intersects" target. Both must be in the same coordinate system
-	ZetaInline COLLISION_TYPE __vectorcall intersectAABBvsAABB(const v_AABB source, const v_AABB target) noexcept
+	ZetaInline COLLISION_TYPE ZETA_VECTORCALL intersectAABBvsAABB(const v_AABB source, const v_AABB target) noexcept
 	{
 		__m128 vMinSource = _mm_sub_ps(source.vCenter, source.vExtents);
 		__m128 vMaxSource = _mm_add_ps(source.vCenter, source.vExtents);
@@ -108,7 +108,7 @@ namespace ZetaRay::Math
 	}
 
 	// Returns the AABB that results from the intersection of two AABBs
-	ZetaInline v_AABB __vectorcall computeOverlapAABB(const v_AABB vBox1, const v_AABB vBox2) noexcept
+	ZetaInline v_AABB ZETA_VECTORCALL computeOverlapAABB(const v_AABB vBox1, const v_AABB vBox2) noexcept
 	{
 		v_AABB vO;
 
@@ -129,7 +129,7 @@ namespace ZetaRay::Math
 	}
 
 	// Returns whether the given AABB and plane intersect. Both must be in the same coordinate system
-	ZetaInline bool __vectorcall intersectAABBvsPlane(const v_AABB vAABB, const __m128 vPlane) noexcept
+	ZetaInline bool ZETA_VECTORCALL intersectAABBvsPlane(const v_AABB vAABB, const __m128 vPlane) noexcept
 	{
 		// Seperating-axis theorem, use the plane Normal as the axis
 		__m128 vProjLengthAlongAxis = _mm_dp_ps(vAABB.vExtents, abs(vPlane), 0xf);
@@ -142,7 +142,7 @@ namespace ZetaRay::Math
 
 	// Returns whether the given view frustum contains or intersects the given AABB.
 	// Assumes plane normals of the frustum are already normalized.
-	ZetaInline COLLISION_TYPE __vectorcall instersectFrustumVsAABB(const v_ViewFrustum vFrustum, const v_AABB vBox) noexcept
+	ZetaInline COLLISION_TYPE ZETA_VECTORCALL instersectFrustumVsAABB(const v_ViewFrustum vFrustum, const v_AABB vBox) noexcept
 	{
 		// Seperating-axis theorem, use the plane Normal as the axis
 
@@ -197,7 +197,7 @@ namespace ZetaRay::Math
 		return intersects ? COLLISION_TYPE::INTERSECTS : COLLISION_TYPE::DISJOINT;
 	}
 
-	ZetaInline bool __vectorcall intersectRayVsAABB(const v_Ray vRay, const v_AABB& vBox, float& t) noexcept
+	ZetaInline bool ZETA_VECTORCALL intersectRayVsAABB(const v_Ray vRay, const v_AABB& vBox, float& t) noexcept
 	{
 		// An AABB can be described as the intersection of three "slabs", where a slab
 		// is the (infinite) region of space between two parallel planes.
@@ -235,8 +235,9 @@ namespace ZetaRay::Math
 		// if x/y/z component of the ray direction is negative then, then the nearest hit
 		// with corresponding slab is with the x_max/y_max/z_max and vice versa for the
 		// positive case
-		vTmin = _mm_blendv_ps(vTmax, vTmin, vDirIsPos);
+		const __m128 vTminSwapped = _mm_blendv_ps(vTmax, vTmin, vDirIsPos);
 		vTmax = _mm_blendv_ps(vTmin, vTmax, vDirIsPos);
+		vTmin = vTminSwapped;
 
 		__m128 vT0 = _mm_shuffle_ps(vTmin, vTmin, V_SHUFFLE_XYZW(0, 0, 0, 0));
 		__m128 vT1 = _mm_shuffle_ps(vTmax, vTmax, V_SHUFFLE_XYZW(0, 0, 0, 0));
@@ -264,7 +265,7 @@ namespace ZetaRay::Math
 	// Returns whether given ray and AABB intersect
 	// When a given Ray is tested against multiple AABBs, a few values that only depend 
 	// on that ray can be precomputed to avoid unneccesary recomputations
-	ZetaInline bool __vectorcall intersectRayVsAABB(const v_Ray vRay, const __m128 vDirRcp,
+	ZetaInline bool ZETA_VECTORCALL intersectRayVsAABB(const v_Ray vRay, const __m128 vDirRcp,
 		const __m128 vDirIsPos, const __m128 vIsParallel, const v_AABB& vBox, float& t) noexcept
 	{
 		const __m128 vCenterTranslatedToOrigin = _mm_sub_ps(vBox.vCenter, vRay.vOrigin);
@@ -277,8 +278,9 @@ namespace ZetaRay::Math
 
 		__m128 vTmin = _mm_mul_ps(vMin, vDirRcp);
 		__m128 vTmax = _mm_mul_ps(vMax, vDirRcp);
-		vTmin = _mm_blendv_ps(vTmax, vTmin, vDirIsPos);
+		const __m128 vTminSwapped = _mm_blendv_ps(vTmax, vTmin, vDirIsPos);
 		vTmax = _mm_blendv_ps(vTmin, vTmax, vDirIsPos);
+		vTmin = vTminSwapped;
 
 		__m128 vT0 = _mm_shuffle_ps(vTmin, vTmin, V_SHUFFLE_XYZW(0, 0, 0, 0));
 		__m128 vT1 = _mm_shuffle_ps(vTmax, vTmax, V_SHUFFLE_XYZW(0, 0, 0, 0));
@@ -300,9 +302,11 @@ namespace ZetaRay::Math
 		return (res & 0x7) == 0;
 	}
 
-	// Returns whether given ray and triangle formed by vertices v0v1v2 (clockwise order) intersect
-	ZetaInline bool __vectorcall intersectRayVsTriangle(const v_Ray vRay, __m128 v0,
-		__m128 v1, __m128 v2, float& t) noexcept
+	// Returns whether given ray and triangle formed by vertices v0v1v2 (clockwise order) intersect. 
+	// On hit, (u, v) are barycentric coords. of the hit position such that
+	//		hit_pos = v0 + u(v1 - v0) + v(v2 - v0)
+	ZetaInline bool ZETA_VECTORCALL intersectRayVsTriangle(const v_Ray vRay, __m128 v0,
+		__m128 v1, __m128 v2, float& t, float& u, float& v) noexcept
 	{
 		// closer to (0, 0, 0) provides better precision, so translate ray origin to (0, 0, 0)
 		v0 = _mm_sub_ps(v0, vRay.vOrigin);
@@ -352,6 +356,8 @@ namespace ZetaRay::Math
 
 		float4a q = store(vRes);
 		t = q.z;
+		u = q.x;
+		v = q.y;
 
 		bool insideTri = (q.x >= 0) && (q.x <= 1) && (q.y >= 0) && (q.y <= 1) && (q.x + q.y <= 1.0);
 		bool triBehindRay = (t >= 0);
@@ -364,8 +370,18 @@ namespace ZetaRay::Math
 		return insideTri && triBehindRay && (rayTriParralel & 0xf);
 	}
 
+	// Returns whether given ray and triangle formed by vertices v0v1v2 (clockwise order) intersect
+	ZetaInline bool ZETA_VECTORCALL intersectRayVsTriangle(const v_Ray vRay, __m128 v0,
+		__m128 v1, __m128 v2, float& t) noexcept
+	{
+		float u;
+		float v;
+
+		return intersectRayVsTriangle(vRay, v0, v1, v2, t, u, v);
+	}
+
 	// Ref: J. Arvo, "Transforming axis-aligned bounding boxes," Graphics Gems, 1990.
-	ZetaInline v_AABB __vectorcall transform(const v_float4x4 M, const v_AABB& aabb) noexcept
+	ZetaInline v_AABB ZETA_VECTORCALL transform(const v_float4x4 M, const v_AABB& aabb) noexcept
 	{
 		// transform the center
 		v_AABB newAABB;
@@ -385,7 +401,7 @@ namespace ZetaRay::Math
 	}
 
 	// Transforms given view frustum with a transformation matrix
-	ZetaInline v_ViewFrustum __vectorcall transform(const v_float4x4 M, const v_ViewFrustum& vFrustum) noexcept
+	ZetaInline v_ViewFrustum ZETA_VECTORCALL transform(const v_float4x4 M, const v_ViewFrustum& vFrustum) noexcept
 	{
 		// In general, planes need to be transformed with the inverse-tranpose of a given transformation M
 		// (due to the normal vector). For view-to-world transformation, we know that it only consists
@@ -455,7 +471,7 @@ namespace ZetaRay::Math
 		return vRet;
 	}
 
-	ZetaInline AABB __vectorcall store(v_AABB vBox) noexcept
+	ZetaInline AABB ZETA_VECTORCALL store(v_AABB vBox) noexcept
 	{
 		AABB aabb;
 
@@ -46,7 +46,7 @@ namespace ZetaRay::Math
 			Reset(c, e);
 		}
 
-		void __vectorcall Reset(const AABB& aabb) noexcept
+		void ZETA_VECTORCALL Reset(const AABB& aabb) noexcept
 		{
 			vCenter = _mm_loadu_ps(reinterpret_cast<const float*>(&aabb));
 			vExtents = _mm_loadu_ps(reinterpret_cast<const float*>(&aabb) + 3);
@@ -56,7 +56,7 @@ namespace ZetaRay::Math
 			vCenter = _mm_insert_ps(vCenter, _mm_set1_ps(1.0f), 0x30);
 		}
 
-		void __vectorcall Reset(float3& c, float3& e) noexcept
+		void ZETA_VECTORCALL Reset(float3& c, float3& e) noexcept
 		{
 			vCenter = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<double*>(&c)));
 			vCenter = _mm_blend_ps(vCenter, _mm_set1_ps(1.0f), 0x8);
@@ -66,7 +66,7 @@ namespace ZetaRay::Math
 			vExtents = _mm_insert_ps(vExtents, _mm_load_ss(&e.z), 0x20);
 		}
 
-		ZetaInline void __vectorcall Reset(__m128 vMinPoint, __m128 vMaxPoint) noexcept
+		ZetaInline void ZETA_VECTORCALL Reset(__m128 vMinPoint, __m128 vMaxPoint) noexcept
 		{
 			const __m128 vOneDivTwo = _mm_set1_ps(0.5f);
 			vCenter = _mm_mul_ps(_mm_add_ps(vMaxPoint, vMinPoint), vOneDivTwo);
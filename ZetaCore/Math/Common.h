@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Utility/Error.h"
+#include <cstdint>
 #include <math.h>
 #include <float.h>
 #include <string.h>
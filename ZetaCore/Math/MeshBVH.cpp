@@ -0,0 +1,422 @@
+#include "MeshBVH.h"
+#include "../Math/CollisionFuncs.h"
+#include "../Utility/Error.h"
+#include <algorithm>
+
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Core;
+
+namespace
+{
+	struct alignas(16) Bin
+	{
+		ZetaInline void ZETA_VECTORCALL Extend(const __m128 vMinPt, const __m128 vMaxPt) noexcept
+		{
+			vMin = _mm_min_ps(vMin, vMinPt);
+			vMax = _mm_max_ps(vMax, vMaxPt);
+			NumEntries++;
+		}
+
+		__m128 vMin = _mm_set1_ps(FLT_MAX);
+		__m128 vMax = _mm_set1_ps(-FLT_MAX);
+		uint32_t NumEntries = 0;
+	};
+
+	ZetaInline float ZETA_VECTORCALL SurfaceArea(const __m128 vMin, const __m128 vMax) noexcept
+	{
+		v_AABB vBox;
+		vBox.Reset(vMin, vMax);
+
+		return computeAABBSurfaceArea(vBox);
+	}
+
+	struct SerializedHeader
+	{
+		uint32_t Version;
+		uint32_t NumNodes;
+		uint32_t NumTriangles;
+	};
+}
+
+//--------------------------------------------------------------------------------------
+// MeshBVH
+//--------------------------------------------------------------------------------------
+
+void MeshBVH::Clear() noexcept
+{
+	m_nodes.free_memory();
+	m_triangles.free_memory();
+	m_triIndices.free_memory();
+}
+
+void MeshBVH::Build(Span<Vertex> vertices, Span<uint32_t> indices) noexcept
+{
+	Clear();
+
+	Assert(indices.size() % 3 == 0, "Number of indices must be a multiple of three.");
+	Check(indices.size() / 3 < UINT32_MAX, "#Triangles can't exceed UINT32_MAX.");
+	const uint32_t numTris = (uint32_t)(indices.size() / 3);
+
+	if (numTris == 0)
+		return;
+
+	SmallVector<BuildInput> input;
+	input.resize(numTris);
+
+	for (uint32_t i = 0; i < numTris; i++)
+	{
+		const __m128 v0 = loadFloat3(vertices[indices[3 * i]].Position);
+		const __m128 v1 = loadFloat3(vertices[indices[3 * i + 1]].Position);
+		const __m128 v2 = loadFloat3(vertices[indices[3 * i + 2]].Position);
+
+		v_AABB vBox;
+		vBox.Reset(_mm_min_ps(_mm_min_ps(v0, v1), v2), _mm_max_ps(_mm_max_ps(v0, v1), v2));
+
+		input[i].AABB = store(vBox);
+		input[i].TriIdx = i;
+	}
+
+	// a binary tree with N leaves has at most 2N - 1 nodes
+	m_nodes.reserve(2 * numTris - 1);
+	BuildSubtree(input, 0, numTris);
+
+	// store the triangles in the BVH order
+	m_triangles.resize(numTris);
+	m_triIndices.resize(numTris);
+
+	for (uint32_t i = 0; i < numTris; i++)
+	{
+		const uint32_t tri = input[i].TriIdx;
+
+		m_triangles[i].V0 = vertices[indices[3 * tri]].Position;
+		m_triangles[i].V1 = vertices[indices[3 * tri + 1]].Position;
+		m_triangles[i].V2 = vertices[indices[3 * tri + 2]].Position;
+		m_triIndices[i] = tri;
+	}
+}
+
+uint32_t MeshBVH::BuildSubtree(Span<BuildInput> input, uint32_t base, uint32_t count) noexcept
+{
+	Assert(count > 0, "Number of triangles to build a subtree for must be greater than 0.");
+	const uint32_t currNodeIdx = (uint32_t)m_nodes.size();
+	m_nodes.emplace_back();
+
+	// compute union AABB of all the triangles and their centroids
+	__m128 vMinPoint = _mm_set1_ps(FLT_MAX);
+	__m128 vMaxPoint = _mm_set1_ps(-FLT_MAX);
+	v_AABB vNodeBox(input[base].AABB);
+
+	for (uint32_t i = base; i < base + count; i++)
+	{
+		v_AABB vTriBox(input[i].AABB);
+
+		vMinPoint = _mm_min_ps(vMinPoint, vTriBox.vCenter);
+		vMaxPoint = _mm_max_ps(vMaxPoint, vTriBox.vCenter);
+
+		vNodeBox = compueUnionAABB(vNodeBox, vTriBox);
+	}
+
+	m_nodes[currNodeIdx].AABB = store(vNodeBox);
+
+	// create a leaf node and return
+	if (count <= MAX_NUM_TRIS_PER_LEAF)
+	{
+		m_nodes[currNodeIdx].BaseOrRight = base;
+		m_nodes[currNodeIdx].Count = count;
+
+		return currNodeIdx;
+	}
+
+	v_AABB vCentroidAABB;
+	vCentroidAABB.Reset(vMinPoint, vMaxPoint);
+	AABB centroidAABB = store(vCentroidAABB);
+
+	// axis along which partitioning should be performed
+	const float* extArr = reinterpret_cast<float*>(&centroidAABB.Extents);
+	int splitAxis = 0;
+	float maxExtent = extArr[0];
+
+	// find the longest axis
+	for (int i = 1; i < 3; i++)
+	{
+		if (extArr[i] > maxExtent)
+		{
+			maxExtent = extArr[i];
+			splitAxis = i;
+		}
+	}
+
+	uint32_t splitCount = 0;
+
+	// split using SAH
+	if (count >= MIN_NUM_TRIS_SPLIT_SAH && maxExtent > 1e-7f)
+	{
+		Bin bins[NUM_SAH_BINS];
+		const float leftMostPlane = reinterpret_cast<float*>(&centroidAABB.Center)[splitAxis] - maxExtent;
+		const float rcpStepSize = NUM_SAH_BINS / (2.0f * maxExtent);
+
+		auto binIdx = [leftMostPlane, rcpStepSize, splitAxis](const BuildInput& tri)
+		{
+			const float c = reinterpret_cast<const float*>(&tri.AABB.Center)[splitAxis];
+			return Math::Min((int)((c - leftMostPlane) * rcpStepSize), NUM_SAH_BINS - 1);
+		};
+
+		// assign each triangle to one bin
+		for (uint32_t i = base; i < base + count; i++)
+		{
+			v_AABB vTriBox(input[i].AABB);
+			bins[binIdx(input[i])].Extend(_mm_sub_ps(vTriBox.vCenter, vTriBox.vExtents),
+				_mm_add_ps(vTriBox.vCenter, vTriBox.vExtents));
+		}
+
+		// N bins correspond to N - 1 split planes
+		float rightSurfaceArea[NUM_SAH_BINS - 1];
+		uint32_t rightCount[NUM_SAH_BINS - 1];
+
+		{
+			__m128 vMin = _mm_set1_ps(FLT_MAX);
+			__m128 vMax = _mm_set1_ps(-FLT_MAX);
+			uint32_t currSum = 0;
+
+			for (int plane = NUM_SAH_BINS - 2; plane >= 0; plane--)
+			{
+				vMin = _mm_min_ps(vMin, bins[plane + 1].vMin);
+				vMax = _mm_max_ps(vMax, bins[plane + 1].vMax);
+				currSum += bins[plane + 1].NumEntries;
+
+				rightCount[plane] = currSum;
+				rightSurfaceArea[plane] = currSum ? SurfaceArea(vMin, vMax) : 0.0f;
+			}
+		}
+
+		int lowestCostPlane = -1;
+		float lowestCost = FLT_MAX;
+
+		{
+			__m128 vMin = _mm_set1_ps(FLT_MAX);
+			__m128 vMax = _mm_set1_ps(-FLT_MAX);
+			uint32_t currSum = 0;
+
+			for (int plane = 0; plane < NUM_SAH_BINS - 1; plane++)
+			{
+				vMin = _mm_min_ps(vMin, bins[plane].vMin);
+				vMax = _mm_max_ps(vMax, bins[plane].vMax);
+				currSum += bins[plane].NumEntries;
+
+				if (currSum == 0 || rightCount[plane] == 0)
+					continue;
+
+				// parent's surface area is the same for all the split planes and can be left out
+				const float splitCost = currSum * SurfaceArea(vMin, vMax) + rightCount[plane] * rightSurfaceArea[plane];
+
+				if (splitCost < lowestCost)
+				{
+					lowestCost = splitCost;
+					lowestCostPlane = plane;
+				}
+			}
+		}
+
+		// partition using the bin indices rather than the split plane position so that the
+		// result is consistent with the binning above
+		if (lowestCostPlane != -1)
+		{
+			auto it = std::partition(input.begin() + base, input.begin() + base + count,
+				[binIdx, lowestCostPlane](const BuildInput& tri)
+				{
+					return binIdx(tri) <= lowestCostPlane;
+				});
+
+			splitCount = (uint32_t)(it - input.begin() - base);
+		}
+	}
+
+	// fall back to splitting into two subtrees with an equal number of triangles
+	if (splitCount == 0 || splitCount == count)
+	{
+		splitCount = count >> 1;
+
+		std::nth_element(input.begin() + base, input.begin() + base + splitCount, input.begin() + base + count,
+			[splitAxis](const BuildInput& t1, const BuildInput& t2)
+			{
+				// compare AABB centers along the split axis
+				return reinterpret_cast<const float*>(&t1.AABB.Center)[splitAxis] <
+					reinterpret_cast<const float*>(&t2.AABB.Center)[splitAxis];
+			});
+	}
+
+	[[maybe_unused]] const uint32_t left = BuildSubtree(input, base, splitCount);
+	const uint32_t right = BuildSubtree(input, base + splitCount, count - splitCount);
+	Assert(left == currNodeIdx + 1, "Index of left child should be equal to current parent's index plus one");
+
+	m_nodes[currNodeIdx].BaseOrRight = right;
+	m_nodes[currNodeIdx].Count = 0;
+
+	return currNodeIdx;
+}
+
+bool MeshBVH::CastRay(Math::Ray& r, Hit& hit) const noexcept
+{
+	if (m_nodes.empty())
+		return false;
+
+	v_Ray vRay(r);
+	const __m128 vIsParallel = _mm_cmpge_ps(_mm_set1_ps(FLT_EPSILON), abs(vRay.vDir));
+	const __m128 vDirRcp = _mm_div_ps(_mm_set1_ps(1.0f), vRay.vDir);
+	const __m128 vDirIsPos = _mm_cmpge_ps(vRay.vDir, _mm_setzero_ps());
+	float t;
+
+	// can return early if ray doesn't intersect the root AABB
+	if (!Math::intersectRayVsAABB(vRay, vDirRcp, vDirIsPos, vIsParallel, v_AABB(m_nodes[0].AABB), t) ||
+		t >= hit.T)
+		return false;
+
+	// manual stack. Inline storage covers all but highly unbalanced BVHs, which spill to the heap
+	// rather than overflowing.
+	SmallVector<uint32_t, Support::SystemAllocator, STACK_SIZE> stack;
+
+	// insert root
+	stack.push_back(0);
+	bool foundHit = false;
+
+	while (!stack.empty())
+	{
+		const uint32_t currNode = stack.back();
+		stack.pop_back();
+		const Node& node = m_nodes[currNode];
+
+		if (node.IsLeaf())
+		{
+			for (uint32_t i = node.BaseOrRight; i < node.BaseOrRight + node.Count; i++)
+			{
+				Triangle tri = m_triangles[i];
+				float u;
+				float v;
+
+				if (Math::intersectRayVsTriangle(vRay, loadFloat3(tri.V0), loadFloat3(tri.V1), loadFloat3(tri.V2), t, u, v) &&
+					t < hit.T)
+				{
+					hit.T = t;
+					hit.U = u;
+					hit.V = v;
+					hit.PrimitiveIdx = m_triIndices[i];
+					foundHit = true;
+				}
+			}
+
+			continue;
+		}
+
+		const uint32_t children[2] = { currNode + 1, node.BaseOrRight };
+		float childT[2];
+		bool hitChild[2];
+
+		for (int c = 0; c < 2; c++)
+		{
+			hitChild[c] = Math::intersectRayVsAABB(vRay, vDirRcp, vDirIsPos, vIsParallel,
+				v_AABB(m_nodes[children[c]].AABB), childT[c]);
+
+			// no need to search this subtree as there's already a closer hit
+			hitChild[c] = hitChild[c] && childT[c] < hit.T;
+		}
+
+		// make sure the closer subtree is popped first
+		const int first = hitChild[1] && (!hitChild[0] || childT[1] < childT[0]) ? 1 : 0;
+		const int second = 1 - first;
+
+		if (hitChild[second])
+			stack.push_back(children[second]);
+		if (hitChild[first])
+			stack.push_back(children[first]);
+	}
+
+	return foundHit;
+}
+
+void MeshBVH::Serialize(Vector<uint8_t>& buffer) const noexcept
+{
+	SerializedHeader header{ .Version = SERIALIZATION_VERSION,
+		.NumNodes = (uint32_t)m_nodes.size(),
+		.NumTriangles = (uint32_t)m_triangles.size() };
+
+	const size_t nodesSize = sizeof(Node) * m_nodes.size();
+	const size_t trisSize = sizeof(Triangle) * m_triangles.size();
+	const size_t triIndicesSize = sizeof(uint32_t) * m_triIndices.size();
+	const size_t offset = buffer.size();
+
+	buffer.resize(offset + sizeof(SerializedHeader) + nodesSize + trisSize + triIndicesSize);
+	uint8_t* curr = buffer.begin() + offset;
+
+	memcpy(curr, &header, sizeof(SerializedHeader));
+	curr += sizeof(SerializedHeader);
+	memcpy(curr, m_nodes.begin(), nodesSize);
+	curr += nodesSize;
+	memcpy(curr, m_triangles.begin(), trisSize);
+	curr += trisSize;
+	memcpy(curr, m_triIndices.begin(), triIndicesSize);
+}
+
+bool MeshBVH::Deserialize(const uint8_t*& curr, const uint8_t* end) noexcept
+{
+	Clear();
+
+	if ((size_t)(end - curr) < sizeof(SerializedHeader))
+		return false;
+
+	SerializedHeader header;
+	memcpy(&header, curr, sizeof(SerializedHeader));
+
+	if (header.Version != SERIALIZATION_VERSION)
+		return false;
+
+	const size_t nodesSize = sizeof(Node) * header.NumNodes;
+	const size_t trisSize = sizeof(Triangle) * header.NumTriangles;
+	const size_t triIndicesSize = sizeof(uint32_t) * header.NumTriangles;
+
+	if ((size_t)(end - curr) < sizeof(SerializedHeader) + nodesSize + trisSize + triIndicesSize)
+		return false;
+
+	const uint8_t* ptr = curr + sizeof(SerializedHeader);
+
+	m_nodes.resize(header.NumNodes);
+	memcpy(m_nodes.data(), ptr, nodesSize);
+	ptr += nodesSize;
+
+	m_triangles.resize(header.NumTriangles);
+	memcpy(m_triangles.data(), ptr, trisSize);
+	ptr += trisSize;
+
+	m_triIndices.resize(header.NumTriangles);
+	memcpy(m_triIndices.data(), ptr, triIndicesSize);
+	ptr += triIndicesSize;
+
+	// data could be corrupted, make sure that traversal can't go out of bounds or loop forever. Left
+	// child always immediately follows its parent and right child comes after the left subtree.
+	for (uint32_t i = 0; i < header.NumNodes; i++)
+	{
+		const Node& node = m_nodes[i];
+		const bool valid = node.IsLeaf() ?
+			node.BaseOrRight <= header.NumTriangles && node.Count <= header.NumTriangles - node.BaseOrRight :
+			node.BaseOrRight > i + 1 && node.BaseOrRight < header.NumNodes;
+
+		if (!valid)
+		{
+			Clear();
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < header.NumTriangles; i++)
+	{
+		if (m_triIndices[i] >= header.NumTriangles)
+		{
+			Clear();
+			return false;
+		}
+	}
+
+	curr = ptr;
+
+	return true;
+}
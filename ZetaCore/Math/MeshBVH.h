@@ -0,0 +1,117 @@
+// Triangle-level BVH for a single mesh (equivalent of a bottom-level acceleration structure),
+// built top-down using binned SAH. Together with the instance-level BVH, it enables exact
+// CPU-side ray queries against the scene geometry.
+//
+// References:
+// 1. Physically Based Rendering 3rd Ed.
+// 2. I. Wald, "On fast Construction of SAH-based Bounding Volume Hierarchies," 2007.
+
+#pragma once
+
+#include "../Math/CollisionTypes.h"
+#include "../Core/Vertex.h"
+#include "../Utility/Span.h"
+
+namespace ZetaRay::Math
+{
+	class MeshBVH
+	{
+	public:
+		struct Hit
+		{
+			// distance along the ray (in units of ray direction's length)
+			float T = FLT_MAX;
+			// barycentric coords. of the hit position such that
+			//		hit_pos = v0 + U(v1 - v0) + V(v2 - v0)
+			float U;
+			float V;
+			// index of the intersected triangle in the mesh's index buffer (i.e. index / 3)
+			uint32_t PrimitiveIdx = uint32_t(-1);
+		};
+
+		MeshBVH() noexcept = default;
+		~MeshBVH() noexcept = default;
+
+		MeshBVH(MeshBVH&&) noexcept = default;
+		MeshBVH& operator=(MeshBVH&&) noexcept = default;
+
+		bool IsBuilt() const noexcept { return m_nodes.size() != 0; }
+		void Clear() noexcept;
+
+		// Builds the BVH for the mesh given by the vertex & index buffers (in object space)
+		void Build(Util::Span<Core::Vertex> vertices, Util::Span<uint32_t> indices) noexcept;
+
+		// Casts a ray into the BVH and returns whether there was a hit closer than hit.T. On return,
+		// hit contains the closest intersection. Given Ray has to be in object space.
+		bool CastRay(Math::Ray& r, Hit& hit) const noexcept;
+
+		// Returns the AABB that encompasses the mesh (in object space)
+		Math::AABB GetAABB() const noexcept
+		{
+			Assert(m_nodes.size() > 0, "BVH hasn't been built yet.");
+			return m_nodes[0].AABB;
+		}
+
+		// Appends the serialized BVH to the end of given buffer
+		void Serialize(Util::Vector<uint8_t>& buffer) const noexcept;
+		// Deserializes the BVH starting at given pointer and on success, advances it past the
+		// consumed data. Returns false if data is truncated, stale (e.g. different format version) or
+		// has out-of-bound node or triangle indices.
+		bool Deserialize(const uint8_t*& curr, const uint8_t* end) noexcept;
+
+		uint32_t GetNumTriangles() const noexcept { return (uint32_t)m_triIndices.size(); }
+
+		// Returns the triangles (in object space and BVH order) as a triangle list
+		Util::Span<Math::float3> GetTriangleVertices() noexcept
+		{
+			return Util::Span(reinterpret_cast<Math::float3*>(m_triangles.data()), m_triangles.size() * 3);
+		}
+
+	private:
+		static constexpr uint32_t SERIALIZATION_VERSION = 1;
+		static constexpr int MAX_NUM_TRIS_PER_LEAF = 4;
+		static constexpr int MIN_NUM_TRIS_SPLIT_SAH = 8;
+		static constexpr int NUM_SAH_BINS = 12;
+		static constexpr int STACK_SIZE = 64;
+
+		struct Node
+		{
+			bool IsLeaf() const { return Count != 0; }
+
+			Math::AABB AABB;
+
+			// for leaves, offset of the first triangle, otherwise index of the right child (left
+			// child always immediately follows its parent)
+			uint32_t BaseOrRight;
+
+			// number of triangles for leaves, zero for internal nodes
+			uint32_t Count;
+		};
+
+		static_assert(sizeof(Node) == 32, "unexpected Node size.");
+
+		// triangle vertices are stored in BVH order so that leaves can be intersected without
+		// going through the vertex & index buffers (which are released after upload to GPU)
+		struct Triangle
+		{
+			float3 V0;
+			float3 V1;
+			float3 V2;
+		};
+
+		static_assert(sizeof(Triangle) == 3 * sizeof(Math::float3), "unexpected Triangle size.");
+
+		struct alignas(16) BuildInput
+		{
+			Math::AABB AABB;
+			uint32_t TriIdx;
+		};
+
+		// Recursively builds a BVH (subtree) for the given range
+		uint32_t BuildSubtree(Util::Span<BuildInput> input, uint32_t base, uint32_t count) noexcept;
+
+		Util::SmallVector<Node> m_nodes;
+		Util::SmallVector<Triangle> m_triangles;
+		Util::SmallVector<uint32_t> m_triIndices;
+	};
+}
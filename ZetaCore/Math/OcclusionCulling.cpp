@@ -0,0 +1,378 @@
+#include "OcclusionCulling.h"
+#include "../Math/MatrixFuncs.h"
+#include "../Utility/Error.h"
+#include <algorithm>
+
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Math;
+
+namespace
+{
+	ZetaInline float ZETA_VECTORCALL HorizontalMin(const __m256 v) noexcept
+	{
+		__m128 vMin = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		vMin = _mm_min_ps(vMin, _mm_shuffle_ps(vMin, vMin, V_SHUFFLE_XYZW(2, 3, 0, 1)));
+		vMin = _mm_min_ps(vMin, _mm_shuffle_ps(vMin, vMin, V_SHUFFLE_XYZW(1, 0, 3, 2)));
+
+		return _mm_cvtss_f32(vMin);
+	}
+
+	ZetaInline float ZETA_VECTORCALL HorizontalMax(const __m256 v) noexcept
+	{
+		__m128 vMax = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		vMax = _mm_max_ps(vMax, _mm_shuffle_ps(vMax, vMax, V_SHUFFLE_XYZW(2, 3, 0, 1)));
+		vMax = _mm_max_ps(vMax, _mm_shuffle_ps(vMax, vMax, V_SHUFFLE_XYZW(1, 0, 3, 2)));
+
+		return _mm_cvtss_f32(vMax);
+	}
+
+	// Edge function E(p) = A * p.x + B * p.y + C of the directed edge ab. For a triangle with positive
+	// signed area, p is inside iff E(p) >= 0 for all three of its edges.
+	struct EdgeFunc
+	{
+		EdgeFunc() noexcept = default;
+		EdgeFunc(float ax, float ay, float bx, float by) noexcept
+			: A(ay - by),
+			B(bx - ax),
+			C(-(ay - by) * ax - (bx - ax) * ay)
+		{}
+
+		// Returns the maximum value of E(p) over a rectangle of pixel centers
+		ZetaInline float MaxOverRect(float xLeft, float xRight, float yTop, float yBottom) const noexcept
+		{
+			return A * (A > 0.0f ? xRight : xLeft) + B * (B > 0.0f ? yBottom : yTop) + C;
+		}
+
+		float A;
+		float B;
+		float C;
+	};
+}
+
+//--------------------------------------------------------------------------------------
+// OcclusionBuffer
+//--------------------------------------------------------------------------------------
+
+void OcclusionBuffer::Init(int width, int height) noexcept
+{
+	Assert(width > 0 && height > 0, "Invalid dimensions.");
+	Assert((width % TILE_WIDTH) == 0 && (height % TILE_HEIGHT) == 0, "Width and height must be multiples of tile dimensions.");
+
+	m_width = width;
+	m_height = height;
+	m_numTilesX = width / TILE_WIDTH;
+	m_numTilesY = height / TILE_HEIGHT;
+
+	m_tiles.resize(m_numTilesX * m_numTilesY);
+	m_tileFarthestDepth.resize(m_numTilesX * m_numTilesY);
+}
+
+void OcclusionBuffer::Clear() noexcept
+{
+	m_tiles.free_memory();
+	m_tileFarthestDepth.free_memory();
+	m_width = 0;
+	m_height = 0;
+	m_numTilesX = 0;
+	m_numTilesY = 0;
+}
+
+void OcclusionBuffer::BeginFrame(const float4x4a& viewProj, float nearZ) noexcept
+{
+	Assert(m_tiles.size() > 0, "OcclusionBuffer hasn't been initialized.");
+	Assert(nearZ > 0.0f, "Near plane distance must be positive.");
+
+	memset(m_tiles.data(), 0, m_tiles.size() * sizeof(Tile));
+	memset(m_tileFarthestDepth.data(), 0, m_tileFarthestDepth.size() * sizeof(float));
+
+	m_viewProj = viewProj;
+	m_nearZ = nearZ;
+	m_numRasterizedTris = 0;
+}
+
+void OcclusionBuffer::RasterizeOccluder(Span<float3> vertices, const float4x3& toWorld) noexcept
+{
+	Assert(vertices.size() % 3 == 0, "Vertices don't form a triangle list.");
+
+	const v_float4x4 vObjectToClip = mul(load(toWorld), load(m_viewProj));
+	const __m128 vOne = _mm_set1_ps(1.0f);
+	const __m128 vViewportScale = _mm_setr_ps(0.5f * m_width, -0.5f * m_height, 1.0f, 0.0f);
+	const __m128 vViewportBias = _mm_setr_ps(0.5f * m_width, 0.5f * m_height, 0.0f, 0.0f);
+
+	for (size_t t = 0; t < vertices.size(); t += 3)
+	{
+		__m128 vClip[3];
+		float w[3];
+
+		for (int i = 0; i < 3; i++)
+		{
+			const __m128 vPos = _mm_insert_ps(loadFloat3(vertices[t + i]), vOne, 0x30);
+			vClip[i] = mul(vObjectToClip, vPos);
+			w[i] = _mm_cvtss_f32(_mm_shuffle_ps(vClip[i], vClip[i], V_SHUFFLE_XYZW(3, 3, 3, 3)));
+		}
+
+		// trivially reject triangles that are completely outside one of the side planes, i.e.
+		// x < -w, x > w, y < -w or y > w for all the vertices
+		{
+			int outside = 0xf;
+
+			for (int i = 0; i < 3; i++)
+			{
+				const __m128 vW = _mm_shuffle_ps(vClip[i], vClip[i], V_SHUFFLE_XYZW(3, 3, 3, 3));
+				const int ltMinusW = _mm_movemask_ps(_mm_cmplt_ps(vClip[i], negate(vW))) & 0x3;
+				const int gtW = _mm_movemask_ps(_mm_cmpgt_ps(vClip[i], vW)) & 0x3;
+				outside &= ltMinusW | (gtW << 2);
+			}
+
+			if (outside)
+				continue;
+		}
+
+		// clip against the near plane (w >= near). Result is a convex polygon with at most 4 vertices.
+		__m128 vPolygon[4];
+		int n = 0;
+
+		for (int i = 0; i < 3; i++)
+		{
+			const int next = i == 2 ? 0 : i + 1;
+			const bool currInside = w[i] >= m_nearZ;
+			const bool nextInside = w[next] >= m_nearZ;
+
+			if (currInside)
+				vPolygon[n++] = vClip[i];
+
+			if (currInside != nextInside)
+			{
+				const float s = (m_nearZ - w[i]) / (w[next] - w[i]);
+				vPolygon[n++] = _mm_fmadd_ps(_mm_set1_ps(s), _mm_sub_ps(vClip[next], vClip[i]), vClip[i]);
+			}
+		}
+
+		if (n < 3)
+			continue;
+
+		// perspective division and viewport transformation -- (x, y, 1 / w) with x & y in pixels
+		for (int i = 0; i < n; i++)
+		{
+			const __m128 vW = _mm_shuffle_ps(vPolygon[i], vPolygon[i], V_SHUFFLE_XYZW(3, 3, 3, 3));
+			const __m128 vRcpW = _mm_div_ps(vOne, vW);
+			__m128 vScreen = _mm_mul_ps(vPolygon[i], vRcpW);
+			vScreen = _mm_fmadd_ps(vScreen, vViewportScale, vViewportBias);
+			vPolygon[i] = _mm_insert_ps(vScreen, vRcpW, 0x20);
+		}
+
+		for (int i = 1; i < n - 1; i++)
+			RasterizeTriangle(vPolygon[0], vPolygon[i], vPolygon[i + 1]);
+	}
+}
+
+void OcclusionBuffer::RasterizeTriangle(const __m128 v0, const __m128 v1, const __m128 v2) noexcept
+{
+	float4a p[3];
+	_mm_store_ps(reinterpret_cast<float*>(&p[0]), v0);
+	_mm_store_ps(reinterpret_cast<float*>(&p[1]), v1);
+	_mm_store_ps(reinterpret_cast<float*>(&p[2]), v2);
+
+	float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+
+	// degenerate
+	if (fabsf(area) < 1e-8f)
+		return;
+
+	// occluders are rasterized regardless of their winding order
+	if (area < 0.0f)
+	{
+		std::swap(p[1], p[2]);
+		area = -area;
+	}
+
+	// screen-space bounding box (inclusive range of pixels whose center might be inside). Vertices 
+	// close to the near plane can be far outside the screen, so clamp before converting to int.
+	const int xMin = (int)floorf(Math::Max(Math::Min(p[0].x, Math::Min(p[1].x, p[2].x)), 0.0f));
+	const int xMax = (int)floorf(Math::Min(Math::Max(p[0].x, Math::Max(p[1].x, p[2].x)), m_width - 0.5f));
+	const int yMin = (int)floorf(Math::Max(Math::Min(p[0].y, Math::Min(p[1].y, p[2].y)), 0.0f));
+	const int yMax = (int)floorf(Math::Min(Math::Max(p[0].y, Math::Max(p[1].y, p[2].y)), m_height - 0.5f));
+
+	if (xMin > xMax || yMin > yMax)
+		return;
+
+	m_numRasterizedTris++;
+
+	const EdgeFunc e01(p[0].x, p[0].y, p[1].x, p[1].y);
+	const EdgeFunc e12(p[1].x, p[1].y, p[2].x, p[2].y);
+	const EdgeFunc e20(p[2].x, p[2].y, p[0].x, p[0].y);
+
+	// depth is an affine function of screen position. Barycentric coords. of each vertex are
+	// given by the edge function of its opposite edge divided by area.
+	const float rcpArea = 1.0f / area;
+	const float dzdx = (e12.A * p[0].z + e20.A * p[1].z + e01.A * p[2].z) * rcpArea;
+	const float dzdy = (e12.B * p[0].z + e20.B * p[1].z + e01.B * p[2].z) * rcpArea;
+	float zConst = (e12.C * p[0].z + e20.C * p[1].z + e01.C * p[2].z) * rcpArea;
+
+	// depth is evaluated at pixel centers, but the triangle could be farther away elsewhere
+	// inside the pixel. Pushing it back by half a pixel's worth of depth change keeps it conservative.
+	zConst -= 0.5f * (fabsf(dzdx) + fabsf(dzdy));
+	const float zMin = Math::Min(p[0].z, Math::Min(p[1].z, p[2].z));
+	const float zMax = Math::Max(p[0].z, Math::Max(p[1].z, p[2].z));
+
+	const __m256 vLaneOffset = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+	const __m256 vA01 = _mm256_set1_ps(e01.A);
+	const __m256 vA12 = _mm256_set1_ps(e12.A);
+	const __m256 vA20 = _mm256_set1_ps(e20.A);
+	const __m256 vDzdx = _mm256_set1_ps(dzdx);
+	const __m256 vZMin = _mm256_set1_ps(zMin);
+	const __m256 vZero = _mm256_setzero_ps();
+
+	const int tileXBeg = xMin / TILE_WIDTH;
+	const int tileXEnd = xMax / TILE_WIDTH;
+	const int tileYBeg = yMin / TILE_HEIGHT;
+	const int tileYEnd = yMax / TILE_HEIGHT;
+
+	for (int tileY = tileYBeg; tileY <= tileYEnd; tileY++)
+	{
+		const float yTop = (float)(tileY * TILE_HEIGHT) + 0.5f;
+		const float yBottom = yTop + (float)(TILE_HEIGHT - 1);
+
+		for (int tileX = tileXBeg; tileX <= tileXEnd; tileX++)
+		{
+			const int tileIdx = tileY * m_numTilesX + tileX;
+
+			// every pixel in this tile is already closer than the triangle
+			if (m_tileFarthestDepth[tileIdx] >= zMax)
+				continue;
+
+			const float xLeft = (float)(tileX * TILE_WIDTH) + 0.5f;
+			const float xRight = xLeft + (float)(TILE_WIDTH - 1);
+
+			// tile is completely outside one of the edges
+			if (e01.MaxOverRect(xLeft, xRight, yTop, yBottom) < 0.0f ||
+				e12.MaxOverRect(xLeft, xRight, yTop, yBottom) < 0.0f ||
+				e20.MaxOverRect(xLeft, xRight, yTop, yBottom) < 0.0f)
+				continue;
+
+			const __m256 vX = _mm256_add_ps(_mm256_set1_ps((float)(tileX * TILE_WIDTH)), vLaneOffset);
+			const __m256 vE01Row = _mm256_fmadd_ps(vA01, vX, _mm256_set1_ps(e01.C));
+			const __m256 vE12Row = _mm256_fmadd_ps(vA12, vX, _mm256_set1_ps(e12.C));
+			const __m256 vE20Row = _mm256_fmadd_ps(vA20, vX, _mm256_set1_ps(e20.C));
+			const __m256 vZRow = _mm256_fmadd_ps(vDzdx, vX, _mm256_set1_ps(zConst));
+
+			Tile& tile = m_tiles[tileIdx];
+			__m256 vTileFarthest = _mm256_set1_ps(FLT_MAX);
+
+			for (int row = 0; row < TILE_HEIGHT; row++)
+			{
+				const float y = yTop + (float)row;
+
+				const __m256 vE01 = _mm256_add_ps(vE01Row, _mm256_set1_ps(e01.B * y));
+				const __m256 vE12 = _mm256_add_ps(vE12Row, _mm256_set1_ps(e12.B * y));
+				const __m256 vE20 = _mm256_add_ps(vE20Row, _mm256_set1_ps(e20.B * y));
+
+				__m256 vInside = _mm256_cmp_ps(vE01, vZero, _CMP_GE_OQ);
+				vInside = _mm256_and_ps(vInside, _mm256_cmp_ps(vE12, vZero, _CMP_GE_OQ));
+				vInside = _mm256_and_ps(vInside, _mm256_cmp_ps(vE20, vZero, _CMP_GE_OQ));
+
+				const __m256 vZ = _mm256_max_ps(_mm256_add_ps(vZRow, _mm256_set1_ps(dzdy * y)), vZMin);
+				const __m256 vDepth = _mm256_load_ps(tile.Depth[row]);
+				const __m256 vNewDepth = _mm256_blendv_ps(vDepth, _mm256_max_ps(vDepth, vZ), vInside);
+
+				_mm256_store_ps(tile.Depth[row], vNewDepth);
+				vTileFarthest = _mm256_min_ps(vTileFarthest, vNewDepth);
+			}
+
+			m_tileFarthestDepth[tileIdx] = HorizontalMin(vTileFarthest);
+		}
+	}
+}
+
+bool OcclusionBuffer::IsOccluded(const AABB& AABB) noexcept
+{
+	const float3 boxMin = AABB.Center - AABB.Extents;
+	const float3 boxMax = AABB.Center + AABB.Extents;
+
+	// the eight corners -- bit 0 of the lane index selects x, bit 1 selects y and bit 2 selects z
+	const __m256 vPx = _mm256_setr_ps(boxMin.x, boxMax.x, boxMin.x, boxMax.x, boxMin.x, boxMax.x, boxMin.x, boxMax.x);
+	const __m256 vPy = _mm256_setr_ps(boxMin.y, boxMin.y, boxMax.y, boxMax.y, boxMin.y, boxMin.y, boxMax.y, boxMax.y);
+	const __m256 vPz = _mm256_setr_ps(boxMin.z, boxMin.z, boxMin.z, boxMin.z, boxMax.z, boxMax.z, boxMax.z, boxMax.z);
+
+	auto transformCoord = [&](int c)
+		{
+			const float* m0 = reinterpret_cast<const float*>(&m_viewProj.m[0]);
+			const float* m1 = reinterpret_cast<const float*>(&m_viewProj.m[1]);
+			const float* m2 = reinterpret_cast<const float*>(&m_viewProj.m[2]);
+			const float* m3 = reinterpret_cast<const float*>(&m_viewProj.m[3]);
+
+			__m256 vRes = _mm256_fmadd_ps(vPx, _mm256_set1_ps(m0[c]), _mm256_set1_ps(m3[c]));
+			vRes = _mm256_fmadd_ps(vPy, _mm256_set1_ps(m1[c]), vRes);
+			vRes = _mm256_fmadd_ps(vPz, _mm256_set1_ps(m2[c]), vRes);
+
+			return vRes;
+		};
+
+	const __m256 vClipX = transformCoord(0);
+	const __m256 vClipY = transformCoord(1);
+	const __m256 vClipW = transformCoord(3);
+
+	// AABB intersects the near plane
+	if (_mm256_movemask_ps(_mm256_cmp_ps(vClipW, _mm256_set1_ps(m_nearZ), _CMP_LT_OQ)))
+		return false;
+
+	const __m256 vRcpW = _mm256_div_ps(_mm256_set1_ps(1.0f), vClipW);
+	const __m256 vScreenX = _mm256_fmadd_ps(_mm256_mul_ps(vClipX, vRcpW), _mm256_set1_ps(0.5f * m_width),
+		_mm256_set1_ps(0.5f * m_width));
+	const __m256 vScreenY = _mm256_fmadd_ps(_mm256_mul_ps(vClipY, vRcpW), _mm256_set1_ps(-0.5f * m_height),
+		_mm256_set1_ps(0.5f * m_height));
+
+	const float screenXMin = HorizontalMin(vScreenX);
+	const float screenXMax = HorizontalMax(vScreenX);
+	const float screenYMin = HorizontalMin(vScreenY);
+	const float screenYMax = HorizontalMax(vScreenY);
+	// depth of the closest point
+	const float boxDepth = HorizontalMax(vRcpW);
+
+	// outside the screen, assume it's visible
+	if (screenXMax < 0.0f || screenXMin >= (float)m_width || screenYMax < 0.0f || screenYMin >= (float)m_height)
+		return false;
+
+	// inclusive range of pixels that the (screen-space bounding rectangle of) AABB overlaps
+	const int xMin = (int)floorf(Math::Max(screenXMin, 0.0f));
+	const int xMax = (int)floorf(Math::Min(screenXMax, m_width - 0.5f));
+	const int yMin = (int)floorf(Math::Max(screenYMin, 0.0f));
+	const int yMax = (int)floorf(Math::Min(screenYMax, m_height - 0.5f));
+
+	const __m256 vLaneIdx = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	const __m256 vXMin = _mm256_set1_ps((float)xMin);
+	const __m256 vXMax = _mm256_set1_ps((float)xMax);
+	const __m256 vBoxDepth = _mm256_set1_ps(boxDepth);
+
+	for (int tileY = yMin / TILE_HEIGHT; tileY <= yMax / TILE_HEIGHT; tileY++)
+	{
+		for (int tileX = xMin / TILE_WIDTH; tileX <= xMax / TILE_WIDTH; tileX++)
+		{
+			const int tileIdx = tileY * m_numTilesX + tileX;
+
+			// every pixel in this tile is closer than the closest point of AABB
+			if (m_tileFarthestDepth[tileIdx] > boxDepth)
+				continue;
+
+			// otherwise, check the overlapped pixels individually
+			const __m256 vX = _mm256_add_ps(_mm256_set1_ps((float)(tileX * TILE_WIDTH)), vLaneIdx);
+			const __m256 vInRange = _mm256_and_ps(_mm256_cmp_ps(vX, vXMin, _CMP_GE_OQ),
+				_mm256_cmp_ps(vX, vXMax, _CMP_LE_OQ));
+
+			const int rowBeg = Math::Max(yMin - tileY * TILE_HEIGHT, 0);
+			const int rowEnd = Math::Min(yMax - tileY * TILE_HEIGHT, TILE_HEIGHT - 1);
+			const Tile& tile = m_tiles[tileIdx];
+
+			for (int row = rowBeg; row <= rowEnd; row++)
+			{
+				const __m256 vDepth = _mm256_load_ps(tile.Depth[row]);
+				const __m256 vNotOccluded = _mm256_and_ps(vInRange, _mm256_cmp_ps(vDepth, vBoxDepth, _CMP_LE_OQ));
+
+				if (_mm256_movemask_ps(vNotOccluded))
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,80 @@
+// Software occlusion culling on the CPU. A few large occluders are rasterized (eight pixels at
+// a time using AVX) into a low-resolution depth buffer, which is then used for testing whether
+// instance AABBs are completely hidden. Depth buffer is divided into 8x4 tiles and each tile
+// additionally keeps the farthest depth among its pixels, so that most AABB tests can be resolved
+// a tile at a time without looking at individual pixels.
+//
+// Depth is stored as 1 / w (w is view-space depth), which is linear in screen space and is larger
+// for closer surfaces. Pixels that haven't been covered by any occluder have depth 0 (i.e. they're
+// infinitely far away).
+//
+// References:
+// 1. J. Hasselgren, M. Andersson and T. Akenine-Moller, "Masked Software Occlusion Culling," in HPG, 2016.
+// 2. N. Greene, M. Kass and G. Miller, "Hierarchical Z-Buffer Visibility," in SIGGRAPH, 1993.
+
+#pragma once
+
+#include "Matrix.h"
+#include "CollisionTypes.h"
+#include "../Utility/Span.h"
+
+namespace ZetaRay::Math
+{
+	class OcclusionBuffer
+	{
+	public:
+		static constexpr int TILE_WIDTH = 8;
+		static constexpr int TILE_HEIGHT = 4;
+
+		OcclusionBuffer() noexcept = default;
+		~OcclusionBuffer() noexcept = default;
+
+		OcclusionBuffer(const OcclusionBuffer&) = delete;
+		OcclusionBuffer& operator=(const OcclusionBuffer&) = delete;
+
+		// Width and height have to be multiples of tile width and tile height respectively
+		void Init(int width, int height) noexcept;
+		void Clear() noexcept;
+
+		// Clears the depth buffer. viewProj transforms from world space to clip space (row vectors)
+		// and geometry closer than nearZ (in view space) is clipped.
+		void BeginFrame(const Math::float4x4a& viewProj, float nearZ) noexcept;
+
+		// Rasterizes the given object-space triangle list (three consecutive vertices per triangle)
+		// into the depth buffer
+		void RasterizeOccluder(Util::Span<Math::float3> vertices, const Math::float4x3& toWorld) noexcept;
+
+		// Returns whether the given world-space AABB is completely hidden behind the occluders
+		// that have been rasterized so far. Not conservative -- occluders are sampled at pixel centers,
+		// so gaps between them that are narrower than a pixel count as covered and instances that are
+		// visible through such gaps can be reported as occluded.
+		bool IsOccluded(const Math::AABB& AABB) noexcept;
+
+		int GetWidth() const noexcept { return m_width; }
+		int GetHeight() const noexcept { return m_height; }
+		uint32_t GetNumRasterizedTriangles() const noexcept { return m_numRasterizedTris; }
+
+	private:
+		struct alignas(32) Tile
+		{
+			float Depth[TILE_HEIGHT][TILE_WIDTH];
+		};
+
+		// Rasterizes a triangle that's already been clipped against the near plane. Each
+		// vertex is (x, y, 1 / w) with x & y in pixels.
+		void RasterizeTriangle(const __m128 v0, const __m128 v1, const __m128 v2) noexcept;
+
+		Util::SmallVector<Tile> m_tiles;
+		// farthest depth among each tile's pixels
+		Util::SmallVector<float> m_tileFarthestDepth;
+
+		int m_width = 0;
+		int m_height = 0;
+		int m_numTilesX = 0;
+		int m_numTilesY = 0;
+
+		Math::float4x4a m_viewProj;
+		float m_nearZ;
+		uint32_t m_numRasterizedTris = 0;
+	};
+}
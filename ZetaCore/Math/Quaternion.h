@@ -6,7 +6,7 @@
 namespace ZetaRay::Math
 {
 	// Returns a roations quaternion that can be used to rotate about axis n by angle theta
-	ZetaInline __m128 __vectorcall rotationQuat(float3 n, float theta) noexcept
+	ZetaInline __m128 ZETA_VECTORCALL rotationQuat(float3 n, float theta) noexcept
 	{
 		const float s = sinf(0.5f * theta);
 		const float c = cosf(0.5f * theta);
@@ -24,7 +24,7 @@ namespace ZetaRay::Math
 		return vQ;
 	}
 
-	ZetaInline __m128 __vectorcall quatToAxisAngle(__m128 vQuat)
+	ZetaInline __m128 ZETA_VECTORCALL quatToAxisAngle(__m128 vQuat)
 	{
 		float4a quat = store(vQuat);
 		float theta = 2.0f * acosf(quat.w);
@@ -35,7 +35,7 @@ namespace ZetaRay::Math
 		return vAxisAngle;
 	}
 
-	ZetaInline void __vectorcall quatToAxisAngle(__m128 vQuat, float3& axis, float& angle)
+	ZetaInline void ZETA_VECTORCALL quatToAxisAngle(__m128 vQuat, float3& axis, float& angle)
 	{
 		float4a quat = store(vQuat);
 		angle = 2.0f * acosf(quat.w);
@@ -43,7 +43,7 @@ namespace ZetaRay::Math
 		axis.normalize();
 	}
 
-	ZetaInline void __vectorcall quatToAxisAngle(float4a& quat, float3& axis, float& angle)
+	ZetaInline void ZETA_VECTORCALL quatToAxisAngle(float4a& quat, float3& axis, float& angle)
 	{
 		angle = 2.0f * acosf(quat.w);
 		axis = float3(quat.x, quat.y, quat.z);
@@ -51,7 +51,7 @@ namespace ZetaRay::Math
 	}
 
 	// Multiplies two given quaternions
-	ZetaInline __m128 __vectorcall mulQuat(const __m128 vP, const __m128 vQ) noexcept
+	ZetaInline __m128 ZETA_VECTORCALL mulQuat(const __m128 vP, const __m128 vQ) noexcept
 	{
 		// p = (p1, p2, p3, p4)
 		// q = (q1, q2, q3, q4)
@@ -79,7 +79,7 @@ namespace ZetaRay::Math
 		return result;
 	}
 
-	ZetaInline __m128 __vectorcall slerp(const __m128 vQ1, const __m128 vQ2, float t) noexcept
+	ZetaInline __m128 ZETA_VECTORCALL slerp(const __m128 vQ1, const __m128 vQ2, float t) noexcept
 	{
 		// rotation by unit quaternions q and -q lead to same result, with the difference
 		// that q rotates about axis n by angle theta, whereas -q rotates about angle -n by
@@ -122,7 +122,7 @@ namespace ZetaRay::Math
 	// yaw: angle of rotation around the y-axis (radians)
 	// roll: angle of rotation around the z-axis (radians)
 	// order is roll, pitch, then yaw
-	ZetaInline __m128 __vectorcall rotationQuatFromRollPitchYaw(float pitch, float yaw, float roll) noexcept
+	ZetaInline __m128 ZETA_VECTORCALL rotationQuatFromRollPitchYaw(float pitch, float yaw, float roll) noexcept
 	{
 		// roll:
 		//		n = (0, 0, 1) -> q_r = (0, 0, sin(r/2), cos(r/2)
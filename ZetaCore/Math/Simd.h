@@ -0,0 +1,480 @@
+// Thin abstraction over SIMD registers, so that wide loops can be written once and compiled for
+// different instruction sets. simd<float, N> is a pack of N floats and simd_mask<float, N> is the
+// result of comparing two such packs.
+//
+// Every backend lives in its own namespace under SimdBackend (so that they can be used side by
+// side, e.g. for testing) and simd<T, N> is an alias for the best one that's available on the
+// target. Packs that are wider than the native registers are emulated using two native packs.
+//
+//	Backend		simd<float, 4>		simd<float, 8>
+//	Scalar		float[4]			float[8]
+//	SSE4		__m128				2 x __m128
+//	AVX2		__m128				__m256
+//
+// Defining ZETA_SIMD_FORCE_SCALAR selects the scalar backend regardless of the target.
+
+#pragma once
+
+#include "../App/ZetaRay.h"
+#include <stdint.h>
+#include <math.h>
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define ZETA_SIMD_AVX2 1
+#endif
+
+#if defined(__SSE4_1__) || defined(__AVX__) || defined(ZETA_SIMD_AVX2)
+#define ZETA_SIMD_SSE4 1
+#endif
+
+#if defined(ZETA_SIMD_SSE4)
+#include <immintrin.h>
+#endif
+
+//--------------------------------------------------------------------------------------
+// Emulation of wide packs using two narrower ones
+//--------------------------------------------------------------------------------------
+
+namespace ZetaRay::Math::SimdBackend::Detail
+{
+	template<typename M>
+	struct MaskPair
+	{
+		M Lo;
+		M Hi;
+	};
+
+	template<typename P>
+	struct PackPair
+	{
+		static constexpr int Width = 2 * P::Width;
+		using Mask = MaskPair<typename P::Mask>;
+
+		PackPair() noexcept = default;
+		PackPair(P lo, P hi) noexcept
+			: Lo(lo),
+			Hi(hi)
+		{}
+		explicit PackPair(float f) noexcept
+			: Lo(f),
+			Hi(f)
+		{}
+
+		static ZetaInline PackPair load(const float* p) noexcept
+		{
+			return PackPair(P::load(p), P::load(p + P::Width));
+		}
+
+		ZetaInline void store(float* p) const noexcept
+		{
+			Lo.store(p);
+			Hi.store(p + P::Width);
+		}
+
+		P Lo;
+		P Hi;
+	};
+
+	template<typename P>
+	ZetaInline PackPair<P> operator+(const PackPair<P>& a, const PackPair<P>& b) noexcept { return PackPair<P>(a.Lo + b.Lo, a.Hi + b.Hi); }
+	template<typename P>
+	ZetaInline PackPair<P> operator-(const PackPair<P>& a, const PackPair<P>& b) noexcept { return PackPair<P>(a.Lo - b.Lo, a.Hi - b.Hi); }
+	template<typename P>
+	ZetaInline PackPair<P> operator*(const PackPair<P>& a, const PackPair<P>& b) noexcept { return PackPair<P>(a.Lo * b.Lo, a.Hi * b.Hi); }
+	template<typename P>
+	ZetaInline PackPair<P> operator/(const PackPair<P>& a, const PackPair<P>& b) noexcept { return PackPair<P>(a.Lo / b.Lo, a.Hi / b.Hi); }
+	template<typename P>
+	ZetaInline PackPair<P> operator-(const PackPair<P>& a) noexcept { return PackPair<P>(-a.Lo, -a.Hi); }
+
+	template<typename P>
+	ZetaInline PackPair<P> fmadd(const PackPair<P>& a, const PackPair<P>& b, const PackPair<P>& c) noexcept
+	{
+		return PackPair<P>(fmadd(a.Lo, b.Lo, c.Lo), fmadd(a.Hi, b.Hi, c.Hi));
+	}
+	template<typename P>
+	ZetaInline PackPair<P> Min(const PackPair<P>& a, const PackPair<P>& b) noexcept { return PackPair<P>(Min(a.Lo, b.Lo), Min(a.Hi, b.Hi)); }
+	template<typename P>
+	ZetaInline PackPair<P> Max(const PackPair<P>& a, const PackPair<P>& b) noexcept { return PackPair<P>(Max(a.Lo, b.Lo), Max(a.Hi, b.Hi)); }
+	template<typename P>
+	ZetaInline PackPair<P> abs(const PackPair<P>& a) noexcept { return PackPair<P>(abs(a.Lo), abs(a.Hi)); }
+	template<typename P>
+	ZetaInline PackPair<P> sqrt(const PackPair<P>& a) noexcept { return PackPair<P>(sqrt(a.Lo), sqrt(a.Hi)); }
+
+	template<typename P>
+	ZetaInline typename PackPair<P>::Mask operator<(const PackPair<P>& a, const PackPair<P>& b) noexcept { return { a.Lo < b.Lo, a.Hi < b.Hi }; }
+	template<typename P>
+	ZetaInline typename PackPair<P>::Mask operator<=(const PackPair<P>& a, const PackPair<P>& b) noexcept { return { a.Lo <= b.Lo, a.Hi <= b.Hi }; }
+	template<typename P>
+	ZetaInline typename PackPair<P>::Mask operator>(const PackPair<P>& a, const PackPair<P>& b) noexcept { return { a.Lo > b.Lo, a.Hi > b.Hi }; }
+	template<typename P>
+	ZetaInline typename PackPair<P>::Mask operator>=(const PackPair<P>& a, const PackPair<P>& b) noexcept { return { a.Lo >= b.Lo, a.Hi >= b.Hi }; }
+
+	template<typename M>
+	ZetaInline MaskPair<M> operator&(const MaskPair<M>& a, const MaskPair<M>& b) noexcept { return { a.Lo & b.Lo, a.Hi & b.Hi }; }
+	template<typename M>
+	ZetaInline MaskPair<M> operator|(const MaskPair<M>& a, const MaskPair<M>& b) noexcept { return { a.Lo | b.Lo, a.Hi | b.Hi }; }
+
+	template<typename P>
+	ZetaInline PackPair<P> select(const typename PackPair<P>::Mask& m, const PackPair<P>& a, const PackPair<P>& b) noexcept
+	{
+		return PackPair<P>(select(m.Lo, a.Lo, b.Lo), select(m.Hi, a.Hi, b.Hi));
+	}
+
+	template<typename M>
+	ZetaInline uint32_t movemask(const MaskPair<M>& m) noexcept
+	{
+		return movemask(m.Lo) | (movemask(m.Hi) << M::Width);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Scalar
+//--------------------------------------------------------------------------------------
+
+namespace ZetaRay::Math::SimdBackend::Scalar
+{
+	template<int N>
+	struct Mask
+	{
+		static constexpr int Width = N;
+
+		bool Lanes[N];
+	};
+
+	template<int N>
+	struct Pack
+	{
+		static constexpr int Width = N;
+		using Mask = Scalar::Mask<N>;
+
+		Pack() noexcept = default;
+		explicit Pack(float f) noexcept
+		{
+			for (int i = 0; i < N; i++)
+				Lanes[i] = f;
+		}
+
+		static ZetaInline Pack load(const float* p) noexcept
+		{
+			Pack ret;
+			for (int i = 0; i < N; i++)
+				ret.Lanes[i] = p[i];
+
+			return ret;
+		}
+
+		ZetaInline void store(float* p) const noexcept
+		{
+			for (int i = 0; i < N; i++)
+				p[i] = Lanes[i];
+		}
+
+		float Lanes[N];
+	};
+
+#define ZETA_SIMD_SCALAR_BINARY_OP(Ret, Name, Expr)						\
+	template<int N>														\
+	ZetaInline Ret Name(const Pack<N>& a, const Pack<N>& b) noexcept	\
+	{																	\
+		Ret ret;														\
+		for (int i = 0; i < N; i++)										\
+		{																\
+			const float x = a.Lanes[i];									\
+			const float y = b.Lanes[i];									\
+			ret.Lanes[i] = Expr;										\
+		}																\
+		return ret;														\
+	}
+
+	ZETA_SIMD_SCALAR_BINARY_OP(Pack<N>, operator+, x + y)
+	ZETA_SIMD_SCALAR_BINARY_OP(Pack<N>, operator-, x - y)
+	ZETA_SIMD_SCALAR_BINARY_OP(Pack<N>, operator*, x * y)
+	ZETA_SIMD_SCALAR_BINARY_OP(Pack<N>, operator/, x / y)
+	ZETA_SIMD_SCALAR_BINARY_OP(Pack<N>, Min, x < y ? x : y)
+	ZETA_SIMD_SCALAR_BINARY_OP(Pack<N>, Max, x > y ? x : y)
+	ZETA_SIMD_SCALAR_BINARY_OP(Mask<N>, operator<, x < y)
+	ZETA_SIMD_SCALAR_BINARY_OP(Mask<N>, operator<=, x <= y)
+	ZETA_SIMD_SCALAR_BINARY_OP(Mask<N>, operator>, x > y)
+	ZETA_SIMD_SCALAR_BINARY_OP(Mask<N>, operator>=, x >= y)
+
+#undef ZETA_SIMD_SCALAR_BINARY_OP
+
+	template<int N>
+	ZetaInline Pack<N> operator-(const Pack<N>& a) noexcept
+	{
+		Pack<N> ret;
+		for (int i = 0; i < N; i++)
+			ret.Lanes[i] = -a.Lanes[i];
+
+		return ret;
+	}
+
+	template<int N>
+	ZetaInline Pack<N> fmadd(const Pack<N>& a, const Pack<N>& b, const Pack<N>& c) noexcept
+	{
+		Pack<N> ret;
+		for (int i = 0; i < N; i++)
+			ret.Lanes[i] = fmaf(a.Lanes[i], b.Lanes[i], c.Lanes[i]);
+
+		return ret;
+	}
+
+	template<int N>
+	ZetaInline Pack<N> abs(const Pack<N>& a) noexcept
+	{
+		Pack<N> ret;
+		for (int i = 0; i < N; i++)
+			ret.Lanes[i] = fabsf(a.Lanes[i]);
+
+		return ret;
+	}
+
+	template<int N>
+	ZetaInline Pack<N> sqrt(const Pack<N>& a) noexcept
+	{
+		Pack<N> ret;
+		for (int i = 0; i < N; i++)
+			ret.Lanes[i] = sqrtf(a.Lanes[i]);
+
+		return ret;
+	}
+
+	template<int N>
+	ZetaInline Mask<N> operator&(const Mask<N>& a, const Mask<N>& b) noexcept
+	{
+		Mask<N> ret;
+		for (int i = 0; i < N; i++)
+			ret.Lanes[i] = a.Lanes[i] && b.Lanes[i];
+
+		return ret;
+	}
+
+	template<int N>
+	ZetaInline Mask<N> operator|(const Mask<N>& a, const Mask<N>& b) noexcept
+	{
+		Mask<N> ret;
+		for (int i = 0; i < N; i++)
+			ret.Lanes[i] = a.Lanes[i] || b.Lanes[i];
+
+		return ret;
+	}
+
+	// Returns a where m is set and b elsewhere
+	template<int N>
+	ZetaInline Pack<N> select(const Mask<N>& m, const Pack<N>& a, const Pack<N>& b) noexcept
+	{
+		Pack<N> ret;
+		for (int i = 0; i < N; i++)
+			ret.Lanes[i] = m.Lanes[i] ? a.Lanes[i] : b.Lanes[i];
+
+		return ret;
+	}
+
+	// Returns a bitmask where bit i is set if lane i of m is set
+	template<int N>
+	ZetaInline uint32_t movemask(const Mask<N>& m) noexcept
+	{
+		uint32_t ret = 0;
+		for (int i = 0; i < N; i++)
+			ret |= uint32_t(m.Lanes[i]) << i;
+
+		return ret;
+	}
+
+	template<typename T, int N>
+	struct Select;
+
+	template<int N>
+	struct Select<float, N>
+	{
+		using Type = Pack<N>;
+	};
+
+	template<typename T, int N>
+	using simd = typename Select<T, N>::Type;
+}
+
+//--------------------------------------------------------------------------------------
+// SSE4
+//--------------------------------------------------------------------------------------
+
+#if defined(ZETA_SIMD_SSE4)
+namespace ZetaRay::Math::SimdBackend::SSE4
+{
+	struct Mask4
+	{
+		static constexpr int Width = 4;
+
+		__m128 V;
+	};
+
+	struct Pack4
+	{
+		static constexpr int Width = 4;
+		using Mask = Mask4;
+
+		Pack4() noexcept = default;
+		Pack4(__m128 v) noexcept
+			: V(v)
+		{}
+		explicit Pack4(float f) noexcept
+			: V(_mm_set1_ps(f))
+		{}
+
+		static ZetaInline Pack4 load(const float* p) noexcept { return _mm_loadu_ps(p); }
+		ZetaInline void store(float* p) const noexcept { _mm_storeu_ps(p, V); }
+
+		__m128 V;
+	};
+
+	ZetaInline Pack4 operator+(Pack4 a, Pack4 b) noexcept { return _mm_add_ps(a.V, b.V); }
+	ZetaInline Pack4 operator-(Pack4 a, Pack4 b) noexcept { return _mm_sub_ps(a.V, b.V); }
+	ZetaInline Pack4 operator*(Pack4 a, Pack4 b) noexcept { return _mm_mul_ps(a.V, b.V); }
+	ZetaInline Pack4 operator/(Pack4 a, Pack4 b) noexcept { return _mm_div_ps(a.V, b.V); }
+	ZetaInline Pack4 operator-(Pack4 a) noexcept { return _mm_xor_ps(a.V, _mm_set1_ps(-0.0f)); }
+
+	ZetaInline Pack4 fmadd(Pack4 a, Pack4 b, Pack4 c) noexcept
+	{
+#if defined(ZETA_SIMD_AVX2)
+		return _mm_fmadd_ps(a.V, b.V, c.V);
+#else
+		return _mm_add_ps(_mm_mul_ps(a.V, b.V), c.V);
+#endif
+	}
+
+	ZetaInline Pack4 Min(Pack4 a, Pack4 b) noexcept { return _mm_min_ps(a.V, b.V); }
+	ZetaInline Pack4 Max(Pack4 a, Pack4 b) noexcept { return _mm_max_ps(a.V, b.V); }
+	ZetaInline Pack4 abs(Pack4 a) noexcept { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.V); }
+	ZetaInline Pack4 sqrt(Pack4 a) noexcept { return _mm_sqrt_ps(a.V); }
+
+	ZetaInline Mask4 operator<(Pack4 a, Pack4 b) noexcept { return { _mm_cmplt_ps(a.V, b.V) }; }
+	ZetaInline Mask4 operator<=(Pack4 a, Pack4 b) noexcept { return { _mm_cmple_ps(a.V, b.V) }; }
+	ZetaInline Mask4 operator>(Pack4 a, Pack4 b) noexcept { return { _mm_cmpgt_ps(a.V, b.V) }; }
+	ZetaInline Mask4 operator>=(Pack4 a, Pack4 b) noexcept { return { _mm_cmpge_ps(a.V, b.V) }; }
+	ZetaInline Mask4 operator&(Mask4 a, Mask4 b) noexcept { return { _mm_and_ps(a.V, b.V) }; }
+	ZetaInline Mask4 operator|(Mask4 a, Mask4 b) noexcept { return { _mm_or_ps(a.V, b.V) }; }
+
+	ZetaInline Pack4 select(Mask4 m, Pack4 a, Pack4 b) noexcept { return _mm_blendv_ps(b.V, a.V, m.V); }
+	ZetaInline uint32_t movemask(Mask4 m) noexcept { return (uint32_t)_mm_movemask_ps(m.V); }
+
+	using Pack8 = Detail::PackPair<Pack4>;
+
+	template<typename T, int N>
+	struct Select;
+
+	template<>
+	struct Select<float, 4>
+	{
+		using Type = Pack4;
+	};
+
+	template<>
+	struct Select<float, 8>
+	{
+		using Type = Pack8;
+	};
+
+	template<typename T, int N>
+	using simd = typename Select<T, N>::Type;
+}
+#endif
+
+//--------------------------------------------------------------------------------------
+// AVX2
+//--------------------------------------------------------------------------------------
+
+#if defined(ZETA_SIMD_AVX2)
+namespace ZetaRay::Math::SimdBackend::AVX2
+{
+	using SSE4::Pack4;
+
+	struct Mask8
+	{
+		static constexpr int Width = 8;
+
+		__m256 V;
+	};
+
+	struct Pack8
+	{
+		static constexpr int Width = 8;
+		using Mask = Mask8;
+
+		Pack8() noexcept = default;
+		Pack8(__m256 v) noexcept
+			: V(v)
+		{}
+		explicit Pack8(float f) noexcept
+			: V(_mm256_set1_ps(f))
+		{}
+
+		static ZetaInline Pack8 load(const float* p) noexcept { return _mm256_loadu_ps(p); }
+		ZetaInline void store(float* p) const noexcept { _mm256_storeu_ps(p, V); }
+
+		__m256 V;
+	};
+
+	ZetaInline Pack8 operator+(Pack8 a, Pack8 b) noexcept { return _mm256_add_ps(a.V, b.V); }
+	ZetaInline Pack8 operator-(Pack8 a, Pack8 b) noexcept { return _mm256_sub_ps(a.V, b.V); }
+	ZetaInline Pack8 operator*(Pack8 a, Pack8 b) noexcept { return _mm256_mul_ps(a.V, b.V); }
+	ZetaInline Pack8 operator/(Pack8 a, Pack8 b) noexcept { return _mm256_div_ps(a.V, b.V); }
+	ZetaInline Pack8 operator-(Pack8 a) noexcept { return _mm256_xor_ps(a.V, _mm256_set1_ps(-0.0f)); }
+
+	ZetaInline Pack8 fmadd(Pack8 a, Pack8 b, Pack8 c) noexcept { return _mm256_fmadd_ps(a.V, b.V, c.V); }
+	ZetaInline Pack8 Min(Pack8 a, Pack8 b) noexcept { return _mm256_min_ps(a.V, b.V); }
+	ZetaInline Pack8 Max(Pack8 a, Pack8 b) noexcept { return _mm256_max_ps(a.V, b.V); }
+	ZetaInline Pack8 abs(Pack8 a) noexcept { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.V); }
+	ZetaInline Pack8 sqrt(Pack8 a) noexcept { return _mm256_sqrt_ps(a.V); }
+
+	ZetaInline Mask8 operator<(Pack8 a, Pack8 b) noexcept { return { _mm256_cmp_ps(a.V, b.V, _CMP_LT_OQ) }; }
+	ZetaInline Mask8 operator<=(Pack8 a, Pack8 b) noexcept { return { _mm256_cmp_ps(a.V, b.V, _CMP_LE_OQ) }; }
+	ZetaInline Mask8 operator>(Pack8 a, Pack8 b) noexcept { return { _mm256_cmp_ps(a.V, b.V, _CMP_GT_OQ) }; }
+	ZetaInline Mask8 operator>=(Pack8 a, Pack8 b) noexcept { return { _mm256_cmp_ps(a.V, b.V, _CMP_GE_OQ) }; }
+	ZetaInline Mask8 operator&(Mask8 a, Mask8 b) noexcept { return { _mm256_and_ps(a.V, b.V) }; }
+	ZetaInline Mask8 operator|(Mask8 a, Mask8 b) noexcept { return { _mm256_or_ps(a.V, b.V) }; }
+
+	ZetaInline Pack8 select(Mask8 m, Pack8 a, Pack8 b) noexcept { return _mm256_blendv_ps(b.V, a.V, m.V); }
+	ZetaInline uint32_t movemask(Mask8 m) noexcept { return (uint32_t)_mm256_movemask_ps(m.V); }
+
+	template<typename T, int N>
+	struct Select;
+
+	template<>
+	struct Select<float, 4>
+	{
+		using Type = Pack4;
+	};
+
+	template<>
+	struct Select<float, 8>
+	{
+		using Type = Pack8;
+	};
+
+	template<typename T, int N>
+	using simd = typename Select<T, N>::Type;
+}
+#endif
+
+//--------------------------------------------------------------------------------------
+// Default backend for the target
+//--------------------------------------------------------------------------------------
+
+namespace ZetaRay::Math
+{
+#if defined(ZETA_SIMD_FORCE_SCALAR)
+	namespace SimdNative = SimdBackend::Scalar;
+#elif defined(ZETA_SIMD_AVX2)
+	namespace SimdNative = SimdBackend::AVX2;
+#elif defined(ZETA_SIMD_SSE4)
+	namespace SimdNative = SimdBackend::SSE4;
+#else
+	namespace SimdNative = SimdBackend::Scalar;
+#endif
+
+	template<typename T, int N>
+	using simd = SimdNative::simd<T, N>;
+
+	template<typename T, int N>
+	using simd_mask = typename simd<T, N>::Mask;
+}
@@ -0,0 +1,418 @@
+#include "SpatialHash.h"
+#include "../Utility/Error.h"
+#include <algorithm>
+#include <bit>
+
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Math;
+
+namespace
+{
+	using V = simd<float, SpatialHash::BLOCK_SIZE>;
+
+	// cell coordinates are stored in 20 bits per axis
+	static constexpr int COORD_BITS = 20;
+	static constexpr int COORD_BIAS = 1 << (COORD_BITS - 1);
+
+	ZetaInline int CellCoord(float v, float oneDivCellSize) noexcept
+	{
+		// instances beyond the representable range end up in the border cells, which doesn't affect
+		// correctness as queries are clamped the same way
+		const float c = floorf(v * oneDivCellSize);
+		return (int)Max(Min(c, (float)(COORD_BIAS - 1)), (float)-COORD_BIAS);
+	}
+
+	ZetaInline uint64_t CellKey(int level, int x, int y, int z) noexcept
+	{
+		uint64_t k = ((uint64_t)level << (3 * COORD_BITS)) |
+			((uint64_t)(x + COORD_BIAS) << (2 * COORD_BITS)) |
+			((uint64_t)(y + COORD_BIAS) << COORD_BITS) |
+			(uint64_t)(z + COORD_BIAS);
+
+		// HashTable expects hashed keys. This is the finalizer of MurmurHash3, which is a bijection,
+		// so different cells never collide.
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdllu;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53llu;
+		k ^= k >> 33;
+
+		return k;
+	}
+
+	// Mask of the first n lanes
+	ZetaInline uint32_t ValidLanes(const uint32_t numInstances, size_t blockIdx) noexcept
+	{
+		const uint32_t n = numInstances - (uint32_t)blockIdx * SpatialHash::BLOCK_SIZE;
+		return n >= SpatialHash::BLOCK_SIZE ? (1u << SpatialHash::BLOCK_SIZE) - 1 : (1u << n) - 1;
+	}
+
+	// Per-lane squared distance from p to the AABBs
+	ZetaInline V DistSqToAABB(const V& px, const V& py, const V& pz, const float* cx, const float* cy,
+		const float* cz, const float* ex, const float* ey, const float* ez) noexcept
+	{
+		const V vZero(0.0f);
+		const V dx = Max(abs(V::load(cx) - px) - V::load(ex), vZero);
+		const V dy = Max(abs(V::load(cy) - py) - V::load(ey), vZero);
+		const V dz = Max(abs(V::load(cz) - pz) - V::load(ez), vZero);
+
+		return fmadd(dx, dx, fmadd(dy, dy, dz * dz));
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// SpatialHash
+//--------------------------------------------------------------------------------------
+
+int SpatialHash::LevelFor(const AABB& box) const noexcept
+{
+	const float size = 2.0f * Max(box.Extents.x, Max(box.Extents.y, box.Extents.z));
+	float cellSize = m_cellSize;
+	int level = 0;
+
+	// instances that are larger than the cells in the last level go in the last level regardless
+	while (level < NUM_LEVELS - 1 && size > cellSize)
+	{
+		cellSize *= 2.0f;
+		level++;
+	}
+
+	return level;
+}
+
+uint64_t SpatialHash::CellKeyFor(int level, const float3& p) const noexcept
+{
+	const float oneDivCellSize = m_oneDivCellSize / (float)(1u << level);
+
+	return CellKey(level, CellCoord(p.x, oneDivCellSize), CellCoord(p.y, oneDivCellSize),
+		CellCoord(p.z, oneDivCellSize));
+}
+
+void SpatialHash::Write(Cell& cell, uint32_t slot, const AABB& box, uint64_t ID) noexcept
+{
+	Block& b = cell.Blocks[slot / BLOCK_SIZE];
+	const uint32_t lane = slot % BLOCK_SIZE;
+
+	b.CenterX[lane] = box.Center.x;
+	b.CenterY[lane] = box.Center.y;
+	b.CenterZ[lane] = box.Center.z;
+	b.ExtentsX[lane] = box.Extents.x;
+	b.ExtentsY[lane] = box.Extents.y;
+	b.ExtentsZ[lane] = box.Extents.z;
+	b.IDs[lane] = ID;
+}
+
+void SpatialHash::Build(Span<BVH::BVHInput> instances) noexcept
+{
+	Clear();
+
+	if (instances.empty())
+		return;
+
+	SmallVector<float> sizes;
+	sizes.resize(instances.size());
+	float3 centerMin(FLT_MAX);
+	float3 centerMax(-FLT_MAX);
+
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		const AABB& box = instances[i].AABB;
+		sizes[i] = 2.0f * Max(box.Extents.x, Max(box.Extents.y, box.Extents.z));
+
+		centerMin.x = Min(centerMin.x, box.Center.x);
+		centerMin.y = Min(centerMin.y, box.Center.y);
+		centerMin.z = Min(centerMin.z, box.Center.z);
+		centerMax.x = Max(centerMax.x, box.Center.x);
+		centerMax.y = Max(centerMax.y, box.Center.y);
+		centerMax.z = Max(centerMax.z, box.Center.z);
+	}
+
+	// Cells should be at least as large as the median instance, so that roughly half of the instances
+	// go in the first level, and large enough to hold about a block of instances on average. Otherwise,
+	// in sparse scenes, queries would spend most of their time looking up empty cells.
+	std::nth_element(sizes.begin(), sizes.begin() + sizes.size() / 2, sizes.end());
+	const float medianSize = Max(sizes[sizes.size() / 2], 1e-3f);
+
+	const float volume = Max(centerMax.x - centerMin.x, medianSize) *
+		Max(centerMax.y - centerMin.y, medianSize) *
+		Max(centerMax.z - centerMin.z, medianSize);
+	const float cellSizeForDensity = cbrtf(volume * BLOCK_SIZE / (float)instances.size());
+
+	m_cellSize = Max(medianSize, cellSizeForDensity);
+	m_oneDivCellSize = 1.0f / m_cellSize;
+
+	m_locations.resize(instances.size());
+
+	for (auto& instance : instances)
+		Insert(instance);
+}
+
+void SpatialHash::Insert(const BVH::BVHInput& instance) noexcept
+{
+	Assert(!m_locations.find(instance.ID), "instance with ID %llu was already inserted.", instance.ID);
+
+	const int level = LevelFor(instance.AABB);
+	const uint64_t key = CellKeyFor(level, instance.AABB.Center);
+
+	Cell* cell = m_cells.find(key);
+	if (!cell)
+	{
+		m_cells.emplace(key, Cell{ .Blocks = SmallVector<Block>(), .NumInstances = 0, .Level = level });
+		cell = m_cells.find(key);
+		m_numCellsPerLevel[level]++;
+	}
+
+	const uint32_t slot = cell->NumInstances++;
+	if (slot % BLOCK_SIZE == 0)
+		cell->Blocks.emplace_back(Block{});
+
+	Write(*cell, slot, instance.AABB, instance.ID);
+	m_locations.insert_or_assign(instance.ID, Location{ .CellKey = key, .Slot = slot, .Level = level });
+
+	const float3& e = instance.AABB.Extents;
+	m_maxExtent[level] = Max(m_maxExtent[level], Max(e.x, Max(e.y, e.z)));
+}
+
+void SpatialHash::Remove(uint64_t ID) noexcept
+{
+	Location* loc = m_locations.find(ID);
+	Assert(loc, "instance with ID %llu was not found.", ID);
+
+	Cell* cell = m_cells.find(loc->CellKey);
+	Assert(cell, "cell was not found.");
+
+	// move the last instance into the removed one's slot
+	const uint32_t last = --cell->NumInstances;
+
+	if (loc->Slot != last)
+	{
+		const Block& src = cell->Blocks[last / BLOCK_SIZE];
+		const uint32_t lane = last % BLOCK_SIZE;
+		const uint64_t movedID = src.IDs[lane];
+		const AABB movedBox(float3(src.CenterX[lane], src.CenterY[lane], src.CenterZ[lane]),
+			float3(src.ExtentsX[lane], src.ExtentsY[lane], src.ExtentsZ[lane]));
+
+		Write(*cell, loc->Slot, movedBox, movedID);
+		m_locations.find(movedID)->Slot = loc->Slot;
+	}
+
+	if (last % BLOCK_SIZE == 0)
+		cell->Blocks.pop_back();
+
+	if (cell->NumInstances == 0)
+	{
+		m_numCellsPerLevel[loc->Level]--;
+		m_cells.erase(loc->CellKey);
+	}
+
+	m_locations.erase(ID);
+}
+
+void SpatialHash::Update(Span<BVH::BVHUpdateInput> instances) noexcept
+{
+	for (auto& instance : instances)
+	{
+		Location* loc = m_locations.find(instance.ID);
+		Assert(loc, "instance with ID %llu was not found.", instance.ID);
+
+		const int level = LevelFor(instance.NewBox);
+		const uint64_t key = CellKeyFor(level, instance.NewBox.Center);
+
+		// most updates are small moves that don't change the cell
+		if (key == loc->CellKey)
+		{
+			Write(*m_cells.find(key), loc->Slot, instance.NewBox, instance.ID);
+
+			const float3& e = instance.NewBox.Extents;
+			m_maxExtent[level] = Max(m_maxExtent[level], Max(e.x, Max(e.y, e.z)));
+
+			continue;
+		}
+
+		Remove(instance.ID);
+		Insert(BVH::BVHInput{ .AABB = instance.NewBox, .ID = instance.ID });
+	}
+}
+
+void SpatialHash::Clear() noexcept
+{
+	m_cells.clear();
+	m_locations.clear();
+
+	for (int i = 0; i < NUM_LEVELS; i++)
+	{
+		m_numCellsPerLevel[i] = 0;
+		m_maxExtent[i] = 0.0f;
+	}
+}
+
+template<typename Func>
+void SpatialHash::ForEachCandidateCell(const AABB& bounds, Func visit) const noexcept
+{
+	if (m_cells.size() == 0)
+		return;
+
+	const float3 qMin = bounds.Center - bounds.Extents;
+	const float3 qMax = bounds.Center + bounds.Extents;
+	uint32_t levelsToScan = 0;
+
+	for (int level = 0; level < NUM_LEVELS; level++)
+	{
+		if (m_numCellsPerLevel[level] == 0)
+			continue;
+
+		// instance centers are at most m_maxExtent away from the query bounds
+		const float oneDivCellSize = m_oneDivCellSize / (float)(1u << level);
+		const float e = m_maxExtent[level];
+
+		const int minX = CellCoord(qMin.x - e, oneDivCellSize);
+		const int minY = CellCoord(qMin.y - e, oneDivCellSize);
+		const int minZ = CellCoord(qMin.z - e, oneDivCellSize);
+		const int maxX = CellCoord(qMax.x + e, oneDivCellSize);
+		const int maxY = CellCoord(qMax.y + e, oneDivCellSize);
+		const int maxZ = CellCoord(qMax.z + e, oneDivCellSize);
+
+		const uint64_t numCandidates = uint64_t(maxX - minX + 1) * uint64_t(maxY - minY + 1) * uint64_t(maxZ - minZ + 1);
+
+		if (numCandidates > m_numCellsPerLevel[level])
+		{
+			levelsToScan |= 1u << level;
+			continue;
+		}
+
+		for (int z = minZ; z <= maxZ; z++)
+		{
+			for (int y = minY; y <= maxY; y++)
+			{
+				for (int x = minX; x <= maxX; x++)
+				{
+					if (const Cell* cell = m_cells.find(CellKey(level, x, y, z)); cell)
+						visit(*cell);
+				}
+			}
+		}
+	}
+
+	if (levelsToScan)
+	{
+		for (auto* it = m_cells.begin_it(); it != m_cells.end_it(); it = m_cells.next_it(it))
+		{
+			if (levelsToScan & (1u << it->Val.Level))
+				visit(it->Val);
+		}
+	}
+}
+
+void SpatialHash::OverlapBox(const AABB& box, Vector<uint64_t>& instanceIDs) const noexcept
+{
+	const V qcx(box.Center.x);
+	const V qcy(box.Center.y);
+	const V qcz(box.Center.z);
+	const V qex(box.Extents.x);
+	const V qey(box.Extents.y);
+	const V qez(box.Extents.z);
+
+	ForEachCandidateCell(box, [&](const Cell& cell)
+		{
+			for (size_t i = 0; i < cell.Blocks.size(); i++)
+			{
+				const Block& b = cell.Blocks[i];
+
+				// separating axis test along each axis
+				const auto vOverlaps = (abs(V::load(b.CenterX) - qcx) <= V::load(b.ExtentsX) + qex) &
+					(abs(V::load(b.CenterY) - qcy) <= V::load(b.ExtentsY) + qey) &
+					(abs(V::load(b.CenterZ) - qcz) <= V::load(b.ExtentsZ) + qez);
+
+				uint32_t mask = movemask(vOverlaps) & ValidLanes(cell.NumInstances, i);
+
+				while (mask)
+				{
+					instanceIDs.push_back(b.IDs[std::countr_zero(mask)]);
+					mask &= mask - 1;
+				}
+			}
+		});
+}
+
+void SpatialHash::OverlapSphere(const float3& center, float radius, Vector<uint64_t>& instanceIDs) const noexcept
+{
+	const V px(center.x);
+	const V py(center.y);
+	const V pz(center.z);
+	const V vRadiusSq(radius * radius);
+
+	ForEachCandidateCell(AABB(center, float3(radius, radius, radius)), [&](const Cell& cell)
+		{
+			for (size_t i = 0; i < cell.Blocks.size(); i++)
+			{
+				const Block& b = cell.Blocks[i];
+				const V vDistSq = DistSqToAABB(px, py, pz, b.CenterX, b.CenterY, b.CenterZ,
+					b.ExtentsX, b.ExtentsY, b.ExtentsZ);
+
+				uint32_t mask = movemask(vDistSq <= vRadiusSq) & ValidLanes(cell.NumInstances, i);
+
+				while (mask)
+				{
+					instanceIDs.push_back(b.IDs[std::countr_zero(mask)]);
+					mask &= mask - 1;
+				}
+			}
+		});
+}
+
+void SpatialHash::FindKNearest(const float3& p, int k, Vector<Neighbor>& neighbors) const noexcept
+{
+	if (k <= 0 || m_locations.size() == 0)
+		return;
+
+	const V px(p.x);
+	const V py(p.y);
+	const V pz(p.z);
+	SmallVector<Neighbor> candidates;
+
+	// grow the search radius until there are at least k instances within it -- the k nearest
+	// are then guaranteed to be among them
+	const size_t numNeeded = Min((size_t)k, m_locations.size());
+	float radius = m_cellSize;
+
+	while (true)
+	{
+		candidates.clear();
+		const V vRadiusSq(radius * radius);
+
+		ForEachCandidateCell(AABB(p, float3(radius, radius, radius)), [&](const Cell& cell)
+			{
+				for (size_t i = 0; i < cell.Blocks.size(); i++)
+				{
+					const Block& b = cell.Blocks[i];
+					const V vDistSq = DistSqToAABB(px, py, pz, b.CenterX, b.CenterY, b.CenterZ,
+						b.ExtentsX, b.ExtentsY, b.ExtentsZ);
+
+					alignas(32) float distSq[BLOCK_SIZE];
+					vDistSq.store(distSq);
+					uint32_t mask = movemask(vDistSq <= vRadiusSq) & ValidLanes(cell.NumInstances, i);
+
+					while (mask)
+					{
+						const int lane = std::countr_zero(mask);
+						candidates.push_back(Neighbor{ .ID = b.IDs[lane], .DistSq = distSq[lane] });
+						mask &= mask - 1;
+					}
+				}
+			});
+
+		if (candidates.size() >= numNeeded || radius == FLT_MAX)
+			break;
+
+		radius = radius < FLT_MAX / 2.0f ? radius * 2.0f : FLT_MAX;
+	}
+
+	const size_t n = Min(numNeeded, candidates.size());
+	std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end(),
+		[](const Neighbor& lhs, const Neighbor& rhs)
+		{
+			return lhs.DistSq < rhs.DistSq;
+		});
+
+	neighbors.append_range(candidates.begin(), candidates.begin() + n);
+}
@@ -0,0 +1,116 @@
+// Hierarchical spatial hash for instance-level proximity queries (box, sphere and k-nearest).
+//
+// It's a loose octree (with a looseness factor of 2) where nodes are addressed by hashing their
+// coordinates rather than through child pointers. Level L is a uniform grid with cells of size
+// CellSize * 2^L and every instance is stored in the smallest level whose cells are at least
+// twice as large as its largest extent, in the cell that contains its center. As instances are
+// never split among cells, insertion, removal and update are O(1), there's no rebalancing and
+// no world bounds that need to be known in advance.
+//
+// Instances of each cell are stored in blocks of simd<float, 8>::Width in structure-of-arrays
+// form, so that overlap tests are done for a whole block at a time.
+//
+// References:
+// 1. T. Ulrich, "Loose Octrees," in Game Programming Gems, 2000.
+// 2. C. Ericson, "Real-time Collision Detection," ch. 7, 2004.
+
+#pragma once
+
+#include "BVH.h"
+#include "Simd.h"
+#include "../Utility/HashTable.h"
+
+namespace ZetaRay::Math
+{
+	class SpatialHash
+	{
+	public:
+		static constexpr int NUM_LEVELS = 16;
+		static constexpr int BLOCK_SIZE = simd<float, 8>::Width;
+
+		struct Neighbor
+		{
+			uint64_t ID;
+			// squared distance from the query point to instance's AABB (zero when inside)
+			float DistSq;
+		};
+
+		SpatialHash() noexcept = default;
+		~SpatialHash() noexcept = default;
+
+		SpatialHash(const SpatialHash&) = delete;
+		SpatialHash& operator=(const SpatialHash&) = delete;
+
+		// Replaces the existing contents. Size of the cells in the first level is chosen based on
+		// the size of given instances.
+		void Build(Util::Span<BVH::BVHInput> instances) noexcept;
+		void Insert(const BVH::BVHInput& instance) noexcept;
+		void Remove(uint64_t ID) noexcept;
+		// Takes the same input as BVH::Update(), so that both can be updated from the same list
+		void Update(Util::Span<BVH::BVHUpdateInput> instances) noexcept;
+		void Clear() noexcept;
+
+		ZetaInline size_t GetNumInstances() const { return m_locations.size(); }
+		ZetaInline float GetCellSize() const { return m_cellSize; }
+
+		//
+		// Queries -- results are appended to the given vector. Queries don't modify the hash, so
+		// any number of them can run concurrently as long as there isn't a concurrent update.
+		//
+
+		// Returns IDs of instances whose AABB overlaps the given AABB
+		void OverlapBox(const AABB& box, Util::Vector<uint64_t>& instanceIDs) const noexcept;
+		// Returns IDs of instances whose AABB overlaps the given sphere
+		void OverlapSphere(const float3& center, float radius, Util::Vector<uint64_t>& instanceIDs) const noexcept;
+		// Returns (at most) k instances whose AABBs are closest to the given point, sorted by distance
+		void FindKNearest(const float3& p, int k, Util::Vector<Neighbor>& neighbors) const noexcept;
+
+	private:
+		struct alignas(32) Block
+		{
+			float CenterX[BLOCK_SIZE];
+			float CenterY[BLOCK_SIZE];
+			float CenterZ[BLOCK_SIZE];
+			float ExtentsX[BLOCK_SIZE];
+			float ExtentsY[BLOCK_SIZE];
+			float ExtentsZ[BLOCK_SIZE];
+			uint64_t IDs[BLOCK_SIZE];
+		};
+
+		struct Cell
+		{
+			// first NumInstances lanes are valid
+			Util::SmallVector<Block> Blocks;
+			uint32_t NumInstances = 0;
+			int Level = 0;
+		};
+
+		struct Location
+		{
+			uint64_t CellKey;
+			uint32_t Slot;
+			int Level;
+		};
+
+		int LevelFor(const AABB& box) const noexcept;
+		uint64_t CellKeyFor(int level, const float3& p) const noexcept;
+
+		// Calls visit(const Cell&) for every cell that may contain instances overlapping the given
+		// AABB. Cells of levels where the range of candidate cells is larger than the number of
+		// occupied cells are found by iterating over all the cells instead.
+		template<typename Func>
+		void ForEachCandidateCell(const AABB& bounds, Func visit) const noexcept;
+
+		void Write(Cell& cell, uint32_t slot, const AABB& box, uint64_t ID) noexcept;
+
+		Util::HashTable<Cell> m_cells;
+		// maps instance ID to where it's stored
+		Util::HashTable<Location> m_locations;
+		uint32_t m_numCellsPerLevel[NUM_LEVELS] = {};
+		// largest extent (along any axis) of instances in each level, i.e. how much cells need to be
+		// expanded by during queries. It's only reset by Build() and Clear().
+		float m_maxExtent[NUM_LEVELS] = {};
+		float m_cellSize = 1.0f;
+		float m_oneDivCellSize = 1.0f;
+	};
+}
@@ -1,112 +1,385 @@
 #include "Surface.h"
+#include "BatchFuncs.h"
 #include "../App/Log.h"
+#include <float.h>
 
 using namespace ZetaRay::Core;
 using namespace ZetaRay::Util;
 using namespace ZetaRay::Math;
 
+namespace
+{
+	using VFloat = simd<float, 8>;
+
+	// Triangle attributes in structure-of-arrays form, one lane per triangle
+	struct TriangleBatch
+	{
+		static constexpr int NUM_COMPONENTS = 3 * 3 + 3 * 3 + 3 * 2;
+
+		alignas(32) float Lanes[NUM_COMPONENTS][VFloat::Width];
+	};
+
+	ZetaInline void GatherVertex(const Vertex& v, TriangleBatch& batch, int corner, int lane) noexcept
+	{
+		float* positions = &batch.Lanes[corner * 3][lane];
+		float* normals = &batch.Lanes[9 + corner * 3][lane];
+		float* uvs = &batch.Lanes[18 + corner * 2][lane];
+		const float3 n(v.Normal);
+
+		positions[0] = v.Position.x;
+		positions[VFloat::Width] = v.Position.y;
+		positions[2 * VFloat::Width] = v.Position.z;
+		normals[0] = n.x;
+		normals[VFloat::Width] = n.y;
+		normals[2 * VFloat::Width] = n.z;
+		uvs[0] = v.TexUV.x;
+		uvs[VFloat::Width] = v.TexUV.y;
+	}
+
+	ZetaInline soa_float3<VFloat> LoadFloat3(const TriangleBatch& batch, int component) noexcept
+	{
+		return soa_float3<VFloat>(VFloat::load(batch.Lanes[component]), VFloat::load(batch.Lanes[component + 1]),
+			VFloat::load(batch.Lanes[component + 2]));
+	}
+
+	ZetaInline soa_float3<VFloat> Subtract(const soa_float3<VFloat>& a, const soa_float3<VFloat>& b) noexcept
+	{
+		return soa_float3<VFloat>(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	ZetaInline soa_float3<VFloat> Scale(const soa_float3<VFloat>& v, const VFloat& s) noexcept
+	{
+		return soa_float3<VFloat>(v.x * s, v.y * s, v.z * s);
+	}
+
+	ZetaInline soa_float3<VFloat> NormalizeOrZero(const soa_float3<VFloat>& v) noexcept
+	{
+		const VFloat vLengthSq = dot(v, v);
+		const VFloat vInvLength = select(vLengthSq > VFloat(FLT_MIN), VFloat(1.0f) / sqrt(vLengthSq), VFloat(0.0f));
+
+		return Scale(v, vInvLength);
+	}
+
+	// Projects v onto the plane with (unit) normal n and normalizes the result
+	ZetaInline soa_float3<VFloat> ProjectOntoPlane(const soa_float3<VFloat>& v, const soa_float3<VFloat>& n) noexcept
+	{
+		const VFloat vNdotV = dot(n, v);
+		return NormalizeOrZero(soa_float3<VFloat>(fmadd(-vNdotV, n.x, v.x), fmadd(-vNdotV, n.y, v.y),
+			fmadd(-vNdotV, n.z, v.z)));
+	}
+
+	// Polynomial approximation of acos() with an absolute error of about 2e-8.
+	// Ref: M. Abramowitz and I. Stegun, Handbook of Mathematical Functions, 4.4.46.
+	ZetaInline VFloat ACos(const VFloat& x) noexcept
+	{
+		const VFloat vAbsX = Min(abs(x), VFloat(1.0f));
+		VFloat vP(-0.0012624911f);
+		vP = fmadd(vP, vAbsX, VFloat(0.0066700901f));
+		vP = fmadd(vP, vAbsX, VFloat(-0.0170881256f));
+		vP = fmadd(vP, vAbsX, VFloat(0.0308918810f));
+		vP = fmadd(vP, vAbsX, VFloat(-0.0501743046f));
+		vP = fmadd(vP, vAbsX, VFloat(0.0889789874f));
+		vP = fmadd(vP, vAbsX, VFloat(-0.2145988016f));
+		vP = fmadd(vP, vAbsX, VFloat(1.5707963050f));
+		vP = vP * sqrt(VFloat(1.0f) - vAbsX);
+
+		// acos(-x) = pi - acos(x)
+		return select(x < VFloat(0.0f), VFloat(PI) - vP, vP);
+	}
+
+	ZetaInline bool Equal(const Vertex& a, const Vertex& b) noexcept
+	{
+		return a.Position.x == b.Position.x && a.Position.y == b.Position.y && a.Position.z == b.Position.z &&
+			a.Normal.x == b.Normal.x && a.Normal.y == b.Normal.y && a.Normal.z == b.Normal.z &&
+			a.TexUV.x == b.TexUV.x && a.TexUV.y == b.TexUV.y;
+	}
+
+	ZetaInline uint32_t Hash(const Vertex& v) noexcept
+	{
+		// +0.0f so that -0 and 0 hash the same
+		const float key[5] = { v.Position.x + 0.0f, v.Position.y + 0.0f, v.Position.z + 0.0f, v.TexUV.x + 0.0f,
+			v.TexUV.y + 0.0f };
+		uint32_t h = v.Normal.x | (uint32_t(v.Normal.y) << 16);
+		h ^= uint32_t(v.Normal.z) * 0x9e3779b1u;
+
+		for (int i = 0; i < 5; i++)
+		{
+			uint32_t k;
+			memcpy(&k, &key[i], sizeof(k));
+
+			// MurmurHash2 mixing
+			k *= 0x5bd1e995u;
+			k ^= k >> 24;
+			k *= 0x5bd1e995u;
+			h = (h * 0x5bd1e995u) ^ k;
+		}
+
+		h ^= h >> 13;
+		h *= 0x5bd1e995u;
+		h ^= h >> 15;
+
+		return h;
+	}
+}
+
 //--------------------------------------------------------------------------------------
-// Surfaces
+// TangentGenerator
 //--------------------------------------------------------------------------------------
 
-void ZetaRay::Math::ComputeMeshTangentVectors(Span<Vertex> vertices, Span<uint32_t> indices, bool rhsIndices) noexcept
+int TangentGenerator::Prepare(Span<Vertex> vertices, Span<uint32_t> indices, bool rhsIndices, bool weld,
+	int maxNumJobs) noexcept
 {
-	float3* tangents = new float3[vertices.size()];
-	memset(tangents, 0, sizeof(float3) * vertices.size());
+	Assert(indices.size() % 3 == 0, "Number of indices must be a multiple of three.");
+	const size_t numVertices = vertices.size();
+	const size_t numTriangles = indices.size() / 3;
+
+	if (numVertices == 0)
+		return 0;
 
-//	for (auto& v : vertices)
-//		v.Tangent = half3(0.0f, 0.0f, 0.0f);
+	m_remap.resize(numVertices);
+
+	if (weld)
+	{
+		// open addressing with linear probing -- maps every vertex to the first one that's identical to it
+		size_t tableSize = 1;
+		while (tableSize < numVertices + numVertices / 2)
+			tableSize <<= 1;
+
+		SmallVector<uint32_t> table;
+		table.resize(tableSize, UINT32_MAX);
+
+		for (uint32_t v = 0; v < (uint32_t)numVertices; v++)
+		{
+			size_t slot = Hash(vertices[v]) & (tableSize - 1);
 
-	// Given triangle with vertices v0, v1, v2 (in clockwise order) and corresponding texture coords
+			while (table[slot] != UINT32_MAX && !Equal(vertices[table[slot]], vertices[v]))
+				slot = (slot + 1) & (tableSize - 1);
+
+			if (table[slot] == UINT32_MAX)
+				table[slot] = v;
+
+			m_remap[v] = table[slot];
+		}
+	}
+	else
+	{
+		for (uint32_t v = 0; v < (uint32_t)numVertices; v++)
+			m_remap[v] = v;
+	}
+
+	// corner c is vertex (c % 3) of triangle c / 3, after accounting for the winding order
+	auto cornerVertex = [indices, rhsIndices](size_t c)
+		{
+			const size_t k = c % 3;
+			return indices[c - k + (rhsIndices && k ? 3 - k : k)];
+		};
+
+	m_cornerOffsets.resize(numVertices + 1);
+	memset(m_cornerOffsets.data(), 0, sizeof(uint32_t) * (numVertices + 1));
+
+	for (size_t c = 0; c < indices.size(); c++)
+	{
+		Assert(indices[c] < numVertices, "Invalid vertex index.");
+		m_cornerOffsets[m_remap[indices[c]] + 1]++;
+	}
+
+	for (size_t v = 0; v < numVertices; v++)
+		m_cornerOffsets[v + 1] += m_cornerOffsets[v];
+
+	m_corners.resize(indices.size());
+
+	{
+		SmallVector<uint32_t> next;
+		next.resize(numVertices);
+		memcpy(next.data(), m_cornerOffsets.data(), sizeof(uint32_t) * numVertices);
+
+		for (size_t c = 0; c < indices.size(); c++)
+			m_corners[next[m_remap[cornerVertex(c)]]++] = (uint32_t)c;
+	}
+
+	m_cornerTangents.resize(indices.size());
+
+	const int numJobs = (int)Math::Min((size_t)Math::Min(maxNumJobs, MAX_NUM_JOBS),
+		Math::Max(numTriangles / MIN_TRIANGLES_PER_JOB, (size_t)1));
+
+	// contiguous ranges with roughly the same number of triangles and vertices respectively
+	for (int i = 0; i < numJobs; i++)
+	{
+		m_triJobOffsets[i] = i * numTriangles / numJobs;
+		m_triJobSizes[i] = (i + 1) * numTriangles / numJobs - m_triJobOffsets[i];
+		m_vtxJobOffsets[i] = i * numVertices / numJobs;
+		m_vtxJobSizes[i] = (i + 1) * numVertices / numJobs - m_vtxJobOffsets[i];
+		m_numDegenerate[i] = 0;
+	}
+
+	return numJobs;
+}
+
+void TangentGenerator::CornerRange(Span<Vertex> vertices, Span<uint32_t> indices, bool rhsIndices, int jobIdx,
+	size_t beg, size_t n) noexcept
+{
+	// Given triangle with vertices p0, p1, p2 (in clockwise order) and corresponding texture coords
 	// (u0, v0), (u1, v1) and (u2, v2) we have:
-	// 
+	//
 	//    p1 - p0 = (u1 - u0) * T + (v1 - v0) * B
 	//    p2 - p0 = (u2 - u0) * T + (v2 - v0) * B
 	//
-	// In matrix form:
-	// 
-	//		   [ u1 - u0  u2 - u0 ]
-	// [T B] * |                  | = [p1 - p0  p2 - p0]
-	//		   [ v1 - v0  v2 - v0 ]
+	// Solving for T gives:
 	//
-	// This linear system is solved with:
-	// 
-	// |     |			  |                  |                                    
-	// | T B | = 1 / D	* | p1 - p0  p2 - p0 |  *  | v2 - v0  u0 - u2 |
-	// |     |			  |                  |     | v0 - v1  u1 - u0 |           
+	//    T = ((v2 - v0) * (p1 - p0) - (v1 - v0) * (p2 - p0)) / D
 	//
-	// where D = (u1 - u0) * (v2 - v0) - (u2 - u0) * (v1 - v0)
-
-	uint32_t numCollinearTris = 0;
+	// where D = (u1 - u0) * (v2 - v0) - (u2 - u0) * (v1 - v0). Sign of D gives the handedness of
+	// texture space.
+	TriangleBatch batch;
+	alignas(32) float out[4][3][VFloat::Width];
+	uint32_t numDegenerate = 0;
 
-	for (size_t i = 0; i < indices.size(); i += 3)
+	for (size_t base = beg; base < beg + n; base += VFloat::Width)
 	{
-		uint32_t i0 = indices[i];
-		uint32_t i1 = indices[i + 1];
-		uint32_t i2 = indices[i + 2];
+		const int batchSize = (int)Math::Min(beg + n - base, (size_t)VFloat::Width);
 
-		// swap i1 & i2
-		if (rhsIndices)
+		for (int lane = 0; lane < VFloat::Width; lane++)
 		{
-			uint32_t temp = i1;
-			i1 = i2;
-			i2 = temp;
+			// unused lanes of the last batch are degenerate
+			if (lane >= batchSize)
+			{
+				for (int c = 0; c < TriangleBatch::NUM_COMPONENTS; c++)
+					batch.Lanes[c][lane] = 0.0f;
+
+				continue;
+			}
+
+			const size_t t = base + lane;
+			const uint32_t i0 = indices[t * 3];
+			const uint32_t i1 = indices[t * 3 + (rhsIndices ? 2 : 1)];
+			const uint32_t i2 = indices[t * 3 + (rhsIndices ? 1 : 2)];
+
+			GatherVertex(vertices[i0], batch, 0, lane);
+			GatherVertex(vertices[i1], batch, 1, lane);
+			GatherVertex(vertices[i2], batch, 2, lane);
 		}
 
-		float2 uv0 = vertices[i0].TexUV;
-		float3 pos0 = vertices[i0].Position;
+		const soa_float3<VFloat> vP[3] = { LoadFloat3(batch, 0), LoadFloat3(batch, 3), LoadFloat3(batch, 6) };
+		const VFloat vU0 = VFloat::load(batch.Lanes[18]);
+		const VFloat vV0 = VFloat::load(batch.Lanes[19]);
+		const VFloat vU10 = VFloat::load(batch.Lanes[20]) - vU0;
+		const VFloat vV10 = VFloat::load(batch.Lanes[21]) - vV0;
+		const VFloat vU20 = VFloat::load(batch.Lanes[22]) - vU0;
+		const VFloat vV20 = VFloat::load(batch.Lanes[23]) - vV0;
 
-		float2 uv1 = vertices[i1].TexUV;
-		float3 pos1 = vertices[i1].Position;
+		const soa_float3<VFloat> vE10 = Subtract(vP[1], vP[0]);
+		const soa_float3<VFloat> vE20 = Subtract(vP[2], vP[0]);
+		const VFloat vDet = vU10 * vV20 - vU20 * vV10;
+		const soa_float3<VFloat> vT(vV20 * vE10.x - vV10 * vE20.x, vV20 * vE10.y - vV10 * vE20.y,
+			vV20 * vE10.z - vV10 * vE20.z);
 
-		float2 uv2 = vertices[i2].TexUV;
-		float3 pos2 = vertices[i2].Position;
+		// triangles with zero area in either position or texture space don't contribute
+		const soa_float3<VFloat> vN = cross(vE10, vE20);
+		const auto vValid = (abs(vDet) > VFloat(FLT_MIN)) & (dot(vT, vT) > VFloat(FLT_MIN)) &
+			(dot(vN, vN) > VFloat(FLT_MIN));
+		const uint32_t validMask = movemask(vValid);
 
-		float2 uv1Minuv0 = uv1 - uv0;
-		float2 uv2Minuv0 = uv2 - uv0;
+		const VFloat vSign = select(vDet > VFloat(0.0f), VFloat(1.0f), VFloat(-1.0f));
 
-		float det = uv1Minuv0.x * uv2Minuv0.y - uv1Minuv0.y * uv2Minuv0.x;
-		if (det == 0)
+		for (int k = 0; k < 3; k++)
 		{
-			numCollinearTris++;
-			continue;
-		}
+			const soa_float3<VFloat> vNormal = NormalizeOrZero(LoadFloat3(batch, 9 + k * 3));
+			const soa_float3<VFloat> vTangent = ProjectOntoPlane(vT, vNormal);
 
-		float oneDivDet = 1.0f / det;
+			// angle between the (projected) edges that meet at this corner
+			const soa_float3<VFloat> vEdge0 = ProjectOntoPlane(Subtract(vP[(k + 1) % 3], vP[k]), vNormal);
+			const soa_float3<VFloat> vEdge1 = ProjectOntoPlane(Subtract(vP[(k + 2) % 3], vP[k]), vNormal);
+			VFloat vAngle = ACos(Max(Min(dot(vEdge0, vEdge1), VFloat(1.0f)), VFloat(-1.0f)));
+			vAngle = select(vValid, vAngle, VFloat(0.0f));
 
-		float3 p1Minp0 = pos1 - pos0;
-		float3 p2Minp0 = pos2 - pos0;
-
-		float3 T(p1Minp0.x * uv2Minuv0.y + p2Minp0.x * -uv1Minuv0.y,
-				 p1Minp0.y * uv2Minuv0.y + p2Minp0.y * -uv1Minuv0.y,
-				 p1Minp0.z * uv2Minuv0.y + p2Minp0.z * -uv1Minuv0.y);
+			// unnormalized T points in the opposite direction when D < 0
+			const VFloat vWeight = vAngle * vSign;
+			vWeight.store(out[3][k]);
+			(vTangent.x * vWeight).store(out[0][k]);
+			(vTangent.y * vWeight).store(out[1][k]);
+			(vTangent.z * vWeight).store(out[2][k]);
+		}
 
-		T *= oneDivDet;
+		for (int lane = 0; lane < batchSize; lane++)
+		{
+			numDegenerate += (validMask & (1u << lane)) == 0;
 
-		tangents[i0] += T;
-		tangents[i1] += T;
-		tangents[i2] += T;
+			for (int k = 0; k < 3; k++)
+			{
+				m_cornerTangents[(base + lane) * 3 + k] = float4(out[0][k][lane], out[1][k][lane],
+					out[2][k][lane], out[3][k][lane]);
+			}
+		}
 	}
 
-	// GramSchmidt Orthonormalization
-	// assumes vertex normala are normalized
-	for(size_t i = 0; i < vertices.size(); i++)
+	m_numDegenerate[jobIdx] = numDegenerate;
+}
+
+void TangentGenerator::VertexRange(Span<Vertex> vertices, size_t beg, size_t n) noexcept
+{
+	for (size_t v = beg; v < beg + n; v++)
 	{
-		float3 n = float3(vertices[i].Normal);
-		float3 tangProjectedOnNormal = n.dot(tangents[i]) * n;
-		tangents[i] -= tangProjectedOnNormal;
-		tangents[i].normalize();
+		const uint32_t w = m_remap[v];
+		float3 tangents[2] = { float3(0.0f), float3(0.0f) };
+		float weights[2] = { 0.0f, 0.0f };
 
-		vertices[i].Tangent = half3(tangents[i]);
+		for (uint32_t c = m_cornerOffsets[w]; c < m_cornerOffsets[w + 1]; c++)
+		{
+			const float4& t = m_cornerTangents[m_corners[c]];
+			const int handedness = t.w < 0.0f;
+
+			tangents[handedness] += float3(t.x, t.y, t.z);
+			weights[handedness] += fabsf(t.w);
+		}
+
+		float3 tangent = weights[1] > weights[0] ? tangents[1] : tangents[0];
+		const float lengthSq = tangent.dot(tangent);
+
+		if (lengthSq > FLT_MIN)
+			tangent = tangent * (1.0f / sqrtf(lengthSq));
+		else
+		{
+			// no usable triangles -- any direction that's orthogonal to the normal
+			float3 normal(vertices[v].Normal);
+			const float3 axis = fabsf(normal.x) < 0.9f ? float3(1.0f, 0.0f, 0.0f) : float3(0.0f, 1.0f, 0.0f);
+			tangent = axis - normal.dot(axis) * normal;
+			tangent.normalize();
+		}
+
+		vertices[v].Tangent = half3(tangent);
 	}
+}
+
+void TangentGenerator::Finish(int numJobs, size_t numTriangles) noexcept
+{
+	uint32_t numDegenerate = 0;
+	for (int i = 0; i < numJobs; i++)
+		numDegenerate += m_numDegenerate[i];
 
-	if (numCollinearTris)
+	if (numDegenerate)
 	{
-		LOG_UI_WARNING("Mesh had %u/%u collinear triangles, vertex tangents might be missing.\n",
-			numCollinearTris, (uint32_t)indices.size() / 3);
+		LOG_UI_WARNING("Mesh had %u/%u degenerate triangles, vertex tangents might be missing.\n",
+			numDegenerate, (uint32_t)numTriangles);
 	}
+}
 
-	delete[] tangents;
+void TangentGenerator::Clear() noexcept
+{
+	m_remap.free_memory();
+	m_cornerOffsets.free_memory();
+	m_corners.free_memory();
+	m_cornerTangents.free_memory();
+}
+
+//--------------------------------------------------------------------------------------
+// Surfaces
+//--------------------------------------------------------------------------------------
+
+void ZetaRay::Math::ComputeMeshTangentVectors(Span<Vertex> vertices, Span<uint32_t> indices, bool rhsIndices,
+	bool weld) noexcept
+{
+	TangentGenerator generator;
+	generator.Generate(vertices, indices, rhsIndices, weld);
 }
 
 //void Math::MergeBoundingBoxes(BoundingBox& out, const BoundingBox& b1, const BoundingBox& b2) noexcept
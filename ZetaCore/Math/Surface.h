@@ -3,16 +3,117 @@
 #include "Common.h"
 #include "../Core/Vertex.h"
 #include "../Utility/Span.h"
+#include "../Utility/SmallVector.h"
+#include "../Support/Executor.h"
 
 namespace ZetaRay::Math
 {
+	//--------------------------------------------------------------------------------------
+	// TangentGenerator
+	//--------------------------------------------------------------------------------------
+
+	// Computes vertex tangents the same way as MikkTSpace [1], which is the tangent space that normal
+	// maps are commonly baked in. Texture-space tangent of every triangle is projected onto the tangent
+	// plane of each of its corners, normalized and weighted by the angle of that corner; tangent of a
+	// vertex is then the normalized sum over all of its corners. When welding is enabled, vertices with
+	// the same position, normal and texture coordinates are treated as one so that they end up with the
+	// same tangent.
+	//
+	// Differences from MikkTSpace: vertices aren't split, so when corners of a vertex disagree on the
+	// handedness of texture space (mirrored UVs), only the corners with the dominant handedness (by angle)
+	// are used. Handedness isn't output either as Vertex has no room for it.
+	//
+	// Work is done in two passes: corners are processed simd<float, 8>::Width triangles at a time, after
+	// which every vertex gathers the corners that refer to it. Each pass can be split into independent
+	// jobs over triangles and vertices respectively.
+	//
+	// 1. M. Mikkelsen, "Simulation of Wrinkled Surfaces Revisited," Master's thesis, University of Copenhagen, 2008.
+	class TangentGenerator
+	{
+	public:
+		static constexpr int MAX_NUM_JOBS = 16;
+		// passes are split so that no job gets fewer triangles than this
+		static constexpr size_t MIN_TRIANGLES_PER_JOB = 8192;
+
+		TangentGenerator() noexcept = default;
+		~TangentGenerator() noexcept = default;
+
+		TangentGenerator(const TangentGenerator&) = delete;
+		TangentGenerator& operator=(const TangentGenerator&) = delete;
+
+		// rhsIndices indicates that triangles are ordered counter-clockwise
+		void Generate(Util::Span<Core::Vertex> vertices, Util::Span<uint32_t> indices, bool rhsIndices = false,
+			bool weld = true) noexcept
+		{
+			Generate(vertices, indices, rhsIndices, weld, Support::SerialExecutor());
+		}
+
+		// Same as above, but the two passes are consecutive stages of the given executor (see 
+		// Support/Executor.h)
+		template<typename Executor>
+		void Generate(Util::Span<Core::Vertex> vertices, Util::Span<uint32_t> indices, bool rhsIndices, bool weld,
+			Executor&& executor) noexcept
+		{
+			const int numJobs = Prepare(vertices, indices, rhsIndices, weld, executor.MaxNumJobs());
+
+			if (numJobs == 1)
+			{
+				CornerRange(vertices, indices, rhsIndices, 0, 0, indices.size() / 3);
+				VertexRange(vertices, 0, vertices.size());
+			}
+			else if (numJobs > 1)
+			{
+				// a vertex can gather corners that were written by any of the jobs in the first pass
+				executor.Stages(2, [numJobs](int)
+					{
+						return numJobs;
+					},
+					[this, vertices, indices, rhsIndices](int pass, int jobIdx)
+					{
+						if (pass == 0)
+							CornerRange(vertices, indices, rhsIndices, jobIdx, m_triJobOffsets[jobIdx], m_triJobSizes[jobIdx]);
+						else
+							VertexRange(vertices, m_vtxJobOffsets[jobIdx], m_vtxJobSizes[jobIdx]);
+					});
+			}
+
+			Finish(numJobs, indices.size() / 3);
+		}
+
+		void Clear() noexcept;
+
+	private:
+		// Returns the number of jobs
+		int Prepare(Util::Span<Core::Vertex> vertices, Util::Span<uint32_t> indices, bool rhsIndices, bool weld,
+			int maxNumJobs) noexcept;
+		void CornerRange(Util::Span<Core::Vertex> vertices, Util::Span<uint32_t> indices, bool rhsIndices, int jobIdx,
+			size_t beg, size_t n) noexcept;
+		void VertexRange(Util::Span<Core::Vertex> vertices, size_t beg, size_t n) noexcept;
+		void Finish(int numJobs, size_t numTriangles) noexcept;
+
+		// first vertex that's identical to each vertex (itself when welding is disabled)
+		Util::SmallVector<uint32_t> m_remap;
+		// corners of every welded vertex, in compressed sparse row form
+		Util::SmallVector<uint32_t> m_cornerOffsets;
+		Util::SmallVector<uint32_t> m_corners;
+		// xyz is the weighted tangent of every corner and w the angle weight, negated when texture
+		// space has negative handedness (D < 0). Zero for degenerate triangles.
+		Util::SmallVector<float4> m_cornerTangents;
+		size_t m_triJobOffsets[MAX_NUM_JOBS];
+		size_t m_triJobSizes[MAX_NUM_JOBS];
+		size_t m_vtxJobOffsets[MAX_NUM_JOBS];
+		size_t m_vtxJobSizes[MAX_NUM_JOBS];
+		uint32_t m_numDegenerate[MAX_NUM_JOBS];
+	};
+
+	// Shorthand for TangentGenerator::Generate()
 	void ComputeMeshTangentVectors(Util::Span<Core::Vertex> vertices, Util::Span<uint32_t> indices,
-		bool rhsIndices = false) noexcept;
+		bool rhsIndices = false, bool weld = true) noexcept;
 
 	// Returns barrycentric coordinates (u, v, w) of point p relative to triangle v0v1v2 (ordered clockwise)
 	// such that p = V0 + v(V1 - V0) + w(V2 - V0) or alternatively,
 	//           p = uV0 + vV1 + wV2
-	ZetaInline __m128 __vectorcall computeBarryCoords(const __m128 v0, const __m128 v1, const __m128 v2, const __m128 p) noexcept
+	ZetaInline __m128 ZETA_VECTORCALL computeBarryCoords(const __m128 v0, const __m128 v1, const __m128 v2, const __m128 p) noexcept
 	{
 		const __m128 v1Minv0 = _mm_sub_ps(v1, v0);	// s
 		const __m128 v2Minv0 = _mm_sub_ps(v2, v0);	// t
@@ -0,0 +1,447 @@
+#include "AccessorDecoder.h"
+#include "../Utility/Error.h"
+#include <immintrin.h>
+#include <cstddef>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Model::glTF;
+
+namespace
+{
+	static constexpr int BATCH_SIZE = 8;
+
+	constexpr uint32_t ComponentSize(ACCESSOR_COMPONENT_TYPE t) noexcept
+	{
+		switch (t)
+		{
+		case ACCESSOR_COMPONENT_TYPE::INT8:
+		case ACCESSOR_COMPONENT_TYPE::UINT8:
+			return 1;
+		case ACCESSOR_COMPONENT_TYPE::INT16:
+		case ACCESSOR_COMPONENT_TYPE::UINT16:
+			return 2;
+		default:
+			return 4;
+		}
+	}
+
+	ZetaInline float ReadComponent(const uint8_t* p, ACCESSOR_COMPONENT_TYPE t, bool normalized) noexcept
+	{
+		switch (t)
+		{
+		case ACCESSOR_COMPONENT_TYPE::INT8:
+		{
+			int8_t v;
+			memcpy(&v, p, sizeof(v));
+			return normalized ? Math::Max(v / 127.0f, -1.0f) : (float)v;
+		}
+		case ACCESSOR_COMPONENT_TYPE::UINT8:
+			return normalized ? *p / 255.0f : (float)*p;
+		case ACCESSOR_COMPONENT_TYPE::INT16:
+		{
+			int16_t v;
+			memcpy(&v, p, sizeof(v));
+			return normalized ? Math::Max(v / 32767.0f, -1.0f) : (float)v;
+		}
+		case ACCESSOR_COMPONENT_TYPE::UINT16:
+		{
+			uint16_t v;
+			memcpy(&v, p, sizeof(v));
+			return normalized ? v / 65535.0f : (float)v;
+		}
+		default:
+		{
+			float v;
+			memcpy(&v, p, sizeof(v));
+			return v;
+		}
+		}
+	}
+
+	// Number of bytes that are read from the start of every element -- four components are always 
+	// loaded, regardless of how many there are
+	constexpr uint32_t RowSize(ACCESSOR_COMPONENT_TYPE t) noexcept
+	{
+		return 4 * ComponentSize(t);
+	}
+
+	// Number of elements whose rows can be loaded without reading past the end
+	ZetaInline size_t NumFullRows(const AccessorView& accessor, int numComponents) noexcept
+	{
+		const uint32_t compSize = ComponentSize(accessor.ComponentType);
+		const size_t endByte = (accessor.Count - 1) * accessor.Stride + compSize * numComponents;
+
+		return endByte >= RowSize(accessor.ComponentType) ?
+			Math::Min(accessor.Count, (endByte - RowSize(accessor.ComponentType)) / accessor.Stride + 1) : 0;
+	}
+
+	// Loads the first four components of an element and converts them to float
+	template<ACCESSOR_COMPONENT_TYPE T, bool Normalized>
+	ZetaInline __m128 LoadRow(const uint8_t* p) noexcept
+	{
+		if constexpr (T == ACCESSOR_COMPONENT_TYPE::FLOAT32)
+			return _mm_loadu_ps(reinterpret_cast<const float*>(p));
+		else
+		{
+			__m128i vRow;
+			float scale;
+
+			if constexpr (T == ACCESSOR_COMPONENT_TYPE::INT8)
+			{
+				vRow = _mm_cvtepi8_epi32(_mm_loadu_si32(p));
+				scale = 1.0f / 127.0f;
+			}
+			else if constexpr (T == ACCESSOR_COMPONENT_TYPE::UINT8)
+			{
+				vRow = _mm_cvtepu8_epi32(_mm_loadu_si32(p));
+				scale = 1.0f / 255.0f;
+			}
+			else if constexpr (T == ACCESSOR_COMPONENT_TYPE::INT16)
+			{
+				vRow = _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+				scale = 1.0f / 32767.0f;
+			}
+			else
+			{
+				vRow = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+				scale = 1.0f / 65535.0f;
+			}
+
+			__m128 vF = _mm_cvtepi32_ps(vRow);
+
+			if constexpr (Normalized)
+			{
+				vF = _mm_mul_ps(vF, _mm_set1_ps(scale));
+
+				// both -128 and -127 map to -1
+				if constexpr (T == ACCESSOR_COMPONENT_TYPE::INT8 || T == ACCESSOR_COMPONENT_TYPE::INT16)
+					vF = _mm_max_ps(vF, _mm_set1_ps(-1.0f));
+			}
+
+			return vF;
+		}
+	}
+
+	template<ACCESSOR_COMPONENT_TYPE T, bool Normalized, typename Func>
+	ZetaInline void ForEachFullRow(const uint8_t* data, size_t n, size_t stride, Func& emit) noexcept
+	{
+		for (size_t i = 0; i < n; i++)
+			emit(i, LoadRow<T, Normalized>(data + i * stride));
+	}
+
+	template<ACCESSOR_COMPONENT_TYPE T, typename Func>
+	ZetaInline void ForEachFullRow(const AccessorView& accessor, size_t n, Func& emit) noexcept
+	{
+		if (accessor.Normalized)
+			ForEachFullRow<T, true>(accessor.Data, n, accessor.Stride, emit);
+		else
+			ForEachFullRow<T, false>(accessor.Data, n, accessor.Stride, emit);
+	}
+
+	// Calls emit(element index, row) for every element, where row holds its first NumComponents 
+	// components (converted to float) and the rest are undefined
+	template<int NumComponents, typename Func>
+	void ForEachRow(const AccessorView& accessor, Func emit) noexcept
+	{
+		Assert(accessor.ComponentType != ACCESSOR_COMPONENT_TYPE::UINT32, "32-bit integer attributes are not supported.");
+
+		const uint32_t compSize = ComponentSize(accessor.ComponentType);
+		Assert(accessor.Stride >= compSize * NumComponents, "Stride is smaller than element size.");
+
+		if (accessor.Count == 0)
+			return;
+
+		const size_t numFullRows = NumFullRows(accessor, NumComponents);
+
+		switch (accessor.ComponentType)
+		{
+		case ACCESSOR_COMPONENT_TYPE::INT8:
+			ForEachFullRow<ACCESSOR_COMPONENT_TYPE::INT8>(accessor, numFullRows, emit);
+			break;
+		case ACCESSOR_COMPONENT_TYPE::UINT8:
+			ForEachFullRow<ACCESSOR_COMPONENT_TYPE::UINT8>(accessor, numFullRows, emit);
+			break;
+		case ACCESSOR_COMPONENT_TYPE::INT16:
+			ForEachFullRow<ACCESSOR_COMPONENT_TYPE::INT16>(accessor, numFullRows, emit);
+			break;
+		case ACCESSOR_COMPONENT_TYPE::UINT16:
+			ForEachFullRow<ACCESSOR_COMPONENT_TYPE::UINT16>(accessor, numFullRows, emit);
+			break;
+		default:
+			ForEachFullRow<ACCESSOR_COMPONENT_TYPE::FLOAT32>(accessor, numFullRows, emit);
+		}
+
+		// rows of the last few elements would extend past the end of the data
+		for (size_t i = numFullRows; i < accessor.Count; i++)
+		{
+			const uint8_t* p = accessor.Data + i * accessor.Stride;
+			alignas(16) float comps[4] = {};
+
+			for (int c = 0; c < NumComponents; c++)
+				comps[c] = ReadComponent(p + c * compSize, accessor.ComponentType, accessor.Normalized);
+
+			emit(i, _mm_load_ps(comps));
+		}
+	}
+
+	// glTF uses a right-handed coordinate system with +Y as up
+	ZetaInline __m128 FlipZ(__m128 v) noexcept
+	{
+		return _mm_xor_ps(v, _mm_setr_ps(0.0f, 0.0f, -0.0f, 0.0f));
+	}
+
+	ZetaInline void StoreHalf3(__m128 v, half3& h) noexcept
+	{
+		const __m128i vH = _mm_cvtps_ph(v, 0);
+		const uint32_t xy = (uint32_t)_mm_cvtsi128_si32(vH);
+
+		h.x = (uint16_t)xy;
+		h.y = (uint16_t)(xy >> 16);
+		h.z = (uint16_t)_mm_extract_epi16(vH, 2);
+	}
+
+	ZetaInline void StorePosition(__m128 v, float3& pos) noexcept
+	{
+		_mm_storel_pi(reinterpret_cast<__m64*>(&pos), v);
+		_mm_store_ss(&pos.z, _mm_movehl_ps(v, v));
+	}
+
+	ZetaInline AccessorView SubView(const AccessorView& accessor, size_t first, size_t count) noexcept
+	{
+		return AccessorView{ .Data = accessor.Data + first * accessor.Stride,
+			.Count = count,
+			.Stride = accessor.Stride,
+			.ComponentType = accessor.ComponentType,
+			.Normalized = accessor.Normalized };
+	}
+
+	// All the attributes are floats, so every vertex can be decoded in one go. Normal and tangent are
+	// converted to half precision together and every vertex is assembled in registers and written 
+	// with three stores (including the padding). Returns number of vertices that were decoded.
+	template<bool HasTexCoord, bool HasTangent>
+	size_t DecodeFloatVertices(const VertexAccessors& accessors, Vertex* vertices) noexcept
+	{
+		static_assert(offsetof(Vertex, Normal) == 12 && offsetof(Vertex, TexUV) == 20 &&
+			offsetof(Vertex, Tangent) == 28 && sizeof(Vertex) == 36, "Vertex layout has changed.");
+
+		size_t n = Math::Min(NumFullRows(accessors.Position, 3), NumFullRows(accessors.Normal, 3));
+		if constexpr (HasTexCoord)
+			n = Math::Min(n, NumFullRows(accessors.TexCoord, 2));
+		if constexpr (HasTangent)
+			n = Math::Min(n, NumFullRows(accessors.Tangent, 3));
+
+		const uint8_t* pos = accessors.Position.Data;
+		const uint8_t* normal = accessors.Normal.Data;
+		const uint8_t* uv = accessors.TexCoord.Data;
+		const uint8_t* tangent = accessors.Tangent.Data;
+		const size_t posStride = accessors.Position.Stride;
+		const size_t normalStride = accessors.Normal.Stride;
+		const size_t uvStride = HasTexCoord ? accessors.TexCoord.Stride : 0;
+		const size_t tangentStride = HasTangent ? accessors.Tangent.Stride : 0;
+		const __m256 vFlipZ = _mm256_setr_ps(0.0f, 0.0f, -0.0f, 0.0f, 0.0f, 0.0f, -0.0f, 0.0f);
+		uint8_t* dst = reinterpret_cast<uint8_t*>(vertices);
+
+		for (size_t i = 0; i < n; i++, dst += sizeof(Vertex))
+		{
+			const __m128 vPos = FlipZ(_mm_loadu_ps(reinterpret_cast<const float*>(pos + i * posStride)));
+			const __m128 vN = _mm_loadu_ps(reinterpret_cast<const float*>(normal + i * normalStride));
+			const __m128 vT = HasTangent ? _mm_loadu_ps(reinterpret_cast<const float*>(tangent + i * tangentStride)) :
+				_mm_setzero_ps();
+			const __m128 vUV = HasTexCoord ? _mm_loadu_ps(reinterpret_cast<const float*>(uv + i * uvStride)) :
+				_mm_setzero_ps();
+
+			// 32-bit lanes are (normal.xy, normal.zw, tangent.xy, tangent.zw)
+			const __m256 vNT = _mm256_xor_ps(_mm256_insertf128_ps(_mm256_castps128_ps256(vN), vT, 1), vFlipZ);
+			const __m128 vH = _mm_castsi128_ps(_mm256_cvtps_ph(vNT, 0));
+
+			// (position.xyz, normal.xy)
+			const __m128 vLo = _mm_blend_ps(vPos, _mm_permute_ps(vH, 0), 0x8);
+			// (normal.z, uv, tangent.xy)
+			const __m128 vHi = _mm_blend_ps(_mm_permute_ps(vH, 0x81), _mm_permute_ps(vUV, 0x10), 0x6);
+
+			_mm_storeu_ps(reinterpret_cast<float*>(dst), vLo);
+			_mm_storeu_ps(reinterpret_cast<float*>(dst + 16), vHi);
+			_mm_store_ss(reinterpret_cast<float*>(dst + 32), _mm_permute_ps(vH, 0x3));
+		}
+
+		return n;
+	}
+
+	template<typename T>
+	ZetaInline __m256i LoadIndices(const T* p) noexcept
+	{
+		if constexpr (sizeof(T) == 1)
+			return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+		else if constexpr (sizeof(T) == 2)
+			return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+		else
+			return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+	}
+
+	// Widens indices to 32 bits and swaps the last two indices of every triangle. Indices are
+	// processed in groups of 24 (eight triangles) so that every group starts with a new triangle.
+	template<typename T>
+	void WidenIndices(const T* src, size_t n, uint32_t* dst) noexcept
+	{
+		// (i0, i1, i2) -> (i0, i2, i1). Triangles straddle the first and second registers of each
+		// group, those lanes are filled from the other register.
+		const __m256i vPermA = _mm256_setr_epi32(0, 2, 1, 3, 5, 4, 6, 0);
+		const __m256i vPermB = _mm256_setr_epi32(0, 1, 3, 2, 4, 6, 5, 7);
+		const __m256i vPermC = _mm256_setr_epi32(1, 0, 2, 4, 3, 5, 7, 6);
+		const __m256i vFirst = _mm256_setzero_si256();
+		const __m256i vLast = _mm256_set1_epi32(7);
+		size_t i = 0;
+
+		for (; i + 3 * BATCH_SIZE <= n; i += 3 * BATCH_SIZE)
+		{
+			const __m256i vA = LoadIndices(src + i);
+			const __m256i vB = LoadIndices(src + i + BATCH_SIZE);
+			const __m256i vC = LoadIndices(src + i + 2 * BATCH_SIZE);
+
+			const __m256i vOutA = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(vA, vPermA),
+				_mm256_permutevar8x32_epi32(vB, vFirst), 0x80);
+			const __m256i vOutB = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(vB, vPermB),
+				_mm256_permutevar8x32_epi32(vA, vLast), 0x1);
+			const __m256i vOutC = _mm256_permutevar8x32_epi32(vC, vPermC);
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), vOutA);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + BATCH_SIZE), vOutB);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 2 * BATCH_SIZE), vOutC);
+		}
+
+		for (; i < n; i += 3)
+		{
+			dst[i] = src[i];
+			dst[i + 1] = src[i + 2];
+			dst[i + 2] = src[i + 1];
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// AccessorDecoder
+//--------------------------------------------------------------------------------------
+
+void glTF::DecodePositions(const AccessorView& accessor, Span<Vertex> vertices) noexcept
+{
+	Assert(vertices.size() >= accessor.Count, "out-of-bound access.");
+	Vertex* v = vertices.data();
+
+	ForEachRow<3>(accessor, [v](size_t i, __m128 vRow)
+		{
+			StorePosition(FlipZ(vRow), v[i].Position);
+		});
+}
+
+void glTF::DecodeNormals(const AccessorView& accessor, Span<Vertex> vertices) noexcept
+{
+	Assert(vertices.size() >= accessor.Count, "out-of-bound access.");
+	Vertex* v = vertices.data();
+
+	ForEachRow<3>(accessor, [v](size_t i, __m128 vRow)
+		{
+			StoreHalf3(FlipZ(vRow), v[i].Normal);
+		});
+}
+
+void glTF::DecodeTexCoords(const AccessorView& accessor, Span<Vertex> vertices) noexcept
+{
+	Assert(vertices.size() >= accessor.Count, "out-of-bound access.");
+	Vertex* v = vertices.data();
+
+	ForEachRow<2>(accessor, [v](size_t i, __m128 vRow)
+		{
+			_mm_storel_pi(reinterpret_cast<__m64*>(&v[i].TexUV), vRow);
+		});
+}
+
+void glTF::DecodeTangents(const AccessorView& accessor, Span<Vertex> vertices) noexcept
+{
+	Assert(vertices.size() >= accessor.Count, "out-of-bound access.");
+	Vertex* v = vertices.data();
+
+	// the fourth component (handedness) isn't needed
+	ForEachRow<3>(accessor, [v](size_t i, __m128 vRow)
+		{
+			StoreHalf3(FlipZ(vRow), v[i].Tangent);
+		});
+}
+
+void glTF::DecodeVertices(const VertexAccessors& accessors, Span<Vertex> vertices) noexcept
+{
+	const size_t count = accessors.Position.Count;
+	Assert(vertices.size() >= count, "out-of-bound access.");
+	Assert(accessors.Normal.Data && accessors.Normal.Count == count, "Invalid NORMAL accessor.");
+	Assert(!accessors.TexCoord.Data || accessors.TexCoord.Count == count, "Invalid TEXCOORD_0 accessor.");
+	Assert(!accessors.Tangent.Data || accessors.Tangent.Count == count, "Invalid TANGENT accessor.");
+
+	if (count == 0)
+		return;
+
+	const bool hasTexCoord = accessors.TexCoord.Data != nullptr;
+	const bool hasTangent = accessors.Tangent.Data != nullptr;
+	const bool allFloats = accessors.Position.ComponentType == ACCESSOR_COMPONENT_TYPE::FLOAT32 &&
+		accessors.Normal.ComponentType == ACCESSOR_COMPONENT_TYPE::FLOAT32 &&
+		(!hasTexCoord || accessors.TexCoord.ComponentType == ACCESSOR_COMPONENT_TYPE::FLOAT32) &&
+		(!hasTangent || accessors.Tangent.ComponentType == ACCESSOR_COMPONENT_TYPE::FLOAT32);
+
+	size_t first = 0;
+
+	if (allFloats)
+	{
+		if (hasTexCoord)
+		{
+			first = hasTangent ? DecodeFloatVertices<true, true>(accessors, vertices.data()) :
+				DecodeFloatVertices<true, false>(accessors, vertices.data());
+		}
+		else
+		{
+			first = hasTangent ? DecodeFloatVertices<false, true>(accessors, vertices.data()) :
+				DecodeFloatVertices<false, false>(accessors, vertices.data());
+		}
+	}
+
+	// Remaining vertices are decoded one attribute at a time, in chunks that fit in the L1 cache so
+	// that the vertices aren't evicted between attributes
+	constexpr size_t CHUNK_SIZE = 256;
+
+	for (; first < count; first += CHUNK_SIZE)
+	{
+		const size_t n = Math::Min(count - first, CHUNK_SIZE);
+		Span<Vertex> chunk(vertices.data() + first, n);
+
+		DecodePositions(SubView(accessors.Position, first, n), chunk);
+		DecodeNormals(SubView(accessors.Normal, first, n), chunk);
+
+		if (hasTexCoord)
+			DecodeTexCoords(SubView(accessors.TexCoord, first, n), chunk);
+		if (hasTangent)
+			DecodeTangents(SubView(accessors.Tangent, first, n), chunk);
+	}
+}
+
+void glTF::DecodeIndices(const AccessorView& accessor, Span<uint32_t> indices) noexcept
+{
+	Assert(accessor.Count % 3 == 0, "invalid number of indices.");
+	Assert(indices.size() >= accessor.Count, "out-of-bound access.");
+	Assert(accessor.Stride == ComponentSize(accessor.ComponentType), "indices must be tightly packed.");
+
+	switch (accessor.ComponentType)
+	{
+	case ACCESSOR_COMPONENT_TYPE::UINT8:
+		WidenIndices(accessor.Data, accessor.Count, indices.data());
+		break;
+	case ACCESSOR_COMPONENT_TYPE::UINT16:
+		WidenIndices(reinterpret_cast<const uint16_t*>(accessor.Data), accessor.Count, indices.data());
+		break;
+	case ACCESSOR_COMPONENT_TYPE::UINT32:
+		WidenIndices(reinterpret_cast<const uint32_t*>(accessor.Data), accessor.Count, indices.data());
+		break;
+	default:
+		Assert(false, "Invalid index type.");
+	}
+}
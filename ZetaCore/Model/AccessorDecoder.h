@@ -0,0 +1,65 @@
+// Decoding of glTF accessors into the engine's vertex and index formats. Elements are read (and
+// converted to float) four components at a time using SSE, so that strided and interleaved
+// layouts cost the same as tightly packed ones. Conversion to half precision uses F16C and
+// indices are widened and reordered eight triangles at a time using AVX2.
+//
+// Besides floats, (normalized) 8- and 16-bit integer components are supported, as allowed by the
+// core spec for texture coordinates and by KHR_mesh_quantization for the other attributes.
+//
+// Ref: https://github.com/KhronosGroup/glTF/tree/main/extensions/2.0/Khronos/KHR_mesh_quantization
+
+#pragma once
+
+#include "../Core/Vertex.h"
+#include "../Utility/Span.h"
+
+namespace ZetaRay::Model::glTF
+{
+	enum class ACCESSOR_COMPONENT_TYPE : uint8_t
+	{
+		INT8,
+		UINT8,
+		INT16,
+		UINT16,
+		UINT32,
+		FLOAT32
+	};
+
+	struct AccessorView
+	{
+		// first component of the first element
+		const uint8_t* Data = nullptr;
+		size_t Count;
+		// distance in bytes between the start of consecutive elements
+		uint32_t Stride;
+		ACCESSOR_COMPONENT_TYPE ComponentType;
+		// integers are mapped to [0, 1] (unsigned) or [-1, 1] (signed), otherwise they're converted as is
+		bool Normalized;
+	};
+
+	struct VertexAccessors
+	{
+		AccessorView Position;
+		AccessorView Normal;
+		// following are optional, Data is null when missing
+		AccessorView TexCoord;
+		AccessorView Tangent;
+	};
+
+	// Decodes all the vertex attributes of a mesh in one pass, which is faster than decoding them one 
+	// at a time as vertices are only written once
+	void DecodeVertices(const VertexAccessors& accessors, Util::Span<Core::Vertex> vertices) noexcept;
+
+	// Following write to the corresponding member of vertices[0, accessor.Count). Positions, normals
+	// and tangents are converted from glTF's right-handed coordinate system to the left-handed one
+	// used by the engine.
+	void DecodePositions(const AccessorView& accessor, Util::Span<Core::Vertex> vertices) noexcept;
+	void DecodeNormals(const AccessorView& accessor, Util::Span<Core::Vertex> vertices) noexcept;
+	void DecodeTexCoords(const AccessorView& accessor, Util::Span<Core::Vertex> vertices) noexcept;
+	// Tangents have four components, the last one (handedness) is ignored
+	void DecodeTangents(const AccessorView& accessor, Util::Span<Core::Vertex> vertices) noexcept;
+
+	// Expects a triangle list with unsigned, tightly packed indices. Winding order of every triangle
+	// is reversed to match the engine's clockwise convention.
+	void DecodeIndices(const AccessorView& accessor, Util::Span<uint32_t> indices) noexcept;
+}
@@ -4,6 +4,7 @@
 #include "../Math/Surface.h"
 #include "../Math/MatrixFuncs.h"
 #include <limits.h>
+#include <xxHash/xxhash.h>
 
 using namespace ZetaRay;
 using namespace ZetaRay::Core;
@@ -43,6 +44,59 @@ TriangleMesh::TriangleMesh(Util::Span<Core::Vertex> vertices,
 	//	D3D12_RESOURCE_STATE_INDEX_BUFFER, false, indices.begin());
 }
 
+uint64_t Model::GeometryHash(Span<Vertex> vertices, Span<uint32_t> indices, uint64_t seed) noexcept
+{
+	// Vertex has padding bytes with unspecified values, so vertices are hashed in blocks after their
+	// members are packed
+	constexpr size_t PACKED_VERTEX_SIZE = sizeof(Vertex::Position) + sizeof(Vertex::Normal) + sizeof(Vertex::TexUV) + 
+		sizeof(Vertex::Tangent);
+	constexpr size_t BLOCK_SIZE = 256;
+	uint8_t block[BLOCK_SIZE * PACKED_VERTEX_SIZE];
+
+	const uint64_t sizes[2] = { vertices.size(), indices.size() };
+	uint64_t hash = XXH3_64bits_withSeed(sizes, sizeof(sizes), seed);
+
+	for (size_t base = 0; base < vertices.size(); base += BLOCK_SIZE)
+	{
+		const size_t n = Math::Min(BLOCK_SIZE, vertices.size() - base);
+		uint8_t* curr = block;
+
+		for (size_t i = base; i < base + n; i++)
+		{
+			memcpy(curr, &vertices[i].Position, sizeof(Vertex::Position));
+			curr += sizeof(Vertex::Position);
+			memcpy(curr, &vertices[i].Normal, sizeof(Vertex::Normal));
+			curr += sizeof(Vertex::Normal);
+			memcpy(curr, &vertices[i].TexUV, sizeof(Vertex::TexUV));
+			curr += sizeof(Vertex::TexUV);
+			memcpy(curr, &vertices[i].Tangent, sizeof(Vertex::Tangent));
+			curr += sizeof(Vertex::Tangent);
+		}
+
+		hash = XXH3_64bits_withSeed(block, n * PACKED_VERTEX_SIZE, hash);
+	}
+
+	return XXH3_64bits_withSeed(indices.data(), indices.size() * sizeof(uint32_t), hash);
+}
+
+bool Model::IdenticalGeometry(Span<Vertex> v0, Span<uint32_t> i0, Span<Vertex> v1, Span<uint32_t> i1) noexcept
+{
+	if (v0.size() != v1.size() || i0.size() != i1.size())
+		return false;
+
+	// Vertex has padding bytes with unspecified values, so its members are compared separately
+	for (size_t i = 0; i < v0.size(); i++)
+	{
+		if (memcmp(&v0[i].Position, &v1[i].Position, sizeof(Vertex::Position)) != 0 ||
+			memcmp(&v0[i].Normal, &v1[i].Normal, sizeof(Vertex::Normal)) != 0 ||
+			memcmp(&v0[i].TexUV, &v1[i].TexUV, sizeof(Vertex::TexUV)) != 0 ||
+			memcmp(&v0[i].Tangent, &v1[i].Tangent, sizeof(Vertex::Tangent)) != 0)
+			return false;
+	}
+
+	return memcmp(i0.data(), i1.data(), i0.size() * sizeof(uint32_t)) == 0;
+}
+
 //--------------------------------------------------------------------------------------
 // PrimitiveMesh
 //--------------------------------------------------------------------------------------
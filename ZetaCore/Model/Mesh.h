@@ -62,9 +62,27 @@ namespace ZetaRay::Model
 		uint64_t m_materialID;
 		uint32_t m_numVertices;
 		uint32_t m_numIndices;
+		// LOD indices are in the index buffer (after the mesh's indices) and refer to the mesh's vertices
+		size_t m_lodIdxBuffStartOffset = 0;
+		uint32_t m_numLODIndices = 0;
+		uint32_t m_lodBuffStartOffset = 0;
+		uint32_t m_numLODs = 0;
+		// meshes with identical vertices and indices share them (along with their LODs and mesh
+		// BVH), see GeometryHash()
+		uint64_t m_geometryID = 0;
 		Math::AABB m_AABB;
 	};
 
+	// Content hash of the given vertices and indices. Identical (bit for bit) geometry has the same hash
+	// regardless of which mesh, scene or glTF file it came from. Hashes with different seeds are independent
+	// of each other.
+	uint64_t GeometryHash(Util::Span<Core::Vertex> vertices, Util::Span<uint32_t> indices, uint64_t seed = 0) noexcept;
+
+	// Whether the two are identical bit for bit (padding bytes of Vertex are ignored). Geometry with
+	// the same GeometryHash() may still differ, this tells them apart.
+	bool IdenticalGeometry(Util::Span<Core::Vertex> v0, Util::Span<uint32_t> i0, 
+		Util::Span<Core::Vertex> v1, Util::Span<uint32_t> i1) noexcept;
+
 	// Ref: DirectXTK12 library (MIT License), available from:
 	// https://github.com/microsoft/DirectXTK12
 	namespace PrimitiveMesh
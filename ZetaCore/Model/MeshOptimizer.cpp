@@ -0,0 +1,467 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Model::MeshOptimizer;
+
+namespace
+{
+	// Size of the LRU cache that's modelled by the vertex cache optimizer. Unlike the FIFO cache
+	// used for analysis, it doesn't need to match the hardware.
+	static constexpr int LRU_CACHE_SIZE = 32;
+	static constexpr int MAX_VALENCE = 32;
+
+	// Ref: T. Forsyth, "Linear-Speed Vertex Cache Optimisation," 2006.
+	struct ScoreTable
+	{
+		ScoreTable() noexcept
+		{
+			constexpr float CACHE_DECAY_POWER = 1.5f;
+			constexpr float LAST_TRI_SCORE = 0.75f;
+			constexpr float VALENCE_BOOST_SCALE = 2.0f;
+			constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+			for (int i = 0; i < LRU_CACHE_SIZE; i++)
+			{
+				// vertices of the last emitted triangle are given the same score, otherwise the next triangle
+				// would depend on the order they were emitted in
+				if (i < 3)
+					Cache[i] = LAST_TRI_SCORE;
+				else
+					Cache[i] = powf(1.0f - (i - 3) / float(LRU_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+			}
+
+			// boost vertices with few remaining triangles so that they're finished off early rather than
+			// requiring another transform later on
+			Valence[0] = 0.0f;
+
+			for (int i = 1; i <= MAX_VALENCE; i++)
+				Valence[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+		}
+
+		ZetaInline float Score(int cachePos, uint32_t numRemainingTris) const
+		{
+			const float cacheScore = cachePos >= 0 ? Cache[cachePos] : 0.0f;
+			return cacheScore + Valence[Min(numRemainingTris, (uint32_t)MAX_VALENCE)];
+		}
+
+		float Cache[LRU_CACHE_SIZE];
+		float Valence[MAX_VALENCE + 1];
+	};
+
+	static const ScoreTable g_scoreTable;
+
+	// Emulates a FIFO cache using timestamps -- a vertex is in the cache when fewer than cacheSize
+	// vertices were added after it
+	struct FIFOCache
+	{
+		FIFOCache(uint32_t numVertices, uint32_t cacheSize) noexcept
+			: m_cacheSize(cacheSize),
+			m_timestamp(cacheSize + 1)
+		{
+			m_timestamps.resize(numVertices, 0);
+		}
+
+		ZetaInline void Flush()
+		{
+			m_timestamp += m_cacheSize + 1;
+		}
+
+		// Returns the number of cache misses
+		ZetaInline uint32_t Access(const uint32_t* tri)
+		{
+			uint32_t numMisses = 0;
+
+			for (int i = 0; i < 3; i++)
+			{
+				Assert(tri[i] < m_timestamps.size(), "Invalid vertex index.");
+
+				if (m_timestamp - m_timestamps[tri[i]] > m_cacheSize)
+				{
+					m_timestamps[tri[i]] = m_timestamp++;
+					numMisses++;
+				}
+			}
+
+			return numMisses;
+		}
+
+		SmallVector<uint32_t> m_timestamps;
+		uint32_t m_cacheSize;
+		uint32_t m_timestamp;
+	};
+}
+
+//--------------------------------------------------------------------------------------
+// MeshOptimizer
+//--------------------------------------------------------------------------------------
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(Span<uint32_t> indices, uint32_t numVertices,
+	uint32_t cacheSize) noexcept
+{
+	Assert(indices.size() % 3 == 0, "Invalid number of indices.");
+
+	VertexCacheStats stats;
+	stats.NumTriangles = indices.size() / 3;
+
+	FIFOCache cache(numVertices, cacheSize);
+	const uint32_t* idx = indices.data();
+
+	for (size_t i = 0; i < indices.size(); i += 3)
+		stats.NumTransformedVertices += cache.Access(idx + i);
+
+	// every referenced vertex has been transformed at least once
+	for (uint32_t v = 0; v < numVertices; v++)
+		stats.NumVertices += cache.m_timestamps[v] != 0;
+
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(Span<uint32_t> indices, uint32_t numVertices) noexcept
+{
+	Assert(indices.size() % 3 == 0, "Invalid number of indices.");
+	const size_t numTris = indices.size() / 3;
+
+	if (numTris <= 1)
+		return;
+
+	uint32_t* idx = indices.data();
+
+	// triangles that use each vertex and haven't been emitted yet are stored in
+	// adjTris[adjOffsets[v], adjOffsets[v] + numRemainingTris[v])
+	SmallVector<uint32_t> numRemainingTris;
+	numRemainingTris.resize(numVertices, 0);
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		Assert(idx[i] < numVertices, "Invalid vertex index.");
+		numRemainingTris[idx[i]]++;
+	}
+
+	SmallVector<uint32_t> adjOffsets;
+	adjOffsets.resize(numVertices);
+	uint32_t currOffset = 0;
+
+	for (uint32_t v = 0; v < numVertices; v++)
+	{
+		adjOffsets[v] = currOffset;
+		currOffset += numRemainingTris[v];
+		numRemainingTris[v] = 0;
+	}
+
+	SmallVector<uint32_t> adjTris;
+	adjTris.resize(indices.size());
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		const uint32_t v = idx[i];
+		adjTris[adjOffsets[v] + numRemainingTris[v]++] = (uint32_t)(i / 3);
+	}
+
+	SmallVector<float> vtxScores;
+	vtxScores.resize(numVertices);
+
+	for (uint32_t v = 0; v < numVertices; v++)
+		vtxScores[v] = g_scoreTable.Score(-1, numRemainingTris[v]);
+
+	SmallVector<float> triScores;
+	triScores.resize(numTris);
+	uint32_t bestTri = 0;
+
+	for (size_t t = 0; t < numTris; t++)
+	{
+		triScores[t] = vtxScores[idx[3 * t]] + vtxScores[idx[3 * t + 1]] + vtxScores[idx[3 * t + 2]];
+
+		if (triScores[t] > triScores[bestTri])
+			bestTri = (uint32_t)t;
+	}
+
+	SmallVector<bool> emitted;
+	emitted.resize(numTris, false);
+	size_t deadEndCursor = 0;
+
+	SmallVector<uint32_t> reordered;
+	reordered.resize(indices.size());
+
+	// extra space for vertices of the new triangle, which are pushed to the front
+	uint32_t cache[LRU_CACHE_SIZE + 3];
+	uint32_t newCache[LRU_CACHE_SIZE + 3];
+	int cacheSize = 0;
+
+	auto updateScore = [&](uint32_t v, int pos)
+		{
+			const float score = g_scoreTable.Score(pos, numRemainingTris[v]);
+			const float diff = score - vtxScores[v];
+			vtxScores[v] = score;
+
+			const uint32_t* adj = adjTris.data() + adjOffsets[v];
+
+			for (uint32_t j = 0; j < numRemainingTris[v]; j++)
+				triScores[adj[j]] += diff;
+		};
+
+	for (size_t n = 0; n < numTris; n++)
+	{
+		// none of the cached vertices have any remaining triangles, continue from the first triangle
+		// that hasn't been emitted yet
+		if (bestTri == uint32_t(-1))
+		{
+			while (emitted[deadEndCursor])
+				deadEndCursor++;
+
+			bestTri = (uint32_t)deadEndCursor;
+		}
+
+		const uint32_t* tri = idx + 3 * bestTri;
+		memcpy(reordered.data() + 3 * n, tri, sizeof(uint32_t) * 3);
+		emitted[bestTri] = true;
+
+		int newCacheSize = 0;
+
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t v = tri[k];
+
+			// remove the emitted triangle from the vertex's list
+			uint32_t* adj = adjTris.data() + adjOffsets[v];
+			const uint32_t numAdj = numRemainingTris[v];
+
+			for (uint32_t j = 0; j < numAdj; j++)
+			{
+				if (adj[j] == bestTri)
+				{
+					adj[j] = adj[numAdj - 1];
+					break;
+				}
+			}
+
+			numRemainingTris[v] = numAdj - 1;
+
+			// degenerate triangles may refer to the same vertex more than once
+			if (k == 0 || (v != tri[0] && (k == 1 || v != tri[1])))
+				newCache[newCacheSize++] = v;
+		}
+
+		// new triangle's vertices followed by the rest in LRU order
+		for (int i = 0; i < cacheSize; i++)
+		{
+			const uint32_t v = cache[i];
+
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCacheSize++] = v;
+		}
+
+		// vertices that were pushed out of the cache
+		for (int i = LRU_CACHE_SIZE; i < newCacheSize; i++)
+			updateScore(newCache[i], -1);
+
+		cacheSize = Min(newCacheSize, LRU_CACHE_SIZE);
+		bestTri = uint32_t(-1);
+		float bestScore = -1.0f;
+
+		for (int i = 0; i < cacheSize; i++)
+		{
+			const uint32_t v = newCache[i];
+			cache[i] = v;
+			updateScore(v, i);
+		}
+
+		// only triangles that use a cached vertex have had their score changed
+		for (int i = 0; i < cacheSize; i++)
+		{
+			const uint32_t v = cache[i];
+			const uint32_t* adj = adjTris.data() + adjOffsets[v];
+
+			for (uint32_t j = 0; j < numRemainingTris[v]; j++)
+			{
+				if (triScores[adj[j]] > bestScore)
+				{
+					bestScore = triScores[adj[j]];
+					bestTri = adj[j];
+				}
+			}
+		}
+	}
+
+	memcpy(idx, reordered.data(), sizeof(uint32_t) * indices.size());
+}
+
+void MeshOptimizer::OptimizeOverdraw(Span<uint32_t> indices, Span<Vertex> vertices, float threshold) noexcept
+{
+	Assert(indices.size() % 3 == 0, "Invalid number of indices.");
+	const uint32_t numTris = (uint32_t)(indices.size() / 3);
+
+	if (numTris <= 1)
+		return;
+
+	uint32_t* idx = indices.data();
+	FIFOCache cache((uint32_t)vertices.size(), FIFO_CACHE_SIZE);
+
+	// Hard boundaries are where the cache is effectively flushed (all of the triangle's vertices
+	// miss), so triangles can be freely reordered at these points
+	SmallVector<uint32_t> hardBoundaries;
+	hardBoundaries.push_back(0);
+	cache.Access(idx);
+
+	for (uint32_t t = 1; t < numTris; t++)
+	{
+		if (cache.Access(idx + 3 * t) == 3)
+			hardBoundaries.push_back(t);
+	}
+
+	hardBoundaries.push_back(numTris);
+
+	// Split each cluster further at points where ACMR of the split part is within threshold of
+	// the cluster's ACMR
+	SmallVector<uint32_t> clusterBoundaries;
+
+	for (size_t c = 0; c < hardBoundaries.size() - 1; c++)
+	{
+		const uint32_t begin = hardBoundaries[c];
+		const uint32_t end = hardBoundaries[c + 1];
+
+		cache.Flush();
+		uint32_t clusterMisses = 0;
+
+		for (uint32_t t = begin; t < end; t++)
+			clusterMisses += cache.Access(idx + 3 * t);
+
+		const float targetACMR = threshold * clusterMisses / (end - begin);
+		const size_t firstBoundary = clusterBoundaries.size();
+		clusterBoundaries.push_back(begin);
+
+		cache.Flush();
+		uint32_t runningMisses = 0;
+		uint32_t runningTris = 0;
+
+		for (uint32_t t = begin; t < end; t++)
+		{
+			runningMisses += cache.Access(idx + 3 * t);
+			runningTris++;
+
+			if (runningMisses <= targetACMR * runningTris)
+			{
+				clusterBoundaries.push_back(t + 1);
+				cache.Flush();
+				runningMisses = 0;
+				runningTris = 0;
+			}
+		}
+
+		// last split is usually small with a poor ACMR (or empty when it ended exactly at the end),
+		// merge it with the previous one
+		if (clusterBoundaries.size() - 1 > firstBoundary)
+			clusterBoundaries.pop_back();
+	}
+
+	clusterBoundaries.push_back(numTris);
+
+	// Sort the clusters so that the ones facing away from the mesh center, which are more likely to
+	// occlude other parts of the mesh, are drawn first
+	float3 meshCentroid(0.0f, 0.0f, 0.0f);
+
+	for (size_t i = 0; i < vertices.size(); i++)
+		meshCentroid += vertices[i].Position;
+
+	meshCentroid *= 1.0f / Max(vertices.size(), size_t(1));
+
+	struct Cluster
+	{
+		float SortKey;
+		uint32_t Begin;
+		uint32_t End;
+	};
+
+	const size_t numClusters = clusterBoundaries.size() - 1;
+	SmallVector<Cluster> clusters;
+	clusters.resize(numClusters);
+
+	for (size_t c = 0; c < numClusters; c++)
+	{
+		const uint32_t begin = clusterBoundaries[c];
+		const uint32_t end = clusterBoundaries[c + 1];
+
+		// area-weighted centroid and normal of the cluster
+		float3 centroid(0.0f, 0.0f, 0.0f);
+		float3 normal(0.0f, 0.0f, 0.0f);
+		float area = 0.0f;
+
+		for (uint32_t t = begin; t < end; t++)
+		{
+			const float3 v0 = vertices[idx[3 * t]].Position;
+			const float3 v1 = vertices[idx[3 * t + 1]].Position;
+			const float3 v2 = vertices[idx[3 * t + 2]].Position;
+
+			// with clockwise winding in a left-handed coordinate system, points outward
+			float3 n = (v1 - v0).cross(v2 - v0);
+			const float a = n.length();
+
+			centroid += (v0 + v1 + v2) * (a / 3.0f);
+			normal += n;
+			area += a;
+		}
+
+		const float normalLength = normal.length();
+		float sortKey = 0.0f;
+
+		if (area > 0.0f && normalLength > 0.0f)
+		{
+			float3 toCluster = centroid * (1.0f / area) - meshCentroid;
+			sortKey = toCluster.dot(normal) / normalLength;
+		}
+
+		clusters[c] = Cluster{ .SortKey = sortKey, .Begin = begin, .End = end };
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& lhs, const Cluster& rhs)
+		{
+			return lhs.SortKey > rhs.SortKey;
+		});
+
+	SmallVector<uint32_t> reordered;
+	reordered.resize(indices.size());
+	uint32_t* dst = reordered.data();
+
+	for (const Cluster& c : clusters)
+	{
+		const size_t n = 3 * (c.End - c.Begin);
+		memcpy(dst, idx + 3 * c.Begin, sizeof(uint32_t) * n);
+		dst += n;
+	}
+
+	memcpy(idx, reordered.data(), sizeof(uint32_t) * indices.size());
+}
+
+uint32_t MeshOptimizer::OptimizeVertexFetchRemap(Span<uint32_t> indices, Span<uint32_t> remap) noexcept
+{
+	const uint32_t numVertices = (uint32_t)remap.size();
+	memset(remap.data(), 0xff, sizeof(uint32_t) * numVertices);
+
+	uint32_t* idx = indices.data();
+	uint32_t next = 0;
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		const uint32_t v = idx[i];
+		Assert(v < numVertices, "Invalid vertex index.");
+
+		if (remap[v] == uint32_t(-1))
+			remap[v] = next++;
+
+		idx[i] = remap[v];
+	}
+
+	const uint32_t numReferenced = next;
+
+	for (uint32_t v = 0; v < numVertices; v++)
+	{
+		if (remap[v] == uint32_t(-1))
+			remap[v] = next++;
+	}
+
+	return numReferenced;
+}
@@ -0,0 +1,83 @@
+// Import-time reordering of mesh index and vertex buffers for better GPU efficiency:
+//
+//  1. Triangles are reordered for post-transform vertex cache locality using Forsyth's greedy
+//     algorithm, which works well regardless of the actual (unknown) cache size.
+//  2. Vertex cache-optimized order is split into clusters, which are then sorted so that the
+//     ones facing away from the mesh center are drawn first, reducing overdraw without giving up
+//     much of the cache locality.
+//  3. Vertices are reordered in the order of first use by the index buffer, so that vertex
+//     fetches are mostly sequential.
+//
+// References:
+// 1. T. Forsyth, "Linear-Speed Vertex Cache Optimisation," 2006.
+// 2. P. Sander, D. Nehab and J. Barczak, "Fast Triangle Reordering for Vertex Locality and
+//    Reduced Overdraw," ACM Transactions on Graphics, 2007.
+// 3. A. Kapoulkine, meshoptimizer, https://github.com/zeux/meshoptimizer
+
+#pragma once
+
+#include "../Core/Vertex.h"
+#include "../Utility/Span.h"
+#include "../Utility/SmallVector.h"
+
+namespace ZetaRay::Model::MeshOptimizer
+{
+	// Cache size used for analysis and for finding the cluster boundaries, roughly matches the
+	// effective size on current GPUs
+	static constexpr uint32_t FIFO_CACHE_SIZE = 16;
+
+	struct VertexCacheStats
+	{
+		ZetaInline void Accumulate(const VertexCacheStats& other)
+		{
+			NumTransformedVertices += other.NumTransformedVertices;
+			NumVertices += other.NumVertices;
+			NumTriangles += other.NumTriangles;
+		}
+
+		// Average cache miss ratio -- number of transformed vertices per triangle, between 0.5 (best
+		// case for large regular meshes) and 3
+		ZetaInline float ACMR() const { return NumTriangles ? (float)NumTransformedVertices / NumTriangles : 0.0f; }
+		// Average transform to vertex ratio -- number of times each vertex is transformed, 1 is optimal
+		ZetaInline float ATVR() const { return NumVertices ? (float)NumTransformedVertices / NumVertices : 0.0f; }
+
+		uint64_t NumTransformedVertices = 0;
+		// number of vertices that are referenced by the index buffer
+		uint64_t NumVertices = 0;
+		uint64_t NumTriangles = 0;
+	};
+
+	// Simulates a FIFO vertex cache of given size
+	VertexCacheStats AnalyzeVertexCache(Util::Span<uint32_t> indices, uint32_t numVertices,
+		uint32_t cacheSize = FIFO_CACHE_SIZE) noexcept;
+
+	// Reorders the triangles (in-place) for vertex cache locality. Winding order of triangles is
+	// preserved.
+	void OptimizeVertexCache(Util::Span<uint32_t> indices, uint32_t numVertices) noexcept;
+
+	// Reorders the triangles (in-place) to reduce overdraw while keeping the vertex cache efficiency
+	// within a factor of threshold of the current order, which should already be vertex cache-optimized.
+	// Triangles are expected to be in clockwise order.
+	void OptimizeOverdraw(Util::Span<uint32_t> indices, Util::Span<Core::Vertex> vertices,
+		float threshold = 1.05f) noexcept;
+
+	// Fills in the new position of each vertex when vertices are sorted by the order of first use in
+	// the index buffer and updates the index buffer accordingly. Unreferenced vertices are moved to
+	// the end. Returns the number of referenced vertices.
+	uint32_t OptimizeVertexFetchRemap(Util::Span<uint32_t> indices, Util::Span<uint32_t> remap) noexcept;
+
+	// Moves vertex i (of any per-vertex data) to remap[i]
+	template<typename T>
+	void RemapVertices(Util::Span<T> vertices, Util::Span<uint32_t> remap) noexcept
+	{
+		Assert(vertices.size() == remap.size(), "Invalid remap table.");
+
+		Util::SmallVector<T> remapped;
+		remapped.resize(vertices.size());
+
+		for (size_t i = 0; i < vertices.size(); i++)
+			remapped[remap[i]] = vertices[i];
+
+		memcpy(vertices.data(), remapped.data(), sizeof(T) * vertices.size());
+	}
+}
@@ -0,0 +1,783 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Model::MeshSimplifier;
+
+namespace
+{
+	static constexpr uint32_t INVALID_VERTEX = UINT32_MAX;
+	// weight of the planes that keep border and seam edges in place, relative to triangle planes
+	static constexpr float BORDER_WEIGHT = 10.0f;
+	// Squared error of normals and texture coordinates is added to the squared distance error (in the
+	// normalized [0, 1] space) with these weights
+	static constexpr float NORMAL_WEIGHT = 0.0025f;
+	static constexpr float UV_WEIGHT = 0.01f;
+	// texture coordinates followed by normal
+	static constexpr int NUM_ATTRIBUTES = 5;
+	// a LOD has to remove at least this fraction of the previous LOD's triangles
+	static constexpr float MIN_LOD_REDUCTION = 0.25f;
+	static constexpr uint32_t MIN_NUM_LOD_TRIANGLES = 32;
+
+	enum class VERTEX_KIND : uint8_t
+	{
+		// interior vertex, can be moved onto any neighbor
+		MANIFOLD,
+		// on an open boundary, can only be moved along the boundary
+		BORDER,
+		// one of two vertices with the same position but different attributes, moved along the seam
+		// together with the other one
+		SEAM,
+		// anything else (e.g. non-manifold vertices or corners where seams meet), never moved
+		LOCKED
+	};
+
+	// Ref: M. Garland and P. Heckbert, "Surface Simplification Using Quadric Error Metrics," SIGGRAPH, 1997.
+	// Weighted sum of squared distances to a set of planes, Q(p) = p^T A p + 2 b^T p + c, where A is symmetric.
+	struct Quadric
+	{
+		void AddPlane(const float3& n, float d, float w)
+		{
+			A00 += w * n.x * n.x;
+			A11 += w * n.y * n.y;
+			A22 += w * n.z * n.z;
+			A01 += w * n.x * n.y;
+			A02 += w * n.x * n.z;
+			A12 += w * n.y * n.z;
+			B0 += w * n.x * d;
+			B1 += w * n.y * d;
+			B2 += w * n.z * d;
+			C += w * d * d;
+			W += w;
+		}
+
+		void Add(const Quadric& q)
+		{
+			A00 += q.A00;
+			A11 += q.A11;
+			A22 += q.A22;
+			A01 += q.A01;
+			A02 += q.A02;
+			A12 += q.A12;
+			B0 += q.B0;
+			B1 += q.B1;
+			B2 += q.B2;
+			C += q.C;
+			W += q.W;
+		}
+
+		// Weighted sum of squared distances
+		float Evaluate(const float3& p) const
+		{
+			return A00 * p.x * p.x + A11 * p.y * p.y + A22 * p.z * p.z +
+				2.0f * (A01 * p.x * p.y + A02 * p.x * p.z + A12 * p.y * p.z) +
+				2.0f * (B0 * p.x + B1 * p.y + B2 * p.z) + C;
+		}
+
+		// Weighted average of squared distances for the sum of this quadric and q, without forming the sum
+		float Error(const Quadric& q, const float3& p) const
+		{
+			const float w = W + q.W;
+
+			// can be slightly negative due to round-off
+			return w > 0.0f ? Max(Evaluate(p) + q.Evaluate(p), 0.0f) / w : 0.0f;
+		}
+
+		float A00 = 0.0f, A11 = 0.0f, A22 = 0.0f;
+		float A01 = 0.0f, A02 = 0.0f, A12 = 0.0f;
+		float B0 = 0.0f, B1 = 0.0f, B2 = 0.0f;
+		float C = 0.0f;
+		float W = 0.0f;
+	};
+
+	// Ref: H. Hoppe, "New Quadric Metric for Simplifying Meshes with Appearance Attributes," IEEE Visualization, 1999.
+	// Every attribute is assumed to vary linearly over each triangle, s(p) = g^T p + d. Squared difference
+	// between that and the vertex's attribute, w (g^T p + d - s)^2, expands to a regular quadric in p (with
+	// a non-unit normal), plus terms that are linear and quadratic in s.
+	struct AttributeQuadric
+	{
+		void AddTriangle(const float3* p, const float* s0, const float* s1, const float* s2, float w)
+		{
+			float3 e1 = p[1] - p[0];
+			float3 e2 = p[2] - p[0];
+			const float a = e1.dot(e1);
+			const float b = e1.dot(e2);
+			const float c = e2.dot(e2);
+			const float det = a * c - b * b;
+
+			if (det <= 0.0f)
+				return;
+
+			// gradient lies in the plane of the triangle and matches the attribute differences along the edges
+			const float oneDivDet = 1.0f / det;
+			const float3 t1 = (e1 * c - e2 * b) * oneDivDet;
+			const float3 t2 = (e2 * a - e1 * b) * oneDivDet;
+
+			for (int k = 0; k < NUM_ATTRIBUTES; k++)
+			{
+				float3 g = t1 * (s1[k] - s0[k]) + t2 * (s2[k] - s0[k]);
+				const float d = s0[k] - g.dot(p[0]);
+
+				Q.AddPlane(g, d, w);
+				G[k] += g * w;
+				D[k] += d * w;
+			}
+
+			// Q.W is the sum of weights over all the attributes
+			W += w;
+		}
+
+		void Add(const AttributeQuadric& q)
+		{
+			Q.Add(q.Q);
+
+			for (int k = 0; k < NUM_ATTRIBUTES; k++)
+			{
+				G[k] += q.G[k];
+				D[k] += q.D[k];
+			}
+
+			W += q.W;
+		}
+
+		// Weighted sum of squared errors, summed over the attributes
+		float Evaluate(const float3& p, const float* s) const
+		{
+			float r = Q.Evaluate(p);
+
+			for (int k = 0; k < NUM_ATTRIBUTES; k++)
+			{
+				float3 g = G[k];
+				r += -2.0f * s[k] * (g.dot(p) + D[k]) + W * s[k] * s[k];
+			}
+
+			return r;
+		}
+
+		// Weighted average (over the triangles) of squared errors for the sum of this quadric and q
+		float Error(const AttributeQuadric& q, const float3& p, const float* s) const
+		{
+			const float w = W + q.W;
+
+			return w > 0.0f ? Max(Evaluate(p, s) + q.Evaluate(p, s), 0.0f) / w : 0.0f;
+		}
+
+		Quadric Q;
+		float3 G[NUM_ATTRIBUTES] = {};
+		float D[NUM_ATTRIBUTES] = {};
+		float W = 0.0f;
+	};
+
+	// Triangles that use each vertex
+	struct VertexTriangles
+	{
+		void Build(const uint32_t* indices, uint32_t numIndices, uint32_t numVertices)
+		{
+			Offsets.clear();
+			Offsets.resize(numVertices + 1, 0);
+			Triangles.resize(numIndices);
+
+			for (uint32_t i = 0; i < numIndices; i++)
+				Offsets[indices[i] + 1]++;
+
+			for (uint32_t v = 0; v < numVertices; v++)
+				Offsets[v + 1] += Offsets[v];
+
+			// Offsets[v] is used as the insertion point and ends up at the beginning of v + 1
+			for (uint32_t i = 0; i < numIndices; i++)
+				Triangles[Offsets[indices[i]]++] = i / 3;
+
+			for (uint32_t v = numVertices; v > 0; v--)
+				Offsets[v] = Offsets[v - 1];
+
+			Offsets[0] = 0;
+		}
+
+		ZetaInline const uint32_t* begin(uint32_t v) const { return Triangles.begin() + Offsets[v]; }
+		ZetaInline const uint32_t* end(uint32_t v) const { return Triangles.begin() + Offsets[v + 1]; }
+
+		SmallVector<uint32_t> Offsets;
+		SmallVector<uint32_t> Triangles;
+	};
+
+	struct Collapse
+	{
+		uint32_t From;
+		uint32_t To;
+		// other side of the seam, if any
+		uint32_t FromTwin;
+		uint32_t ToTwin;
+		float Cost;
+	};
+
+	// Whether any triangle around v has the half-edge a -> b
+	bool HasHalfEdge(const uint32_t* indices, const VertexTriangles& adj, uint32_t v, uint32_t a, uint32_t b)
+	{
+		for (const uint32_t* t = adj.begin(v); t != adj.end(v); t++)
+		{
+			const uint32_t* tri = indices + 3 * *t;
+
+			if ((tri[0] == a && tri[1] == b) || (tri[1] == a && tri[2] == b) || (tri[2] == a && tri[0] == b))
+				return true;
+		}
+
+		return false;
+	}
+
+	// Finds the half-edges around v that don't have an opposite half-edge. Returns the other endpoint
+	// of its outgoing and incoming open edges (or INVALID_VERTEX if there isn't exactly one) along with
+	// the number of open edges.
+	uint32_t FindOpenEdges(const uint32_t* indices, const VertexTriangles& adj, uint32_t v, uint32_t& openNext,
+		uint32_t& openPrev)
+	{
+		uint32_t numOut = 0;
+		uint32_t numIn = 0;
+		openNext = INVALID_VERTEX;
+		openPrev = INVALID_VERTEX;
+
+		for (const uint32_t* t = adj.begin(v); t != adj.end(v); t++)
+		{
+			const uint32_t* tri = indices + 3 * *t;
+			const int k = tri[0] == v ? 0 : (tri[1] == v ? 1 : 2);
+			const uint32_t next = tri[(k + 1) % 3];
+			const uint32_t prev = tri[(k + 2) % 3];
+
+			// both opposite half-edges would be in triangles that have v
+			if (!HasHalfEdge(indices, adj, v, next, v))
+			{
+				openNext = next;
+				numOut++;
+			}
+
+			if (!HasHalfEdge(indices, adj, v, v, prev))
+			{
+				openPrev = prev;
+				numIn++;
+			}
+		}
+
+		if (numOut != 1)
+			openNext = INVALID_VERTEX;
+		if (numIn != 1)
+			openPrev = INVALID_VERTEX;
+
+		return numOut + numIn;
+	}
+
+	// Whether moving vertex "from" onto "to" would flip (or collapse) any of the triangles that remain
+	bool HasFlips(const uint32_t* indices, const VertexTriangles& adj, Span<float3> positions, uint32_t from, uint32_t to)
+	{
+		for (const uint32_t* t = adj.begin(from); t != adj.end(from); t++)
+		{
+			const uint32_t* tri = indices + 3 * *t;
+
+			// removed by the collapse
+			if (tri[0] == to || tri[1] == to || tri[2] == to)
+				continue;
+
+			float3 p[3] = { positions[tri[0]], positions[tri[1]], positions[tri[2]] };
+			float3 n0 = (p[1] - p[0]).cross(p[2] - p[0]);
+
+			for (int k = 0; k < 3; k++)
+			{
+				if (tri[k] == from)
+					p[k] = positions[to];
+			}
+
+			float3 n1 = (p[1] - p[0]).cross(p[2] - p[0]);
+			const float len0 = n0.length();
+
+			// already degenerate
+			if (len0 == 0.0f)
+				continue;
+
+			// rejects flips and large changes in the normal, along with new degenerate triangles
+			if (n0.dot(n1) <= 0.25f * len0 * n1.length())
+				return true;
+		}
+
+		return false;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// MeshSimplifier
+//--------------------------------------------------------------------------------------
+
+float MeshSimplifier::Simplify(Span<Vertex> vertices, Span<uint32_t> indices, uint32_t targetNumIndices,
+	float maxError, Vector<uint32_t>& simplifiedIndices) noexcept
+{
+	Assert(indices.size() % 3 == 0, "Invalid number of indices.");
+
+	// simplification is done in place, at the end of the output
+	const size_t base = simplifiedIndices.size();
+	simplifiedIndices.append_range(indices.begin(), indices.end());
+
+	if (indices.size() <= targetNumIndices)
+		return 0.0f;
+
+	const uint32_t numVertices = (uint32_t)vertices.size();
+	uint32_t numIndices = (uint32_t)indices.size();
+	uint32_t* result = simplifiedIndices.data() + base;
+
+	// positions are normalized to the unit cube so that errors don't depend on the mesh's scale
+	float3 vMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	float3 vMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (auto& v : vertices)
+	{
+		vMin = float3(Min(vMin.x, v.Position.x), Min(vMin.y, v.Position.y), Min(vMin.z, v.Position.z));
+		vMax = float3(Max(vMax.x, v.Position.x), Max(vMax.y, v.Position.y), Max(vMax.z, v.Position.z));
+	}
+
+	const float extent = Max(vMax.x - vMin.x, Max(vMax.y - vMin.y, vMax.z - vMin.z));
+	if (extent == 0.0f)
+		return 0.0f;
+
+	const float scale = 1.0f / extent;
+	SmallVector<float3> positions;
+	positions.resize(numVertices);
+
+	for (uint32_t v = 0; v < numVertices; v++)
+		positions[v] = (vertices[v].Position - vMin) * scale;
+
+	// Link the vertices that have the same position -- remap is the first one and wedge is the next one
+	// (circularly). Unreferenced vertices are left out so that they don't make their twin look like a seam.
+	SmallVector<uint32_t> remap;
+	SmallVector<uint32_t> wedge;
+	SmallVector<uint32_t> sorted;
+	remap.resize(numVertices);
+	wedge.resize(numVertices);
+
+	{
+		SmallVector<uint8_t> referenced;
+		referenced.resize(numVertices, 0);
+
+		for (uint32_t i = 0; i < numIndices; i++)
+		{
+			Assert(result[i] < numVertices, "Invalid vertex index.");
+			referenced[result[i]] = 1;
+		}
+
+		for (uint32_t v = 0; v < numVertices; v++)
+		{
+			remap[v] = v;
+			wedge[v] = v;
+
+			if (referenced[v])
+				sorted.push_back(v);
+		}
+	}
+
+	auto lessThan = [&vertices](uint32_t a, uint32_t b)
+		{
+			const float3& pa = vertices[a].Position;
+			const float3& pb = vertices[b].Position;
+
+			return pa.x != pb.x ? pa.x < pb.x : (pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z);
+		};
+
+	std::sort(sorted.begin(), sorted.end(), lessThan);
+
+	for (size_t i = 0; i < sorted.size();)
+	{
+		size_t j = i + 1;
+		while (j < sorted.size() && !lessThan(sorted[i], sorted[j]))
+			j++;
+
+		for (size_t k = i; k < j; k++)
+		{
+			remap[sorted[k]] = sorted[i];
+			wedge[sorted[k]] = k + 1 < j ? sorted[k + 1] : sorted[i];
+		}
+
+		i = j;
+	}
+
+	VertexTriangles adj;
+	adj.Build(result, numIndices, numVertices);
+
+	SmallVector<uint32_t> openNext;
+	SmallVector<uint32_t> openPrev;
+	SmallVector<uint32_t> numOpen;
+	openNext.resize(numVertices);
+	openPrev.resize(numVertices);
+	numOpen.resize(numVertices);
+
+	for (uint32_t v = 0; v < numVertices; v++)
+		numOpen[v] = FindOpenEdges(result, adj, v, openNext[v], openPrev[v]);
+
+	// Vertex kinds are decided once for the input mesh. Open edges change as edges are collapsed, so
+	// they're found again in every pass.
+	SmallVector<VERTEX_KIND> kinds;
+	kinds.resize(numVertices);
+
+	for (uint32_t v = 0; v < numVertices; v++)
+	{
+		const uint32_t w = wedge[v];
+
+		if (w == v)
+		{
+			if (numOpen[v] == 0)
+				kinds[v] = VERTEX_KIND::MANIFOLD;
+			else if (numOpen[v] == 2 && openNext[v] != INVALID_VERTEX && openPrev[v] != INVALID_VERTEX)
+				kinds[v] = VERTEX_KIND::BORDER;
+			else
+				kinds[v] = VERTEX_KIND::LOCKED;
+		}
+		// open edges of the two vertices have to be twins
+		else if (wedge[w] == v && numOpen[v] == 2 && numOpen[w] == 2 &&
+			openNext[v] != INVALID_VERTEX && openPrev[v] != INVALID_VERTEX &&
+			openNext[w] != INVALID_VERTEX && openPrev[w] != INVALID_VERTEX &&
+			remap[openNext[v]] == remap[openPrev[w]] && remap[openPrev[v]] == remap[openNext[w]])
+		{
+			kinds[v] = VERTEX_KIND::SEAM;
+		}
+		else
+			kinds[v] = VERTEX_KIND::LOCKED;
+	}
+
+	// Attributes are scaled so that they can be summed up with equal weights
+	SmallVector<float> attributes;
+	attributes.resize(numVertices * NUM_ATTRIBUTES);
+
+	for (uint32_t v = 0; v < numVertices; v++)
+	{
+		const float3 n = vertices[v].Normal;
+		float* s = attributes.data() + v * NUM_ATTRIBUTES;
+
+		s[0] = vertices[v].TexUV.x * sqrtf(UV_WEIGHT);
+		s[1] = vertices[v].TexUV.y * sqrtf(UV_WEIGHT);
+		s[2] = n.x * sqrtf(NORMAL_WEIGHT);
+		s[3] = n.y * sqrtf(NORMAL_WEIGHT);
+		s[4] = n.z * sqrtf(NORMAL_WEIGHT);
+	}
+
+	// One quadric for every position, made up of the planes of the triangles around it, weighted by
+	// their area. Border and seam edges add a plane that's perpendicular to their triangle, so that
+	// moving the vertex away from the edge is penalized. Attribute quadrics are per vertex, since
+	// vertices with the same position can have different attributes.
+	SmallVector<Quadric> quadrics;
+	SmallVector<AttributeQuadric> attribQuadrics;
+	quadrics.resize(numVertices, Quadric());
+	attribQuadrics.resize(numVertices, AttributeQuadric());
+
+	for (uint32_t t = 0; t < numIndices / 3; t++)
+	{
+		const uint32_t* tri = result + 3 * t;
+		const float3 p[3] = { positions[tri[0]], positions[tri[1]], positions[tri[2]] };
+		float3 n = (p[1] - p[0]).cross(p[2] - p[0]);
+		const float length = n.length();
+
+		if (length == 0.0f)
+			continue;
+
+		n *= 1.0f / length;
+		const float d = -n.dot(p[0]);
+
+		for (int k = 0; k < 3; k++)
+		{
+			quadrics[remap[tri[k]]].AddPlane(n, d, 0.5f * length);
+			attribQuadrics[tri[k]].AddTriangle(p, attributes.data() + tri[0] * NUM_ATTRIBUTES,
+				attributes.data() + tri[1] * NUM_ATTRIBUTES, attributes.data() + tri[2] * NUM_ATTRIBUTES, 0.5f * length);
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t a = tri[k];
+			const uint32_t b = tri[(k + 1) % 3];
+
+			if (HasHalfEdge(result, adj, a, b, a))
+				continue;
+
+			float3 edge = positions[b] - positions[a];
+			float3 edgeNormal = edge.cross(n);
+			const float edgeLength = edgeNormal.length();
+
+			if (edgeLength == 0.0f)
+				continue;
+
+			edgeNormal *= 1.0f / edgeLength;
+			const float edgeD = -edgeNormal.dot(positions[a]);
+
+			quadrics[remap[a]].AddPlane(edgeNormal, edgeD, BORDER_WEIGHT * edgeLength * edgeLength);
+			quadrics[remap[b]].AddPlane(edgeNormal, edgeD, BORDER_WEIGHT * edgeLength * edgeLength);
+		}
+	}
+
+	auto tryCollapse = [&](uint32_t from, uint32_t to, Collapse& c)
+		{
+			c = Collapse{ .From = from, .To = to, .FromTwin = INVALID_VERTEX, .ToTwin = INVALID_VERTEX, .Cost = FLT_MAX };
+
+			switch (kinds[from])
+			{
+			case VERTEX_KIND::MANIFOLD:
+				break;
+			case VERTEX_KIND::BORDER:
+				if (kinds[to] != VERTEX_KIND::BORDER && kinds[to] != VERTEX_KIND::LOCKED)
+					return false;
+				if (openNext[from] != to && openPrev[from] != to)
+					return false;
+				break;
+			case VERTEX_KIND::SEAM:
+			{
+				if (kinds[to] != VERTEX_KIND::SEAM && kinds[to] != VERTEX_KIND::LOCKED)
+					return false;
+
+				// the twin moves along the twin edge on the other side of the seam
+				const uint32_t twin = wedge[from];
+				uint32_t toTwin;
+
+				if (openNext[from] == to)
+					toTwin = openPrev[twin];
+				else if (openPrev[from] == to)
+					toTwin = openNext[twin];
+				else
+					return false;
+
+				if (toTwin == INVALID_VERTEX || remap[toTwin] != remap[to])
+					return false;
+
+				c.FromTwin = twin;
+				c.ToTwin = toTwin;
+				break;
+			}
+			default:
+				return false;
+			}
+
+			// attributes of "to" are kept
+			float attribError = attribQuadrics[from].Error(attribQuadrics[to], positions[to],
+				attributes.data() + to * NUM_ATTRIBUTES);
+
+			if (c.FromTwin != INVALID_VERTEX)
+			{
+				attribError = Max(attribError, attribQuadrics[c.FromTwin].Error(attribQuadrics[c.ToTwin], positions[to],
+					attributes.data() + c.ToTwin * NUM_ATTRIBUTES));
+			}
+
+			c.Cost = quadrics[remap[from]].Error(quadrics[remap[to]], positions[to]) + attribError;
+
+			return true;
+		};
+
+	auto countSharedTriangles = [&](uint32_t a, uint32_t b)
+		{
+			uint32_t n = 0;
+
+			for (const uint32_t* t = adj.begin(a); t != adj.end(a); t++)
+			{
+				const uint32_t* tri = result + 3 * *t;
+				n += tri[0] == b || tri[1] == b || tri[2] == b;
+			}
+
+			return n;
+		};
+
+	const float maxCost = maxError * scale * maxError * scale;
+	float resultCost = 0.0f;
+
+	SmallVector<Collapse> candidates;
+	SmallVector<uint32_t> collapseTo;
+	SmallVector<uint8_t> locked;
+	collapseTo.resize(numVertices);
+	locked.resize(numVertices);
+
+	// Every pass collapses the cheapest edges that don't share any triangles with each other, so
+	// that collapses in the same pass can't affect each other's errors or flip checks
+	for (int pass = 0; numIndices > targetNumIndices; pass++)
+	{
+		if (pass > 0)
+		{
+			adj.Build(result, numIndices, numVertices);
+
+			// only needed for vertices that move along an edge
+			for (uint32_t v = 0; v < numVertices; v++)
+			{
+				if (kinds[v] == VERTEX_KIND::BORDER || kinds[v] == VERTEX_KIND::SEAM)
+					FindOpenEdges(result, adj, v, openNext[v], openPrev[v]);
+			}
+		}
+
+		candidates.clear();
+
+		for (uint32_t i = 0; i < numIndices; i++)
+		{
+			const uint32_t a = result[i];
+			const uint32_t b = result[i - i % 3 + (i % 3 + 1) % 3];
+
+			// interior edges are visited from both sides
+			if (a > b && HasHalfEdge(result, adj, a, b, a))
+				continue;
+
+			if (remap[a] == remap[b])
+				continue;
+
+			Collapse ab;
+			Collapse ba;
+			const bool validAB = tryCollapse(a, b, ab) && ab.Cost <= maxCost;
+			const bool validBA = tryCollapse(b, a, ba) && ba.Cost <= maxCost;
+
+			if (validAB || validBA)
+				candidates.push_back(validAB && (!validBA || ab.Cost <= ba.Cost) ? ab : ba);
+		}
+
+		if (candidates.empty())
+			break;
+
+		std::sort(candidates.begin(), candidates.end(), [](const Collapse& lhs, const Collapse& rhs)
+			{
+				return lhs.Cost < rhs.Cost;
+			});
+
+		for (uint32_t v = 0; v < numVertices; v++)
+			collapseTo[v] = v;
+
+		memset(locked.data(), 0, locked.size());
+
+		const uint32_t numTrisToRemove = (numIndices - targetNumIndices + 2) / 3;
+		uint32_t numRemoved = 0;
+		uint32_t numCollapses = 0;
+
+		auto lockNeighborhood = [&](uint32_t v)
+			{
+				for (const uint32_t* t = adj.begin(v); t != adj.end(v); t++)
+				{
+					const uint32_t* tri = result + 3 * *t;
+					locked[remap[tri[0]]] = 1;
+					locked[remap[tri[1]]] = 1;
+					locked[remap[tri[2]]] = 1;
+				}
+			};
+
+		for (auto& c : candidates)
+		{
+			if (numRemoved >= numTrisToRemove)
+				break;
+
+			if (locked[remap[c.From]] || locked[remap[c.To]])
+				continue;
+
+			if (HasFlips(result, adj, positions, c.From, c.To) ||
+				(c.FromTwin != INVALID_VERTEX && HasFlips(result, adj, positions, c.FromTwin, c.ToTwin)))
+			{
+				continue;
+			}
+
+			collapseTo[c.From] = c.To;
+			numRemoved += countSharedTriangles(c.From, c.To);
+			lockNeighborhood(c.From);
+			lockNeighborhood(c.To);
+
+			if (c.FromTwin != INVALID_VERTEX)
+			{
+				collapseTo[c.FromTwin] = c.ToTwin;
+				numRemoved += countSharedTriangles(c.FromTwin, c.ToTwin);
+				lockNeighborhood(c.FromTwin);
+				lockNeighborhood(c.ToTwin);
+			}
+
+			quadrics[remap[c.To]].Add(quadrics[remap[c.From]]);
+			attribQuadrics[c.To].Add(attribQuadrics[c.From]);
+
+			if (c.FromTwin != INVALID_VERTEX)
+				attribQuadrics[c.ToTwin].Add(attribQuadrics[c.FromTwin]);
+
+			resultCost = Max(resultCost, c.Cost);
+			numCollapses++;
+		}
+
+		if (numCollapses == 0)
+			break;
+
+		// remove the triangles that became degenerate
+		uint32_t numRemaining = 0;
+
+		for (uint32_t i = 0; i < numIndices; i += 3)
+		{
+			const uint32_t i0 = collapseTo[result[i]];
+			const uint32_t i1 = collapseTo[result[i + 1]];
+			const uint32_t i2 = collapseTo[result[i + 2]];
+
+			if (i0 == i1 || i1 == i2 || i2 == i0)
+				continue;
+
+			result[numRemaining++] = i0;
+			result[numRemaining++] = i1;
+			result[numRemaining++] = i2;
+		}
+
+		numIndices = numRemaining;
+	}
+
+	simplifiedIndices.resize(base + numIndices);
+
+	return sqrtf(resultCost) * extent;
+}
+
+void MeshSimplifier::BuildLODs(Span<Vertex> vertices, Span<uint32_t> indices, Vector<MeshLOD>& lods,
+	Vector<uint32_t>& lodIndices, float maxRelativeError) noexcept
+{
+	float3 vMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	float3 vMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (auto& v : vertices)
+	{
+		vMin = float3(Min(vMin.x, v.Position.x), Min(vMin.y, v.Position.y), Min(vMin.z, v.Position.z));
+		vMax = float3(Max(vMax.x, v.Position.x), Max(vMax.y, v.Position.y), Max(vMax.z, v.Position.z));
+	}
+
+	const float maxError = maxRelativeError * Max(vMax.x - vMin.x, Max(vMax.y - vMin.y, vMax.z - vMin.z));
+	const size_t baseOffset = lodIndices.size();
+	SmallVector<uint32_t> simplified;
+	Span<uint32_t> prev = indices;
+	float prevError = 0.0f;
+
+	// every LOD is simplified from the previous one, so their errors add up
+	for (uint32_t i = 0; i < MAX_NUM_LODS; i++)
+	{
+		const uint32_t numTris = (uint32_t)prev.size() / 3;
+		if (numTris < 2 * MIN_NUM_LOD_TRIANGLES)
+			break;
+
+		simplified.clear();
+		const float error = Simplify(vertices, prev, (numTris / 2) * 3, maxError - prevError, simplified);
+
+		// not worth it -- rest of the mesh is most likely locked or error limit was reached
+		if (simplified.empty() || simplified.size() > (1.0f - MIN_LOD_REDUCTION) * prev.size())
+			break;
+
+		MeshOptimizer::OptimizeVertexCache(simplified, (uint32_t)vertices.size());
+		prevError += error;
+
+		lods.push_back(MeshLOD{ .IdxOffset = (uint32_t)(lodIndices.size() - baseOffset),
+			.NumIndices = (uint32_t)simplified.size(),
+			.Error = prevError });
+
+		lodIndices.append_range(simplified.begin(), simplified.end());
+		prev = Span(lodIndices.begin() + lodIndices.size() - simplified.size(), simplified.size());
+	}
+}
+
+uint32_t MeshSimplifier::SelectLOD(Span<MeshLOD> lods, float distance, float scale, float pixelSpreadAngle,
+	float maxPixelError) noexcept
+{
+	if (distance <= 0.0f)
+		return 0;
+
+	// world space size of a pixel at the given distance, converted to object space
+	const float pixelSize = distance * tanf(pixelSpreadAngle);
+	const float maxError = maxPixelError * pixelSize / scale;
+	uint32_t lod = 0;
+
+	// errors are increasing
+	for (uint32_t i = 0; i < (uint32_t)lods.size() && lods[i].Error <= maxError; i++)
+		lod = i + 1;
+
+	return lod;
+}
@@ -0,0 +1,59 @@
+// Import-time level of detail (LOD) generation using quadric error metric edge collapses.
+//
+// Every LOD is an index buffer over the vertices of the full-resolution mesh, so LODs don't add
+// any vertices and only take up space in the index buffer. Edges are collapsed (one endpoint moved
+// onto the other) in the order of increasing error, which is the quadric error of the merged vertex
+// plus the error of its attributes (normal and texture coordinates), assuming that they vary linearly
+// over the triangles. Vertices on the mesh border
+// can only move along the border, while vertices on attribute seams (same position, different
+// attributes) move along the seam together with their twin on the other side, so that no holes or
+// cracks are introduced.
+//
+// References:
+// 1. M. Garland and P. Heckbert, "Surface Simplification Using Quadric Error Metrics," SIGGRAPH, 1997.
+// 2. H. Hoppe, "New Quadric Metric for Simplifying Meshes with Appearance Attributes," IEEE Visualization, 1999.
+// 3. A. Kapoulkine, meshoptimizer, https://github.com/zeux/meshoptimizer
+
+#pragma once
+
+#include "../Core/Vertex.h"
+#include "../Utility/Span.h"
+#include "../Utility/SmallVector.h"
+
+namespace ZetaRay::Model
+{
+	struct MeshLOD
+	{
+		// relative to the mesh's first LOD index
+		uint32_t IdxOffset;
+		uint32_t NumIndices;
+		// approximate distance (in object space) between this LOD and the full-resolution mesh
+		float Error;
+	};
+}
+
+namespace ZetaRay::Model::MeshSimplifier
+{
+	// Not counting the full-resolution mesh
+	static constexpr uint32_t MAX_NUM_LODS = 5;
+
+	// Collapses edges until the mesh has at most targetNumIndices indices or every remaining collapse
+	// would have an error greater than maxError (in object space). Simplified indices are appended to
+	// simplifiedIndices. Returns the error of the simplified mesh.
+	float Simplify(Util::Span<Core::Vertex> vertices, Util::Span<uint32_t> indices, uint32_t targetNumIndices,
+		float maxError, Util::Vector<uint32_t>& simplifiedIndices) noexcept;
+
+	// Builds a chain of up to MAX_NUM_LODS LODs, each with about half the triangles of the previous one.
+	// Chain ends early when simplification stops making progress or error would exceed maxRelativeError
+	// times the mesh extent. LODs are appended to lods and their (vertex cache-optimized) indices to
+	// lodIndices.
+	void BuildLODs(Util::Span<Core::Vertex> vertices, Util::Span<uint32_t> indices, Util::Vector<MeshLOD>& lods,
+		Util::Vector<uint32_t>& lodIndices, float maxRelativeError = 0.05f) noexcept;
+
+	// Returns the coarsest LOD whose projected error is at most maxPixelError pixels, where 0 is the
+	// full-resolution mesh and i > 0 is lods[i - 1]. distance is from the camera to the closest point of
+	// the mesh, scale is the largest scale factor of the object-to-world transformation and pixelSpreadAngle
+	// is given by Camera::GetPixelSpreadAngle().
+	uint32_t SelectLOD(Util::Span<MeshLOD> lods, float distance, float scale, float pixelSpreadAngle,
+		float maxPixelError = 1.0f) noexcept;
+}
@@ -0,0 +1,263 @@
+#include "Meshlet.h"
+#include "../Math/CollisionTypes.h"
+#include "../Math/MatrixFuncs.h"
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Model;
+
+namespace
+{
+	// Ref: J. Ritter, "An Efficient Bounding Sphere," in Graphics Gems, 1990.
+	void ComputeBoundingSphere(Span<Vertex> vertices, const uint32_t* meshletVertices, uint32_t numVertices,
+		float3& center, float& radius) noexcept
+	{
+		// initial sphere is formed by the most distant pair among the extreme points along each axis
+		uint32_t minIdx[3] = { 0, 0, 0 };
+		uint32_t maxIdx[3] = { 0, 0, 0 };
+		auto coord = [](const float3& p, int axis)
+			{
+				return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+			};
+
+		for (uint32_t i = 1; i < numVertices; i++)
+		{
+			const float3& p = vertices[meshletVertices[i]].Position;
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (coord(p, axis) < coord(vertices[meshletVertices[minIdx[axis]]].Position, axis))
+					minIdx[axis] = i;
+				if (coord(p, axis) > coord(vertices[meshletVertices[maxIdx[axis]]].Position, axis))
+					maxIdx[axis] = i;
+			}
+		}
+
+		float maxDistSq = -1.0f;
+		float3 p0;
+		float3 p1;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float3 a = vertices[meshletVertices[minIdx[axis]]].Position;
+			const float3 b = vertices[meshletVertices[maxIdx[axis]]].Position;
+			float3 d = b - a;
+			const float distSq = d.dot(d);
+
+			if (distSq > maxDistSq)
+			{
+				maxDistSq = distSq;
+				p0 = a;
+				p1 = b;
+			}
+		}
+
+		center = (p0 + p1) * 0.5f;
+		radius = sqrtf(maxDistSq) * 0.5f;
+
+		// grow the sphere to include the points that are outside
+		for (uint32_t i = 0; i < numVertices; i++)
+		{
+			float3 d = vertices[meshletVertices[i]].Position - center;
+			const float distSq = d.dot(d);
+
+			if (distSq > radius * radius)
+			{
+				const float dist = sqrtf(distSq);
+				const float newRadius = (radius + dist) * 0.5f;
+				center += d * ((newRadius - radius) / dist);
+				radius = newRadius;
+			}
+		}
+	}
+
+	void ComputeNormalCone(Span<Vertex> vertices, Span<uint32_t> indices, const Meshlet& meshlet,
+		float3& axis, float& cutoff) noexcept
+	{
+		float3 normals[Meshlet::MAX_NUM_TRIANGLES];
+		uint32_t numNormals = 0;
+		axis = float3(0.0f, 0.0f, 0.0f);
+
+		for (uint32_t t = meshlet.TriangleOffset; t < meshlet.TriangleOffset + meshlet.NumTriangles; t++)
+		{
+			const float3 v0 = vertices[indices[3 * t]].Position;
+			const float3 v1 = vertices[indices[3 * t + 1]].Position;
+			const float3 v2 = vertices[indices[3 * t + 2]].Position;
+
+			// with clockwise winding in a left-handed coordinate system, points outward
+			float3 n = (v1 - v0).cross(v2 - v0);
+			const float length = n.length();
+
+			// degenerate triangles are never visible
+			if (length == 0.0f)
+				continue;
+
+			n *= 1.0f / length;
+			normals[numNormals++] = n;
+			axis += n;
+		}
+
+		const float axisLength = axis.length();
+		cutoff = 1.0f;
+
+		if (axisLength == 0.0f)
+			return;
+
+		axis *= 1.0f / axisLength;
+		float minDot = 1.0f;
+
+		for (uint32_t i = 0; i < numNormals; i++)
+			minDot = Min(minDot, normals[i].dot(axis));
+
+		// Cone would be wider than ~84 degrees and would hardly ever be culled
+		if (minDot <= 0.1f)
+			return;
+
+		// Normals are within acos(minDot) of the axis. All the triangles are back-facing when the angle
+		// between view direction and the axis is less than 90 - acos(minDot) degrees, or equivalently,
+		// when the cosine of that angle is greater than sin(acos(minDot)).
+		cutoff = sqrtf(1.0f - minDot * minDot);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Meshlet
+//--------------------------------------------------------------------------------------
+
+void Model::BuildMeshlets(Span<Vertex> vertices, Span<uint32_t> indices, Vector<Meshlet>& meshlets,
+	Vector<uint32_t>& meshletVertices, Span<uint8_t> meshletTriangles) noexcept
+{
+	Assert(indices.size() % 3 == 0, "Invalid number of indices.");
+	Assert(meshletTriangles.size() == indices.size(), "Every triangle needs a meshlet triangle.");
+	static_assert(Meshlet::MAX_NUM_VERTICES < 0xff, "Meshlet vertex indices must fit in 8 bits.");
+
+	const uint32_t numTris = (uint32_t)(indices.size() / 3);
+	if (numTris == 0)
+		return;
+
+	const size_t baseVertex = meshletVertices.size();
+	const uint32_t* idx = indices.data();
+
+	// position of every vertex in the current meshlet, or 0xff if it's not in the meshlet
+	SmallVector<uint8_t> localIdx;
+	localIdx.resize(vertices.size(), 0xff);
+
+	Meshlet curr{};
+
+	auto finishMeshlet = [&]()
+		{
+			const uint32_t* currVertices = meshletVertices.data() + baseVertex + curr.VertexOffset;
+
+			for (uint32_t i = 0; i < curr.NumVertices; i++)
+				localIdx[currVertices[i]] = 0xff;
+
+			ComputeBoundingSphere(vertices, currVertices, curr.NumVertices, curr.Center, curr.Radius);
+			ComputeNormalCone(vertices, indices, curr, curr.ConeAxis, curr.ConeCutoff);
+			meshlets.push_back(curr);
+
+			curr = Meshlet{ .Center = float3(0.0f, 0.0f, 0.0f),
+				.Radius = 0.0f,
+				.ConeAxis = float3(0.0f, 0.0f, 0.0f),
+				.ConeCutoff = 0.0f,
+				.VertexOffset = curr.VertexOffset + curr.NumVertices,
+				.TriangleOffset = curr.TriangleOffset + curr.NumTriangles,
+				.NumVertices = 0,
+				.NumTriangles = 0 };
+		};
+
+	for (uint32_t t = 0; t < numTris; t++)
+	{
+		const uint32_t* tri = idx + 3 * t;
+		Assert(tri[0] < vertices.size() && tri[1] < vertices.size() && tri[2] < vertices.size(), "Invalid vertex index.");
+
+		// degenerate triangles may refer to the same vertex more than once
+		const uint32_t numNewVertices = (localIdx[tri[0]] == 0xff) +
+			(localIdx[tri[1]] == 0xff && tri[1] != tri[0]) +
+			(localIdx[tri[2]] == 0xff && tri[2] != tri[0] && tri[2] != tri[1]);
+
+		if (curr.NumVertices + numNewVertices > Meshlet::MAX_NUM_VERTICES ||
+			curr.NumTriangles == Meshlet::MAX_NUM_TRIANGLES)
+		{
+			finishMeshlet();
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			if (localIdx[tri[k]] == 0xff)
+			{
+				localIdx[tri[k]] = (uint8_t)curr.NumVertices++;
+				meshletVertices.push_back(tri[k]);
+			}
+		}
+
+		meshletTriangles[3 * t] = localIdx[tri[0]];
+		meshletTriangles[3 * t + 1] = localIdx[tri[1]];
+		meshletTriangles[3 * t + 2] = localIdx[tri[2]];
+		curr.NumTriangles++;
+	}
+
+	finishMeshlet();
+}
+
+void Model::CullMeshlets(Span<Meshlet> meshlets, const ViewFrustum& viewFrustum, const float4x4a& objectToView,
+	Vector<uint32_t>& visibleMeshlets) noexcept
+{
+	const v_float4x4 vM = load(objectToView);
+
+	// camera position in object space
+	const v_float4x4 vViewToObject = inverseSRT(vM);
+	const float3 cameraPos = storeFloat3(vViewToObject.vRow[3]);
+
+	// Backface test is done in object space, which gives the same result in any space as long as
+	// the transformation doesn't flip the orientation of triangles
+	const bool mirrored = _mm_cvtss_f32(det3x3(vM)) < 0.0f;
+
+	// bounding spheres are transformed to view space, scaled by the largest scale factor
+	float maxScaleSq = 0.0f;
+
+	for (int i = 0; i < 3; i++)
+	{
+		const float4a& r = objectToView.m[i];
+		maxScaleSq = Max(maxScaleSq, r.x * r.x + r.y * r.y + r.z * r.z);
+	}
+
+	const float maxScale = sqrtf(maxScaleSq);
+	const Plane planes[6] = { viewFrustum.Left, viewFrustum.Right, viewFrustum.Top, viewFrustum.Bottom,
+		viewFrustum.Near, viewFrustum.Far };
+
+	for (uint32_t i = 0; i < (uint32_t)meshlets.size(); i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+
+		// view frustum -- positive half space of every plane is inside
+		const __m128 vCenter = _mm_setr_ps(meshlet.Center.x, meshlet.Center.y, meshlet.Center.z, 1.0f);
+		float3 center = storeFloat3(mul(vM, vCenter));
+		const float radius = meshlet.Radius * maxScale;
+		bool outside = false;
+
+		for (int p = 0; p < 6; p++)
+		{
+			float3 n = planes[p].Normal;
+			outside = outside || n.dot(center) + planes[p].d < -radius;
+		}
+
+		if (outside)
+			continue;
+
+		// Normal cone -- all of the triangles are back-facing when
+		//		dot(normalize(center - cameraPos), axis) > cutoff + radius / |center - cameraPos|
+		// where the second term accounts for the triangles not being at the center
+		if (!mirrored)
+		{
+			float3 toCenter = meshlet.Center - cameraPos;
+			const float dist = toCenter.length();
+
+			if (toCenter.dot(meshlet.ConeAxis) > meshlet.ConeCutoff * dist + meshlet.Radius)
+				continue;
+		}
+
+		visibleMeshlets.push_back(i);
+	}
+}
@@ -0,0 +1,64 @@
+// Meshlets -- small clusters of a mesh's triangles that are culled (and eventually drawn)
+// independently of each other.
+//
+// Meshlets are formed by scanning the (vertex cache-optimized) index buffer in order and starting
+// a new meshlet whenever the current one runs out of vertices or triangles, so every meshlet covers
+// a contiguous range of the mesh's triangles. Triangles are stored one per triangle of the mesh
+// (parallel to the index buffer) as three consecutive 8-bit indices into the meshlet's vertices, which
+// in turn are indices into the mesh's vertices.
+//
+// This is a library only: the engine doesn't call BuildMeshlets() or CullMeshlets(), and meshlets
+// aren't built at import time or stored alongside the scene's index buffer. Nothing would read them
+// until there's a mesh shader path.
+//
+// Every meshlet has a bounding sphere and a normal cone for view frustum and backface culling.
+//
+// References:
+// 1. G. Wihlidal, "Optimizing the Graphics Pipeline with Compute," GDC, 2016.
+// 2. A. Kapoulkine, meshoptimizer, https://github.com/zeux/meshoptimizer
+
+#pragma once
+
+#include "../Core/Vertex.h"
+#include "../Math/Matrix.h"
+#include "../Utility/Span.h"
+
+namespace ZetaRay::Math
+{
+	struct ViewFrustum;
+}
+
+namespace ZetaRay::Model
+{
+	struct Meshlet
+	{
+		static constexpr uint32_t MAX_NUM_VERTICES = 64;
+		static constexpr uint32_t MAX_NUM_TRIANGLES = 124;
+
+		// bounding sphere, in object space
+		Math::float3 Center;
+		float Radius;
+		// every (non-degenerate) triangle's normal is within the cone around ConeAxis with half angle
+		// asin(ConeCutoff). ConeCutoff is 1 when the cone is too wide to be useful.
+		Math::float3 ConeAxis;
+		float ConeCutoff;
+		// relative to the mesh's first meshlet vertex
+		uint32_t VertexOffset;
+		// relative to the mesh's first triangle
+		uint32_t TriangleOffset;
+		uint32_t NumVertices;
+		uint32_t NumTriangles;
+	};
+
+	// Splits the given mesh into meshlets, which are appended to meshlets. Meshlet vertices are appended to
+	// meshletVertices, while meshletTriangles (three per triangle, same as indices) is written to.
+	void BuildMeshlets(Util::Span<Core::Vertex> vertices, Util::Span<uint32_t> indices,
+		Util::Vector<Meshlet>& meshlets, Util::Vector<uint32_t>& meshletVertices,
+		Util::Span<uint8_t> meshletTriangles) noexcept;
+
+	// CPU reference for meshlet culling. Appends indices of meshlets that (at least partially) overlap the
+	// view frustum and have at least one triangle facing the camera. View frustum is in view space and
+	// objectToView transforms from mesh's object space to view space (it may contain scaling).
+	void CullMeshlets(Util::Span<Meshlet> meshlets, const Math::ViewFrustum& viewFrustum,
+		const Math::float4x4a& objectToView, Util::Vector<uint32_t>& visibleMeshlets) noexcept;
+}
@@ -0,0 +1,245 @@
+#include "SceneCache.h"
+#include <xxHash/xxhash.h>
+#include <type_traits>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Model;
+using namespace ZetaRay::Model::glTF;
+using namespace ZetaRay::Model::glTF::Asset;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+
+namespace
+{
+	struct Header
+	{
+		static constexpr uint32_t MAGIC = 0x4e43535a;	// "ZSCN"
+		// needs to be incremented whenever the layout of the file, any of the stored types or how meshes
+		// are processed changes
+		static constexpr uint32_t VERSION = 10;
+
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t ContentHash;
+		uint64_t BufferHash;
+	};
+
+	static constexpr size_t SECTION_ALIGNMENT = 16;
+
+	// 256 KB are read from every buffer, regardless of its size
+	static constexpr size_t NUM_BUFFER_HASH_BLOCKS = 64;
+	static constexpr size_t BUFFER_HASH_BLOCK_SIZE = 4096;
+
+	ZetaInline void Append(const void* data, size_t n, Vector<uint8_t>& buffer) noexcept
+	{
+		const size_t offset = buffer.size();
+		buffer.resize(offset + n);
+
+		if (n)
+			memcpy(buffer.begin() + offset, data, n);
+	}
+
+	// Alignment is relative to the beginning of the snapshot (base), so that it can be appended to
+	// a buffer that already has some content
+	ZetaInline void AlignTo16(size_t base, Vector<uint8_t>& buffer) noexcept
+	{
+		const size_t offset = buffer.size() - base;
+		const size_t aligned = (offset + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+		const size_t n = aligned - offset;
+
+		if (n)
+		{
+			const uint8_t zeros[SECTION_ALIGNMENT] = {};
+			Append(zeros, n, buffer);
+		}
+	}
+
+	template<typename T>
+	void WriteArray(const T* data, size_t n, size_t base, Vector<uint8_t>& buffer) noexcept
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable types can be stored as is.");
+
+		const uint64_t count = n;
+		Append(&count, sizeof(count), buffer);
+		AlignTo16(base, buffer);
+		Append(data, sizeof(T) * n, buffer);
+	}
+
+	template<typename T, typename Allocator>
+	ZetaInline void WriteArray(const SmallVector<T, Allocator>& vec, size_t base, Vector<uint8_t>& buffer) noexcept
+	{
+		WriteArray(vec.begin(), vec.size(), base, buffer);
+	}
+
+	// Alignment is relative to beg, same as AlignTo16()
+	ZetaInline bool ReadCount(const uint8_t* beg, const uint8_t*& curr, const uint8_t* end, uint64_t& count) noexcept
+	{
+		if ((size_t)(end - curr) < sizeof(uint64_t))
+			return false;
+
+		memcpy(&count, curr, sizeof(uint64_t));
+		curr += sizeof(uint64_t);
+
+		const size_t offset = curr - beg;
+		const size_t aligned = (offset + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+		if ((size_t)(end - curr) < aligned - offset)
+			return false;
+
+		curr += aligned - offset;
+
+		return true;
+	}
+
+	template<typename T, typename Allocator>
+	bool ReadArray(const uint8_t* beg, const uint8_t*& curr, const uint8_t* end, SmallVector<T, Allocator>& vec) noexcept
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "only trivially copyable types can be stored as is.");
+
+		uint64_t count;
+		if (!ReadCount(beg, curr, end, count))
+			return false;
+
+		if (count > (size_t)(end - curr) / sizeof(T))
+			return false;
+
+		vec.resize(count);
+
+		if (count)
+			memcpy(vec.data(), curr, sizeof(T) * count);
+
+		curr += sizeof(T) * count;
+
+		return true;
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// SceneSnapshot
+//--------------------------------------------------------------------------------------
+
+uint64_t glTF::HashBuffer(const uint8_t* data, size_t size, uint64_t lastWriteTime, uint64_t seed) noexcept
+{
+	const uint64_t header[2] = { size, lastWriteTime };
+	uint64_t hash = XXH3_64bits_withSeed(header, sizeof(header), seed);
+
+	if (size <= NUM_BUFFER_HASH_BLOCKS * BUFFER_HASH_BLOCK_SIZE)
+		return XXH3_64bits_withSeed(data, size, hash);
+
+	// first block starts at the beginning, last one ends at the end
+	const size_t stride = (size - BUFFER_HASH_BLOCK_SIZE) / (NUM_BUFFER_HASH_BLOCKS - 1);
+
+	for (size_t i = 0; i < NUM_BUFFER_HASH_BLOCKS; i++)
+	{
+		const size_t offset = i < NUM_BUFFER_HASH_BLOCKS - 1 ? i * stride : size - BUFFER_HASH_BLOCK_SIZE;
+		hash = XXH3_64bits_withSeed(data + offset, BUFFER_HASH_BLOCK_SIZE, hash);
+	}
+
+	return hash;
+}
+
+void glTF::SerializeSceneSnapshot(const SceneSnapshot& scene, uint64_t contentHash, Vector<uint8_t>& buffer) noexcept
+{
+	Assert(scene.Meshes.size() == scene.MeshBVHs.size(), "every mesh must have a BVH.");
+
+	const size_t base = buffer.size();
+	buffer.reserve(base + sizeof(Header) + scene.Vertices.size() * sizeof(Core::Vertex) + 
+		scene.Indices.size() * sizeof(uint32_t));
+
+	const Header header{ .Magic = Header::MAGIC,
+		.Version = Header::VERSION,
+		.ContentHash = contentHash,
+		.BufferHash = scene.BufferHash };
+	Append(&header, sizeof(Header), buffer);
+
+	WriteArray(scene.BufferURIs, base, buffer);
+	WriteArray(scene.Vertices, base, buffer);
+	WriteArray(scene.Indices, base, buffer);
+	WriteArray(scene.LODs, base, buffer);
+	WriteArray(scene.LODIndices, base, buffer);
+	WriteArray(scene.Meshes, base, buffer);
+
+	// MeshBVH has its own format
+	const uint64_t numBVHs = scene.MeshBVHs.size();
+	Append(&numBVHs, sizeof(numBVHs), buffer);
+
+	for (auto& bvh : scene.MeshBVHs)
+		bvh.Serialize(buffer);
+
+	WriteArray(scene.ImageURIs, base, buffer);
+	WriteArray(scene.Materials, base, buffer);
+	WriteArray(scene.Instances, base, buffer);
+}
+
+bool glTF::DeserializeSceneSnapshot(const uint8_t* beg, const uint8_t* end, uint64_t contentHash,
+	SceneSnapshot& scene) noexcept
+{
+	if ((size_t)(end - beg) < sizeof(Header))
+		return false;
+
+	Header header;
+	memcpy(&header, beg, sizeof(Header));
+
+	if (header.Magic != Header::MAGIC || header.Version != Header::VERSION || header.ContentHash != contentHash)
+		return false;
+
+	scene.BufferHash = header.BufferHash;
+	const uint8_t* curr = beg + sizeof(Header);
+
+	if (!ReadArray(beg, curr, end, scene.BufferURIs) ||
+		!ReadArray(beg, curr, end, scene.Vertices) ||
+		!ReadArray(beg, curr, end, scene.Indices) ||
+		!ReadArray(beg, curr, end, scene.LODs) ||
+		!ReadArray(beg, curr, end, scene.LODIndices) ||
+		!ReadArray(beg, curr, end, scene.Meshes))
+		return false;
+
+	uint64_t numBVHs;
+	if ((size_t)(end - curr) < sizeof(numBVHs))
+		return false;
+
+	memcpy(&numBVHs, curr, sizeof(numBVHs));
+	curr += sizeof(numBVHs);
+
+	if (numBVHs != scene.Meshes.size())
+		return false;
+
+	scene.MeshBVHs.clear();
+	scene.MeshBVHs.resize(numBVHs);
+
+	for (auto& bvh : scene.MeshBVHs)
+	{
+		if (!bvh.Deserialize(curr, end))
+			return false;
+	}
+
+	if (!ReadArray(beg, curr, end, scene.ImageURIs) ||
+		!ReadArray(beg, curr, end, scene.Materials) ||
+		!ReadArray(beg, curr, end, scene.Instances))
+		return false;
+
+	// make sure the references are in bounds
+	for (auto& mesh : scene.Meshes)
+	{
+		if ((size_t)mesh.BaseVtxOffset + mesh.NumVertices > scene.Vertices.size() ||
+			(size_t)mesh.BaseIdxOffset + mesh.NumIndices > scene.Indices.size())
+			return false;
+
+		if ((size_t)mesh.BaseLODOffset + mesh.NumLODs > scene.LODs.size() ||
+			(size_t)mesh.BaseLODIdxOffset + mesh.NumLODIndices > scene.LODIndices.size())
+			return false;
+
+		for (uint32_t i = mesh.BaseLODOffset; i < mesh.BaseLODOffset + mesh.NumLODs; i++)
+		{
+			if ((size_t)scene.LODs[i].IdxOffset + scene.LODs[i].NumIndices > mesh.NumLODIndices)
+				return false;
+		}
+	}
+
+	if (!scene.ImageURIs.empty() && scene.ImageURIs.back() != '\0')
+		return false;
+
+	if (!scene.BufferURIs.empty() && scene.BufferURIs.back() != '\0')
+		return false;
+
+	return curr == end;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "glTFAsset.h"
+#include "MeshSimplifier.h"
+#include "../Math/MeshBVH.h"
+#include "../Utility/SmallVector.h"
+
+namespace ZetaRay::Model::glTF
+{
+	//--------------------------------------------------------------------------------------
+	// Binary snapshot of a processed glTF scene, so that later loads can skip parsing JSON, decoding
+	// accessors and building mesh BVHs. File starts with a header and is followed by one section
+	// per member of SceneSnapshot (in order of declaration). Every section is a count followed by
+	// its (16-byte aligned) elements. There aren't any pointers, only counts, so the file is memory
+	// mapped and every section is copied once, straight into the array that's handed to SceneCore.
+	// Scene graph and the instance BVH aren't part of it, as they're shared with the other scenes;
+	// instances are stored parents first, so that inserting them is a single pass.
+	//--------------------------------------------------------------------------------------
+
+	struct SceneSnapshot
+	{
+		// URI of every buffer that's a separate file (relative to the glTF file, each followed by a null
+		// terminator) and the combined HashBuffer() of all of them, which is used to detect changes to 
+		// buffers. A .glb file lists itself.
+		Util::SmallVector<char> BufferURIs;
+		uint64_t BufferHash = 0;
+
+		Util::SmallVector<Core::Vertex> Vertices;
+		Util::SmallVector<uint32_t> Indices;
+		Util::SmallVector<MeshLOD> LODs;
+		// indices of every LOD, kept apart from Indices since their number isn't known ahead of time
+		Util::SmallVector<uint32_t> LODIndices;
+		Util::SmallVector<Asset::MeshSubset> Meshes;
+		// i'th BVH belongs to i'th mesh
+		Util::SmallVector<Math::MeshBVH> MeshBVHs;
+		// URI of every image (relative to the glTF file) followed by a null terminator. Images without
+		// a URI are empty strings.
+		Util::SmallVector<char> ImageURIs;
+		// texture paths are indices into images rather than hashes of the full path, so that the cache
+		// remains valid if the asset directory is moved
+		Util::SmallVector<Asset::MaterialDesc> Materials;
+		// parents come before their children
+		Util::SmallVector<Asset::InstanceDesc> Instances;
+	};
+
+	// Identifies the contents of a buffer without reading all of it -- combines its size, last write
+	// time and a few blocks that are spread evenly over it (or the whole buffer if it's small). Hashes 
+	// of several buffers are combined by passing the previous one as seed.
+	uint64_t HashBuffer(const uint8_t* data, size_t size, uint64_t lastWriteTime, uint64_t seed) noexcept;
+
+	// Appends the serialized snapshot to the end of given buffer. contentHash identifies the glTF
+	// file that the snapshot was created from.
+	void SerializeSceneSnapshot(const SceneSnapshot& scene, uint64_t contentHash, Util::Vector<uint8_t>& buffer) noexcept;
+
+	// Returns false if data is truncated or stale (different format version or content hash)
+	bool DeserializeSceneSnapshot(const uint8_t* beg, const uint8_t* end, uint64_t contentHash,
+		SceneSnapshot& scene) noexcept;
+}
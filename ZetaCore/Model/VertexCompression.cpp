@@ -0,0 +1,338 @@
+#include "VertexCompression.h"
+#include "../Math/BatchFuncs.h"
+#include "../Math/Common.h"
+
+using namespace ZetaRay;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Model;
+
+namespace
+{
+	using VFloat = simd<float, 8>;
+
+	enum COMPONENT
+	{
+		POSITION = 0,
+		NORMAL = 3,
+		TANGENT = 6,
+		NUM_COMPONENTS = 9
+	};
+
+	// Attributes of a group of vertices in structure-of-arrays form. Normals and tangents are either
+	// vectors or octahedral coordinates (first two components), depending on the stage.
+	struct Batch
+	{
+		alignas(32) float Lanes[NUM_COMPONENTS][VFloat::Width];
+	};
+
+	struct Quantization
+	{
+		explicit Quantization(const AABB& aabb) noexcept
+		{
+			const float3 size = aabb.Extents * 2.0f;
+			Min = aabb.Center - aabb.Extents;
+
+			// degenerate axes (e.g. flat meshes) are quantized to zero
+			Scale = float3(size.x > 0.0f ? 65535.0f / size.x : 0.0f,
+				size.y > 0.0f ? 65535.0f / size.y : 0.0f,
+				size.z > 0.0f ? 65535.0f / size.z : 0.0f);
+			InvScale = size * (1.0f / 65535.0f);
+		}
+
+		float3 Min;
+		float3 Scale;
+		float3 InvScale;
+	};
+
+	// Maps unit vector n to a point in [-1, 1]^2
+	ZetaInline void OctEncode(const soa_float3<VFloat>& n, VFloat& u, VFloat& v) noexcept
+	{
+		const VFloat vL1 = abs(n.x) + abs(n.y) + abs(n.z);
+		const VFloat vInvL1 = select(vL1 > VFloat(0.0f), VFloat(1.0f) / vL1, VFloat(0.0f));
+		const VFloat vX = n.x * vInvL1;
+		const VFloat vY = n.y * vInvL1;
+
+		// lower hemisphere is folded over the diagonals
+		const VFloat vSignX = select(vX >= VFloat(0.0f), VFloat(1.0f), VFloat(-1.0f));
+		const VFloat vSignY = select(vY >= VFloat(0.0f), VFloat(1.0f), VFloat(-1.0f));
+		const auto vLower = n.z < VFloat(0.0f);
+
+		u = select(vLower, (VFloat(1.0f) - abs(vY)) * vSignX, vX);
+		v = select(vLower, (VFloat(1.0f) - abs(vX)) * vSignY, vY);
+	}
+
+	ZetaInline soa_float3<VFloat> OctDecode(const VFloat& u, const VFloat& v) noexcept
+	{
+		// Ref: https://twitter.com/Stubbesaurus/status/937994790553227264
+		const VFloat vZ = VFloat(1.0f) - abs(u) - abs(v);
+		const VFloat vT = Max(-vZ, VFloat(0.0f));
+		const VFloat vX = u + select(u >= VFloat(0.0f), -vT, vT);
+		const VFloat vY = v + select(v >= VFloat(0.0f), -vT, vT);
+
+		const VFloat vInvLength = VFloat(1.0f) / sqrt(fmadd(vX, vX, fmadd(vY, vY, vZ * vZ)));
+
+		return soa_float3<VFloat>(vX * vInvLength, vY * vInvLength, vZ * vInvLength);
+	}
+
+	// Scales to the given range and adds +-0.5 so that converting to integer (which truncates) rounds
+	// to nearest
+	ZetaInline VFloat PrepareForRounding(const VFloat& f, float scale, float minVal, float maxVal) noexcept
+	{
+		const VFloat vF = Min(Max(f * VFloat(scale), VFloat(minVal)), VFloat(maxVal));
+		return vF + select(vF >= VFloat(0.0f), VFloat(0.5f), VFloat(-0.5f));
+	}
+
+	ZetaInline soa_float3<VFloat> LoadFloat3(const Batch& batch, int component) noexcept
+	{
+		return soa_float3<VFloat>(VFloat::load(batch.Lanes[component]), VFloat::load(batch.Lanes[component + 1]),
+			VFloat::load(batch.Lanes[component + 2]));
+	}
+
+	ZetaInline soa_float3<VFloat> NormalizeOrZero(const soa_float3<VFloat>& v) noexcept
+	{
+		const VFloat vLengthSq = dot(v, v);
+		const VFloat vInvLength = select(vLengthSq > VFloat(0.0f), VFloat(1.0f) / sqrt(vLengthSq), VFloat(0.0f));
+
+		return soa_float3<VFloat>(v.x * vInvLength, v.y * vInvLength, v.z * vInvLength);
+	}
+
+	struct DecodedBatch
+	{
+		soa_float3<VFloat> Position;
+		soa_float3<VFloat> Normal;
+		soa_float3<VFloat> Tangent;
+	};
+
+	// Unused lanes of the last group are left as zeros
+	void GatherCompressed(const CompressedVertex* vertices, int n, Batch& batch) noexcept
+	{
+		for (int lane = 0; lane < VFloat::Width; lane++)
+		{
+			const bool valid = lane < n;
+
+			for (int c = 0; c < 3; c++)
+				batch.Lanes[POSITION + c][lane] = valid ? (float)vertices[lane].Position[c] : 0.0f;
+
+			for (int c = 0; c < 2; c++)
+			{
+				batch.Lanes[NORMAL + c][lane] = valid ? (float)vertices[lane].Normal[c] : 0.0f;
+				batch.Lanes[TANGENT + c][lane] = valid ? (float)vertices[lane].Tangent[c] : 0.0f;
+			}
+		}
+	}
+
+	DecodedBatch DecodeBatch(const Batch& batch, const Quantization& q) noexcept
+	{
+		DecodedBatch ret;
+		const soa_float3<VFloat> vQ = LoadFloat3(batch, POSITION);
+		ret.Position = soa_float3<VFloat>(fmadd(vQ.x, VFloat(q.InvScale.x), VFloat(q.Min.x)),
+			fmadd(vQ.y, VFloat(q.InvScale.y), VFloat(q.Min.y)),
+			fmadd(vQ.z, VFloat(q.InvScale.z), VFloat(q.Min.z)));
+
+		const VFloat vSnormScale(1.0f / 32767.0f);
+		ret.Normal = OctDecode(VFloat::load(batch.Lanes[NORMAL]) * vSnormScale,
+			VFloat::load(batch.Lanes[NORMAL + 1]) * vSnormScale);
+		ret.Tangent = OctDecode(VFloat::load(batch.Lanes[TANGENT]) * vSnormScale,
+			VFloat::load(batch.Lanes[TANGENT + 1]) * vSnormScale);
+
+		return ret;
+	}
+
+	ZetaInline void StoreFloat3(const soa_float3<VFloat>& v, Batch& batch, int component) noexcept
+	{
+		v.x.store(batch.Lanes[component]);
+		v.y.store(batch.Lanes[component + 1]);
+		v.z.store(batch.Lanes[component + 2]);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// VertexCompression
+//--------------------------------------------------------------------------------------
+
+void VertexCompression::Encode(Span<Vertex> vertices, const AABB& aabb, Span<CompressedVertex> out) noexcept
+{
+	Assert(out.size() >= vertices.size(), "out must have room for every vertex.");
+	const Quantization q(aabb);
+	Batch batch;
+
+	for (size_t base = 0; base < vertices.size(); base += VFloat::Width)
+	{
+		const int n = (int)Math::Min(vertices.size() - base, (size_t)VFloat::Width);
+
+		for (int lane = 0; lane < VFloat::Width; lane++)
+		{
+			const Vertex v = lane < n ? vertices[base + lane] : Vertex{};
+			const float3 normal(v.Normal);
+			const float3 tangent(v.Tangent);
+
+			batch.Lanes[POSITION][lane] = v.Position.x;
+			batch.Lanes[POSITION + 1][lane] = v.Position.y;
+			batch.Lanes[POSITION + 2][lane] = v.Position.z;
+			batch.Lanes[NORMAL][lane] = normal.x;
+			batch.Lanes[NORMAL + 1][lane] = normal.y;
+			batch.Lanes[NORMAL + 2][lane] = normal.z;
+			batch.Lanes[TANGENT][lane] = tangent.x;
+			batch.Lanes[TANGENT + 1][lane] = tangent.y;
+			batch.Lanes[TANGENT + 2][lane] = tangent.z;
+		}
+
+		const soa_float3<VFloat> vPos = LoadFloat3(batch, POSITION);
+		const soa_float3<VFloat> vNormal = LoadFloat3(batch, NORMAL);
+		const soa_float3<VFloat> vTangent = LoadFloat3(batch, TANGENT);
+
+		PrepareForRounding(vPos.x - VFloat(q.Min.x), q.Scale.x, 0.0f, 65535.0f).store(batch.Lanes[POSITION]);
+		PrepareForRounding(vPos.y - VFloat(q.Min.y), q.Scale.y, 0.0f, 65535.0f).store(batch.Lanes[POSITION + 1]);
+		PrepareForRounding(vPos.z - VFloat(q.Min.z), q.Scale.z, 0.0f, 65535.0f).store(batch.Lanes[POSITION + 2]);
+
+		VFloat vU;
+		VFloat vV;
+		OctEncode(vNormal, vU, vV);
+		PrepareForRounding(vU, 32767.0f, -32767.0f, 32767.0f).store(batch.Lanes[NORMAL]);
+		PrepareForRounding(vV, 32767.0f, -32767.0f, 32767.0f).store(batch.Lanes[NORMAL + 1]);
+
+		OctEncode(vTangent, vU, vV);
+		PrepareForRounding(vU, 32767.0f, -32767.0f, 32767.0f).store(batch.Lanes[TANGENT]);
+		PrepareForRounding(vV, 32767.0f, -32767.0f, 32767.0f).store(batch.Lanes[TANGENT + 1]);
+
+		for (int lane = 0; lane < n; lane++)
+		{
+			CompressedVertex& cv = out[base + lane];
+
+			for (int c = 0; c < 3; c++)
+				cv.Position[c] = (uint16_t)batch.Lanes[POSITION + c][lane];
+
+			for (int c = 0; c < 2; c++)
+			{
+				cv.Normal[c] = (int16_t)batch.Lanes[NORMAL + c][lane];
+				cv.Tangent[c] = (int16_t)batch.Lanes[TANGENT + c][lane];
+			}
+
+			cv.TexUV = half2(vertices[base + lane].TexUV);
+			cv.Pad = 0;
+		}
+	}
+}
+
+void VertexCompression::Decode(Span<CompressedVertex> vertices, const AABB& aabb, Span<Vertex> out) noexcept
+{
+	Assert(out.size() >= vertices.size(), "out must have room for every vertex.");
+	const Quantization q(aabb);
+	Batch batch;
+
+	for (size_t base = 0; base < vertices.size(); base += VFloat::Width)
+	{
+		const int n = (int)Math::Min(vertices.size() - base, (size_t)VFloat::Width);
+		GatherCompressed(vertices.data() + base, n, batch);
+
+		const DecodedBatch decoded = DecodeBatch(batch, q);
+		StoreFloat3(decoded.Position, batch, POSITION);
+		StoreFloat3(decoded.Normal, batch, NORMAL);
+		StoreFloat3(decoded.Tangent, batch, TANGENT);
+
+		for (int lane = 0; lane < n; lane++)
+		{
+			Vertex& v = out[base + lane];
+			v.Position = float3(batch.Lanes[POSITION][lane], batch.Lanes[POSITION + 1][lane],
+				batch.Lanes[POSITION + 2][lane]);
+			v.Normal = half3(float3(batch.Lanes[NORMAL][lane], batch.Lanes[NORMAL + 1][lane],
+				batch.Lanes[NORMAL + 2][lane]));
+			v.Tangent = half3(float3(batch.Lanes[TANGENT][lane], batch.Lanes[TANGENT + 1][lane],
+				batch.Lanes[TANGENT + 2][lane]));
+			v.TexUV = float2(vertices[base + lane].TexUV);
+		}
+	}
+}
+
+VertexCompression::QuantizationError VertexCompression::MeasureError(Span<Vertex> vertices,
+	Span<CompressedVertex> compressed, const AABB& aabb) noexcept
+{
+	Assert(compressed.size() == vertices.size(), "Every vertex should have a compressed counterpart.");
+	const Quantization q(aabb);
+	Batch batch;
+	Batch original;
+
+	VFloat vMaxPosErrSq(0.0f);
+	// angles are measured with the chord length, which unlike acos(dot) remains accurate for small angles
+	VFloat vMaxNormalChordSq(0.0f);
+	VFloat vMaxTangentChordSq(0.0f);
+	float maxUVErr = 0.0f;
+
+	for (size_t base = 0; base < vertices.size(); base += VFloat::Width)
+	{
+		const int n = (int)Math::Min(vertices.size() - base, (size_t)VFloat::Width);
+		GatherCompressed(compressed.data() + base, n, batch);
+
+		// unused lanes are zero in both, so they don't contribute
+		for (int lane = 0; lane < VFloat::Width; lane++)
+		{
+			const Vertex v = lane < n ? vertices[base + lane] : Vertex{};
+			const float3 normal(v.Normal);
+			const float3 tangent(v.Tangent);
+
+			original.Lanes[POSITION][lane] = v.Position.x;
+			original.Lanes[POSITION + 1][lane] = v.Position.y;
+			original.Lanes[POSITION + 2][lane] = v.Position.z;
+			original.Lanes[NORMAL][lane] = normal.x;
+			original.Lanes[NORMAL + 1][lane] = normal.y;
+			original.Lanes[NORMAL + 2][lane] = normal.z;
+			original.Lanes[TANGENT][lane] = tangent.x;
+			original.Lanes[TANGENT + 1][lane] = tangent.y;
+			original.Lanes[TANGENT + 2][lane] = tangent.z;
+
+			if (lane < n)
+			{
+				const float2 uv(compressed[base + lane].TexUV);
+				maxUVErr = Math::Max(maxUVErr, Math::Max(fabsf(uv.x - v.TexUV.x), fabsf(uv.y - v.TexUV.y)));
+			}
+		}
+
+		DecodedBatch decoded = DecodeBatch(batch, q);
+		const soa_float3<VFloat> vPos = LoadFloat3(original, POSITION);
+		const soa_float3<VFloat> vNormal = NormalizeOrZero(LoadFloat3(original, NORMAL));
+		const soa_float3<VFloat> vTangent = NormalizeOrZero(LoadFloat3(original, TANGENT));
+
+		// mask out unused lanes, which decode to the AABB's min
+		const soa_float3<VFloat> vPosErr(decoded.Position.x - vPos.x, decoded.Position.y - vPos.y,
+			decoded.Position.z - vPos.z);
+		alignas(32) float used[VFloat::Width];
+		for (int lane = 0; lane < VFloat::Width; lane++)
+			used[lane] = lane < n ? 1.0f : 0.0f;
+
+		vMaxPosErrSq = Max(vMaxPosErrSq, dot(vPosErr, vPosErr) * VFloat::load(used));
+
+		const soa_float3<VFloat> vNormalChord(decoded.Normal.x - vNormal.x, decoded.Normal.y - vNormal.y,
+			decoded.Normal.z - vNormal.z);
+		const soa_float3<VFloat> vTangentChord(decoded.Tangent.x - vTangent.x, decoded.Tangent.y - vTangent.y,
+			decoded.Tangent.z - vTangent.z);
+		vMaxNormalChordSq = Max(vMaxNormalChordSq, select(dot(vNormal, vNormal) > VFloat(0.0f),
+			dot(vNormalChord, vNormalChord), VFloat(0.0f)));
+		vMaxTangentChordSq = Max(vMaxTangentChordSq, select(dot(vTangent, vTangent) > VFloat(0.0f),
+			dot(vTangentChord, vTangentChord), VFloat(0.0f)));
+	}
+
+	alignas(32) float lanes[3][VFloat::Width];
+	vMaxPosErrSq.store(lanes[0]);
+	vMaxNormalChordSq.store(lanes[1]);
+	vMaxTangentChordSq.store(lanes[2]);
+
+	QuantizationError err;
+	err.MaxTexUV = maxUVErr;
+	float maxNormalChord = 0.0f;
+	float maxTangentChord = 0.0f;
+
+	for (int lane = 0; lane < VFloat::Width; lane++)
+	{
+		err.MaxPosition = Math::Max(err.MaxPosition, sqrtf(lanes[0][lane]));
+		maxNormalChord = Math::Max(maxNormalChord, sqrtf(lanes[1][lane]));
+		maxTangentChord = Math::Max(maxTangentChord, sqrtf(lanes[2][lane]));
+	}
+
+	// chord of length c subtends an angle of 2 asin(c / 2)
+	err.MaxNormalAngle = 2.0f * asinf(Math::Min(maxNormalChord * 0.5f, 1.0f));
+	err.MaxTangentAngle = 2.0f * asinf(Math::Min(maxTangentChord * 0.5f, 1.0f));
+
+	return err;
+}
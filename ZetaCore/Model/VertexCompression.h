@@ -0,0 +1,44 @@
+// Compression of vertex attributes into Core::CompressedVertex:
+//
+//  1. Positions are quantized to 16 bits per component relative to the mesh's AABB, so the error
+//     along each axis is at most half of 1/65535th of the AABB's size along that axis.
+//  2. Normals and tangents are octahedral-encoded with 16-bit snorm components, which takes two thirds
+//     of the space of half3 while being more accurate (angular error is at most around 0.004 degrees).
+//     Zero vectors can't be represented and decode to (0, 0, 1).
+//  3. Texture coordinates are stored in half precision.
+//
+// Encoding and decoding are done simd<float, 8>::Width vertices at a time: attributes are gathered in
+// structure-of-arrays form and quantized or reconstructed for the whole group at once.
+//
+// References:
+// 1. Z. Cigolle, S. Donow, D. Evangelakos, M. Mara, M. McGuire and Q. Meyer, "A Survey of Efficient
+//    Representations for Independent Unit Vectors," Journal of Computer Graphics Techniques, 2014.
+
+#pragma once
+
+#include "../Core/Vertex.h"
+#include "../Math/CollisionTypes.h"
+#include "../Utility/Span.h"
+
+namespace ZetaRay::Model::VertexCompression
+{
+	struct QuantizationError
+	{
+		// distance in object space
+		float MaxPosition = 0.0f;
+		// in radians
+		float MaxNormalAngle = 0.0f;
+		float MaxTangentAngle = 0.0f;
+		float MaxTexUV = 0.0f;
+	};
+
+	// aabb should contain every vertex (e.g. TriangleMesh::m_AABB), positions outside of it are clamped
+	void Encode(Util::Span<Core::Vertex> vertices, const Math::AABB& aabb, Util::Span<Core::CompressedVertex> out) noexcept;
+	// aabb must be the same one that was used for encoding
+	void Decode(Util::Span<Core::CompressedVertex> vertices, const Math::AABB& aabb, Util::Span<Core::Vertex> out) noexcept;
+
+	// Largest difference between vertices and their compressed form. Normals and tangents of zero
+	// length are skipped.
+	QuantizationError MeasureError(Util::Span<Core::Vertex> vertices, Util::Span<Core::CompressedVertex> compressed,
+		const Math::AABB& aabb) noexcept;
+}
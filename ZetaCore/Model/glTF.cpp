@@ -1,14 +1,22 @@
 #include "glTF.h"
 #include "glTFAsset.h"
+#include "SceneCache.h"
+#include "AccessorDecoder.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Mesh.h"
 #include "../Math/MatrixFuncs.h"
 #include "../Math/Surface.h"
 #include "../Math/Quaternion.h"
+#include "../Math/MeshBVH.h"
 #include "../Scene/SceneCore.h"
 #include "../RayTracing/RtCommon.h"
 #include "../Support/Task.h"
 #include "../Core/RendererCore.h"
 #include "../Core/GpuMemory.h"
 #include "../App/Log.h"
+#include "../App/Filesystem.h"
+#include "../App/Timer.h"
 #include "../Support/ThreadSafeMemoryArena.h"
 #include "../Utility/Utility.h"
 #include <algorithm>
@@ -74,126 +82,421 @@ namespace
 	}
 #endif
 	
-	void ProcessPositions(const cgltf_data& model, const cgltf_accessor& accessor, Span<Vertex> vertices, uint32_t baseOffset) noexcept
+	AccessorView GetAccessorView(const cgltf_accessor& accessor, const char* name) noexcept
 	{
-		Check(accessor.type == cgltf_type_vec3, "Invalid type for POSITION attribute.");
-		Check(accessor.component_type == cgltf_component_type_r_32f,
-			"Invalid component type for POSITION attribute.");
+		Check(!accessor.is_sparse, "Sparse accessors are not supported (%s).", name);
+		Check(accessor.buffer_view, "Accessor without a buffer view (%s).", name);
 
-		const cgltf_buffer_view& bufferView = *accessor.buffer_view;
-		Check(accessor.stride == sizeof(float3), "Invalid stride for POSITION attribute.");
+		ACCESSOR_COMPONENT_TYPE componentType = ACCESSOR_COMPONENT_TYPE::FLOAT32;
+
+		switch (accessor.component_type)
+		{
+		case cgltf_component_type_r_8:
+			componentType = ACCESSOR_COMPONENT_TYPE::INT8;
+			break;
+		case cgltf_component_type_r_8u:
+			componentType = ACCESSOR_COMPONENT_TYPE::UINT8;
+			break;
+		case cgltf_component_type_r_16:
+			componentType = ACCESSOR_COMPONENT_TYPE::INT16;
+			break;
+		case cgltf_component_type_r_16u:
+			componentType = ACCESSOR_COMPONENT_TYPE::UINT16;
+			break;
+		case cgltf_component_type_r_32u:
+			componentType = ACCESSOR_COMPONENT_TYPE::UINT32;
+			break;
+		case cgltf_component_type_r_32f:
+			componentType = ACCESSOR_COMPONENT_TYPE::FLOAT32;
+			break;
+		default:
+			Check(false, "Invalid component type for %s.", name);
+		}
 
+		const cgltf_buffer_view& bufferView = *accessor.buffer_view;
 		const cgltf_buffer& buffer = *bufferView.buffer;
-		const float3* start = reinterpret_cast<float3*>(reinterpret_cast<uintptr_t>(buffer.data) + bufferView.offset + accessor.offset);
 
-		for (size_t i = 0; i < accessor.count; i++)
+		// stride is either the buffer view's stride or the element size when it's tightly packed
+		return AccessorView{ .Data = reinterpret_cast<const uint8_t*>(buffer.data) + bufferView.offset + accessor.offset,
+			.Count = accessor.count,
+			.Stride = (uint32_t)accessor.stride,
+			.ComponentType = componentType,
+			.Normalized = accessor.normalized != 0 };
+	}
+
+	// Besides floats, KHR_mesh_quantization allows (normalized) signed integers for normals and tangents 
+	// and any 8- or 16-bit integer for positions and texture coordinates
+	ZetaInline bool IsValidSnorm(const cgltf_accessor& accessor) noexcept
+	{
+		return accessor.component_type == cgltf_component_type_r_32f ||
+			(accessor.normalized && (accessor.component_type == cgltf_component_type_r_8 ||
+				accessor.component_type == cgltf_component_type_r_16));
+	}
+
+	ZetaInline bool IsValidQuantized(const cgltf_accessor& accessor) noexcept
+	{
+		return accessor.component_type != cgltf_component_type_r_32u && 
+			accessor.component_type != cgltf_component_type_invalid;
+	}
+
+	void ProcessVertices(const cgltf_primitive& prim, int posIt, int normalIt, int texIt, int tangentIt, 
+		Span<Vertex> vertices, uint32_t baseOffset) noexcept
+	{
+		const cgltf_accessor& pos = *prim.attributes[posIt].data;
+		Check(pos.type == cgltf_type_vec3, "Invalid type for POSITION attribute.");
+		Check(IsValidQuantized(pos), "Invalid component type for POSITION attribute.");
+
+		const cgltf_accessor& normal = *prim.attributes[normalIt].data;
+		Check(normal.type == cgltf_type_vec3, "Invalid type for NORMAL attribute.");
+		Check(IsValidSnorm(normal), "Invalid component type for NORMAL attribute.");
+
+		VertexAccessors accessors{ .Position = GetAccessorView(pos, "POSITION"),
+			.Normal = GetAccessorView(normal, "NORMAL") };
+
+		if (texIt != -1)
 		{
-			const float3* curr = start + i;
+			const cgltf_accessor& texCoord = *prim.attributes[texIt].data;
+			Check(texCoord.type == cgltf_type_vec2, "Invalid type for TEXCOORD_0 attribute.");
+			Check(IsValidQuantized(texCoord), "Invalid component type for TEXCOORD_0 attribute.");
 
-			// glTF uses a right-handed coordinate system with +Y as up
-			vertices[baseOffset + i].Position = float3(curr->x, curr->y, -curr->z);
+			accessors.TexCoord = GetAccessorView(texCoord, "TEXCOORD_0");
+
+			// tangents are only used along with texture coordinates
+			if (tangentIt != -1)
+			{
+				const cgltf_accessor& tangent = *prim.attributes[tangentIt].data;
+				Check(tangent.type == cgltf_type_vec4, "Invalid type for TANGENT attribute.");
+				Check(IsValidSnorm(tangent), "Invalid component type for TANGENT attribute.");
+
+				accessors.Tangent = GetAccessorView(tangent, "TANGENT");
+			}
 		}
+
+		DecodeVertices(accessors, Span(vertices.begin() + baseOffset, pos.count));
 	}
 
-	void ProcessNormals(const cgltf_data& model, const cgltf_accessor& accessor, Span<Vertex> vertices, uint32_t baseOffset) noexcept
+	void ProcessIndices(const cgltf_data& model, const cgltf_accessor& accessor, Span<uint32_t> indices, uint32_t baseOffset) noexcept
 	{
-		Check(accessor.type == cgltf_type_vec3, "Invalid type for NORMAL attribute.");
-		Check(accessor.component_type == cgltf_component_type_r_32f,
-			"Invalid component type for NORMAL attribute.");
+		Check(accessor.type == cgltf_type_scalar, "Invalid index type.");
+		Check(accessor.component_type == cgltf_component_type_r_8u || accessor.component_type == cgltf_component_type_r_16u ||
+			accessor.component_type == cgltf_component_type_r_32u, "Invalid component type for indices.");
+		Check(accessor.count % 3 == 0, "invalid number of indices");
 
-		const cgltf_buffer_view& bufferView = *accessor.buffer_view;
-		Check(accessor.stride == sizeof(float3), "Invalid stride for NORMAL attribute.");
+		// indices must be tightly packed
+		const AccessorView view = GetAccessorView(accessor, "indices");
+		const uint32_t indexSize = accessor.component_type == cgltf_component_type_r_8u ? 1 :
+			(accessor.component_type == cgltf_component_type_r_16u ? 2 : 4);
+		Check(view.Stride == indexSize, "Invalid index stride.");
 
-		const cgltf_buffer& buffer = *bufferView.buffer;
-		const float3* start = reinterpret_cast<float3*>(reinterpret_cast<uintptr_t>(buffer.data) + bufferView.offset + accessor.offset);
+		// use a clockwise ordering
+		DecodeIndices(view, Span(indices.begin() + baseOffset, accessor.count));
+	}
+
+	void FindVertexAttributes(const cgltf_primitive& prim, int& posIt, int& normalIt, int& texIt, int& tangentIt) noexcept
+	{
+		posIt = -1;
+		normalIt = -1;
+		texIt = -1;
+		tangentIt = -1;
 
-		for (size_t i = 0; i < accessor.count; i++)
+		for (int attrib = 0; attrib < prim.attributes_count; attrib++)
 		{
-			const float3* curr = start + i;
+			if(strcmp(prim.attributes[attrib].name, "POSITION") == 0)
+				posIt = attrib;
+			else if (strcmp(prim.attributes[attrib].name, "NORMAL") == 0)
+				normalIt = attrib;
+			else if (strcmp(prim.attributes[attrib].name, "TEXCOORD_0") == 0)
+				texIt = attrib;
+			else if (strcmp(prim.attributes[attrib].name, "TANGENT") == 0)
+				tangentIt = attrib;
+		}
+	}
+
+	// POSITION, NORMAL, TEXCOORD_0 & TANGENT along with the indices
+	void DecodeGeometry(const cgltf_data& model, const cgltf_primitive& prim, int posIt, int normalIt, int texIt, 
+		int tangentIt, Span<Vertex> vertices, uint32_t baseVtxOffset, Span<uint32_t> indices, uint32_t baseIdxOffset) noexcept
+	{
+		const uint32_t numVertices = (uint32_t)prim.attributes[posIt].data->count;
+		const uint32_t numIndices = (uint32_t)prim.indices->count;
+
+		ProcessVertices(prim, posIt, normalIt, texIt, tangentIt, vertices, baseVtxOffset);
+		ProcessIndices(model, *prim.indices, indices, baseIdxOffset);
 
-			// glTF uses a right-handed coordinate system with +Y as up
-			vertices[baseOffset + i].Normal = half3(curr->x, curr->y, -curr->z);
+		// if vertex tangents aren't present, compute them. Make sure the computation happens after 
+		// vertex & index processing
+		if (texIt != -1 && tangentIt == -1)
+		{
+			Math::ComputeMeshTangentVectors(Span(vertices.begin() + baseVtxOffset, numVertices),
+				Span(indices.begin() + baseIdxOffset, numIndices),
+				false);
 		}
 	}
 
-	void ProcessTexCoords(const cgltf_data& model, const cgltf_accessor& accessor, Span<Vertex> vertices, uint32_t baseOffset) noexcept
+	// Decoding only depends on the accessors, so mesh prims that use the same ones decode to the same geometry
+	bool SameAccessors(const cgltf_primitive& p0, const cgltf_primitive& p1) noexcept
 	{
-		Check(accessor.type == cgltf_type_vec2, "Invalid type for TEXCOORD_0 attribute.");
-		Check(accessor.component_type == cgltf_component_type_r_32f,
-			"Invalid component type for TEXCOORD_0 attribute.");
+		if (p0.indices != p1.indices || p0.attributes_count != p1.attributes_count)
+			return false;
 
-		const cgltf_buffer_view& bufferView = *accessor.buffer_view;
-		Check(accessor.stride == sizeof(float2), "Invalid stride for TEXCOORD_0 attribute.");
+		for (int attrib = 0; attrib < p0.attributes_count; attrib++)
+		{
+			if (p0.attributes[attrib].data != p1.attributes[attrib].data ||
+				strcmp(p0.attributes[attrib].name, p1.attributes[attrib].name) != 0)
+				return false;
+		}
 
-		const cgltf_buffer& buffer = *bufferView.buffer;
-		const float2* start = reinterpret_cast<float2*>(reinterpret_cast<uintptr_t>(buffer.data) + bufferView.offset + accessor.offset);
+		return true;
+	}
 
-		for (size_t i = 0; i < accessor.count; i++)
+	// Reorders triangles for vertex cache locality and reduced overdraw, followed by reordering the
+	// vertices for vertex fetch locality
+	void OptimizeMeshPrim(Span<Vertex> vertices, Span<uint32_t> indices,
+		MeshOptimizer::VertexCacheStats& statsBefore, MeshOptimizer::VertexCacheStats& statsAfter) noexcept
+	{
+		const uint32_t numVertices = (uint32_t)vertices.size();
+		statsBefore.Accumulate(MeshOptimizer::AnalyzeVertexCache(indices, numVertices));
+
+		MeshOptimizer::OptimizeVertexCache(indices, numVertices);
+		MeshOptimizer::OptimizeOverdraw(indices, vertices);
+
+		SmallVector<uint32_t> remap;
+		remap.resize(numVertices);
+		MeshOptimizer::OptimizeVertexFetchRemap(indices, remap);
+		MeshOptimizer::RemapVertices(vertices, remap);
+
+		statsAfter.Accumulate(MeshOptimizer::AnalyzeVertexCache(indices, numVertices));
+	}
+
+	void PrefetchAccessor(const cgltf_accessor& accessor) noexcept
+	{
+		if (!accessor.buffer_view || !accessor.buffer_view->buffer->data || accessor.count == 0)
+			return;
+
+		const size_t offset = accessor.buffer_view->offset + accessor.offset;
+		const size_t size = (accessor.count - 1) * accessor.stride + cgltf_calc_size(accessor.type, accessor.component_type);
+		Filesystem::Prefetch(reinterpret_cast<const uint8_t*>(accessor.buffer_view->buffer->data) + offset, size);
+	}
+
+	// Starts reading the parts of the mapped buffers that mesh's primitives refer to, so that I/O for
+	// the next mesh overlaps with decoding of the current one
+	void PrefetchMesh(const cgltf_mesh& mesh) noexcept
+	{
+		for (int primIdx = 0; primIdx < mesh.primitives_count; primIdx++)
 		{
-			const float2* curr = start + i;
-			vertices[baseOffset + i].TexUV = float2(curr->x, curr->y);
+			const cgltf_primitive& prim = mesh.primitives[primIdx];
+
+			if (prim.indices)
+				PrefetchAccessor(*prim.indices);
+
+			for (int attrib = 0; attrib < prim.attributes_count; attrib++)
+				PrefetchAccessor(*prim.attributes[attrib].data);
 		}
 	}
 
-	void ProcessTangents(const cgltf_data& model, const cgltf_accessor& accessor, Span<Vertex> vertices, uint32_t baseOffset) noexcept
+	struct MeshBVHCacheHeader
 	{
-		Check(accessor.type == cgltf_type_vec4, "Invalid type for TANGENT attribute.");
-		Check(accessor.component_type == cgltf_component_type_r_32f,
-			"Invalid component type for TANGENT attribute.");
+		static constexpr uint32_t MAGIC = 0x4856424d;	// "MBVH"
+		// needs to be incremented whenever the triangle order of the processed meshes changes, as BVHs 
+		// refer to triangles by their position in the index buffer
+		static constexpr uint32_t VERSION = 3;
+
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t NumEntries;
+	};
 
-		const cgltf_buffer_view& bufferView = *accessor.buffer_view;
+	struct MeshBVHCacheEntry
+	{
+		// content hash of the geometry that the BVH was built for
+		uint64_t GeometryID;
+		// size of the serialized BVH that follows
+		uint64_t Size;
+	};
 
-		const cgltf_buffer& buffer = *bufferView.buffer;
-		const float4* start = reinterpret_cast<float4*>(reinterpret_cast<uintptr_t>(buffer.data) + bufferView.offset + accessor.offset);
+	// Serialized BVHs from a previous load, keyed by the content hash of the geometry they were built
+	// for, so that edited or reordered meshes miss the cache instead of picking up a wrong BVH. Only
+	// read by the mesh workers, which deserialize their own BVHs.
+	struct MeshBVHCache
+	{
+		SmallVector<uint8_t> Data;
+		// offset of each serialized BVH in Data
+		HashTable<uint64_t> Offsets;
+		std::atomic_uint32_t NumMisses = 0;
+	};
+
+	// Returns false if the cache file is missing or is stale
+	bool LoadMeshBVHCache(const char* path, MeshBVHCache& cache) noexcept
+	{
+		if (!Filesystem::Exists(path))
+			return false;
+
+		Filesystem::LoadFromFile(path, cache.Data);
+
+		const uint8_t* curr = cache.Data.begin();
+		const uint8_t* end = cache.Data.end();
+
+		MeshBVHCacheHeader header;
+		if (cache.Data.size() < sizeof(MeshBVHCacheHeader))
+			return false;
+
+		memcpy(&header, curr, sizeof(MeshBVHCacheHeader));
+		curr += sizeof(MeshBVHCacheHeader);
+
+		if (header.Magic != MeshBVHCacheHeader::MAGIC || header.Version != MeshBVHCacheHeader::VERSION)
+			return false;
+
+		cache.Offsets.resize(header.NumEntries);
 
-		for (size_t i = 0; i < accessor.count; i++)
+		for (uint32_t i = 0; i < header.NumEntries; i++)
 		{
-			const float4* curr = start + i;
+			MeshBVHCacheEntry entry;
+			if ((size_t)(end - curr) < sizeof(MeshBVHCacheEntry))
+				return false;
 
-			// glTF uses a right-handed coordinate system with +Y as up
-			vertices[baseOffset + i].Tangent = half3(curr->x, curr->y, -curr->z);
+			memcpy(&entry, curr, sizeof(MeshBVHCacheEntry));
+			curr += sizeof(MeshBVHCacheEntry);
+
+			if ((size_t)(end - curr) < entry.Size)
+				return false;
+
+			cache.Offsets.insert_or_assign(entry.GeometryID, (uint64_t)(curr - cache.Data.begin()));
+			curr += entry.Size;
 		}
+
+		return true;
 	}
 
-	void ProcessIndices(const cgltf_data& model, const cgltf_accessor& accessor, Span<uint32_t> indices, uint32_t baseOffset) noexcept
+	// Deserializes the cached BVH for given geometry. Returns false on a cache miss.
+	bool FindCachedMeshBVH(MeshBVHCache& cache, uint64_t geometryID, uint32_t numTriangles, MeshBVH& bvh) noexcept
 	{
-		Check(accessor.type == cgltf_type_scalar, "Invalid index type.");
-		Check(accessor.stride != -1, "Invalid index stride.");
-		Check(accessor.count % 3 == 0, "invalid number of indices");
+		const uint64_t* offset = cache.Offsets.find(geometryID);
+		if (!offset)
+			return false;
 
-		const cgltf_buffer_view& bufferView = *accessor.buffer_view;
-		const cgltf_buffer& buffer = *bufferView.buffer;
+		const uint8_t* curr = cache.Data.begin() + *offset;
+		return bvh.Deserialize(curr, cache.Data.end()) && bvh.GetNumTriangles() == numTriangles;
+	}
 
-		// populate the mesh indices
-		uint8_t* curr = reinterpret_cast<uint8_t*>(reinterpret_cast<uintptr_t>(buffer.data) + bufferView.offset + accessor.offset);
-		const size_t numFaces = accessor.count / 3;
-		const size_t indexStrideInBytes = accessor.stride;
-		size_t currIdxOffset = 0;
+	void WriteMeshBVHCache(const char* path, Span<MeshSubset> meshPrims, Span<MeshBVH> meshBVHs) noexcept
+	{
+		SmallVector<uint8_t> data;
+		data.resize(sizeof(MeshBVHCacheHeader));
+
+		// mesh prims with the same geometry share one entry
+		HashTable<bool> written;
+		written.resize(meshPrims.size());
 
-		for (size_t face = 0; face < numFaces; face++)
+		for (size_t i = 0; i < meshPrims.size(); i++)
 		{
-			uint32_t i0 = 0;
-			uint32_t i1 = 0;
-			uint32_t i2 = 0;
+			// duplicates don't have a BVH of their own
+			if (!meshBVHs[i].IsBuilt() || !written.emplace(meshPrims[i].GeometryID, true))
+				continue;
+
+			const size_t offset = data.size();
+			data.resize(offset + sizeof(MeshBVHCacheEntry));
 
-			memcpy(&i0, curr, indexStrideInBytes);
-			curr += indexStrideInBytes;
-			memcpy(&i1, curr, indexStrideInBytes);
-			curr += indexStrideInBytes;
-			memcpy(&i2, curr, indexStrideInBytes);
-			curr += indexStrideInBytes;
+			meshBVHs[i].Serialize(data);
 
-			// use a clockwise ordering
-			indices[baseOffset + currIdxOffset++] = i0;
-			indices[baseOffset + currIdxOffset++] = i2;
-			indices[baseOffset + currIdxOffset++] = i1;
+			MeshBVHCacheEntry entry{ .GeometryID = meshPrims[i].GeometryID, 
+				.Size = data.size() - offset - sizeof(MeshBVHCacheEntry) };
+			memcpy(data.begin() + offset, &entry, sizeof(MeshBVHCacheEntry));
 		}
+
+		MeshBVHCacheHeader header{ .Magic = MeshBVHCacheHeader::MAGIC, 
+			.Version = MeshBVHCacheHeader::VERSION,
+			.NumEntries = (uint32_t)written.size() };
+		memcpy(data.begin(), &header, sizeof(MeshBVHCacheHeader));
+
+		Filesystem::WriteToFile(path, data.begin(), (uint32_t)data.size());
 	}
 
+	// Mesh prims with identical geometry (same GeometryHash()) share one copy of it. The first mesh prim
+	// to claim a geometry becomes its owner, the others refer to the owner's vertices, indices and LODs
+	// (see ShareDuplicateGeometry()). Shared by all the mesh workers of one load.
+	struct GeometryOwners
+	{
+		struct Owner
+		{
+			uint32_t MeshPrim;
+			const cgltf_primitive* Prim;
+		};
+
+		// Returns the mesh prim that claimed the given (decoded) geometry first. Geometry with the same
+		// hash is compared against the owner's -- decoded again into the scratch buffers, as the owner's
+		// copy may be getting optimized by another worker -- and if it's different, the next ID is tried 
+		// as in MeshContainer::FindGeometry(). geometryID is updated to the ID that was claimed.
+		uint32_t Claim(const cgltf_data& model, const cgltf_primitive& prim, uint64_t& geometryID, uint32_t meshPrimIdx,
+			Span<Vertex> vertices, Span<uint32_t> indices, 
+			SmallVector<Vertex>& scratchVertices, SmallVector<uint32_t>& scratchIndices) noexcept
+		{
+			while (true)
+			{
+				AcquireSRWLockExclusive(&Lock);
+
+				// owners are never replaced, so the entry can be read after the lock is released
+				const Owner* o = Owners.find(geometryID);
+				const Owner owner = o ? *o : Owner{ .MeshPrim = meshPrimIdx, .Prim = &prim };
+
+				if (!o)
+					Owners.emplace(geometryID, owner);
+
+				ReleaseSRWLockExclusive(&Lock);
+
+				if (!o || SameAccessors(*owner.Prim, prim))
+					return owner.MeshPrim;
+
+				int posIt, normalIt, texIt, tangentIt;
+				FindVertexAttributes(*owner.Prim, posIt, normalIt, texIt, tangentIt);
+
+				scratchVertices.resize(owner.Prim->attributes[posIt].data->count);
+				scratchIndices.resize(owner.Prim->indices->count);
+				DecodeGeometry(model, *owner.Prim, posIt, normalIt, texIt, tangentIt, scratchVertices, 0, 
+					scratchIndices, 0);
+
+				if (IdenticalGeometry(scratchVertices, scratchIndices, vertices, indices))
+					return owner.MeshPrim;
+
+				// different content with the same hash, try the next key
+				geometryID++;
+			}
+		}
+
+		HashTable<Owner> Owners;
+		SRWLOCK Lock = SRWLOCK_INIT;
+		// LODs are only built when requested
+		bool BuildLODs = false;
+		// Geometry that's already in the scene (e.g. from another glTF file) doesn't get LODs, as the 
+		// scene keeps its existing copy. Not set when the scene cache is being written, since the cache
+		// mustn't depend on which other scenes happened to be loaded.
+		bool SkipGeometryInScene = false;
+	};
+
+	struct DuplicateMeshPrim
+	{
+		uint32_t MeshPrim;
+		uint32_t Owner;
+	};
+
+	// LODs of the meshes that were processed by one worker. Their sizes aren't known ahead
+	// of time, so every worker appends to its own buffers, which are concatenated after all the workers
+	// are done.
+	struct WorkerMeshData
+	{
+		SmallVector<MeshLOD> LODs;
+		SmallVector<uint32_t> LODIndices;
+		// mesh prims whose geometry is owned by another mesh prim
+		SmallVector<DuplicateMeshPrim> Duplicates;
+		// range of mesh prims that were processed by this worker
+		uint32_t BaseMeshPrim = 0;
+		uint32_t NumMeshPrims = 0;
+	};
+
 	void ProcessMeshes(const cgltf_data& model, size_t offset, size_t size, 
 		Span<Vertex> vertices, std::atomic_uint32_t& vertexCounter,
 		Span<uint32_t> indices, std::atomic_uint32_t& idxCounter,
-		Span<MeshSubset> meshPrims, std::atomic_uint32_t& meshPrimCounter) noexcept
+		Span<MeshSubset> meshPrims, std::atomic_uint32_t& meshPrimCounter,
+		Span<MeshBVH> meshBVHs, MeshBVHCache* bvhCache, GeometryOwners& owners, WorkerMeshData& workerData,
+		MeshOptimizer::VertexCacheStats& statsBefore, MeshOptimizer::VertexCacheStats& statsAfter) noexcept
 	{
 		SceneCore& scene = App::GetScene();
 
@@ -212,6 +515,7 @@ namespace
 				const cgltf_primitive& prim = mesh.primitives[primIdx];
 
 				Check(prim.indices->count > 0, "index buffer is required.");
+				Check(prim.indices->count % 3 == 0, "Invalid number of indices.");
 				Check(prim.type == cgltf_primitive_type_triangles, "Non-triangle meshes are not supported.");
 
 				int posIt = -1;
@@ -247,32 +551,31 @@ namespace
 		uint32_t currIdxOffset = workerBaseIdx;
 		uint32_t currMeshPrimOffset = workerBaseMeshPrim;
 
+		workerData.BaseMeshPrim = workerBaseMeshPrim;
+		workerData.NumMeshPrims = totalMeshPrims;
+
+		// owners' geometry is decoded again into these to be compared against (see GeometryOwners::Claim())
+		SmallVector<Vertex> scratchVertices;
+		SmallVector<uint32_t> scratchIndices;
+
+		if (size)
+			PrefetchMesh(model.meshes[offset]);
+
 		// now iterate again and populate the buffers
 		for (size_t meshIdx = offset; meshIdx != offset + size; meshIdx++)
 		{
 			const cgltf_mesh& mesh = model.meshes[meshIdx];
 
+			if (meshIdx + 1 != offset + size)
+				PrefetchMesh(model.meshes[meshIdx + 1]);
+
 			// fill in the subsets
 			for (int primIdx = 0; primIdx < mesh.primitives_count; primIdx++)
 			{
 				const cgltf_primitive& prim = mesh.primitives[primIdx];
 				
-				int posIt = -1;
-				int normalIt = -1;
-				int texIt = -1;
-				int tangentIt = -1;
-
-				for (int attrib = 0; attrib < prim.attributes_count; attrib++)
-				{
-					if(strcmp(prim.attributes[attrib].name, "POSITION") == 0)
-						posIt = attrib;
-					else if (strcmp(prim.attributes[attrib].name, "NORMAL") == 0)
-						normalIt = attrib;
-					else if (strcmp(prim.attributes[attrib].name, "TEXCOORD_0") == 0)
-						texIt = attrib;
-					else if (strcmp(prim.attributes[attrib].name, "TANGENT") == 0)
-						tangentIt = attrib;
-				}
+				int posIt, normalIt, texIt, tangentIt;
+				FindVertexAttributes(prim, posIt, normalIt, texIt, tangentIt);
 				
 				Check(normalIt != -1, "NORMAL was not found in the vertex attributes.");
 
@@ -283,32 +586,55 @@ namespace
 				const cgltf_buffer_view& bufferView = *prim.indices->buffer_view;
 				const uint32_t numIndices = (uint32_t)prim.indices->count;
 
-				// POSITION
-				ProcessPositions(model, *prim.attributes[posIt].data, vertices, currVtxOffset);
+				DecodeGeometry(model, prim, posIt, normalIt, texIt, tangentIt, vertices, currVtxOffset, 
+					indices, currIdxOffset);
 
-				// NORMAL
-				ProcessNormals(model, *prim.attributes[normalIt].data, vertices, currVtxOffset);
+				// hashed and compared as decoded, so that duplicates are found before any of the work below. 
+				// The optimizations are deterministic, hence identical geometry stays identical afterwards.
+				uint64_t geometryID = GeometryHash(Span(vertices.begin() + currVtxOffset, numVertices),
+					Span(indices.begin() + currIdxOffset, numIndices));
 
-				// indices
-				ProcessIndices(model, *prim.indices, indices, currIdxOffset);
+				const uint32_t owner = owners.Claim(model, prim, geometryID, currMeshPrimOffset, 
+					Span(vertices.begin() + currVtxOffset, numVertices),
+					Span(indices.begin() + currIdxOffset, numIndices),
+					scratchVertices, scratchIndices);
+				const bool isDuplicate = owner != currMeshPrimOffset;
 
-				// TEXCOORD_0
-				if (texIt != -1)
+				if (isDuplicate)
+					workerData.Duplicates.push_back(DuplicateMeshPrim{ .MeshPrim = currMeshPrimOffset, .Owner = owner });
+
+				// duplicates are left as decoded and without a mesh BVH, they end up using the owner's
+				if (!isDuplicate)
 				{
-					ProcessTexCoords(model, *prim.attributes[texIt].data, vertices, currVtxOffset);
+					// mesh BVH refers to triangles by their position in the index buffer, so this has to happen first
+					OptimizeMeshPrim(Span(vertices.begin() + currVtxOffset, numVertices),
+						Span(indices.begin() + currIdxOffset, numIndices), statsBefore, statsAfter);
 
-					// if vertex tangents aren't present, compute them. Make sure the computation happens after 
-					// vertex & index processing
-					if (tangentIt != -1)
-						ProcessTangents(model, *prim.attributes[tangentIt].data, vertices, currVtxOffset);
-					else
+					// mesh BVHs are built (or deserialized from the cache) here so that the work is spread 
+					// across the mesh workers
+					if (!bvhCache || !FindCachedMeshBVH(*bvhCache, geometryID, numIndices / 3, meshBVHs[currMeshPrimOffset]))
 					{
-						Math::ComputeMeshTangentVectors(Span(vertices.begin() + currVtxOffset, numVertices),
-							Span(indices.begin() + currIdxOffset, numIndices),
-							false);
+						meshBVHs[currMeshPrimOffset].Build(Span(vertices.begin() + currVtxOffset, numVertices),
+							Span(indices.begin() + currIdxOffset, numIndices));
+
+						if (bvhCache)
+							bvhCache->NumMisses.fetch_add(1, std::memory_order_relaxed);
 					}
 				}
 
+				// LOD offsets are relative to this worker's buffers until they're concatenated
+				const uint32_t baseLOD = (uint32_t)workerData.LODs.size();
+				const uint32_t baseLODIdx = (uint32_t)workerData.LODIndices.size();
+
+				// LODs don't get a mesh BVH, it's only built for the full-resolution mesh
+				if (owners.BuildLODs && !isDuplicate && 
+					!(owners.SkipGeometryInScene && scene.HasGeometry(geometryID)))
+				{
+					MeshSimplifier::BuildLODs(Span(vertices.begin() + currVtxOffset, numVertices),
+						Span(indices.begin() + currIdxOffset, numIndices),
+						workerData.LODs, workerData.LODIndices);
+				}
+
 				meshPrims[currMeshPrimOffset++] = MeshSubset
 				{
 					.MaterialIdx = prim.material ? (int)(prim.material - model.materials) : -1,
@@ -317,7 +643,12 @@ namespace
 					.BaseVtxOffset = currVtxOffset,
 					.BaseIdxOffset = currIdxOffset,
 					.NumVertices = numVertices,
-					.NumIndices = numIndices
+					.NumIndices = numIndices,
+					.BaseLODOffset = baseLOD,
+					.BaseLODIdxOffset = baseLODIdx,
+					.NumLODs = (uint32_t)workerData.LODs.size() - baseLOD,
+					.NumLODIndices = (uint32_t)workerData.LODIndices.size() - baseLODIdx,
+					.GeometryID = geometryID
 				};
 
 				currVtxOffset += numVertices;
@@ -326,19 +657,38 @@ namespace
 		}
 	}
 
-	void LoadDDSImages(uint64_t sceneID, const Filesystem::Path& modelDir, const cgltf_data& model,
-		size_t offset, size_t size, Span<DDSImage> ddsImages) noexcept
+	// Duplicates take the owner's vertices, indices and LODs. Offsets of both have to be relative to
+	// the same buffers by now. Vertices and indices that the duplicates were decoded to are left unused
+	// and are dropped by SceneCore.
+	void ShareDuplicateGeometry(Span<MeshSubset> meshPrims, Span<DuplicateMeshPrim> duplicates) noexcept
+	{
+		for (auto& d : duplicates)
+		{
+			MeshSubset& mesh = meshPrims[d.MeshPrim];
+			const MeshSubset& owner = meshPrims[d.Owner];
+
+			mesh.BaseVtxOffset = owner.BaseVtxOffset;
+			mesh.BaseIdxOffset = owner.BaseIdxOffset;
+			mesh.BaseLODOffset = owner.BaseLODOffset;
+			mesh.BaseLODIdxOffset = owner.BaseLODIdxOffset;
+			mesh.NumLODs = owner.NumLODs;
+			mesh.NumLODIndices = owner.NumLODIndices;
+		}
+	}
+
+	void LoadDDSImages(const Filesystem::Path& modelDir, Span<const char*> imageURIs, size_t offset, size_t size, 
+		Span<DDSImage> ddsImages) noexcept
 	{
 		char ext[8];
 
 		for (size_t m = offset; m != offset + size; m++)
 		{
-			const cgltf_image& image = model.images[m];
-			if (image.uri)
+			const char* uri = imageURIs[m];
+			if (uri)
 			{
 				Filesystem::Path p(App::GetAssetDir());
 				p.Append(modelDir.GetView());
-				p.Append(image.uri);
+				p.Append(uri);
 				p.Extension(ext);
 
 				if (strcmp(ext, "dds") != 0)
@@ -364,8 +714,9 @@ namespace
 		}
 	}
 
-	void ProcessMaterials(uint64_t sceneID, const Filesystem::Path& modelDir, const cgltf_data& model,
-		int offset, int size, Span<DDSImage> ddsImages) noexcept
+	// Texture paths of returned materials are image indices (rather than path hashes) so that they 
+	// can be cached, see ResolveTexturePaths()
+	void ProcessMaterials(const cgltf_data& model, int offset, int size, Span<MaterialDesc> materials) noexcept
 	{
 		auto getAlphaMode = [](cgltf_alpha_mode m) noexcept
 		{
@@ -385,12 +736,18 @@ namespace
 			return Material::ALPHA_MODE::OPAQUE_;
 		};
 
+		auto imageIdx = [&model](const cgltf_texture_view& view) noexcept
+		{
+			Check(view.texture->image, "textureView doesn't point to any image.");
+			return (uint64_t)(view.texture->image - model.images);
+		};
+
 		for (int m = offset; m != offset + size; m++)
 		{
 			const auto& mat = model.materials[m];
 			Check(mat.has_pbr_metallic_roughness, "material is not supported.");
 
-			glTF::Asset::MaterialDesc desc;
+			glTF::Asset::MaterialDesc& desc = materials[m];
 
 			desc.Index = m;
 			desc.AlphaMode = getAlphaMode(mat.alpha_mode);
@@ -401,15 +758,7 @@ namespace
 			{
 				const cgltf_texture_view& baseColView = mat.pbr_metallic_roughness.base_color_texture;
 				if (baseColView.texture)
-				{
-					Check(baseColView.texture->image, "textureView doesn't point to any image.");
-
-					Filesystem::Path p(App::GetAssetDir());
-					p.Append(modelDir.GetView());
-					p.Append(baseColView.texture->image->uri);
-
-					desc.BaseColorTexPath = XXH3_64bits(p.Get(), p.Length());
-				}
+					desc.BaseColorTexPath = imageIdx(baseColView);
 
 				auto& f = mat.pbr_metallic_roughness.base_color_factor;
 				desc.BaseColorFactor = float4(f[0], f[1], f[2], f[3]);
@@ -420,14 +769,7 @@ namespace
 				const cgltf_texture_view& normalView = mat.normal_texture;
 				if (normalView.texture)
 				{
-					Check(normalView.texture->image, "textureView doesn't point to any image.");
-					const char* texPath = normalView.texture->image->uri;
-
-					Filesystem::Path p(App::GetAssetDir());
-					p.Append(modelDir.GetView());
-					p.Append(normalView.texture->image->uri);
-					desc.NormalTexPath = XXH3_64bits(p.Get(), p.Length());
-
+					desc.NormalTexPath = imageIdx(normalView);
 					desc.NormalScale = (float)mat.normal_texture.scale;
 				}
 			}
@@ -436,14 +778,7 @@ namespace
 			{
 				const cgltf_texture_view& metalnessRoughnessView = mat.pbr_metallic_roughness.metallic_roughness_texture;
 				if (metalnessRoughnessView.texture)
-				{
-					Check(metalnessRoughnessView.texture->image, "textureView doesn't point to any image.");
-
-					Filesystem::Path p(App::GetAssetDir());
-					p.Append(modelDir.GetView());
-					p.Append(metalnessRoughnessView.texture->image->uri);
-					desc.MetalnessRoughnessTexPath = XXH3_64bits(p.Get(), p.Length());
-				}
+					desc.MetalnessRoughnessTexPath = imageIdx(metalnessRoughnessView);
 
 				desc.MetalnessFactor = (float)mat.pbr_metallic_roughness.metallic_factor;
 				desc.RoughnessFactor = (float)mat.pbr_metallic_roughness.roughness_factor;
@@ -453,15 +788,7 @@ namespace
 			{
 				const cgltf_texture_view& emissiveView = mat.emissive_texture;
 				if (emissiveView.texture)
-				{
-					Check(emissiveView.texture->image, "textureView doesn't point to any image.");
-					const char* texPath = emissiveView.texture->image->uri;
-
-					Filesystem::Path p(App::GetAssetDir());
-					p.Append(modelDir.GetView());
-					p.Append(emissiveView.texture->image->uri);
-					desc.EmissiveTexPath = XXH3_64bits(p.Get(), p.Length());
-				}
+					desc.EmissiveTexPath = imageIdx(emissiveView);
 
 				auto& f = mat.emissive_factor;
 				desc.EmissiveFactor = float3((float)f[0], (float)f[1], (float)f[2]);
@@ -469,13 +796,49 @@ namespace
 				if (mat.has_emissive_strength)
 					desc.EmissiveStrength = mat.emissive_strength.emissive_strength;
 			}
+		}
+	}
+
+	// Replaces image indices with hash of the texture path, which is what SceneCore expects
+	void ResolveTexturePaths(const Filesystem::Path& modelDir, Span<const char*> imageURIs, MaterialDesc& desc) noexcept
+	{
+		auto resolve = [&modelDir, imageURIs](uint64_t& texPath) noexcept
+		{
+			if (texPath == uint64_t(-1))
+				return;
+
+			Check(texPath < imageURIs.size() && imageURIs[texPath], "Invalid image index.");
+
+			Filesystem::Path p(App::GetAssetDir());
+			p.Append(modelDir.GetView());
+			p.Append(imageURIs[texPath]);
+
+			texPath = XXH3_64bits(p.Get(), p.Length());
+		};
+
+		resolve(desc.BaseColorTexPath);
+		resolve(desc.NormalTexPath);
+		resolve(desc.MetalnessRoughnessTexPath);
+		resolve(desc.EmissiveTexPath);
+	}
+
+	void AddMaterials(uint64_t sceneID, const Filesystem::Path& modelDir, Span<const char*> imageURIs,
+		Span<MaterialDesc> materials, int offset, int size, Span<DDSImage> ddsImages) noexcept
+	{
+		SceneCore& scene = App::GetScene();
+
+		for (int m = offset; m != offset + size; m++)
+		{
+			// copy, so that the snapshot still has the indices when it's serialized
+			MaterialDesc desc = materials[m];
+			ResolveTexturePaths(modelDir, imageURIs, desc);
 
-			SceneCore& scene = App::GetScene();
 			scene.AddMaterial(sceneID, desc, ddsImages);
 		}
 	}
 
-	void ProcessNodeSubtree(const cgltf_node& node, uint64_t sceneID, const cgltf_data& model, uint64_t parentId) noexcept
+	void ProcessNodeSubtree(const cgltf_node& node, uint64_t sceneID, const cgltf_data& model, uint64_t parentId,
+		SmallVector<glTF::Asset::InstanceDesc>& instances) noexcept
 	{
 		uint64_t currInstanceID = SceneCore::ROOT_ID;
 
@@ -588,59 +951,57 @@ namespace
 				// parent-child relationships will be w.r.t. the last mesh primitive
 				currInstanceID = SceneCore::InstanceID(sceneID, instanceName, meshIdx, primIdx);
 
-				glTF::Asset::InstanceDesc desc{
+				instances.push_back(glTF::Asset::InstanceDesc{
 					.LocalTransform = transform,
 					.MeshIdx = meshIdx,
 					.ID = currInstanceID,
 					.ParentID = parentId,
 					.MeshPrimIdx = primIdx,
 					.RtMeshMode = RT_MESH_MODE::STATIC,
-					.RtInstanceMask = rtInsMask };
-
-				SceneCore& scene = App::GetScene();
-				scene.AddInstance(sceneID, ZetaMove(desc));
+					.RtInstanceMask = rtInsMask });
 			}
 		}
 		else
 		{
 			currInstanceID = SceneCore::InstanceID(sceneID, instanceName, -1, -1);
 
-			glTF::Asset::InstanceDesc desc{
+			instances.push_back(glTF::Asset::InstanceDesc{
 				.LocalTransform = transform,
-					.MeshIdx = -1,
-					.ID = currInstanceID,
-					.ParentID = parentId,
-					.MeshPrimIdx = -1,
-					.RtMeshMode = RT_MESH_MODE::STATIC,
-					.RtInstanceMask = RT_AS_SUBGROUP::NON_EMISSIVE };
-
-			SceneCore& scene = App::GetScene();
-			scene.AddInstance(sceneID, ZetaMove(desc));
+				.MeshIdx = -1,
+				.ID = currInstanceID,
+				.ParentID = parentId,
+				.MeshPrimIdx = -1,
+				.RtMeshMode = RT_MESH_MODE::STATIC,
+				.RtInstanceMask = RT_AS_SUBGROUP::NON_EMISSIVE });
 		}
 
 		for (int c = 0; c < node.children_count; c++)
 		{
 			const cgltf_node& childNode = *node.children[c];
-			ProcessNodeSubtree(childNode, sceneID, model, currInstanceID);
+			ProcessNodeSubtree(childNode, sceneID, model, currInstanceID, instances);
 		}
 	}
 
-	void ProcessNodes(const cgltf_data& model, uint64_t sceneID) noexcept
+	void ProcessNodes(const cgltf_data& model, uint64_t sceneID, SmallVector<glTF::Asset::InstanceDesc>& instances) noexcept
 	{
+		// subtrees are visited depth-first, so parents always come before their children
+		instances.reserve(model.nodes_count);
+
 		for (size_t i = 0; i < model.scene->nodes_count; i++)
 		{
 			const cgltf_node& node = *model.scene->nodes[i];
-			ProcessNodeSubtree(node, sceneID, model, SceneCore::ROOT_ID);
+			ProcessNodeSubtree(node, sceneID, model, SceneCore::ROOT_ID, instances);
 		}
 	}
 
-	void TotalNumVerticesAndIndices(cgltf_data* model, size_t& numVertices, size_t& numIndices, size_t& numMeshes) noexcept
+	void TotalNumVerticesAndIndices(const cgltf_data* model, size_t offset, size_t size, size_t& numVertices, 
+		size_t& numIndices, size_t& numMeshes) noexcept
 	{
 		numVertices = 0;
 		numIndices = 0;
 		numMeshes = 0;
 
-		for (size_t meshIdx = 0; meshIdx != model->meshes_count; meshIdx++)
+		for (size_t meshIdx = offset; meshIdx != offset + size; meshIdx++)
 		{
 			const auto& mesh = model->meshes[meshIdx];
 			numMeshes += mesh.primitives_count;
@@ -667,46 +1028,497 @@ namespace
 			}
 		}
 	}
+
+	// Moves the boundaries of given mesh ranges (one per mesh worker) so that every worker processes 
+	// about the same number of triangles. Cost of processing a mesh, most of which goes to building 
+	// its BVH, grows with its size, so equal numbers of meshes can leave one worker with most of the work.
+	void BalanceMeshRanges(const cgltf_data& model, size_t numRanges, Span<size_t> offsets, Span<size_t> sizes) noexcept
+	{
+		auto numMeshIndices = [&model](size_t meshIdx)
+			{
+				size_t n = 0;
+				for (size_t primIdx = 0; primIdx < model.meshes[meshIdx].primitives_count; primIdx++)
+					n += model.meshes[meshIdx].primitives[primIdx].indices->count;
+
+				return n;
+			};
+
+		size_t totalNumIndices = 0;
+		for (size_t meshIdx = 0; meshIdx < model.meshes_count; meshIdx++)
+			totalNumIndices += numMeshIndices(meshIdx);
+
+		size_t currMesh = 0;
+		size_t currNumIndices = 0;
+
+		for (size_t i = 0; i < numRanges; i++)
+		{
+			const size_t target = totalNumIndices * (i + 1) / numRanges;
+			// leave at least one mesh for each of the remaining ranges
+			const size_t lastMesh = model.meshes_count - (numRanges - 1 - i);
+			offsets[i] = currMesh;
+
+			do
+			{
+				currNumIndices += numMeshIndices(currMesh++);
+			} while (currMesh < lastMesh && currNumIndices < target);
+
+			sizes[i] = currMesh - offsets[i];
+		}
+
+		sizes[numRanges - 1] = model.meshes_count - offsets[numRanges - 1];
+	}
+
+	// Loads the scene snapshot that was written by a previous load of the same glTF file. Returns
+	// false if the cache file is missing or is stale.
+	bool LoadSceneCache(const char* path, const Filesystem::Path& pathToglTF, uint64_t contentHash, 
+		glTF::SceneSnapshot& snapshot) noexcept
+	{
+		// contents are copied directly from the mapped view into the final arrays. Whole file is 
+		// going to be read, so start reading it in the background.
+		Filesystem::MemoryMappedFile file;
+		if (!file.Open(path))
+			return false;
+
+		Filesystem::Prefetch(file.Data(), file.Size());
+
+		if (!glTF::DeserializeSceneSnapshot(file.Data(), file.Data() + file.Size(), contentHash, snapshot))
+			return false;
+
+		// JSON hash doesn't cover the buffers, make sure they haven't changed either (see LoadBuffers())
+		uint64_t bufferHash = 0;
+
+		for (const char* uri = snapshot.BufferURIs.begin(); uri != snapshot.BufferURIs.end(); uri += strlen(uri) + 1)
+		{
+			Filesystem::Path bufferPath(pathToglTF.GetView());
+			bufferPath.Directory();
+			bufferPath.Append(uri);
+
+			Filesystem::MemoryMappedFile buffer;
+			if (!buffer.Open(bufferPath.Get()))
+				return false;
+
+			bufferHash = glTF::HashBuffer(buffer.Data(), buffer.Size(), Filesystem::GetLastWriteTime(bufferPath.Get()),
+				bufferHash);
+		}
+
+		return bufferHash == snapshot.BufferHash;
+	}
+
+	// For .glb files, returns the JSON chunk, otherwise the whole file is JSON
+	void GetJSON(const uint8_t* data, size_t size, const uint8_t*& json, size_t& jsonSize) noexcept
+	{
+		constexpr uint32_t GLB_MAGIC = 0x46546C67;			// "glTF"
+		constexpr uint32_t GLB_CHUNK_TYPE_JSON = 0x4E4F534A;	// "JSON"
+		constexpr size_t GLB_HEADER_SIZE = 12;
+		constexpr size_t GLB_CHUNK_HEADER_SIZE = 8;
+
+		json = data;
+		jsonSize = size;
+
+		if (size < GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE)
+			return;
+
+		uint32_t magic;
+		memcpy(&magic, data, sizeof(magic));
+
+		if (magic != GLB_MAGIC)
+			return;
+
+		uint32_t chunkLength;
+		uint32_t chunkType;
+		memcpy(&chunkLength, data + GLB_HEADER_SIZE, sizeof(chunkLength));
+		memcpy(&chunkType, data + GLB_HEADER_SIZE + sizeof(chunkLength), sizeof(chunkType));
+		Check(chunkType == GLB_CHUNK_TYPE_JSON && chunkLength <= size - GLB_HEADER_SIZE - GLB_CHUNK_HEADER_SIZE,
+			"Invalid .glb file.");
+
+		json = data + GLB_HEADER_SIZE + GLB_CHUNK_HEADER_SIZE;
+		jsonSize = chunkLength;
+	}
+
+	// Buffers can be
+	//  1. external files, which are memory mapped
+	//  2. binary chunk of a .glb file, which is used directly from the glTF file's mapped view
+	//  3. base64-encoded data URIs, which are decoded into memory that's freed by cgltf_free()
+	// Mapped views are unmapped by MemoryMappedFile rather than cgltf_free(). External files (including
+	// the .glb file itself, since its binary chunk isn't part of the JSON) are appended to bufferURIs and
+	// their contents to bufferHash (in the same format as SceneSnapshot).
+	void LoadBuffers(const cgltf_options& options, cgltf_data& model, const Filesystem::Path& pathToglTF,
+		const Filesystem::MemoryMappedFile& gltfFile, SmallVector<Filesystem::MemoryMappedFile>& mappedBuffers, 
+		SmallVector<char>& bufferURIs, uint64_t& bufferHash) noexcept
+	{
+		mappedBuffers.resize(model.buffers_count);
+
+		for (size_t i = 0; i < model.buffers_count; i++)
+		{
+			cgltf_buffer& buffer = model.buffers[i];
+
+			if (!buffer.uri)
+			{
+				Check(i == 0 && model.bin, "Buffer %llu doesn't have a URI.", i);
+				Check(model.bin_size >= buffer.size, "Binary chunk of %s is smaller than expected.",
+					pathToglTF.GetView().data());
+
+				buffer.data = const_cast<void*>(model.bin);
+				buffer.data_free_method = cgltf_data_free_method_none;
+
+				const char* filename = pathToglTF.GetView().data();
+				for (const char* c = filename; *c; c++)
+				{
+					if (*c == '/' || *c == '\\')
+						filename = c + 1;
+				}
+
+				bufferURIs.append_range(filename, filename + strlen(filename) + 1);
+				bufferHash = glTF::HashBuffer(gltfFile.Data(), gltfFile.Size(), 
+					Filesystem::GetLastWriteTime(pathToglTF.GetView().data()), bufferHash);
+			}
+			else if (strncmp(buffer.uri, "data:", 5) == 0)
+			{
+				const char* comma = strchr(buffer.uri, ',');
+				Check(comma && comma - buffer.uri >= 7 && strncmp(comma - 7, ";base64", 7) == 0,
+					"Buffer %llu has a data URI that isn't base64-encoded.", i);
+
+				Checkgltf(cgltf_load_buffer_base64(&options, buffer.size, comma + 1, &buffer.data));
+				buffer.data_free_method = cgltf_data_free_method_memory_free;
+			}
+			else
+			{
+				Filesystem::Path bufferPath(pathToglTF.GetView());
+				bufferPath.Directory();
+				bufferPath.Append(buffer.uri);
+
+				const bool bufferFound = mappedBuffers[i].Open(bufferPath.Get());
+				Check(bufferFound, "Buffer %s was not found.", bufferPath.Get());
+				Check(mappedBuffers[i].Size() >= buffer.size, "Buffer %s is smaller than expected.", bufferPath.Get());
+
+				buffer.data = const_cast<uint8_t*>(mappedBuffers[i].Data());
+				buffer.data_free_method = cgltf_data_free_method_none;
+
+				bufferURIs.append_range(buffer.uri, buffer.uri + strlen(buffer.uri) + 1);
+				bufferHash = glTF::HashBuffer(mappedBuffers[i].Data(), mappedBuffers[i].Size(), 
+					Filesystem::GetLastWriteTime(bufferPath.Get()), bufferHash);
+			}
+		}
+	}
+
+	// Parses the glTF file that's mapped by gltfFile and loads its buffers (see LoadBuffers())
+	cgltf_data* Parse(const Filesystem::Path& pathToglTF, const Filesystem::MemoryMappedFile& gltfFile,
+		SmallVector<Filesystem::MemoryMappedFile>& mappedBuffers, SmallVector<char>& bufferURIs,
+		uint64_t& bufferHash) noexcept
+	{
+		cgltf_options options{};
+		cgltf_data* model = nullptr;
+		Checkgltf(cgltf_parse(&options, gltfFile.Data(), gltfFile.Size(), &model));
+
+		for (size_t i = 0; i < model->extensions_required_count; i++)
+		{
+			Check(strcmp(model->extensions_required[i], "KHR_mesh_quantization") == 0,
+				"Required glTF extension %s is not supported.", model->extensions_required[i]);
+		}
+
+		Check(model->scene, "no scene found in glTF file: %s.", pathToglTF.GetView().data());
+		LoadBuffers(options, *model, pathToglTF, gltfFile, mappedBuffers, bufferURIs, bufferHash);
+
+		return model;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Streaming
+	//--------------------------------------------------------------------------------------
+
+	// Stages of a streamed scene -- instances refer to meshes and materials, so they're
+	// integrated last
+	enum STREAMING_STAGE
+	{
+		MESHES_AND_MATERIALS,
+		INSTANCES,
+		COUNT
+	};
+
+	// Meshes are decoded and handed over to the scene a few at a time, so that integrating each chunk
+	// (mostly copying its geometry to the scene's buffers) takes a fraction of the frame budget
+	struct StreamedMeshChunk
+	{
+		size_t MeshOffset;
+		size_t NumMeshes;
+		SmallVector<MeshSubset> Meshes;
+		SmallVector<Vertex> Vertices;
+		SmallVector<uint32_t> Indices;
+		SmallVector<MeshBVH> MeshBVHs;
+		WorkerMeshData Data;
+	};
+
+	// Everything that has to outlive the background tasks. Released by the last item of the last stage.
+	struct StreamingScene
+	{
+		static constexpr size_t MESHES_PER_CHUNK = 16;
+		static constexpr size_t INSTANCES_PER_CHUNK = 256;
+
+		explicit StreamingScene(const Filesystem::Path& p) noexcept
+			: PathToglTF(p.GetView()),
+			ModelDir(p.GetView())
+		{
+			ModelDir.ToParent();
+		}
+
+		Filesystem::Path PathToglTF;
+		Filesystem::Path ModelDir;
+		uint64_t SceneID;
+		bool BuildLODs;
+		StreamingQueue* Queue;
+		DeltaTimer Timer;
+
+		Filesystem::MemoryMappedFile GltfFile;
+		SmallVector<Filesystem::MemoryMappedFile> MappedBuffers;
+		cgltf_data* Model = nullptr;
+
+		SmallVector<StreamedMeshChunk> MeshChunks;
+		std::atomic_uint32_t NextMeshChunk = 0;
+		// number of tasks that are decoding meshes, the last one to finish closes the first stage
+		std::atomic_int32_t NumMeshProducers = 0;
+
+		SmallVector<const char*> ImageURIs;
+		SmallVector<DDSImage> DDSImages;
+		SmallVector<MaterialDesc> Materials;
+		SmallVector<InstanceDesc> Instances;
+	};
+
+	// Called by every task that decodes meshes. Chunks are claimed one at a time, so they're
+	// spread evenly even though the tasks start at different times.
+	void StreamMeshChunks(StreamingScene& s) noexcept
+	{
+		while (true)
+		{
+			const uint32_t chunkIdx = s.NextMeshChunk.fetch_add(1, std::memory_order_relaxed);
+			if (chunkIdx >= s.MeshChunks.size())
+				break;
+
+			StreamedMeshChunk& chunk = s.MeshChunks[chunkIdx];
+
+			size_t numVertices;
+			size_t numIndices;
+			size_t numMeshPrims;
+			TotalNumVerticesAndIndices(s.Model, chunk.MeshOffset, chunk.NumMeshes, numVertices, numIndices, numMeshPrims);
+
+			chunk.Vertices.resize(numVertices);
+			chunk.Indices.resize(numIndices);
+			chunk.Meshes.resize(numMeshPrims);
+			chunk.MeshBVHs.resize(numMeshPrims);
+
+			// offsets are relative to this chunk, they're rebased when the chunk is added to the scene
+			std::atomic_uint32_t currVtxOffset = 0;
+			std::atomic_uint32_t currIdxOffset = 0;
+			std::atomic_uint32_t currMeshPrimOffset = 0;
+			MeshOptimizer::VertexCacheStats statsBefore;
+			MeshOptimizer::VertexCacheStats statsAfter;
+
+			// duplicates are only detected within each chunk, duplicates across chunks are shared by 
+			// SceneCore instead
+			GeometryOwners owners;
+			owners.BuildLODs = s.BuildLODs;
+			owners.SkipGeometryInScene = true;
+
+			ProcessMeshes(*s.Model, chunk.MeshOffset, chunk.NumMeshes,
+				chunk.Vertices, currVtxOffset,
+				chunk.Indices, currIdxOffset,
+				chunk.Meshes, currMeshPrimOffset,
+				chunk.MeshBVHs, nullptr, owners, chunk.Data,
+				statsBefore, statsAfter);
+
+			ShareDuplicateGeometry(chunk.Meshes, chunk.Data.Duplicates);
+
+			s.Queue->Enqueue(STREAMING_STAGE::MESHES_AND_MATERIALS, [&s, chunkIdx]()
+				{
+					StreamedMeshChunk& chunk = s.MeshChunks[chunkIdx];
+
+					App::GetScene().AddMeshes(s.SceneID, ZetaMove(chunk.Meshes), ZetaMove(chunk.Vertices),
+						ZetaMove(chunk.Indices), ZetaMove(chunk.Data.LODs), ZetaMove(chunk.Data.LODIndices),
+						ZetaMove(chunk.MeshBVHs));
+				});
+		}
+
+		// s may be released as soon as the first stage is closed, so it's not accessed after the
+		// decrement by any of the tasks
+		StreamingQueue* queue = s.Queue;
+
+		if (s.NumMeshProducers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			queue->Close(STREAMING_STAGE::MESHES_AND_MATERIALS);
+	}
+
+	void StreamScene(StreamingScene& s) noexcept
+	{
+		const bool gltfFound = s.GltfFile.Open(s.PathToglTF.GetView().data());
+		Check(gltfFound, "glTF file %s was not found.", s.PathToglTF.GetView().data());
+
+		// external files aren't tracked, there's no scene cache to invalidate
+		SmallVector<char> bufferURIs;
+		uint64_t bufferHash = 0;
+		s.Model = Parse(s.PathToglTF, s.GltfFile, s.MappedBuffers, bufferURIs, bufferHash);
+		const cgltf_data& model = *s.Model;
+
+		// meshes are decoded by every background thread
+		for (size_t offset = 0; offset < model.meshes_count; offset += StreamingScene::MESHES_PER_CHUNK)
+		{
+			s.MeshChunks.push_back(StreamedMeshChunk{ .MeshOffset = offset,
+				.NumMeshes = Math::Min(StreamingScene::MESHES_PER_CHUNK, model.meshes_count - offset) });
+		}
+
+		const int numMeshProducers = Math::Max(App::GetNumBackgroundThreads(), 1);
+		s.NumMeshProducers.store(numMeshProducers, std::memory_order_relaxed);
+
+		for (int i = 1; i < numMeshProducers; i++)
+		{
+			StackStr(tname, n, "glTF::StreamMeshes_%d", i);
+
+			Task t(tname, TASK_PRIORITY::BACKGRUND, [&s]()
+				{
+					StreamMeshChunks(s);
+				});
+
+			App::SubmitBackground(ZetaMove(t));
+		}
+
+		// materials, after all the textures that they refer to are loaded
+		for (size_t i = 0; i < model.images_count; i++)
+			s.ImageURIs.push_back(model.images[i].uri);
+
+		s.DDSImages.resize(s.ImageURIs.size());
+		LoadDDSImages(s.ModelDir, s.ImageURIs, 0, s.ImageURIs.size(), s.DDSImages);
+
+		std::sort(s.DDSImages.begin(), s.DDSImages.end(), [](const DDSImage& lhs, const DDSImage& rhs)
+			{
+				return lhs.ID < rhs.ID;
+			});
+
+		s.Materials.resize(model.materials_count);
+		ProcessMaterials(model, 0, (int)model.materials_count, s.Materials);
+
+		for (int i = 0; i < (int)model.materials_count; i++)
+		{
+			s.Queue->Enqueue(STREAMING_STAGE::MESHES_AND_MATERIALS, [&s, i]()
+				{
+					AddMaterials(s.SceneID, s.ModelDir, s.ImageURIs, s.Materials, i, 1, s.DDSImages);
+				});
+		}
+
+		// instances, parents come before their children as chunks are integrated in order
+		ProcessNodes(model, s.SceneID, s.Instances);
+
+		for (size_t offset = 0; offset < s.Instances.size(); offset += StreamingScene::INSTANCES_PER_CHUNK)
+		{
+			const size_t n = Math::Min(StreamingScene::INSTANCES_PER_CHUNK, s.Instances.size() - offset);
+
+			s.Queue->Enqueue(STREAMING_STAGE::INSTANCES, [&s, offset, n]()
+				{
+					App::GetScene().AddInstances(s.SceneID, Span<InstanceDesc>(s.Instances.begin() + offset, n));
+				});
+		}
+
+		// runs after everything else was integrated
+		s.Queue->Enqueue(STREAMING_STAGE::INSTANCES, [&s]()
+			{
+				s.Timer.End();
+				LOG_UI_INFO("glTF scene %s streamed in %u[ms]\n", s.PathToglTF.GetView().data(), (uint32_t)s.Timer.DeltaMilli());
+
+				cgltf_free(s.Model);
+				delete &s;
+			});
+
+		s.Queue->Close(STREAMING_STAGE::INSTANCES);
+
+		// help with the meshes
+		StreamMeshChunks(s);
+	}
 }
 
-void glTF::Load(const App::Filesystem::Path& pathToglTF) noexcept
+void glTF::Load(const App::Filesystem::Path& pathToglTF, bool cacheMeshBVHs, bool cacheScene, bool buildLODs) noexcept
 {
-	// parse json
-	cgltf_options options{};
-	cgltf_data* model = nullptr;
-	Checkgltf(cgltf_parse_file(&options, pathToglTF.GetView().data(), &model));
+	App::DeltaTimer timer;
+	timer.Start();
 
-	Check(model->extensions_required_count == 0, "Required glTF extensions are not supported.");
+	// .gltf or .glb file. Binary chunk of the latter is used directly from the mapped view.
+	Filesystem::MemoryMappedFile gltfFile;
+	const bool gltfFound = gltfFile.Open(pathToglTF.GetView().data());
+	Check(gltfFound, "glTF file %s was not found.", pathToglTF.GetView().data());
 
-	// load buffers
-	Check(model->buffers_count == 1, "invalid number of buffers");
-	Filesystem::Path bufferPath(pathToglTF.GetView());
-	bufferPath.Directory();
-	bufferPath.Append(model->buffers[0].uri);
-	Checkgltf(cgltf_load_buffers(&options, model, bufferPath.Get()));
+	const uint8_t* json;
+	size_t jsonSize;
+	GetJSON(gltfFile.Data(), gltfFile.Size(), json, jsonSize);
 
-	Check(model->scene, "no scene found in glTF file: %s.", pathToglTF.GetView());
 	const uint64_t sceneID = XXH3_64bits(pathToglTF.GetView().data(), pathToglTF.Length());
 	SceneCore& scene = App::GetScene();
 
+	// everything that's needed to add this scene to SceneCore -- either loaded from the scene cache
+	// or filled in from the glTF file below
+	SceneSnapshot snapshot;
+	// snapshots with and without LODs are told apart by the seed
+	const uint64_t contentHash = cacheScene ? XXH3_64bits_withSeed(json, jsonSize, buildLODs) : 0;
+
+	StackStr(sceneCachePath, sceneCachePathLen, "%s.scene", pathToglTF.GetView().data());
+	const bool loadedSceneFromCache = cacheScene && LoadSceneCache(sceneCachePath, pathToglTF, contentHash, snapshot);
+	const bool writeSceneCache = cacheScene && !loadedSceneFromCache;
+
+	if (writeSceneCache)
+		LOG_UI_INFO("Scene cache %s was missing or stale, rebuilding...\n", sceneCachePath);
+
+	cgltf_data* model = nullptr;
+	size_t totalNumMeshPrims = 0;
+	// accessors are decoded directly from the mapped views into the final arrays rather than reading
+	// the whole buffers into memory first. Has to outlive the mesh workers.
+	SmallVector<Filesystem::MemoryMappedFile> mappedBuffers;
+
+	if (!loadedSceneFromCache)
+	{
+		App::DeltaTimer parseTimer;
+		parseTimer.Start();
+
+		model = Parse(pathToglTF, gltfFile, mappedBuffers, snapshot.BufferURIs, snapshot.BufferHash);
+
+		parseTimer.End();
+		LOG_UI_INFO("glTF JSON (%llu[KB]) parsed and %llu buffer(s) loaded in %u[ms]\n", jsonSize / 1024,
+			model->buffers_count, (uint32_t)parseTimer.DeltaMilli());
+
+		// image URIs, in the same format as the scene cache
+		for (size_t i = 0; i < model->images_count; i++)
+		{
+			const char* uri = model->images[i].uri ? model->images[i].uri : "";
+			snapshot.ImageURIs.append_range(uri, uri + strlen(uri) + 1);
+		}
+
+		// figure out total number of vertices & indices
+		size_t totalNumVertices;
+		size_t totalNumIndices;
+		TotalNumVerticesAndIndices(model, 0, model->meshes_count, totalNumVertices, totalNumIndices, totalNumMeshPrims);
+
+		// preallocate
+		snapshot.Vertices.resize(totalNumVertices);
+		snapshot.Indices.resize(totalNumIndices);
+		snapshot.Meshes.resize(totalNumMeshPrims);
+		snapshot.MeshBVHs.resize(totalNumMeshPrims);
+		snapshot.Materials.resize(model->materials_count);
+	}
+
+	// pointer to each image's URI or null when it doesn't have one
+	SmallVector<const char*> imageURIs;
+
+	for (const char* curr = snapshot.ImageURIs.begin(); curr != snapshot.ImageURIs.end(); curr += strlen(curr) + 1)
+		imageURIs.push_back(*curr != '\0' ? curr : nullptr);
+
 	// all the unique textures that need to be loaded from disk
 	SmallVector<DDSImage> ddsImages;
-	ddsImages.resize(model->images_count);
-
-	// figure out total number of vertices & indices
-	size_t totalNumVertices;
-	size_t totalNumIndices;
-	size_t totalNumMeshPrims;
-	TotalNumVerticesAndIndices(model, totalNumVertices, totalNumIndices, totalNumMeshPrims);
+	ddsImages.resize(imageURIs.size());
 
-	// preallocate
-	Util::SmallVector<Core::Vertex> vertices;
-	Util::SmallVector<uint32_t> indices;
-	Util::SmallVector<MeshSubset> meshPrims;
+	// per-mesh triangle BVHs. If caching is enabled, only the BVHs that are missing from the cache 
+	// are built
+	MeshBVHCache bvhCache;
+	StackStr(bvhCachePath, bvhCachePathLen, "%s.bvh", pathToglTF.GetView().data());
+	const bool useBVHCache = !loadedSceneFromCache && cacheMeshBVHs;
 
-	vertices.resize(totalNumVertices);
-	indices.resize(totalNumIndices);
-	meshPrims.resize(totalNumMeshPrims);
+	if (useBVHCache && !LoadMeshBVHCache(bvhCachePath, bvhCache))
+	{
+		bvhCache.Offsets.clear();
+		LOG_UI_INFO("Mesh BVH cache %s was missing or stale, rebuilding...\n", bvhCachePath);
+	}
 
 	// how many meshes are processed by each worker
 	constexpr size_t MAX_NUM_MESH_WORKERS = 4;
@@ -714,19 +1526,22 @@ void glTF::Load(const App::Filesystem::Path& pathToglTF) noexcept
 	size_t meshThreadOffsets[MAX_NUM_MESH_WORKERS];
 	size_t meshThreadSizes[MAX_NUM_MESH_WORKERS];
 
-	const size_t meshNumThreads = SubdivideRangeWithMin(model->meshes_count,
+	const size_t meshNumThreads = loadedSceneFromCache ? 0 : SubdivideRangeWithMin(model->meshes_count,
 		MAX_NUM_MESH_WORKERS,
 		meshThreadOffsets,
 		meshThreadSizes,
 		MIN_MESHES_PER_WORKER);
 
+	if (meshNumThreads > 1)
+		BalanceMeshRanges(*model, meshNumThreads, meshThreadOffsets, meshThreadSizes);
+
 	// how many images are processed by each worker
 	constexpr size_t MAX_NUM_IMAGE_WORKERS = 5;
 	constexpr size_t MIN_IMAGES_PER_WORKER = 15;
 	size_t imgThreadOffsets[MAX_NUM_IMAGE_WORKERS];
 	size_t imgThreadSizes[MAX_NUM_IMAGE_WORKERS];
 
-	const size_t imgNumThreads = SubdivideRangeWithMin(model->images_count,
+	const size_t imgNumThreads = SubdivideRangeWithMin(imageURIs.size(),
 		MAX_NUM_IMAGE_WORKERS,
 		imgThreadOffsets,
 		imgThreadSizes,
@@ -738,12 +1553,19 @@ void glTF::Load(const App::Filesystem::Path& pathToglTF) noexcept
 	size_t matThreadOffsets[MAX_NUM_MAT_WORKERS];
 	size_t matThreadSizes[MAX_NUM_MAT_WORKERS];
 
-	const size_t matNumThreads = SubdivideRangeWithMin(model->materials_count,
+	const size_t matNumThreads = SubdivideRangeWithMin(snapshot.Materials.size(),
 		MAX_NUM_MAT_WORKERS,
 		matThreadOffsets,
 		matThreadSizes,
 		MIN_MATS_PER_WORKER);
 
+	MeshOptimizer::VertexCacheStats cacheStatsBefore[MAX_NUM_MESH_WORKERS];
+	MeshOptimizer::VertexCacheStats cacheStatsAfter[MAX_NUM_MESH_WORKERS];
+	WorkerMeshData workerData[MAX_NUM_MESH_WORKERS];
+	GeometryOwners geometryOwners;
+	geometryOwners.BuildLODs = buildLODs;
+	geometryOwners.SkipGeometryInScene = !writeSceneCache;
+
 	std::atomic_uint32_t currVtxOffset = 0;
 	std::atomic_uint32_t currIdxOffset = 0;
 	std::atomic_uint32_t currMeshPrimOffset = 0;
@@ -764,25 +1586,80 @@ void glTF::Load(const App::Filesystem::Path& pathToglTF) noexcept
 		std::atomic_uint32_t& CurrIdxOffset;
 		Span<MeshSubset> MeshPrims;
 		std::atomic_uint32_t& CurrMeshPrimOffset;
+		Span<MeshBVH> MeshBVHs;
+		MeshBVHCache* BVHCache;
+		GeometryOwners& Owners;
+		WorkerMeshData* WorkerData;
+		// vertex cache efficiency of the meshes processed by each worker, before and after optimization
+		MeshOptimizer::VertexCacheStats* CacheStatsBefore;
+		MeshOptimizer::VertexCacheStats* CacheStatsAfter;
+		Span<const char*> ImageURIs;
+		Span<MaterialDesc> Materials;
 	};
 
 	ThreadContext tc{ .SceneID = sceneID, .Model = model,
 		.MeshThreadOffsets = meshThreadOffsets, .MeshThreadSizes = meshThreadSizes,
 		.MatThreadOffsets = matThreadOffsets, .MatThreadSizes = matThreadSizes,
 		.ImgThreadOffsets = imgThreadOffsets, .ImgThreadSizes = imgThreadSizes,
-		.Vertices = vertices,
+		.Vertices = snapshot.Vertices,
 		.CurrVtxOffset = currVtxOffset,
-		.Indices = indices,
+		.Indices = snapshot.Indices,
 		.CurrIdxOffset = currIdxOffset,
-		.MeshPrims = meshPrims,
-		.CurrMeshPrimOffset = currMeshPrimOffset };
+		.MeshPrims = snapshot.Meshes,
+		.CurrMeshPrimOffset = currMeshPrimOffset,
+		.MeshBVHs = snapshot.MeshBVHs,
+		.BVHCache = useBVHCache ? &bvhCache : nullptr,
+		.Owners = geometryOwners,
+		.WorkerData = workerData,
+		.CacheStatsBefore = cacheStatsBefore,
+		.CacheStatsAfter = cacheStatsAfter,
+		.ImageURIs = imageURIs,
+		.Materials = snapshot.Materials };
 
 	TaskSet ts;
 
-	auto addMeshesToScene = ts.EmplaceTask("AddMeshesToScene", [&meshPrims, &vertices, &indices, sceneID]()
+	// when the scene cache is being written, meshes are added after serialization instead
+	auto addMeshesToScene = ts.EmplaceTask("AddMeshesToScene", [&snapshot, &tc, &bvhCachePath, meshNumThreads, 
+		writeSceneCache]()
 		{
+			// concatenate the LODs of every worker and make the offsets global
+			for (size_t i = 0; i < meshNumThreads; i++)
+			{
+				const WorkerMeshData& w = tc.WorkerData[i];
+				const uint32_t baseLOD = (uint32_t)snapshot.LODs.size();
+				const uint32_t baseLODIdx = (uint32_t)snapshot.LODIndices.size();
+
+				for (uint32_t m = w.BaseMeshPrim; m < w.BaseMeshPrim + w.NumMeshPrims; m++)
+				{
+					snapshot.Meshes[m].BaseLODOffset += baseLOD;
+					snapshot.Meshes[m].BaseLODIdxOffset += baseLODIdx;
+				}
+
+				snapshot.LODs.append_range(w.LODs.begin(), w.LODs.end());
+				snapshot.LODIndices.append_range(w.LODIndices.begin(), w.LODIndices.end());
+			}
+
+			// owners may have been processed by another worker
+			for (size_t i = 0; i < meshNumThreads; i++)
+				ShareDuplicateGeometry(snapshot.Meshes, tc.WorkerData[i].Duplicates);
+
+			if (tc.BVHCache)
+			{
+				const uint32_t numMisses = tc.BVHCache->NumMisses.load(std::memory_order_relaxed);
+
+				if (numMisses)
+				{
+					LOG_UI_INFO("%u of %llu mesh BVHs were missing from the cache\n", numMisses, snapshot.Meshes.size());
+					WriteMeshBVHCache(bvhCachePath, snapshot.Meshes, snapshot.MeshBVHs);
+				}
+			}
+
+			if (writeSceneCache)
+				return;
+
 			SceneCore& scene = App::GetScene();
-			scene.AddMeshes(sceneID, ZetaMove(meshPrims), ZetaMove(vertices), ZetaMove(indices));
+			scene.AddMeshes(tc.SceneID, ZetaMove(snapshot.Meshes), ZetaMove(snapshot.Vertices), ZetaMove(snapshot.Indices), 
+				ZetaMove(snapshot.LODs), ZetaMove(snapshot.LODIndices), ZetaMove(snapshot.MeshBVHs));
 		});
 
 	for (size_t i = 0; i < meshNumThreads; i++)
@@ -794,7 +1671,9 @@ void glTF::Load(const App::Filesystem::Path& pathToglTF) noexcept
 				ProcessMeshes(*tc.Model, tc.MeshThreadOffsets[rangeIdx], tc.MeshThreadSizes[rangeIdx], 
 					tc.Vertices, tc.CurrVtxOffset, 
 					tc.Indices, tc.CurrIdxOffset,
-					tc.MeshPrims, tc.CurrMeshPrimOffset);
+					tc.MeshPrims, tc.CurrMeshPrimOffset,
+					tc.MeshBVHs, tc.BVHCache, tc.Owners, tc.WorkerData[rangeIdx],
+					tc.CacheStatsBefore[rangeIdx], tc.CacheStatsAfter[rangeIdx]);
 			});
 
 		ts.AddOutgoingEdge(h, addMeshesToScene);
@@ -818,7 +1697,7 @@ void glTF::Load(const App::Filesystem::Path& pathToglTF) noexcept
 				Filesystem::Path parent(pathToglTF.GetView());
 				parent.ToParent();
 
-				LoadDDSImages(tc.SceneID, parent, *tc.Model, tc.ImgThreadOffsets[rangeIdx], tc.ImgThreadSizes[rangeIdx], ddsImages);
+				LoadDDSImages(parent, tc.ImageURIs, tc.ImgThreadOffsets[rangeIdx], tc.ImgThreadSizes[rangeIdx], ddsImages);
 			});
 
 		// sort after all images are loaded
@@ -834,7 +1713,13 @@ void glTF::Load(const App::Filesystem::Path& pathToglTF) noexcept
 				Filesystem::Path parent(pathToglTF.GetView());
 				parent.ToParent();
 
-				ProcessMaterials(tc.SceneID, parent, *tc.Model, (int)tc.MatThreadOffsets[rangeIdx], (int)tc.MatThreadSizes[rangeIdx], ddsImages);
+				const int offset = (int)tc.MatThreadOffsets[rangeIdx];
+				const int size = (int)tc.MatThreadSizes[rangeIdx];
+
+				if (tc.Model)
+					ProcessMaterials(*tc.Model, offset, size, tc.Materials);
+
+				AddMaterials(tc.SceneID, parent, tc.ImageURIs, tc.Materials, offset, size, ddsImages);
 			});
 
 		// make sure processing materials starts after textures are loaded
@@ -848,7 +1733,66 @@ void glTF::Load(const App::Filesystem::Path& pathToglTF) noexcept
 
 	waitObj.Wait();
 
-	ProcessNodes(*model, sceneID);
+	if (meshNumThreads)
+	{
+		MeshOptimizer::VertexCacheStats before;
+		MeshOptimizer::VertexCacheStats after;
+
+		for (size_t i = 0; i < meshNumThreads; i++)
+		{
+			before.Accumulate(cacheStatsBefore[i]);
+			after.Accumulate(cacheStatsAfter[i]);
+		}
+
+		LOG_UI_INFO("Mesh optimization -- ACMR: %.3f -> %.3f, ATVR: %.3f -> %.3f\n", before.ACMR(), after.ACMR(),
+			before.ATVR(), after.ATVR());
+	}
+
+	if (!loadedSceneFromCache)
+	{
+		ProcessNodes(*model, sceneID, snapshot.Instances);
+
+		cgltf_free(model);
+		mappedBuffers.clear();
+	}
+
+	if (writeSceneCache)
+	{
+		SmallVector<uint8_t> data;
+		SerializeSceneSnapshot(snapshot, contentHash, data);
+		Filesystem::WriteToFile(sceneCachePath, data.begin(), (uint32_t)data.size());
+
+		scene.AddMeshes(sceneID, ZetaMove(snapshot.Meshes), ZetaMove(snapshot.Vertices), ZetaMove(snapshot.Indices),
+			ZetaMove(snapshot.LODs), ZetaMove(snapshot.LODIndices), ZetaMove(snapshot.MeshBVHs));
+	}
+
+	scene.AddInstances(sceneID, snapshot.Instances);
+
+	timer.End();
 
-	cgltf_free(model);
-}
\ No newline at end of file
+	if (cacheScene)
+	{
+		LOG_UI_INFO("glTF scene %s loaded in %u[ms] (%s)\n", pathToglTF.GetView().data(), (uint32_t)timer.DeltaMilli(),
+			loadedSceneFromCache ? "warm, from scene cache" : "cold");
+	}
+	else
+		LOG_UI_INFO("glTF scene %s loaded in %u[ms]\n", pathToglTF.GetView().data(), (uint32_t)timer.DeltaMilli());
+}
+
+void glTF::LoadAsync(const App::Filesystem::Path& pathToglTF, bool buildLODs) noexcept
+{
+	StreamingScene* s = new (std::nothrow) StreamingScene(pathToglTF);
+	Check(s, "Allocating memory for streaming glTF scene %s failed.", pathToglTF.GetView().data());
+
+	s->Timer.Start();
+	s->BuildLODs = buildLODs;
+	s->SceneID = XXH3_64bits(pathToglTF.GetView().data(), pathToglTF.Length());
+	s->Queue = &App::GetScene().AddStreamingQueue(STREAMING_STAGE::COUNT);
+
+	Task t("glTF::Stream", TASK_PRIORITY::BACKGRUND, [s]()
+		{
+			StreamScene(*s);
+		});
+
+	App::SubmitBackground(ZetaMove(t));
+}
@@ -9,5 +9,25 @@ namespace ZetaRay::App::Filesystem
 
 namespace ZetaRay::Model::glTF
 {
-	void Load(const App::Filesystem::Path& p) noexcept;
+	// Accepts both .gltf and .glb files. Buffers can be external files (memory mapped), the binary
+	// chunk of a .glb file or base64 data URIs.
+	// When cacheMeshBVHs is true, per-mesh BVHs are loaded from (or if missing, written to) a 
+	// cache file next to the glTF file. Cached BVHs are looked up by the content hash of each mesh's
+	// geometry, so only the meshes that changed are rebuilt. Similarly, when cacheScene is true, the processed scene
+	// (geometry, mesh BVHs, materials and nodes) is loaded from a snapshot next to the glTF
+	// file, which skips parsing and processing the glTF file altogether. Snapshot is rewritten
+	// whenever the glTF file or any of its buffers change (see SceneCache.h).
+	// When buildLODs is true, LODs are generated for every mesh (see MeshSimplifier::BuildLODs()) and
+	// can be queried with SceneCore::GetLODs(). Nothing selects them yet, so they're off by default.
+	// Mesh prims with the same geometry share its LODs, and geometry that's already in the scene keeps
+	// its existing copy.
+	void Load(const App::Filesystem::Path& p, bool cacheMeshBVHs = false, bool cacheScene = false, 
+		bool buildLODs = false) noexcept;
+
+	// Returns immediately. The glTF file is parsed and decoded by background tasks and the scene is
+	// added to SceneCore over the following frames, a few chunks (meshes, materials and then
+	// instances) per frame within the scene's streaming budget (see SceneCore::AddStreamingQueue()).
+	// Static instances are ray traced once all of them have been added. Caches aren't used. buildLODs
+	// is the same as for Load().
+	void LoadAsync(const App::Filesystem::Path& p, bool buildLODs = false) noexcept;
 }
\ No newline at end of file
@@ -19,6 +19,14 @@ namespace ZetaRay::Model::glTF::Asset
 		uint32_t BaseIdxOffset;
 		uint32_t NumVertices;
 		uint32_t NumIndices;
+		// relative to the beginning of the LOD and LOD index buffers. LOD indices are relative to
+		// BaseVtxOffset, same as the mesh's indices.
+		uint32_t BaseLODOffset;
+		uint32_t BaseLODIdxOffset;
+		uint32_t NumLODs;
+		uint32_t NumLODIndices;
+		// content hash of the vertices and indices as decoded (before optimization), see Model::GeometryHash()
+		uint64_t GeometryID;
 	};
 
 	struct InstanceDesc
@@ -7,6 +7,7 @@
 #include "../Model/Mesh.h"
 #include "RtCommon.h"
 #include "../Core/SharedShaderResources.h"
+#include <algorithm>
 
 using namespace ZetaRay;
 using namespace ZetaRay::Core;
@@ -109,6 +110,7 @@ void StaticBLAS::Rebuild(ComputeCmdList& cmdList) noexcept
 	}
 
 	Assert((uint32_t)currInstance == scene.m_numStaticInstances, "Invalid number of instances.");
+	Assert((int)m_instanceIDs.size() == currInstance, "FillMeshTransformBufferForBuild() wasn't called for this rebuild.");
 
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc;
 	buildDesc.Inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
@@ -168,6 +170,9 @@ void StaticBLAS::FillMeshTransformBufferForBuild() noexcept
 	SmallVector<BLASTransform, App::FrameAllocator> transforms;
 	transforms.resize(scene.m_numStaticInstances);
 
+	m_instanceIDs.clear();
+	m_instanceIDs.reserve(scene.m_numStaticInstances);
+
 	int currInstance = 0;
 
 	// skip the first level
@@ -193,6 +198,7 @@ void StaticBLAS::FillMeshTransformBufferForBuild() noexcept
 					transforms[currInstance].M[2][j] = M.m[j].z;
 				}
 
+				m_instanceIDs.push_back(currTreeLevel.m_IDs[i]);
 				currInstance++;
 			}
 		}
@@ -256,6 +262,7 @@ void StaticBLAS::Clear() noexcept
 	m_perMeshTransformForBuild.Reset();
 	m_postBuildInfo.Reset();
 	m_scratchBuffer.Reset();
+	m_instanceIDs.free_memory();
 }
 
 //--------------------------------------------------------------------------------------
@@ -398,7 +405,9 @@ void TLAS::RebuildTLASInstances(ComputeCmdList& cmdList) noexcept
 {
 	SceneCore& scene = App::GetScene();
 
-	const int numInstances = (int)m_dynamicBLASes.size() + (scene.m_numStaticInstances > 0);
+	// static instances that were added after the last rebuild of static BLAS aren't included
+	const int numStaticInstances = (int)m_staticBLAS.m_instanceIDs.size();
+	const int numInstances = (int)m_dynamicBLASes.size() + (numStaticInstances > 0);
 	if (numInstances == 0)
 		return;
 
@@ -415,7 +424,7 @@ void TLAS::RebuildTLASInstances(ComputeCmdList& cmdList) noexcept
 	int currInstance = 0;
 
 	// identity transform for static BLAS instance
-	if (scene.m_numStaticInstances)
+	if (numStaticInstances)
 	{
 		memset(&instance.Transform, 0, sizeof(BLASTransform));
 		instance.Transform[0][0] = 1.0f;
@@ -425,8 +434,6 @@ void TLAS::RebuildTLASInstances(ComputeCmdList& cmdList) noexcept
 		tlasInstances[currInstance++] = instance;
 	}
 
-	const int numStaticInstances = scene.m_numStaticInstances;
-
 	// following traversal order must match the one in RebuildOrUpdateBLASes()
 
 	// skip the first level
@@ -488,9 +495,7 @@ void TLAS::RebuildTLASInstances(ComputeCmdList& cmdList) noexcept
 
 void TLAS::RebuildTLAS(ComputeCmdList& cmdList) noexcept
 {
-	SceneCore& scene = App::GetScene();
-
-	const int numInstances = (int)m_dynamicBLASes.size() + (scene.m_numStaticInstances > 0);
+	const int numInstances = (int)m_dynamicBLASes.size() + !m_staticBLAS.m_instanceIDs.empty();
 	if (numInstances == 0)
 		return;
 
@@ -535,6 +540,32 @@ void TLAS::RebuildOrUpdateBLASes(ComputeCmdList& cmdList) noexcept
 {
 	SceneCore& scene = App::GetScene();
 
+	// drop the BLASes of removed instances. Remaining ones have to stay in the same order as they're
+	// matched to the scene-graph traversal order
+	if (!scene.m_removedDynamicInstances.empty())
+	{
+		std::sort(scene.m_removedDynamicInstances.begin(), scene.m_removedDynamicInstances.end());
+		int numRemaining = 0;
+
+		for (int i = 0; i < (int)m_dynamicBLASes.size(); i++)
+		{
+			if (std::binary_search(scene.m_removedDynamicInstances.begin(), scene.m_removedDynamicInstances.end(), 
+				m_dynamicBLASes[i].m_instanceID))
+			{
+				m_dynamicBLASes[i].Clear();
+				continue;
+			}
+
+			if (numRemaining != i)
+				m_dynamicBLASes[numRemaining] = ZetaMove(m_dynamicBLASes[i]);
+
+			numRemaining++;
+		}
+
+		m_dynamicBLASes.resize(numRemaining);
+		scene.m_removedDynamicInstances.clear();
+	}
+
 	// From DXR specs:
 	// acceleration structures must always be in D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE, 
 	// so resource state transitions cant be used to synchronize between writes and reads of acceleration 
@@ -655,7 +686,7 @@ void TLAS::Clear() noexcept
 void TLAS::BuildFrameMeshInstanceData() noexcept
 {
 	SceneCore& scene = App::GetScene();
-	const size_t numInstances = scene.m_IDtoTreePos.size();
+	const size_t numInstances = scene.m_IDtoHandle.size();
 	SmallVector<RT::MeshInstance, App::FrameAllocator> frameInstanceData;
 	frameInstanceData.resize(numInstances);
 
@@ -687,35 +718,33 @@ void TLAS::BuildFrameMeshInstanceData() noexcept
 		frameInstanceData[currInstance++] = instance;
 	};
 
-	// skip the first level
-	for (int treeLevelIdx = 1; treeLevelIdx < scene.m_sceneGraph.size(); treeLevelIdx++)
+	// Layout:
+	//  -----------------------------------------------------------------------------------------------------
+	// | static mesh 0 | static mesh 1 | ... | static mesh S - 1 | dynamic mesh 0 | ... | dynamic mesh D - 1 |
+	//  -----------------------------------------------------------------------------------------------------
+	// TLAS instance for Static BLAS has instance-ID of 0. 
+	// TLAS instance for Dynamic BLAS d where 0 <= d < D has Instance-ID of S + d
+	// With this setup, every instance can use GeometryIndex() + InstanceID() to index into the mesh instance buffer
+
+	// static meshes, in the same order as their geometries in the static BLAS
+	for (uint64_t insID : m_staticBLAS.m_instanceIDs)
 	{
-		auto& currTreeLevel = scene.m_sceneGraph[treeLevelIdx];
-		const auto& rtFlagVec = currTreeLevel.m_rtFlags;
+		const TreePos* p = scene.FindTreePosFromID(insID);
+		Assert(p, "instance with ID %llu was not found in the scene graph.", insID);
 
-		// Layout:
-		//  -----------------------------------------------------------------------------------------------------
-		// | static mesh 0 | static mesh 1 | ... | static mesh S - 1 | dynamic mesh 0 | ... | dynamic mesh D - 1 |
-		//  -----------------------------------------------------------------------------------------------------
-		// TLAS instance for Static BLAS has instance-ID of 0. 
-		// TLAS instance for Dynamic BLAS d where 0 <= d < D has Instance-ID of S + d
-		// With this setup, every instance can use GeometryIndex() + InstanceID() to index into the mesh instance buffer
+		auto& currTreeLevel = scene.m_sceneGraph[p->Level];
+		const auto mesh = scene.GetMesh(currTreeLevel.m_meshIDs[p->Offset]);
+		const auto mat = scene.GetMaterial(mesh.m_materialID);
 
-		// static meshes
-		for (int i = 0; i < rtFlagVec.size(); i++)
-		{
-			if (currTreeLevel.m_meshIDs[i] == SceneCore::NULL_MESH)
-				continue;
-
-			const auto mesh = scene.GetMesh(currTreeLevel.m_meshIDs[i]);
-			const auto mat = scene.GetMaterial(mesh.m_materialID);
-			auto& M = currTreeLevel.m_toWorlds[i];
+		addTLASInstance(mesh, mat, currTreeLevel.m_toWorlds[p->Offset]);
+	}
 
-			if (Scene::GetRtFlags(rtFlagVec[i]).MeshMode == RT_MESH_MODE::STATIC)
-				addTLASInstance(mesh, mat, M);
-		}
+	// dynamic meshes, skip the first level
+	for (int treeLevelIdx = 1; treeLevelIdx < scene.m_sceneGraph.size(); treeLevelIdx++)
+	{
+		auto& currTreeLevel = scene.m_sceneGraph[treeLevelIdx];
+		const auto& rtFlagVec = currTreeLevel.m_rtFlags;
 
-		// dynamic meshes
 		for (int i = 0; i < rtFlagVec.size(); i++)
 		{
 			if (currTreeLevel.m_meshIDs[i] == SceneCore::NULL_MESH)
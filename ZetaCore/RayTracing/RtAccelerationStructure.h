@@ -34,6 +34,10 @@ namespace ZetaRay::RT
 
 		// each element containa a 3x4 affine transformation matrix
 		Core::DefaultHeapBuffer m_perMeshTransformForBuild;
+
+		// IDs of the static instances in the order of their geometries in the BLAS. Static instances that
+		// were added after the last rebuild aren't included (see SceneCore::m_heldStaticInstances).
+		Util::SmallVector<uint64_t> m_instanceIDs;
 	};
 
 	struct DynamicBLAS
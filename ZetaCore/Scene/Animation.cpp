@@ -0,0 +1,941 @@
+#include "Animation.h"
+#include "../Math/BatchFuncs.h"
+#include "../Math/Common.h"
+#include "../Utility/Error.h"
+#include <string.h>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Scene;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Math;
+
+namespace
+{
+	using VFloat = simd<float, 8>;
+
+	// with steady playback, the next keyframe is usually the cached one or the one after it. If it's
+	// more than a few keyframes ahead, time must have jumped, so fall back to binary search.
+	constexpr int MAX_NUM_LINEAR_STEPS = 4;
+
+	// Inputs for interpolating a batch of animations in SoA layout. Batches span several SIMD groups,
+	// so that by the time a group is loaded, the scalar stores that filled it have retired and there's
+	// no store-forwarding stall.
+	struct Batch
+	{
+		static constexpr int NUM_COMPONENTS = 10;
+		static constexpr int SIZE = VFloat::Width * 8;
+
+		// scale (xyz), rotation (xyzw), translation (xyz) for the keyframe before and after
+		alignas(32) float K1[NUM_COMPONENTS][SIZE];
+		alignas(32) float K2[NUM_COMPONENTS][SIZE];
+		// interpolation parameter for scale, rotation and translation
+		alignas(32) float T[3][SIZE];
+	};
+
+	// first component of every track in Batch
+	constexpr int SCALE_COMPONENT = 0;
+	constexpr int ROTATION_COMPONENT = 3;
+	constexpr int TRANSLATION_COMPONENT = 7;
+
+	ZetaInline void GatherFloat3(const float3& f, float lanes[][Batch::SIZE], int lane) noexcept
+	{
+		lanes[0][lane] = f.x;
+		lanes[1][lane] = f.y;
+		lanes[2][lane] = f.z;
+	}
+
+	ZetaInline void GatherFloat4(const float4& f, float lanes[][Batch::SIZE], int lane) noexcept
+	{
+		lanes[0][lane] = f.x;
+		lanes[1][lane] = f.y;
+		lanes[2][lane] = f.z;
+		lanes[3][lane] = f.w;
+	}
+
+	ZetaInline void GatherTransform(const AffineTransformation& tr, float lanes[][Batch::SIZE], int lane) noexcept
+	{
+		GatherFloat3(tr.Scale, lanes + SCALE_COMPONENT, lane);
+		GatherFloat4(tr.Rotation, lanes + ROTATION_COMPONENT, lane);
+		GatherFloat3(tr.Translation, lanes + TRANSLATION_COMPONENT, lane);
+	}
+
+	ZetaInline soa_float3<VFloat> LoadFloat3(float lanes[][Batch::SIZE], int lane) noexcept
+	{
+		return soa_float3<VFloat>(VFloat::load(lanes[0] + lane), VFloat::load(lanes[1] + lane),
+			VFloat::load(lanes[2] + lane));
+	}
+
+	ZetaInline soa_float4<VFloat> LoadFloat4(float lanes[][Batch::SIZE], int lane) noexcept
+	{
+		return soa_float4<VFloat>{ VFloat::load(lanes[0] + lane), VFloat::load(lanes[1] + lane),
+			VFloat::load(lanes[2] + lane), VFloat::load(lanes[3] + lane) };
+	}
+
+	ZetaInline void StoreFloat3(const soa_float3<VFloat>& v, float lanes[][Batch::SIZE], int lane) noexcept
+	{
+		v.x.store(lanes[0] + lane);
+		v.y.store(lanes[1] + lane);
+		v.z.store(lanes[2] + lane);
+	}
+
+	ZetaInline void StoreFloat4(const soa_float4<VFloat>& v, float lanes[][Batch::SIZE], int lane) noexcept
+	{
+		v.x.store(lanes[0] + lane);
+		v.y.store(lanes[1] + lane);
+		v.z.store(lanes[2] + lane);
+		v.w.store(lanes[3] + lane);
+	}
+
+	// Unused lanes of the last group interpolate between two identity transformations
+	void PadBatch(Batch& batch, int batchSize, int numLanes) noexcept
+	{
+		for (int lane = batchSize; lane < numLanes; lane++)
+		{
+			GatherTransform(AffineTransformation::GetIdentity(), batch.K1, lane);
+			GatherTransform(AffineTransformation::GetIdentity(), batch.K2, lane);
+			batch.T[0][lane] = 0.0f;
+			batch.T[1][lane] = 0.0f;
+			batch.T[2][lane] = 0.0f;
+		}
+	}
+
+	// Interpolates VFloat::Width animations at a time, results are written over K1
+	void InterpolateBatch(Batch& batch, int numLanes) noexcept
+	{
+		for (int lane = 0; lane < numLanes; lane += VFloat::Width)
+		{
+			const soa_float3<VFloat> vScale = lerp(LoadFloat3(batch.K1 + SCALE_COMPONENT, lane),
+				LoadFloat3(batch.K2 + SCALE_COMPONENT, lane), VFloat::load(batch.T[0] + lane));
+			const soa_float4<VFloat> vRot = slerp(LoadFloat4(batch.K1 + ROTATION_COMPONENT, lane),
+				LoadFloat4(batch.K2 + ROTATION_COMPONENT, lane), VFloat::load(batch.T[1] + lane));
+			const soa_float3<VFloat> vTranslation = lerp(LoadFloat3(batch.K1 + TRANSLATION_COMPONENT, lane),
+				LoadFloat3(batch.K2 + TRANSLATION_COMPONENT, lane), VFloat::load(batch.T[2] + lane));
+
+			StoreFloat3(vScale, batch.K1 + SCALE_COMPONENT, lane);
+			StoreFloat4(vRot, batch.K1 + ROTATION_COMPONENT, lane);
+			StoreFloat3(vTranslation, batch.K1 + TRANSLATION_COMPONENT, lane);
+		}
+	}
+
+	void ScatterBatch(const Batch& batch, int batchSize, AffineTransformation* out) noexcept
+	{
+		for (int lane = 0; lane < batchSize; lane++)
+		{
+			AffineTransformation& tr = out[lane];
+			tr.Scale = float3(batch.K1[0][lane], batch.K1[1][lane], batch.K1[2][lane]);
+			tr.Rotation = float4(batch.K1[3][lane], batch.K1[4][lane], batch.K1[5][lane], batch.K1[6][lane]);
+			tr.Translation = float3(batch.K1[7][lane], batch.K1[8][lane], batch.K1[9][lane]);
+		}
+	}
+
+	struct KeyframePair
+	{
+		int K1;
+		int K2;
+		float T;
+	};
+
+	// Returns the pair of keyframes around time t along with the interpolation parameter. time(i)
+	// returns time of the i'th keyframe and must be strictly increasing. Before the first keyframe
+	// and after the last one, both keyframes of the pair are the same.
+	template<typename TimeFunc>
+	ZetaInline KeyframePair FindKeyframePair(int n, int& cursor, float t, TimeFunc time) noexcept
+	{
+		if (n == 1)
+			return KeyframePair{ .K1 = 0, .K2 = 0, .T = 0.0f };
+
+		// common case -- time is still between the same two keyframes as last time. Checked first
+		// so that the first and last keyframes aren't touched (they're usually on other cache lines).
+		if (cursor >= n - 1 || time(cursor) > t || t >= time(cursor + 1))
+		{
+			if (t <= time(0))
+			{
+				cursor = 0;
+				return KeyframePair{ .K1 = 0, .K2 = 0, .T = 0.0f };
+			}
+
+			if (t >= time(n - 1))
+			{
+				cursor = n - 2;
+				return KeyframePair{ .K1 = n - 1, .K2 = n - 1, .T = 0.0f };
+			}
+
+			bool found = false;
+
+			if (cursor < n - 1 && time(cursor) <= t)
+			{
+				for (int i = 0; i < MAX_NUM_LINEAR_STEPS && !found; i++)
+				{
+					cursor++;
+					found = t < time(cursor + 1);
+				}
+			}
+
+			// binary search for the last keyframe with time <= t
+			if (!found)
+			{
+				int beg = 0;
+				int end = n - 1;
+
+				while (end - beg > 1)
+				{
+					const int mid = beg + ((end - beg) >> 1);
+
+					if (time(mid) <= t)
+						beg = mid;
+					else
+						end = mid;
+				}
+
+				cursor = beg;
+			}
+		}
+
+		const float t1 = time(cursor);
+		const float t2 = time(cursor + 1);
+		Assert(t1 <= t && t < t2, "bug");
+
+		return KeyframePair{ .K1 = cursor, .K2 = cursor + 1, .T = (t - t1) / (t2 - t1) };
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Quantization
+	//--------------------------------------------------------------------------------------
+
+	constexpr float MAX_UINT8 = 255.0f;
+	constexpr float MAX_UINT16 = 65535.0f;
+	constexpr float MAX_UINT15 = 32767.0f;
+	// the three smallest components of a unit quaternion are in [-1 / sqrt(2), 1 / sqrt(2)]
+	constexpr float ONE_OVER_SQRT2 = 0.7071067811865475f;
+	// upper bound for the angle between a unit quaternion and its "smallest three" encoding (radians)
+	constexpr float QUATERNION_QUANTIZATION_ERROR = 1.5e-4f;
+	// largest part of the tolerance that quantization of times can take, the rest is for values
+	constexpr float MAX_TIME_ERROR_FRACTION = 0.25f;
+
+	ZetaInline uint16_t QuantizeUnorm(float x, float maxVal) noexcept
+	{
+		return (uint16_t)(Math::Min(Math::Max(x, 0.0f), 1.0f) * maxVal + 0.5f);
+	}
+
+	// Number of bits per component of scale & translation tracks -- 8 or 16 bits relative to the
+	// range of the track, or 32 for floats. Smallest one whose quantization error is at most maxError
+	// is used.
+	ZetaInline int SelectNumBits(float range, float maxError) noexcept
+	{
+		if (0.5f * range / MAX_UINT8 <= maxError)
+			return 8;
+
+		if (0.5f * range / MAX_UINT16 <= maxError)
+			return 16;
+
+		return 32;
+	}
+
+	ZetaInline float MaxQuantized(int numBits) noexcept
+	{
+		return numBits == 8 ? MAX_UINT8 : MAX_UINT16;
+	}
+
+	// Size of one keyframe of a track in bytes. Quantized rotations always take 16 bits per component.
+	ZetaInline uint32_t KeySize(int numBits, bool isRotation) noexcept
+	{
+		if (isRotation)
+			return numBits == 32 ? sizeof(float) * 4 : sizeof(uint16_t) * 3;
+
+		return 3 * numBits / 8;
+	}
+
+	// Quantized scale & translation tracks start with the minimum and the step of their range (float3
+	// each), followed by the keyframes
+	constexpr uint32_t QUANTIZATION_HEADER_SIZE = sizeof(float) * 6;
+
+	ZetaInline uint32_t TrackSize(uint32_t numKeys, int numBits, bool isRotation) noexcept
+	{
+		const uint32_t headerSize = isRotation || numBits == 32 ? 0 : QUANTIZATION_HEADER_SIZE;
+		return headerSize + numKeys * KeySize(numBits, isRotation);
+	}
+
+	template<typename T>
+	ZetaInline void AppendBytes(const T& v, SmallVector<uint8_t>& out) noexcept
+	{
+		out.append_range(reinterpret_cast<const uint8_t*>(&v), reinterpret_cast<const uint8_t*>(&v) + sizeof(T));
+	}
+
+	void EncodeFloat3(const float3& v, int numBits, const float3& minVal, const float3& step, 
+		SmallVector<uint8_t>& out) noexcept
+	{
+		const float c[3] = { v.x, v.y, v.z };
+
+		if (numBits == 32)
+		{
+			AppendBytes(c, out);
+			return;
+		}
+
+		const float m[3] = { minVal.x, minVal.y, minVal.z };
+		const float s[3] = { step.x, step.y, step.z };
+		const float maxQ = MaxQuantized(numBits);
+		uint16_t q[3];
+
+		for (int i = 0; i < 3; i++)
+			q[i] = s[i] > 0.0f ? QuantizeUnorm((c[i] - m[i]) / (s[i] * maxQ), maxQ) : 0;
+
+		if (numBits == 8)
+		{
+			for (int i = 0; i < 3; i++)
+				out.push_back((uint8_t)q[i]);
+		}
+		else
+			AppendBytes(q, out);
+	}
+
+	// Decodes keyframe k of a scale or translation track
+	ZetaInline float3 DecodeFloat3(const uint8_t* track, int numBits, uint32_t k) noexcept
+	{
+		if (numBits == 32)
+		{
+			float c[3];
+			memcpy(c, track + k * sizeof(c), sizeof(c));
+
+			return float3(c[0], c[1], c[2]);
+		}
+
+		float h[6];
+		memcpy(h, track, sizeof(h));
+		const uint8_t* key = track + QUANTIZATION_HEADER_SIZE + k * KeySize(numBits, false);
+
+		if (numBits == 8)
+			return float3(h[0] + h[3] * key[0], h[1] + h[4] * key[1], h[2] + h[5] * key[2]);
+
+		uint16_t q[3];
+		memcpy(q, key, sizeof(q));
+
+		return float3(h[0] + h[3] * q[0], h[1] + h[4] * q[1], h[2] + h[5] * q[2]);
+	}
+
+	// "Smallest three" -- as q and -q represent the same rotation, q is negated if needed so that its
+	// largest component is positive, which can then be recovered from the other three. Index of the
+	// largest component goes in the top bits of the first two words.
+	ZetaInline void EncodeQuaternion(const float4& q, uint16_t* out) noexcept
+	{
+		const float c[4] = { q.x, q.y, q.z, q.w };
+		int largest = 0;
+
+		for (int i = 1; i < 4; i++)
+		{
+			if (fabsf(c[i]) > fabsf(c[largest]))
+				largest = i;
+		}
+
+		const float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+		int j = 0;
+
+		for (int i = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+
+			// [-1 / sqrt(2), 1 / sqrt(2)] -> [0, 1]
+			const float unorm = c[i] * sign * ONE_OVER_SQRT2 + 0.5f;
+			out[j++] = QuantizeUnorm(unorm, MAX_UINT15);
+		}
+
+		out[0] |= (uint16_t)((largest >> 1) << 15);
+		out[1] |= (uint16_t)((largest & 0x1) << 15);
+	}
+
+	ZetaInline float4 DecodeQuaternion(const uint16_t* in) noexcept
+	{
+		constexpr float SCALE = 1.0f / MAX_UINT15;
+		const int largest = ((in[0] >> 15) << 1) | (in[1] >> 15);
+		float c[4];
+		float sumSq = 0.0f;
+		int j = 0;
+
+		for (int i = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+
+			// [0, 1] -> [-1 / sqrt(2), 1 / sqrt(2)]
+			c[i] = ((in[j++] & 0x7fff) * SCALE - 0.5f) * 2.0f * ONE_OVER_SQRT2;
+			sumSq += c[i] * c[i];
+		}
+
+		c[largest] = sqrtf(Math::Max(1.0f - sumSq, 0.0f));
+
+		return float4(c[0], c[1], c[2], c[3]);
+	}
+
+	// Decodes keyframe k of a rotation track
+	ZetaInline float4 DecodeRotation(const uint8_t* track, int numBits, uint32_t k) noexcept
+	{
+		if (numBits == 32)
+		{
+			float c[4];
+			memcpy(c, track + k * sizeof(c), sizeof(c));
+
+			return float4(c[0], c[1], c[2], c[3]);
+		}
+
+		uint16_t q[3];
+		memcpy(q, track + k * sizeof(q), sizeof(q));
+
+		return DecodeQuaternion(q);
+	}
+
+	// Times of a track are either 16-bit or floats (rawTimes is non-null)
+	ZetaInline KeyframePair FindKeyframePair(int n, int& cursor, float t, const uint16_t* times, 
+		const float* rawTimes) noexcept
+	{
+		if (rawTimes)
+			return FindKeyframePair(n, cursor, t, [rawTimes](int k) { return rawTimes[k]; });
+
+		return FindKeyframePair(n, cursor, t, [times](int k) { return (float)times[k]; });
+	}
+
+	//--------------------------------------------------------------------------------------
+	// Keyframe reduction
+	//--------------------------------------------------------------------------------------
+
+	// bounds the cost of reduction, which is quadratic in the length of every segment
+	constexpr int MAX_SEGMENT_LENGTH = 512;
+
+	float4 SlerpScalar(const float4& q1, float4 q2, float t) noexcept
+	{
+		float cosTheta = q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+		if (cosTheta < 0.0f)
+		{
+			q2 = -q2;
+			cosTheta = -cosTheta;
+		}
+
+		float4 q;
+
+		if (cosTheta > 1.0f - FLT_EPSILON)
+			q = q1 * (1.0f - t) + q2 * t;
+		else
+		{
+			const float theta = acosf(cosTheta);
+			const float sinTheta = sinf(theta);
+			q = q1 * (sinf((1.0f - t) * theta) / sinTheta) + q2 * (sinf(t * theta) / sinTheta);
+		}
+
+		q.normalize();
+
+		return q;
+	}
+
+	ZetaInline float MaxAbsDiff(const float3& a, const float3& b) noexcept
+	{
+		return Math::Max(fabsf(a.x - b.x), Math::Max(fabsf(a.y - b.y), fabsf(a.z - b.z)));
+	}
+
+	// Angle of the rotation between two unit quaternions. For small angles, acos(dot(q1, q2)) is too
+	// imprecise in single precision (~1e-3 radians), so it's computed from the chord length instead.
+	ZetaInline float AngleBetween(const float4& q1, const float4& q2) noexcept
+	{
+		const float d = q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w;
+		const float4 diff = d >= 0.0f ? q1 - q2 : q1 + q2;
+		const float chord = sqrtf(diff.x * diff.x + diff.y * diff.y + diff.z * diff.z + diff.w * diff.w);
+
+		return 4.0f * asinf(Math::Min(0.5f * chord, 1.0f));
+	}
+
+	// Greedily extends every segment for as long as all the keyframes inside it can be reconstructed
+	// by interpolating its endpoints, i.e. error(a, b, i, t) <= tol, where t is the interpolation
+	// parameter of keyframe i between keyframes a and b. Indices of the remaining keyframes are
+	// written to retained. Interpolation parameter is computed from the original times -- rounding
+	// of the quantized times is the same with or without reduction and would otherwise prevent
+	// keyframes on fast-changing linear segments from being removed. times are the times that are 
+	// stored (possibly quantized).
+	template<typename ErrorFunc>
+	void ReduceKeyframes(Span<Keyframe> keyframes, Span<float> times, float tol, ErrorFunc error, 
+		SmallVector<int>& retained) noexcept
+	{
+		const int n = (int)times.size();
+		retained.clear();
+
+		bool isConstant = true;
+		for (int i = 1; i < n && isConstant; i++)
+			isConstant = error(0, 0, i, 0.0f) <= tol;
+
+		if (isConstant)
+		{
+			retained.push_back(0);
+			return;
+		}
+
+		auto interpolatedT = [keyframes](int a, int b, int i)
+			{
+				return (keyframes[i].Time - keyframes[a].Time) / (keyframes[b].Time - keyframes[a].Time);
+			};
+
+		int anchor = 0;
+		retained.push_back(0);
+
+		for (int j = 2; j < n; j++)
+		{
+			// quantized times must be strictly increasing, otherwise j can't be an endpoint
+			bool fits = j - anchor <= MAX_SEGMENT_LENGTH && times[j] > times[anchor];
+
+			for (int i = anchor + 1; i < j && fits; i++)
+				fits = error(anchor, j, i, interpolatedT(anchor, j, i)) <= tol;
+
+			if (!fits)
+			{
+				anchor = j - 1;
+				retained.push_back(anchor);
+			}
+		}
+
+		retained.push_back(n - 1);
+
+		// keyframes that were too close to each other end up with the same quantized time. The last
+		// keyframe is always kept so that the whole duration is covered.
+		int numRetained = 1;
+
+		for (int i = 1; i < (int)retained.size(); i++)
+		{
+			if (times[retained[i]] > times[retained[numRetained - 1]])
+				retained[numRetained++] = retained[i];
+			else if (i == (int)retained.size() - 1)
+				retained[numRetained - 1] = retained[i];
+		}
+
+		retained.resize(numRetained);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// CompressedAnimations
+//--------------------------------------------------------------------------------------
+
+void CompressedAnimations::Add(Span<Keyframe> keyframes, float tOffset, const AnimationCompressionParams& params) noexcept
+{
+	Check(keyframes.size() > 0, "Invalid animation.");
+
+	// keyframes that all have the same time are collapsed into the last one
+	if (keyframes[keyframes.size() - 1].Time <= keyframes[0].Time)
+		keyframes = Span(keyframes.data() + keyframes.size() - 1, 1);
+
+	const int n = (int)keyframes.size();
+	const float duration = keyframes[n - 1].Time - keyframes[0].Time;
+
+	auto scale = [keyframes](int i) { return keyframes[i].Transform.Scale; };
+	auto rotation = [keyframes](int i) { return keyframes[i].Transform.Rotation; };
+	auto translation = [keyframes](int i) { return keyframes[i].Transform.Translation; };
+
+	const float tol[TRACK::COUNT] = { params.ScaleTolerance, params.RotationTolerance, params.TranslationTolerance };
+	float maxRate[TRACK::COUNT] = { 0.0f, 0.0f, 0.0f };
+	float minInterval = FLT_MAX;
+	bool isIncreasing = n > 1;
+
+	for (int i = 1; i < n && isIncreasing; i++)
+	{
+		const float interval = keyframes[i].Time - keyframes[i - 1].Time;
+		isIncreasing = interval > 0.0f;
+
+		if (isIncreasing)
+		{
+			minInterval = Math::Min(minInterval, interval);
+			maxRate[TRACK::SCALE] = Math::Max(maxRate[TRACK::SCALE], MaxAbsDiff(scale(i), scale(i - 1)) / interval);
+			maxRate[TRACK::ROTATION] = Math::Max(maxRate[TRACK::ROTATION], AngleBetween(rotation(i), rotation(i - 1)) / interval);
+			maxRate[TRACK::TRANSLATION] = Math::Max(maxRate[TRACK::TRANSLATION],
+				MaxAbsDiff(translation(i), translation(i - 1)) / interval);
+		}
+	}
+
+	Animation anim;
+	anim.BegTime = keyframes[0].Time;
+	anim.BegTimeOffset = tOffset;
+	anim.TimeScale = 1.0f;
+
+	SmallVector<float> times;
+	times.resize(n);
+	float timeError[TRACK::COUNT] = { 0.0f, 0.0f, 0.0f };
+
+	// Times are stored as 16-bit multiples of a time step. Every keyframe is shifted by the rounding, 
+	// which changes the interpolated values by up to that much times the rate of change of the track.
+	// Shortest interval between the keyframes (averaged over the whole duration to reduce the float
+	// error) is tried first, which is exact for animations that were sampled at a fixed rate, followed
+	// by 1 / 65535 of the duration. When neither is within the tolerance or keyframes would end up with
+	// the same time (e.g. long clips), times are stored as floats.
+	auto quantizeTimes = [keyframes, n, &tol, &maxRate, &times, &timeError, &anim](float step)
+		{
+			float maxShift = 0.0f;
+
+			for (int i = 0; i < n; i++)
+			{
+				const float t = keyframes[i].Time - keyframes[0].Time;
+				const float q = roundf(t / step);
+
+				if (q > MAX_UINT16 || (i > 0 && q <= times[i - 1]))
+					return false;
+
+				times[i] = q;
+				maxShift = Math::Max(maxShift, fabsf(q * step - t));
+			}
+
+			for (int i = 0; i < TRACK::COUNT; i++)
+			{
+				timeError[i] = maxRate[i] * maxShift;
+
+				if (timeError[i] > MAX_TIME_ERROR_FRACTION * tol[i])
+					return false;
+			}
+
+			anim.TimeScale = 1.0f / step;
+
+			return true;
+		};
+
+	anim.RawTimes = params.Raw || !isIncreasing || 
+		(!quantizeTimes(duration / roundf(duration / minInterval)) && !quantizeTimes(duration / MAX_UINT16));
+
+	if (anim.RawTimes)
+	{
+		for (int i = 0; i < n; i++)
+			times[i] = keyframes[i].Time - keyframes[0].Time;
+
+		for (int i = 0; i < TRACK::COUNT; i++)
+			timeError[i] = 0.0f;
+	}
+
+	SmallVector<int> retained;
+
+	auto appendTimes = [this, &anim, &times, &retained](Track& track)
+		{
+			track.NumKeys = (uint32_t)retained.size();
+
+			if (anim.RawTimes)
+			{
+				track.TimeOffset = (uint32_t)m_rawTimes.size();
+
+				for (int i : retained)
+					m_rawTimes.push_back(times[i]);
+			}
+			else
+			{
+				track.TimeOffset = (uint32_t)m_times.size();
+
+				for (int i : retained)
+					m_times.push_back((uint16_t)times[i]);
+			}
+		};
+
+	// lossless tracks only drop the keyframes that interpolation reproduces exactly
+	auto addFloat3Track = [this, &params, keyframes, &times, &retained, &appendTimes](Track& track, float tol, 
+		auto getValue)
+		{
+			float3 minVal(FLT_MAX, FLT_MAX, FLT_MAX);
+			float3 maxVal(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+			for (int i = 0; i < (int)keyframes.size(); i++)
+			{
+				const float3 v = getValue(i);
+				minVal = float3(Math::Min(minVal.x, v.x), Math::Min(minVal.y, v.y), Math::Min(minVal.z, v.z));
+				maxVal = float3(Math::Max(maxVal.x, v.x), Math::Max(maxVal.y, v.y), Math::Max(maxVal.z, v.z));
+			}
+
+			// range of the retained keyframes can only be smaller, so quantization error doesn't increase
+			const float3 extent = maxVal - minVal;
+			const float range = Math::Max(extent.x, Math::Max(extent.y, extent.z));
+			int numBits = params.Raw ? 32 : SelectNumBits(range, 0.5f * tol);
+			const float quantizationError = numBits == 32 ? 0.0f : 0.5f * range / MaxQuantized(numBits);
+
+			ReduceKeyframes(keyframes, times, params.Raw ? 0.0f : tol - quantizationError, 
+				[getValue](int a, int b, int i, float t)
+				{
+					return MaxAbsDiff(getValue(a) + (getValue(b) - getValue(a)) * t, getValue(i));
+				}, retained);
+
+			// a single keyframe takes less space than the quantization header
+			if (retained.size() == 1)
+				numBits = 32;
+
+			track.NumBits = (uint8_t)numBits;
+			track.ValueOffset = (uint32_t)m_values.size();
+			appendTimes(track);
+
+			minVal = float3(FLT_MAX, FLT_MAX, FLT_MAX);
+			maxVal = float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+			for (int i : retained)
+			{
+				const float3 v = getValue(i);
+				minVal = float3(Math::Min(minVal.x, v.x), Math::Min(minVal.y, v.y), Math::Min(minVal.z, v.z));
+				maxVal = float3(Math::Max(maxVal.x, v.x), Math::Max(maxVal.y, v.y), Math::Max(maxVal.z, v.z));
+			}
+
+			const float3 step = (maxVal - minVal) / MaxQuantized(numBits);
+
+			if (numBits != 32)
+			{
+				const float h[6] = { minVal.x, minVal.y, minVal.z, step.x, step.y, step.z };
+				AppendBytes(h, m_values);
+			}
+
+			for (int i : retained)
+				EncodeFloat3(getValue(i), numBits, minVal, step, m_values);
+		};
+
+	addFloat3Track(anim.Tracks[TRACK::SCALE], tol[TRACK::SCALE] - timeError[TRACK::SCALE], scale);
+
+	// rotation
+	{
+		const float rotationTol = tol[TRACK::ROTATION] - timeError[TRACK::ROTATION];
+		const int numBits = params.Raw || 0.5f * rotationTol < QUATERNION_QUANTIZATION_ERROR ? 32 : 16;
+		const float quantizationError = numBits == 32 ? 0.0f : QUATERNION_QUANTIZATION_ERROR;
+
+		ReduceKeyframes(keyframes, times, params.Raw ? 0.0f : rotationTol - quantizationError, 
+			[rotation](int a, int b, int i, float t)
+			{
+				return AngleBetween(SlerpScalar(rotation(a), rotation(b), t), rotation(i));
+			}, retained);
+
+		Track& track = anim.Tracks[TRACK::ROTATION];
+		track.NumBits = (uint8_t)numBits;
+		track.ValueOffset = (uint32_t)m_values.size();
+		appendTimes(track);
+
+		for (int i : retained)
+		{
+			const float4 q = rotation(i);
+
+			if (numBits == 32)
+			{
+				const float c[4] = { q.x, q.y, q.z, q.w };
+				AppendBytes(c, m_values);
+			}
+			else
+			{
+				uint16_t e[3];
+				EncodeQuaternion(q, e);
+				AppendBytes(e, m_values);
+			}
+		}
+	}
+
+	addFloat3Track(anim.Tracks[TRACK::TRANSLATION], tol[TRACK::TRANSLATION] - timeError[TRACK::TRANSLATION], 
+		translation);
+
+	m_animations.push_back(anim);
+}
+
+void CompressedAnimations::Remove(Span<bool> isRemoved) noexcept
+{
+	Assert(isRemoved.size() == m_animations.size(), "Invalid input.");
+
+	// relative order is preserved, so keyframes of the remaining animations only move backwards
+	size_t numAnimations = 0;
+	uint32_t numTimes = 0;
+	uint32_t numRawTimes = 0;
+	uint32_t numValueBytes = 0;
+
+	for (size_t i = 0; i < m_animations.size(); i++)
+	{
+		if (isRemoved[i])
+			continue;
+
+		Animation anim = m_animations[i];
+
+		for (int j = 0; j < TRACK::COUNT; j++)
+		{
+			Track& track = anim.Tracks[j];
+			uint32_t& timeOffset = anim.RawTimes ? numRawTimes : numTimes;
+
+			for (uint32_t k = 0; k < track.NumKeys; k++)
+			{
+				if (anim.RawTimes)
+					m_rawTimes[timeOffset + k] = m_rawTimes[track.TimeOffset + k];
+				else
+					m_times[timeOffset + k] = m_times[track.TimeOffset + k];
+			}
+
+			const uint32_t numBytes = TrackSize(track.NumKeys, track.NumBits, j == TRACK::ROTATION);
+
+			for (uint32_t b = 0; b < numBytes; b++)
+				m_values[numValueBytes + b] = m_values[track.ValueOffset + b];
+
+			track.TimeOffset = timeOffset;
+			track.ValueOffset = numValueBytes;
+			timeOffset += track.NumKeys;
+			numValueBytes += numBytes;
+		}
+
+		m_animations[numAnimations++] = anim;
+	}
+
+	m_animations.resize(numAnimations);
+	m_times.resize(numTimes);
+	m_rawTimes.resize(numRawTimes);
+	m_values.resize(numValueBytes);
+}
+
+AffineTransformation CompressedAnimations::Sample(size_t animIdx, float t) const noexcept
+{
+	const Animation& anim = m_animations[animIdx];
+	// same units as the stored times
+	const float u = (t - anim.BegTimeOffset - anim.BegTime) * anim.TimeScale;
+	AffineTransformation ret;
+
+	for (int i = 0; i < TRACK::COUNT; i++)
+	{
+		const Track& track = anim.Tracks[i];
+		const uint8_t* values = m_values.begin() + track.ValueOffset;
+
+		int cursor = 0;
+		const KeyframePair p = FindKeyframePair(track.NumKeys, cursor, u, m_times.begin() + track.TimeOffset,
+			anim.RawTimes ? m_rawTimes.begin() + track.TimeOffset : nullptr);
+
+		if (i == TRACK::ROTATION)
+		{
+			ret.Rotation = SlerpScalar(DecodeRotation(values, track.NumBits, p.K1), 
+				DecodeRotation(values, track.NumBits, p.K2), p.T);
+			continue;
+		}
+
+		const float3 v1 = DecodeFloat3(values, track.NumBits, p.K1);
+		const float3 v2 = DecodeFloat3(values, track.NumBits, p.K2);
+		const float3 v = v1 + (v2 - v1) * p.T;
+
+		if (i == TRACK::SCALE)
+			ret.Scale = v;
+		else
+			ret.Translation = v;
+	}
+
+	return ret;
+}
+
+size_t CompressedAnimations::SizeInBytes() const noexcept
+{
+	return m_animations.size() * sizeof(Animation) + m_times.size() * sizeof(uint16_t) +
+		m_rawTimes.size() * sizeof(float) + m_values.size();
+}
+
+void CompressedAnimations::Clear() noexcept
+{
+	m_animations.free_memory();
+	m_times.free_memory();
+	m_rawTimes.free_memory();
+	m_values.free_memory();
+}
+
+//--------------------------------------------------------------------------------------
+// AnimationSampler
+//--------------------------------------------------------------------------------------
+
+int AnimationSampler::Prepare(size_t numCursors, size_t numAnimations, int maxNumJobs) noexcept
+{
+	// new animations start from their first keyframe
+	if (m_cursors.size() != numCursors)
+		m_cursors.resize(numCursors, 0);
+
+	if (numAnimations == 0)
+		return 0;
+
+	return (int)SubdivideRangeWithMin(numAnimations, Math::Min(maxNumJobs, MAX_NUM_JOBS), Span(m_jobOffsets),
+		Span(m_jobSizes), MIN_ANIMATIONS_PER_JOB);
+}
+
+void AnimationSampler::SampleRange(Span<Keyframe> keyframes, Span<AnimationOffset> animations, float t,
+	Span<AffineTransformation> out, size_t beg, size_t n) noexcept
+{
+	Batch batch;
+
+	for (size_t base = beg; base < beg + n; base += Batch::SIZE)
+	{
+		const int batchSize = (int)Math::Min<size_t>(Batch::SIZE, beg + n - base);
+		const int numLanes = (int)Math::AlignUp(batchSize, VFloat::Width);
+
+		// find the pair of keyframes for every animation in this batch
+		for (int lane = 0; lane < batchSize; lane++)
+		{
+			const AnimationOffset& anim = animations[base + lane];
+			const Keyframe* k = keyframes.data() + anim.BegOffset;
+			const int numKeyframes = anim.EndOffset - anim.BegOffset;
+			Assert(numKeyframes > 0, "Invalid animation.");
+
+			const KeyframePair p = FindKeyframePair(numKeyframes, m_cursors[base + lane], t - anim.BegTimeOffset,
+				[k](int i) { return k[i].Time; });
+
+			GatherTransform(k[p.K1].Transform, batch.K1, lane);
+			GatherTransform(k[p.K2].Transform, batch.K2, lane);
+			batch.T[0][lane] = p.T;
+			batch.T[1][lane] = p.T;
+			batch.T[2][lane] = p.T;
+		}
+
+		PadBatch(batch, batchSize, numLanes);
+		InterpolateBatch(batch, numLanes);
+		ScatterBatch(batch, batchSize, out.data() + base);
+	}
+}
+
+void AnimationSampler::SampleRange(const CompressedAnimations& animations, float t, Span<AffineTransformation> out,
+	size_t beg, size_t n) noexcept
+{
+	using TRACK = CompressedAnimations::TRACK;
+	const uint16_t* allTimes = animations.m_times.begin();
+	const float* allRawTimes = animations.m_rawTimes.begin();
+	const uint8_t* allValues = animations.m_values.begin();
+	Batch batch;
+
+	for (size_t base = beg; base < beg + n; base += Batch::SIZE)
+	{
+		const int batchSize = (int)Math::Min<size_t>(Batch::SIZE, beg + n - base);
+		const int numLanes = (int)Math::AlignUp(batchSize, VFloat::Width);
+
+		// every track has its own keyframes and cursor
+		for (int lane = 0; lane < batchSize; lane++)
+		{
+			const CompressedAnimations::Animation& anim = animations.m_animations[base + lane];
+			const float u = (t - anim.BegTimeOffset - anim.BegTime) * anim.TimeScale;
+			int* cursors = m_cursors.data() + (base + lane) * TRACK::COUNT;
+
+			for (int i = 0; i < TRACK::COUNT; i++)
+			{
+				const CompressedAnimations::Track& track = anim.Tracks[i];
+				const uint8_t* values = allValues + track.ValueOffset;
+
+				const KeyframePair p = FindKeyframePair(track.NumKeys, cursors[i], u, allTimes + track.TimeOffset,
+					anim.RawTimes ? allRawTimes + track.TimeOffset : nullptr);
+				batch.T[i][lane] = p.T;
+
+				// the same keyframe is only decoded once -- before the start, after the end and for 
+				// constant tracks
+				if (i == TRACK::ROTATION)
+				{
+					const float4 q1 = DecodeRotation(values, track.NumBits, p.K1);
+					GatherFloat4(q1, batch.K1 + ROTATION_COMPONENT, lane);
+					GatherFloat4(p.K1 == p.K2 ? q1 : DecodeRotation(values, track.NumBits, p.K2),
+						batch.K2 + ROTATION_COMPONENT, lane);
+				}
+				else
+				{
+					const int c = i == TRACK::SCALE ? SCALE_COMPONENT : TRANSLATION_COMPONENT;
+					const float3 v1 = DecodeFloat3(values, track.NumBits, p.K1);
+					GatherFloat3(v1, batch.K1 + c, lane);
+					GatherFloat3(p.K1 == p.K2 ? v1 : DecodeFloat3(values, track.NumBits, p.K2),
+						batch.K2 + c, lane);
+				}
+			}
+		}
+
+		PadBatch(batch, batchSize, numLanes);
+		InterpolateBatch(batch, numLanes);
+		ScatterBatch(batch, batchSize, out.data() + base);
+	}
+}
+
+void AnimationSampler::Reset() noexcept
+{
+	m_cursors.clear();
+}
+
+void AnimationSampler::Clear() noexcept
+{
+	m_cursors.free_memory();
+}
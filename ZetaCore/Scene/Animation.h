@@ -0,0 +1,222 @@
+#pragma once
+
+#include "../Math/Matrix.h"
+#include "../Utility/SmallVector.h"
+#include "../Utility/Span.h"
+#include "../Support/Executor.h"
+
+namespace ZetaRay::Scene
+{
+	struct Keyframe
+	{
+		Math::AffineTransformation Transform;
+		float Time;
+	};
+
+	// Keyframes of every animation are stored contiguously (sorted by time) in [BegOffset, EndOffset)
+	struct AnimationOffset
+	{
+		AnimationOffset() = default;
+		AnimationOffset(int b, int e, float t) noexcept
+			: BegOffset(b),
+			EndOffset(e),
+			BegTimeOffset(t)
+		{}
+
+		int BegOffset;
+		int EndOffset;
+		float BegTimeOffset;
+	};
+
+	//--------------------------------------------------------------------------------------
+	// CompressedAnimations
+	//--------------------------------------------------------------------------------------
+
+	struct AnimationCompressionParams
+	{
+		// maximum difference per component
+		float ScaleTolerance = 1e-4f;
+		// maximum angle between the original and the reconstructed rotation (radians)
+		float RotationTolerance = 5e-4f;
+		// maximum difference per component
+		float TranslationTolerance = 1e-4f;
+		// lossless -- values and times are kept as floats and only keyframes that interpolation 
+		// reproduces exactly are removed
+		bool Raw = false;
+	};
+
+	// Compact storage for a set of keyframe animations. Every animation is split into scale, rotation
+	// and translation tracks, which are compressed independently:
+	//  - Every track is stored in the smallest format whose quantization error is at most half of its
+	//    tolerance -- 8 or 16 bits per component relative to the range of the track for scale and 
+	//    translation, "smallest three" (largest component is dropped, the other three are quantized to
+	//    15 bits each) for rotation, or otherwise 32-bit floats.
+	//  - Keyframes that can be reconstructed (within what's left of the tolerance after quantization)
+	//    by interpolating the keyframes around them are removed, so every track ends up with its own 
+	//    set of keyframes. Tracks that don't change are reduced to a single keyframe.
+	//  - Times are stored as 16-bit steps, either of the frame rate the animation was sampled at or of
+	//    1 / 65535 of its duration. Animations that fit neither (e.g. long clips with irregular spacing)
+	//    keep float times.
+	// With the default tolerances, a keyframe usually takes 5 to 8 bytes per track (vs. 44 bytes for
+	// a Keyframe, which holds all three).
+	class CompressedAnimations
+	{
+	public:
+		CompressedAnimations() noexcept = default;
+		~CompressedAnimations() noexcept = default;
+
+		CompressedAnimations(const CompressedAnimations&) = delete;
+		CompressedAnimations& operator=(const CompressedAnimations&) = delete;
+
+		// Compresses the given keyframes (sorted by time) and appends them as a new animation. A single 
+		// keyframe results in a constant animation.
+		void Add(Util::Span<Keyframe> keyframes, float tOffset, const AnimationCompressionParams& params = AnimationCompressionParams()) noexcept;
+		// Removes the animations for which isRemoved is true. Relative order of the rest is preserved.
+		void Remove(Util::Span<bool> isRemoved) noexcept;
+
+		// Decodes one animation at time t. AnimationSampler should be preferred when sampling many animations.
+		Math::AffineTransformation Sample(size_t animIdx, float t) const noexcept;
+
+		ZetaInline size_t size() const { return m_animations.size(); }
+		ZetaInline size_t NumKeyframes() const { return m_times.size() + m_rawTimes.size(); }
+		// Total memory used for the compressed data
+		size_t SizeInBytes() const noexcept;
+		void Clear() noexcept;
+
+	private:
+		friend class AnimationSampler;
+
+		enum TRACK
+		{
+			SCALE,
+			ROTATION,
+			TRANSLATION,
+			COUNT
+		};
+
+		struct Track
+		{
+			// offset into m_times or m_rawTimes (see Animation::RawTimes)
+			uint32_t TimeOffset;
+			// offset into m_values in bytes
+			uint32_t ValueOffset;
+			uint32_t NumKeys;
+			// per component -- 8 or 16 for quantized values (always 16 for rotations), 32 for floats
+			uint8_t NumBits;
+		};
+
+		struct Animation
+		{
+			Track Tracks[TRACK::COUNT];
+			float BegTime;
+			float BegTimeOffset;
+			// converts time since the start of the animation to the units of the stored times
+			float TimeScale;
+			bool RawTimes;
+		};
+
+		Util::SmallVector<Animation> m_animations;
+		Util::SmallVector<uint16_t> m_times;
+		Util::SmallVector<float> m_rawTimes;
+		Util::SmallVector<uint8_t> m_values;
+	};
+
+	//--------------------------------------------------------------------------------------
+	// AnimationSampler
+	//--------------------------------------------------------------------------------------
+
+	// Samples a set of keyframe animations at a given time. For every animation, index of the keyframe
+	// that was used in the last call is cached. As long as time moves forward, the next pair of keyframes
+	// is at or right after the cached one, so steady playback is O(1) per animation rather than a binary
+	// search; a binary search is only needed after time jumps (e.g. when it goes back).
+	//
+	// Animations are processed in groups of simd<float, 8>::Width. After the keyframes of every animation
+	// in the group are found, scale and translation are interpolated with lerp and rotation with slerp
+	// for the whole group at once (structure-of-arrays). Animations are independent of each other, so
+	// they can also be split into jobs that run in parallel.
+	class AnimationSampler
+	{
+	public:
+		static constexpr int MAX_NUM_JOBS = 16;
+		// animations are only split between jobs when each one gets at least this many
+		static constexpr int MIN_ANIMATIONS_PER_JOB = 2048;
+
+		AnimationSampler() noexcept = default;
+		~AnimationSampler() noexcept = default;
+
+		AnimationSampler(const AnimationSampler&) = delete;
+		AnimationSampler& operator=(const AnimationSampler&) = delete;
+
+		// Writes the transformation of animations[i] at time t to out[i]. New animations must be appended
+		// to the end; after animations are removed or reordered, Reset() should be called.
+		void Sample(Util::Span<Keyframe> keyframes, Util::Span<AnimationOffset> animations, float t,
+			Util::Span<Math::AffineTransformation> out) noexcept
+		{
+			Sample(keyframes, animations, t, out, Support::SerialExecutor());
+		}
+
+		// Same as above, but animations are split into jobs that run on the given executor (see 
+		// Support/Executor.h)
+		template<typename Executor>
+		void Sample(Util::Span<Keyframe> keyframes, Util::Span<AnimationOffset> animations, float t,
+			Util::Span<Math::AffineTransformation> out, Executor&& executor) noexcept
+		{
+			Assert(out.size() >= animations.size(), "output is too small.");
+			const int numJobs = Prepare(animations.size(), animations.size(), executor.MaxNumJobs());
+
+			if (numJobs == 1)
+				SampleRange(keyframes, animations, t, out, 0, animations.size());
+			else if (numJobs > 1)
+			{
+				executor.For(numJobs, [this, keyframes, animations, t, out](int jobIdx)
+					{
+						SampleRange(keyframes, animations, t, out, m_jobOffsets[jobIdx], m_jobSizes[jobIdx]);
+					});
+			}
+		}
+
+		// Same as above for compressed animations. Every track is decoded separately, but interpolation is
+		// shared with the uncompressed path.
+		void Sample(const CompressedAnimations& animations, float t, Util::Span<Math::AffineTransformation> out) noexcept
+		{
+			Sample(animations, t, out, Support::SerialExecutor());
+		}
+
+		template<typename Executor>
+		void Sample(const CompressedAnimations& animations, float t, Util::Span<Math::AffineTransformation> out,
+			Executor&& executor) noexcept
+		{
+			Assert(out.size() >= animations.size(), "output is too small.");
+			const int numJobs = Prepare(animations.size() * CompressedAnimations::TRACK::COUNT, 
+				animations.size(), executor.MaxNumJobs());
+
+			if (numJobs == 1)
+				SampleRange(animations, t, out, 0, animations.size());
+			else if (numJobs > 1)
+			{
+				executor.For(numJobs, [this, &animations, t, out](int jobIdx)
+					{
+						SampleRange(animations, t, out, m_jobOffsets[jobIdx], m_jobSizes[jobIdx]);
+					});
+			}
+		}
+
+		// Forgets the cached keyframes
+		void Reset() noexcept;
+		void Clear() noexcept;
+
+	private:
+		// Returns the number of jobs
+		int Prepare(size_t numCursors, size_t numAnimations, int maxNumJobs) noexcept;
+		void SampleRange(Util::Span<Keyframe> keyframes, Util::Span<AnimationOffset> animations, float t,
+			Util::Span<Math::AffineTransformation> out, size_t beg, size_t n) noexcept;
+		void SampleRange(const CompressedAnimations& animations, float t, Util::Span<Math::AffineTransformation> out, 
+			size_t beg, size_t n) noexcept;
+
+		// for every animation (or every track of compressed animations), index (relative to the first
+		// keyframe) of the keyframe that came right before (or at) the time of the last sample
+		Util::SmallVector<int> m_cursors;
+		size_t m_jobOffsets[MAX_NUM_JOBS];
+		size_t m_jobSizes[MAX_NUM_JOBS];
+	};
+}
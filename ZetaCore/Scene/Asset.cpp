@@ -8,6 +8,7 @@
 #include "SceneRenderer.h"
 #include "SceneCore.h"
 #include "../Model/glTFAsset.h"
+#include <algorithm>
 
 using namespace ZetaRay::Core;
 using namespace ZetaRay::Scene::Internal;
@@ -88,7 +89,7 @@ void TexSRVDescriptorTable::Recycle(uint64_t completedFenceVal) noexcept
 			// set the descriptor slot to free
 			const uint32_t idx = it->DescTableOffset >> 6;
 			Assert(idx < m_numMasks, "invalid index.");
-			m_inUseBitset[idx] |= (1llu << (it->DescTableOffset & 63));
+			m_inUseBitset[idx] &= ~(1llu << (it->DescTableOffset & 63));
 
 			it = m_pending.erase(*it);
 		}
@@ -109,27 +110,28 @@ void TexSRVDescriptorTable::Clear() noexcept
 	m_descTable.Reset();
 }
 
-//void TexSRVDescriptorTable::Remove(uint64_t id, uint64_t nextFenceVal) noexcept
-//{
-//	auto it = Cache.find(id);
-//	Check(it != nullptr, "Invalid texture ID %llu", id);
-//	Check(it->TableOffset < NUM_DESCRIPTORS, "Descriptor table offset %u was out-of-bounds.", NUM_DESCRIPTORS);
-//	it->RefCount--;
-//
-//	TODO remove the corresponding bit from the bitmask
-// 
-//	// no more references to this texture
-//	if (it->RefCount == 0)
-//	{
-//		auto numErased = Cache.erase(id);
-//		Assert(numErased == 1, "Number of removed elements must be exactly one.");
-//
-//		Pending.emplace_back(ToBeFreedTexture{
-//			.T = ZetaMove(it->second.T), 
-//			.FenceVal = nextFenceVal, 
-//			.TableOffset = it->second.TableOffset});
-//	}
-//}
+bool TexSRVDescriptorTable::Remove(uint64_t id, uint64_t nextFenceVal) noexcept
+{
+	auto it = m_cache.find(id);
+	Assert(it != nullptr, "texture with ID %llu was not found.", id);
+	Assert(it->DescTableOffset < m_descTableSize, "invalid offset.");
+	Assert(it->RefCount > 0, "invalid ref count.");
+
+	if (--it->RefCount > 0)
+		return false;
+
+	// no more references to this texture. Its descriptor slot is freed in Recycle() after the GPU 
+	// is done with it
+	m_pending.emplace_back(ToBeFreedTexture{
+		.T = ZetaMove(it->T),
+		.FenceVal = nextFenceVal,
+		.DescTableOffset = it->DescTableOffset });
+
+	const size_t numErased = m_cache.erase(id);
+	Assert(numErased == 1, "Number of removed elements must be exactly one.");
+
+	return true;
+}
 
 //--------------------------------------------------------------------------------------
 // MaterialBuffer
@@ -161,8 +163,41 @@ void MaterialBuffer::Add(uint64_t id, Material& mat) noexcept
 	// set offset in input material
 	mat.SetGpuBufferIndex(freeIdx);
 	m_matTable.insert_or_assign(id, mat);
+	m_refCounts[id]++;
+
+	m_stale = true;
+}
+
+void MaterialBuffer::AddRef(uint64_t id) noexcept
+{
+	m_refCounts[id]++;
+}
+
+bool MaterialBuffer::Release(uint64_t id, uint64_t nextFenceVal, Material& mat) noexcept
+{
+	uint32_t* refCount = m_refCounts.find(id);
+	Assert(refCount && *refCount > 0, "material with ID %llu doesn't have any references.", id);
+
+	if (--(*refCount) > 0)
+		return false;
+
+	m_refCounts.erase(id);
+
+	Material* m = m_matTable.find(id);
+	Assert(m, "material with id %llu was not found", id);
+
+	if (!m)
+		return false;
+
+	mat = *m;
+
+	// slot is freed in Recycle() after the GPU is done with it
+	m_pending.emplace_back(ToBeRemoved{ .FenceVal = nextFenceVal, .Offset = (uint16_t)mat.GpuBufferIndex() });
+	m_matTable.erase(id);
 
 	m_stale = true;
+
+	return true;
 }
 
 void MaterialBuffer::UpdateGPUBufferIfStale() noexcept
@@ -172,10 +207,16 @@ void MaterialBuffer::UpdateGPUBufferIfStale() noexcept
 
 	Assert(!m_matTable.empty(), "Stale flag is set, yet there aren't any materials.");
 
+	// slots of removed materials leave gaps behind
+	uint32_t bufferSize = 0;
+
+	for (auto it = m_matTable.begin_it(); it != m_matTable.end_it(); it = m_matTable.next_it(it))
+		bufferSize = Math::Max(bufferSize, it->Val.GpuBufferIndex() + 1);
+
 	auto it = m_matTable.begin_it();
 
 	SmallVector<Material, FrameAllocator> buffer;
-	buffer.resize(m_matTable.size());
+	buffer.resize(bufferSize);
 
 	while (it != m_matTable.end_it())
 	{
@@ -209,7 +250,7 @@ void MaterialBuffer::Recycle(uint64_t completedFenceVal) noexcept
 			// set the slot to free
 			const int idx = it->Offset >> 6;
 			Assert(idx < NUM_MASKS, "Invalid index.");
-			m_inUseBitset[idx] |= (1llu << (it->Offset & 63));
+			m_inUseBitset[idx] &= ~(1llu << (it->Offset & 63));
 
 			it = m_pending.erase(*it);
 		}
@@ -226,95 +267,457 @@ void MaterialBuffer::Clear() noexcept
 	// Assumes CPU-GPU synchronization has been performed, so that GPU is done with the material buffer.
 	// UploadHeapBuffer's destructor takes care of the rest
 	m_buffer.Reset();
+	m_pending.free_memory();
+	m_refCounts.free();
 }
 
-//void MaterialBuffer::Remove(uint64_t id, uint64_t nextFenceVal) noexcept
-//{
-//	auto it = Materials.find(id);
-//	Assert(it != nullptr, "Attempting to remove material %s that doesn't exist.", id);
-//
-//	Pending.emplace_back(ToBeRemoved{ .FenceVal = nextFenceVal, .Offset = (uint16_t)it->GpuBufferIndex()});
-//	Materials.erase(it);
-//}
-
 //--------------------------------------------------------------------------------------
 // MeshContainer
 //--------------------------------------------------------------------------------------
 
+namespace
+{
+	size_t GeometrySizeInBytes(const TriangleMesh& geometry) noexcept
+	{
+		return geometry.m_numVertices * sizeof(Vertex) +
+			(geometry.m_numIndices + geometry.m_numLODIndices) * sizeof(uint32_t) +
+			geometry.m_numLODs * sizeof(Model::MeshLOD);
+	}
+
+	// Part of the vertex or index buffer that some geometry occupies
+	struct BufferRange
+	{
+		size_t* Offset;
+		size_t Count;
+	};
+
+	// Packs the given ranges in the order of their current offsets and updates the offsets accordingly. 
+	// Uploaded ranges come first -- they're moved on the GPU (adjacent ones with one copy) -- followed 
+	// by the pending ones, which are repacked on the CPU.
+	template<typename T>
+	void PackRanges(SmallVector<BufferRange>& ranges, size_t& numUploaded, SmallVector<T>& pending,
+		SmallVector<MeshContainer::BufferMove>& moves) noexcept
+	{
+		std::sort(ranges.begin(), ranges.end(), [](const BufferRange& lhs, const BufferRange& rhs)
+			{
+				return *lhs.Offset < *rhs.Offset;
+			});
+
+		SmallVector<T> packed;
+		const size_t firstMove = moves.size();
+		size_t numPacked = 0;
+		size_t numPackedUploaded = 0;
+
+		for (auto& range : ranges)
+		{
+			const size_t offset = *range.Offset;
+
+			if (offset < numUploaded)
+			{
+				Assert(offset + range.Count <= numUploaded, "geometry is partially uploaded.");
+
+				if (moves.size() > firstMove && moves.back().SrcOffset + moves.back().Count == offset)
+					moves.back().Count += range.Count;
+				else
+				{
+					moves.push_back(MeshContainer::BufferMove{ .SrcOffset = offset,
+						.DstOffset = numPacked,
+						.Count = range.Count });
+				}
+
+				numPackedUploaded += range.Count;
+			}
+			else
+			{
+				const T* src = pending.begin() + (offset - numUploaded);
+				packed.append_range(src, src + range.Count);
+			}
+
+			*range.Offset = numPacked;
+			numPacked += range.Count;
+		}
+
+		pending.swap(packed);
+		numUploaded = numPackedUploaded;
+	}
+}
+
 void MeshContainer::Add(uint64_t id, Span<Vertex> vertices, Span<uint32_t> indices, uint64_t matID) noexcept
 {
-	const size_t vtxOffset = m_vertices.size();
-	const size_t idxOffset = m_indices.size();
+	uint64_t geometryID = GeometryHash(vertices, indices);
+	const uint64_t contentHash = GeometryHash(vertices, indices, CONTENT_HASH_SEED);
 
-	m_meshes.emplace(id, vertices, vtxOffset, idxOffset, (uint32_t)indices.size(), matID);
+	if (FindGeometry(geometryID, contentHash, vertices.size(), indices.size()))
+	{
+		TriangleMesh mesh = *m_geometries.find(geometryID);
+		mesh.m_materialID = matID;
+		mesh.m_geometryID = geometryID;
+
+		m_meshes.insert_or_assign(id, mesh);
+		m_refCounts.insert_or_assign(id, 1);
+		(*m_geometryRefCounts.find(geometryID))++;
+
+		return;
+	}
 
-	m_vertices.append_range(vertices.begin(), vertices.end());
-	m_indices.append_range(indices.begin(), indices.end());
+	const size_t vtxOffset = m_numUploadedVertices + m_pendingVertices.size();
+	const size_t idxOffset = m_numUploadedIndices + m_pendingIndices.size();
+
+	TriangleMesh mesh(vertices, vtxOffset, idxOffset, (uint32_t)indices.size(), matID);
+
+	m_pendingVertices.append_range(vertices.begin(), vertices.end());
+	m_pendingIndices.append_range(indices.begin(), indices.end());
+
+	mesh.m_geometryID = geometryID;
+
+	m_geometries.insert_or_assign(geometryID, mesh);
+	m_geometryRefCounts.insert_or_assign(geometryID, 1);
+	m_contentHashes.insert_or_assign(geometryID, contentHash);
+	m_meshes.insert_or_assign(id, mesh);
+	m_refCounts.insert_or_assign(id, 1);
+
+	m_stale = true;
 }
 
-void MeshContainer::AddBatch(uint64_t sceneID, SmallVector<Model::glTF::Asset::MeshSubset>&& meshes, 
-	SmallVector<Core::Vertex>&& vertices, SmallVector<uint32_t>&& indices) noexcept
+MeshContainer::SharedGeometryStats MeshContainer::AddBatch(uint64_t sceneID, SmallVector<Model::glTF::Asset::MeshSubset>&& meshes, 
+	SmallVector<Core::Vertex>&& vertices, SmallVector<uint32_t>&& indices, SmallVector<Model::MeshLOD>&& lods,
+	SmallVector<uint32_t>&& lodIndices) noexcept
 {
-	const size_t vtxOffset = m_vertices.size();
-	const size_t idxOffset = m_indices.size();
+	// first batch (e.g. the initial load) is taken as is, later ones (e.g. chunks of a streamed scene) 
+	// only append their new geometry, so that RebuildBuffers() uploads just that
+	const bool takeBatch = m_numUploadedVertices == 0 && m_numUploadedIndices == 0 && 
+		m_pendingVertices.empty() && m_pendingIndices.empty() && m_lods.empty();
+	// LOD indices of the whole batch go after its indices
+	const size_t lodIdxOffset = indices.size();
+	const size_t numBatchVertices = vertices.size();
+	const size_t numBatchIndices = indices.size() + lodIndices.size();
+	const size_t numBatchLODs = lods.size();
+
+	if (takeBatch)
+	{
+		m_pendingVertices = ZetaMove(vertices);
+		m_pendingIndices = ZetaMove(indices);
+		m_pendingIndices.append_range(lodIndices.begin(), lodIndices.end());
+		m_lods = ZetaMove(lods);
+	}
+
+	Span<Vertex> batchVertices = takeBatch ? Span(m_pendingVertices) : Span(vertices);
+	Span<uint32_t> batchIndices = takeBatch ? Span(m_pendingIndices) : Span(indices);
+
+	SharedGeometryStats stats;
+	// parts of the batch that the newly added geometry refers to
+	size_t numUsedVertices = 0;
+	size_t numUsedIndices = 0;
+	size_t numUsedLODs = 0;
 
 	for (auto& mesh : meshes)
 	{
 		const uint64_t meshFromSceneID = SceneCore::MeshID(sceneID, mesh.MeshIdx, mesh.MeshPrimIdx);
 		const uint64_t matFromSceneID = mesh.MaterialIdx != -1 ? SceneCore::MaterialID(sceneID, mesh.MaterialIdx) : SceneCore::DEFAULT_MATERIAL;
+		const Span<Vertex> meshVertices(batchVertices.begin() + mesh.BaseVtxOffset, mesh.NumVertices);
+		const Span<uint32_t> meshIndices(batchIndices.begin() + mesh.BaseIdxOffset, mesh.NumIndices);
+		const uint64_t contentHash = GeometryHash(meshVertices, meshIndices, CONTENT_HASH_SEED);
+
+		TriangleMesh m(meshVertices, mesh.BaseVtxOffset, mesh.BaseIdxOffset, mesh.NumIndices, matFromSceneID);
+		m.m_lodIdxBuffStartOffset = lodIdxOffset + mesh.BaseLODIdxOffset;
+		m.m_numLODIndices = mesh.NumLODIndices;
+		m.m_lodBuffStartOffset = mesh.BaseLODOffset;
+		m.m_numLODs = mesh.NumLODs;
+		m.m_geometryID = mesh.GeometryID;
+
+		if (FindGeometry(m.m_geometryID, contentHash, mesh.NumVertices, mesh.NumIndices))
+		{
+			stats.NumMeshes++;
+			stats.NumBytes += GeometrySizeInBytes(m);
+
+			// refer to the existing copy instead
+			m = *m_geometries.find(m.m_geometryID);
+			m.m_materialID = matFromSceneID;
+			(*m_geometryRefCounts.find(m.m_geometryID))++;
+		}
+		else
+		{
+			if (!takeBatch)
+			{
+				const uint32_t* meshLODIndices = lodIndices.begin() + mesh.BaseLODIdxOffset;
+				const Model::MeshLOD* meshLODs = lods.begin() + mesh.BaseLODOffset;
+
+				m.m_vtxBuffStartOffset = m_numUploadedVertices + m_pendingVertices.size();
+				m_pendingVertices.append_range(meshVertices.begin(), meshVertices.end());
 
-		m_meshes.emplace(meshFromSceneID, Span(vertices.begin() + mesh.BaseVtxOffset, mesh.NumVertices), 
-			vtxOffset + mesh.BaseVtxOffset,
-			idxOffset + mesh.BaseIdxOffset,
-			mesh.NumIndices, 
-			matFromSceneID);
+				m.m_idxBuffStartOffset = m_numUploadedIndices + m_pendingIndices.size();
+				m_pendingIndices.append_range(meshIndices.begin(), meshIndices.end());
+
+				m.m_lodIdxBuffStartOffset = m_numUploadedIndices + m_pendingIndices.size();
+				m_pendingIndices.append_range(meshLODIndices, meshLODIndices + mesh.NumLODIndices);
+
+				m.m_lodBuffStartOffset = (uint32_t)m_lods.size();
+				m_lods.append_range(meshLODs, meshLODs + mesh.NumLODs);
+			}
+
+			m_geometries.insert_or_assign(m.m_geometryID, m);
+			m_geometryRefCounts.insert_or_assign(m.m_geometryID, 1);
+			m_contentHashes.insert_or_assign(m.m_geometryID, contentHash);
+
+			numUsedVertices += m.m_numVertices;
+			numUsedIndices += m.m_numIndices + m.m_numLODIndices;
+			numUsedLODs += m.m_numLODs;
+		}
+
+		m_meshes.insert_or_assign(meshFromSceneID, m);
+		m_refCounts.insert_or_assign(meshFromSceneID, 1);
 	}
 
-	if (m_vertices.empty())
-		m_vertices = ZetaMove(vertices);
-	else
-		m_vertices.append_range(vertices.begin(), vertices.end());
+	// rest of the first batch -- whatever duplicate meshes were decoded to before they were pointed 
+	// to their owner at import time -- is left in place until compaction
+	if (takeBatch)
+	{
+		m_numRemovedVertices += numBatchVertices - numUsedVertices;
+		m_numRemovedIndices += numBatchIndices - numUsedIndices;
+		m_numRemovedLODs += numBatchLODs - numUsedLODs;
+	}
 
-	if (m_indices.empty())
-		m_indices = ZetaMove(indices);
-	else
-		m_indices.append_range(indices.begin(), indices.end());
+	m_stale = true;
+
+	return stats;
+}
+
+bool MeshContainer::FindGeometry(uint64_t& id, uint64_t contentHash, size_t numVertices, size_t numIndices) noexcept
+{
+	while (true)
+	{
+		const TriangleMesh* geometry = m_geometries.find(id);
+		if (!geometry)
+			return false;
+
+		if (geometry->m_numVertices == numVertices && geometry->m_numIndices == numIndices &&
+			*m_contentHashes.find(id) == contentHash)
+		{
+			return true;
+		}
+
+		// different content with the same hash, try the next key
+		id++;
+	}
+}
+
+void MeshContainer::MarkRemoved(const TriangleMesh& geometry) noexcept
+{
+	// vertices and indices are left in place until the next rebuild
+	m_numRemovedVertices += geometry.m_numVertices;
+	m_numRemovedIndices += geometry.m_numIndices + geometry.m_numLODIndices;
+	m_numRemovedLODs += geometry.m_numLODs;
 }
 
 void MeshContainer::Reserve(size_t numVertices, size_t numIndices) noexcept
 {
-	m_vertices.reserve(numVertices);
-	m_indices.reserve(numIndices);
+	m_pendingVertices.reserve(numVertices);
+	m_pendingIndices.reserve(numIndices);
+}
+
+void MeshContainer::AddRef(uint64_t id) noexcept
+{
+	uint32_t* refCount = m_refCounts.find(id);
+	Assert(refCount, "mesh with id %llu was not found", id);
+	(*refCount)++;
+}
+
+bool MeshContainer::Release(uint64_t id, TriangleMesh& mesh) noexcept
+{
+	uint32_t* refCount = m_refCounts.find(id);
+	Assert(refCount && *refCount > 0, "mesh with ID %llu doesn't have any references.", id);
+
+	if (!refCount || --(*refCount) > 0)
+		return false;
+
+	m_refCounts.erase(id);
+
+	TriangleMesh* m = m_meshes.find(id);
+	Assert(m, "Mesh with id %llu was not found", id);
+	mesh = *m;
+	m_meshes.erase(id);
+
+	// geometry is removed along with the last mesh that refers to it
+	uint32_t* geometryRefCount = m_geometryRefCounts.find(mesh.m_geometryID);
+	Assert(geometryRefCount && *geometryRefCount > 0, "geometry with ID %llu doesn't have any references.", mesh.m_geometryID);
+
+	if (--(*geometryRefCount) == 0)
+	{
+		m_geometryRefCounts.erase(mesh.m_geometryID);
+		m_geometries.erase(mesh.m_geometryID);
+		m_contentHashes.erase(mesh.m_geometryID);
+		MarkRemoved(mesh);
+
+		m_stale = true;
+	}
+
+	return true;
+}
+
+size_t MeshContainer::GetCpuMemoryUsage() const noexcept
+{
+	return m_pendingVertices.capacity() * sizeof(Vertex) +
+		m_pendingIndices.capacity() * sizeof(uint32_t) +
+		m_lods.capacity() * sizeof(Model::MeshLOD);
+}
+
+void MeshContainer::Compact(SmallVector<BufferMove>& vertexMoves, SmallVector<BufferMove>& indexMoves) noexcept
+{
+	// Indices are relative to the first vertex of their mesh (and LOD offsets to the first LOD index 
+	// of their mesh), so only the mesh offsets need to be updated
+	if (m_numRemovedVertices == 0 && m_numRemovedIndices == 0 && m_numRemovedLODs == 0)
+		return;
+
+	SmallVector<BufferRange> vertexRanges;
+	SmallVector<BufferRange> indexRanges;
+	SmallVector<Model::MeshLOD> lods;
+	vertexRanges.reserve(m_geometries.size());
+	indexRanges.reserve(m_geometries.size() * 2);
+	lods.reserve(m_lods.size() - m_numRemovedLODs);
+
+	// geometry table doesn't change until the offsets are updated
+	for (auto it = m_geometries.begin_it(); it != m_geometries.end_it(); it = m_geometries.next_it(it))
+	{
+		TriangleMesh& mesh = it->Val;
+
+		vertexRanges.push_back(BufferRange{ .Offset = &mesh.m_vtxBuffStartOffset, .Count = mesh.m_numVertices });
+		indexRanges.push_back(BufferRange{ .Offset = &mesh.m_idxBuffStartOffset, .Count = mesh.m_numIndices });
+
+		if (mesh.m_numLODIndices)
+			indexRanges.push_back(BufferRange{ .Offset = &mesh.m_lodIdxBuffStartOffset, .Count = mesh.m_numLODIndices });
+
+		const size_t lodOffset = lods.size();
+
+		lods.append_range(m_lods.begin() + mesh.m_lodBuffStartOffset,
+			m_lods.begin() + mesh.m_lodBuffStartOffset + mesh.m_numLODs);
+
+		mesh.m_lodBuffStartOffset = (uint32_t)lodOffset;
+	}
+
+	PackRanges(vertexRanges, m_numUploadedVertices, m_pendingVertices, vertexMoves);
+	PackRanges(indexRanges, m_numUploadedIndices, m_pendingIndices, indexMoves);
+
+	// meshes take the new offsets of their geometry
+	for (auto it = m_meshes.begin_it(); it != m_meshes.end_it(); it = m_meshes.next_it(it))
+	{
+		TriangleMesh& mesh = it->Val;
+		const TriangleMesh* geometry = m_geometries.find(mesh.m_geometryID);
+		Assert(geometry, "geometry with ID %llu was not found.", mesh.m_geometryID);
+
+		mesh.m_vtxBuffStartOffset = geometry->m_vtxBuffStartOffset;
+		mesh.m_idxBuffStartOffset = geometry->m_idxBuffStartOffset;
+		mesh.m_lodIdxBuffStartOffset = geometry->m_lodIdxBuffStartOffset;
+		mesh.m_lodBuffStartOffset = geometry->m_lodBuffStartOffset;
+	}
+
+	m_lods.swap(lods);
+	m_numRemovedVertices = 0;
+	m_numRemovedIndices = 0;
+	m_numRemovedLODs = 0;
+	m_stale = true;
+}
+
+void MeshContainer::MarkUploaded() noexcept
+{
+	m_numUploadedVertices += m_pendingVertices.size();
+	m_numUploadedIndices += m_pendingIndices.size();
+
+	m_pendingVertices.free_memory();
+	m_pendingIndices.free_memory();
 }
 
 void MeshContainer::RebuildBuffers() noexcept
 {
-	Assert(m_vertices.size() > 0, "vertex buffer is empty");
-	Assert(m_indices.size() > 0, "index buffer is empty");
+	const size_t numVertices = m_numUploadedVertices + m_pendingVertices.size();
+	const size_t numIndices = m_numUploadedIndices + m_pendingIndices.size();
+
+	// compaction recreates both buffers, so removed geometry is left in place until there's enough of it
+	const bool compact = (m_numRemovedVertices && m_numRemovedVertices * COMPACTION_RATIO >= numVertices) ||
+		(m_numRemovedIndices && m_numRemovedIndices * COMPACTION_RATIO >= numIndices);
+
+	SmallVector<BufferMove> vertexMoves;
+	SmallVector<BufferMove> indexMoves;
+
+	if (compact)
+		Compact(vertexMoves, indexMoves);
 
-	const size_t vbSizeInBytes = sizeof(Vertex) * m_vertices.size();
-	m_vertexBuffer = App::GetRenderer().GetGpuMemory().GetDefaultHeapBufferAndInit(GlobalResource::SCENE_VERTEX_BUFFER, vbSizeInBytes,
-		D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER, false, m_vertices.data());
+	m_stale = false;
+
+	// every mesh was removed
+	if (m_numUploadedVertices + m_pendingVertices.size() == 0)
+	{
+		m_vertexBuffer.Reset();
+		m_indexBuffer.Reset();
+		MarkUploaded();
+
+		return;
+	}
 
-	const size_t ibSizeInBytes = sizeof(uint32_t) * m_indices.size();
-	m_indexBuffer = App::GetRenderer().GetGpuMemory().GetDefaultHeapBufferAndInit(GlobalResource::SCENE_INDEX_BUFFER, ibSizeInBytes,
-		D3D12_RESOURCE_STATE_INDEX_BUFFER, false, m_indices.data());
+	Assert(m_numUploadedIndices + m_pendingIndices.size() > 0, "index buffer is empty");
 
+	auto& gpuMem = App::GetRenderer().GetGpuMemory();
 	auto& r = App::GetRenderer().GetSharedShaderResources();
-	r.InsertOrAssignDefaultHeapBuffer(GlobalResource::SCENE_VERTEX_BUFFER, m_vertexBuffer);
-	r.InsertOrAssignDefaultHeapBuffer(GlobalResource::SCENE_INDEX_BUFFER, m_indexBuffer);
 
-	m_vertices.free_memory();
-	m_indices.free_memory();
+	// Elements before numUploaded might be in use by the GPU, so rather than being overwritten, they're
+	// copied to a new buffer when the current one is full or after compaction. Pending elements are 
+	// then appended.
+	auto upload = [&gpuMem, &r, compact](DefaultHeapBuffer& buffer, const char* name, Span<BufferMove> moves,
+		size_t stride, size_t numUploaded, uint8_t* pending, size_t numPending)
+		{
+			const size_t size = numUploaded + numPending;
+
+			if (compact || !buffer.IsInitialized() || buffer.GetDesc().Width < size * stride)
+			{
+				// leave some room for the geometry that's added next
+				const size_t capacity = size + (size >> 1);
+				DefaultHeapBuffer newBuffer = gpuMem.GetDefaultHeapBuffer(name, capacity * stride, 
+					D3D12_RESOURCE_STATE_COMMON, false);
+
+				if (compact)
+				{
+					for (auto& move : moves)
+					{
+						gpuMem.CopyDefaultHeapBuffer(newBuffer, move.DstOffset * stride, buffer, move.SrcOffset * stride,
+							move.Count * stride);
+					}
+				}
+				else if (numUploaded)
+					gpuMem.CopyDefaultHeapBuffer(newBuffer, 0, buffer, 0, numUploaded * stride);
+
+				// previous buffer is released after the GPU is done with it
+				buffer = ZetaMove(newBuffer);
+				r.InsertOrAssignDefaultHeapBuffer(name, buffer);
+			}
+
+			if (numPending)
+				gpuMem.UploadToDefaultHeapBuffer(buffer, numPending * stride, pending, numUploaded * stride);
+		};
+
+	upload(m_vertexBuffer, GlobalResource::SCENE_VERTEX_BUFFER, vertexMoves, sizeof(Vertex), m_numUploadedVertices,
+		reinterpret_cast<uint8_t*>(m_pendingVertices.data()), m_pendingVertices.size());
+	upload(m_indexBuffer, GlobalResource::SCENE_INDEX_BUFFER, indexMoves, sizeof(uint32_t), m_numUploadedIndices,
+		reinterpret_cast<uint8_t*>(m_pendingIndices.data()), m_pendingIndices.size());
+
+	// pending data was copied to the upload heap
+	MarkUploaded();
 }
 
 void MeshContainer::Clear() noexcept
 {
 	m_meshes.clear();
+	m_refCounts.free();
+	m_geometries.clear();
+	m_geometryRefCounts.free();
+	m_contentHashes.free();
 	m_vertexBuffer.Reset();
 	m_indexBuffer.Reset();
 
-	m_vertices.free_memory();
-	m_indices.free_memory();
+	m_pendingVertices.free_memory();
+	m_pendingIndices.free_memory();
+	m_lods.free_memory();
+	m_numRemovedVertices = 0;
+	m_numRemovedIndices = 0;
+	m_numRemovedLODs = 0;
+	m_numUploadedVertices = 0;
+	m_numUploadedIndices = 0;
 }
-
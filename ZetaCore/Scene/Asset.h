@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Model/Mesh.h"
+#include "../Model/MeshSimplifier.h"
 #include "../Core/Material.h"
 #include "../Utility/HashTable.h"
 #include "../Core/DescriptorHeap.h"
@@ -33,7 +34,10 @@ namespace ZetaRay::Scene::Internal
 		// Returns offset of the given texture in the desc. table. The texture is then loaded from
 		// the disk. "id" is hash of the texture path
 		uint32_t Add(Core::Texture&& tex, uint64_t id) noexcept;
-		//void Remove(uint64_t id, uint64_t nextFenceVal) noexcept;
+		// Releases one reference to the given texture. Once there aren't any references left, texture is 
+		// released and its descriptor slot is freed after the GPU is done with it (see Recycle()). Returns
+		// whether the texture was released.
+		bool Remove(uint64_t id, uint64_t nextFenceVal) noexcept;
 
 		void Clear() noexcept;
 		void Recycle(uint64_t completedFenceVal) noexcept;
@@ -81,10 +85,18 @@ namespace ZetaRay::Scene::Internal
 
 		void Init(uint64_t id) noexcept;
 
-		// Allocates an entry for the given material. Index to the allocated entry is also set
+		// Allocates an entry for the given material. Index to the allocated entry is also set. Caller
+		// owns one reference to the material.
 		void Add(uint64_t id, Material& mat) noexcept;
 		void UpdateGPUBufferIfStale() noexcept;
-		//void Remove(uint64_t id, uint64_t nextFenceVal) noexcept;
+
+		// Meshes hold a reference to their material. Materials and meshes are loaded concurrently, so a 
+		// reference can be added before the material itself.
+		void AddRef(uint64_t id) noexcept;
+		// Releases one reference to the given material. Once there aren't any references left, material
+		// is removed (returned in mat) and its slot is freed after the GPU is done with it (see Recycle()).
+		// Returns whether the material was removed.
+		bool Release(uint64_t id, uint64_t nextFenceVal, Material& mat) noexcept;
 
 		// returns a copy since references to elements are not stable
 		ZetaInline Material Get(uint64_t id) noexcept
@@ -119,6 +131,7 @@ namespace ZetaRay::Scene::Internal
 			
 		// references to elements are not stable
 		Util::HashTable<Material> m_matTable;
+		Util::HashTable<uint32_t> m_refCounts;
 
 		uint64_t k_bufferID = uint64_t (-1);
 		bool m_stale = false;
@@ -128,13 +141,62 @@ namespace ZetaRay::Scene::Internal
 	// MeshContainer
 	//--------------------------------------------------------------------------------------
 
+	// Meshes are deduplicated by their content -- meshes (from any scene) with identical vertices and
+	// indices share one copy of them, along with the LODs that were built from them, and
+	// only differ in their material. Shared geometry is reference counted separately by the meshes that
+	// refer to it. Vertices and indices only stay in system memory until they're uploaded.
 	struct MeshContainer
 	{
+		// Range of elements (vertices or indices) that compaction moves to the new GPU buffer
+		struct BufferMove
+		{
+			size_t SrcOffset;
+			size_t DstOffset;
+			size_t Count;
+		};
+
+		// Geometry of newly added meshes that was already present
+		struct SharedGeometryStats
+		{
+			uint32_t NumMeshes = 0;
+			// size of the vertices, indices and LODs that aren't duplicated
+			size_t NumBytes = 0;
+		};
+
+		// Caller owns one reference to every added mesh. Meshes that are added this way don't have LODs.
 		void Add(uint64_t id, Util::Span<Core::Vertex> vertices, Util::Span<uint32_t> indices, uint64_t matID) noexcept;
-		void AddBatch(uint64_t sceneID, Util::SmallVector<Model::glTF::Asset::MeshSubset>&& meshes, Util::SmallVector<Core::Vertex>&& vertices,
-			Util::SmallVector<uint32_t>&& indices) noexcept;
+		// LODs (if any) are expected to be built at import time. Geometry that's already present is 
+		// shared (see MeshSubset::GeometryID). Only the new geometry is copied over, except for the first
+		// batch, which is taken as a whole -- parts of it that none of its meshes refer to (e.g. when 
+		// meshes with identical geometry were pointed to one copy of it) are left for Compact().
+		SharedGeometryStats AddBatch(uint64_t sceneID, Util::SmallVector<Model::glTF::Asset::MeshSubset>&& meshes, Util::SmallVector<Core::Vertex>&& vertices,
+			Util::SmallVector<uint32_t>&& indices, Util::SmallVector<Model::MeshLOD>&& lods, Util::SmallVector<uint32_t>&& lodIndices) noexcept;
 		void Reserve(size_t numVertices, size_t numIndices) noexcept;
+
+		// Instances hold a reference to their mesh
+		void AddRef(uint64_t id) noexcept;
+		// Releases one reference to the given mesh. Once there aren't any references left, mesh is removed
+		// (returned in mesh). Its vertices and indices are compacted away later (see RebuildBuffers()), unless
+		// other meshes still share them. Returns whether the mesh was removed.
+		bool Release(uint64_t id, Model::TriangleMesh& mesh) noexcept;
+		// Whether any of the meshes still refer to the given geometry (see TriangleMesh::m_geometryID)
+		ZetaInline bool HasGeometry(uint64_t geometryID) noexcept { return m_geometries.find(geometryID) != nullptr; }
+
+		// GPU buffers are out of date after meshes are added or removed
+		ZetaInline bool IsStale() const { return m_stale; }
+		// Uploads the vertices and indices that were added since the last call. GPU buffers are recreated 
+		// (with some room to spare) when they don't fit or after compaction -- geometry that's already
+		// in them is copied over on the GPU. Removed geometry is compacted away once it takes up at least 
+		// 1 / COMPACTION_RATIO of either buffer. Previous buffers are released after the GPU is done with 
+		// them (see GpuMemory).
 		void RebuildBuffers() noexcept;
+		// Closes the gaps left behind by removed geometry, which changes the offsets of the rest. Geometry
+		// that's already uploaded has to be moved to the new GPU buffers as given by vertexMoves and 
+		// indexMoves (in the order of their source offsets), while the pending geometry is repacked to 
+		// follow it.
+		void Compact(Util::SmallVector<BufferMove>& vertexMoves, Util::SmallVector<BufferMove>& indexMoves) noexcept;
+		// Pending vertices and indices (see below) were copied to the GPU buffers and can be released
+		void MarkUploaded() noexcept;
 		
 		ZetaInline Model::TriangleMesh GetMesh(uint64_t id) noexcept
 		{
@@ -144,15 +206,63 @@ namespace ZetaRay::Scene::Internal
 			return *mesh;
 		}
 
+		// Vertices and indices that were added since the last upload. They go right after the uploaded ones
+		// (e.g. the first pending vertex is at offset GetNumUploadedVertices()).
+		ZetaInline Util::Span<Core::Vertex> GetPendingVertices() noexcept { return m_pendingVertices; }
+		ZetaInline Util::Span<uint32_t> GetPendingIndices() noexcept { return m_pendingIndices; }
+		ZetaInline size_t GetNumUploadedVertices() const { return m_numUploadedVertices; }
+		ZetaInline size_t GetNumUploadedIndices() const { return m_numUploadedIndices; }
+
+		// LODs of the mesh, from finest to coarsest (not counting the full-resolution mesh). Index offsets
+		// are relative to the mesh's m_lodIdxBuffStartOffset.
+		ZetaInline Util::Span<Model::MeshLOD> GetLODs(uint64_t id) noexcept
+		{
+			auto* mesh = m_meshes.find(id);
+			Assert(mesh, "Mesh with id %llu was not found", id);
+
+			return Util::Span(m_lods.data() + mesh->m_lodBuffStartOffset, mesh->m_numLODs);
+		}
+
+		// Size of the pending geometry and the LODs in bytes
+		size_t GetCpuMemoryUsage() const noexcept;
+
 		const Core::DefaultHeapBuffer& GetVB() { return m_vertexBuffer; }
 		const Core::DefaultHeapBuffer& GetIB() { return m_indexBuffer; }
 
 		void Clear() noexcept;
 
 	private:
+		static constexpr int COMPACTION_RATIO = 4;
+		static constexpr uint64_t CONTENT_HASH_SEED = 0x9e3779b97f4a7c15;
+
+		// Returns whether geometry with the same content is present. Otherwise, id is set to the key
+		// that the new geometry should be added with (in case of hash collisions). Uploaded geometry
+		// isn't around to be compared with, so geometry is told apart by its size and a second, 
+		// independent hash of its content (see m_contentHashes).
+		bool FindGeometry(uint64_t& id, uint64_t contentHash, size_t numVertices, size_t numIndices) noexcept;
+		// Vertices, indices and LODs of the given geometry are dropped by the next rebuild
+		void MarkRemoved(const Model::TriangleMesh& geometry) noexcept;
+
 		Util::HashTable<Model::TriangleMesh> m_meshes;
-		Util::SmallVector<Core::Vertex> m_vertices;
-		Util::SmallVector<uint32_t> m_indices;
+		Util::HashTable<uint32_t> m_refCounts;
+		// unique geometry, keyed by content hash. Materials of these entries aren't used.
+		Util::HashTable<Model::TriangleMesh> m_geometries;
+		// number of meshes that refer to each geometry
+		Util::HashTable<uint32_t> m_geometryRefCounts;
+		// GeometryHash() of each geometry with CONTENT_HASH_SEED
+		Util::HashTable<uint64_t> m_contentHashes;
+		// Vertices and indices that aren't in the GPU buffers yet. They're released once uploaded, so only
+		// the LODs (which are small) are kept around.
+		Util::SmallVector<Core::Vertex> m_pendingVertices;
+		Util::SmallVector<uint32_t> m_pendingIndices;
+		Util::SmallVector<Model::MeshLOD> m_lods;
+		size_t m_numRemovedVertices = 0;
+		size_t m_numRemovedIndices = 0;
+		size_t m_numRemovedLODs = 0;
+		// number of vertices and indices that are in the GPU buffers
+		size_t m_numUploadedVertices = 0;
+		size_t m_numUploadedIndices = 0;
+		bool m_stale = false;
 
 		Core::DefaultHeapBuffer m_vertexBuffer;
 		Core::DefaultHeapBuffer m_indexBuffer;
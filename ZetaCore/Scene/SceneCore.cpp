@@ -4,7 +4,10 @@
 #include "../Math/Color.h"
 #include "../RayTracing/RtCommon.h"
 #include "../Support/Task.h"
+#include "../Support/Param.h"
 #include "../Core/RendererCore.h"
+#include "../App/Timer.h"
+#include "../App/Log.h"
 #include "Camera.h"
 #include <algorithm>
 
@@ -56,10 +59,10 @@ SceneCore::SceneCore() noexcept
 	m_metalnessRoughnessDescTable(METALNESS_ROUGHNESS_DESC_TABLE_SIZE),
 	m_emissiveDescTable(EMISSIVE_DESC_TABLE_SIZE),
 	m_sceneGraph(m_memoryPool, m_memoryPool),
-	m_prevToWorlds(m_memoryPool),
-	m_animOffsetToInstanceMap(m_memoryPool),
-	m_animationOffsets(m_memoryPool),
-	m_keyframes(m_memoryPool)
+	m_movedNodes(m_memoryPool),
+	m_pendingBVHInserts(m_memoryPool),
+	m_removedDynamicInstances(m_memoryPool),
+	m_animatedInstances(m_memoryPool)
 {
 }
 
@@ -85,6 +88,8 @@ void SceneCore::Init(Renderer::Interface& rendererInterface) noexcept
 
 	v_float4x4 I = identity();
 	m_sceneGraph[0].m_toWorlds[0] = float4x3(store(I));
+	m_sceneGraph[0].m_prevToWorlds.resize(1);
+	m_sceneGraph[0].m_prevToWorlds[0] = m_sceneGraph[0].m_toWorlds[0];
 
 	m_matBuffer.Init(XXH3_64bits(GlobalResource::MATERIAL_BUFFER, strlen(GlobalResource::MATERIAL_BUFFER)));
 	m_baseColorDescTable.Init(XXH3_64bits(GlobalResource::BASE_COLOR_DESCRIPTOR_TABLE,
@@ -96,6 +101,18 @@ void SceneCore::Init(Renderer::Interface& rendererInterface) noexcept
 
 	CheckHR(App::GetRenderer().GetDevice()->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(m_fence.GetAddressOf())));
 
+	m_occlusionBuffer.Init(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+
+	ParamVariant occlusionCulling;
+	occlusionCulling.InitBool("Scene", "Occlusion Culling", "Enable", fastdelegate::MakeDelegate(this, &SceneCore::SetOcclusionCullingEnabled),
+		m_occlusionCullingEnabled);
+	App::AddParam(occlusionCulling);
+
+	ParamVariant streamingBudget;
+	streamingBudget.InitFloat("Scene", "Streaming", "Budget (ms)", fastdelegate::MakeDelegate(this, &SceneCore::SetStreamingBudget),
+		m_streamingBudgetMs, 0.1f, 16.0f, 0.1f);
+	App::AddParam(streamingBudget);
+
 	m_rendererInterface.Init();
 
 	// allocate a slot for the default material
@@ -111,14 +128,43 @@ void SceneCore::OnWindowSizeChanged() noexcept
 
 void SceneCore::Update(double dt, TaskSet& sceneTS, TaskSet& sceneRendererTS) noexcept
 {
-	if (m_isPaused)
+	// updates continue while paused as long as a scene is being streamed in, otherwise its chunks 
+	// wouldn't be integrated. Only animations are stopped.
+	const bool streaming = IsStreaming();
+
+	if (m_isPaused && !streaming)
 		return;
 
-	TaskSet::TaskHandle h0 = sceneTS.EmplaceTask("Scene::Update", [this, dt]()
+	// while paused, animated transformations are left as they were
+	const bool animate = !m_isPaused;
+
+	// animations are sampled at the total time of the frames that weren't paused
+	if (animate)
+		m_animationTime += dt;
+
+	const double animationTime = m_animationTime;
+
+	// chunks are added before anything else so that they're handled like the rest of the scene
+	IntegrateStreamedChunks();
+
+	TaskSet::TaskHandle h0 = sceneTS.EmplaceTask("Scene::Update", [this, animate, animationTime]()
 		{
-			SmallVector<AnimationUpdateOut, App::FrameAllocator> animUpdates;
-			UpdateAnimations((float)dt, animUpdates);
-			UpdateLocalTransforms(animUpdates);
+			// tree positions change after compaction, so this has to happen before anything else
+			if (m_compactSceneGraph)
+				CompactSceneGraph();
+
+			if (animate)
+			{
+				SmallVector<AffineTransformation, App::FrameAllocator> animUpdates;
+				animUpdates.resize(m_animations.size());
+				UpdateAnimations((float)animationTime, animUpdates);
+				UpdateLocalTransforms(animUpdates);
+			}
+
+			// insert the newly added instances before the update pass so that their (possibly 
+			// animated) transformations are handled like every other instance's
+			if (!m_rebuildBVHFlag)
+				InsertPendingInstancesToBVH();
 
 			SmallVector<BVH::BVHUpdateInput, App::FrameAllocator> toUpdateInstances;
 			UpdateWorldTransformations(toUpdateInstances);
@@ -128,24 +174,50 @@ void SceneCore::Update(double dt, TaskSet& sceneTS, TaskSet& sceneRendererTS) no
 				RebuildBVH();
 				m_rebuildBVHFlag = false;
 			}
-			else
+			else if (!toUpdateInstances.empty())
+			{
 				m_bvh.Update(toUpdateInstances);
+				m_spatialHash.Update(toUpdateInstances);
+				m_bvhSAHCostStale = true;
+			}
 
 			//m_frameInstances.clear();
 			m_frameInstances.free_memory();
-			m_frameInstances.reserve(m_IDtoTreePos.size());
+			m_frameInstances.reserve(m_IDtoHandle.size());
 
 			const Camera& camera = App::GetCamera();
 			m_bvh.DoFrustumCulling(camera.GetCameraFrustumViewSpace(), camera.GetViewInv(), m_frameInstances);
 
-			App::AddFrameStat("Scene", "FrustumCulled", (uint32_t)(m_IDtoTreePos.size() - m_frameInstances.size()), (uint32_t)m_IDtoTreePos.size());
+			App::AddFrameStat("Scene", "FrustumCulled", (uint32_t)(m_IDtoHandle.size() - m_frameInstances.size()), (uint32_t)m_IDtoHandle.size());
+
+			if (m_occlusionCullingEnabled)
+				DoOcclusionCulling();
+
+			if (m_bvhSAHCostStale && App::GetTimer().GetTotalFrameCount() % SAH_COST_UPDATE_INTERVAL == 0)
+			{
+				m_bvhSAHCost = m_bvh.IsBuilt() ? m_bvh.ComputeSAHCost() : 0.0f;
+				m_bvhSAHCostStale = false;
+			}
+
+			// SAH cost relative to a full rebuild
+			if (m_bvhBuildSAHCost > 0.0f)
+				App::AddFrameStat("Scene", "BVH SAH drift", m_bvhSAHCost / m_bvhBuildSAHCost);
+
+			AcquireSRWLockShared(&m_meshLock);
+			const size_t meshCpuMemory = m_meshes.GetCpuMemoryUsage();
+			ReleaseSRWLockShared(&m_meshLock);
+
+			App::AddFrameStat("Scene", "Mesh CPU memory (MB)", (float)meshCpuMemory / (1024.0f * 1024.0f));
 		});
 
-	if (m_staleStaticInstances)
+	if (m_meshes.IsStale())
 	{
 		sceneTS.EmplaceTask("Scene::RebuildMeshBuffers", [this]()
 			{
+				// runs concurrently with "Scene::Update", which reads the mesh buffers' memory usage
+				AcquireSRWLockExclusive(&m_meshLock);
 				m_meshes.RebuildBuffers();
+				ReleaseSRWLockExclusive(&m_meshLock);
 			});
 	}
 	
@@ -196,26 +268,72 @@ void SceneCore::Shutdown() noexcept
 	m_emissiveDescTable.Clear();
 	m_meshes.Clear();
 	m_bvh.Clear();
+	m_spatialHash.Clear();
+	m_pendingBVHInserts.free_memory();
+	m_meshBVHs.free();
+	m_occlusionBuffer.Clear();
 
 	m_baseColTableOffsetToID.free();
 	m_normalTableOffsetToID.free();
 	m_metalnessRougnessrTableOffsetToID.free();
 	m_emissiveTableOffsetToID.free();
 
-	m_prevToWorlds.free_memory();
-	//m_sceneMetadata.free();
+	m_movedNodes.free_memory();
+	m_worldTransformUpdater.Clear();
+	m_animSampler.Clear();
+	m_animations.Clear();
+	m_animationTime = 0.0;
+	m_animatedInstances.free_memory();
+	m_sceneMetadata.free();
 	m_sceneGraph.free_memory();
-	m_IDtoTreePos.free();
+	m_IDtoHandle.free();
+	m_nodeHandles.Clear();
+	m_removedDynamicInstances.free_memory();
+	m_instanceVisibilityIdx.free();
+	m_freeVisibilityIndices.free_memory();
 
 	m_rendererInterface.Shutdown();
 }
 
 void SceneCore::ReserveScene(uint64_t sceneID, size_t numMeshes, size_t numMats, size_t numNodes) noexcept
 {
-	//auto& it = m_sceneMetadata[sceneID];
-	//it.MaterialIDs.reserve(numMats);
-	//it.Meshes.reserve(numMeshes);
-	//it.Instances.reserve(numNodes);
+	AcquireSRWLockExclusive(&m_sceneMetadataLock);
+
+	auto& it = m_sceneMetadata[sceneID];
+	it.MaterialIDs.reserve(numMats);
+	it.Meshes.reserve(numMeshes);
+	it.Instances.reserve(numNodes);
+
+	ReleaseSRWLockExclusive(&m_sceneMetadataLock);
+}
+
+void SceneCore::UnloadScene(uint64_t sceneID) noexcept
+{
+	AcquireSRWLockExclusive(&m_sceneMetadataLock);
+
+	SceneMetadata* metadata = m_sceneMetadata.find(sceneID);
+	Assert(metadata, "scene with ID %llu was not found.", sceneID);
+
+	if (!metadata)
+	{
+		ReleaseSRWLockExclusive(&m_sceneMetadataLock);
+		return;
+	}
+
+	SceneMetadata s = ZetaMove(*metadata);
+	m_sceneMetadata.erase(sceneID);
+
+	ReleaseSRWLockExclusive(&m_sceneMetadataLock);
+
+	// instances release their meshes, which in turn release their materials. Instances that were 
+	// already removed are skipped.
+	RemoveInstances(s.Instances);
+
+	for (uint64_t meshID : s.Meshes)
+		RemoveMesh(meshID);
+
+	for (uint64_t matID : s.MaterialIDs)
+		RemoveMaterial(matID);
 }
 
 void SceneCore::ReserveMeshData(size_t numVertices, size_t numIndices) noexcept
@@ -224,13 +342,75 @@ void SceneCore::ReserveMeshData(size_t numVertices, size_t numIndices) noexcept
 }
 
 void SceneCore::AddMeshes(uint64_t sceneID, SmallVector<Model::glTF::Asset::MeshSubset>&& meshes,
-	SmallVector<Core::Vertex>&& vertices, SmallVector<uint32_t>&& indices) noexcept
+	SmallVector<Core::Vertex>&& vertices, SmallVector<uint32_t>&& indices, 
+	SmallVector<Model::MeshLOD>&& lods, SmallVector<uint32_t>&& lodIndices,
+	SmallVector<Math::MeshBVH>&& meshBVHs) noexcept
+{
+	Assert(meshBVHs.empty() || meshBVHs.size() == meshes.size(), "Number of mesh BVHs doesn't match the number of meshes.");
+
+	SmallVector<uint64_t> meshIDs;
+	meshIDs.resize(meshes.size());
+
+	for (size_t i = 0; i < meshes.size(); i++)
+		meshIDs[i] = MeshID(sceneID, meshes[i].MeshIdx, meshes[i].MeshPrimIdx);
+
+	AcquireSRWLockExclusive(&m_meshLock);
+
+	// every mesh holds a reference to its material
+	AcquireSRWLockExclusive(&m_matLock);
+
+	for (auto& mesh : meshes)
+		m_matBuffer.AddRef(mesh.MaterialIdx != -1 ? MaterialID(sceneID, mesh.MaterialIdx) : DEFAULT_MATERIAL);
+
+	ReleaseSRWLockExclusive(&m_matLock);
+
+	const MeshContainer::SharedGeometryStats stats = m_meshes.AddBatch(sceneID, ZetaMove(meshes), ZetaMove(vertices),
+		ZetaMove(indices), ZetaMove(lods), ZetaMove(lodIndices));
+
+	// mesh BVHs are shared along with the geometry. Duplicates within the batch don't have one.
+	for (size_t i = 0; i < meshBVHs.size(); i++)
+	{
+		const uint64_t geometryID = m_meshes.GetMesh(meshIDs[i]).m_geometryID;
+
+		if (meshBVHs[i].IsBuilt() && !m_meshBVHs.find(geometryID))
+			m_meshBVHs.emplace(geometryID, ZetaMove(meshBVHs[i]));
+	}
+
+	ReleaseSRWLockExclusive(&m_meshLock);
+
+	if (stats.NumMeshes)
+	{
+		LOG_UI_INFO("%u of %llu mesh(es) shared geometry that was already present, saved %llu[KB]\n", stats.NumMeshes,
+			meshIDs.size(), stats.NumBytes / 1024);
+	}
+
+	// remember which glTF scene these meshes came from
+	AcquireSRWLockExclusive(&m_sceneMetadataLock);
+	m_sceneMetadata[sceneID].Meshes.append_range(meshIDs.begin(), meshIDs.end());
+	ReleaseSRWLockExclusive(&m_sceneMetadataLock);
+}
+
+void SceneCore::RemoveMesh(uint64_t id) noexcept
 {
 	AcquireSRWLockExclusive(&m_meshLock);
-	m_meshes.AddBatch(sceneID, ZetaMove(meshes), ZetaMove(vertices), ZetaMove(indices));
+	ReleaseMesh(id);
 	ReleaseSRWLockExclusive(&m_meshLock);
 }
 
+void SceneCore::ReleaseMesh(uint64_t id) noexcept
+{
+	TriangleMesh mesh;
+	if (!m_meshes.Release(id, mesh))
+		return;
+
+	if (!m_meshes.HasGeometry(mesh.m_geometryID))
+		m_meshBVHs.erase(mesh.m_geometryID);
+
+	AcquireSRWLockExclusive(&m_matLock);
+	ReleaseMaterial(mesh.m_materialID);
+	ReleaseSRWLockExclusive(&m_matLock);
+}
+
 void SceneCore::AddMaterial(uint64_t sceneID, const glTF::Asset::MaterialDesc& matDesc, Span<glTF::Asset::DDSImage> ddsImages) noexcept
 {
 	Assert(matDesc.Index >= 0, "invalid material index.");
@@ -304,120 +484,250 @@ void SceneCore::AddMaterial(uint64_t sceneID, const glTF::Asset::MaterialDesc& m
 	// add it to GPU material buffer, which offsets into descriptor tables above
 	m_matBuffer.Add(matFromSceneID, mat);
 
+	ReleaseSRWLockExclusive(&m_matLock);
+
 	// remember from which glTF scene this material came from
-	//m_sceneMetadata[sceneID].MaterialIDs.push_back(matFromSceneID);
+	AcquireSRWLockExclusive(&m_sceneMetadataLock);
+	m_sceneMetadata[sceneID].MaterialIDs.push_back(matFromSceneID);
+	ReleaseSRWLockExclusive(&m_sceneMetadataLock);
+}
+
+void SceneCore::RemoveMaterial(uint64_t id) noexcept
+{
+	Assert(id != DEFAULT_MATERIAL, "Default material can't be removed.");
 
+	AcquireSRWLockExclusive(&m_matLock);
+	ReleaseMaterial(id);
 	ReleaseSRWLockExclusive(&m_matLock);
 }
 
+void SceneCore::ReleaseMaterial(uint64_t id) noexcept
+{
+	Material mat;
+	if (!m_matBuffer.Release(id, m_nextFenceVal, mat))
+		return;
+
+	// material holds a reference to each of its textures
+	auto releaseTex = [this](uint32_t tableOffset, TexSRVDescriptorTable& table, HashTable<uint64_t>& offsetToID)
+		{
+			if (tableOffset == uint32_t(-1))
+				return;
+
+			const uint64_t* texID = offsetToID.find(tableOffset);
+			Assert(texID, "texture at descriptor table offset %u was not found.", tableOffset);
+
+			if (table.Remove(*texID, m_nextFenceVal))
+				offsetToID.erase(tableOffset);
+		};
+
+	releaseTex(mat.BaseColorTexture, m_baseColorDescTable, m_baseColTableOffsetToID);
+	releaseTex(mat.NormalTexture, m_normalDescTable, m_normalTableOffsetToID);
+	releaseTex(mat.MetalnessRoughnessTexture, m_metalnessRoughnessDescTable, m_metalnessRougnessrTableOffsetToID);
+
+	const uint16_t emissiveTex = mat.GetEmissiveTex();
+	releaseTex(emissiveTex == uint16_t(-1) ? uint32_t(-1) : emissiveTex, m_emissiveDescTable, m_emissiveTableOffsetToID);
+}
+
 void SceneCore::AddInstance(uint64_t sceneID, glTF::Asset::InstanceDesc&& instance) noexcept
 {
-	const uint64_t meshID = instance.MeshIdx == -1 ? NULL_MESH : MeshID(sceneID, instance.MeshIdx, instance.MeshPrimIdx);
-	//const uint64_t instanceID = InstanceID(sceneID, instance.Name, instance.MeshIdx, instance.MeshPrimIdx);
+	AddInstances(sceneID, Span(&instance, 1));
+}
+
+void SceneCore::AddInstances(uint64_t sceneID, Span<glTF::Asset::InstanceDesc> instances) noexcept
+{
+	SmallVector<NewNode> newNodes;
+	newNodes.reserve(instances.size());
 
 	AcquireSRWLockExclusive(&m_instanceLock);
+	AcquireSRWLockExclusive(&m_meshLock);
 
-	if (instance.RtMeshMode == RT_MESH_MODE::STATIC && meshID != NULL_MESH)
+	for (auto& instance : instances)
 	{
-		m_numStaticInstances++;
-		m_staleStaticInstances = true;
+		const uint64_t meshID = instance.MeshIdx == -1 ? NULL_MESH : MeshID(sceneID, instance.MeshIdx, instance.MeshPrimIdx);
+
+		if (instance.RtMeshMode == RT_MESH_MODE::STATIC && meshID != NULL_MESH)
+		{
+			m_numStaticInstances++;
+
+			// static BLAS is rebuilt from scratch, so for streamed scenes, it's rebuilt once after all
+			// of their instances have been added rather than after every chunk
+			if (m_integratingStreamedChunks)
+				m_heldStaticInstances = true;
+			else
+				m_staleStaticInstances = true;
+		}
+		else
+			m_numDynamicInstances++;
+
+		// every instance holds a reference to its mesh
+		if (meshID != NULL_MESH)
+			m_meshes.AddRef(meshID);
+
+		// set rebuild flag to true for any instance that is added for the first time
+		newNodes.push_back(NewNode{ 
+			.LocalTransform = instance.LocalTransform,
+			.ID = instance.ID,
+			.ParentID = instance.ParentID,
+			.MeshID = meshID,
+			.RtFlags = SetRtFlags(instance.RtMeshMode, instance.RtInstanceMask, 1, 0) });
 	}
+
+	ReleaseSRWLockExclusive(&m_meshLock);
+
+	// parent's world transformation is up-to-date (it's either been updated in the last frame or 
+	// computed there when it was added), so world transformations of new instances are computed
+	// right away
+	InsertNodes(m_sceneGraph, m_memoryPool, newNodes, ROOT_ID, m_IDtoHandle, m_nodeHandles);
+
+	// full rebuild is only needed for the initial (bulk) load, afterwards instances are inserted
+	// incrementally
+	if (!m_bvh.IsBuilt())
+		m_rebuildBVHFlag = true;
 	else
-		m_numDynamicInstances++;
-	
-	int treeLevel = 1;
-	int parentIdx = 0;
-	
-	// get parent's index from the hashmap
-	if (instance.ParentID != ROOT_ID)
 	{
-		TreePos* p = FindTreePosFromID(instance.ParentID);
-		Assert(p, "instance with ID %llu was not found in the scene graph.", instance.ParentID);
+		for (auto& node : newNodes)
+		{
+			if (node.MeshID != NULL_MESH)
+				m_pendingBVHInserts.push_back(node.ID);
+		}
+	}
+
+	ReleaseSRWLockExclusive(&m_instanceLock);
+
+	// remember which glTF scene these instances came from
+	AcquireSRWLockExclusive(&m_sceneMetadataLock);
+
+	auto& metadata = m_sceneMetadata[sceneID];
+	for (auto& node : newNodes)
+		metadata.Instances.push_back(node.ID);
+
+	ReleaseSRWLockExclusive(&m_sceneMetadataLock);
+}
+
+void SceneCore::RemoveInstance(uint64_t id) noexcept
+{
+	RemoveInstances(Span(&id, 1));
+}
 
-		treeLevel = p->Level + 1;
-		parentIdx = p->Offset;
+void SceneCore::RemoveInstances(Span<uint64_t> ids) noexcept
+{
+	SmallVector<NodeHandle> handles;
+	handles.reserve(ids.size());
+
+	AcquireSRWLockExclusive(&m_instanceLock);
+
+	// instances that were already removed (possibly along with one of their ancestors) are skipped
+	for (uint64_t id : ids)
+	{
+		if (NodeHandle* h = m_IDtoHandle.find(id); h)
+			handles.push_back(*h);
 	}
-	
-	const int insertIdx = InsertAtLevel(instance.ID, treeLevel, parentIdx, instance.LocalTransform, meshID,
-		instance.RtMeshMode, instance.RtInstanceMask);
 
-	// update instance "dictionary"
+	// nodes are only marked as removed here, so their data remains accessible until the next update
+	SmallVector<TreePos> removed;
+	RemoveNodes(m_sceneGraph, handles, m_nodeHandles, removed);
+
+	AcquireSRWLockExclusive(&m_meshLock);
+
+	for (TreePos p : removed)
 	{
-		Assert(m_IDtoTreePos.find(instance.ID) == nullptr, "instance with id %llu already existed.", instance.ID);
-		//m_IDtoTreePos.emplace(instanceID, TreePos{ .Level = treeLevel, .Offset = insertIdx });
-		m_IDtoTreePos.insert_or_assign(instance.ID, TreePos{ .Level = treeLevel, .Offset = insertIdx });
+		const TreeLevel& level = m_sceneGraph[p.Level];
+		const uint64_t insID = level.m_IDs[p.Offset];
+		const uint64_t meshID = level.m_meshIDs[p.Offset];
+		const RT_Flags flags = GetRtFlags(level.m_rtFlags[p.Offset]);
+
+		m_IDtoHandle.erase(insID);
 
-		// adjust tree positions of shifted instances
-		for(int i = insertIdx + 1; i < m_sceneGraph[treeLevel].m_IDs.size(); i++)
+		if (flags.MeshMode == RT_MESH_MODE::STATIC && meshID != NULL_MESH)
+		{
+			m_numStaticInstances--;
+			m_staleStaticInstances = true;
+		}
+		else
 		{
-			uint64_t insID = m_sceneGraph[treeLevel].m_IDs[i];
-			TreePos* p = m_IDtoTreePos.find(insID);
-			Assert(p, "instance with ID %llu was not found in the scene graph.", insID);
+			m_numDynamicInstances--;
 
-			// shift the tree poistion to right
-			p->Offset++;
+			if (meshID != NULL_MESH)
+				m_removedDynamicInstances.push_back(insID);
 		}
+
+		if (meshID == NULL_MESH)
+			continue;
+
+		// only the instances that have been inserted into the BVH have a visibility index
+		if (uint32_t* visIdx = m_instanceVisibilityIdx.find(insID); visIdx)
+		{
+			m_freeVisibilityIndices.push_back(*visIdx);
+			m_instanceVisibilityIdx.erase(insID);
+
+			v_AABB vBox(m_meshes.GetMesh(meshID).m_AABB);
+			vBox = transform(load(level.m_toWorlds[p.Offset]), vBox);
+			m_bvh.Remove(insID, store(vBox));
+			m_spatialHash.Remove(insID);
+		}
+
+		ReleaseMesh(meshID);
 	}
 
-	/*
-	// cache the meshe IDs that are emissive
-	if (instance.RtInstanceMask & RT_AS_SUBGROUP::EMISSIVE)
+	ReleaseSRWLockExclusive(&m_meshLock);
+
+	// the rest haven't been inserted into the BVH yet
+	if (!removed.empty() && !m_pendingBVHInserts.empty())
 	{
-		Assert(!instance.Lumen.empty(), "Emissive instances require precomputed per-triangle power");
-		m_sceneRenderer.AddEmissiveInstance(instanceID, ZetaMove(instance.Lumen));
+		size_t numRemaining = 0;
+
+		for (uint64_t insID : m_pendingBVHInserts)
+		{
+			if (m_IDtoHandle.find(insID))
+				m_pendingBVHInserts[numRemaining++] = insID;
+		}
+
+		m_pendingBVHInserts.resize(numRemaining);
 	}
-	*/
 
-	m_rebuildBVHFlag = true;
+	m_bvhSAHCostStale = m_bvhSAHCostStale || !removed.empty();
+
+	m_compactSceneGraph = m_compactSceneGraph || !removed.empty();
 
 	ReleaseSRWLockExclusive(&m_instanceLock);
 }
 
-int SceneCore::InsertAtLevel(uint64_t id, int treeLevel, int parentIdx, AffineTransformation& localTransform,
-	uint64_t meshID, RT_MESH_MODE rtMeshMode, uint8_t rtInstanceMask) noexcept
+void SceneCore::CompactSceneGraph() noexcept
 {
-	while(treeLevel >= m_sceneGraph.size())
-		m_sceneGraph.emplace_back(m_memoryPool);
-
-	auto& parentLevel = m_sceneGraph[treeLevel - 1];
-	auto& currLevel = m_sceneGraph[treeLevel];
-	auto& parentRange = parentLevel.m_subtreeRanges[parentIdx];
-
-	// insert position is right next to parent's rightmost child
-	const int insertIdx = parentRange.Base + parentRange.Count;
+	AcquireSRWLockExclusive(&m_instanceLock);
 
-	// increment parent's children count
-	parentRange.Count++;
+	CompactNodes(m_sceneGraph, m_nodeHandles);
+	m_compactSceneGraph = false;
 
-	// append it to the end, then keep swapping it back until it's at insertIdx
-	auto rearrange = []<typename T, typename... Args> requires std::is_swappable<T>::value
-		(Vector<T, Support::PoolAllocator>& vec, int insertIdx, Args&&... args) noexcept
-		{
-			vec.emplace_back(T(ZetaForward(args)...));
+	// drop the animations of removed instances along with their keyframes. Remaining animations keep
+	// their relative order, so i'th animation still belongs to i'th instance in "m_animatedInstances".
+	SmallVector<bool, App::FrameAllocator> isRemoved;
+	isRemoved.resize(m_animatedInstances.size());
+	int numRemaining = 0;
 
-			for (int i = (int)vec.size() - 1; i != insertIdx; --i)
-				std::swap(vec[i], vec[i - 1]);
-		};
+	for (int i = 0; i < (int)m_animatedInstances.size(); i++)
+	{
+		const NodeHandle h = m_animatedInstances[i];
+		isRemoved[i] = m_nodeHandles.Find(h) == nullptr;
 
-	float4x3 I = float4x3(store(identity()));
+		if (!isRemoved[i])
+			m_animatedInstances[numRemaining++] = h;
+	}
 
-	rearrange(currLevel.m_IDs, insertIdx, id);
-	rearrange(currLevel.m_localTransforms, insertIdx, localTransform);
-	rearrange(currLevel.m_toWorlds, insertIdx, I);
-	rearrange(currLevel.m_meshIDs, insertIdx, meshID);
-	const int newBase = currLevel.m_subtreeRanges.empty() ? 0 : currLevel.m_subtreeRanges.back().Base + currLevel.m_subtreeRanges.back().Count;
-	rearrange(currLevel.m_subtreeRanges, insertIdx, newBase, 0);
-	// set rebuild flag to true for any instance that is added for the first time
-	rearrange(currLevel.m_rtFlags, insertIdx, SetRtFlags(rtMeshMode, rtInstanceMask, 1, 0));
+	if (numRemaining != (int)m_animatedInstances.size())
+	{
+		m_animatedInstances.resize(numRemaining);
+		m_animations.Remove(isRemoved);
 
-	// shift base offset of parent's right siblings to right by one
-	for (int siblingIdx = parentIdx + 1; siblingIdx != parentLevel.m_subtreeRanges.size(); siblingIdx++)
-		parentLevel.m_subtreeRanges[siblingIdx].Base++;
+		// cached keyframes refer to the old order
+		m_animSampler.Reset();
+	}
 
-	return insertIdx;
+	ReleaseSRWLockExclusive(&m_instanceLock);
 }
 
-void SceneCore::AddAnimation(uint64_t id, Vector<Keyframe>&& keyframes, float tOffset, bool isSorted) noexcept
+void SceneCore::AddAnimation(uint64_t id, Vector<Keyframe>&& keyframes, float tOffset, bool isSorted,
+	const AnimationCompressionParams& params) noexcept
 {
 #ifdef _DEBUG
 	TreePos *p = FindTreePosFromID(id);
@@ -425,69 +735,90 @@ void SceneCore::AddAnimation(uint64_t id, Vector<Keyframe>&& keyframes, float tO
 	Assert(GetRtFlags(m_sceneGraph[p->Level].m_rtFlags[p->Offset]).MeshMode != RT_MESH_MODE::STATIC, "Static instance can't be animated.");
 #endif // _DEBUG
 
-	Check(keyframes.size() > 1, "Invalid animation");
+	Check(keyframes.size() > 0, "Invalid animation");
 
 	if (!isSorted)
 	{
-		std::sort(m_keyframes.begin(), m_keyframes.end(),
+		std::sort(keyframes.begin(), keyframes.end(),
 			[](const Keyframe& k1, const Keyframe& k2)
 			{
 				return k1.Time < k2.Time;
 			});
 	}
 
-	// save starting offset and number of keyframes
-	const uint32_t currOffset = (uint32_t)m_keyframes.size();
-	m_animationOffsets.emplace_back(currOffset, currOffset + (int)keyframes.size(), tOffset);
-
-	// save  mapping from instance ID to starting offset in keyframe buffer
-	m_animOffsetToInstanceMap.emplace_back(id, currOffset);
-
-	// insertion sort
-	int currIdx = Math::Max(0, (int)m_animOffsetToInstanceMap.size() - 2);
-	while (currIdx >= 0 && id < m_animOffsetToInstanceMap[currIdx].Offset)
-	{
-		std::swap(m_animOffsetToInstanceMap[currIdx], m_animOffsetToInstanceMap[currIdx + 1]);
-		currIdx--;
-	}
+	NodeHandle* h = m_IDtoHandle.find(id);
+	Check(h, "instance with ID %llu was not found in the scene graph.", id);
 
-	// append
-	m_keyframes.append_range(keyframes.begin(), keyframes.end());
+	// tracks are compressed separately, each ends up with its own subset of keyframes
+	m_animations.Add(keyframes, tOffset, params);
+	m_animatedInstances.push_back(*h);
 }
 
-float4x3 SceneCore::GetPrevToWorld(uint64_t key) noexcept
+bool SceneCore::CastRay(Math::Ray& r, RayHit& hit) noexcept
 {
-	int beg = 0;
-	int end = (int)m_prevToWorlds.size();
-	int mid = (int)m_prevToWorlds.size() >> 1;
+	if (!m_bvh.IsBuilt())
+		return false;
 
-	while (true)
+	// first level -- instances whose AABB is intersected, sorted by distance
+	SmallVector<BVH::InstanceHit, App::FrameAllocator> instanceHits;
+	m_bvh.CastRay(r, instanceHits);
+
+	const v_Ray vRay(r);
+	const __m128 vOne = _mm_set1_ps(1.0f);
+	const __m128 vZero = _mm_setzero_ps();
+	bool foundHit = false;
+
+	AcquireSRWLockShared(&m_meshLock);
+
+	// second level -- triangles of each instance's mesh
+	for (auto& instance : instanceHits)
 	{
-		if (end - beg <= 2)
+		// no need to test the remaining instances as any hit with them would necessarily be farther away
+		if (instance.T >= hit.T)
 			break;
 
-		if (m_prevToWorlds[mid].ID < key)
-			beg = mid + 1;
-		else
-			end = mid + 1;
+		TreePos* p = FindTreePosFromID(instance.ID);
+		Assert(p, "instance with ID %llu was not found in the scene graph.", instance.ID);
 
-		mid = beg + ((end - beg) >> 1);
+		const uint64_t meshID = m_sceneGraph[p->Level].m_meshIDs[p->Offset];
+		const MeshBVH* meshBVH = meshID != NULL_MESH ? m_meshBVHs.find(m_meshes.GetMesh(meshID).m_geometryID) : nullptr;
+		if (!meshBVH)
+			continue;
+
+		// transform the ray into object space. Ray direction isn't normalized, so that distances 
+		// along the ray remain the same in both spaces
+		const v_float4x4 vWorldToObject = inverseSRT(load(m_sceneGraph[p->Level].m_toWorlds[p->Offset]));
+		const __m128 vOrigin = mul(vWorldToObject, _mm_insert_ps(vRay.vOrigin, vOne, 0x30));
+		const __m128 vDir = mul(vWorldToObject, _mm_insert_ps(vRay.vDir, vZero, 0x30));
+
+		Ray localRay(storeFloat3(vOrigin), storeFloat3(vDir));
+		MeshBVH::Hit meshHit{ .T = hit.T };
+
+		if (meshBVH->CastRay(localRay, meshHit))
+		{
+			hit.InstanceID = instance.ID;
+			hit.T = meshHit.T;
+			hit.U = meshHit.U;
+			hit.V = meshHit.V;
+			hit.PrimitiveIdx = meshHit.PrimitiveIdx;
+			foundHit = true;
+		}
 	}
 
-	if (m_prevToWorlds[beg].ID == key)
-		return m_prevToWorlds[beg].W;
-	else if (m_prevToWorlds[mid].ID == key)
-		return m_prevToWorlds[mid].W;
+	ReleaseSRWLockShared(&m_meshLock);
 
-	return float4x3(store(identity()));
+	return foundHit;
 }
 
 void SceneCore::RebuildBVH() noexcept
 {
 	SmallVector<BVH::BVHInput, App::FrameAllocator> allInstances;
-	allInstances.reserve(m_IDtoTreePos.size());
+	allInstances.reserve(m_IDtoHandle.size());
 
-	m_instanceVisibilityIdx.resize(m_IDtoTreePos.size());
+	// visibility indices are reassigned from scratch
+	m_instanceVisibilityIdx.clear();
+	m_instanceVisibilityIdx.resize(m_IDtoHandle.size());
+	m_freeVisibilityIndices.clear();
 
 	const int numLevels = (int)m_sceneGraph.size();
 	uint32_t currInsIdx = 0;
@@ -515,179 +846,276 @@ void SceneCore::RebuildBVH() noexcept
 	}
 
 	m_bvh.Build(allInstances);
+	m_spatialHash.Build(allInstances);
+	m_pendingBVHInserts.clear();
+
+	m_bvhBuildSAHCost = m_bvh.ComputeSAHCost();
+	m_bvhSAHCost = m_bvhBuildSAHCost;
+	m_bvhSAHCostStale = false;
 }
 
-void SceneCore::UpdateWorldTransformations(Vector<BVH::BVHUpdateInput, App::FrameAllocator>& toUpdateInstances) noexcept
+void SceneCore::InsertPendingInstancesToBVH() noexcept
 {
-	m_prevToWorlds.clear();
-	const int numLevels = (int)m_sceneGraph.size();
+	AcquireSRWLockExclusive(&m_instanceLock);
+
+	if (m_pendingBVHInserts.empty())
+	{
+		ReleaseSRWLockExclusive(&m_instanceLock);
+		return;
+	}
 
-	for (int level = 0; level < numLevels - 1; ++level)
+	for (uint64_t insID : m_pendingBVHInserts)
 	{
-		for (int i = 0; i < m_sceneGraph[level].m_subtreeRanges.size(); i++)
+		TreePos* p = FindTreePosFromID(insID);
+		Assert(p, "instance with ID %llu was not found in the scene graph.", insID);
+
+		const uint64_t meshID = m_sceneGraph[p->Level].m_meshIDs[p->Offset];
+		v_AABB vBox(m_meshes.GetMesh(meshID).m_AABB);
+		v_float4x4 vM = load(m_sceneGraph[p->Level].m_toWorlds[p->Offset]);
+
+		// transform AABB to world space
+		vBox = transform(vM, vBox);
+		const BVH::BVHInput input{ .AABB = store(vBox), .ID = insID };
+		m_bvh.Insert(input);
+		m_spatialHash.Insert(input);
+
+		// reuse the visibility indices of removed instances first, so that the indices remain in
+		// [0, number of instances)
+		uint32_t visIdx = (uint32_t)m_instanceVisibilityIdx.size();
+		if (!m_freeVisibilityIndices.empty())
 		{
-			v_float4x4 vParentTransform = load(m_sceneGraph[level].m_toWorlds[i]);
-			const auto& range = m_sceneGraph[level].m_subtreeRanges[i];
+			visIdx = m_freeVisibilityIndices.back();
+			m_freeVisibilityIndices.pop_back();
+		}
 
-			for (int j = range.Base; j < range.Base + range.Count; j++)
-			{
-				AffineTransformation& tr = m_sceneGraph[level + 1].m_localTransforms[j];
-				v_float4x4 vLocal = affineTransformation(tr.Scale, tr.Rotation, tr.Translation);
-				v_float4x4 newW = mul(vLocal, vParentTransform);
-				v_float4x4 prevW = load(m_sceneGraph[level + 1].m_toWorlds[j]);
+		m_instanceVisibilityIdx.emplace(insID, visIdx);
+	}
 
-				if (!m_rebuildBVHFlag && !equal(newW, prevW))
-				{
-					const uint64_t meshID = m_sceneGraph[level + 1].m_meshIDs[j];
+	m_pendingBVHInserts.clear();
+	m_bvhSAHCostStale = true;
 
-					v_AABB vOldBox(m_meshes.GetMesh(meshID).m_AABB);
-					vOldBox = transform(prevW, vOldBox);
-					v_AABB vNewBox = transform(newW, vOldBox);
+	ReleaseSRWLockExclusive(&m_instanceLock);
+}
 
-					toUpdateInstances.emplace_back(BVH::BVHUpdateInput{ 
-						.OldBox = store(vOldBox),
-						.NewBox = store(vNewBox),
-						.ID = m_sceneGraph[level + 1].m_IDs[j] });
+void SceneCore::DoOcclusionCulling() noexcept
+{
+	if (m_frameInstances.empty())
+		return;
 
-					RT_Flags f = GetRtFlags(m_sceneGraph[level + 1].m_rtFlags[j]);
-					Assert(f.MeshMode != RT_MESH_MODE::STATIC, "Transformation of static meshes can't change");
-					Assert(!f.RebuildFlag, "Rebuild & update flags can't be set at the same time.");
+	const Camera& camera = App::GetCamera();
+	const v_float4x4 vViewProj = mul(load(camera.GetCurrView()), load(camera.GetCurrProj()));
+	m_occlusionBuffer.BeginFrame(store(vViewProj), camera.GetNearZ());
 
-					m_sceneGraph[level + 1].m_rtFlags[j] = SetRtFlags(f.MeshMode, f.InstanceMask, 0, 1);
-				}
+	// instances that cover a larger portion of the screen are better occluders
+	struct OccluderCandidate
+	{
+		float Size;
+		int FrameIdx;
+	};
 
-				m_prevToWorlds.emplace_back(PrevToWorld{ 
-					.W = m_sceneGraph[level + 1].m_toWorlds[j], 
-					.ID = m_sceneGraph[level + 1].m_IDs[j] });
+	SmallVector<OccluderCandidate, App::FrameAllocator> candidates;
+	const float3 camPos = camera.GetPos();
 
-				m_sceneGraph[level + 1].m_toWorlds[j] = float4x3(store(newW));
-			}
-		}
+	for (int i = 0; i < (int)m_frameInstances.size(); i++)
+	{
+		AABB& box = m_frameInstances[i].AABB;
+		const float dist = Math::Max((box.Center - camPos).length(), 1e-4f);
+		const float size = box.Extents.length() / dist;
+
+		if (size >= MIN_OCCLUDER_SIZE)
+			candidates.emplace_back(OccluderCandidate{ .Size = size, .FrameIdx = i });
 	}
 
-	std::sort(m_prevToWorlds.begin(), m_prevToWorlds.end(), 
-		[](const PrevToWorld& lhs, const PrevToWorld& rhs)
+	std::sort(candidates.begin(), candidates.end(), [](const OccluderCandidate& lhs, const OccluderCandidate& rhs)
 		{
-			return lhs.ID < rhs.ID;
+			return lhs.Size > rhs.Size;
 		});
+
+	// occluders themselves shouldn't be tested as their AABB isn't necessarily in front of their geometry
+	SmallVector<bool, App::FrameAllocator> isOccluder;
+	isOccluder.resize(m_frameInstances.size(), false);
+	int numOccluders = 0;
+
+	AcquireSRWLockShared(&m_meshLock);
+
+	for (auto& candidate : candidates)
+	{
+		if (numOccluders == MAX_NUM_OCCLUDERS)
+			break;
+
+		const uint64_t insID = m_frameInstances[candidate.FrameIdx].ID;
+		TreePos* p = FindTreePosFromID(insID);
+		Assert(p, "instance with ID %llu was not found in the scene graph.", insID);
+
+		const uint64_t meshID = m_sceneGraph[p->Level].m_meshIDs[p->Offset];
+		MeshBVH* meshBVH = m_meshBVHs.find(m_meshes.GetMesh(meshID).m_geometryID);
+		if (!meshBVH || meshBVH->GetNumTriangles() > MAX_NUM_OCCLUDER_TRIS)
+			continue;
+
+		// alpha-tested and transparent geometry can't occlude
+		const Material mat = GetMaterial(m_meshes.GetMesh(meshID).m_materialID);
+		if (mat.GetAlphaMode() != Material::ALPHA_MODE::OPAQUE_)
+			continue;
+
+		m_occlusionBuffer.RasterizeOccluder(meshBVH->GetTriangleVertices(), m_sceneGraph[p->Level].m_toWorlds[p->Offset]);
+		isOccluder[candidate.FrameIdx] = true;
+		numOccluders++;
+	}
+
+	ReleaseSRWLockShared(&m_meshLock);
+
+	const uint32_t numFrustumVisible = (uint32_t)m_frameInstances.size();
+	uint32_t numVisible = 0;
+
+	for (uint32_t i = 0; i < numFrustumVisible; i++)
+	{
+		if (isOccluder[i] || !m_occlusionBuffer.IsOccluded(m_frameInstances[i].AABB))
+			m_frameInstances[numVisible++] = m_frameInstances[i];
+	}
+
+	m_frameInstances.resize(numVisible);
+
+	App::AddFrameStat("Scene", "OcclusionCulled", numFrustumVisible - numVisible, (uint32_t)m_IDtoHandle.size());
+	App::AddFrameStat("Scene", "OccluderTris", m_occlusionBuffer.GetNumRasterizedTriangles());
+}
+
+void SceneCore::SetOcclusionCullingEnabled(const ParamVariant& p) noexcept
+{
+	m_occlusionCullingEnabled = p.GetBool();
 }
 
-void SceneCore::UpdateAnimations(float t, Vector<AnimationUpdateOut, App::FrameAllocator>& animVec) noexcept
+void SceneCore::UpdateWorldTransformations(Vector<BVH::BVHUpdateInput, App::FrameAllocator>& toUpdateInstances) noexcept
 {
-	for (int i = 0; i < m_animationOffsets.size(); i++)
+	// nodes that moved in the last update but not in this one should end up with the same previous and 
+	// current transformations. Nodes that were removed since then are skipped.
+	for (NodeHandle h : m_movedNodes)
 	{
-		AffineTransformation vRes;
+		if (TreePos* p = m_nodeHandles.Find(h); p)
+			m_sceneGraph[p->Level].m_prevToWorlds[p->Offset] = m_sceneGraph[p->Level].m_toWorlds[p->Offset];
+	}
 
-		// interpolate
-		const Keyframe& kStart = m_keyframes[m_animationOffsets[i].BegOffset];
-		const Keyframe& kEnd = m_keyframes[m_animationOffsets[i].EndOffset - 1];
-		const float startOffset = m_animationOffsets[i].BegTimeOffset;
+	// only the nodes whose world transformation changed are returned
+	Span<WorldTransformUpdater::ChangedNode> changedNodes = m_worldTransformUpdater.Update(m_sceneGraph, 
+		TaskExecutor("Scene::UpdateWorld"));
 
-		// fast path
-		if (t <= kStart.Time + startOffset)
-		{
-			vRes = kStart.Transform;
-		}
-		else if (t >= kEnd.Time + startOffset)
-		{
-			vRes = kEnd.Transform;
-		}
-		else
-		{
-			// binary search
-			int beg = m_animationOffsets[i].BegOffset;
-			int end = (int)m_animationOffsets[i].EndOffset;
-			int mid = (end - beg) >> 1;
+	m_movedNodes.resize(changedNodes.size());
 
-			while (true)
+	TaskExecutor executor("Scene::UpdateWorldBVH");
+	size_t offsets[WorldTransformUpdater::MAX_NUM_JOBS];
+	size_t sizes[WorldTransformUpdater::MAX_NUM_JOBS];
+	const int numJobs = (int)SubdivideRangeWithMin(changedNodes.size(), 
+		Math::Min(executor.MaxNumJobs(), WorldTransformUpdater::MAX_NUM_JOBS), Span(offsets), Span(sizes),
+		WorldTransformUpdater::MIN_NODES_PER_JOB);
+
+	// every job builds its own list of BVH updates, which are merged at the end
+	SmallVector<BVH::BVHUpdateInput, App::FrameAllocator> bvhUpdates[WorldTransformUpdater::MAX_NUM_JOBS];
+
+	auto job = [this, changedNodes, &offsets, &sizes, &bvhUpdates](int jobIdx)
+		{
+			for (size_t i = offsets[jobIdx]; i < offsets[jobIdx] + sizes[jobIdx]; i++)
 			{
-				if (end - beg <= 2)
-					break;
+				const WorldTransformUpdater::ChangedNode& node = changedNodes[i];
+				TreeLevel& level = m_sceneGraph[node.Pos.Level];
+				const int j = node.Pos.Offset;
+				const uint64_t meshID = level.m_meshIDs[j];
+
+				if (!m_rebuildBVHFlag && meshID != NULL_MESH)
+				{
+					// both boxes are transformed from the object-space AABB
+					const v_AABB vMeshBox(m_meshes.GetMesh(meshID).m_AABB);
+					v_AABB vOldBox = transform(load(node.PrevW), vMeshBox);
+					v_AABB vNewBox = transform(load(level.m_toWorlds[j]), vMeshBox);
+
+					bvhUpdates[jobIdx].emplace_back(BVH::BVHUpdateInput{
+						.OldBox = store(vOldBox),
+						.NewBox = store(vNewBox),
+						.ID = level.m_IDs[j] });
 
-				if (m_keyframes[mid].Time + startOffset < t)
-					beg = mid + 1;
-				else
-					end = mid + 1;
+					RT_Flags f = GetRtFlags(level.m_rtFlags[j]);
+					Assert(f.MeshMode != RT_MESH_MODE::STATIC, "Transformation of static meshes can't change");
+					Assert(!f.RebuildFlag, "Rebuild & update flags can't be set at the same time.");
+
+					level.m_rtFlags[j] = SetRtFlags(f.MeshMode, f.InstanceMask, 0, 1);
+				}
 
-				mid = beg + ((end - beg) >> 1);
+				level.m_prevToWorlds[j] = node.PrevW;
+				m_movedNodes[i] = m_nodeHandles.Handle(level.m_handles[j]);
 			}
+		};
 
-			auto& k1 = m_keyframes[beg];
-			auto& k2 = m_keyframes[mid];
-
-			Assert(t >= k1.Time + startOffset && t <= k2.Time + startOffset, "bug");
-			Assert(k1.Time < k2.Time, "divide-by-zero");
-
-			float interpolatedT = (t - (k1.Time + startOffset)) / (k2.Time - k1.Time);
-
-			// scale
-			float4a temp1 = float4a(k1.Transform.Scale);
-			float4a temp2 = float4a(k2.Transform.Scale);
-			const __m128 vScale1 = _mm_load_ps(reinterpret_cast<float*>(&temp1));
-			const __m128 vScale2 = _mm_load_ps(reinterpret_cast<float*>(&temp2));
-			const __m128 vScaleInt = lerp(vScale1, vScale2, interpolatedT);
-
-			// translation
-			float4a temp3 = float4a(k1.Transform.Translation);
-			float4a temp4 = float4a(k2.Transform.Translation);
-			const __m128 vTranlate1 = _mm_load_ps(reinterpret_cast<float*>(&temp3));
-			const __m128 vTranlate2 = _mm_load_ps(reinterpret_cast<float*>(&temp4));
-			const __m128 vTranslateInt = lerp(vTranlate1, vTranlate2, interpolatedT);
-
-			// rotation
-			float4a temp5 = float4a(k1.Transform.Rotation);
-			float4a temp6 = float4a(k2.Transform.Rotation);
-			const __m128 vRot1 = _mm_load_ps(reinterpret_cast<float*>(&temp5));
-			const __m128 vRot2 = _mm_load_ps(reinterpret_cast<float*>(&temp6));
-			const __m128 vRotInt = slerp(vRot1, vRot2, interpolatedT);
-
-			//vRes = affineTransformation(vScaleInt, vRotInt, vTranslateInt);
-			vRes.Scale = storeFloat3(vScaleInt);
-			vRes.Rotation = storeFloat4(vRotInt);
-			vRes.Translation = storeFloat3(vTranslateInt);
-		}
+	executor.For(numJobs, job);
 
-		animVec.emplace_back(AnimationUpdateOut{ .M = vRes, .Offset = m_animationOffsets[i].BegOffset });
-	}
+	for (int i = 0; i < numJobs; i++)
+		toUpdateInstances.append_range(bvhUpdates[i].begin(), bvhUpdates[i].end());
+}
+
+void SceneCore::UpdateAnimations(float t, Span<AffineTransformation> animVec) noexcept
+{
+	m_animSampler.Sample(m_animations, t, animVec, TaskExecutor("Scene::UpdateAnimations"));
 }
 
-void SceneCore::UpdateLocalTransforms(Span<AnimationUpdateOut> animVec) noexcept
+void SceneCore::UpdateLocalTransforms(Span<AffineTransformation> animVec) noexcept
 {
-	for(auto& update : animVec)
+	Assert(animVec.size() == m_animatedInstances.size(), "every animation must belong to exactly one instance.");
+
+	for (size_t i = 0; i < animVec.size(); i++)
 	{
-		uint64_t insID = uint64_t(-1);
+		// animations of removed instances are dropped during compaction, which comes before this
+		TreePos* t = m_nodeHandles.Find(m_animatedInstances[i]);
+		Assert(t, "instance for animation %llu was not found in the scene graph.", i);
 
-		{
-			// binary search
-			int key = update.Offset;
-			int beg = 0;
-			int end = (int)m_animOffsetToInstanceMap.size();
-			int mid = end >> 1;
+		m_sceneGraph[t->Level].m_localTransforms[t->Offset] = animVec[i];
+		m_worldTransformUpdater.MarkDirty(*t);
+	}
+}
 
-			while (true)
-			{
-				if (end - beg <= 2)
-					break;
+StreamingQueue& SceneCore::AddStreamingQueue(int numStages) noexcept
+{
+	m_streamingQueues.push_back(std::make_unique<StreamingQueue>(numStages));
+	return *m_streamingQueues.back();
+}
 
-				if (m_animOffsetToInstanceMap[mid].Offset < key)
-					beg = mid + 1;
-				else
-					end = mid + 1;
+void SceneCore::IntegrateStreamedChunks() noexcept
+{
+	if (m_streamingQueues.empty())
+		return;
 
-				mid = beg + ((end - beg) >> 1);
-			}
+	DeltaTimer timer;
+	timer.Start();
 
-			if (m_animOffsetToInstanceMap[beg].Offset == key)
-				insID = m_animOffsetToInstanceMap[beg].InstanceID;
-			else if (m_animOffsetToInstanceMap[mid].Offset == key)
-				insID = m_animOffsetToInstanceMap[mid].InstanceID;
-			else
-				Assert(false, "Instance ID for current animation was not found.");
-		}
+	double remainingMs = m_streamingBudgetMs;
+	uint32_t numChunks = 0;
+	m_integratingStreamedChunks = true;
+
+	// budget is shared between the queues, but every queue makes progress
+	for (size_t i = 0; i < m_streamingQueues.size();)
+	{
+		numChunks += m_streamingQueues[i]->Integrate(Math::Max(remainingMs, 0.0));
 
-		TreePos* t = FindTreePosFromID(insID);
-		Assert(t, "instance with ID %llu was not found in the scene graph.", insID);
+		timer.End();
+		remainingMs = m_streamingBudgetMs - timer.DeltaMilli();
 
-		m_sceneGraph[t->Level].m_localTransforms[t->Offset] = update.M;
+		if (m_streamingQueues[i]->IsDone())
+		{
+			// every instance of this scene was added (along with whatever other streamed scenes have 
+			// added so far)
+			m_staleStaticInstances = m_staleStaticInstances || m_heldStaticInstances;
+			m_heldStaticInstances = false;
+
+			// order doesn't matter
+			std::swap(m_streamingQueues[i], m_streamingQueues.back());
+			m_streamingQueues.pop_back();
+		}
+		else
+			i++;
 	}
+
+	m_integratingStreamedChunks = false;
+
+	App::AddFrameStat("Scene", "Streamed chunks", numChunks);
+}
+
+void SceneCore::SetStreamingBudget(const ParamVariant& p) noexcept
+{
+	m_streamingBudgetMs = p.GetFloat().m_val;
 }
@@ -2,9 +2,16 @@
 
 #include "../Model/glTFAsset.h"
 #include "../Math/BVH.h"
+#include "../Math/MeshBVH.h"
+#include "../Math/OcclusionCulling.h"
+#include "../Math/SpatialHash.h"
+#include "Animation.h"
 #include "Asset.h"
+#include "SceneGraph.h"
 #include "SceneRenderer.h"
+#include "../Support/StreamingQueue.h"
 #include <xxHash/xxhash.h>
+#include <memory>
 
 namespace ZetaRay::Model
 {
@@ -17,14 +24,13 @@ namespace ZetaRay::RT
 	struct TLAS;
 }
 
-namespace ZetaRay::Scene
+namespace ZetaRay::Support
 {
-	struct Keyframe
-	{
-		Math::AffineTransformation Transform;
-		float Time;
-	};
+	struct ParamVariant;
+}
 
+namespace ZetaRay::Scene
+{
 	struct RT_Flags
 	{
 		Model::RT_MESH_MODE MeshMode;
@@ -46,6 +52,19 @@ namespace ZetaRay::Scene
 			.UpdateFlag = uint8_t((f >> 5) & 0x1) };
 	}
 
+	struct RayHit
+	{
+		uint64_t InstanceID = uint64_t(-1);
+		// distance along the ray (in units of ray direction's length)
+		float T = FLT_MAX;
+		// barycentric coords. of the hit position relative to the hit triangle (v0v1v2) such that
+		//		hit_pos = v0 + U(v1 - v0) + V(v2 - v0)
+		float U;
+		float V;
+		// index of the hit triangle in the mesh's index buffer (i.e. index / 3)
+		uint32_t PrimitiveIdx = uint32_t(-1);
+	};
+
 	class SceneCore
 	{
 		friend struct RT::StaticBLAS;
@@ -99,14 +118,19 @@ namespace ZetaRay::Scene
 
 		// needs to be called prior to loading a scene
 		void ReserveScene(uint64_t sceneID, size_t numMeshes, size_t numMats, size_t numNodes) noexcept;
-		//void UnloadScene(uint64_t sceneID) noexcept;
+		// Removes every instance, mesh and material that was added from the given scene. GPU resources
+		// are released after the GPU is done with them.
+		void UnloadScene(uint64_t sceneID) noexcept;
 
 		//
 		// Mesh
 		//
 		void AddMeshes(uint64_t sceneID, Util::SmallVector<Model::glTF::Asset::MeshSubset>&& meshes,
 			Util::SmallVector<Core::Vertex>&& vertices,
-			Util::SmallVector<uint32_t>&& indices) noexcept;
+			Util::SmallVector<uint32_t>&& indices,
+			Util::SmallVector<Model::MeshLOD>&& lods,
+			Util::SmallVector<uint32_t>&& lodIndices,
+			Util::SmallVector<Math::MeshBVH>&& meshBVHs) noexcept;
 		ZetaInline Model::TriangleMesh GetMesh(uint64_t id) noexcept
 		{
 			AcquireSRWLockShared(&m_meshLock);
@@ -119,8 +143,29 @@ namespace ZetaRay::Scene
 
 		ZetaInline const Core::DefaultHeapBuffer& GetMeshVB() noexcept { return m_meshes.GetVB(); }
 		ZetaInline const Core::DefaultHeapBuffer& GetMeshIB() noexcept { return m_meshes.GetIB(); }
+		// LODs of the mesh (see MeshSimplifier::SelectLOD()), empty unless they were requested at import 
+		// time. Invalidated by adding meshes or when buffers are rebuilt.
+		ZetaInline Util::Span<Model::MeshLOD> GetLODs(uint64_t id) noexcept
+		{
+			AcquireSRWLockShared(&m_meshLock);
+			auto l = m_meshes.GetLODs(id);
+			ReleaseSRWLockShared(&m_meshLock);
 
-		//void RemoveMesh(uint64_t id) noexcept;
+			return l;
+		}
+		// Whether any of the meshes has geometry with the given content hash (see Model::GeometryHash())
+		ZetaInline bool HasGeometry(uint64_t geometryID) noexcept
+		{
+			AcquireSRWLockShared(&m_meshLock);
+			const bool found = m_meshes.HasGeometry(geometryID);
+			ReleaseSRWLockShared(&m_meshLock);
+
+			return found;
+		}
+
+		// Releases the reference that was added by AddMeshes(). Mesh is removed once none of the 
+		// instances refer to it anymore.
+		void RemoveMesh(uint64_t id) noexcept;
 
 		//
 		// Material
@@ -134,7 +179,9 @@ namespace ZetaRay::Scene
 
 			return mat;
 		}
-		//void RemoveMaterial(uint64_t id) noexcept;
+		// Releases the reference that was added by AddMaterial(). Material (along with its textures) is
+		// removed once none of the meshes refer to it anymore.
+		void RemoveMaterial(uint64_t id) noexcept;
 
 		ZetaInline uint32_t GetBaseColMapsDescHeapOffset() const { return m_baseColorDescTable.m_descTable.GPUDesciptorHeapIndex(); }
 		ZetaInline uint32_t GetNormalMapsDescHeapOffset() const { return m_normalDescTable.m_descTable.GPUDesciptorHeapIndex(); }
@@ -145,8 +192,12 @@ namespace ZetaRay::Scene
 		// Instance
 		//
 		void AddInstance(uint64_t sceneID, Model::glTF::Asset::InstanceDesc&& instance) noexcept;
-		//void RemoveInstance(uint64_t id) noexcept;
-		Math::float4x3 GetPrevToWorld(uint64_t id) noexcept;
+		// Parents must either already be in the scene or come before their children
+		void AddInstances(uint64_t sceneID, Util::Span<Model::glTF::Asset::InstanceDesc> instances) noexcept;
+		// Removes the given instances along with all of their descendants. Removed instances are compacted
+		// away from the scene graph at the beginning of the next update.
+		void RemoveInstance(uint64_t id) noexcept;
+		void RemoveInstances(Util::Span<uint64_t> ids) noexcept;
 		
 		ZetaInline Math::float4x3 GetToWorld(uint64_t id) noexcept
 		{
@@ -156,6 +207,14 @@ namespace ZetaRay::Scene
 			return m_sceneGraph[p->Level].m_toWorlds[p->Offset];
 		}
 
+		ZetaInline Math::float4x3 GetPrevToWorld(uint64_t id) noexcept
+		{
+			TreePos* p = FindTreePosFromID(id);
+			Assert(p, "instance with ID %llu was not found in the scene-graph.", id);
+
+			return m_sceneGraph[p->Level].m_prevToWorlds[p->Offset];
+		}
+
 		ZetaInline uint64_t GetInstanceMeshID(uint64_t id) noexcept
 		{
 			TreePos* p = FindTreePosFromID(id);
@@ -172,10 +231,44 @@ namespace ZetaRay::Scene
 			return *e;
 		}
 
-		ZetaInline uint32_t GetTotalNumInstances() const { return (uint32_t)m_IDtoTreePos.size(); }
+		ZetaInline uint32_t GetTotalNumInstances() const { return (uint32_t)m_IDtoHandle.size(); }
 		ZetaInline Util::Span<Math::BVH::BVHInput> GetFrameInstances() { return m_frameInstances; }
 
-		void AddAnimation(uint64_t id, Util::Vector<Keyframe>&& keyframes, float tOffset, bool isSorted = true) noexcept;
+		// A single keyframe results in a constant transformation
+		void AddAnimation(uint64_t id, Util::Vector<Keyframe>&& keyframes, float tOffset, bool isSorted = true,
+			const AnimationCompressionParams& params = AnimationCompressionParams()) noexcept;
+
+		// Casts a ray against the scene geometry and returns whether there was a hit closer than hit.T.
+		// Traversal is two-level: instance BVH first and then the triangle BVH of each intersected
+		// instance's mesh. Given Ray has to be in world space. Shouldn't be called concurrently 
+		// with Update().
+		bool CastRay(Math::Ray& r, RayHit& hit) noexcept;
+
+		// Following return instances whose world-space AABB overlaps the given AABB or sphere, or is
+		// closest to the given point (results are appended). They can be called concurrently from 
+		// multiple threads, but not concurrently with Update() or instance removal.
+		ZetaInline void FindInstancesInAABB(const Math::AABB& box, Util::Vector<uint64_t>& instanceIDs) const noexcept
+		{
+			m_spatialHash.OverlapBox(box, instanceIDs);
+		}
+		ZetaInline void FindInstancesInRadius(const Math::float3& center, float radius, Util::Vector<uint64_t>& instanceIDs) const noexcept
+		{
+			m_spatialHash.OverlapSphere(center, radius, instanceIDs);
+		}
+		ZetaInline void FindNearestInstances(const Math::float3& p, int k, Util::Vector<Math::SpatialHash::Neighbor>& neighbors) const noexcept
+		{
+			m_spatialHash.FindKNearest(p, k, neighbors);
+		}
+
+		//
+		// Streaming
+		//
+		// Returns a queue for chunks of a scene that's being loaded in the background. Queued chunks are
+		// integrated at the beginning of every update within the streaming time budget (see
+		// StreamingQueue::Integrate()) and the queue is released once all of its stages are done.
+		// Should only be called from the main thread.
+		Support::StreamingQueue& AddStreamingQueue(int numStages) noexcept;
+		ZetaInline bool IsStreaming() const { return !m_streamingQueues.empty(); }
 
 		//
 		// Cleanup
@@ -195,72 +288,51 @@ namespace ZetaRay::Scene
 		// by order of declaration and destroyed in reverse order"
 		Support::MemoryPool m_memoryPool;
 
-		struct TreePos
+		ZetaInline TreePos* FindTreePosFromID(uint64_t id) noexcept
 		{
-			int Level;
-			int Offset;
-		};
+			NodeHandle* h = m_IDtoHandle.find(id);
+			return h ? m_nodeHandles.Find(*h) : nullptr;
+		}
 
-		ZetaInline TreePos* FindTreePosFromID(uint64_t id) noexcept { return m_IDtoTreePos.find(id); }
+		// Following two assume the corresponding lock is held
+		void ReleaseMesh(uint64_t id) noexcept;
+		void ReleaseMaterial(uint64_t id) noexcept;
 
-		int InsertAtLevel(uint64_t id, int treeLevel, int parentIdx, Math::AffineTransformation& localTransform,
-			uint64_t meshID, Model::RT_MESH_MODE rtMeshMode, uint8_t rtInstanceMask) noexcept;
-		//void RemoveFromLevel(int idx, int level) noexcept;
+		void CompactSceneGraph() noexcept;
 
 		void UpdateWorldTransformations(Util::Vector<Math::BVH::BVHUpdateInput, App::FrameAllocator>& toUpdateInstances) noexcept;
 		void RebuildBVH() noexcept;
+		void InsertPendingInstancesToBVH() noexcept;
 
-		struct AnimationUpdateOut
-		{
-			Math::AffineTransformation M;
-			int Offset;
-		};
+		// Removes the instances that are hidden behind a few large occluders from the frustum-culled instances
+		void DoOcclusionCulling() noexcept;
+		void SetOcclusionCullingEnabled(const Support::ParamVariant& p) noexcept;
 
-		void UpdateAnimations(float t, Util::Vector<AnimationUpdateOut, App::FrameAllocator>& animVec) noexcept;
-		void UpdateLocalTransforms(Util::Span<AnimationUpdateOut> animVec) noexcept;
+		// Transformation of i'th animation is written to animVec[i]
+		void UpdateAnimations(float t, Util::Span<Math::AffineTransformation> animVec) noexcept;
+		void UpdateLocalTransforms(Util::Span<Math::AffineTransformation> animVec) noexcept;
+
+		void IntegrateStreamedChunks() noexcept;
+		void SetStreamingBudget(const Support::ParamVariant& p) noexcept;
 
 		bool m_isPaused = false;
+		// time that animations are sampled at -- advanced by the frame time, except while paused
+		double m_animationTime = 0.0;
 
 		//
 		// scene-graph
 		//
 
-		// Maps instance ID to tree position
-		Util::HashTable<TreePos> m_IDtoTreePos;
-
-		struct Range
-		{
-			Range() noexcept = default;
-			Range(int b, int c) noexcept
-				: Base(b),
-				Count(c)
-			{}
-
-			int Base;
-			int Count;
-		};
-
-		struct TreeLevel
-		{
-			TreeLevel(Support::MemoryPool& mp) noexcept
-				: m_IDs(mp),
-				m_localTransforms(mp),
-				m_toWorlds(mp),
-				m_meshIDs(mp),
-				m_subtreeRanges(mp),
-				m_rtFlags(mp)
-			{}
-
-			Util::SmallVector<uint64_t, Support::PoolAllocator> m_IDs;
-			Util::SmallVector<Math::AffineTransformation, Support::PoolAllocator> m_localTransforms;
-			Util::SmallVector<Math::float4x3, Support::PoolAllocator> m_toWorlds;
-			Util::SmallVector<uint64_t, Support::PoolAllocator> m_meshIDs;
-			Util::SmallVector<Range, Support::PoolAllocator> m_subtreeRanges;
-			// first six bits encode MeshInstanceFlags, last two bits indicate RT_MESH_MODE
-			Util::SmallVector<uint8_t, Support::PoolAllocator> m_rtFlags;
-		};
+		// Maps instance ID to its handle
+		Util::HashTable<NodeHandle> m_IDtoHandle;
+		NodeHandleTable m_nodeHandles;
 
 		Util::SmallVector<TreeLevel, Support::PoolAllocator> m_sceneGraph;
+		// some of the instances were removed since the last update
+		bool m_compactSceneGraph = false;
+
+		// nodes whose local transformation changed since the last update
+		WorldTransformUpdater m_worldTransformUpdater;
 
 		//
 		// scene metadata
@@ -274,25 +346,23 @@ namespace ZetaRay::Scene
 			Util::SmallVector<uint64_t> Instances;
 		};
 
-		//Util::HashTable<SceneMetadata> m_sceneMetadata;
+		Util::HashTable<SceneMetadata> m_sceneMetadata;
 
 		uint32_t m_numStaticInstances = 0;
 		uint32_t m_numDynamicInstances = 0;
 
 		// TODO this is managed by TLAS, is there a better way?
 		bool m_staleStaticInstances = false;
+		// static instances that were streamed in and aren't in the static BLAS yet. They're traced once 
+		// their scene is done streaming (see IntegrateStreamedChunks()).
+		bool m_heldStaticInstances = false;
+		bool m_integratingStreamedChunks = false;
+		// dynamic instances that were removed since the last TLAS build. Their BLASes are released by TLAS
+		Util::SmallVector<uint64_t, Support::PoolAllocator> m_removedDynamicInstances;
 
-		//
-		// previous frame's ToWorld transformations
-		//
-		
-		struct PrevToWorld
-		{
-			Math::float4x3 W;
-			uint64_t ID;
-		};
-
-		Util::SmallVector<PrevToWorld, Support::PoolAllocator> m_prevToWorlds;
+		// nodes that moved in the last update. Their previous world transformation is reset at the 
+		// beginning of the next one, so that nodes that stopped moving don't keep their old one.
+		Util::SmallVector<NodeHandle, Support::PoolAllocator> m_movedNodes;
 
 		//
 		// BVH
@@ -301,12 +371,48 @@ namespace ZetaRay::Scene
 		Math::BVH m_bvh;
 		bool m_rebuildBVHFlag = false;
 
+		// same instances as the BVH for proximity queries, kept in sync with it
+		Math::SpatialHash m_spatialHash;
+
+		// instances that were added after the BVH was built. They're inserted incrementally 
+		// rather than triggering a full rebuild
+		Util::SmallVector<uint64_t, Support::PoolAllocator> m_pendingBVHInserts;
+
+		// SAH cost right after the last full rebuild and after the last incremental change,
+		// used to track the tree-quality drift. Computing it walks the whole tree, so after
+		// incremental changes it's only refreshed every few frames.
+		static constexpr uint64_t SAH_COST_UPDATE_INTERVAL = 30;
+		float m_bvhBuildSAHCost = 0.0f;
+		float m_bvhSAHCost = 0.0f;
+		bool m_bvhSAHCostStale = false;
+
+		// per-mesh triangle BVHs, indexed by geometry ID (see TriangleMesh::m_geometryID)
+		Util::HashTable<Math::MeshBVH> m_meshBVHs;
+
+		//
+		// occlusion culling
+		//
+
+		static constexpr int OCCLUSION_BUFFER_WIDTH = 256;
+		static constexpr int OCCLUSION_BUFFER_HEIGHT = 144;
+		static constexpr int MAX_NUM_OCCLUDERS = 16;
+		static constexpr uint32_t MAX_NUM_OCCLUDER_TRIS = 4096;
+		// ratio of (half) AABB diagonal to distance from the camera, below which an instance
+		// is too small to be an effective occluder
+		static constexpr float MIN_OCCLUDER_SIZE = 0.1f;
+
+		Math::OcclusionBuffer m_occlusionBuffer;
+		// off by default, as the occlusion buffer isn't conservative yet (see OcclusionBuffer::IsOccluded())
+		bool m_occlusionCullingEnabled = false;
+
 		//
 		// instances
 		//
 
 		Util::SmallVector<Math::BVH::BVHInput, App::FrameAllocator> m_frameInstances;
 		Util::HashTable<uint32_t> m_instanceVisibilityIdx;
+		// visibility indices of removed instances, which are reused before allocating new ones
+		Util::SmallVector<uint32_t> m_freeVisibilityIndices;
 
 		//
 		// assets
@@ -334,42 +440,25 @@ namespace ZetaRay::Scene
 		SRWLOCK m_matLock = SRWLOCK_INIT;
 		SRWLOCK m_meshLock = SRWLOCK_INIT;
 		SRWLOCK m_instanceLock = SRWLOCK_INIT;
+		SRWLOCK m_sceneMetadataLock = SRWLOCK_INIT;
 
 		//
 		// animations
 		//
 
-		// has to remain sorted by "Offset"
-		struct InstanceToAnimationMap
-		{
-			InstanceToAnimationMap() = default;
-			InstanceToAnimationMap(uint64_t id, int o) noexcept
-				: InstanceID(id),
-				Offset(o)
-			{}
-
-			uint64_t InstanceID;
-			int Offset;
-		};
+		// i'th animation belongs to i'th instance
+		Util::SmallVector<NodeHandle, Support::PoolAllocator> m_animatedInstances;
+		CompressedAnimations m_animations;
+		AnimationSampler m_animSampler;
 
-		// offsets into "m_keyframes"
-		struct AnimationOffset
-		{
-			AnimationOffset() = default;
-			AnimationOffset(int b, int e, float t) noexcept
-				: BegOffset(b),
-				EndOffset(e),
-				BegTimeOffset(t)
-			{}
-
-			int BegOffset;
-			int EndOffset;
-			float BegTimeOffset;
-		};
+		//
+		// streaming
+		//
 
-		Util::SmallVector<InstanceToAnimationMap, Support::PoolAllocator> m_animOffsetToInstanceMap;
-		Util::SmallVector<AnimationOffset, Support::PoolAllocator> m_animationOffsets;
-		Util::SmallVector<Keyframe, Support::PoolAllocator> m_keyframes;
+		// queues are shared with the background tasks that fill them, so their addresses have to be stable
+		Util::SmallVector<std::unique_ptr<Support::StreamingQueue>> m_streamingQueues;
+		// total time that each update spends on integrating streamed chunks (of all the queues)
+		float m_streamingBudgetMs = 2.0f;
 
 		//
 		// Scene Renderer
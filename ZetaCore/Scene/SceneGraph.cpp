@@ -0,0 +1,638 @@
+#include "SceneGraph.h"
+#include "../Math/MatrixFuncs.h"
+#include "../Math/BatchFuncs.h"
+#include "../Utility/Error.h"
+#include <algorithm>
+
+using namespace ZetaRay;
+using namespace ZetaRay::Scene;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Math;
+using namespace ZetaRay::Support;
+
+//--------------------------------------------------------------------------------------
+// NodeHandleTable
+//--------------------------------------------------------------------------------------
+
+NodeHandle NodeHandleTable::Allocate(TreePos pos) noexcept
+{
+	m_numLive++;
+
+	if (m_freeListHead != NodeHandle::INVALID_INDEX)
+	{
+		const uint32_t idx = m_freeListHead;
+		Slot& slot = m_slots[idx];
+		m_freeListHead = slot.NextFree;
+		slot.Pos = pos;
+
+		return NodeHandle{ .Index = idx, .Generation = slot.Generation };
+	}
+
+	m_slots.push_back(Slot{ .Pos = pos, .Generation = 0, .NextFree = NodeHandle::INVALID_INDEX });
+
+	return NodeHandle{ .Index = (uint32_t)m_slots.size() - 1, .Generation = 0 };
+}
+
+void NodeHandleTable::Free(NodeHandle h) noexcept
+{
+	Assert(Find(h), "handle is stale.");
+	Slot& slot = m_slots[h.Index];
+
+	// every existing copy of this handle becomes stale
+	slot.Generation++;
+	slot.Pos = TreePos{ .Level = -1, .Offset = -1 };
+	slot.NextFree = m_freeListHead;
+	m_freeListHead = h.Index;
+
+	m_numLive--;
+}
+
+void NodeHandleTable::Clear() noexcept
+{
+	m_slots.free_memory();
+	m_freeListHead = NodeHandle::INVALID_INDEX;
+	m_numLive = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Insertion
+//--------------------------------------------------------------------------------------
+
+void Scene::InsertNodes(SmallVector<TreeLevel, PoolAllocator>& levels, MemoryPool& mp, Span<NewNode> nodes,
+	uint64_t rootID, HashTable<NodeHandle>& idToHandle, NodeHandleTable& handles) noexcept
+{
+	if (nodes.empty())
+		return;
+
+	// avoid rehashing while the new nodes are added (max. load factor is less than 1)
+	idToHandle.resize((idToHandle.size() + nodes.size()) * 2);
+
+	// new nodes get a handle right away (with an invalid offset), so that the level of their 
+	// children can be found
+	SmallVector<int> nodeLevels;
+	SmallVector<uint32_t> nodeSlots;
+	SmallVector<uint32_t> parentSlots;
+	nodeLevels.resize(nodes.size());
+	nodeSlots.resize(nodes.size());
+	parentSlots.resize(nodes.size());
+	int minLevel = (int)levels.size();
+	int maxLevel = 0;
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		int parentLevel = 0;
+		parentSlots[i] = NodeHandle::INVALID_INDEX;
+
+		if (nodes[i].ParentID != rootID)
+		{
+			const NodeHandle* p = idToHandle.find(nodes[i].ParentID);
+			Assert(p, "parent of node with ID %llu was not found.", nodes[i].ID);
+			parentSlots[i] = p->Index;
+			parentLevel = handles.Pos(p->Index).Level;
+		}
+
+		Assert(idToHandle.find(nodes[i].ID) == nullptr, "node with ID %llu already exists.", nodes[i].ID);
+		nodeLevels[i] = parentLevel + 1;
+
+		const NodeHandle h = handles.Allocate(TreePos{ .Level = nodeLevels[i], .Offset = -1 });
+		idToHandle.insert_or_assign(nodes[i].ID, h);
+		nodeSlots[i] = h.Index;
+
+		minLevel = Math::Min(minLevel, nodeLevels[i]);
+		maxLevel = Math::Max(maxLevel, nodeLevels[i]);
+	}
+
+	// bucket the new nodes by level using counting sort (stable, so batch order is preserved)
+	SmallVector<int> levelOffsets;
+	levelOffsets.resize(maxLevel + 2, 0);
+
+	for (int l : nodeLevels)
+		levelOffsets[l + 1]++;
+
+	for (int l = 1; l < (int)levelOffsets.size(); l++)
+		levelOffsets[l] += levelOffsets[l - 1];
+
+	SmallVector<int> sorted;
+	sorted.resize(nodes.size());
+
+	{
+		SmallVector<int> curr;
+		curr.append_range(levelOffsets.begin(), levelOffsets.end());
+
+		for (int i = 0; i < (int)nodes.size(); i++)
+			sorted[curr[nodeLevels[i]]++] = i;
+	}
+
+	while ((int)levels.size() <= maxLevel)
+		levels.emplace_back(mp);
+
+	// new nodes at the current level sorted by parent (again using counting sort) and where the 
+	// children of each parent start
+	SmallVector<int> children;
+	SmallVector<int> firstChild;
+	SmallVector<int> parentOffsets;
+
+	// subtree ranges of level l - 1 are recomputed while level l is rebuilt, so one more level needs to
+	// be visited after the last one that has new nodes
+	for (int level = minLevel; level <= maxLevel + 1; level++)
+	{
+		TreeLevel& parentLevel = levels[level - 1];
+		// level 0 only has subtree ranges and world transformations
+		const int numParents = (int)parentLevel.m_subtreeRanges.size();
+
+		// no more levels, all the subtree ranges of parent level are empty
+		if (level == (int)levels.size())
+		{
+			for (auto& r : parentLevel.m_subtreeRanges)
+				r = Range(0, 0);
+
+			break;
+		}
+
+		TreeLevel& currLevel = levels[level];
+		const int numNew = level <= maxLevel ? levelOffsets[level + 1] - levelOffsets[level] : 0;
+
+		children.resize(numNew);
+		parentOffsets.resize(numNew);
+		firstChild.resize(numParents + 1);
+		memset(firstChild.data(), 0, firstChild.size() * sizeof(int));
+
+		// parent level is done, so positions of all the parents are known by now
+		for (int i = 0; i < numNew; i++)
+		{
+			const uint32_t parentSlot = parentSlots[sorted[levelOffsets[level] + i]];
+			parentOffsets[i] = parentSlot == NodeHandle::INVALID_INDEX ? 0 : handles.Pos(parentSlot).Offset;
+			firstChild[parentOffsets[i] + 1]++;
+		}
+
+		for (int p = 1; p <= numParents; p++)
+			firstChild[p] += firstChild[p - 1];
+
+		for (int i = 0; i < numNew; i++)
+			children[firstChild[parentOffsets[i]]++] = sorted[levelOffsets[level] + i];
+
+		// firstChild[p] now points to the end of p's children
+		for (int p = numParents; p > 0; p--)
+			firstChild[p] = firstChild[p - 1];
+
+		firstChild[0] = 0;
+
+		const int oldSize = (int)currLevel.m_IDs.size();
+		const int newSize = oldSize + numNew;
+
+		currLevel.m_IDs.resize(newSize);
+		currLevel.m_localTransforms.resize(newSize);
+		currLevel.m_toWorlds.resize(newSize);
+		currLevel.m_prevToWorlds.resize(newSize);
+		currLevel.m_meshIDs.resize(newSize);
+		currLevel.m_subtreeRanges.resize(newSize);
+		currLevel.m_rtFlags.resize(newSize);
+		currLevel.m_handles.resize(newSize);
+
+		// fill the level from the back; every existing node either stays where it is or moves to 
+		// the right, so nothing is overwritten before it's moved
+		int dst = newSize;
+
+		for (int p = numParents - 1; p >= 0; p--)
+		{
+			const int end = dst;
+
+			// new children go after the existing ones
+			for (int c = firstChild[p + 1] - 1; c >= firstChild[p]; c--)
+			{
+				const int nodeIdx = children[c];
+				NewNode& node = nodes[nodeIdx];
+				const v_float4x4 vLocal = affineTransformation(node.LocalTransform.Scale, node.LocalTransform.Rotation,
+					node.LocalTransform.Translation);
+				dst--;
+
+				currLevel.m_IDs[dst] = node.ID;
+				currLevel.m_localTransforms[dst] = node.LocalTransform;
+				currLevel.m_toWorlds[dst] = float4x3(store(mul(vLocal, load(parentLevel.m_toWorlds[p]))));
+				// new nodes haven't moved
+				currLevel.m_prevToWorlds[dst] = currLevel.m_toWorlds[dst];
+				currLevel.m_meshIDs[dst] = node.MeshID;
+				currLevel.m_subtreeRanges[dst] = Range(0, 0);
+				currLevel.m_rtFlags[dst] = node.RtFlags;
+				currLevel.m_handles[dst] = nodeSlots[nodeIdx];
+
+				handles.Pos(nodeSlots[nodeIdx]).Offset = dst;
+			}
+
+			const Range oldRange = parentLevel.m_subtreeRanges[p];
+
+			for (int i = oldRange.Base + oldRange.Count - 1; i >= oldRange.Base; i--)
+			{
+				dst--;
+
+				if (dst == i)
+					continue;
+
+				currLevel.m_IDs[dst] = currLevel.m_IDs[i];
+				currLevel.m_localTransforms[dst] = currLevel.m_localTransforms[i];
+				currLevel.m_toWorlds[dst] = currLevel.m_toWorlds[i];
+				currLevel.m_prevToWorlds[dst] = currLevel.m_prevToWorlds[i];
+				currLevel.m_meshIDs[dst] = currLevel.m_meshIDs[i];
+				currLevel.m_subtreeRanges[dst] = currLevel.m_subtreeRanges[i];
+				currLevel.m_rtFlags[dst] = currLevel.m_rtFlags[i];
+				currLevel.m_handles[dst] = currLevel.m_handles[i];
+
+				// removed nodes that haven't been compacted yet don't have a handle
+				if (currLevel.m_handles[dst] != NodeHandle::INVALID_INDEX)
+					handles.Pos(currLevel.m_handles[dst]).Offset = dst;
+			}
+
+			// base offsets are the prefix sum of children counts
+			parentLevel.m_subtreeRanges[p] = Range(dst, end - dst);
+		}
+
+		Assert(dst == 0, "some of the nodes at level %d weren't placed.", level);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Removal
+//--------------------------------------------------------------------------------------
+
+void Scene::RemoveNodes(Span<TreeLevel> levels, Span<NodeHandle> nodes, NodeHandleTable& handles,
+	SmallVector<TreePos>& removed) noexcept
+{
+	size_t next = removed.size();
+
+	for (NodeHandle h : nodes)
+	{
+		// already removed along with one of its ancestors
+		const TreePos* pos = handles.Find(h);
+		if (!pos)
+			continue;
+
+		removed.push_back(*pos);
+
+		// every removed node is visited once (breadth-first), its children are always removed along with it
+		for (; next < removed.size(); next++)
+		{
+			const TreePos p = removed[next];
+			TreeLevel& level = levels[p.Level];
+			const uint32_t slot = level.m_handles[p.Offset];
+			Assert(slot != NodeHandle::INVALID_INDEX, "node at level %d, offset %d was already removed.", p.Level, p.Offset);
+
+			handles.Free(handles.Handle(slot));
+			level.m_handles[p.Offset] = NodeHandle::INVALID_INDEX;
+			level.m_numRemoved++;
+
+			const Range& r = level.m_subtreeRanges[p.Offset];
+
+			for (int c = r.Base; c < r.Base + r.Count; c++)
+				removed.push_back(TreePos{ .Level = p.Level + 1, .Offset = c });
+		}
+	}
+}
+
+void Scene::CompactNodes(SmallVector<TreeLevel, PoolAllocator>& levels, NodeHandleTable& handles) noexcept
+{
+	for (int level = 1; level < (int)levels.size(); level++)
+	{
+		TreeLevel& currLevel = levels[level];
+
+		// nothing moves, so subtree ranges of the parent level remain valid
+		if (currLevel.m_numRemoved == 0)
+			continue;
+
+		TreeLevel& parentLevel = levels[level - 1];
+		const int numParents = (int)parentLevel.m_subtreeRanges.size();
+		int dst = 0;
+
+		// existing nodes either stay where they are or move to the left, so a forward pass doesn't 
+		// overwrite anything before it's moved
+		for (int p = 0; p < numParents; p++)
+		{
+			const Range oldRange = parentLevel.m_subtreeRanges[p];
+			const int base = dst;
+
+			for (int i = oldRange.Base; i < oldRange.Base + oldRange.Count; i++)
+			{
+				const uint32_t slot = currLevel.m_handles[i];
+				if (slot == NodeHandle::INVALID_INDEX)
+					continue;
+
+				if (dst != i)
+				{
+					currLevel.m_IDs[dst] = currLevel.m_IDs[i];
+					currLevel.m_localTransforms[dst] = currLevel.m_localTransforms[i];
+					currLevel.m_toWorlds[dst] = currLevel.m_toWorlds[i];
+					currLevel.m_prevToWorlds[dst] = currLevel.m_prevToWorlds[i];
+					currLevel.m_meshIDs[dst] = currLevel.m_meshIDs[i];
+					// still refers to the old positions in the next level, which is compacted next
+					currLevel.m_subtreeRanges[dst] = currLevel.m_subtreeRanges[i];
+					currLevel.m_rtFlags[dst] = currLevel.m_rtFlags[i];
+					currLevel.m_handles[dst] = slot;
+
+					handles.Pos(slot).Offset = dst;
+				}
+
+				dst++;
+			}
+
+			// base offsets are the prefix sum of the remaining children counts
+			parentLevel.m_subtreeRanges[p] = Range(base, dst - base);
+		}
+
+		Assert(dst == (int)currLevel.m_IDs.size() - currLevel.m_numRemoved, "some of the nodes at level %d weren't placed.", level);
+
+		currLevel.m_IDs.resize(dst);
+		currLevel.m_localTransforms.resize(dst);
+		currLevel.m_toWorlds.resize(dst);
+		currLevel.m_prevToWorlds.resize(dst);
+		currLevel.m_meshIDs.resize(dst);
+		currLevel.m_subtreeRanges.resize(dst);
+		currLevel.m_rtFlags.resize(dst);
+		currLevel.m_handles.resize(dst);
+		currLevel.m_numRemoved = 0;
+	}
+
+	// level 1 always remains, even if it's empty (same as after initialization)
+	while (levels.size() > 2 && levels.back().m_IDs.empty())
+		levels.pop_back();
+}
+
+//--------------------------------------------------------------------------------------
+// WorldTransformUpdater
+//--------------------------------------------------------------------------------------
+
+namespace
+{
+	using VFloat = simd<float, 8>;
+	
+	ZetaInline soa_float3<VFloat> LoadFloat3(float lanes[][VFloat::Width]) noexcept
+	{
+		return soa_float3<VFloat>(VFloat::load(lanes[0]), VFloat::load(lanes[1]), VFloat::load(lanes[2]));
+	}
+
+	ZetaInline soa_float4x3<VFloat> LoadFloat4x3(float lanes[][VFloat::Width]) noexcept
+	{
+		soa_float4x3<VFloat> M;
+		for (int i = 0; i < 4; i++)
+			M.m[i] = LoadFloat3(lanes + i * 3);
+
+		return M;
+	}
+
+	ZetaInline void GatherFloat3(const float3& f, float lanes[][VFloat::Width], int lane) noexcept
+	{
+		lanes[0][lane] = f.x;
+		lanes[1][lane] = f.y;
+		lanes[2][lane] = f.z;
+	}
+
+	ZetaInline void GatherFloat4x3(const float4x3& M, float lanes[][VFloat::Width], int lane) noexcept
+	{
+		for (int i = 0; i < 4; i++)
+			GatherFloat3(M.m[i], lanes + i * 3, lane);
+	}
+}
+
+bool WorldTransformUpdater::BeginUpdate() noexcept
+{
+	m_changedNodes.clear();
+
+	if (m_dirtyNodes.empty())
+		return false;
+
+	std::sort(m_dirtyNodes.begin(), m_dirtyNodes.end(), [](const TreePos& lhs, const TreePos& rhs)
+		{
+			return lhs.Level < rhs.Level || (lhs.Level == rhs.Level && lhs.Offset < rhs.Offset);
+		});
+
+	m_nextDirtyNode = 0;
+	m_dirtyRanges.clear();
+
+	return true;
+}
+
+int WorldTransformUpdater::PrepareLevel(Span<TreeLevel> levels, int level, int maxNumJobs) noexcept
+{
+	const TreeLevel& parentLevel = levels[level - 1];
+
+	// add the nodes at this level whose local transformation changed. Subtree ranges of the
+	// parent level are sorted, so the parent is the last node whose children start at or
+	// before the given node.
+	for (; m_nextDirtyNode < m_dirtyNodes.size() && m_dirtyNodes[m_nextDirtyNode].Level == level; m_nextDirtyNode++)
+	{
+		const int offset = m_dirtyNodes[m_nextDirtyNode].Offset;
+		auto it = std::upper_bound(parentLevel.m_subtreeRanges.begin(), parentLevel.m_subtreeRanges.end(), offset,
+			[](int o, const Range& r)
+			{
+				return o < r.Base;
+			});
+
+		const int parentIdx = (int)(it - parentLevel.m_subtreeRanges.begin()) - 1;
+		Assert(parentIdx >= 0 && offset < parentLevel.m_subtreeRanges[parentIdx].Base + parentLevel.m_subtreeRanges[parentIdx].Count,
+			"parent of node (level %d, offset %d) was not found.", level, offset);
+
+		m_dirtyRanges.push_back(DirtyRange{ .Nodes = Range(offset, 1), .ParentIdx = parentIdx });
+	}
+
+	if (m_dirtyRanges.empty())
+		return 0;
+
+	// ranges that overlap always share the same parent (children of different parents are disjoint),
+	// so after sorting, every node can be visited once by skipping over the already-visited prefix.
+	// Children of the previous level are already sorted, so sorting is only needed when some of the
+	// nodes at this level were marked dirty.
+	auto cmp = [](const DirtyRange& lhs, const DirtyRange& rhs)
+		{
+			return lhs.Nodes.Base < rhs.Nodes.Base;
+		};
+
+	if (!std::is_sorted(m_dirtyRanges.begin(), m_dirtyRanges.end(), cmp))
+		std::sort(m_dirtyRanges.begin(), m_dirtyRanges.end(), cmp);
+
+	int visitedEnd = 0;
+	int numNodes = 0;
+	size_t numRanges = 0;
+
+	for (auto& r : m_dirtyRanges)
+	{
+		const int beg = Math::Max(r.Nodes.Base, visitedEnd);
+		const int end = r.Nodes.Base + r.Nodes.Count;
+
+		if (beg >= end)
+			continue;
+
+		visitedEnd = end;
+		numNodes += end - beg;
+		m_dirtyRanges[numRanges++] = DirtyRange{ .Nodes = Range(beg, end - beg), .ParentIdx = r.ParentIdx };
+	}
+
+	m_dirtyRanges.resize(numRanges);
+
+	// split the nodes evenly between the jobs
+	const int numJobs = Math::Max(Math::Min(numNodes / MIN_NODES_PER_JOB, Math::Min(maxNumJobs, MAX_NUM_JOBS)), 1);
+	const int nodesPerJob = (numNodes + numJobs - 1) / numJobs;
+	int currJob = 0;
+	int currJobSize = 0;
+
+	m_jobRanges.clear();
+	m_jobs[0].FirstRange = 0;
+
+	for (auto& r : m_dirtyRanges)
+	{
+		int base = r.Nodes.Base;
+		int remaining = r.Nodes.Count;
+
+		while (remaining > 0)
+		{
+			const int n = Math::Min(remaining, nodesPerJob - currJobSize);
+			m_jobRanges.push_back(DirtyRange{ .Nodes = Range(base, n), .ParentIdx = r.ParentIdx });
+
+			base += n;
+			remaining -= n;
+			currJobSize += n;
+
+			if (currJobSize == nodesPerJob && currJob < numJobs - 1)
+			{
+				m_jobs[currJob].NumRanges = (int)m_jobRanges.size() - m_jobs[currJob].FirstRange;
+				m_jobs[++currJob].FirstRange = (int)m_jobRanges.size();
+				currJobSize = 0;
+			}
+		}
+	}
+
+	m_jobs[currJob].NumRanges = (int)m_jobRanges.size() - m_jobs[currJob].FirstRange;
+	m_dirtyRanges.clear();
+
+	return currJob + 1;
+}
+
+void WorldTransformUpdater::ProcessJob(Span<TreeLevel> levels, int level, int jobIdx) noexcept
+{
+	constexpr int W = VFloat::Width;
+	const TreeLevel& parentLevel = levels[level - 1];
+	TreeLevel& currLevel = levels[level];
+	Job& job = m_jobs[jobIdx];
+
+	// first job appends directly to the final lists, so when there's only one job, nothing needs 
+	// to be copied
+	auto& changedNodes = jobIdx == 0 ? m_changedNodes : job.ChangedNodes;
+	auto& nextRanges = jobIdx == 0 ? m_dirtyRanges : job.NextRanges;
+
+	job.ChangedNodes.clear();
+	job.NextRanges.clear();
+
+	int offsets[W];
+	int parents[W];
+
+	// W nodes are updated at a time, each lane could have a different parent
+	auto updateBatch = [&](int n)
+		{
+			alignas(32) float scale[3][W];
+			alignas(32) float rotation[4][W];
+			alignas(32) float translation[3][W];
+			alignas(32) float parentW[12][W];
+			alignas(32) float prevW[12][W];
+
+			for (int i = 0; i < W; i++)
+			{
+				// unused lanes repeat the first node
+				const int k = i < n ? i : 0;
+				const AffineTransformation& tr = currLevel.m_localTransforms[offsets[k]];
+
+				GatherFloat3(tr.Scale, scale, i);
+				rotation[0][i] = tr.Rotation.x;
+				rotation[1][i] = tr.Rotation.y;
+				rotation[2][i] = tr.Rotation.z;
+				rotation[3][i] = tr.Rotation.w;
+				GatherFloat3(tr.Translation, translation, i);
+				GatherFloat4x3(parentLevel.m_toWorlds[parents[k]], parentW, i);
+				GatherFloat4x3(currLevel.m_toWorlds[offsets[k]], prevW, i);
+			}
+
+			const soa_float4<VFloat> vQ{ VFloat::load(rotation[0]), VFloat::load(rotation[1]), 
+				VFloat::load(rotation[2]), VFloat::load(rotation[3]) };
+			const soa_float4x3<VFloat> vLocal = affineTransformation(LoadFloat3(scale), vQ, LoadFloat3(translation));
+			const soa_float4x3<VFloat> vNewW = mul(vLocal, LoadFloat4x3(parentW));
+
+			// descendants only need to be visited if the node actually moved
+			const uint32_t unchanged = movemask(equal(vNewW, LoadFloat4x3(prevW)));
+			if ((unchanged & ((1u << n) - 1)) == ((1u << n) - 1))
+				return;
+
+			alignas(32) float newW[12][W];
+			for (int i = 0; i < 4; i++)
+			{
+				vNewW.m[i].x.store(newW[i * 3]);
+				vNewW.m[i].y.store(newW[i * 3 + 1]);
+				vNewW.m[i].z.store(newW[i * 3 + 2]);
+			}
+
+			for (int i = 0; i < n; i++)
+			{
+				if (unchanged & (1u << i))
+					continue;
+
+				const int j = offsets[i];
+				changedNodes.push_back(ChangedNode{ .PrevW = currLevel.m_toWorlds[j], .Pos = TreePos{ .Level = level, .Offset = j } });
+
+				float4x3& w = currLevel.m_toWorlds[j];
+				for (int r = 0; r < 4; r++)
+					w.m[r] = float3(newW[r * 3][i], newW[r * 3 + 1][i], newW[r * 3 + 2][i]);
+
+				const Range& children = currLevel.m_subtreeRanges[j];
+				if (children.Count)
+					nextRanges.push_back(DirtyRange{ .Nodes = children, .ParentIdx = j });
+			}
+		};
+
+	int n = 0;
+
+	for (int r = job.FirstRange; r < job.FirstRange + job.NumRanges; r++)
+	{
+		const DirtyRange& range = m_jobRanges[r];
+
+		for (int j = range.Nodes.Base; j < range.Nodes.Base + range.Nodes.Count; j++)
+		{
+			offsets[n] = j;
+			parents[n] = range.ParentIdx;
+
+			if (++n == W)
+			{
+				updateBatch(n);
+				n = 0;
+			}
+		}
+	}
+
+	if (n)
+		updateBatch(n);
+}
+
+void WorldTransformUpdater::FinishLevel(int numJobs) noexcept
+{
+	// jobs cover consecutive nodes, so concatenating the outputs in job order keeps them sorted
+	for (int i = 1; i < numJobs; i++)
+	{
+		m_changedNodes.append_range(m_jobs[i].ChangedNodes.begin(), m_jobs[i].ChangedNodes.end());
+		m_dirtyRanges.append_range(m_jobs[i].NextRanges.begin(), m_jobs[i].NextRanges.end());
+	}
+}
+
+void WorldTransformUpdater::EndUpdate() noexcept
+{
+	m_dirtyNodes.clear();
+	m_dirtyRanges.clear();
+	m_jobRanges.clear();
+}
+
+void WorldTransformUpdater::Clear() noexcept
+{
+	m_dirtyNodes.free_memory();
+	m_dirtyRanges.free_memory();
+	m_jobRanges.free_memory();
+	m_changedNodes.free_memory();
+
+	for (int i = 0; i < MAX_NUM_JOBS; i++)
+	{
+		m_jobs[i].ChangedNodes.free_memory();
+		m_jobs[i].NextRanges.free_memory();
+	}
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#include "../Math/Matrix.h"
+#include "../Support/MemoryPool.h"
+#include "../Support/Executor.h"
+#include "../Utility/HashTable.h"
+#include "../Utility/SmallVector.h"
+#include "../Utility/Span.h"
+
+namespace ZetaRay::Scene
+{
+	//--------------------------------------------------------------------------------------
+	// Scene graph is stored level by level. Children of every node are stored contiguously
+	// in the next level and each node keeps track of where its children start and how many
+	// there are (its "subtree range").
+	//--------------------------------------------------------------------------------------
+
+	struct TreePos
+	{
+		int Level;
+		int Offset;
+	};
+
+	struct Range
+	{
+		Range() noexcept = default;
+		Range(int b, int c) noexcept
+			: Base(b),
+			Count(c)
+		{}
+
+		int Base;
+		int Count;
+	};
+
+	struct TreeLevel
+	{
+		TreeLevel(Support::MemoryPool& mp) noexcept
+			: m_IDs(mp),
+			m_localTransforms(mp),
+			m_toWorlds(mp),
+			m_prevToWorlds(mp),
+			m_meshIDs(mp),
+			m_subtreeRanges(mp),
+			m_rtFlags(mp),
+			m_handles(mp)
+		{}
+
+		Util::SmallVector<uint64_t, Support::PoolAllocator> m_IDs;
+		Util::SmallVector<Math::AffineTransformation, Support::PoolAllocator> m_localTransforms;
+		Util::SmallVector<Math::float4x3, Support::PoolAllocator> m_toWorlds;
+		// world transformation before the last update (same as m_toWorlds for nodes that didn't move)
+		Util::SmallVector<Math::float4x3, Support::PoolAllocator> m_prevToWorlds;
+		Util::SmallVector<uint64_t, Support::PoolAllocator> m_meshIDs;
+		Util::SmallVector<Range, Support::PoolAllocator> m_subtreeRanges;
+		// first six bits encode MeshInstanceFlags, last two bits indicate RT_MESH_MODE
+		Util::SmallVector<uint8_t, Support::PoolAllocator> m_rtFlags;
+		// index of every node's slot in NodeHandleTable. Nodes that were removed, but haven't been 
+		// compacted away yet are set to NodeHandle::INVALID_INDEX.
+		Util::SmallVector<uint32_t, Support::PoolAllocator> m_handles;
+		int m_numRemoved = 0;
+	};
+
+	//--------------------------------------------------------------------------------------
+	// Node handles
+	//--------------------------------------------------------------------------------------
+
+	// Tree positions change whenever nodes are inserted or removed. A handle refers to the same node
+	// until it's removed, at which point the generation of its slot is incremented so that stale
+	// copies of the handle can be detected.
+	struct NodeHandle
+	{
+		static constexpr uint32_t INVALID_INDEX = uint32_t(-1);
+
+		uint32_t Index = INVALID_INDEX;
+		uint32_t Generation = 0;
+	};
+
+	class NodeHandleTable
+	{
+	public:
+		NodeHandleTable() noexcept = default;
+		~NodeHandleTable() noexcept = default;
+
+		NodeHandleTable(const NodeHandleTable&) = delete;
+		NodeHandleTable& operator=(const NodeHandleTable&) = delete;
+
+		NodeHandle Allocate(TreePos pos) noexcept;
+		// Slot is reused by later allocations
+		void Free(NodeHandle h) noexcept;
+
+		// Returns NULL if the node that h referred to was removed
+		ZetaInline TreePos* Find(NodeHandle h) noexcept
+		{
+			if (h.Index >= m_slots.size() || m_slots[h.Index].Generation != h.Generation)
+				return nullptr;
+
+			return &m_slots[h.Index].Pos;
+		}
+
+		// Scene graph keeps track of which slot belongs to which node, so lookups from there skip
+		// the generation check
+		ZetaInline TreePos& Pos(uint32_t index) noexcept
+		{
+			Assert(index < m_slots.size(), "invalid index.");
+			return m_slots[index].Pos;
+		}
+
+		ZetaInline NodeHandle Handle(uint32_t index) const noexcept
+		{
+			Assert(index < m_slots.size(), "invalid index.");
+			return NodeHandle{ .Index = index, .Generation = m_slots[index].Generation };
+		}
+
+		ZetaInline size_t size() const noexcept { return m_numLive; }
+		void Clear() noexcept;
+
+	private:
+		struct Slot
+		{
+			TreePos Pos;
+			uint32_t Generation;
+			// next slot in the free list (only for free slots)
+			uint32_t NextFree;
+		};
+
+		Util::SmallVector<Slot> m_slots;
+		uint32_t m_freeListHead = NodeHandle::INVALID_INDEX;
+		uint32_t m_numLive = 0;
+	};
+
+	//--------------------------------------------------------------------------------------
+	// Insertion
+	//--------------------------------------------------------------------------------------
+
+	struct NewNode
+	{
+		Math::AffineTransformation LocalTransform;
+		uint64_t ID;
+		uint64_t ParentID;
+		uint64_t MeshID;
+		uint8_t RtFlags;
+	};
+
+	// Inserts a batch of nodes into the scene graph. Every parent must either already be in the scene 
+	// graph (rootID refers to the node at level 0) or come before its children in the batch. New children
+	// are placed after the existing children of their parent in batch order, i.e. same as inserting them 
+	// one at a time. A handle is allocated for every new node and added to idToHandle. Tree positions of
+	// the new nodes and every existing node that was shifted are updated in handles.
+	//
+	// New nodes are bucketed by level and then by parent. Every affected level is then rebuilt in one
+	// (backward) pass with subtree ranges of the parent level given by prefix sums, so the cost is 
+	// O(k + n) rather than O(k * n) for k new nodes and n existing nodes in the affected levels.
+	void InsertNodes(Util::SmallVector<TreeLevel, Support::PoolAllocator>& levels, Support::MemoryPool& mp, 
+		Util::Span<NewNode> nodes, uint64_t rootID, Util::HashTable<NodeHandle>& idToHandle, 
+		NodeHandleTable& handles) noexcept;
+
+	//--------------------------------------------------------------------------------------
+	// Removal
+	//--------------------------------------------------------------------------------------
+
+	// Marks the given nodes along with all of their descendants as removed and frees their handles 
+	// (stale handles are skipped). Nothing is moved, so the cost is proportional to the number of 
+	// removed nodes and tree positions stay valid until the next call to CompactNodes(). Positions of 
+	// the removed nodes are appended to removed, which can be used to read their data up until then.
+	void RemoveNodes(Util::Span<TreeLevel> levels, Util::Span<NodeHandle> nodes, NodeHandleTable& handles,
+		Util::SmallVector<TreePos>& removed) noexcept;
+
+	// Closes the gaps left behind by the removed nodes. Levels are visited top to bottom and subtree 
+	// ranges of the parent level are given by the prefix sums of the remaining children (the mirror 
+	// image of InsertNodes()). Levels without removed nodes are skipped, so the cost is O(n) in the 
+	// size of the affected levels. Tree positions of the moved nodes are updated in handles and empty
+	// levels at the bottom are released.
+	void CompactNodes(Util::SmallVector<TreeLevel, Support::PoolAllocator>& levels, NodeHandleTable& handles) noexcept;
+
+	//--------------------------------------------------------------------------------------
+	// WorldTransformUpdater
+	//--------------------------------------------------------------------------------------
+
+	// Recomputes the world transformations of the nodes whose local transformation changed along
+	// with their descendants, level by level. Subtrees where nothing changed are never visited, so
+	// the cost is proportional to the number of changed nodes rather than the size of the scene.
+	//
+	// Levels have to be processed in order, but nodes of the same level are independent of each 
+	// other, so every level can be split into jobs that run in parallel. Each job writes to its own
+	// output lists, which are merged (in job order) after the level is done.
+	class WorldTransformUpdater
+	{
+	public:
+		static constexpr int MAX_NUM_JOBS = 16;
+		// levels with fewer dirty nodes than this aren't worth splitting
+		static constexpr int MIN_NODES_PER_JOB = 1024;
+
+		struct ChangedNode
+		{
+			// world transformation before the update
+			Math::float4x3 PrevW;
+			TreePos Pos;
+		};
+
+		WorldTransformUpdater() noexcept = default;
+		~WorldTransformUpdater() noexcept = default;
+
+		WorldTransformUpdater(const WorldTransformUpdater&) = delete;
+		WorldTransformUpdater& operator=(const WorldTransformUpdater&) = delete;
+
+		// Marks the local transformation of the given node as changed. Node positions must remain
+		// valid until the next call to Update().
+		ZetaInline void MarkDirty(TreePos pos) noexcept { m_dirtyNodes.push_back(pos); }
+		ZetaInline bool HasDirtyNodes() const noexcept { return !m_dirtyNodes.empty(); }
+
+		// Updates the world transformation of every dirty node and its descendants. Returns the nodes
+		// whose world transformation actually changed (sorted by level and then offset); returned
+		// span is valid until the next call to Update().
+		Util::Span<ChangedNode> Update(Util::Span<TreeLevel> levels) noexcept
+		{
+			return Update(levels, Support::SerialExecutor());
+		}
+
+		// Same as above, but every level below the root is a stage of the given executor (see 
+		// Support/Executor.h) with its nodes split between the jobs
+		template<typename Executor>
+		Util::Span<ChangedNode> Update(Util::Span<TreeLevel> levels, Executor&& executor) noexcept
+		{
+			if (!BeginUpdate())
+				return m_changedNodes;
+
+			const int maxNumJobs = executor.MaxNumJobs();
+			int numJobs = 0;
+
+			// outputs of each level are merged right before the next one is prepared
+			executor.Stages((int)levels.size() - 1,
+				[this, levels, maxNumJobs, &numJobs](int stage)
+				{
+					FinishLevel(numJobs);
+					numJobs = PrepareLevel(levels, stage + 1, maxNumJobs);
+
+					return numJobs;
+				},
+				[this, levels](int stage, int jobIdx)
+				{
+					ProcessJob(levels, stage + 1, jobIdx);
+				});
+
+			FinishLevel(numJobs);
+			EndUpdate();
+
+			return m_changedNodes;
+		}
+
+		void Clear() noexcept;
+
+	private:
+		// a range of nodes that need to be recomputed along with their (shared) parent
+		struct DirtyRange
+		{
+			Range Nodes;
+			int ParentIdx;
+		};
+
+		struct Job
+		{
+			// subset of m_jobRanges
+			int FirstRange;
+			int NumRanges;
+			Util::SmallVector<ChangedNode> ChangedNodes;
+			Util::SmallVector<DirtyRange> NextRanges;
+		};
+
+		bool BeginUpdate() noexcept;
+		// Returns the number of jobs for the given level
+		int PrepareLevel(Util::Span<TreeLevel> levels, int level, int maxNumJobs) noexcept;
+		void ProcessJob(Util::Span<TreeLevel> levels, int level, int jobIdx) noexcept;
+		void FinishLevel(int numJobs) noexcept;
+		void EndUpdate() noexcept;
+
+		Util::SmallVector<TreePos> m_dirtyNodes;
+		size_t m_nextDirtyNode = 0;
+		// dirty ranges for the current level
+		Util::SmallVector<DirtyRange> m_dirtyRanges;
+		// dirty ranges of the current level after removing the overlaps and splitting them between jobs
+		Util::SmallVector<DirtyRange> m_jobRanges;
+		Job m_jobs[MAX_NUM_JOBS];
+		Util::SmallVector<ChangedNode> m_changedNodes;
+	};
+}
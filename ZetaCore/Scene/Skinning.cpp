@@ -0,0 +1,451 @@
+#include "Skinning.h"
+#include "../Math/BatchFuncs.h"
+#include "../Math/MatrixFuncs.h"
+#include "../Math/Common.h"
+#include "../Utility/Error.h"
+
+using namespace ZetaRay;
+using namespace ZetaRay::Scene;
+using namespace ZetaRay::Core;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::Math;
+
+namespace
+{
+	using VFloat = simd<float, 8>;
+
+	// Inputs for skinning a batch of vertices in SoA layout. As with animations, batches span several
+	// SIMD groups, so that the scalar stores that filled a group have retired by the time it's loaded.
+	// Every palette entry takes NumJointComponents floats.
+	template<int NumJointComponents>
+	struct Batch
+	{
+		static constexpr int NUM_VERTEX_COMPONENTS = 9;
+		static constexpr int SIZE = VFloat::Width * 8;
+
+		// position (xyz), normal (xyz), tangent (xyz)
+		alignas(32) float Vertex[NUM_VERTEX_COMPONENTS][SIZE];
+		alignas(32) float Weights[SkinInfluence::MAX_NUM_INFLUENCES][SIZE];
+		// palette entry of every influence
+		alignas(32) float Joints[SkinInfluence::MAX_NUM_INFLUENCES][NumJointComponents][SIZE];
+	};
+
+	// first component of every vertex attribute in Batch::Vertex
+	constexpr int POSITION_COMPONENT = 0;
+	constexpr int NORMAL_COMPONENT = 3;
+	constexpr int TANGENT_COMPONENT = 6;
+
+	// linear part (row by row) followed by translation
+	constexpr int NUM_MATRIX_COMPONENTS = 12;
+	// real (xyzw), dual (xyzw), scale (xyz)
+	constexpr int NUM_DUAL_QUAT_COMPONENTS = 11;
+
+	template<int SIZE>
+	ZetaInline void GatherFloat3(const float3& f, float lanes[][SIZE], int lane) noexcept
+	{
+		lanes[0][lane] = f.x;
+		lanes[1][lane] = f.y;
+		lanes[2][lane] = f.z;
+	}
+
+	template<int SIZE>
+	ZetaInline void GatherFloat4(const float4& f, float lanes[][SIZE], int lane) noexcept
+	{
+		lanes[0][lane] = f.x;
+		lanes[1][lane] = f.y;
+		lanes[2][lane] = f.z;
+		lanes[3][lane] = f.w;
+	}
+
+	template<int SIZE>
+	ZetaInline soa_float3<VFloat> LoadFloat3(float lanes[][SIZE], int lane) noexcept
+	{
+		return soa_float3<VFloat>(VFloat::load(lanes[0] + lane), VFloat::load(lanes[1] + lane),
+			VFloat::load(lanes[2] + lane));
+	}
+
+	template<int SIZE>
+	ZetaInline soa_float4<VFloat> LoadFloat4(float lanes[][SIZE], int lane) noexcept
+	{
+		return soa_float4<VFloat>{ VFloat::load(lanes[0] + lane), VFloat::load(lanes[1] + lane),
+			VFloat::load(lanes[2] + lane), VFloat::load(lanes[3] + lane) };
+	}
+
+	template<int SIZE>
+	ZetaInline void StoreFloat3(const soa_float3<VFloat>& v, float lanes[][SIZE], int lane) noexcept
+	{
+		v.x.store(lanes[0] + lane);
+		v.y.store(lanes[1] + lane);
+		v.z.store(lanes[2] + lane);
+	}
+
+	ZetaInline void GatherJoint(const float4x3& M, float lanes[][Batch<NUM_MATRIX_COMPONENTS>::SIZE], int lane) noexcept
+	{
+		for (int i = 0; i < 4; i++)
+			GatherFloat3(M.m[i], lanes + i * 3, lane);
+	}
+
+	ZetaInline void GatherJoint(const DualQuaternion& dq, float lanes[][Batch<NUM_DUAL_QUAT_COMPONENTS>::SIZE], int lane) noexcept
+	{
+		GatherFloat4(dq.Real, lanes, lane);
+		GatherFloat4(dq.Dual, lanes + 4, lane);
+		GatherFloat3(dq.Scale, lanes + 8, lane);
+	}
+
+	// Gathers the vertices, weights and palette entries of the batch that starts at vertex base. Unused lanes
+	// of the last group skin a zero vertex with the first joint.
+	template<typename Joint, int NumJointComponents>
+	void GatherBatch(Span<Vertex> vertices, Span<SkinInfluence> influences, Span<Joint> palette, size_t base,
+		int batchSize, int numLanes, Batch<NumJointComponents>& batch) noexcept
+	{
+		for (int lane = 0; lane < batchSize; lane++)
+		{
+			const Vertex& v = vertices[base + lane];
+			const SkinInfluence& s = influences[base + lane];
+
+			GatherFloat3(v.Position, batch.Vertex + POSITION_COMPONENT, lane);
+			GatherFloat3(float3(v.Normal), batch.Vertex + NORMAL_COMPONENT, lane);
+			GatherFloat3(float3(v.Tangent), batch.Vertex + TANGENT_COMPONENT, lane);
+
+			for (int k = 0; k < SkinInfluence::MAX_NUM_INFLUENCES; k++)
+			{
+				Assert(s.Joints[k] < palette.size(), "joint index is out of bounds.");
+				batch.Weights[k][lane] = s.Weights[k];
+				GatherJoint(palette[s.Joints[k]], batch.Joints[k], lane);
+			}
+		}
+
+		for (int lane = batchSize; lane < numLanes; lane++)
+		{
+			for (int c = 0; c < Batch<NumJointComponents>::NUM_VERTEX_COMPONENTS; c++)
+				batch.Vertex[c][lane] = 0.0f;
+
+			for (int k = 0; k < SkinInfluence::MAX_NUM_INFLUENCES; k++)
+			{
+				batch.Weights[k][lane] = k == 0 ? 1.0f : 0.0f;
+				GatherJoint(palette[0], batch.Joints[k], lane);
+			}
+		}
+	}
+
+	template<int NumJointComponents>
+	void ScatterBatch(const Batch<NumJointComponents>& batch, Span<Vertex> vertices, Span<Vertex> out, size_t base,
+		int batchSize) noexcept
+	{
+		const auto& c = batch.Vertex;
+
+		for (int lane = 0; lane < batchSize; lane++)
+		{
+			Vertex& v = out[base + lane];
+			v.Position = float3(c[0][lane], c[1][lane], c[2][lane]);
+			v.Normal = half3(float3(c[3][lane], c[4][lane], c[5][lane]));
+			v.TexUV = vertices[base + lane].TexUV;
+			v.Tangent = half3(float3(c[6][lane], c[7][lane], c[8][lane]));
+		}
+	}
+
+	// Zero vectors (e.g. missing tangents) remain zero
+	ZetaInline soa_float3<VFloat> NormalizeOrZero(const soa_float3<VFloat>& v) noexcept
+	{
+		const VFloat vLengthSq = dot(v, v);
+		const VFloat vInvLength = select(vLengthSq > VFloat(0.0f), VFloat(1.0f) / sqrt(vLengthSq), VFloat(0.0f));
+
+		return soa_float3<VFloat>(v.x * vInvLength, v.y * vInvLength, v.z * vInvLength);
+	}
+
+	// Rotates v by the unit quaternion q: v + 2 * q.xyz x (q.xyz x v + q.w * v)
+	ZetaInline soa_float3<VFloat> Rotate(const soa_float4<VFloat>& q, const soa_float3<VFloat>& v) noexcept
+	{
+		const soa_float3<VFloat> vQ(q.x, q.y, q.z);
+		soa_float3<VFloat> vT = cross(vQ, v);
+		vT = soa_float3<VFloat>(fmadd(q.w, v.x, vT.x), fmadd(q.w, v.y, vT.y), fmadd(q.w, v.z, vT.z));
+		vT = cross(vQ, vT);
+
+		const VFloat v2(2.0f);
+		return soa_float3<VFloat>(fmadd(v2, vT.x, v.x), fmadd(v2, vT.y, v.y), fmadd(v2, vT.z, v.z));
+	}
+
+	void LinearBlendBatch(Batch<NUM_MATRIX_COMPONENTS>& batch, int numLanes) noexcept
+	{
+		for (int lane = 0; lane < numLanes; lane += VFloat::Width)
+		{
+			// weighted sum of the skinning matrices
+			soa_float4x3<VFloat> M;
+
+			for (int k = 0; k < SkinInfluence::MAX_NUM_INFLUENCES; k++)
+			{
+				const VFloat vW = VFloat::load(batch.Weights[k] + lane);
+
+				for (int i = 0; i < 4; i++)
+				{
+					const soa_float3<VFloat> vRow = LoadFloat3(batch.Joints[k] + i * 3, lane);
+
+					if (k == 0)
+						M.m[i] = soa_float3<VFloat>(vW * vRow.x, vW * vRow.y, vW * vRow.z);
+					else
+					{
+						M.m[i] = soa_float3<VFloat>(fmadd(vW, vRow.x, M.m[i].x), fmadd(vW, vRow.y, M.m[i].y),
+							fmadd(vW, vRow.z, M.m[i].z));
+					}
+				}
+			}
+
+			// normals are transformed with the inverse transpose of M, which is its cofactor matrix 
+			// divided by the determinant. Only the sign of the latter matters after normalization.
+			soa_float4x3<VFloat> C;
+			C.m[0] = cross(M.m[1], M.m[2]);
+			C.m[1] = cross(M.m[2], M.m[0]);
+			C.m[2] = cross(M.m[0], M.m[1]);
+			const auto vIsMirrored = dot(M.m[0], C.m[0]) < VFloat(0.0f);
+
+			soa_float3<VFloat> vN = LoadFloat3(batch.Vertex + NORMAL_COMPONENT, lane);
+			vN = soa_float3<VFloat>(select(vIsMirrored, -vN.x, vN.x), select(vIsMirrored, -vN.y, vN.y),
+				select(vIsMirrored, -vN.z, vN.z));
+
+			const soa_float3<VFloat> vPos = mul(M, LoadFloat3(batch.Vertex + POSITION_COMPONENT, lane));
+			const soa_float3<VFloat> vNormal = NormalizeOrZero(mul3x3(C, vN));
+			const soa_float3<VFloat> vTangent = NormalizeOrZero(mul3x3(M, LoadFloat3(batch.Vertex + TANGENT_COMPONENT, lane)));
+
+			StoreFloat3(vPos, batch.Vertex + POSITION_COMPONENT, lane);
+			StoreFloat3(vNormal, batch.Vertex + NORMAL_COMPONENT, lane);
+			StoreFloat3(vTangent, batch.Vertex + TANGENT_COMPONENT, lane);
+		}
+	}
+
+	void DualQuaternionBatch(Batch<NUM_DUAL_QUAT_COMPONENTS>& batch, int numLanes) noexcept
+	{
+		const VFloat vZero(0.0f);
+
+		for (int lane = 0; lane < numLanes; lane += VFloat::Width)
+		{
+			const soa_float4<VFloat> vReal0 = LoadFloat4(batch.Joints[0], lane);
+			soa_float4<VFloat> vReal{ vZero, vZero, vZero, vZero };
+			soa_float4<VFloat> vDual{ vZero, vZero, vZero, vZero };
+			soa_float3<VFloat> vScale(vZero, vZero, vZero);
+
+			for (int k = 0; k < SkinInfluence::MAX_NUM_INFLUENCES; k++)
+			{
+				const VFloat vW = VFloat::load(batch.Weights[k] + lane);
+				const soa_float4<VFloat> vR = LoadFloat4(batch.Joints[k], lane);
+				const soa_float4<VFloat> vD = LoadFloat4(batch.Joints[k] + 4, lane);
+				const soa_float3<VFloat> vS = LoadFloat3(batch.Joints[k] + 8, lane);
+
+				// q and -q represent the same rotation, blend the ones on the same hemisphere as the first
+				const VFloat vSignedW = select(dot(vReal0, vR) >= vZero, vW, -vW);
+
+				vReal.x = fmadd(vSignedW, vR.x, vReal.x);
+				vReal.y = fmadd(vSignedW, vR.y, vReal.y);
+				vReal.z = fmadd(vSignedW, vR.z, vReal.z);
+				vReal.w = fmadd(vSignedW, vR.w, vReal.w);
+				vDual.x = fmadd(vSignedW, vD.x, vDual.x);
+				vDual.y = fmadd(vSignedW, vD.y, vDual.y);
+				vDual.z = fmadd(vSignedW, vD.z, vDual.z);
+				vDual.w = fmadd(vSignedW, vD.w, vDual.w);
+				vScale = soa_float3<VFloat>(fmadd(vW, vS.x, vScale.x), fmadd(vW, vS.y, vScale.y), fmadd(vW, vS.z, vScale.z));
+			}
+
+			// normalize the blended dual quaternion
+			const VFloat vInvLength = VFloat(1.0f) / sqrt(dot(vReal, vReal));
+			vReal = soa_float4<VFloat>{ vReal.x * vInvLength, vReal.y * vInvLength, vReal.z * vInvLength, vReal.w * vInvLength };
+			vDual = soa_float4<VFloat>{ vDual.x * vInvLength, vDual.y * vInvLength, vDual.z * vInvLength, vDual.w * vInvLength };
+
+			// translation = 2 * (Dual * conjugate(Real)).xyz
+			const soa_float3<VFloat> vRealXYZ(vReal.x, vReal.y, vReal.z);
+			const soa_float3<VFloat> vDualXYZ(vDual.x, vDual.y, vDual.z);
+			const soa_float3<VFloat> vC = cross(vRealXYZ, vDualXYZ);
+			const VFloat v2(2.0f);
+			const soa_float3<VFloat> vT(
+				v2 * (fmadd(vReal.w, vDual.x, vC.x) - vDual.w * vReal.x),
+				v2 * (fmadd(vReal.w, vDual.y, vC.y) - vDual.w * vReal.y),
+				v2 * (fmadd(vReal.w, vDual.z, vC.z) - vDual.w * vReal.z));
+
+			// scale comes first. Normals are scaled by its inverse, tangents like positions.
+			const soa_float3<VFloat> vP = LoadFloat3(batch.Vertex + POSITION_COMPONENT, lane);
+			const soa_float3<VFloat> vN = LoadFloat3(batch.Vertex + NORMAL_COMPONENT, lane);
+			const soa_float3<VFloat> vTan = LoadFloat3(batch.Vertex + TANGENT_COMPONENT, lane);
+
+			soa_float3<VFloat> vPos = Rotate(vReal, soa_float3<VFloat>(vP.x * vScale.x, vP.y * vScale.y, vP.z * vScale.z));
+			vPos = soa_float3<VFloat>(vPos.x + vT.x, vPos.y + vT.y, vPos.z + vT.z);
+			const soa_float3<VFloat> vNormal = NormalizeOrZero(Rotate(vReal,
+				soa_float3<VFloat>(vN.x / vScale.x, vN.y / vScale.y, vN.z / vScale.z)));
+			const soa_float3<VFloat> vTangent = NormalizeOrZero(Rotate(vReal,
+				soa_float3<VFloat>(vTan.x * vScale.x, vTan.y * vScale.y, vTan.z * vScale.z)));
+
+			StoreFloat3(vPos, batch.Vertex + POSITION_COMPONENT, lane);
+			StoreFloat3(vNormal, batch.Vertex + NORMAL_COMPONENT, lane);
+			StoreFloat3(vTangent, batch.Vertex + TANGENT_COMPONENT, lane);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Skinning
+//--------------------------------------------------------------------------------------
+
+void Scene::EvaluatePose(const Skeleton& skeleton, Span<AffineTransformation> localPose, Span<float4x3> palette) noexcept
+{
+	const size_t numJoints = skeleton.Parents.size();
+	Assert(skeleton.InverseBindMatrices.size() == numJoints, "every joint must have an inverse bind matrix.");
+	Assert(localPose.size() >= numJoints && palette.size() >= numJoints, "invalid number of joints.");
+
+	// transformation of every joint relative to the root. Parents come before their children, so
+	// their transformation is already computed by the time it's needed.
+	for (size_t i = 0; i < numJoints; i++)
+	{
+		AffineTransformation& tr = localPose[i];
+		v_float4x4 vM = affineTransformation(tr.Scale, tr.Rotation, tr.Translation);
+
+		const int parent = skeleton.Parents[i];
+		Assert(parent < (int)i, "parents must come before their children.");
+
+		if (parent != -1)
+			vM = mul(vM, load(palette[parent]));
+
+		palette[i] = float4x3(store(vM));
+	}
+
+	for (size_t i = 0; i < numJoints; i++)
+	{
+		const v_float4x4 vM = mul(load(skeleton.InverseBindMatrices[i]), load(palette[i]));
+		palette[i] = float4x3(store(vM));
+	}
+}
+
+DualQuaternion Scene::ToDualQuaternion(const float4x3& M) noexcept
+{
+	float4a s;
+	float4a r;
+	float4a t;
+	decomposeSRT(load(M), s, r, t);
+
+	// Dual = 0.5 * (t, 0) * Real
+	float3 vT(t.x, t.y, t.z);
+	float3 vQ(r.x, r.y, r.z);
+	const float3 vC = vT.cross(vQ);
+
+	DualQuaternion dq;
+	dq.Real = float4(r.x, r.y, r.z, r.w);
+	dq.Dual = float4(0.5f * (r.w * vT.x + vC.x),
+		0.5f * (r.w * vT.y + vC.y),
+		0.5f * (r.w * vT.z + vC.z),
+		-0.5f * vQ.dot(vT));
+	dq.Scale = float3(s.x, s.y, s.z);
+
+	return dq;
+}
+
+void Scene::SkinLinearBlend(Span<Vertex> vertices, Span<SkinInfluence> influences, Span<float4x3> palette,
+	Span<Vertex> out) noexcept
+{
+	Assert(influences.size() == vertices.size() && out.size() >= vertices.size(), "invalid arguments.");
+	Assert(!palette.empty(), "palette is empty.");
+	Batch<NUM_MATRIX_COMPONENTS> batch;
+	const size_t n = vertices.size();
+
+	for (size_t base = 0; base < n; base += Batch<NUM_MATRIX_COMPONENTS>::SIZE)
+	{
+		const int batchSize = (int)Math::Min<size_t>(Batch<NUM_MATRIX_COMPONENTS>::SIZE, n - base);
+		const int numLanes = (int)Math::AlignUp(batchSize, VFloat::Width);
+
+		GatherBatch(vertices, influences, palette, base, batchSize, numLanes, batch);
+		LinearBlendBatch(batch, numLanes);
+		ScatterBatch(batch, vertices, out, base, batchSize);
+	}
+}
+
+void Scene::SkinDualQuaternion(Span<Vertex> vertices, Span<SkinInfluence> influences, Span<DualQuaternion> palette,
+	Span<Vertex> out) noexcept
+{
+	Assert(influences.size() == vertices.size() && out.size() >= vertices.size(), "invalid arguments.");
+	Assert(!palette.empty(), "palette is empty.");
+	Batch<NUM_DUAL_QUAT_COMPONENTS> batch;
+	const size_t n = vertices.size();
+
+	for (size_t base = 0; base < n; base += Batch<NUM_DUAL_QUAT_COMPONENTS>::SIZE)
+	{
+		const int batchSize = (int)Math::Min<size_t>(Batch<NUM_DUAL_QUAT_COMPONENTS>::SIZE, n - base);
+		const int numLanes = (int)Math::AlignUp(batchSize, VFloat::Width);
+
+		GatherBatch(vertices, influences, palette, base, batchSize, numLanes, batch);
+		DualQuaternionBatch(batch, numLanes);
+		ScatterBatch(batch, vertices, out, base, batchSize);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// MeshSkinner
+//--------------------------------------------------------------------------------------
+
+int MeshSkinner::Prepare(Span<Mesh> meshes, SKINNING_METHOD method, int maxNumJobs) noexcept
+{
+	if (meshes.empty())
+		return 0;
+
+	if (method == SKINNING_METHOD::DUAL_QUATERNION)
+	{
+		m_dualQuats.clear();
+		m_dualQuatOffsets.resize(meshes.size());
+
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			// consecutive meshes with the same palette (e.g. primitives of the same glTF mesh) share it
+			if (i > 0 && meshes[i].Palette == meshes[i - 1].Palette)
+			{
+				m_dualQuatOffsets[i] = m_dualQuatOffsets[i - 1];
+				continue;
+			}
+
+			m_dualQuatOffsets[i] = (uint32_t)m_dualQuats.size();
+
+			for (uint32_t j = 0; j < meshes[i].NumJoints; j++)
+				m_dualQuats.push_back(ToDualQuaternion(meshes[i].Palette[j]));
+		}
+	}
+
+	size_t numVertices = 0;
+	for (const Mesh& mesh : meshes)
+		numVertices += mesh.NumVertices;
+
+	const int numJobs = (int)Math::Min(Math::Min((size_t)Math::Min(maxNumJobs, MAX_NUM_JOBS), meshes.size()),
+		Math::Max(numVertices / MIN_VERTICES_PER_JOB, (size_t)1));
+
+	// contiguous ranges of meshes with roughly the same number of vertices. Job i takes the meshes that
+	// start in [i * numVertices / numJobs, (i + 1) * numVertices / numJobs).
+	size_t currMesh = 0;
+	size_t currVertex = 0;
+
+	for (int i = 0; i < numJobs; i++)
+	{
+		const size_t end = (i + 1) * numVertices / numJobs;
+		m_jobOffsets[i] = currMesh;
+
+		while (currMesh < meshes.size() && (currVertex < end || i == numJobs - 1))
+			currVertex += meshes[currMesh++].NumVertices;
+
+		m_jobSizes[i] = currMesh - m_jobOffsets[i];
+	}
+
+	return numJobs;
+}
+
+void MeshSkinner::SkinRange(Span<Mesh> meshes, SKINNING_METHOD method, size_t beg, size_t n) noexcept
+{
+	for (size_t i = beg; i < beg + n; i++)
+	{
+		Mesh& mesh = meshes[i];
+		Span<Vertex> vertices(mesh.Vertices, mesh.NumVertices);
+		Span<SkinInfluence> influences(mesh.Influences, mesh.NumVertices);
+		Span<Vertex> out(mesh.Out, mesh.NumVertices);
+
+		if (method == SKINNING_METHOD::LINEAR_BLEND)
+			SkinLinearBlend(vertices, influences, Span(mesh.Palette, mesh.NumJoints), out);
+		else
+			SkinDualQuaternion(vertices, influences, Span(m_dualQuats.begin() + m_dualQuatOffsets[i], mesh.NumJoints), out);
+	}
+}
+
+void MeshSkinner::Clear() noexcept
+{
+	m_dualQuats.free_memory();
+	m_dualQuatOffsets.free_memory();
+}
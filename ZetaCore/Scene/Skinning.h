@@ -0,0 +1,138 @@
+#pragma once
+
+#include "../Core/Vertex.h"
+#include "../Math/Matrix.h"
+#include "../Utility/SmallVector.h"
+#include "../Utility/Span.h"
+#include "../Support/Executor.h"
+
+namespace ZetaRay::Scene
+{
+	// Joints (indices into the skin's joints) that influence a vertex and their weights. Weights
+	// should add up to one; unused influences have a weight of zero.
+	struct SkinInfluence
+	{
+		static constexpr int MAX_NUM_INFLUENCES = 4;
+
+		uint16_t Joints[MAX_NUM_INFLUENCES];
+		float Weights[MAX_NUM_INFLUENCES];
+	};
+
+	// Rigid transformation as a unit dual quaternion (Real + eps * Dual) along with a scale that's
+	// applied before it. Dual quaternions only represent rotation and translation, so scale is blended
+	// separately.
+	struct DualQuaternion
+	{
+		Math::float4 Real;
+		Math::float4 Dual;
+		Math::float3 Scale;
+	};
+
+	enum class SKINNING_METHOD
+	{
+		// blends the skinning matrices -- fast, but volume is lost around joints that twist or bend a lot
+		LINEAR_BLEND,
+		// blends the rigid part of skinning matrices as dual quaternions, which avoids the "candy-wrapper"
+		// artifacts of linear blending
+		DUAL_QUATERNION
+	};
+
+	// Joint hierarchy of a skin. Parent of every joint comes before it.
+	struct Skeleton
+	{
+		// index of the parent joint or -1 for the roots
+		Util::SmallVector<int> Parents;
+		// transforms the mesh from its bind pose into the local space of each joint
+		Util::SmallVector<Math::float4x3> InverseBindMatrices;
+	};
+
+	// Computes the skinning matrix of every joint from the local transformations of joints (e.g. the
+	// output of AnimationSampler): palette[i] = InverseBindMatrices[i] * global[i], where global[i] is
+	// the transformation of joint i relative to the skeleton's root.
+	void EvaluatePose(const Skeleton& skeleton, Util::Span<Math::AffineTransformation> localPose,
+		Util::Span<Math::float4x3> palette) noexcept;
+
+	// Decomposes the skinning matrix into scale and a dual quaternion. Skinning matrices are assumed to
+	// have no shear or negative scale.
+	DualQuaternion ToDualQuaternion(const Math::float4x3& M) noexcept;
+
+	// Both of the following write the skinned position, normal and tangent of vertices[i] to out[i] (texture
+	// coordinates are copied over). Vertices are processed in groups of simd<float, 8>::Width: influences
+	// are gathered in structure-of-arrays form and the rest is done for the whole group at once.
+	void SkinLinearBlend(Util::Span<Core::Vertex> vertices, Util::Span<SkinInfluence> influences,
+		Util::Span<Math::float4x3> palette, Util::Span<Core::Vertex> out) noexcept;
+	void SkinDualQuaternion(Util::Span<Core::Vertex> vertices, Util::Span<SkinInfluence> influences,
+		Util::Span<DualQuaternion> palette, Util::Span<Core::Vertex> out) noexcept;
+
+	//--------------------------------------------------------------------------------------
+	// MeshSkinner
+	//--------------------------------------------------------------------------------------
+
+	// Skins a set of meshes, each with its own palette. Meshes are independent of each other, so they're
+	// split into jobs (of roughly the same number of vertices) that can run in parallel; every mesh is
+	// skinned by one job.
+	class MeshSkinner
+	{
+	public:
+		static constexpr int MAX_NUM_JOBS = 16;
+		// meshes are grouped so that every job skins at least this many vertices
+		static constexpr size_t MIN_VERTICES_PER_JOB = 8192;
+
+		struct Mesh
+		{
+			// vertices in the bind pose
+			Core::Vertex* Vertices;
+			// one for every vertex
+			SkinInfluence* Influences;
+			// skinned vertices are written here
+			Core::Vertex* Out;
+			uint32_t NumVertices;
+			// skinning matrix of every joint
+			Math::float4x3* Palette;
+			uint32_t NumJoints;
+		};
+
+		MeshSkinner() noexcept = default;
+		~MeshSkinner() noexcept = default;
+
+		MeshSkinner(const MeshSkinner&) = delete;
+		MeshSkinner& operator=(const MeshSkinner&) = delete;
+
+		void Skin(Util::Span<Mesh> meshes, SKINNING_METHOD method) noexcept
+		{
+			Skin(meshes, method, Support::SerialExecutor());
+		}
+
+		// Same as above, but meshes are split into jobs that run on the given executor (see 
+		// Support/Executor.h)
+		template<typename Executor>
+		void Skin(Util::Span<Mesh> meshes, SKINNING_METHOD method, Executor&& executor) noexcept
+		{
+			const int numJobs = Prepare(meshes, method, executor.MaxNumJobs());
+
+			if (numJobs == 1)
+				SkinRange(meshes, method, 0, meshes.size());
+			else if (numJobs > 1)
+			{
+				executor.For(numJobs, [this, meshes, method](int jobIdx)
+					{
+						SkinRange(meshes, method, m_jobOffsets[jobIdx], m_jobSizes[jobIdx]);
+					});
+			}
+		}
+
+		void Clear() noexcept;
+
+	private:
+		// Returns the number of jobs
+		int Prepare(Util::Span<Mesh> meshes, SKINNING_METHOD method, int maxNumJobs) noexcept;
+		void SkinRange(Util::Span<Mesh> meshes, SKINNING_METHOD method, size_t beg, size_t n) noexcept;
+
+		// palettes of all the meshes converted to dual quaternions. Conversion is done once up front
+		// as it's a small fraction of the work, and palettes are often shared between meshes.
+		Util::SmallVector<DualQuaternion> m_dualQuats;
+		Util::SmallVector<uint32_t> m_dualQuatOffsets;
+		size_t m_jobOffsets[MAX_NUM_JOBS];
+		size_t m_jobSizes[MAX_NUM_JOBS];
+	};
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Classes whose work can be split into independent jobs (e.g. Scene::WorldTransformUpdater) take an
+// executor that decides where those jobs run, so that they don't depend on a particular thread pool.
+// An executor provides the following:
+//
+//	int MaxNumJobs(): maximum number of jobs that are worth creating, e.g. the number of threads.
+//
+//	For(numJobs, job): calls job(i) for every i in [0, numJobs) -- possibly in parallel -- and returns
+//	after all of them have finished.
+//
+//	Stages(numStages, prepare, job): for every stage s in [0, numStages) in order, calls prepare(s),
+//	which returns the number of jobs n in that stage (at most MaxNumJobs()), followed by job(s, i) for
+//	every i in [0, n). prepare(s + 1) is called after every job of stage s has finished. Returns after
+//	the last stage has finished.
+//
+// SerialExecutor runs everything on the calling thread, while TaskExecutor (Task.h) uses the worker
+// threads.
+
+namespace ZetaRay::Support
+{
+	struct SerialExecutor
+	{
+		int MaxNumJobs() const noexcept { return 1; }
+
+		template<typename Job>
+		void For(int numJobs, Job&& job) const noexcept
+		{
+			for (int i = 0; i < numJobs; i++)
+				job(i);
+		}
+
+		template<typename Prepare, typename Job>
+		void Stages(int numStages, Prepare&& prepare, Job&& job) const noexcept
+		{
+			for (int s = 0; s < numStages; s++)
+			{
+				const int numJobs = prepare(s);
+
+				for (int i = 0; i < numJobs; i++)
+					job(s, i);
+			}
+		}
+	};
+}
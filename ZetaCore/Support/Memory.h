@@ -1,11 +1,34 @@
 #pragma once
 
 #include "../App/ZetaRay.h"
-#include <malloc.h>
 #include <concepts>
+#ifdef _MSC_VER
+#include <malloc.h>
+#else
+#include <cstdlib>
+#endif
 
 namespace ZetaRay::Support
 {
+	ZetaInline void* AlignedAlloc(size_t size, size_t alignment) noexcept
+	{
+#ifdef _MSC_VER
+		return _aligned_malloc(size, alignment);
+#else
+		// size has to be a multiple of alignment
+		return std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+#endif
+	}
+
+	ZetaInline void AlignedFree(void* mem) noexcept
+	{
+#ifdef _MSC_VER
+		_aligned_free(mem);
+#else
+		std::free(mem);
+#endif
+	}
+
 	template<typename T>
 	concept AllocType = requires(T t, size_t s, size_t a, void* mem)
 	{
@@ -17,12 +40,12 @@ namespace ZetaRay::Support
 	{
 		ZetaInline void* AllocateAligned(size_t size, size_t alignment) noexcept
 		{
-			return _aligned_malloc(size, alignment);
+			return AlignedAlloc(size, alignment);
 		}
 
 		ZetaInline void FreeAligned(void* mem, size_t size, size_t alignment) noexcept
 		{
-			_aligned_free(mem);
+			AlignedFree(mem);
 		}
 	};
 }
@@ -166,7 +166,7 @@ void* MemoryPool::AllocateAligned(size_t size, size_t alignment) noexcept
 
 	// Alignment > 256 is not supported
 	if(alignment > 256)
-		return _aligned_malloc(size, alignment);
+		return AlignedAlloc(size, alignment);
 
 	// Given alignment a, at most a - 1 additional bytes are needed, e.g. size = 1, a = 64, 
 	// then 63 extra bytes has to be allocated assuming original memory was allocated at an 
@@ -194,7 +194,7 @@ void* MemoryPool::AllocateAligned(size_t size, size_t alignment) noexcept
 	if (poolIndex >= POOL_COUNT)
 	{
 		Assert(size >= MAX_ALLOC_SIZE, "bug");
-		return _aligned_malloc(size, alignment);
+		return AlignedAlloc(size, alignment);
 	}
 
 	// if the pool for the requested size is empty or has become full, add a new memory block
@@ -259,7 +259,7 @@ void MemoryPool::FreeAligned(void* mem, size_t size, size_t alignment) noexcept
 		// this request was allocated with malloc
 		if (maxNumBytes > MAX_ALLOC_SIZE || alignment > 256)
 		{
-			_aligned_free(mem);
+			AlignedFree(mem);
 			return;
 		}
 
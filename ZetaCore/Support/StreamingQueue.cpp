@@ -0,0 +1,88 @@
+#include "StreamingQueue.h"
+#include "../App/Timer.h"
+#include "../Math/Common.h"
+
+using namespace ZetaRay::Support;
+using namespace ZetaRay::Util;
+using namespace ZetaRay::App;
+
+//--------------------------------------------------------------------------------------
+// StreamingQueue
+//--------------------------------------------------------------------------------------
+
+StreamingQueue::StreamingQueue(int numStages, Clock clock) noexcept
+	: m_clock(clock),
+	m_numStages(numStages)
+{
+	Assert(numStages > 0 && numStages <= MAX_NUM_STAGES, "invalid number of stages.");
+
+	for (int i = 0; i < MAX_NUM_STAGES; i++)
+	{
+		m_closed[i].store(false, std::memory_order_relaxed);
+		m_costEstimateMs[i] = UNKNOWN_COST;
+	}
+}
+
+void StreamingQueue::Enqueue(int stage, Function&& item) noexcept
+{
+	Assert(stage >= 0 && stage < m_numStages, "invalid stage.");
+	Assert(!m_closed[stage].load(std::memory_order_relaxed), "stage %d was already closed.", stage);
+
+	bool success = m_queues[stage].enqueue(ZetaMove(item));
+	Assert(success, "moodycamel::ConcurrentQueue couldn't allocate memory.");
+}
+
+void StreamingQueue::Close(int stage) noexcept
+{
+	Assert(stage >= 0 && stage < m_numStages, "invalid stage.");
+	m_closed[stage].store(true, std::memory_order_release);
+}
+
+int StreamingQueue::Integrate(double budgetMs) noexcept
+{
+	DeltaTimer timer;
+	timer.Start();
+	const double startMs = m_clock ? m_clock() : 0.0;
+
+	for (int i = m_currStage; i < m_numStages; i++)
+	{
+		if (m_costEstimateMs[i] != UNKNOWN_COST)
+			m_costEstimateMs[i] *= COST_DECAY;
+	}
+
+	double elapsedMs = 0.0;
+	int numIntegrated = 0;
+
+	while (m_currStage < m_numStages)
+	{
+		// Has to be read before trying to dequeue -- if the stage was already closed, every one of its
+		// items was enqueued before the attempt and a failed attempt means that the stage is done
+		const bool closed = m_closed[m_currStage].load(std::memory_order_acquire);
+
+		// cost of the first item of each stage is unknown, only integrate it at the beginning
+		if (numIntegrated > 0 && (m_costEstimateMs[m_currStage] == UNKNOWN_COST ||
+			elapsedMs + m_costEstimateMs[m_currStage] > budgetMs))
+			break;
+
+		Function item;
+
+		if (!m_queues[m_currStage].try_dequeue(item))
+		{
+			if (!closed)
+				break;
+
+			m_currStage++;
+			continue;
+		}
+
+		item.Run();
+		numIntegrated++;
+
+		timer.End();
+		const double currMs = m_clock ? m_clock() - startMs : timer.DeltaMilli();
+		m_costEstimateMs[m_currStage] = Math::Max(m_costEstimateMs[m_currStage], currMs - elapsedMs);
+		elapsedMs = currMs;
+	}
+
+	return numIntegrated;
+}
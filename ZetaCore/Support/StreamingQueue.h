@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../Utility/Function.h"
+#include <atomic>
+#include <concurrentqueue/concurrentqueue.h>
+
+namespace ZetaRay::Support
+{
+	//--------------------------------------------------------------------------------------
+	// StreamingQueue: work items that are produced by background tasks (e.g. decoded chunks of a
+	// scene that's being streamed in) and integrated by one thread (e.g. at the beginning of every
+	// frame), a few at a time so that each call spends at most a given time budget.
+	//
+	// Items are grouped into stages. Items of stage i + 1 are only integrated after stage i has been
+	// closed and all of its items were integrated (e.g. meshes before the instances that refer to
+	// them). Items of the same stage that were enqueued by the same thread are integrated in order.
+	//--------------------------------------------------------------------------------------
+
+	struct StreamingQueue
+	{
+		static constexpr int MAX_NUM_STAGES = 4;
+
+		// Returns the current time in milliseconds
+		using Clock = double(*)() noexcept;
+
+		// Cost of integrated items is measured with the given clock, or with the high-resolution timer 
+		// when it's null. Former is useful for tests, e.g. items that advance a fake clock.
+		explicit StreamingQueue(int numStages, Clock clock = nullptr) noexcept;
+		~StreamingQueue() noexcept = default;
+
+		StreamingQueue(const StreamingQueue&) = delete;
+		StreamingQueue& operator=(const StreamingQueue&) = delete;
+
+		// Can be called from any thread
+		void Enqueue(int stage, Util::Function&& item) noexcept;
+		// Called after the last item of the given stage has been enqueued. Can be called from any thread.
+		void Close(int stage) noexcept;
+
+		// Integrates the ready items until either there aren't any left or integrating the next one is
+		// expected to go over the budget (based on the cost of previous items of the same stage). At
+		// least one item is integrated when there's any, so that progress is made even when the budget
+		// is smaller than a single item. Returns the number of integrated items.
+		int Integrate(double budgetMs) noexcept;
+
+		// Every stage was closed and all of its items were integrated
+		ZetaInline bool IsDone() const noexcept { return m_currStage == m_numStages; }
+
+	private:
+		// Cost estimates decay with every call to Integrate(), so that an outlier (e.g. due to a
+		// context switch) doesn't throttle the rest of the stage
+		static constexpr double COST_DECAY = 0.9;
+		static constexpr double UNKNOWN_COST = -1.0;
+
+		moodycamel::ConcurrentQueue<Util::Function> m_queues[MAX_NUM_STAGES];
+		std::atomic_bool m_closed[MAX_NUM_STAGES];
+		// largest (decayed) time it took to integrate an item of each stage
+		double m_costEstimateMs[MAX_NUM_STAGES];
+		const Clock m_clock;
+		const int m_numStages;
+		int m_currStage = 0;
+	};
+}
@@ -4,6 +4,7 @@
 #include "../Utility/Span.h"
 #include "../Utility/Function.h"
 #include "../App/App.h"
+#include "Executor.h"
 #include <atomic>
 
 #define USE_TASK_NAMES 0
@@ -161,5 +162,139 @@ namespace ZetaRay::Support
 		bool m_isSorted = false;
 		bool m_isFinalized = false;
 	};
+
+	//--------------------------------------------------------------------------------------
+	// TaskExecutor
+	//--------------------------------------------------------------------------------------
+
+	// Executor (see Executor.h) that runs the jobs on the worker threads. Meant to be called from 
+	// a task -- the calling thread is a worker as well, so it runs jobs itself rather than only 
+	// waiting for them.
+	struct TaskExecutor
+	{
+		// one task per job plus one that prepares the next stage
+		static constexpr int MAX_NUM_JOBS = TaskSet::MAX_NUM_TASKS - 3;
+
+		explicit TaskExecutor(const char* name) noexcept
+			: m_name(name)
+		{}
+
+		int MaxNumJobs() const noexcept
+		{
+			const int numThreads = App::GetNumWorkerThreads();
+			return numThreads < MAX_NUM_JOBS ? numThreads : MAX_NUM_JOBS;
+		}
+
+		// First job runs on the calling thread
+		template<typename Job>
+		void For(int numJobs, Job&& job) noexcept
+		{
+			Assert(numJobs <= MAX_NUM_JOBS, "Too many jobs.");
+
+			if (numJobs <= 1)
+			{
+				if (numJobs == 1)
+					job(0);
+
+				return;
+			}
+
+			TaskSet ts;
+
+			for (int i = 1; i < numJobs; i++)
+			{
+				StackStr(tname, n, "%s_%d", m_name, i);
+				ts.EmplaceTask(tname, [&job, i]()
+					{
+						job(i);
+					});
+			}
+
+			WaitObject waitObj;
+			ts.Sort();
+			ts.Finalize(&waitObj);
+			App::Submit(ZetaMove(ts));
+
+			job(0);
+			waitObj.Wait();
+		}
+
+		// Stages aren't waited on one by one. Instead, jobs of each stage are submitted along with 
+		// a task that depends on all of them and prepares & submits the next stage. Stages with a 
+		// single job run inline. Calling thread only waits once, for the last stage.
+		template<typename Prepare, typename Job>
+		void Stages(int numStages, Prepare&& prepare, Job&& job) noexcept
+		{
+			StageChain<Prepare, Job> chain(prepare, job, m_name, numStages);
+			chain.Advance();
+			chain.Done.Wait();
+		}
+
+	private:
+		template<typename Prepare, typename Job>
+		struct StageChain
+		{
+			StageChain(Prepare& prepare, Job& job, const char* name, int numStages) noexcept
+				: Prep(prepare),
+				Run(job),
+				Name(name),
+				NumStages(numStages)
+			{}
+
+			void Advance() noexcept
+			{
+				while (NextStage < NumStages)
+				{
+					const int stage = NextStage++;
+					const int numJobs = Prep(stage);
+					Assert(numJobs <= MAX_NUM_JOBS, "Too many jobs.");
+
+					if (numJobs == 0)
+						continue;
+
+					if (numJobs == 1)
+					{
+						Run(stage, 0);
+						continue;
+					}
+
+					TaskSet ts;
+
+					for (int i = 0; i < numJobs; i++)
+					{
+						StackStr(tname, n, "%s_%d_%d", Name, stage, i);
+						ts.EmplaceTask(tname, [this, stage, i]()
+							{
+								Run(stage, i);
+							});
+					}
+
+					StackStr(tname, n, "%s_%d", Name, stage + 1);
+					TaskSet::TaskHandle next = ts.EmplaceTask(tname, [this]()
+						{
+							Advance();
+						});
+
+					ts.AddIncomingEdgeFromAll(next);
+					ts.Sort();
+					ts.Finalize();
+					App::Submit(ZetaMove(ts));
+
+					return;
+				}
+
+				Done.Notify();
+			}
+
+			Prepare& Prep;
+			Job& Run;
+			const char* Name;
+			const int NumStages;
+			int NextStage = 0;
+			WaitObject Done;
+		};
+
+		const char* m_name;
+	};
 }
 
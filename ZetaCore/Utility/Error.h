@@ -10,11 +10,11 @@
 #ifdef _DEBUG
 #define StackStr(buffName, lenName, formatStr, ...)                         \
     char buffName[512];                                                     \
-    int lenName = stbsp_snprintf(buffName, 512, formatStr, __VA_ARGS__);    
+    int lenName = stbsp_snprintf(buffName, 512, formatStr, ##__VA_ARGS__);  
 #else
 #define StackStr(buffName, lenName, formatStr, ...)                         \
     char buffName[512];                                                     \
-    int lenName = stbsp_snprintf(buffName, 512, formatStr, __VA_ARGS__);    
+    int lenName = stbsp_snprintf(buffName, 512, formatStr, ##__VA_ARGS__);  
 #endif
 
 //--------------------------------------------------------------------------------------
@@ -35,7 +35,7 @@ namespace ZetaRay::Util
     {                                                                                         \
         char buff_[256];                                                                      \
         int n_ = stbsp_snprintf(buff_, 256, "%s: %d\n", __FILE__, __LINE__);                  \
-        stbsp_snprintf(buff_ + n_, 256 - n_, formatStr, __VA_ARGS__);                         \
+        stbsp_snprintf(buff_ + n_, 256 - n_, formatStr, ##__VA_ARGS__);                       \
         ZetaRay::Util::ReportError("Assertion failed", buff_);                                \
         ZetaRay::Util::DebugBreak();                                                          \
     }
@@ -66,7 +66,7 @@ namespace ZetaRay::Util
     {                                                                                        \
         char buff_[256];                                                                     \
         int n_ = stbsp_snprintf(buff_, 256, "%s: %d\n", __FILE__, __LINE__);                 \
-        stbsp_snprintf(buff_ + n_, 256 - n_, formatStr, __VA_ARGS__);                        \
+        stbsp_snprintf(buff_ + n_, 256 - n_, formatStr, ##__VA_ARGS__);                      \
         ZetaRay::Util::ReportError("Fatal Error", buff_);                                    \
         ZetaRay::Util::DebugBreak();                                                         \
     }
@@ -78,7 +78,7 @@ namespace ZetaRay::Util
     {                                                                                        \
         char buff_[256];                                                                     \
         int n_ = stbsp_snprintf(buff_, 256, "%s: %d\n", __FILE__, __LINE__);                 \
-        stbsp_snprintf(buff_ + n_, 256 - n_, formatStr, __VA_ARGS__);                        \
+        stbsp_snprintf(buff_ + n_, 256 - n_, formatStr, ##__VA_ARGS__);                      \
         ZetaRay::Util::ReportError("Fatal Error", buff_);                                    \
         ZetaRay::Util::Exit();                                                               \
     }
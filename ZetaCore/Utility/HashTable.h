@@ -61,7 +61,12 @@ namespace ZetaRay::Util
 		// Note: in contrast to find(), find_entry() only returns NULL when the table is empty
 		T* find(uint64_t key) noexcept
 		{
-			Entry* e = find_entry(key);
+			return const_cast<T*>(static_cast<const HashTable&>(*this).find(key));
+		}
+
+		const T* find(uint64_t key) const noexcept
+		{
+			const Entry* e = find_entry(key);
 			if (e && e->Key != NULL_KEY)
 				return &e->Val;
 
@@ -149,6 +154,52 @@ namespace ZetaRay::Util
 			return *elem;
 		}
 
+		// Returns the number of removed elements (zero or one). Entries after the removed one in the same
+		// probe sequence are shifted back, so no tombstones are left behind and lookups don't get slower
+		// after many removals.
+		size_t erase(uint64_t key) noexcept
+		{
+			Entry* elem = find_entry(key);
+			if (!elem || elem->Key == NULL_KEY)
+				return 0;
+
+			const size_t n = bucket_count();
+			size_t hole = elem - m_beg;
+			size_t curr = hole;
+
+			while (true)
+			{
+				curr = curr + 1 < n ? curr + 1 : 0;
+				Entry* next = m_beg + curr;
+
+				if (next->Key == NULL_KEY)
+					break;
+
+				// entry can be moved to the hole unless its home bucket is cyclically in (hole, curr]
+				const size_t home = next->Key & (n - 1);
+				const bool stays = hole <= curr ? (home > hole && home <= curr) : (home > hole || home <= curr);
+
+				if (!stays)
+				{
+					Entry* dst = m_beg + hole;
+					if constexpr (!std::is_trivially_destructible_v<T>)
+						dst->Val.~T();
+
+					new (&dst->Val) T(ZetaMove(next->Val));
+					dst->Key = next->Key;
+					hole = curr;
+				}
+			}
+
+			if constexpr (!std::is_trivially_destructible_v<T>)
+				m_beg[hole].Val.~T();
+
+			m_beg[hole].Key = NULL_KEY;
+			m_numEntries--;
+
+			return 1;
+		}
+
 		ZetaInline size_t bucket_count() const noexcept
 		{
 			return m_end - m_beg;
@@ -242,12 +293,26 @@ namespace ZetaRay::Util
 
 		ZetaInline Entry* begin_it() noexcept
 		{
-			return m_beg;
+			return const_cast<Entry*>(static_cast<const HashTable&>(*this).begin_it());
+		}
+
+		ZetaInline const Entry* begin_it() const noexcept
+		{
+			const Entry* curr = m_beg;
+			while (curr != m_end && curr->Key == NULL_KEY)
+				curr++;
+
+			return curr;
 		}
 
 		ZetaInline Entry* next_it(Entry* curr) noexcept
 		{
-			Entry* next = curr + 1;
+			return const_cast<Entry*>(static_cast<const HashTable&>(*this).next_it(curr));
+		}
+
+		ZetaInline const Entry* next_it(const Entry* curr) const noexcept
+		{
+			const Entry* next = curr + 1;
 			while (next != m_end && next->Key == NULL_KEY)
 				next++;
 			
@@ -259,8 +324,18 @@ namespace ZetaRay::Util
 			return m_end;
 		}
 
+		ZetaInline const Entry* end_it() const noexcept
+		{
+			return m_end;
+		}
+
 	private:
 		Entry* find_entry(uint64_t key) noexcept
+		{
+			return const_cast<Entry*>(static_cast<const HashTable&>(*this).find_entry(key));
+		}
+
+		const Entry* find_entry(uint64_t key) const noexcept
 		{
 			const size_t n = bucket_count();
 			if (n == 0)
@@ -268,7 +343,7 @@ namespace ZetaRay::Util
 
 			const size_t origPos = key & (n - 1);	// == key % n (n is a power of 2)
 			size_t nextPos = origPos;
-			Entry* curr = m_beg + origPos;
+			const Entry* curr = m_beg + origPos;
 
 			// which bucket the entry belongs to
 			while (curr->Key != key && curr->Key != NULL_KEY)
@@ -18,7 +18,7 @@ namespace ZetaRay::Util
 	{
 		static_assert(Support::AllocType<Allocator>, "Allocator doesn't meet the requirements for AllocType.");
 		static_assert(std::is_copy_constructible_v<Allocator>, "Allocator must be copy-constructible.");
-		static constexpr size_t MIN_CAPACITY = Math::Max(64 / sizeof(T), 4llu);
+		static constexpr size_t MIN_CAPACITY = Math::Max(64 / sizeof(T), size_t(4));
 
 	public:
 		~Vector() noexcept
@@ -184,6 +184,19 @@ namespace ZetaRay::Util
 			const size_t currCapacity = capacity();
 			const size_t oldSize = size();
 
+			// shrink -- destruct the removed elements
+			if (n <= oldSize)
+			{
+				if constexpr (!std::is_trivially_destructible_v<T>)
+				{
+					for (T* curr = m_beg + n; curr != m_end; curr++)
+						curr->~T();
+				}
+
+				m_end = m_beg + n;
+				return;
+			}
+
 			// check if current capacity is enough, otherwise just adjust the "end" pointer
 			if (n > currCapacity)
 			{
@@ -215,6 +228,19 @@ namespace ZetaRay::Util
 			const size_t oldSize = size();
 			const size_t currCapacity = capacity();
 
+			// shrink -- destruct the removed elements
+			if (n <= oldSize)
+			{
+				if constexpr (!std::is_trivially_destructible_v<T>)
+				{
+					for (T* curr = m_beg + n; curr != m_end; curr++)
+						curr->~T();
+				}
+
+				m_end = m_beg + n;
+				return;
+			}
+
 			if (n > currCapacity)
 			{
 				void* mem = relocate(n);
@@ -354,6 +354,17 @@ size_t Filesystem::GetFileSize(const char* path) noexcept
     return s.QuadPart;
 }
 
+uint64_t Filesystem::GetLastWriteTime(const char* path) noexcept
+{
+    Assert(path, "given path was NULL");
+
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+        return 0;
+
+    return (uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+}
+
 void Filesystem::CreateDirectoryIfNotExists(const char* path) noexcept
 {
     if (!CreateDirectoryA(path, nullptr))
@@ -404,4 +415,84 @@ bool Filesystem::IsDirectory(const char* path) noexcept
     return ret & FILE_ATTRIBUTE_DIRECTORY;
 }
 
+void Filesystem::Prefetch(const void* data, size_t size) noexcept
+{
+    if (!data || !size)
+        return;
+
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<void*>(data);
+    range.NumberOfBytes = size;
+
+    // only a hint, failure isn't an error
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+
+
+
+//--------------------------------------------------------------------------------------
+// MemoryMappedFile
+//--------------------------------------------------------------------------------------
+
+bool Filesystem::MemoryMappedFile::Open(const char* path) noexcept
+{
+    Assert(path, "given path was NULL");
+    Close();
+
+    HANDLE h = CreateFileA(path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
 
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        auto e = GetLastError();
+        Check(e == ERROR_FILE_NOT_FOUND || e == ERROR_PATH_NOT_FOUND,
+            "CreateFile() for path %s failed with following error code: %d", path, e);
+
+        return false;
+    }
+
+    LARGE_INTEGER s;
+    CheckWin32(GetFileSizeEx(h, &s));
+
+    // mapping an empty file fails
+    if (s.QuadPart == 0)
+    {
+        CloseHandle(h);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(h, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    Check(mapping, "CreateFileMapping() for path %s failed with following error code: %d", path, GetLastError());
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    Check(view, "MapViewOfFile() for path %s failed with following error code: %d", path, GetLastError());
+
+    m_file = h;
+    m_mapping = mapping;
+    m_view = view;
+    m_size = s.QuadPart;
+
+    return true;
+}
+
+void Filesystem::MemoryMappedFile::Close() noexcept
+{
+    if (m_view)
+        UnmapViewOfFile(m_view);
+
+    if (m_mapping)
+        CloseHandle(m_mapping);
+
+    if (m_file)
+        CloseHandle(m_file);
+
+    m_file = nullptr;
+    m_mapping = nullptr;
+    m_view = nullptr;
+    m_size = 0;
+}